@@ -0,0 +1,133 @@
+/*
+	File:		CRC.cc
+
+	Contains:	CRC16 implementation (used by framed async serial communications tools).
+
+	Written by:	Newton Research Group, 2009.
+*/
+
+#include "BufferList.h"
+#include "CRC.h"
+
+#include <pthread.h>
+
+
+/*--------------------------------------------------------------------------------
+	CRC16
+	CRC-16 with the reflected polynomial 0xA001 (x^16 + x^15 + x^2 + 1).
+	Buffers are processed eight bytes at a time using slicing-by-8 tables:
+	gCRC16Table[0] is the classic byte-at-a-time table, and gCRC16Table[n]
+	advances a byte through n further zero bytes.
+--------------------------------------------------------------------------------*/
+
+static UShort				gCRC16Table[8][256];
+static pthread_once_t	gCRC16TableOnce = PTHREAD_ONCE_INIT;
+
+static void
+InitCRC16Table(void)
+{
+	for (ArrayIndex i = 0; i < 256; ++i)
+	{
+		ULong crc = i;
+		for (ArrayIndex bit = 0; bit < 8; ++bit)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+		gCRC16Table[0][i] = crc;
+	}
+	for (ArrayIndex i = 0; i < 256; ++i)
+	{
+		ULong crc = gCRC16Table[0][i];
+		for (ArrayIndex slice = 1; slice < 8; ++slice)
+		{
+			crc = (crc >> 8) ^ gCRC16Table[0][crc & 0xFF];
+			gCRC16Table[slice][i] = crc;
+		}
+	}
+}
+
+
+/*--------------------------------------------------------------------------------
+	Reset the CRC.
+	Args:		--
+	Return:	--
+--------------------------------------------------------------------------------*/
+
+void
+CRC16::reset(void)
+{
+	pthread_once(&gCRC16TableOnce, InitCRC16Table);
+	workingCRC = 0;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Add character into CRC computation.
+	Args:		inChar
+	Return:	--
+--------------------------------------------------------------------------------*/
+
+void
+CRC16::computeCRC(UByte inChar)
+{
+	workingCRC = (workingCRC >> 8) ^ gCRC16Table[0][(workingCRC ^ inChar) & 0xFF];
+}
+
+
+/*--------------------------------------------------------------------------------
+	Add characters in buffer into CRC computation.
+	Args:		inData
+	Return:	--
+--------------------------------------------------------------------------------*/
+
+void
+CRC16::computeCRC(CBufferList& inData)
+{
+	UByte chunk[256];
+	size_t count;
+	inData.seek(0, kSeekFromBeginning);
+	while ((count = inData.getn(chunk, sizeof(chunk))) > 0)
+		computeCRC(chunk, count);
+}
+
+
+/*--------------------------------------------------------------------------------
+	Add characters in buffer into CRC computation.
+	Args:		inData
+				inSize
+	Return:	--
+--------------------------------------------------------------------------------*/
+
+void
+CRC16::computeCRC(UByte * inData, size_t inSize)
+{
+	ULong crc = workingCRC;
+	for ( ; inSize >= 8; inSize -= 8, inData += 8)
+	{
+		crc ^= inData[0] | (inData[1] << 8);
+		crc = gCRC16Table[7][crc & 0xFF] ^ gCRC16Table[6][crc >> 8]
+			 ^ gCRC16Table[5][inData[2]] ^ gCRC16Table[4][inData[3]]
+			 ^ gCRC16Table[3][inData[4]] ^ gCRC16Table[2][inData[5]]
+			 ^ gCRC16Table[1][inData[6]] ^ gCRC16Table[0][inData[7]];
+	}
+	for ( ; inSize > 0; inSize--)
+		crc = (crc >> 8) ^ gCRC16Table[0][(crc ^ *inData++) & 0xFF];
+	workingCRC = crc;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Copy 16-bit CRC into two chars in reverse network byte order.
+	Args:		--
+	Return:	--
+--------------------------------------------------------------------------------*/
+
+void
+CRC16::get(void)
+{
+#if defined(hasByteSwapping)
+	crc16[0] = workingCRC;
+	crc16[1] = workingCRC >> 8;
+#else
+	crc16[1] = workingCRC;
+	crc16[0] = workingCRC >> 8;
+#endif
+}
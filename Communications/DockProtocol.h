@@ -261,6 +261,21 @@ struct DockEventHeader
 // Newton 2.1
 #define kDSetStatusText					'stxt'
 
+// Capability negotiation
+// Desktop -> Newton
+#define kDGetCapabilities				'gcap'
+// Newton -> Desktop
+#define kDCapabilities					'caps'
+
+// Soup streaming -- only once kDockCapSoupStreaming has been negotiated
+// Desktop -> Newton
+#define kDStreamSoup						'stso'
+#define kDRestoreSoupStream			'rsso'
+// Desktop <- -> Newton
+#define kDStreamEntry					'sent'
+#define kDStreamAck						'sack'
+#define kDStreamDone						'sdon'
+
 
 /*------------------------------------------------------------------------------
 	N e w t o n I n f o
@@ -443,6 +458,44 @@ enum
 };
 
 
+/*------------------------------------------------------------------------------
+	Capabilities exchanged with kDGetCapabilities / kDCapabilities.
+	A desktop that never asks gets the classic protocol.
+------------------------------------------------------------------------------*/
+
+enum
+{
+	kDockCapSoupStreaming = 1
+};
+
+#define kDockCapabilities				kDockCapSoupStreaming
+
+
+/*------------------------------------------------------------------------------
+	Soup streaming.
+	kDStreamSoup			ULong		window -- max entries sent but not acknowledged
+							ULong		resume after this _uniqueId, or kStreamFromStart
+							Ref		(optional) query spec
+	kDStreamEntry			ULong		_uniqueId
+							Ref		entry
+	kDStreamAck				ULong		_uniqueId of last entry received -- the checkpoint
+							ULong		number of entries received since the last ack
+	kDStreamDone			ULong		number of entries streamed
+	kDRestoreSoupStream	ULong		window -- entries between acknowledgements
+	The desktop acknowledges every kStreamAckInterval(window) entries it
+	receives, but not a final shorter run; kDStreamDone follows that.
+	A restore stream is a run of kDStreamEntry ended by kDStreamDone. An entry
+	is added with the _uniqueId given, as for kDAddEntryWithUniqueID, or with a
+	new one if that is kStreamFromStart. The Newton acknowledges each window
+	of entries added and ends with kDResult.
+------------------------------------------------------------------------------*/
+
+#define kStreamFromStart				0xFFFFFFFF
+#define kDefaultStreamWindow			32
+#define kMaxStreamWindow				256
+#define kStreamAckInterval(window)	(((window) + 1) / 2)
+
+
 /*------------------------------------------------------------------------------
 	Source OS version.
 ------------------------------------------------------------------------------*/
@@ -207,6 +207,7 @@ CDocker::CDocker()
 	fB3 = false;
 	fB4 = false;
 	fSessionType = kSettingUpSession;
+	fCapabilities = 0;
 }
 
 
@@ -726,6 +727,307 @@ CDocker::remoteCursorFree(void)
 }
 
 
+#pragma mark Soup Streaming
+/* -------------------------------------------------------------------------------
+	Soup streaming sends a whole soup, or the result of a query, as a pipelined
+	run of kDStreamEntry events rather than a cursor round-trip per entry.
+	The desktop acknowledges every half window of entries with kDStreamAck,
+	and we only stop to read acknowledgements once a whole window of entries
+	is unacknowledged, so the desktop is always reading while we write.
+	Entries are always streamed in _uniqueId order so that the last _uniqueId
+	acknowledged is a checkpoint the desktop can resume after.
+------------------------------------------------------------------------------- */
+
+/* -------------------------------------------------------------------------------
+	Negotiate capabilities.
+	Desktops that never ask are given the classic protocol.
+	Args:		--
+	Return:	--
+	Protocol data:
+		EventType	------				| already read
+		Size			length				|
+		ULong			desktop capabilities
+------------------------------------------------------------------------------- */
+
+void
+CDocker::writeCapabilities(void)
+{
+	if (fEvtLength != sizeof(ULong))
+		ThrowErr(exLongError, kDockErrBadCommandLength);
+
+	ULong desktopCapabilities;
+	*fPipe >> desktopCapabilities;
+	fCapabilities = desktopCapabilities & kDockCapabilities;
+	writeLong(kDCapabilities, fCapabilities);
+}
+
+
+/* -------------------------------------------------------------------------------
+	Stream the current soup, or entries matching a query, to the desktop.
+	Args:		--
+	Return:	--
+	Protocol data:
+		EventType	------				| already read
+		Size			length				|
+		ULong			window
+		ULong			resume after this _uniqueId, or kStreamFromStart
+		Ref			(optional) query spec; may name the soup in its soupName slot
+------------------------------------------------------------------------------- */
+
+void
+CDocker::streamSoup(void)
+{
+	if ((fCapabilities & kDockCapSoupStreaming) == 0)
+		ThrowErr(exLongError, kDockErrProtocolError);
+	if (fEvtLength < 2*sizeof(ULong))
+		ThrowErr(exLongError, kDockErrBadCommandLength);
+
+	ULong window, checkpoint;
+	*fPipe >> window;
+	*fPipe >> checkpoint;
+	if (window == 0)
+		window = kDefaultStreamWindow;
+	else if (window > kMaxStreamWindow)
+		window = kMaxStreamWindow;
+
+	RefVar querySpec;
+	if (fEvtLength > 2*sizeof(ULong))
+	{
+		RefVar spec(readRef(fTargetStore));
+		if (NOTNIL(spec))
+			querySpec = Clone(spec);
+	}
+	if (ISNIL(querySpec))
+		querySpec = AllocateFrame();
+	else
+	{
+		RefVar soupName(GetFrameSlot(querySpec, SYMA(soupName)));
+		if (NOTNIL(soupName) && IsString(soupName) && Ustrlen(GetUString(soupName)) > 0)
+		{
+			fTargetSoup = StoreGetSoup(fTargetStore, soupName);
+			if (ISNIL(fTargetSoup))
+			{
+				writeResult(kDockErrSoupNotFound);
+				return;
+			}
+			setupSoup();
+		}
+	}
+	verifySoup();
+
+	// walk the _uniqueId index, starting after the checkpoint
+	SetFrameSlot(querySpec, SYMA(indexPath), SYMA(_uniqueId));
+	SetFrameSlot(querySpec, SYMA(beginKey), RA(NILREF));
+	SetFrameSlot(querySpec, SYMA(endKey), RA(NILREF));
+	SetFrameSlot(querySpec, SYMA(endExclKey), RA(NILREF));
+	SetFrameSlot(querySpec, SYMA(startKey), RA(NILREF));
+	if (checkpoint == kStreamFromStart)
+		SetFrameSlot(querySpec, SYMA(beginExclKey), RA(NILREF));
+	else
+		SetFrameSlot(querySpec, SYMA(beginExclKey), MAKEINT(checkpoint));
+
+	RefVar cursor(SoupQuery(fTargetSoup, querySpec));
+	RefVar entry;
+	ArrayIndex ackInterval = kStreamAckInterval(window);
+	ArrayIndex inFlight = 0;
+	ArrayIndex count = 0;
+	ArrayIndex numOfAcks = 0;
+	for (entry = CursorEntry(cursor); NOTNIL(entry); entry = CursorNext(cursor))
+	{
+		// only wait when a whole window is unacknowledged
+		while (inFlight >= window)
+		{
+			if (!readStreamAck(inFlight, checkpoint))
+				return;
+			numOfAcks++;
+		}
+		writeStreamEntry(RINT(GetFrameSlot(entry, SYMA(_uniqueId))), entry);
+		inFlight++;
+		count++;
+		// send each half window as it is completed, so the desktop can acknowledge it while we go on
+		if (count % ackInterval == 0)
+			fPipe->flushWrite();
+	}
+	// collect the acks still to come -- there is none for a final short run
+	while (numOfAcks < count / ackInterval)
+	{
+		if (!readStreamAck(inFlight, checkpoint))
+			return;
+		numOfAcks++;
+	}
+	writeLong(kDStreamDone, count);
+}
+
+
+/* -------------------------------------------------------------------------------
+	Write a soup entry to the stream, without flushing.
+	Args:		inId			its _uniqueId
+				inEntry		the entry
+	Return:	--
+	Protocol data:
+		EventType	kDStreamEntry
+		Size			length
+		ULong			_uniqueId
+		Ref			entry
+------------------------------------------------------------------------------- */
+
+void
+CDocker::writeStreamEntry(ULong inId, RefArg inEntry)
+{
+	size_t nsofLength = 0;
+	writeDockerHeader(kDStreamEntry, false);
+	CObjectWriter writer(inEntry, *fPipe, false);
+	newton_try
+	{
+		if (fVBOCompression == kCompressedVBOs)
+			writer.setCompressLargeBinaries();
+		nsofLength = writer.size();
+		*fPipe << (ULong)(sizeof(ULong) + nsofLength);
+		*fPipe << inId;
+		writer.write();
+	}
+	cleanup
+	{
+		writer.~CObjectWriter();
+	}
+	end_try;
+	pad(nsofLength);
+}
+
+
+/* -------------------------------------------------------------------------------
+	Read an acknowledgement of streamed entries.
+	Anything we have written is flushed first -- the desktop has caught up.
+	Args:		ioInFlight		number of entries sent but not acknowledged
+				outCheckpoint	_uniqueId of the last entry the desktop has
+	Return:	false => the desktop canceled the stream
+	Protocol data:
+		EventType	kDStreamAck
+		Size			length
+		ULong			_uniqueId of last entry received
+		ULong			number of entries received since the last ack
+------------------------------------------------------------------------------- */
+
+bool
+CDocker::readStreamAck(ArrayIndex& ioInFlight, ULong& outCheckpoint)
+{
+	fPipe->flushWrite();
+	readDockerHeader(fEvtTag, fEvtLength);
+	if (fEvtTag == kDOperationCanceled)
+	{
+		writeDockerHeader(kDOpCanceledAck, true);
+		f2F = true;
+		return false;
+	}
+	if (fEvtTag != kDStreamAck || fEvtLength != 2*sizeof(ULong))
+		ThrowErr(exLongError, kDockErrProtocolError);
+
+	ULong numOfEntries;
+	*fPipe >> outCheckpoint;
+	*fPipe >> numOfEntries;
+	ioInFlight = (numOfEntries < ioInFlight) ? ioInFlight - numOfEntries : 0;
+	return true;
+}
+
+
+/* -------------------------------------------------------------------------------
+	Add a stream of entries to the current soup.
+	All entries are added inside one store transaction, which is aborted if
+	the stream is canceled or goes wrong.
+	Args:		--
+	Return:	--
+	Protocol data:
+		EventType	------				| already read
+		Size			length				|
+		ULong			window
+	followed by kDStreamEntry events ended by kDStreamDone.
+------------------------------------------------------------------------------- */
+
+void
+CDocker::restoreSoupStream(void)
+{
+	if ((fCapabilities & kDockCapSoupStreaming) == 0)
+		ThrowErr(exLongError, kDockErrProtocolError);
+	if (fEvtLength != sizeof(ULong))
+		ThrowErr(exLongError, kDockErrBadCommandLength);
+
+	ULong window;
+	*fPipe >> window;
+	if (window == 0)
+		window = kDefaultStreamWindow;
+	else if (window > kMaxStreamWindow)
+		window = kMaxStreamWindow;
+	verifySoup();
+
+	NewtonErr err = noErr;
+	ArrayIndex count = 0;
+	ArrayIndex unacked = 0;
+	ULong lastId = kStreamFromStart;
+	StoreLock(fTargetStore);
+	newton_try
+	{
+		for ( ; ; )
+		{
+			readDockerHeader(fEvtTag, fEvtLength);
+			if (fEvtTag == kDStreamDone)
+			{
+				if (fEvtLength != sizeof(ULong))
+					ThrowErr(exLongError, kDockErrBadCommandLength);
+				ULong numOfEntries;
+				*fPipe >> numOfEntries;
+				if (numOfEntries != count)
+					err = kDockErrProtocolError;
+				break;
+			}
+			if (fEvtTag == kDOperationCanceled)
+			{
+				writeDockerHeader(kDOpCanceledAck, true);
+				f2F = true;
+				err = kDockErrAborted;
+				break;
+			}
+			if (fEvtTag != kDStreamEntry)
+				ThrowErr(exLongError, kDockErrProtocolError);
+			if (fEvtLength <= sizeof(ULong))
+				ThrowErr(exLongError, kDockErrBadCommandLength);
+
+			ULong id;
+			*fPipe >> id;
+			RefVar entry(readRef(fTargetStore));
+			if (id == kStreamFromStart)
+				entry = SoupAddFlushed(fTargetSoup, entry);
+			else
+			{
+				SetFrameSlot(entry, SYMA(_uniqueId), MAKEINT(id));
+				entry = SoupAddFlushedWithUniqueID(fTargetSoup, entry);
+			}
+			lastId = RINT(GetFrameSlot(entry, SYMA(_uniqueId)));
+			count++;
+			if (++unacked >= window)
+			{
+				writeDockerHeader(kDStreamAck, false);
+				*fPipe << (ULong)(2*sizeof(ULong));
+				*fPipe << lastId;
+				*fPipe << (ULong)unacked;
+				fPipe->flushWrite();
+				unacked = 0;
+			}
+		}
+	}
+	cleanup
+	{
+		StoreAbort(fTargetStore);
+		StoreUnlock(fTargetStore);
+	}
+	end_try;
+
+	if (err != noErr)
+		StoreAbort(fTargetStore);
+	StoreUnlock(fTargetStore);
+	writeResult(err);
+}
+
+
 #pragma mark -
 
 bool
@@ -976,6 +1278,17 @@ CDocker::processCommand(bool& outDisconnected, bool& outDone)
 			remoteCursorFree();
 			break;
 
+// Soup Streaming
+		case kDGetCapabilities:
+			writeCapabilities();
+			break;
+		case kDStreamSoup:
+			streamSoup();
+			break;
+		case kDRestoreSoupStream:
+			restoreSoupStream();
+			break;
+
 // Packages
 		case kDLoadPackage:
 			if (fSessionType == kRestoreSession)
@@ -1670,6 +1983,7 @@ CDocker::readDesktopInfo(void)
 	ULong parm;
 
 	// read info about about desktop
+	fCapabilities = 0;
 	*fPipe >> fProtocolVersion;
 	if (fProtocolVersion < kDanteProtocolVersion)
 		ThrowErr(exLongError, kDockErrIncompatibleProtocol);
@@ -256,6 +256,13 @@ public:
 	void		sendSoup(void);
 	void		backupSoup(void);
 
+// soup streaming
+	void		writeCapabilities(void);
+	void		streamSoup(void);
+	void		restoreSoupStream(void);
+	void		writeStreamEntry(ULong inId, RefArg inEntry);
+	bool		readStreamAck(ArrayIndex& ioInFlight, ULong& outCheckpoint);
+
 	void		writeSoupNames(void);
 	void		writeSoupInfo(bool);
 	void		writeIndexDescription(bool);
@@ -379,6 +386,7 @@ private:
 	bool					fIsSelectiveSync;	//+B2
 	bool					fB3;
 	bool					fB4;
+	ULong					fCapabilities;		// negotiated with kDGetCapabilities
 };
 
 #endif	/* __DOCKER_H */
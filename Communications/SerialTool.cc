@@ -674,110 +674,9 @@ const unsigned char kLAFrame[] =
 
 
 /*--------------------------------------------------------------------------------
-	CRC16
+	CRC16 is implemented in CRC.cc.
 --------------------------------------------------------------------------------*/
 
-static const UShort kCRC16LoTable[16] =
-{
-	0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
-	0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440
-};
-
-static const UShort kCRC16HiTable[16] =
-{
-	0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
-	0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
-};
-
-
-/*--------------------------------------------------------------------------------
-	Reset the CRC.
-	Args:		--
-	Return:	--
---------------------------------------------------------------------------------*/
-
-void
-CRC16::reset(void)
-{
-	workingCRC = 0;
-}
-
-
-/*--------------------------------------------------------------------------------
-	Add character into CRC computation.
-	Args:		inChar
-	Return:	--
---------------------------------------------------------------------------------*/
-
-void
-CRC16::computeCRC(UByte inChar)
-{
-	ULong index = ((workingCRC & 0xFF) ^ inChar);
-	ULong loCRC = kCRC16LoTable[index & 0x0F];
-	ULong hiCRC = kCRC16HiTable[(index & 0xF0) >> 4];
-	workingCRC = (workingCRC >> 8) ^ (hiCRC ^ loCRC);
-}
-
-
-/*--------------------------------------------------------------------------------
-	Add characters in buffer into CRC computation.
-	Args:		inData
-	Return:	--
---------------------------------------------------------------------------------*/
-
-void
-CRC16::computeCRC(CBufferList& inData)
-{
-	int ch;
-	inData.seek(0, kSeekFromBeginning);
-	while ((ch = inData.get()) != -1)
-	{
-		ULong index = ((workingCRC & 0xFF) ^ ch);
-		ULong loCRC = kCRC16LoTable[index & 0x0F];
-		ULong hiCRC = kCRC16HiTable[(index & 0xF0) >> 4];
-		workingCRC = (workingCRC >> 8) ^ (hiCRC ^ loCRC);
-	}
-}
-
-
-/*--------------------------------------------------------------------------------
-	Add characters in buffer into CRC computation.
-	Args:		inData
-				inSize
-	Return:	--
---------------------------------------------------------------------------------*/
-
-void
-CRC16::computeCRC(UByte * inData, size_t inSize)
-{
-	for ( ; inSize > 0; inSize--)
-	{
-		ULong index = ((workingCRC & 0xFF) ^ *inData++);
-		ULong loCRC = kCRC16LoTable[index & 0x0F];
-		ULong hiCRC = kCRC16HiTable[(index & 0xF0) >> 4];
-		workingCRC = (workingCRC >> 8) ^ (hiCRC ^ loCRC);
-	}
-}
-
-
-/*--------------------------------------------------------------------------------
-	Copy 16-bit CRC into two chars in network byte order.
-	Args:		--
-	Return:	--
---------------------------------------------------------------------------------*/
-
-void
-CRC16::get(void)
-{
-#if defined(hasByteSwapping)
-	crc16[0] = workingCRC;
-	crc16[1] = workingCRC >> 8;
-#else
-	crc16[1] = workingCRC;
-	crc16[0] = workingCRC >> 8;
-#endif
-}
-
 #pragma mark -
 
 /*--------------------------------------------------------------------------------
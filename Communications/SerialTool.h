@@ -16,6 +16,7 @@
 
 
 class CSerialChip;
+class CHostSerialPort;
 
 /* -------------------------------------------------------------------------------
 	C S e r T o o l R e p l y
@@ -192,6 +193,11 @@ public:
 			  void			killPut(void);
 			  void			killGet(void);
 
+#if !defined(correct)
+			  void			handleInternalEvent(void);
+			  void			handleTimerTick(void);
+#endif
+
 // CSerTool virtual member functions
 			  NewtonErr		allocateBuffers(void);
 			  void			turnOnSerChip(void);
@@ -252,6 +258,10 @@ public:
 	void					rxMultiByteInterrupt(unsigned long);
 	void					carrierTimerInterrupt(unsigned long);
 
+#if !defined(correct)
+	void					transferHostBytes(void);
+#endif
+
 protected:
 // start @380
 	CCircleBuf				fSendBuf;	// +384		// transport output buffer
@@ -269,6 +279,10 @@ protected:
 	CCMOSerialMiscConfig	f470;
 	int						f498;
 // size +4B0
+#if !defined(correct)
+// not in the original
+	CHostSerialPort *		fHostPort;				// stands in for the serial chip on the host
+#endif
 };
 
 
@@ -314,6 +328,10 @@ public:
 	void						getFramingCtl(CCMOFramingParms * outParms);
 
 protected:
+	ArrayIndex				putFramedRun(void);
+	ArrayIndex				getFramedRun(void);
+	void						skipToSYN(void);
+
 // start @4B0
 	int						fGetFrameState;		// +4B0
 	int						fPutFrameState;		// +4B4
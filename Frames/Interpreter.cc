@@ -23,6 +23,9 @@
 #include "DeveloperNotification.h"
 #include "REPTranslators.h"
 #include "ROMResources.h"
+#if !defined(correct) && !defined(forFramework)
+#include "HostStack.h"
+#endif
 
 DeclareException(exMessage, exRootException);
 DeclareException(exInterpreter, exRootException);
@@ -1071,6 +1074,10 @@ ResetStack(const StackState & ioState)
 void
 CInterpreter::run()
 {
+#if !defined(correct) && !defined(forFramework)
+	// C functions that call NewtonScript recurse through here
+	CheckHostStack();
+#endif
 	traceSetOptions();
 
 	StackState stackState;
@@ -21,6 +21,7 @@
 #include "NewtGlobals.h"
 #include "RefMemory.h"
 #include "ROMResources.h"
+#include "KernelTrace.h"
 
 extern "C" void	SafelyPrintString(UniChar * str);
 
@@ -1838,105 +1839,113 @@ size_t free, largest;
 	if (inGC)
 		ThrowErr(exFrames, kNSErrGcDuringGc);
 	inGC = true;
+	TraceEvent(kTraceGCBegin);
 PRINTF(("CObjectHeap::GC()\n"));
 ENTER_FUNC
 
-	// pointer refs will change so invalidate the lookup cache
-	gCached.ref = INVALIDPTRREF;
-	gCached.lenRef = INVALIDPTRREF;
-	FindOffsetCacheClear();
+	// balance the begin event even if something in here throws
+	unwind_protect
+	{
+		// pointer refs will change so invalidate the lookup cache
+		gCached.ref = INVALIDPTRREF;
+		gCached.lenRef = INVALIDPTRREF;
+		FindOffsetCacheClear();
 
-	if (gGC.verbose) {
-		size_t free, largest;
-		heapStatistics(&free, &largest);
-		REPprintf("\n[ GC! start %ld/%ld...", free, largest);
-	}
-	
-	isTWAMarked = false;
-	weakLink = NULL;
+		if (gGC.verbose) {
+			size_t free, largest;
+			heapStatistics(&free, &largest);
+			REPprintf("\n[ GC! start %ld/%ld...", free, largest);
+		}
+		
+		isTWAMarked = false;
+		weakLink = NULL;
 
-	// mark the RefVar handle block
+		// mark the RefVar handle block
 PRINTF(("marking RefHandle block\n"));
-	mark(MAKEPTR(refHBlock));
-	// mark all roots
-	if (gGC.roots != NULL)
-	{
-		Ref ** rp = gGC.roots;
-		count = GetPtrSize((Ptr)gGC.roots)/sizeof(Ref*);
-PRINTF(("marking %d roots\n", count));
-		for (i = 0; i < count; ++i, ++rp)
+		mark(MAKEPTR(refHBlock));
+		// mark all roots
+		if (gGC.roots != NULL)
 		{
-			Ref * p = *rp;
-			if (*p == gSymbolTable)
-				isTWAMarked = true;
-			else if (*p != INVALIDPTRREF)
-				mark(*p);
-		}
+			Ref ** rp = gGC.roots;
+			count = GetPtrSize((Ptr)gGC.roots)/sizeof(Ref*);
+PRINTF(("marking %d roots\n", count));
+			for (i = 0; i < count; ++i, ++rp)
+			{
+				Ref * p = *rp;
+				if (*p == gSymbolTable)
+					isTWAMarked = true;
+				else if (*p != INVALIDPTRREF)
+					mark(*p);
+			}
 heapStatistics(&free, &largest);
 if (free > kHeapSize)
 REPprintf("wacko free heap size %d!\n",free);
-	}
+		}
 
-	// mark all external objects
-	if (gGC.extObjs != NULL)
-	{
-		DIYGCRegistration * regPtr = gGC.extObjs;
-		count = GetPtrSize((Ptr)gGC.extObjs)/sizeof(DIYGCRegistration);
-PRINTF(("marking %d external objects\n", count));
-		for (i = 0; i < count; ++i, ++regPtr)
+		// mark all external objects
+		if (gGC.extObjs != NULL)
 		{
-			regPtr->mark(regPtr->refCon);
-		}
+			DIYGCRegistration * regPtr = gGC.extObjs;
+			count = GetPtrSize((Ptr)gGC.extObjs)/sizeof(DIYGCRegistration);
+PRINTF(("marking %d external objects\n", count));
+			for (i = 0; i < count; ++i, ++regPtr)
+			{
+				regPtr->mark(regPtr->refCon);
+			}
 heapStatistics(&free, &largest);
 if (free > kHeapSize)
 REPprintf("wacko free heap size %d!\n",free);
-	}
+		}
 
-	// mark symbols
-	if (isTWAMarked)
-	{
+		// mark symbols
+		if (isTWAMarked)
+		{
 PRINTF(("\n#### CLEANING SYMBOL TABLE ####\n"));
-		GCTWA();
+			GCTWA();
 PRINTF(("\n#### MARKING SYMBOL TABLE ####\n"));
-		mark(gSymbolTable);
+			mark(gSymbolTable);
 heapStatistics(&free, &largest);
 if (free > kHeapSize)
 REPprintf("wacko free heap size %d!\n",free);
-	}
+		}
 
-	// sweep up unreferenced objects
+		// sweep up unreferenced objects
 PRINTF(("\n#### CLEANING WEAK ARRAYS ####\n"));
-	cleanUpWeakChain();
+		cleanUpWeakChain();
 heapStatistics(&free, &largest);
 if (free > kHeapSize)
 REPprintf("wacko free heap size %d!\n",free);
-	sweepAndCompact();
+		sweepAndCompact();
 heapStatistics(&free, &largest);
 if (free > kHeapSize)
 REPprintf("wacko free heap size %d!\n",free);
-	declawRefsInRegisteredRanges();
+		declawRefsInRegisteredRanges();
 heapStatistics(&free, &largest);
 if (free > kHeapSize)
 REPprintf("wacko free heap size %d!\n",free);
 
-	inGC = false;
+		inGC = false;
 
 //	ValidateHeap(GetCurrentHeap(), -1);
 
-	// collect all external objects
-	if (gGC.extGC != NULL)
-	{
-		GCRegistration * regPtr = gGC.extGC;
-		count = GetPtrSize((Ptr)gGC.extGC)/sizeof(GCRegistration);
-PRINTF(("collecting %d external objects\n", count));
-		for (i = 0; i < count; ++i, ++regPtr)
+		// collect all external objects
+		if (gGC.extGC != NULL)
 		{
-			regPtr->collect(regPtr->refCon);
-		}
+			GCRegistration * regPtr = gGC.extGC;
+			count = GetPtrSize((Ptr)gGC.extGC)/sizeof(GCRegistration);
+PRINTF(("collecting %d external objects\n", count));
+			for (i = 0; i < count; ++i, ++regPtr)
+			{
+				regPtr->collect(regPtr->refCon);
+			}
 heapStatistics(&free, &largest);
 if (free > kHeapSize)
 REPprintf("wacko free heap size %d!\n",free);
+		}
 	}
+	on_unwind
+		TraceEvent(kTraceGCEnd);
+	end_unwind;
 
 	if (gGC.verbose) {
 		size_t	free, largest;
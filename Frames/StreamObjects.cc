@@ -11,6 +11,9 @@
 #include "StreamObjects.h"
 #include "LargeBinaries.h"
 #include "ROMResources.h"
+#if !defined(correct) && !defined(forFramework)
+#include "HostStack.h"
+#endif
 
 
 /*------------------------------------------------------------------------------
@@ -537,6 +540,10 @@ CObjectReader::scanSize(void)
 	ArrayIndex		skipSize = 0;
 	ArrayIndex		objSize;
 	unsigned char	objType;
+#if !defined(correct) && !defined(forFramework)
+	// a stream can nest arrays and frames as deep as it likes
+	CheckHostStack();
+#endif
 	fPipe >> objType;
 	switch (objType)
 	{
@@ -628,6 +635,10 @@ CObjectReader::scan(void)
 {
 	RefVar			obj;
 	unsigned char	objType;
+#if !defined(correct) && !defined(forFramework)
+	// a stream can nest arrays and frames as deep as it likes
+	CheckHostStack();
+#endif
 	fPipe >> objType;
 	switch (objType)
 	{
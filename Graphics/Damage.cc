@@ -0,0 +1,119 @@
+/*
+	File:		Damage.cc
+
+	Contains:	Screen damage.
+					Rects that overlap, or are close enough that blitting them
+					as one wastes little, are merged; when the list is full the
+					new rect is merged with whichever rect wastes least.
+					Split out of Screen.cc so the merging can be built and
+					tested on its own.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "Damage.h"
+#include "Geometry.h"
+
+
+/*------------------------------------------------------------------------------
+	Forget all damage.
+	Args:		ioDamage			the damage set
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+ClearDamage(DamageSet * ioDamage)
+{
+	ioDamage->count = 0;
+}
+
+
+/*------------------------------------------------------------------------------
+	Return the number of pixels in a rect.
+	Args:		inRect
+	Return:	pixel count
+------------------------------------------------------------------------------*/
+
+long
+RectArea(const Rect * inRect)
+{
+	return (long)(inRect->right - inRect->left) * (inRect->bottom - inRect->top);
+}
+
+
+/*------------------------------------------------------------------------------
+	Return the number of pixels that would be blitted needlessly if two rects
+	were blitted as their union.
+	Args:		inRect1, inRect2
+	Return:	pixel count
+------------------------------------------------------------------------------*/
+
+static long
+MergeCost(const Rect * inRect1, const Rect * inRect2)
+{
+	Rect bounds, overlap;
+	UnionRect(inRect1, inRect2, &bounds);
+	long cost = RectArea(&bounds) - RectArea(inRect1) - RectArea(inRect2);
+	if (SectRect(inRect1, inRect2, &overlap))
+		cost += RectArea(&overlap);
+	return cost;
+}
+
+
+/*------------------------------------------------------------------------------
+	Add a rect to the damage set, keeping its rects disjoint.
+	Args:		ioDamage			the damage set
+				inBounds			the rect drawn into
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+AddDamage(DamageSet * ioDamage, const Rect * inBounds)
+{
+	if (EmptyRect(inBounds))
+		return;
+
+	// absorb rects that overlap the new one or are cheap to merge with it;
+	// the merged rect may then reach others, so repeat until nothing merges
+	Rect damage = *inBounds;
+	bool isMerged;
+	do
+	{
+		isMerged = false;
+		for (ArrayIndex i = 0; i < ioDamage->count; )
+		{
+			Rect overlap;
+			if (SectRect(&ioDamage->rect[i], &damage, &overlap)
+			||  MergeCost(&ioDamage->rect[i], &damage) <= kDamageMergeSlack)
+			{
+				UnionRect(&ioDamage->rect[i], &damage, &damage);
+				ioDamage->rect[i] = ioDamage->rect[--ioDamage->count];
+				isMerged = true;
+			}
+			else
+				i++;
+		}
+	} while (isMerged);
+
+	if (ioDamage->count == kMaxDamageRects)
+	{
+		// no room -- merge with whichever rect wastes least, and add that instead
+		ArrayIndex best = 0;
+		long bestCost = MergeCost(&ioDamage->rect[0], &damage);
+		for (ArrayIndex i = 1; i < ioDamage->count; ++i)
+		{
+			long cost = MergeCost(&ioDamage->rect[i], &damage);
+			if (cost < bestCost)
+			{
+				best = i;
+				bestCost = cost;
+			}
+		}
+		UnionRect(&ioDamage->rect[best], &damage, &damage);
+		ioDamage->rect[best] = ioDamage->rect[--ioDamage->count];
+		AddDamage(ioDamage, &damage);
+		return;
+	}
+
+	ioDamage->rect[ioDamage->count++] = damage;
+}
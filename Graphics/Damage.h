@@ -0,0 +1,30 @@
+/*
+	File:		Damage.h
+
+	Contains:	Screen damage declarations.
+					The parts of the screen pixmap drawn into since the last
+					update, kept as a short list of disjoint rects so that
+					distant updates are blitted separately.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__DAMAGE_H)
+#define __DAMAGE_H 1
+
+#include "QDTypes.h"
+
+#define kMaxDamageRects		8
+#define kDamageMergeSlack	(16*16)	// pixels we will blit needlessly to save a blit
+
+struct DamageSet
+{
+	ArrayIndex	count;
+	Rect			rect[kMaxDamageRects];
+};
+
+extern void		ClearDamage(DamageSet * ioDamage);
+extern void		AddDamage(DamageSet * ioDamage, const Rect * inBounds);
+extern long		RectArea(const Rect * inRect);
+
+#endif	/* __DAMAGE_H */
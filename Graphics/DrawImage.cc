@@ -284,6 +284,7 @@ public:
 	NativePixelMap *	pixMap(void)	const;
 	NativePixelMap *	mask(void)		const;
 	int					bitDepth(void)	const;
+	Ref					bitmapRef(void)	const;	// not in the original
 
 private:
 	Ref					getFramBitmap(void);
@@ -306,6 +307,7 @@ private:
 inline	NativePixelMap *	CPixelObj::pixMap(void)		const		{ return fPixPtr; }
 inline	NativePixelMap *	CPixelObj::mask(void)		const		{ return fMaskPtr; }
 inline	int					CPixelObj::bitDepth(void)	const		{ return fBitDepth; }
+inline	Ref					CPixelObj::bitmapRef(void)	const		{ return fBitmapRef; }
 
 
 CPixelObj::CPixelObj()
@@ -700,6 +702,7 @@ DrawBits(const char * inBits, unsigned inHeight, unsigned inWidth, unsigned inRo
 ------------------------------------------------------------------------------*/
 #include "View.h"
 #if !defined(forFramework)
+#include "BackingStore.h"
 extern CView *	FailGetView(RefArg inContext);
 #endif
 
@@ -737,12 +740,306 @@ FCopyBits(RefArg inRcvr, RefArg inImage, RefArg inX, RefArg inY, RefArg inTransf
 
 	int mode = ISNIL(inTransferMode) ? modeCopy : RVALUE(inTransferMode);
 	DrawPicture(inImage, &bounds, vjLeftH + vjTopV, mode);
+#if !defined(forFramework)
+	// not in the original: bits copied outside viewDrawScript are not in any backing store
+	if (!CBackingStore::isDrawing())
+	{
+		FailGetView(inRcvr)->outerBounds(&bounds);
+		CBackingStore::invalidateOverlapping(&bounds);
+	}
+#endif
+	return NILREF;
+}
+
+
+#pragma mark -
+/*------------------------------------------------------------------------------
+	S c a l i n g
+
+	Thumbnails and overviews shrink the same bitmaps again and again, so
+	results are cached. An entry is keyed on the binary holding the source
+	pixels and on the shape of the result. The key is weak: the cache doesn't
+	mark it, so it doesn't keep the binary alive, and updates it after GC so
+	that a binary that has been moved still hits while one that has been
+	collected drops its entry. A binary can be changed in place in any number
+	of ways -- from NewtonScript, or from C through BinaryData -- so an entry
+	also keeps a copy of the pixels and gray table it was scaled from, and is
+	only used if they are unchanged.
+------------------------------------------------------------------------------*/
+
+#define kScaleCacheSize			16
+#define kScaleCacheMaxBytes	(64*KByte)	// don't cache anything bigger, source and result together
+
+struct ScaleCacheEntry
+{
+	Ref				srcObj;			// weak
+	Rect				srcBounds;
+	short				srcRowBytes;
+	short				srcDepth;
+	short				dstWidth;
+	short				dstHeight;
+	short				dstDepth;
+	short				filter;
+	UByte *			srcPixels;		// the source rows, then its gray table if any
+	size_t			srcSize;
+	UByte *			pixels;			// packed rows, no padding
+	ULong				lastUse;
+};
+
+static ScaleCacheEntry	gScaleCache[kScaleCacheSize];
+static ULong				gScaleCacheClock = 0;
+static bool					gScaleCacheIsRegistered = false;
+
+
+/*------------------------------------------------------------------------------
+	Forget a cache entry.
+	Args:		ioEntry
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+ForgetScaleCacheEntry(ScaleCacheEntry * ioEntry)
+{
+	if (ioEntry->pixels)
+	{
+		FreePtr((Ptr)ioEntry->pixels);
+		FreePtr((Ptr)ioEntry->srcPixels);
+	}
+	ioEntry->pixels = NULL;
+	ioEntry->srcPixels = NULL;
+	ioEntry->srcObj = NILREF;
+}
+
+
+/*------------------------------------------------------------------------------
+	GC hooks.
+	Sources aren't marked: the cache must not keep them alive. After GC, move
+	each key with its binary, and forget entries whose binary has gone.
+	Args:		inCache
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+MarkScaleCache(void * inCache)
+{ }
+
+
+static void
+UpdateScaleCache(void * inCache)
+{
+	ScaleCacheEntry *	entry = (ScaleCacheEntry *)inCache;
+	for (ArrayIndex i = 0; i < kScaleCacheSize; ++i, ++entry)
+	{
+		if (entry->pixels)
+		{
+			entry->srcObj = DIYGCUpdate(entry->srcObj);
+			if (ISNIL(entry->srcObj))
+				ForgetScaleCacheEntry(entry);
+		}
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	Flush the scaling cache.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+FlushScaleCache(void)
+{
+	for (ArrayIndex i = 0; i < kScaleCacheSize; ++i)
+		ForgetScaleCacheEntry(&gScaleCache[i]);
+}
+
+
+/*------------------------------------------------------------------------------
+	Copy what a scaled result depends on from its source: the rows of pixels
+	and the gray table.
+	Args:		inSrc
+				outPixels		room for them, or NULL just to count them
+	Return:	number of bytes
+------------------------------------------------------------------------------*/
+
+static size_t
+CopySource(const NativePixelMap * inSrc, UByte * outPixels)
+{
+	size_t	rowsSize = RectGetHeight(inSrc->bounds) * inSrc->rowBytes;
+	size_t	grayTableSize = inSrc->grayTable ? 1 << PixelDepth(inSrc) : 0;
+	if (outPixels)
+	{
+		memcpy(outPixels, PixelMapBits(inSrc), rowsSize);
+		if (grayTableSize)
+			memcpy(outPixels + rowsSize, inSrc->grayTable, grayTableSize);
+	}
+	return rowsSize + grayTableSize;
+}
+
+
+/*------------------------------------------------------------------------------
+	Check that a source is as it was when a cache entry was scaled from it.
+	Args:		inEntry
+				inSrc
+	Return:	true if it is
+------------------------------------------------------------------------------*/
+
+static bool
+IsSameSource(const ScaleCacheEntry * inEntry, const NativePixelMap * inSrc)
+{
+	size_t	rowsSize = RectGetHeight(inSrc->bounds) * inSrc->rowBytes;
+	return memcmp(inEntry->srcPixels, PixelMapBits(inSrc), rowsSize) == 0
+		 && (inSrc->grayTable == NULL || memcmp(inEntry->srcPixels + rowsSize, inSrc->grayTable, inEntry->srcSize - rowsSize) == 0);
+}
+
+
+/*------------------------------------------------------------------------------
+	Scale a bitmap's pixel map into another, converting depth as necessary.
+	Both pixel maps must be gray, 1, 2, 4 or 8 bits deep; the destination's
+	gray table, if any, is ignored.
+	Args:		inSrcObj			the binary holding the source pixels
+				inSrc
+				ioDst
+				inFilter			kScaleBox or kScaleBilinear
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+ScalePixelMap(RefArg inSrcObj, const NativePixelMap * inSrc, NativePixelMap * ioDst, int inFilter)
+{
+	int	srcDepth = PixelDepth(inSrc);
+	int	dstDepth = PixelDepth(ioDst);
+	int	dstWidth = RectGetWidth(ioDst->bounds);
+	int	dstHeight = RectGetHeight(ioDst->bounds);
+
+	if ((srcDepth != 1 && srcDepth != 2 && srcDepth != 4 && srcDepth != 8)
+	||  (dstDepth != 1 && dstDepth != 2 && dstDepth != 4 && dstDepth != 8))
+		return kOSErrBadParameters;
+	if (RectGetWidth(inSrc->bounds) <= 0 || RectGetHeight(inSrc->bounds) <= 0 || dstWidth <= 0 || dstHeight <= 0)
+		return noErr;
+
+	UByte *	dstBits = (UByte *)PixelMapBits(ioDst);
+	size_t	packedRowBytes = (dstWidth * dstDepth + 7) / 8;
+	size_t	packedSize = dstHeight * packedRowBytes;
+	size_t	srcSize = CopySource(inSrc, NULL);
+
+	// look for the result in the cache, remembering the least recently used entry
+	ScaleCacheEntry *	entry = NULL;
+	ScaleCacheEntry *	oldest = &gScaleCache[0];
+	for (ArrayIndex i = 0; i < kScaleCacheSize; ++i)
+	{
+		ScaleCacheEntry *	candidate = &gScaleCache[i];
+		if (candidate->pixels
+		&&  candidate->srcObj == inSrcObj
+		&&  EqualRect(&candidate->srcBounds, &inSrc->bounds)
+		&&  candidate->srcRowBytes == inSrc->rowBytes
+		&&  candidate->srcDepth == srcDepth
+		&&  candidate->srcSize == srcSize
+		&&  candidate->dstWidth == dstWidth
+		&&  candidate->dstHeight == dstHeight
+		&&  candidate->dstDepth == dstDepth
+		&&  candidate->filter == inFilter)
+		{
+			if (IsSameSource(candidate, inSrc))
+			{
+				entry = candidate;
+				break;
+			}
+			// it has been changed in place: no other entry can match
+			ForgetScaleCacheEntry(candidate);
+		}
+		if (candidate->pixels == NULL || candidate->lastUse < oldest->lastUse)
+			oldest = candidate;
+	}
+
+	if (entry == NULL)
+	{
+		UByte *		pixels = (UByte *)NewPtr(packedSize);
+		NewtonErr	err = pixels ? ScalePixels(inSrc, inFilter, dstWidth, dstHeight, dstDepth, pixels, packedRowBytes) : kOSErrNoMemory;
+		if (err)
+		{
+			if (pixels)
+				FreePtr((Ptr)pixels);
+			return err;
+		}
+
+		UByte *	srcPixels = NULL;
+		if (srcSize + packedSize <= kScaleCacheMaxBytes
+		&&  (srcPixels = (UByte *)NewPtr(srcSize)) != NULL)
+		{
+			if (!gScaleCacheIsRegistered)
+			{
+				DIYGCRegister(gScaleCache, MarkScaleCache, UpdateScaleCache);
+				gScaleCacheIsRegistered = true;
+			}
+			entry = oldest;
+			ForgetScaleCacheEntry(entry);
+			CopySource(inSrc, srcPixels);
+			entry->srcObj = inSrcObj;
+			entry->srcBounds = inSrc->bounds;
+			entry->srcRowBytes = inSrc->rowBytes;
+			entry->srcDepth = srcDepth;
+			entry->srcPixels = srcPixels;
+			entry->srcSize = srcSize;
+			entry->dstWidth = dstWidth;
+			entry->dstHeight = dstHeight;
+			entry->dstDepth = dstDepth;
+			entry->filter = inFilter;
+			entry->pixels = pixels;
+		}
+		else
+		{
+			for (int y = 0; y < dstHeight; ++y)
+				memcpy(dstBits + y * ioDst->rowBytes, pixels + y * packedRowBytes, packedRowBytes);
+			FreePtr((Ptr)pixels);
+			return noErr;
+		}
+	}
+
+	entry->lastUse = ++gScaleCacheClock;
+	for (int y = 0; y < dstHeight; ++y)
+		memcpy(dstBits + y * ioDst->rowBytes, entry->pixels + y * packedRowBytes, packedRowBytes);
+	return noErr;
+}
+
+
+/*------------------------------------------------------------------------------
+	Shrink a bitmap into another, shading it into the destination's grays.
+	Args:		inRcvr
+				inSrcBitmap
+				inDstBitmap		made by MakeBitmap
+	Return:	NILREF
+------------------------------------------------------------------------------*/
+
+Ref
+FGrayShrink(RefArg inRcvr, RefArg inSrcBitmap, RefArg inDstBitmap)
+{
+	CPixelObj	src;
+	CPixelObj	dst;
+	NewtonErr	err = noErr;
+	newton_try
+	{
+		src.init(inSrcBitmap);
+		dst.init(inDstBitmap);
+		const NativePixelMap *	srcPix = src.pixMap();
+		NativePixelMap *			dstPix = dst.pixMap();
+		bool	isShrinking = RectGetWidth(dstPix->bounds) <= RectGetWidth(srcPix->bounds)
+							&& RectGetHeight(dstPix->bounds) <= RectGetHeight(srcPix->bounds);
+		err = ScalePixelMap(src.bitmapRef(), srcPix, dstPix, isShrinking ? kScaleBox : kScaleBilinear);
+	}
+	cleanup
+	{
+		src.~CPixelObj();
+		dst.~CPixelObj();
+	}
+	end_try;
+	if (err)
+		ThrowErr(exGraf, err);
 	return NILREF;
 }
 
 
 Ref		FDrawXBitmap(RefArg inRcvr, RefArg inArg1, RefArg inArg2, RefArg inArg3) { return NILREF; }
-Ref		FGrayShrink(RefArg inRcvr, RefArg inArg1, RefArg inArg2) { return NILREF; }
 Ref		FDrawIntoBitmap(RefArg inRcvr, RefArg inArg1, RefArg inArg2, RefArg inArg3) { return NILREF; }
 Ref		FViewIntoBitmap(RefArg inRcvr, RefArg inArg1, RefArg inArg2, RefArg inArg3) { return NILREF; }
 
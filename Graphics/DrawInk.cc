@@ -5,6 +5,8 @@
 
 	Changes to the original:	Fixed -> float type since we now have the hardware efficiently to handle that,
 										and Quartz likes it.
+										Codewords are decoded through lookup tables from a 64-bit bit buffer,
+										and strokes are passed to the decode proc whole rather than point by point.
 
 	Written by:	Newton Research Group, 2007.
 */
@@ -28,10 +30,20 @@ enum
 {
 	kInkCoderInit = 1,
 	kInkCoderRun,
-	kInkCoderAddPoint,
+	kInkCoderAddStroke,
 	kInkCoderClose
 };
 
+// codewords are looked up this many bits at a time; longer ones are scanned a bit at a time
+#define kLookupBits 10
+
+enum
+{
+	kCodeMore,				// need more bits than the lookup holds
+	kCodeMatch,
+	kCodeFail
+};
+
 
 /*------------------------------------------------------------------------------
 	T y p e s
@@ -57,6 +69,33 @@ struct _CODETABLE
 };
 
 
+/*------------------------------------------------------------------------------
+	Not in the original: a code table indexed by the next kLookupBits bits of
+	the stroke stream, built from a _CODEWORD list by running the original
+	bit-at-a-time scan over every possible index, so decoding through it gives
+	exactly the same result as scanning.
+------------------------------------------------------------------------------*/
+
+struct _LOOKUPENTRY
+{
+	int16_t		word;					// originalWord of the codeword matched
+	uint8_t		len;					// number of bits consumed
+	uint8_t		status;				// kCodeMore, kCodeMatch or kCodeFail
+};
+
+
+struct _CODELOOKUP
+{
+	const _CODEWORD *	codewords;
+	uint16_t		numOfCodewords;	// 0 => list is terminated by a zero codeLen, as for DecodeWord_NEW
+	int16_t		x04;					// escapes, as for _CODETABLE
+	int16_t		x06;
+	int16_t		x08;
+	int16_t		x0A;
+	_LOOKUPENTRY	entry[1 << kLookupBits];
+};
+
+
 struct _POINT				// NOT the same as Point!
 {
 	int16_t		x;
@@ -72,7 +111,7 @@ struct _LPOINT
 
 struct CSStrokeHeader
 {
-	char	stream[];		// bit stream?
+	char	stream[1];		// bit stream?
 };
 typedef OpaqueRef CSStrokeRef;
 
@@ -108,10 +147,8 @@ struct _DPINST					// display points instance data
 	int			f00;			// lock
 	int			f04;
 	_DISPLAY *	displayParms;
-	Point			lastPtOut;	//	+0C	last point drawn
-	Point			lastPtIn;	//	+10	last point entered
-	int			numOfPts;	// +14	number of buffered points
-	Point			pts[20];		// +18
+	CGPoint *	pts;			// display points of the stroke being drawn
+	ArrayIndex	maxNumOfPts;	// number of points allocated
 };
 
 
@@ -151,14 +188,20 @@ struct _DCC
 	int				x0C;				//	cbDecodedData?
 	int				x10;				//	DecodedDataSize?
 	void *			parms;			// _DISPLAY * or _EXPAND * parameters
-	int				x18;
+	int				x18;				// stroke stream size in bytes
 	CSStrokeHeader *	x1C;
 	unsigned char *	x20;			// stroke bit stream
 	int				x24;				// was isHandle flag? now unused
-	int				x28;				// not referenced by decoder
+	int				x28;				// stroke stream size in bits; not referenced by decoder
 	int				x2C;				// stroke stream bit index
 	int				x30;				// ditto
 	int				x34;				// ditto
+	uint64_t			bitBuffer;		// next bits of the stroke stream, first in the low bit
+	int				bitCount;		// number of bits in bitBuffer
+	int				byteIndex;		// next byte of the stroke stream to go into bitBuffer
+	_POINT *			pts;				// points of the stroke being decoded
+	ArrayIndex		numOfPts;
+	ArrayIndex		maxNumOfPts;
 	_LPOINT			penLocation;			// +38	CPPos
 	short				scaleMultiplier;		// +40	ScMul	scaling parameters
 	short				scaleDivisor;			// +42	ScDiv
@@ -166,14 +209,14 @@ struct _DCC
 	int				x48;				// KvStep3
 	int				x4C;				// KvStepE_1
 	int				x50;				// KvStepE_2
-	_CODETABLE *	x54;				// pFarDX
-	_CODETABLE *	x58;				// pFarDY
-	_CODETABLE *	x5C;				// pNearDX
-	_CODETABLE *	x60;				// pNearDY
-	_CODETABLE *	x64;				// pSpX2
-	_CODETABLE *	x68;				// pSpY2
-	_CODETABLE *	x6C;				// pSpX3
-	_CODETABLE *	x70;				// pSpY3
+	_CODELOOKUP *	x54;				// pFarDX
+	_CODELOOKUP *	x58;				// pFarDY
+	_CODELOOKUP *	x5C;				// pNearDX
+	_CODELOOKUP *	x60;				// pNearDY
+	_CODELOOKUP *	x64;				// pSpX2
+	_CODELOOKUP *	x68;				// pSpY2
+	_CODELOOKUP *	x6C;				// pSpX3
+	_CODELOOKUP *	x70;				// pSpY3
 	short				x74;				// InMode	code book
 	UShort			x76;				// OutMode
 	short				isFirstStroke;	// +78	could be bool
@@ -220,6 +263,11 @@ static _CODEWORD	STROKE_TBL[] =
 	{ 0, 0, 0 }
 };
 
+// code lookups, built on first use
+static _CODELOOKUP *	gSegmentLookup = NULL;
+static _CODELOOKUP *	gStrokeLookup = NULL;
+static _CODELOOKUP *	gCodeBookLookup[2][8];
+
 
 /*------------------------------------------------------------------------------
 	F u n c t i o n   P r o t o t y p e s
@@ -230,18 +278,18 @@ void		CSExpandGroup(CSStrokeHeader * inData, ULong inArg2, float inArg3, float i
 void		CSRawExpandGroup(CSStrokeHeader * inData, ULong inArg2, float inArg3, float inArg4, float inArg5, float inArg6);
 void		CSMakePathsGroup(CSStrokeHeader * inData, float inX, float inY);
 void		CSMakePathsGroupInRect(CSStrokeHeader * inData, float inX, float inY, CGRect inRect);
-void		CSDraw(CSStrokeHeader * inData, float inPenSize, CGPoint inLocation, bool inLive);
-void		CSDrawInRect(CSStrokeHeader * inData, float inPenSize, CGSize inOriginalSize, CGRect inDisplayRect, bool inLive);
+void		CSDraw(CSStrokeHeader * inData, size_t inSize, float inPenSize, CGPoint inLocation, bool inLive);
+void		CSDrawInRect(CSStrokeHeader * inData, size_t inSize, float inPenSize, CGSize inOriginalSize, CGRect inDisplayRect, bool inLive);
 
 // internal functions use float parms
 Ptr		GenericCSCompress(CRecStroke ** inStrokes, uint16_t inArg2);
 Ptr		GenericCSExpandGroup(CSStrokeHeader * inData, ULong inArg2, float inArg3, float inArg4, float inArg5, float inArg6, bool inArg7);
 pathsHandle *	GenericCSMakePathsGroup(CSStrokeHeader * inData, float inX, float inY, float inScaleX, float inScaleY);
-void		GenericCSDraw(CSStrokeHeader * inData, float inPenSize, CGPoint inLocation,  bool inLive);
-void		GenericCSDraw(CSStrokeHeader * inData, float inPenSize, CGPoint inLocation, float inScaleX, float inScaleY, bool inLive);
+void		GenericCSDraw(CSStrokeHeader * inData, size_t inSize, float inPenSize, CGPoint inLocation,  bool inLive);
+void		GenericCSDraw(CSStrokeHeader * inData, size_t inSize, float inPenSize, CGPoint inLocation, float inScaleX, float inScaleY, bool inLive);
 
-void		Decode(CSStrokeHeader * inData, uint16_t, void * inParms, CSDecodeProc);
-_DCC *	DecoderOpen(UShort inArg1, CSStrokeRef inStroke, UShort inArg3, CSParmsRef inParms, UShort inArg5);
+void		Decode(CSStrokeHeader * inData, size_t inSize, uint16_t, void * inParms, CSDecodeProc);
+_DCC *	DecoderOpen(size_t inSize, CSStrokeRef inStroke, UShort inArg3, CSParmsRef inParms, UShort inArg5);
 int		DecoderRun(_DCC * p);
 int		DecoderClose(_DCC * p, int * outArg2);
 
@@ -252,7 +300,7 @@ void		EndStroke(_EXPAND * ioData);
 void		AddStrokePoint(_EXPAND * ioData, int inX, int inY);
 
 int		PGCDrawPointProc(short inSelector, _POINT * inPt, _DCC * inContext);
-void		DrawBufferedPoints(_DPINST * inPtBuffer);
+int		DrawStroke(_DPINST * inInstance, const _POINT * inPts, ArrayIndex inNumOfPts);
 	
 int		ReadNewStroke(_DCC * inContext, short * outType);
 int		ReadSegmentNear(_DCC * inContext, short * outType);
@@ -260,8 +308,11 @@ int		ReadShortStroke(_DCC * inContext);
 int		GetSkipPoint(tag_SKP * ioSkipPoint, short inX, short inY);
 int		ClearSkipPoint(tag_SKP * inSkipPoint);
 void		RestoreSegment(int * inArg1, int * inArg2);
-int		DecodeWord_NEW(_DCC * inContext, _CODEWORD * inCW, short * outWord);
-int		DecodeWord_OLD(_DCC * inContext, _CODETABLE * inCT, short * outWord);
+_CODELOOKUP *	MakeCodeLookup(const _CODEWORD * inCW, const _CODETABLE * inCT);
+int		ScanCodeword(const _CODELOOKUP * inLookup, uint64_t inBits, ArrayIndex inNumOfBits, _LOOKUPENTRY * outEntry);
+int		DecodeWord_NEW(_DCC * inContext, const _CODELOOKUP * inLookup, short * outWord);
+int		DecodeWord_OLD(_DCC * inContext, const _CODELOOKUP * inLookup, short * outWord);
+int		AppendPoint(_DCC * ioContext, _POINT inPt);
 int		DecodeLongStroke(_DCC * inContext);
 int		DecodeShortStroke(_DCC * inContext);
 
@@ -501,14 +552,14 @@ GenericCSExpandGuts(CSStrokeHeader * inData, void ** inArg1, ULong inArg2, float
 ------------------------------------------------------------------------------*/
 
 void
-CSDraw(CSStrokeHeader * inData, float inPenSize, CGPoint inLocation, bool inLive)
+CSDraw(CSStrokeHeader * inData, size_t inSize, float inPenSize, CGPoint inLocation, bool inLive)
 {
-	GenericCSDraw(inData, inPenSize, inLocation, inLive);
+	GenericCSDraw(inData, inSize, inPenSize, inLocation, inLive);
 }
 
 
 void
-GenericCSDraw(CSStrokeHeader * inData, float inPenSize, CGPoint inLocation, bool inLive)
+GenericCSDraw(CSStrokeHeader * inData, size_t inSize, float inPenSize, CGPoint inLocation, bool inLive)
 {
 	_DISPLAY parms;
 	parms.penSize = inPenSize;
@@ -516,7 +567,7 @@ GenericCSDraw(CSStrokeHeader * inData, float inPenSize, CGPoint inLocation, bool
 	parms.scale.x = 1.0;
 	parms.scale.y = 1.0;
 	parms.isLive = inLive;
-	Decode(inData, 0, &parms, PGCDrawPointProc);
+	Decode(inData, inSize, 0, &parms, PGCDrawPointProc);
 }
 
 
@@ -525,14 +576,14 @@ GenericCSDraw(CSStrokeHeader * inData, float inPenSize, CGPoint inLocation, bool
 ------------------------------------------------------------------------------*/
 
 void
-CSDrawInRect(CSStrokeHeader * inData, float inPenSize, CGSize inOriginalSize, CGRect inDisplayRect, bool inLive)
+CSDrawInRect(CSStrokeHeader * inData, size_t inSize, float inPenSize, CGSize inOriginalSize, CGRect inDisplayRect, bool inLive)
 {
-	GenericCSDraw(inData, inPenSize, CGPointMake(inDisplayRect.origin.x, inDisplayRect.origin.y+inDisplayRect.size.height), CGRectGetWidth(inDisplayRect)/inOriginalSize.width, CGRectGetHeight(inDisplayRect)/inOriginalSize.height, inLive);
+	GenericCSDraw(inData, inSize, inPenSize, CGPointMake(inDisplayRect.origin.x, inDisplayRect.origin.y+inDisplayRect.size.height), CGRectGetWidth(inDisplayRect)/inOriginalSize.width, CGRectGetHeight(inDisplayRect)/inOriginalSize.height, inLive);
 }
 
 
 void
-GenericCSDraw(CSStrokeHeader * inData, float inPenSize, CGPoint inLocation, float inScaleX, float inScaleY, bool inLive)
+GenericCSDraw(CSStrokeHeader * inData, size_t inSize, float inPenSize, CGPoint inLocation, float inScaleX, float inScaleY, bool inLive)
 {
 	_DISPLAY parms;
 	parms.penSize = inPenSize;
@@ -540,7 +591,7 @@ GenericCSDraw(CSStrokeHeader * inData, float inPenSize, CGPoint inLocation, floa
 	parms.scale.x = inScaleX;
 	parms.scale.y = inScaleY;
 	parms.isLive = inLive;
-	Decode(inData, 0, &parms, PGCDrawPointProc);
+	Decode(inData, inSize, 0, &parms, PGCDrawPointProc);
 }
 
 #pragma mark -
@@ -548,6 +599,7 @@ GenericCSDraw(CSStrokeHeader * inData, float inPenSize, CGPoint inLocation, floa
 /*------------------------------------------------------------------------------
 	Decode points.
 	Args:		inStroke
+				inSize			size of stroke stream in bytes
 				inArg2			TDIL has no inArg2
 				inParms
 				inDecoder
@@ -555,10 +607,10 @@ GenericCSDraw(CSStrokeHeader * inData, float inPenSize, CGPoint inLocation, floa
 ------------------------------------------------------------------------------*/
 
 void
-Decode(CSStrokeHeader * inStroke, UShort inArg2, void * inParms, CSDecodeProc inDecoder)
+Decode(CSStrokeHeader * inStroke, size_t inSize, UShort inArg2, void * inParms, CSDecodeProc inDecoder)
 {
 	_DCC *	context;
-	if ((context = DecoderOpen(1, (CSStrokeRef)inStroke, 1, (CSParmsRef)inParms, (inArg2 == 1) ? 1 : 3)))	// TDIL says inParms->1, 1:3->3
+	if ((context = DecoderOpen(inSize, (CSStrokeRef)inStroke, 1, (CSParmsRef)inParms, (inArg2 == 1) ? 1 : 3)))	// TDIL says inParms->1, 1:3->3
 	{
 		context->proc = inDecoder;
 		context->x24 = 0;		// TDIL says ((_DCC *)context)->instanceData = inParms;
@@ -570,7 +622,7 @@ Decode(CSStrokeHeader * inStroke, UShort inArg2, void * inParms, CSDecodeProc in
 
 /*------------------------------------------------------------------------------
 	Open a decoder.
-	Args:		inArg1
+	Args:		inSize			size of stroke stream in bytes
 				inStroke
 				inArg3
 				inParms
@@ -579,7 +631,7 @@ Decode(CSStrokeHeader * inStroke, UShort inArg2, void * inParms, CSDecodeProc in
 ------------------------------------------------------------------------------*/
 
 _DCC *
-DecoderOpen(UShort inArg1, CSStrokeRef inStroke, UShort inArg3, CSParmsRef inParms, UShort inArg5)
+DecoderOpen(size_t inSize, CSStrokeRef inStroke, UShort inArg3, CSParmsRef inParms, UShort inArg5)
 {
 	_DCC *	context;
 
@@ -590,16 +642,31 @@ DecoderOpen(UShort inArg1, CSStrokeRef inStroke, UShort inArg3, CSParmsRef inPar
 
 		context->err = noErr;
 
-		XFAIL(inArg1 == 0 || inStroke == 0)
+		XFAIL(inSize == 0 || inStroke == 0)
 		context->x1C = (CSStrokeHeader *)inStroke;
-		context->x18 = inArg1;
+		context->x18 = inSize;
 		context->x24 = 1;
-		context->x28 = inArg1 * 8;
+		context->x28 = inSize * 8;
 		context->x2C = 0;
 		context->x30 = 0;
 		context->x34 = 0;
+		context->bitBuffer = 0;
+		context->bitCount = 0;
+		context->byteIndex = 0;
 		context->penLocation = (_LPOINT){0,0};
 
+		// decoded strokes are gathered here, to be passed to the decode proc whole
+		context->maxNumOfPts = 64;
+		context->pts = (_POINT *)NewPtr(context->maxNumOfPts * sizeof(_POINT));
+		XFAIL(context->pts == NULL)
+		context->numOfPts = 0;
+
+		if (gStrokeLookup == NULL)
+			gStrokeLookup = MakeCodeLookup(STROKE_TBL, NULL);
+		if (gSegmentLookup == NULL)
+			gSegmentLookup = MakeCodeLookup(SEGMENT_TBL, NULL);
+		XFAIL(gStrokeLookup == NULL || gSegmentLookup == NULL)
+
 		XFAIL(inArg3 == 0 || inParms == 0)
 		context->parms = (void *)inParms;
 		context->x0C = inArg3;
@@ -614,6 +681,8 @@ DecoderOpen(UShort inArg1, CSStrokeRef inStroke, UShort inArg3, CSParmsRef inPar
 
 	XDOFAIL(context)
 	{
+		if (context->pts)
+			FreePtr((Ptr)context->pts);
 		FreePtr((Ptr)context);
 	}
 	XENDFAIL;
@@ -625,6 +694,8 @@ DecoderOpen(UShort inArg1, CSStrokeRef inStroke, UShort inArg3, CSParmsRef inPar
 /*------------------------------------------------------------------------------
 	Run a decoder.
 	Return when all strokes have been processed.
+	Each stroke is decoded into the context's point array, which is then passed
+	to the decode proc in one call.
 	Args:		inContext		the decoder instance
 	Return:	status
 ------------------------------------------------------------------------------*/
@@ -655,6 +726,11 @@ DecoderRun(_DCC * inContext)
 			else if (strokeType == 2)
 				return 1;
 
+			if (inContext->numOfPts > 0)
+			{
+				inContext->proc(kInkCoderAddStroke, inContext->pts, inContext);
+				inContext->numOfPts = 0;
+			}
 			inContext->proc(kInkCoderRun, NULL, inContext);
 		}
 	}
@@ -693,29 +769,61 @@ DecoderClose(_DCC * inContext, int * outArg2)
 		  ||  inContext->x74 == 3)
 		UnlockCodeBook(2);
 */
+	FreePtr((Ptr)inContext->pts);
 	FreePtr((Ptr)inContext);
 
 	return result;
 }
 
 
+/*------------------------------------------------------------------------------
+	Fill the bit buffer so it holds at least 57 bits of the stroke stream.
+	The original read the stream a bit at a time; now a byte goes into the
+	buffer whenever there is room for it. Beyond the end of the stream we read
+	zeroes.
+------------------------------------------------------------------------------*/
+
+static inline void
+FillBitBuffer(_DCC * ioContext)
+{
+	while (ioContext->bitCount <= 56)
+	{
+		uint64_t	byte = (ioContext->byteIndex < ioContext->x18) ? ioContext->x20[ioContext->byteIndex] : 0;
+		ioContext->bitBuffer |= byte << ioContext->bitCount;
+		ioContext->bitCount += 8;
+		ioContext->byteIndex++;
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	Consume bits from the bit buffer.
+------------------------------------------------------------------------------*/
+
+static inline void
+SkipBits(_DCC * ioContext, ArrayIndex inNumOfBits)
+{
+	ioContext->bitBuffer >>= inNumOfBits;
+	ioContext->bitCount -= inNumOfBits;
+	ioContext->x2C += inNumOfBits;
+	ioContext->x30 += inNumOfBits;
+	ioContext->x34 += inNumOfBits;
+}
+
+
 /*------------------------------------------------------------------------------
 	Get n bits from the stroke stream.
+	The first bit read is the least significant bit of the result.
 ------------------------------------------------------------------------------*/
 
 unsigned int
 GetNBit(_DCC * inContext, uint16_t inNumOfBits)
 {
-	unsigned int	bit, word = 0;
+	unsigned int	word;
 
-	for (ArrayIndex i = 0; i < inNumOfBits; ++i)
-	{
-		bit = (inContext->x20[inContext->x2C/8] >> (inContext->x2C & 0x07)) & 0x01;
-		word |= (bit << i);
-		inContext->x2C++;
-	}
-	inContext->x30 += inNumOfBits;
-	inContext->x34 += inNumOfBits;
+	FillBitBuffer(inContext);
+	word = inContext->bitBuffer & ((1ULL << inNumOfBits) - 1);
+	SkipBits(inContext, inNumOfBits);
 
 	return word;
 }
@@ -729,12 +837,14 @@ int
 DecoderSelectCodeBook(_DCC * inContext)
 {
 	_CODETABLE *	table = NULL;
+	_CODELOOKUP **	lookup = NULL;
 
 	XTRY
 	{
 		if (inContext->x74 == 1)
 		{
 			table = &kCompr1;	// original says LockCodeBook(1);
+			lookup = gCodeBookLookup[0];
 			inContext->scaleMultiplier = 1024;
 			inContext->scaleDivisor = 1;
 			inContext->x44 = 0x08CC;	// 2252
@@ -745,6 +855,7 @@ DecoderSelectCodeBook(_DCC * inContext)
 		else if (inContext->x74 == 2 || inContext->x74 == 3)
 		{
 			table = &kCompr2;	// original says LockCodeBook(2);
+			lookup = gCodeBookLookup[1];
 			inContext->scaleMultiplier = 1024;
 			inContext->scaleDivisor = 1;
 			inContext->x44 = 0x1D50;	// 7504
@@ -754,21 +865,24 @@ DecoderSelectCodeBook(_DCC * inContext)
 		}
 		XFAIL(table == NULL)
 
-		inContext->x54 = table;
-		table = (_CODETABLE *)((char *)table + table->size);
-		inContext->x58 = table;
-		table = (_CODETABLE *)((char *)table + table->size);
-		inContext->x5C = table;
-		table = (_CODETABLE *)((char *)table + table->size);
-		inContext->x60 = table;
-		table = (_CODETABLE *)((char *)table + table->size);
-		inContext->x64 = table;
-		table = (_CODETABLE *)((char *)table + table->size);
-		inContext->x68 = table;
-		table = (_CODETABLE *)((char *)table + table->size);
-		inContext->x6C = table;
-		table = (_CODETABLE *)((char *)table + table->size);
-		inContext->x70 = table;
+		// the code book is eight tables, one after the other; build lookups for them
+		ArrayIndex	i;
+		for (i = 0; i < 8; ++i, table = (_CODETABLE *)((char *)table + table->size))
+		{
+			if (lookup[i] == NULL
+			&& (lookup[i] = MakeCodeLookup(table->codewords, table)) == NULL)
+				break;
+		}
+		XFAIL(i < 8)
+
+		inContext->x54 = lookup[0];
+		inContext->x58 = lookup[1];
+		inContext->x5C = lookup[2];
+		inContext->x60 = lookup[3];
+		inContext->x64 = lookup[4];
+		inContext->x68 = lookup[5];
+		inContext->x6C = lookup[6];
+		inContext->x70 = lookup[7];
 
 		return 1;
 	}
@@ -794,7 +908,7 @@ ReadNewStroke(_DCC * inContext, short * outType)
 		if (inContext->isFirstStroke)
 		{
 			inContext->isFirstStroke = false;
-			XFAIL(!DecodeWord_NEW(inContext, STROKE_TBL, outType))
+			XFAIL(!DecodeWord_NEW(inContext, gStrokeLookup, outType))
 			if (*outType == 2)
 			{
 				unsigned int	firstWord = GetNBit(inContext, 4);
@@ -804,7 +918,7 @@ ReadNewStroke(_DCC * inContext, short * outType)
 				dx = GetNBit(inContext, numOfBits);
 				dy = GetNBit(inContext, numOfBits);
 				XFAIL(inContext->err != noErr)
-				XFAIL(!DecodeWord_NEW(inContext, STROKE_TBL, outType))
+				XFAIL(!DecodeWord_NEW(inContext, gStrokeLookup, outType))
 				XFAIL(*outType == 2)
 			}
 			else
@@ -818,9 +932,9 @@ ReadNewStroke(_DCC * inContext, short * outType)
 				if (*outType == 1
 				&& (dx == 0x01FF || dy == 0x01FF))
 				{
-					XFAIL(!DecodeWord_NEW(inContext, SEGMENT_TBL, outType))
+					XFAIL(!DecodeWord_NEW(inContext, gSegmentLookup, outType))
 					XFAIL(*outType != 7)
-					XFAIL(!DecodeWord_NEW(inContext, STROKE_TBL, outType))
+					XFAIL(!DecodeWord_NEW(inContext, gStrokeLookup, outType))
 					XFAIL(*outType == 2)
 					inContext->penLocation.x += inContext->x50 * dx;
 					inContext->penLocation.y += inContext->x50 * dy;
@@ -831,7 +945,7 @@ ReadNewStroke(_DCC * inContext, short * outType)
 		}
 		else
 		{
-			XFAIL(!DecodeWord_NEW(inContext, STROKE_TBL, outType))
+			XFAIL(!DecodeWord_NEW(inContext, gStrokeLookup, outType))
 			if (*outType == 2)
 				return 1;
 			XFAIL(!DecodeWord_OLD(inContext, inContext->x54, &dx))
@@ -885,7 +999,7 @@ ReadSegmentNear(_DCC * inContext, short * outType)
 		inContext->x188 = (inContext->x1A4.x - inContext->x1AC.x)/2 - inContext->x190;
 		inContext->x198 = (inContext->x1A4.y - inContext->x1AC.y)/2 - inContext->x1A0;
 
-		XFAIL(!DecodeWord_NEW(inContext, SEGMENT_TBL, outType))
+		XFAIL(!DecodeWord_NEW(inContext, gSegmentLookup, outType))
 
 		return 1;
 	}
@@ -909,7 +1023,7 @@ ReadShortStroke(_DCC * inContext)
 	inContext->vertY[0] = inContext->penLocation.y;
 	inContext->nVert = 1;
 
-	while (DecodeWord_NEW(inContext, SEGMENT_TBL, &strokeType))
+	while (DecodeWord_NEW(inContext, gSegmentLookup, &strokeType))
 	{
 		if (strokeType == 7)
 			return 1;
@@ -1093,83 +1207,180 @@ RestoreSegment(int * inArg1, int * inArg2)
 
 
 /*------------------------------------------------------------------------------
-	Decode word.
+	Scan a code table for the codeword at the start of some bits.
+	This is the original decoding: after each bit is read, the codewords of
+	that length are compared in turn, so the table must be in order of length.
+	Args:		inLookup			code table
+				inBits			bits of the stroke stream, first in the low bit
+				inNumOfBits		number of bits to scan, no more than 32
+				outEntry			the codeword, and the number of bits scanned
+	Return:	kCodeMatch, kCodeFail, or kCodeMore if inNumOfBits was not enough
 ------------------------------------------------------------------------------*/
 
 int
-DecodeWord_NEW(_DCC * inContext, _CODEWORD * inCW, short * outWord)
+ScanCodeword(const _CODELOOKUP * inLookup, uint64_t inBits, ArrayIndex inNumOfBits, _LOOKUPENTRY * outEntry)
 {
+	const _CODEWORD *	theCW = inLookup->codewords;
 	unsigned int	bit, word = 0;
+	int	codewordIndex = 0;
+
+	outEntry->word = 0;
+	outEntry->len = 0;
+	outEntry->status = kCodeMore;
 
-	for (ArrayIndex i = 0; ; ++i)
+	for (ArrayIndex i = 0; i < inNumOfBits; ++i)
 	{
-		bit = (inContext->x20[inContext->x2C/8] >> (inContext->x2C & 0x07)) & 0x01;
+		bit = (inBits >> i) & 0x01;
 		word |= (bit << i);
-		inContext->x2C++;
-		inContext->x30++;
-		inContext->x34++;
+		outEntry->len = i+1;
 
-		for (ArrayIndex j = i+1; j == inCW->codeLen; inCW++)
+		for (ArrayIndex j = i+1; j == theCW->codeLen; theCW++)
 		{
-			if (word == inCW->codeWord)
+			if (word == theCW->codeWord)
 			{
-				*outWord = inCW->originalWord;
-				return 1;
+				outEntry->word = theCW->originalWord;
+				outEntry->status = kCodeMatch;
+				return kCodeMatch;
+			}
+			// _CODETABLEs are counted
+			if (inLookup->numOfCodewords != 0
+			&&  ++codewordIndex == inLookup->numOfCodewords)
+			{
+				outEntry->status = kCodeFail;
+				return kCodeFail;
 			}
 		}
-		if (inCW->codeLen == 0)
+		// plain _CODEWORD lists are terminated
+		if (inLookup->numOfCodewords == 0
+		&&  theCW->codeLen == 0)
 		{
-			*outWord = 0;
-			return 0;
+			outEntry->status = kCodeFail;
+			return kCodeFail;
 		}
 	}
+
+	return kCodeMore;
 }
 
 
 /*------------------------------------------------------------------------------
-	Decode word.
+	Make a lookup for a code table.
+	Args:		inCW				codewords
+				inCT				the table they are in, or NULL for a terminated list
+	Return:	lookup; never freed
 ------------------------------------------------------------------------------*/
 
-int
-DecodeWord_OLD(_DCC * inContext, _CODETABLE * inCT, short * outWord)
+_CODELOOKUP *
+MakeCodeLookup(const _CODEWORD * inCW, const _CODETABLE * inCT)
 {
-	_CODEWORD *	theCW = inCT->codewords;	// r6
-	unsigned int	bit, word = 0;	// r1
-	int	codewordIndex = 0;
+	_CODELOOKUP *	lookup;
 
-	for (ArrayIndex i = 0; i < 32; ++i)
+	if ((lookup = (_CODELOOKUP *)NewPtr(sizeof(_CODELOOKUP))) != NULL)
 	{
-		bit = (inContext->x20[inContext->x2C/8] >> (inContext->x2C & 0x07)) & 0x01;
-		word |= (bit << i);
-		inContext->x2C++;
-		inContext->x30++;
-		inContext->x34++;
-
-		for (ArrayIndex j = i+1; j == theCW->codeLen; theCW++)
+		lookup->codewords = inCW;
+		if (inCT)
 		{
-			if (word == theCW->codeWord)
-			{
-				short	sp00;
-				short	theWord = theCW->originalWord;	// r0
-				if (theCW->originalWord == inCT->x0A)	// at the limit; recurse
-				{
-					if (DecodeWord_OLD(inContext, inCT, &sp00) == 0) return 0;
-					theWord = inCT->x04 + sp00;
-				}
-				if (theCW->originalWord == inCT->x08)	// at the limit; recurse
-				{
-					if (DecodeWord_OLD(inContext, inCT, &sp00) == 0) return 0;
-					theWord = inCT->x06 + sp00;
-				}
-				*outWord = theWord;
-				return 1;
-			}
-			if (++codewordIndex == inCT->numOfCodewords)
-				return 0;
+			lookup->numOfCodewords = inCT->numOfCodewords;
+			lookup->x04 = inCT->x04;
+			lookup->x06 = inCT->x06;
+			lookup->x08 = inCT->x08;
+			lookup->x0A = inCT->x0A;
 		}
+		else
+		{
+			lookup->numOfCodewords = 0;
+			lookup->x04 = lookup->x06 = lookup->x08 = lookup->x0A = 0;
+		}
+		for (ArrayIndex i = 0; i < (1 << kLookupBits); ++i)
+			ScanCodeword(lookup, i, kLookupBits, &lookup->entry[i]);
 	}
+	return lookup;
+}
 
-	return 0;
+
+/*------------------------------------------------------------------------------
+	Read the next codeword from the stroke stream.
+	Codewords no longer than kLookupBits are looked up; longer ones are
+	scanned. As in the original, we give up after 32 bits.
+------------------------------------------------------------------------------*/
+
+static inline int
+ReadCodeword(_DCC * inContext, const _CODELOOKUP * inLookup, short * outWord)
+{
+	_LOOKUPENTRY	cw;
+
+	FillBitBuffer(inContext);
+	cw = inLookup->entry[inContext->bitBuffer & ((1 << kLookupBits) - 1)];
+	if (cw.status == kCodeMore
+	&&  ScanCodeword(inLookup, inContext->bitBuffer, 32, &cw) == kCodeMore)
+		cw.status = kCodeFail;
+	SkipBits(inContext, cw.len);
+
+	*outWord = cw.word;
+	return cw.status == kCodeMatch;
+}
+
+
+/*------------------------------------------------------------------------------
+	Decode word.
+------------------------------------------------------------------------------*/
+
+int
+DecodeWord_NEW(_DCC * inContext, const _CODELOOKUP * inLookup, short * outWord)
+{
+	return ReadCodeword(inContext, inLookup, outWord);
+}
+
+
+/*------------------------------------------------------------------------------
+	Decode word.
+------------------------------------------------------------------------------*/
+
+int
+DecodeWord_OLD(_DCC * inContext, const _CODELOOKUP * inLookup, short * outWord)
+{
+	short	originalWord;
+
+	if (ReadCodeword(inContext, inLookup, &originalWord) == 0)
+		return 0;
+
+	short	sp00;
+	short	theWord = originalWord;	// r0
+	if (originalWord == inLookup->x0A)	// at the limit; recurse
+	{
+		if (DecodeWord_OLD(inContext, inLookup, &sp00) == 0) return 0;
+		theWord = inLookup->x04 + sp00;
+	}
+	if (originalWord == inLookup->x08)	// at the limit; recurse
+	{
+		if (DecodeWord_OLD(inContext, inLookup, &sp00) == 0) return 0;
+		theWord = inLookup->x06 + sp00;
+	}
+	*outWord = theWord;
+	return 1;
+}
+
+
+/*------------------------------------------------------------------------------
+	Add a point to the stroke being decoded.
+	Args:		ioContext
+				inPt
+	Return:	false => out of memory
+------------------------------------------------------------------------------*/
+
+int
+AppendPoint(_DCC * ioContext, _POINT inPt)
+{
+	if (ioContext->numOfPts == ioContext->maxNumOfPts)
+	{
+		_POINT *	pts = (_POINT *)ReallocPtr((Ptr)ioContext->pts, 2 * ioContext->maxNumOfPts * sizeof(_POINT));
+		if (pts == NULL)
+			return 0;
+		ioContext->pts = pts;
+		ioContext->maxNumOfPts *= 2;
+	}
+	ioContext->pts[ioContext->numOfPts++] = inPt;
+	return 1;
 }
 
 
@@ -1209,7 +1420,7 @@ DecodeLongStroke(_DCC * inContext)
 				||  abs(sp04.y - sp08.y) > 1)
 				{
 					sp08 = sp04;
-					if (inContext->proc) inContext->proc(kInkCoderAddPoint, &sp04, inContext);
+					if (!AppendPoint(inContext, sp04)) return 0;
 				}
 			}
 			else
@@ -1219,7 +1430,7 @@ DecodeLongStroke(_DCC * inContext)
 					sp04 = inContext->skipPoint.outPoint;
 
 					sp08 = sp04;
-					if (inContext->proc) inContext->proc(kInkCoderAddPoint, &sp04, inContext);
+					if (!AppendPoint(inContext, sp04)) return 0;
 				}
 			}
 		}
@@ -1233,17 +1444,17 @@ DecodeLongStroke(_DCC * inContext)
 				if (GetSkipPoint(&inContext->skipPoint, sp04.x, sp04.y))
 				{
 					sp04 = inContext->skipPoint.outPoint;
-					if (inContext->proc) inContext->proc(kInkCoderAddPoint, &sp04, inContext);
+					if (!AppendPoint(inContext, sp04)) return 0;
 				}
 				while (ClearSkipPoint(&inContext->skipPoint))
 				{
 					sp04 = inContext->skipPoint.outPoint;
-					if (inContext->proc) inContext->proc(kInkCoderAddPoint, &sp04, inContext);
+					if (!AppendPoint(inContext, sp04)) return 0;
 				}
 			}
 			else
 			{
-				if (inContext->proc) inContext->proc(kInkCoderAddPoint, &sp04, inContext);
+				if (!AppendPoint(inContext, sp04)) return 0;
 			}
 
 			return 1;
@@ -1269,7 +1480,7 @@ DecodeShortStroke(_DCC * inContext)
 		{
 			pt.x = inContext->vertX[i] >> 10;
 			pt.y = inContext->vertY[i] >> 10;
-			inContext->proc(kInkCoderAddPoint, &pt, inContext);
+			if (!AppendPoint(inContext, pt)) return 0;
 		}
 		return 1;
 	}
@@ -1292,9 +1503,9 @@ StorePointProcDefault(short inSelector, _POINT * inPt, _DCC * inParms)
 	Decode proc for storing point data in decode context.
 	Args:		inSelector	1 => allocate & initialize
 								2 => idle? draw?
-								3 => add point
+								3 => add stroke
 								4 => free
-				inPt			point to add
+				inPt			points of stroke to add; inContext->numOfPts of them
 				inContext
 	Return:	status
 ------------------------------------------------------------------------------*/
@@ -1337,7 +1548,7 @@ PGCStorePointProc(short inSelector, _POINT * inPt, _DCC * inContext)
 		}
 		break;
 
-	case kInkCoderAddPoint:
+	case kInkCoderAddStroke:
 		if (instanceData != NULL)
 		{
 			if (instanceData->f04 == 0)
@@ -1348,22 +1559,25 @@ PGCStorePointProc(short inSelector, _POINT * inPt, _DCC * inContext)
 					if (BeginStroke(instanceData->expandParms) == 0)
 						break;
 				}
-				
-				Point	thePoint;
-				float	ordinate;
-				ordinate = inPt->x;
-				if (ordinate < 0)
-					ordinate = 0;
-				ordinate = expander->location.x + (ordinate / gTabScale.x) * expander->scale.x;
-				thePoint.h = ordinate;
-
-				ordinate = inPt->y;
-				if (ordinate < 0)
-					ordinate = 0;
-				ordinate = expander->location.y - (ordinate / gTabScale.y) * expander->scale.y;
-				thePoint.v = ordinate;
-
-				AddStrokePoint(expander, thePoint.h, thePoint.v);
+
+				for (ArrayIndex i = 0; i < inContext->numOfPts; ++i, ++inPt)
+				{
+					Point	thePoint;
+					float	ordinate;
+					ordinate = inPt->x;
+					if (ordinate < 0)
+						ordinate = 0;
+					ordinate = expander->location.x + (ordinate / gTabScale.x) * expander->scale.x;
+					thePoint.h = ordinate;
+
+					ordinate = inPt->y;
+					if (ordinate < 0)
+						ordinate = 0;
+					ordinate = expander->location.y - (ordinate / gTabScale.y) * expander->scale.y;
+					thePoint.v = ordinate;
+
+					AddStrokePoint(expander, thePoint.h, thePoint.v);
+				}
 			}
 			result = 1;
 		}
@@ -1488,9 +1702,9 @@ AddStrokePoint(_EXPAND * ioData, int inX, int inY)	// might be Fixed
 	Decode proc for drawing point data in decode context.
 	Args:		inSelector	1 => allocate & initialize
 								2 => idle? draw?
-								3 => add point
+								3 => add stroke
 								4 => free
-				inPt			point to add
+				inPt			points of stroke to add; inContext->numOfPts of them
 				inContext
 	Return:	status
 ------------------------------------------------------------------------------*/
@@ -1516,8 +1730,8 @@ PGCDrawPointProc(short inSelector, _POINT * inPt, _DCC * inContext)
 			instanceData->f00 = 1;
 			instanceData->f04 = 0;
 			instanceData->displayParms = (_DISPLAY *)inContext->parms;
-			instanceData->lastPtOut = (Point){0,0};
-			instanceData->numOfPts = 0;
+			instanceData->pts = NULL;
+			instanceData->maxNumOfPts = 0;
 			result = 1;
 		}
 		break;
@@ -1525,46 +1739,19 @@ PGCDrawPointProc(short inSelector, _POINT * inPt, _DCC * inContext)
 	case kInkCoderRun:
 		if (instanceData != NULL && display != NULL)
 			instanceData->f00 = 1;
-		DrawBufferedPoints(instanceData);
 		result = 1;
 		break;
 
-	case kInkCoderAddPoint:
+	case kInkCoderAddStroke:
 		if (instanceData != NULL && display != NULL)
 		{
 			if (instanceData->f04 == 0)
 			{
-				Point	thePoint;
-				float	ordinate;
-				ordinate = inPt->x;
-				if (ordinate < 0)
-					ordinate = 0;
-				ordinate = display->location.x + (ordinate / gTabScale.x) * display->scale.x + 0.5;
-				thePoint.h = ordinate;
-
-				ordinate = inPt->y;
-				if (ordinate < 0)
-					ordinate = 0;
-				ordinate = display->location.y - (ordinate / gTabScale.y) * display->scale.y + 0.5;
-				thePoint.v = ordinate;
-
-				if (instanceData->f00)
-				{
-					instanceData->f00 = 0;
-//					MoveTo(thePoint.h, thePoint.v);
-					instanceData->lastPtOut = (Point){-1,-1};
-					instanceData->lastPtIn = (Point){-1,-1};
-				}
-				if (instanceData->lastPtIn.h != thePoint.h
-				||  instanceData->lastPtIn.v != thePoint.v)
-				{
-					instanceData->pts[instanceData->numOfPts++] = thePoint;
-					instanceData->lastPtIn = thePoint;
-				}
-				if (instanceData->numOfPts >= 20)
-					DrawBufferedPoints(instanceData);
+				instanceData->f00 = 0;
+				result = DrawStroke(instanceData, inPt, inContext->numOfPts);
 			}
-			result = 1;
+			else
+				result = 1;
 		}
 		break;
 
@@ -1575,6 +1762,8 @@ PGCDrawPointProc(short inSelector, _POINT * inPt, _DCC * inContext)
 			if (instanceData->f04 == 0)
 			{
 				instanceData->f04 = 1;
+				if (instanceData->pts)
+					FreePtr((Ptr)instanceData->pts);
 				FreePtr((Ptr)instanceData);
 				inContext->instanceData = NULL;
 			}
@@ -1589,63 +1778,67 @@ PGCDrawPointProc(short inSelector, _POINT * inPt, _DCC * inContext)
 
 /*------------------------------------------------------------------------------
 	Join the dots.
-	Args:		inPtBuffer	struct containing points through which a stroke passed
-	Return	--
+	The original buffered 20 points at a time and stroked a path for each
+	buffer; now the whole stroke is one path.
+	Args:		inInstance	display instance data
+				inPts			points through which the stroke passed, in tablet space
+				inNumOfPts	number of them
+	Return	false => out of memory
 ------------------------------------------------------------------------------*/
 
-void
-DrawBufferedPoints(_DPINST * inPoints)
+int
+DrawStroke(_DPINST * inInstance, const _POINT * inPts, ArrayIndex inNumOfPts)
 {
-//printf("DrawBufferedPoints()\n");
-	if (inPoints->numOfPts != 0)
-	{
-		ArrayIndex	index;
-		Point *	lastKnownPt;
-		Point *	thisPt, * nextPt;
-//		Rect		inkedBox;
-//		Point		pnSize;
-
-		_DISPLAY *	display = inPoints->displayParms;
-//		pnSize.h = pnSize.v = display->penSize;
-		index = 0;
-		thisPt = lastKnownPt = &inPoints->lastPtOut;
-		if (thisPt->h == -1
-		&&  thisPt->v == -1)
-		{
-			thisPt = inPoints->pts;
-			if (inPoints->numOfPts > 1)
-				index = 1;
-		}
-		nextPt = &inPoints->pts[index];
+	_DISPLAY *	display = inInstance->displayParms;
 
-/*		GrafPtr thePort;
-		GetPort(&thePort);
-		if (!display->isLive)
-			PenSize(pnSize.h, pnSize.v);
-*/		SetLineWidth(display->penSize);
-
-		CGContextBeginPath(quartz);
-		CGContextMoveToPoint(quartz, thisPt->h, thisPt->v);
-//printf("new path from %d, %d\n", thisPt->h, thisPt->v);
+	// a single point is drawn as a line to itself, so allow room for that
+	if (inInstance->maxNumOfPts < inNumOfPts + 1)
+	{
+		ArrayIndex	numOfPts = (inNumOfPts + 1 + 63) & ~63;
+		CGPoint *	pts = (inInstance->pts == NULL) ? (CGPoint *)NewPtr(numOfPts * sizeof(CGPoint))
+																: (CGPoint *)ReallocPtr((Ptr)inInstance->pts, numOfPts * sizeof(CGPoint));
+		if (pts == NULL)
+			return 0;
+		inInstance->pts = pts;
+		inInstance->maxNumOfPts = numOfPts;
+	}
 
-		for ( ; index < inPoints->numOfPts; ++index, ++nextPt)
+	// convert to display space, dropping points that coincide
+	ArrayIndex	numOfPts = 0;
+	Point			lastPt = (Point){-1,-1};
+	for (ArrayIndex i = 0; i < inNumOfPts; ++i, ++inPts)
+	{
+		Point	thePoint;
+		float	ordinate;
+		ordinate = inPts->x;
+		if (ordinate < 0)
+			ordinate = 0;
+		ordinate = display->location.x + (ordinate / gTabScale.x) * display->scale.x + 0.5;
+		thePoint.h = ordinate;
+
+		ordinate = inPts->y;
+		if (ordinate < 0)
+			ordinate = 0;
+		ordinate = display->location.y - (ordinate / gTabScale.y) * display->scale.y + 0.5;
+		thePoint.v = ordinate;
+
+		if (lastPt.h != thePoint.h
+		||  lastPt.v != thePoint.v)
 		{
-/*			if (display->isLive)
-			{
-				Inkerline(*thisPt, *nextPt, &inkedBox, pnSize.v, &thePort->portBits);
-				thisPt = nextPt;
-			}
-			else
-				LineTo(nextPt->h, nextPt->v);
-*/			CGContextAddLineToPoint(quartz, nextPt->h, nextPt->v);
-//printf("drawing to %d, %d\n", nextPt->h, nextPt->v);
-			thisPt = nextPt;
+			inInstance->pts[numOfPts++] = CGPointMake(thePoint.h, thePoint.v);
+			lastPt = thePoint;
 		}
-//printf("path done\n");
-		CGContextStrokePath(quartz);
-		inPoints->lastPtOut = *thisPt;
-		inPoints->numOfPts = 0;
 	}
+	if (numOfPts == 0)
+		return 1;
+	if (numOfPts == 1)
+		inInstance->pts[numOfPts++] = inInstance->pts[0];
+
+	SetLineWidth(display->penSize);
+	CGContextBeginPath(quartz);
+	CGContextAddLines(quartz, inInstance->pts, numOfPts);
+	CGContextStrokePath(quartz);
+	return 1;
 }
 
 
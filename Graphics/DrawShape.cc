@@ -991,6 +991,7 @@ GetBoundsRect(RefArg inShape, Rect * outRect, Point inOffset, CSaveStyle * inSty
 #pragma mark -
 #if !forFramework
 #include "View.h"
+#include "BackingStore.h"
 extern CView *	FailGetView(RefArg inContext);
 /*------------------------------------------------------------------------------
 	D r a w i n g
@@ -1013,6 +1014,13 @@ FDrawShape(RefArg inRcvr, RefArg inShape, RefArg inStyle)
 	//saveScale = QDScaler::forceScaling(1);
 	DrawShape(inShape, inStyle, pt);
 	//QDScaler::forceScaling(saveScale);
+	// not in the original: a shape drawn outside viewDrawScript is not in any backing store
+	if (!CBackingStore::isDrawing())
+	{
+		Rect  bounds;
+		view->outerBounds(&bounds);
+		CBackingStore::invalidateOverlapping(&bounds);
+	}
 	return NILREF;
 }
 
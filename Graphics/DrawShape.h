@@ -10,6 +10,7 @@
 #define __DRAWSHAPE_H 1
 
 #include "QDDrawing.h"
+#include "Scaling.h"
 
 
 /*------------------------------------------------------------------------------
@@ -31,4 +32,7 @@ extern bool		PtInPixelMap(const NativePixelMap * inPixmap, int inX, int inY);
 extern int		PtInCPixelMap(const NativePixelMap * inPixmap, int inX, int inY);
 extern int		PtInMask(const NativePixelMap * inPixmap, int inX, int inY);
 
+extern NewtonErr	ScalePixelMap(RefArg inSrcObj, const NativePixelMap * inSrc, NativePixelMap * ioDst, int inFilter);
+extern void			FlushScaleCache(void);
+
 #endif	/* __DRAWSHAPE_H */
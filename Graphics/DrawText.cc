@@ -48,10 +48,10 @@ TextBounds(CRichString & inStr, RefArg inFont, Rect * ioRect, long inJustifyH)
 
 
 #include "Quartz.h"
-#include <CoreText/CoreText.h>
 #include "Geometry.h"
 #include "Objects.h"
 #include "DrawText.h"
+#include "TextCache.h"
 #include "DrawShape.h"
 #include "Ink.h"
 
@@ -67,6 +67,8 @@ TextBounds(CRichString & inStr, RefArg inFont, Rect * ioRect, long inJustifyH)
 #include "Preference.h"
 #include "UStringUtils.h"
 
+#include <math.h>
+
 
 void			DrawSimpleParagraph(CRichString & inStr, RefArg inFont, Rect * ioRect, ULong inJustifyH, bool inDoDraw /*, long inTransferMode*/);
 ArrayIndex	DoRichString(CRichString & inStr, ULong inStart, size_t inCount, StyleRecord * inStyle, FPoint inPt, TextOptions * inOptions, TextBoundsInfo * inBoundsInfo, bool inDoDraw);
@@ -429,6 +431,18 @@ DoTextOnce(void * inText, size_t inLength, StyleRecord ** inStyles, short * inRu
 }
 
 
+/*------------------------------------------------------------------------------
+	Draw Unicode text into a box.
+	The laid out text comes from the text cache, and is drawn wherever the box
+	now is.
+	Args:		inStr					text
+				inLength				its length
+				inBox					box to draw it in
+				inColor				colour to draw it in
+				inJustify			horizontal justification
+	Return:	--
+------------------------------------------------------------------------------*/
+
 void
 DrawUnicodeText(const UniChar * inStr, size_t inLength, /* inFont,*/ const Rect * inBox, CGColorRef inColor, ULong inJustify)	// SRB
 {
@@ -468,57 +482,8 @@ DrawUnicodeText(const UniChar * inStr, size_t inLength, /* inFont,*/ const Rect
 
 //	CGContextSelectFont(quartz, "Helvetica", 10.0, kCGEncodingMacRoman);
 
-	// create font -- fixed for now
-	CTFontRef font = CTFontCreateWithName(CFSTR("Helvetica"), 10.0, NULL);	// CTFontCreateUIFontForLanguage(kCTFontMiniSystemFontType, 0.0, NULL);
-
-	//	inJustifyH -> CTParagraphStyleSetting
-	//    create paragraph style and assign text alignment to it
-	CTTextAlignment alignment = inJustify & vjHMask;
-	CTParagraphStyleSetting _settings[] = { { kCTParagraphStyleSpecifierAlignment, sizeof(alignment), &alignment } };
-	CTParagraphStyleRef paraStyle = CTParagraphStyleCreate(_settings, sizeof(_settings) / sizeof(_settings[0]));
-
-	CFStringRef keys[] = { kCTFontAttributeName, kCTStrokeColorAttributeName, kCTParagraphStyleAttributeName };
-	CFTypeRef values[] = { font, inColor, paraStyle };
-	CFDictionaryRef attributes = CFDictionaryCreate(kCFAllocatorDefault, (const void **)&keys, (const void **)&values, sizeof(keys) / sizeof(keys[0]), &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
-
-	// Initialize an attributed string.
-	CFStringRef string = CFStringCreateWithCharacters(kCFAllocatorDefault, inStr, inLength);
-	CFAttributedStringRef attrStr = CFAttributedStringCreate(kCFAllocatorDefault, string, attributes);
-	CFRelease(string);
-	CFRelease(attributes);
-	CFRelease(paraStyle);
-	CFRelease(font);
-
-#if 0
-	CGContextSetTextPosition(quartz, box.origin.x, box.origin.y);
-
-	char str[256];
-	int strLen = MIN(inLength, 255);
-	ConvertFromUnicode((const UniChar *)inStr, str, strLen);
-	CGContextShowTextAtPoint(quartz, box.origin.x, box.origin.y, str, strLen);
-/*
-	CTLineRef line = CTLineCreateWithAttributedString(attrStr);
-	CTLineDraw(line, quartz);
-	CFRelease(line);
-*/
-#else
-	CGMutablePathRef path = CGPathCreateMutable();
-	CGPathAddRect(path, NULL, box);
-
 	CGContextSetStrokeColorWithColor(quartz, inColor);
-
-	// Create the framesetter with the attributed string.
-	CTFramesetterRef framesetter = CTFramesetterCreateWithAttributedString(attrStr);
-	CFRelease(attrStr);
-	 
-	// Create the frame and draw it into the graphics context
-	CTFrameRef frame = CTFramesetterCreateFrame(framesetter, CFRangeMake(0, 0), path, NULL);
-	CTFrameDraw(frame, quartz);
-	CFRelease(frame);
-
-	CFRelease(framesetter);
-	CGPathRelease(path);
-#endif
+	DrawCachedText(inStr, inLength, box, inColor, inJustify);
 
 /*	char str[256];
 	int strLen = MIN(inLength, 255);
@@ -585,12 +550,16 @@ TextBounds(CRichString & inStr, RefArg inFont, Rect * ioRect, long inJustifyH)
 void
 DrawSimpleParagraph(CRichString & inStr, RefArg inFont, Rect * ioRect, ULong inJustifyH, bool inDoDraw /*, long inTransferMode*/)
 {
-	// Initialize an attributed string.
 	size_t strLen = inStr.length();
-	CFStringRef string = CFStringCreateWithCharacters(kCFAllocatorDefault, inStr.grabPtr(), strLen);
-
-
-	DrawUnicodeText(inStr.grabPtr(), strLen, /* inFont,*/ ioRect, gBlackColor, inJustifyH);
-
-	// return path.size.height -> ioRect.bottom
+	if (inDoDraw)
+		DrawUnicodeText(inStr.grabPtr(), strLen, /* inFont,*/ ioRect, gBlackColor, inJustifyH);
+	else
+	{
+		// return height of text laid out in the box's width -> ioRect.bottom
+		CGFloat width = RectGetWidth(*ioRect);
+		if (width < 0.0)
+			width = -width;
+		ioRect->bottom = ioRect->top + ceil(MeasureCachedText(inStr.grabPtr(), strLen, width, gBlackColor, inJustifyH));
+	}
+	inStr.releasePtr();
 }
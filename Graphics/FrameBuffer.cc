@@ -0,0 +1,281 @@
+/*
+	File:		FrameBuffer.cc
+
+	Contains:	Blits onto the display's frame buffer.
+					The LCD is 480x320 at 4 bits a pixel, landscape; images for
+					the portrait orientations are rotated into it a tile at a time.
+					Split out of ScreenDriver.cc so the blits can be built and
+					tested on their own.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "FrameBuffer.h"
+#include "NewtonWidgets.h"
+#include "Geometry.h"
+#include "Screen.h"
+#include "ViewFlags.h"
+
+#define kFrameBufferDepth	4
+
+
+/*------------------------------------------------------------------------------
+	B l i t R e c
+
+	Data passed to landscape blit functions.
+------------------------------------------------------------------------------*/
+
+struct BlitRec
+{
+	int		srcRowOffset;	// +00
+	int		dstRowOffset;	// +04
+	int		x08;
+	Ptr		srcAddr;			// +0C
+	Ptr		dstAddr;			// +10
+	int		mode;				// +14
+	int		numOfRows;		// +18
+	int		numOfBytes;		// +1C
+//	size +20
+};
+
+
+/*------------------------------------------------------------------------------
+	Reverse the order of the eight 4-bit pixels in a long.
+	Reversing the bytes in memory is a byte swap whichever way round the CPU
+	is, so this works on both big- and little-endian hosts.
+	Args:		inPixels		eight pixels
+	Return:	the same pixels, right to left
+------------------------------------------------------------------------------*/
+
+static inline ULong
+FlipNibbles(ULong inPixels)
+{
+	ULong pixels = ((inPixels >> 4) & 0x0F0F0F0F) | ((inPixels & 0x0F0F0F0F) << 4);
+	return (pixels >> 24) | ((pixels >> 8) & 0x0000FF00) | ((pixels << 8) & 0x00FF0000) | (pixels << 24);
+}
+
+
+static void
+BlitLandscape(BlitRec * inBlit)	// 007A6070
+{
+	register int * srcPtr = (int *)inBlit->srcAddr;
+	register int * dstPtr = (int *)inBlit->dstAddr;
+	register int mode = inBlit->mode;
+	register ArrayIndex numOfLongs = inBlit->numOfBytes / 4;	// do 32 bits at a time
+
+	for (ArrayIndex row = inBlit->numOfRows; row > 0; row--)
+	{
+		if (mode == modeCopy)
+			for (ArrayIndex i = numOfLongs; i > 0; i--)
+				*dstPtr++ = *srcPtr++;
+		else /*srcOr*/
+			for (ArrayIndex i = numOfLongs; i > 0; i--)
+				*dstPtr++ |= *srcPtr++;
+		srcPtr = (int *)((Ptr)srcPtr + inBlit->srcRowOffset);
+		dstPtr = (int *)((Ptr)dstPtr + inBlit->dstRowOffset);
+	}
+}
+
+
+static void
+BlitLandscapeFlip(BlitRec * inBlit)	// 007A60E8
+{
+	register int * srcPtr = (int *)inBlit->srcAddr;
+	register int * dstPtr = (int *)inBlit->dstAddr;
+	register int mode = inBlit->mode;
+	register ArrayIndex numOfLongs = inBlit->numOfBytes / 4;
+
+	for (ArrayIndex row = inBlit->numOfRows; row > 0; row--)
+	{
+		if (mode == modeCopy)
+			for (ArrayIndex i = numOfLongs; i > 0; i--)
+				*dstPtr-- = FlipNibbles(*srcPtr++);
+		else /*srcOr*/
+			for (ArrayIndex i = numOfLongs; i > 0; i--)
+				*dstPtr-- |= FlipNibbles(*srcPtr++);
+		srcPtr = (int *)((Ptr)srcPtr + inBlit->srcRowOffset);
+		dstPtr = (int *)((Ptr)dstPtr - inBlit->dstRowOffset);
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	Portrait blits rotate the image into the landscape frame buffer in tiles
+	of 8x8 pixels. A tile is eight rows of four bytes; each row is loaded into
+	a long with its leftmost pixel in the high nibble, the tile is transposed,
+	and each long is stored as a row of the frame buffer.
+------------------------------------------------------------------------------*/
+
+static inline ULong
+LoadTileRow(const UByte * inBits)
+{
+	return (inBits[0] << 24) | (inBits[1] << 16) | (inBits[2] << 8) | inBits[3];
+}
+
+
+static inline void
+StoreTileRow(UByte * outBits, ULong inPixels, int inTransferMode)
+{
+	if (inTransferMode != modeCopy)
+		inPixels |= LoadTileRow(outBits);
+	outBits[0] = inPixels >> 24;
+	outBits[1] = inPixels >> 16;
+	outBits[2] = inPixels >> 8;
+	outBits[3] = inPixels;
+}
+
+
+/*------------------------------------------------------------------------------
+	Transpose an 8x8 tile of 4-bit pixels in place.
+	Swaps the off-diagonal 4x4 blocks, then 2x2 blocks within those, then
+	single pixels, working on a whole long at a time -- 24 mask-and-shift
+	steps instead of 64 nibble moves.
+	Args:		ioTile		eight rows of eight pixels
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static inline void
+TransposeTile(ULong * ioTile)
+{
+	ULong t;
+	for (ArrayIndex i = 0; i < 4; ++i)
+	{
+		t = (ioTile[i] ^ (ioTile[i+4] >> 16)) & 0x0000FFFF;
+		ioTile[i] ^= t;
+		ioTile[i+4] ^= t << 16;
+	}
+	for (ArrayIndex i = 0; i < 8; i += 4)
+	{
+		for (ArrayIndex j = i; j < i+2; ++j)
+		{
+			t = (ioTile[j] ^ (ioTile[j+2] >> 8)) & 0x00FF00FF;
+			ioTile[j] ^= t;
+			ioTile[j+2] ^= t << 8;
+		}
+	}
+	for (ArrayIndex i = 0; i < 8; i += 2)
+	{
+		t = (ioTile[i] ^ (ioTile[i+1] >> 4)) & 0x0F0F0F0F;
+		ioTile[i] ^= t;
+		ioTile[i+1] ^= t << 4;
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	Blit a 4-bit pixmap onto a frame buffer rotated by a quarter turn.
+	Portrait rotates clockwise: screen (x,y) is frame buffer (w-1-y, x).
+	Portrait flip rotates anticlockwise: screen (x,y) is frame buffer (y, h-1-x).
+	The update is rounded out to whole tiles, so the image’s left edge must
+	fall on a tile boundary on screen -- as it does when the pixmap is the
+	screen image.
+	Args:		inPixmap				the image
+				inSrcBounds			part of the image to use
+				inDstBounds			part of the screen to update
+				inTransferMode		modeCopy or srcOr
+				inFrameBuffer		the landscape frame buffer
+				inIsFlipped			true => portrait flip
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+BlitRotated(NativePixelMap * inPixmap, const Rect * inSrcBounds, const Rect * inDstBounds, int inTransferMode, NativePixelMap * inFrameBuffer, bool inIsFlipped)
+{
+	int fbWidth = RectGetWidth(inFrameBuffer->bounds);
+	int fbHeight = RectGetHeight(inFrameBuffer->bounds);
+	int dh = inDstBounds->left - inSrcBounds->left;
+	int dv = inDstBounds->top - inSrcBounds->top;
+
+	// round the update out to whole tiles, within both screen and image
+	int left = MAX(inDstBounds->left, inPixmap->bounds.left + dh);
+	int top = MAX(inDstBounds->top, inPixmap->bounds.top + dv);
+	int right = MIN(inDstBounds->right, inPixmap->bounds.right + dh);
+	int bottom = MIN(inDstBounds->bottom, inPixmap->bounds.bottom + dv);
+	left = MAX(left, 0) & ~0x07;
+	top = MAX(top, 0) & ~0x07;
+	right = MIN((right + 7) & ~0x07, fbHeight);
+	bottom = MIN((bottom + 7) & ~0x07, fbWidth);
+
+	int srcLeft = inPixmap->bounds.left + dh;
+	int srcTop = inPixmap->bounds.top + dv;
+	int srcBottom = inPixmap->bounds.bottom + dv;
+	int srcRowBytes = inPixmap->rowBytes;
+	int dstRowBytes = inFrameBuffer->rowBytes;
+	const UByte * srcBits = (const UByte *)PixelMapBits(inPixmap);
+	UByte * dstBits = (UByte *)PixelMapBits(inFrameBuffer);
+
+	ULong tile[8];
+	for (int y = top; y < bottom; y += 8)
+	{
+		for (int x = left; x < right; x += 8)
+		{
+			// load the tile; portrait feeds rows bottom-up so the transpose rotates it
+			for (ArrayIndex i = 0; i < 8; ++i)
+			{
+				int row = y + (inIsFlipped ? i : 7 - i);
+				tile[i] = (row >= srcTop && row < srcBottom) ? LoadTileRow(srcBits + (row - srcTop) * srcRowBytes + (x - srcLeft)/2) : 0;
+			}
+			TransposeTile(tile);
+			// tile[j] is now screen column x+j
+			for (ArrayIndex j = 0; j < 8; ++j)
+			{
+				UByte * dst;
+				if (inIsFlipped)
+					dst = dstBits + (fbHeight - 1 - (x + j)) * dstRowBytes + y/2;
+				else
+					dst = dstBits + (x + j) * dstRowBytes + (fbWidth - 8 - y)/2;
+				StoreTileRow(dst, tile[j], inTransferMode);
+			}
+		}
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	Blit a 4-bit pixmap onto the frame buffer.
+	Landscape blits copy whole longs, a row at a time; portrait blits rotate
+	the image in tiles.
+	Args:		inPixmap				the image
+				inSrcBounds			part of the image to use
+				inDstBounds			part of the screen to update
+				inTransferMode		modeCopy or srcOr
+				inFrameBuffer		the landscape frame buffer
+				inOrientation		the screen's orientation
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+BlitFrameBuffer(NativePixelMap * inPixmap, const Rect * inSrcBounds, const Rect * inDstBounds, int inTransferMode, NativePixelMap * inFrameBuffer, int inOrientation)
+{
+	BlitRec	blitParms;
+
+	if (inOrientation == kLandscape || inOrientation == kLandscapeFlip)
+	{
+		// byte-aligned leftmost pixel in image
+		int	srcLeft = (inSrcBounds->left - inPixmap->bounds.left) & ~0x07;
+		// byte-aligned rightmost pixel in image
+		int	srcRight = (inSrcBounds->right - inPixmap->bounds.left + 0x07) & ~0x07;
+		// number of bytes in row to be transferred
+		int	byteWd = (srcRight - srcLeft) * kFrameBufferDepth / 8;
+		// offset to first byte in image
+		int	srcOffset = inPixmap->rowBytes * (inSrcBounds->top - inPixmap->bounds.top) + srcLeft * kFrameBufferDepth / 8;
+		// offset to first byte on screen
+		int	dstOffset = inFrameBuffer->rowBytes * inDstBounds->top + (inDstBounds->left & ~0x07) * kFrameBufferDepth / 8;
+		if (inOrientation != kLandscape)		// ie flipped
+			dstOffset = inFrameBuffer->rowBytes * RectGetHeight(inFrameBuffer->bounds) - 4 - dstOffset; 	// 480*320*4/8-4
+ 
+		blitParms.srcRowOffset = inPixmap->rowBytes - byteWd;
+		blitParms.dstRowOffset = inFrameBuffer->rowBytes - byteWd;
+		blitParms.srcAddr = PixelMapBits(inPixmap) + srcOffset;
+		blitParms.dstAddr = PixelMapBits(inFrameBuffer) + dstOffset;
+		blitParms.mode = inTransferMode;
+		blitParms.numOfRows = inDstBounds->bottom - inDstBounds->top;
+		blitParms.numOfBytes = byteWd;
+		if (inOrientation == kLandscape)
+			BlitLandscape(&blitParms);
+		else
+			BlitLandscapeFlip(&blitParms);
+	}
+	else
+		BlitRotated(inPixmap, inSrcBounds, inDstBounds, inTransferMode, inFrameBuffer, inOrientation == kPortraitFlip);
+}
@@ -0,0 +1,17 @@
+/*
+	File:		FrameBuffer.h
+
+	Contains:	Frame buffer blit declarations.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__FRAMEBUFFER_H)
+#define __FRAMEBUFFER_H 1
+
+#include "QDTypes.h"
+
+extern void		BlitFrameBuffer(NativePixelMap * inPixmap, const Rect * inSrcBounds, const Rect * inDstBounds, int inTransferMode,
+										 NativePixelMap * inFrameBuffer, int inOrientation);
+
+#endif	/* __FRAMEBUFFER_H */
@@ -0,0 +1,485 @@
+/*
+	File:		HeadlessDisplay.cc
+
+	Contains:	Display driver for running without a window.
+
+	Written by:	Newton Research Group.
+*/
+#include "Quartz.h"
+#include "Geometry.h"
+
+#include "HeadlessDisplay.h"
+#include "PNGFile.h"
+#include "ViewFlags.h"
+#include "QDDrawing.h"
+#include "OSErrors.h"
+
+#include <time.h>
+
+
+/* -----------------------------------------------------------------------------
+	S c r e e n   P a r a m e t e r s
+	The same as the CMainDisplayDriver, so frames match what the LCD would show.
+----------------------------------------------------------------------------- */
+
+#define kScreenWidth		480
+#define kScreenHeight	320
+#define kScreenDepth		  4
+#define kScreenDPI		100
+
+
+/* -----------------------------------------------------------------------------
+	D a t a
+----------------------------------------------------------------------------- */
+
+bool							gWantHeadlessDisplay = false;
+CHeadlessDisplayDriver *	gHeadlessDisplay = NULL;
+
+
+/*------------------------------------------------------------------------------
+	Return the host's monotonic clock.
+	Args:		--
+	Return:	microseconds
+------------------------------------------------------------------------------*/
+
+static uint64_t
+HostMicroseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+
+#pragma mark -
+/*------------------------------------------------------------------------------
+	C H e a d l e s s D i s p l a y D r i v e r
+------------------------------------------------------------------------------*/
+
+const CClassInfo *
+CHeadlessDisplayDriver::classInfo(void)
+{
+__asm__ (
+CLASSINFO_BEGIN
+"		.long		0			\n"
+"		.long		1f - .	\n"
+"		.long		2f - .	\n"
+"		.long		3f - .	\n"
+"		.long		4f - .	\n"
+"		.long		5f - .	\n"
+"		.long		__ZN22CHeadlessDisplayDriver6sizeOfEv - 0b	\n"
+"		.long		0			\n"
+"		.long		0			\n"
+"		.long		__ZN22CHeadlessDisplayDriver4makeEv - 0b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver7destroyEv - 0b	\n"
+"		.long		0			\n"
+"		.long		0			\n"
+"		.long		0			\n"
+"		.long		6f - 0b	\n"
+"1:	.asciz	\"CHeadlessDisplayDriver\"	\n"
+"2:	.asciz	\"CScreenDriver\"	\n"
+"3:	.byte		0			\n"
+"		.align	2			\n"
+"4:	.long		0			\n"
+"		.long		__ZN22CHeadlessDisplayDriver9classInfoEv - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver4makeEv - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver7destroyEv - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver11screenSetupEv - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver13getScreenInfoEP10ScreenInfo - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver9powerInitEv - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver7powerOnEv - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver8powerOffEv - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver4blitEP14NativePixelMapP4RectS3_i - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver10doubleBlitEP14NativePixelMapS1_P4RectS3_i - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver10getFeatureEi - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver10setFeatureEii - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver18autoAdjustFeaturesEv - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver13enterIdleModeEv - 4b	\n"
+"		.long		__ZN22CHeadlessDisplayDriver12exitIdleModeEv - 4b	\n"
+CLASSINFO_END
+);
+}
+
+PROTOCOL_IMPL_SOURCE_MACRO(CHeadlessDisplayDriver)
+
+CHeadlessDisplayDriver *
+CHeadlessDisplayDriver::make(void)
+{
+	fPixMap.baseAddr = NULL;
+	fCaptureDir = NULL;
+	fGoldenDir = NULL;
+	fFrameCount = 0;
+	memset(&fTiming, 0, sizeof(fTiming));
+	gHeadlessDisplay = this;
+	return this;
+}
+
+
+void
+CHeadlessDisplayDriver::destroy(void)
+{
+	if (fPixMap.baseAddr)
+		FreePtr(fPixMap.baseAddr);
+	if (gHeadlessDisplay == this)
+		gHeadlessDisplay = NULL;
+}
+
+
+void
+CHeadlessDisplayDriver::screenSetup(void)
+{
+	fOrientation = kPortraitFlip;
+	fContrast = 0;
+	fBacklight = false;
+	allocateFrame();
+}
+
+
+/*------------------------------------------------------------------------------
+	Allocate the frame pixmap to match the screen in its current orientation.
+	Args:		--
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CHeadlessDisplayDriver::allocateFrame(void)
+{
+	ScreenInfo	info;
+	getScreenInfo(&info);
+
+	if (fPixMap.baseAddr)
+		FreePtr(fPixMap.baseAddr);
+	fPixMap.rowBytes = ALIGN(info.width, 8) / 8 * kScreenDepth;
+	SetRect(&fPixMap.bounds, 0, 0, info.width, info.height);
+	fPixMap.pixMapFlags = kPixMapPtr + kScreenDepth;
+	fPixMap.deviceRes.h = info.resolution.h;
+	fPixMap.deviceRes.v = info.resolution.v;
+	fPixMap.grayTable = NULL;
+	fPixMap.baseAddr = NewPtr(fPixMap.rowBytes * info.height);
+	if (fPixMap.baseAddr == NULL)
+		return kOSErrNoMemory;
+	memset(fPixMap.baseAddr, 0, fPixMap.rowBytes * info.height);
+	return noErr;
+}
+
+
+void
+CHeadlessDisplayDriver::getScreenInfo(ScreenInfo * outInfo)
+{
+	if (fOrientation == kLandscape || fOrientation == kLandscapeFlip)
+	{
+		outInfo->width = kScreenWidth;
+		outInfo->height = kScreenHeight;
+	}
+	else
+	{
+		outInfo->height = kScreenWidth;
+		outInfo->width = kScreenHeight;
+	}
+	outInfo->depth = kScreenDepth;
+	outInfo->f0C = 55;
+	outInfo->f14 =
+	outInfo->f18 = 32;
+	outInfo->resolution.h =
+	outInfo->resolution.v = kScreenDPI;
+}
+
+
+void
+CHeadlessDisplayDriver::powerInit(void)
+{ }
+
+void
+CHeadlessDisplayDriver::powerOn(void)
+{ }
+
+void
+CHeadlessDisplayDriver::powerOff(void)
+{ }
+
+
+/*------------------------------------------------------------------------------
+	Blit pixmap image into the frame.
+	The frame is the same way up as the screen, so there is no rotation to do.
+	When source and destination pixels line up within their bytes -- as they do
+	when the image is the screen pixmap -- the update is rounded out to whole
+	bytes, like the hardware blitters; otherwise it is done pixel by pixel.
+	Args:		inPixmap				the image
+				inSrcBounds			part of the image to use
+				inDstBounds			part of the frame to update
+				inTransferMode		modeCopy or srcOr
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CHeadlessDisplayDriver::blit(NativePixelMap * inPixmap, Rect * inSrcBounds, Rect * inDstBounds, int inTransferMode)
+{
+	Rect	dst;
+	if (fPixMap.baseAddr == NULL
+	||  PixelDepth(inPixmap) != kScreenDepth
+	||  !SectRect(inDstBounds, &fPixMap.bounds, &dst))
+		return;
+
+	int	dh = inSrcBounds->left - inDstBounds->left;
+	int	dv = inSrcBounds->top - inDstBounds->top;
+	Rect	src = dst;
+	OffsetRect(&src, dh, dv);
+	Rect	clippedSrc;
+	if (!SectRect(&src, &inPixmap->bounds, &clippedSrc))
+		return;
+	dst = clippedSrc;
+	OffsetRect(&dst, -dh, -dv);
+
+	int	srcBit = (clippedSrc.left - inPixmap->bounds.left) * kScreenDepth;
+	int	dstBit = dst.left * kScreenDepth;
+	int	numOfRows = RectGetHeight(dst);
+	const UByte *	srcRow = (const UByte *)PixelMapBits(inPixmap) + (clippedSrc.top - inPixmap->bounds.top) * inPixmap->rowBytes;
+	UByte *	dstRow = (UByte *)PixelMapBits(&fPixMap) + dst.top * fPixMap.rowBytes;
+
+	if ((srcBit & 7) == (dstBit & 7))
+	{
+		int	numOfBytes = (dstBit + RectGetWidth(dst) * kScreenDepth + 7) / 8 - dstBit / 8;
+		srcRow += srcBit / 8;
+		dstRow += dstBit / 8;
+		for ( ; numOfRows > 0; numOfRows--, srcRow += inPixmap->rowBytes, dstRow += fPixMap.rowBytes)
+		{
+			if (inTransferMode == modeCopy)
+				memmove(dstRow, srcRow, numOfBytes);
+			else /*srcOr*/
+				for (ArrayIndex i = 0; i < numOfBytes; ++i)
+					dstRow[i] |= srcRow[i];
+		}
+	}
+	else
+	{
+		int	numOfPixels = RectGetWidth(dst);
+		for ( ; numOfRows > 0; numOfRows--, srcRow += inPixmap->rowBytes, dstRow += fPixMap.rowBytes)
+		{
+			for (int i = 0, sb = srcBit, db = dstBit; i < numOfPixels; ++i, sb += kScreenDepth, db += kScreenDepth)
+			{
+				UByte	pixel = (srcRow[sb/8] >> (4 - (sb & 7))) & 0x0F;
+				UByte	mask = 0xF0 >> (db & 7);
+				pixel <<= 4 - (db & 7);
+				if (inTransferMode == modeCopy)
+					dstRow[db/8] = (dstRow[db/8] & ~mask) | pixel;
+				else
+					dstRow[db/8] |= pixel;
+			}
+		}
+	}
+	fTiming.pixelsBlitted += RectGetWidth(dst) * RectGetHeight(dst);
+}
+
+
+void
+CHeadlessDisplayDriver::doubleBlit(NativePixelMap * inArg1, NativePixelMap * inPixmap, Rect * inSrcBounds, Rect * inDstBounds, int inTransferMode)
+{ }
+
+
+int
+CHeadlessDisplayDriver::getFeature(int inSelector)
+{
+	switch (inSelector)
+	{
+	case 0:	// contrast
+		return fContrast;
+	case 1:	// more contrast
+		return 1;
+	case 2:	// backlight
+		return fBacklight;
+	case 3:
+		return 0;
+	case 4:	// orientation
+		return fOrientation;
+	case 5:
+		return 10;
+	}
+	return -1;
+}
+
+
+void
+CHeadlessDisplayDriver::setFeature(int inSelector, int inValue)
+{
+	switch (inSelector)
+	{
+	case 0:	// contrast
+		fContrast = MINMAX(-16, inValue, 16);
+		break;
+	case 2:	// backlight
+		fBacklight = inValue;
+		break;
+	case 4:	// orientation
+		if (inValue != fOrientation)
+		{
+			fOrientation = inValue;
+			allocateFrame();
+		}
+		break;
+	}
+}
+
+
+int
+CHeadlessDisplayDriver::autoAdjustFeatures(void)
+{ return 0; }
+
+void
+CHeadlessDisplayDriver::enterIdleMode(void)
+{ }
+
+void
+CHeadlessDisplayDriver::exitIdleMode(void)
+{ }
+
+
+#pragma mark Frames
+/*------------------------------------------------------------------------------
+	Set where frames are to be written, and where their golden counterparts
+	are to be found. Frame n is frameNNNNN.png in either directory.
+	Args:		inCaptureDir		NULL => don't write frames
+				inGoldenDir			NULL => don't compare frames
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CHeadlessDisplayDriver::setFrameDirectories(const char * inCaptureDir, const char * inGoldenDir)
+{
+	fCaptureDir = inCaptureDir;
+	fGoldenDir = inGoldenDir;
+}
+
+
+/*------------------------------------------------------------------------------
+	Time a phase of the frame in progress.
+	A phase may be timed more than once per frame; the times accumulate.
+	Args:		inPhase
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CHeadlessDisplayDriver::startTiming(EFramePhase inPhase)
+{
+	fPhaseStart[inPhase] = HostMicroseconds();
+}
+
+
+void
+CHeadlessDisplayDriver::stopTiming(EFramePhase inPhase)
+{
+	fTiming.time[inPhase] += HostMicroseconds() - fPhaseStart[inPhase];
+}
+
+
+/*------------------------------------------------------------------------------
+	Finish the frame in progress: capture it and compare it with its golden
+	frame if required, and log its timing.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CHeadlessDisplayDriver::endFrame(void)
+{
+	char	path[256];
+
+	fTiming.frame = fFrameCount;
+	fTiming.pixelsDiffering = kIndexNotFound;
+	if (fCaptureDir)
+	{
+		snprintf(path, sizeof(path), "%s/frame%05u.png", fCaptureDir, (unsigned)fFrameCount);
+		writeFrame(path);
+	}
+	if (fGoldenDir)
+	{
+		ULong	numOfPixels;
+		Rect	bounds;
+		snprintf(path, sizeof(path), "%s/frame%05u.png", fGoldenDir, (unsigned)fFrameCount);
+		if (diffFrame(path, &numOfPixels, &bounds) == noErr)
+			fTiming.pixelsDiffering = numOfPixels;
+	}
+	fTimingLog[fFrameCount % kFrameTimingLogSize] = fTiming;
+	fFrameCount++;
+	memset(&fTiming, 0, sizeof(fTiming));
+}
+
+
+/*------------------------------------------------------------------------------
+	Print the timings of the most recent frames, and a summary of them.
+	Args:		inFile				where to print them
+	Return:	number of frames that differ from their golden frames
+------------------------------------------------------------------------------*/
+
+ArrayIndex
+CHeadlessDisplayDriver::reportTimings(FILE * inFile)
+{
+	static const char * kPhaseName[kNumOfFramePhases] = { "update", "draw", "blit" };
+	uint64_t		total[kNumOfFramePhases];
+	ULong			longest[kNumOfFramePhases];
+	ArrayIndex	numOfMismatches = 0;
+	ArrayIndex	first = (fFrameCount > kFrameTimingLogSize) ? fFrameCount - kFrameTimingLogSize : 0;
+
+	memset(total, 0, sizeof(total));
+	memset(longest, 0, sizeof(longest));
+	fprintf(inFile, "frame   update     draw     blit   pixels  differing\n");
+	for (ArrayIndex i = first; i < fFrameCount; ++i)
+	{
+		FrameTiming *	timing = &fTimingLog[i % kFrameTimingLogSize];
+		fprintf(inFile, "%5u %8u %8u %8u %8u", (unsigned)timing->frame, timing->time[kFrameUpdate], timing->time[kFrameDraw], timing->time[kFrameBlit], timing->pixelsBlitted);
+		if (timing->pixelsDiffering != kIndexNotFound)
+		{
+			fprintf(inFile, " %10u", timing->pixelsDiffering);
+			if (timing->pixelsDiffering != 0)
+				numOfMismatches++;
+		}
+		fputc('\n', inFile);
+		for (ArrayIndex phase = 0; phase < kNumOfFramePhases; ++phase)
+		{
+			total[phase] += timing->time[phase];
+			if (timing->time[phase] > longest[phase])
+				longest[phase] = timing->time[phase];
+		}
+	}
+	if (fFrameCount > first)
+	{
+		for (ArrayIndex phase = 0; phase < kNumOfFramePhases; ++phase)
+			fprintf(inFile, "%s: mean %lluus, max %uus\n", kPhaseName[phase], (unsigned long long)(total[phase] / (fFrameCount - first)), longest[phase]);
+	}
+	if (fGoldenDir)
+		fprintf(inFile, "%u of %u frames differ from golden\n", (unsigned)numOfMismatches, (unsigned)(fFrameCount - first));
+	return numOfMismatches;
+}
+
+
+/*------------------------------------------------------------------------------
+	Write the frame to a PNG file.
+	Args:		inPath				file to write
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CHeadlessDisplayDriver::writeFrame(const char * inPath)
+{
+	if (fPixMap.baseAddr == NULL)
+		return kOSErrNoMemory;
+	return WritePNG(&fPixMap, inPath);
+}
+
+
+/*------------------------------------------------------------------------------
+	Compare the frame with a golden frame.
+	Args:		inGoldenPath		PNG file written by writeFrame
+				outNumOfPixels		number of pixels that differ
+				outBounds			bounds of the pixels that differ
+	Return:	error code
+				kOSErrItemNotFound => no such golden frame
+				kOSErrBadParameters => golden frame is not the same shape
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CHeadlessDisplayDriver::diffFrame(const char * inGoldenPath, ULong * outNumOfPixels, Rect * outBounds)
+{
+	if (fPixMap.baseAddr == NULL)
+		return kOSErrNoMemory;
+	return DiffPNG(&fPixMap, inGoldenPath, outNumOfPixels, outBounds);
+}
@@ -0,0 +1,121 @@
+/*
+	File:		HeadlessDisplay.h
+
+	Contains:	Display driver for running without a window.
+					Frames are kept in memory, and can be written to PNG files or
+					compared with golden frames, so that drawing can be timed and
+					checked for regressions without anyone watching.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__HEADLESSDISPLAY_H)
+#define __HEADLESSDISPLAY_H 1
+
+#include "ScreenDriver.h"
+#include <stdio.h>
+
+
+/*------------------------------------------------------------------------------
+	F r a m e   T i m i n g
+	A frame is one pass of CRootView::update that finds something to update.
+	Its phases are timed by the host's monotonic clock, not the Newton clock,
+	so that timings mean something even when the Newton clock is virtual.
+------------------------------------------------------------------------------*/
+
+enum EFramePhase
+{
+	kFrameUpdate,			// the whole of CRootView::update
+	kFrameDraw,				// drawing the invalid views
+	kFrameBlit,				// blitting the damage to the display
+	kNumOfFramePhases
+};
+
+struct FrameTiming
+{
+	ArrayIndex	frame;
+	ULong			time[kNumOfFramePhases];	// microseconds
+	ULong			pixelsBlitted;
+	ULong			pixelsDiffering;				// from the golden frame; kIndexNotFound => no golden frame
+};
+
+#define kFrameTimingLogSize	1024
+
+
+/*------------------------------------------------------------------------------
+	C H e a d l e s s D i s p l a y D r i v e r
+	Keeps the display in a pixmap of its own, the same shape as the screen.
+	Register it and set gWantHeadlessDisplay before the screen is initialised
+	to have InitScreen() make it in preference to the CMainDisplayDriver.
+------------------------------------------------------------------------------*/
+
+PROTOCOL CHeadlessDisplayDriver : public CScreenDriver
+{
+public:
+	PROTOCOL_IMPL_HEADER_MACRO(CHeadlessDisplayDriver)
+	CAPABILITIES( "four" "" )
+
+	CHeadlessDisplayDriver *	make(void);
+	void			destroy(void);
+
+	void	screenSetup(void);
+	void	getScreenInfo(ScreenInfo * outInfo);
+
+	void	powerInit(void);
+	void	powerOn(void);
+	void	powerOff(void);
+
+	void	blit(NativePixelMap * inPixmap, Rect * inSrcBounds, Rect * inDstBounds, int inTransferMode);
+	void	doubleBlit(NativePixelMap *, NativePixelMap * inPixmap, Rect * inSrcBounds, Rect * inDstBounds, int inTransferMode);
+
+	int	getFeature(int inSelector);
+	void	setFeature(int inSelector, int inValue);
+	int	autoAdjustFeatures(void);
+
+	void	enterIdleMode(void);
+	void	exitIdleMode(void);
+
+// not part of the protocol
+	NativePixelMap *	frame(void);
+	ArrayIndex			frameCount(void) const;
+	void			setFrameDirectories(const char * inCaptureDir, const char * inGoldenDir);
+
+	void			startTiming(EFramePhase inPhase);
+	void			stopTiming(EFramePhase inPhase);
+	void			endFrame(void);
+	ArrayIndex	reportTimings(FILE * inFile);
+
+	NewtonErr	writeFrame(const char * inPath);
+	NewtonErr	diffFrame(const char * inGoldenPath, ULong * outNumOfPixels, Rect * outBounds);
+
+private:
+	NewtonErr	allocateFrame(void);
+
+	NativePixelMap	fPixMap;
+	int				fOrientation;
+	long				fContrast;
+	bool				fBacklight;
+	const char *	fCaptureDir;
+	const char *	fGoldenDir;
+	uint64_t			fPhaseStart[kNumOfFramePhases];
+	FrameTiming		fTiming;							// of the frame in progress
+	FrameTiming		fTimingLog[kFrameTimingLogSize];	// circular
+	ArrayIndex		fFrameCount;
+};
+
+inline NativePixelMap *	CHeadlessDisplayDriver::frame(void)  { return &fPixMap; }
+inline ArrayIndex		CHeadlessDisplayDriver::frameCount(void) const  { return fFrameCount; }
+
+
+/*------------------------------------------------------------------------------
+	P u b l i c   I n t e r f a c e
+------------------------------------------------------------------------------*/
+
+extern bool							gWantHeadlessDisplay;
+extern CHeadlessDisplayDriver *	gHeadlessDisplay;	// NULL => the display is not headless
+
+inline void		StartFrameTiming(EFramePhase inPhase)  { if (gHeadlessDisplay) gHeadlessDisplay->startTiming(inPhase); }
+inline void		StopFrameTiming(EFramePhase inPhase)  { if (gHeadlessDisplay) gHeadlessDisplay->stopTiming(inPhase); }
+inline void		EndFrame(void)  { if (gHeadlessDisplay) gHeadlessDisplay->endFrame(); }
+
+#endif	/* __HEADLESSDISPLAY_H */
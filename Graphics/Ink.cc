@@ -8,7 +8,7 @@
 
 #include "Ink.h"
 #include "Geometry.h"
-#include "CoreGraphics/CGGeometry.h"
+#include "Quartz.h"
 #include "RSSymbols.h"
 
 
@@ -22,8 +22,8 @@ void		CSExpandGroup(CSStrokeHeader * inData, ULong inArg2, float inArg3, float i
 void		CSRawExpandGroup(CSStrokeHeader * inData, ULong inArg2, float inArg3, float inArg4, float inArg5, float inArg6);
 void		CSMakePathsGroup(CSStrokeHeader * inData, float inX, float inY);
 void		CSMakePathsGroupInRect(CSStrokeHeader * inData, float inX, float inY, CGRect inRect);
-void		CSDraw(CSStrokeHeader * inData, float inPenSize, CGPoint inLocation, bool inLive);
-void		CSDrawInRect(CSStrokeHeader * inData, float inPenSize, CGSize inOriginalSize, CGRect inDisplayRect, bool inLive);
+void		CSDraw(CSStrokeHeader * inData, size_t inSize, float inPenSize, CGPoint inLocation, bool inLive);
+void		CSDrawInRect(CSStrokeHeader * inData, size_t inSize, float inPenSize, CGSize inOriginalSize, CGRect inDisplayRect, bool inLive);
 
 
 extern "C" {
@@ -360,7 +360,7 @@ void
 InkDraw(RefArg inkObj, size_t inPenSize, long inX, long inY, bool inLive)
 {
 #if !defined(forNTK)
-	CSDraw((CSStrokeHeader *)BinaryData(inkObj), inPenSize, CGPointMake(inX, inY), inLive);
+	CSDraw((CSStrokeHeader *)BinaryData(inkObj), Length(inkObj), inPenSize, CGPointMake(inX, inY), inLive);
 #endif
 }
 
@@ -370,7 +370,7 @@ void
 InkDrawInRect(RefArg inkObj, size_t inPenSize, Rect * inOriginalBounds, Rect * inBounds, bool inLive)
 {
 #if !defined(forNTK)
-	CSDrawInRect((CSStrokeHeader *)BinaryData(inkObj), inPenSize, CGSizeMake(RectGetWidth(*inOriginalBounds), RectGetHeight(*inOriginalBounds)), MakeCGRect(*inBounds), inLive);
+	CSDrawInRect((CSStrokeHeader *)BinaryData(inkObj), Length(inkObj), inPenSize, CGSizeMake(RectGetWidth(*inOriginalBounds), RectGetHeight(*inOriginalBounds)), MakeCGRect(*inBounds), inLive);
 #endif
 }
 
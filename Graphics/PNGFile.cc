@@ -0,0 +1,338 @@
+/*
+	File:		PNGFile.cc
+
+	Contains:	Greyscale PNG files of pixel maps.
+					Split out of HeadlessDisplay.cc so the files can be written,
+					read and compared on their own.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "PNGFile.h"
+#include "NewtonWidgets.h"
+#include "Geometry.h"
+#include "NewtonMemory.h"
+#include "OSErrors.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/*------------------------------------------------------------------------------
+	P N G   F i l e s
+	Frames are written as greyscale PNGs at the pixmap's own depth. The image
+	data is not compressed -- deflate's stored blocks are all we need for a
+	byte-exact copy -- and only such PNGs can be read back as golden frames.
+	PNG greys run from black, Newton pixels from white, so every bit is
+	inverted on the way through.
+------------------------------------------------------------------------------*/
+
+static const UByte	kPNGSignature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+#define kMaxStoredBlockSize	65535
+
+static ULong	gCRCTable[256];
+
+
+static ULong
+PNGCRC(ULong inCRC, const UByte * inData, size_t inSize)
+{
+	if (gCRCTable[1] == 0)
+	{
+		for (ArrayIndex i = 0; i < 256; ++i)
+		{
+			ULong c = i;
+			for (ArrayIndex bit = 0; bit < 8; ++bit)
+				c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			gCRCTable[i] = c;
+		}
+	}
+	inCRC = ~inCRC;
+	for ( ; inSize > 0; inSize--)
+		inCRC = gCRCTable[(inCRC ^ *inData++) & 0xFF] ^ (inCRC >> 8);
+	return ~inCRC;
+}
+
+
+static inline void
+PutLong(UByte * outData, ULong inValue)
+{
+	outData[0] = inValue >> 24;
+	outData[1] = inValue >> 16;
+	outData[2] = inValue >> 8;
+	outData[3] = inValue;
+}
+
+
+static inline ULong
+GetLong(const UByte * inData)
+{
+	return (inData[0] << 24) | (inData[1] << 16) | (inData[2] << 8) | inData[3];
+}
+
+
+static bool
+WritePNGChunk(FILE * inFile, const char * inType, const UByte * inData, size_t inSize)
+{
+	UByte buf[4];
+	ULong crc = PNGCRC(0, (const UByte *)inType, 4);
+	crc = PNGCRC(crc, inData, inSize);
+	PutLong(buf, inSize);
+	if (fwrite(buf, 4, 1, inFile) != 1
+	||  fwrite(inType, 4, 1, inFile) != 1
+	||  (inSize > 0 && fwrite(inData, inSize, 1, inFile) != 1))
+		return false;
+	PutLong(buf, crc);
+	return fwrite(buf, 4, 1, inFile) == 1;
+}
+
+
+/*------------------------------------------------------------------------------
+	Write a pixmap to a PNG file.
+	Args:		inPixmap				the image
+				inPath				file to write
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+WritePNG(const NativePixelMap * inPixmap, const char * inPath)
+{
+	NewtonErr	err = noErr;
+	FILE *		file = NULL;
+	UByte *		zdata = NULL;
+
+	XTRY
+	{
+		size_t	width = RectGetWidth(inPixmap->bounds);
+		size_t	height = RectGetHeight(inPixmap->bounds);
+		size_t	depth = PixelDepth(inPixmap);
+		size_t	rowSize = 1 + (width * depth + 7) / 8;		// filter type byte + pixels
+		size_t	rawSize = rowSize * height;
+		size_t	numOfBlocks = (rawSize + kMaxStoredBlockSize - 1) / kMaxStoredBlockSize;
+
+		// zlib header + stored blocks + adler32
+		zdata = (UByte *)NewPtr(2 + numOfBlocks * 5 + rawSize + 4);
+		XFAILIF(zdata == NULL, err = kOSErrNoMemory;)
+		UByte *	p = zdata;
+		*p++ = 0x78;
+		*p++ = 0x01;
+
+		ULong		adlerA = 1, adlerB = 0;
+		size_t	blockLeft = 0;
+		size_t	rawLeft = rawSize;
+		const UByte *	row = (const UByte *)PixelMapBits(inPixmap);
+		for (ArrayIndex y = 0; y < height; ++y, row += inPixmap->rowBytes)
+		{
+			for (ArrayIndex x = 0; x < rowSize; ++x)
+			{
+				if (blockLeft == 0)
+				{
+					blockLeft = MIN(rawLeft, kMaxStoredBlockSize);
+					rawLeft -= blockLeft;
+					*p++ = (rawLeft == 0);		// BFINAL, BTYPE = stored
+					*p++ = blockLeft;
+					*p++ = blockLeft >> 8;
+					*p++ = ~blockLeft;
+					*p++ = ~blockLeft >> 8;
+				}
+				UByte	pixels = (x == 0) ? 0 : ~row[x-1];
+				*p++ = pixels;
+				blockLeft--;
+				adlerA = (adlerA + pixels) % 65521;
+				adlerB = (adlerB + adlerA) % 65521;
+			}
+		}
+		PutLong(p, (adlerB << 16) | adlerA);
+		p += 4;
+
+		UByte	header[13];
+		PutLong(header, width);
+		PutLong(header+4, height);
+		header[8] = depth;
+		header[9] = 0;		// greyscale
+		header[10] = 0;	// deflate
+		header[11] = 0;	// adaptive filtering
+		header[12] = 0;	// no interlace
+
+		file = fopen(inPath, "wb");
+		XFAILIF(file == NULL, err = kOSErrBadParameters;)
+		XFAILIF(fwrite(kPNGSignature, sizeof(kPNGSignature), 1, file) != 1
+			  || !WritePNGChunk(file, "IHDR", header, sizeof(header))
+			  || !WritePNGChunk(file, "IDAT", zdata, p - zdata)
+			  || !WritePNGChunk(file, "IEND", NULL, 0), err = kOSErrBadParameters;)
+	}
+	XENDTRY;
+
+	if (file)
+		fclose(file);
+	if (zdata)
+		FreePtr((Ptr)zdata);
+	return err;
+}
+
+
+/*------------------------------------------------------------------------------
+	Read a PNG file written by WritePNG.
+	Args:		inPath				file to read
+				outWidth				its dimensions
+				outHeight
+				outDepth
+	Return:	pixels, filter bytes and all; caller must FreePtr()
+				NULL => could not read it
+------------------------------------------------------------------------------*/
+
+UByte *
+ReadPNG(const char * inPath, ULong * outWidth, ULong * outHeight, ULong * outDepth)
+{
+	FILE *	file = NULL;
+	UByte *	fileData = NULL;
+	UByte *	raw = NULL;
+	bool		isOK = false;
+
+	XTRY
+	{
+		file = fopen(inPath, "rb");
+		XFAIL(file == NULL)
+		fseek(file, 0, SEEK_END);
+		long	fileSize = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		XFAIL(fileSize < (long)sizeof(kPNGSignature))
+		fileData = (UByte *)NewPtr(fileSize);
+		XFAIL(fileData == NULL)
+		XFAIL(fread(fileData, fileSize, 1, file) != 1)
+		XFAIL(memcmp(fileData, kPNGSignature, sizeof(kPNGSignature)) != 0)
+
+		// gather the IDAT chunks together, in place
+		UByte *	p = fileData + sizeof(kPNGSignature);
+		UByte *	limit = fileData + fileSize;
+		UByte *	zdata = fileData;
+		size_t	zsize = 0;
+		bool		hasHeader = false;
+		bool		hasEnd = false;
+		while (p + 12 <= limit)
+		{
+			size_t	chunkSize = GetLong(p);
+			UByte *	chunkData = p + 8;
+			// a truncated or damaged golden frame is not a frame that differs
+			if (chunkSize > (size_t)(limit - chunkData) - 4
+			||  PNGCRC(0, p+4, chunkSize + 4) != GetLong(chunkData + chunkSize))
+				break;
+			if (memcmp(p+4, "IHDR", 4) == 0 && chunkSize == 13)
+			{
+				*outWidth = GetLong(chunkData);
+				*outHeight = GetLong(chunkData+4);
+				*outDepth = chunkData[8];
+				hasHeader = (*outDepth == 1 || *outDepth == 2 || *outDepth == 4 || *outDepth == 8)
+						   && chunkData[9] == 0 && chunkData[12] == 0;
+			}
+			else if (memcmp(p+4, "IEND", 4) == 0)
+			{
+				hasEnd = true;
+				break;
+			}
+			else if (memcmp(p+4, "IDAT", 4) == 0)
+			{
+				memmove(zdata + zsize, chunkData, chunkSize);
+				zsize += chunkSize;
+			}
+			p = chunkData + chunkSize + 4;
+		}
+		XFAIL(!hasHeader || !hasEnd || zsize < 6 || (zdata[0] & 0x0F) != 8)
+
+		// unpack the stored blocks
+		size_t	rawSize = (1 + (*outWidth * *outDepth + 7) / 8) * *outHeight;
+		raw = (UByte *)NewPtr(rawSize);
+		XFAIL(raw == NULL)
+		size_t	rawIndex = 0;
+		UByte *	zp = zdata + 2;
+		UByte *	zlimit = zdata + zsize - 4;
+		bool		isFinal = false;
+		while (!isFinal && zp + 5 <= zlimit)
+		{
+			isFinal = (zp[0] & 1);
+			if ((zp[0] & 0x06) != 0)				// not a stored block
+				break;
+			size_t	blockSize = zp[1] | (zp[2] << 8);
+			zp += 5;
+			if (blockSize > (size_t)(zlimit - zp) || blockSize > rawSize - rawIndex)
+				break;
+			memmove(raw + rawIndex, zp, blockSize);
+			rawIndex += blockSize;
+			zp += blockSize;
+		}
+		XFAIL(!isFinal || rawIndex != rawSize)
+		isOK = true;
+	}
+	XENDTRY;
+
+	if (file)
+		fclose(file);
+	if (fileData)
+		FreePtr((Ptr)fileData);
+	if (!isOK && raw)
+		FreePtr((Ptr)raw), raw = NULL;
+	return raw;
+}
+
+
+/*------------------------------------------------------------------------------
+	Compare a pixmap with a PNG file written by WritePNG.
+	Args:		inPixmap				the image
+				inPath				file to compare it with
+				outNumOfPixels		number of pixels that differ
+				outBounds			bounds of the pixels that differ
+	Return:	error code
+				kOSErrItemNotFound => no such file
+				kOSErrBadParameters => file is not the same shape
+------------------------------------------------------------------------------*/
+
+NewtonErr
+DiffPNG(const NativePixelMap * inPixmap, const char * inPath, ULong * outNumOfPixels, Rect * outBounds)
+{
+	ULong		width, height, depth;
+	UByte *	golden = ReadPNG(inPath, &width, &height, &depth);
+	if (golden == NULL)
+		return kOSErrItemNotFound;
+
+	NewtonErr	err = noErr;
+	if (width != RectGetWidth(inPixmap->bounds) || height != RectGetHeight(inPixmap->bounds) || depth != PixelDepth(inPixmap))
+		err = kOSErrBadParameters;
+	else
+	{
+		ULong	numOfPixels = 0;
+		size_t	rowSize = 1 + (width * depth + 7) / 8;
+		UByte	pixelMask = 0xFF << (8 - depth);		// leftmost pixel in the high bits
+		SetRect(outBounds, width, height, 0, 0);
+		for (ArrayIndex y = 0; y < height; ++y)
+		{
+			const UByte *	goldenRow = golden + y * rowSize + 1;
+			const UByte *	row = (const UByte *)PixelMapBits(inPixmap) + y * inPixmap->rowBytes;
+			for (ArrayIndex i = 0; i < rowSize - 1; ++i)
+			{
+				UByte	diff = row[i] ^ (UByte)~goldenRow[i];
+				if (diff != 0)
+				{
+					// each differing pixel's worth of bits is a differing pixel
+					for (ArrayIndex bit = 0; bit < 8; bit += depth)
+					{
+						if (diff & (pixelMask >> bit))
+						{
+							int	x = (i * 8 + bit) / depth;
+							if (x >= (int)width)
+								break;
+							numOfPixels++;
+							if (x < outBounds->left)		outBounds->left = x;
+							if (x >= outBounds->right)		outBounds->right = x + 1;
+							if ((int)y < outBounds->top)	outBounds->top = y;
+							outBounds->bottom = y + 1;
+						}
+					}
+				}
+			}
+		}
+		if (numOfPixels == 0)
+			SetRect(outBounds, 0, 0, 0, 0);
+		*outNumOfPixels = numOfPixels;
+	}
+	FreePtr((Ptr)golden);
+	return err;
+}
@@ -0,0 +1,25 @@
+/*
+	File:		PNGFile.h
+
+	Contains:	Greyscale PNG files of pixel maps.
+					For the headless display's frames and golden frames.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__PNGFILE_H)
+#define __PNGFILE_H 1
+
+#include "QDTypes.h"
+
+/*------------------------------------------------------------------------------
+	P u b l i c   I n t e r f a c e
+	Files are greyscale at the pixmap's own depth, with the image data in
+	deflate's stored blocks; ReadPNG reads only such files.
+------------------------------------------------------------------------------*/
+
+extern NewtonErr	WritePNG(const NativePixelMap * inPixmap, const char * inPath);
+extern UByte *		ReadPNG(const char * inPath, ULong * outWidth, ULong * outHeight, ULong * outDepth);
+extern NewtonErr	DiffPNG(const NativePixelMap * inPixmap, const char * inPath, ULong * outNumOfPixels, Rect * outBounds);
+
+#endif	/* __PNGFILE_H */
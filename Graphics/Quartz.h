@@ -42,6 +42,9 @@
 		Patterns in the QD world were in fact used as colours. We now use CGColorRef.
 		Text..!
 	We don’t need the ScreenUpdateTask.
+
+	Where there is no CoreGraphics (forSoftQuartz) SoftQuartz.h provides the subset of it we use,
+	drawing into the screen PixelMap; the ScreenUpdateTask then does blit it to the hardware.
 */
 
 #if !defined(__QUARTZ_H)
@@ -49,7 +52,15 @@
 
 #include "QDTypes.h"
 
+#if !defined(__APPLE__) && !defined(forSoftQuartz)
+#define forSoftQuartz 1
+#endif
+
+#if defined(forSoftQuartz)
+#include "SoftQuartz.h"
+#else
 #include <CoreGraphics/CoreGraphics.h>
+#endif
 
 
 extern CGContextRef	quartz;
@@ -164,14 +164,20 @@ CBaseRegion::intersects(const Rect * inRect) const
 CBaseRegion &
 CBaseRegion::setRegion(const CBaseRegion& inRgn)
 {
+	if (this == &inRgn)
+		return *this;
+
+	// keep our rect list if it's big enough -- views reset their regions on every layout
+	if (inRgn.count > allocCount || rect == NULL) {
+		if (rect)
+			delete[] rect;
+		allocCount = MAX(inRgn.count, kInitialCount);
+		rect = new Rect[allocCount];
+	}
 	extent = inRgn.extent;
 	count = inRgn.count;
-	allocCount = inRgn.allocCount;
-
-	if (rect)
-		delete[] rect;
-	rect = new Rect[allocCount];
-	memcpy(rect, inRgn.rect, count*sizeof(Rect));
+	if (count > 0)
+		memcpy(rect, inRgn.rect, count*sizeof(Rect));
 
 	return *this;
 }
@@ -208,13 +214,6 @@ CBaseRegion::unionRegion(const CBaseRegion& inRgn)
 	}
 
 	combine(inRgn, opUnion);
-
-	// Update extent
-	extent.top = MIN(extent.top, inRgn.extent.top);
-	extent.left = MIN(extent.left, inRgn.extent.left);
-	extent.bottom = MAX(extent.bottom, inRgn.extent.bottom);
-	extent.right = MAX(extent.right, inRgn.extent.right);
-
 	return *this;
 }
 
@@ -232,7 +231,6 @@ CBaseRegion::diffRegion(const CBaseRegion& inRgn)
 	// trivial rejection
 	if (!isEmpty() && !inRgn.isEmpty() && RectsOverlap(&extent, &inRgn.extent)) {
 		combine(inRgn, opDiff);
-		updateExtent();
 	}
 	return *this;
 }
@@ -250,7 +248,6 @@ CBaseRegion::sectRegion(const CBaseRegion& inRgn)
 	// trivial rejection
 	if (!isEmpty() && !inRgn.isEmpty() && RectsOverlap(&extent, &inRgn.extent)) {
 		combine(inRgn, opSect);
-		updateExtent();
 	} else {
 		setEmpty();
 	}
@@ -259,486 +256,306 @@ CBaseRegion::sectRegion(const CBaseRegion& inRgn)
 
 
 /* -----------------------------------------------------------------------------
-	Combine our region with another in some way.
-	Args:		inRgn			another region
-				inSelector	how to combine them
-	Return:	--
+	R e g i o n   A r i t h m e t i c
+	A region is a list of rects sorted into bands: every rect in a band has
+	the same top and bottom, bands are sorted top to bottom, the rects in a
+	band left to right, and no two rects in a band touch. Adjacent bands with
+	the same spans are coalesced.
+	combine() sweeps down both regions a band at a time, merging the spans of
+	whichever bands cover each stretch of y.
 ----------------------------------------------------------------------------- */
-ArrayIndex gRectCount = 0;
-ArrayIndex gRectAllocCount = 0;
-Rect * gRect = NULL;
-
-void
-CBaseRegion::checkMemory(Rect * inRects, ArrayIndex inCount)
-{
-	if (inRects == NULL) {
-		if (inCount > gRectAllocCount) {
-			gRectAllocCount = inCount * 2;
-			Rect * newList = new Rect[gRectAllocCount];
-			if (gRectCount > 0)
-				memcpy(newList, gRect, gRectCount*sizeof(Rect));
-			if (gRect)
-				delete[] gRect;
-			gRect = newList;
-		}
-	} else {
-		if (inCount > allocCount) {
-			allocCount = inCount * 2;
-			Rect * newList = new Rect[allocCount];
-			if (count > 0)
-				memcpy(newList, rect, count*sizeof(Rect));
-			if (rect)
-				delete[] rect;
-			rect = newList;
-		}
-	}
-}
 
+/* -----------------------------------------------------------------------------
+	Scratch space for the result of a combine().
+	An operation works out up front how many rects it could possibly produce,
+	so the arena is sized once and never reallocated while bands are being
+	built. The memory is kept for the next operation.
+	Each thread has its own arena, so regions can be combined on any task.
+	An operation that finds its thread's arena in use -- one that started
+	while another was under way -- gets a list of its own instead.
+----------------------------------------------------------------------------- */
 
-void
-CBaseRegion::combine(const CBaseRegion& inRgn, int inSelector)
+struct RegionArena
 {
-//static const char * ops[4] = { "<OUCH!>", "union", "diff", "sect" };
-//printf("CBaseRegion::combine(%s)\n", ops[inSelector]);
-//dump("this"); inRgn.dump("with");
-	// lock access to gRect
-	int r1 = 0, r1End = count;
-	int r2 = 0, r2End = inRgn.count;
-	gRectCount = 0;
-
-	int yTop = 0, yBottom = extent.top < inRgn.extent.top ? extent.top : inRgn.extent.top;
-	int currentBand, previousBand = 0;
-	int r1BandEnd, r2BandEnd;
-	int top, bottom;
-
-	// Main loop
-	do {
-		currentBand = gRectCount;
-
-		// Find end of the current r1 band (same top)
-		for (r1BandEnd = r1 + 1; r1BandEnd != r1End && rect[r1BandEnd].top == rect[r1].top; ++r1BandEnd) {
-		  ;
-		}
-		// Find end of the current r2 band
-		for (r2BandEnd = r2 + 1; r2BandEnd != r2End && rect[r2BandEnd].top == rect[r2].top; ++r2BandEnd) {
-		  ;
-		}
+	Rect *		rect;
+	ArrayIndex	allocCount;
+	bool			isInUse;
 
-		// First handle non-intersection band if any
-		if (rect[r1].top < inRgn.rect[r2].top) {
-			top    = MAX(rect[r1].top,    yBottom);
-			bottom = MIN(rect[r1].bottom, inRgn.rect[r2].top);
-
-			if (top != bottom) {
-				nonOverlap1(rect, r1, r1BandEnd, top, bottom, inSelector);
-			}
-			yTop = inRgn.rect[r2].top;
-		} else if (inRgn.rect[r2].top < rect[r1].top) {
-			top    = MAX(inRgn.rect[r2].top,    yBottom);
-			bottom = MIN(inRgn.rect[r2].bottom, rect[r1].top);
-
-			if (top != bottom) {
-				nonOverlap2 (inRgn.rect, r2, r2BandEnd, top, bottom, inSelector);
-			}
-			yTop = rect[r1].top;
-		} else {
-			yTop = rect[r1].top;
-		}
+					~RegionArena()	{ if (rect) delete[] rect; }
+};
 
-		// Then coalesce if possible
-		if (gRectCount != currentBand) {
-			previousBand = coalesceBands(previousBand, currentBand);
-		}
-		currentBand = gRectCount;
+static thread_local RegionArena tArena = { NULL, 0, false };
 
-		// Check if this is an intersecting band
-		yBottom = MIN(rect[r1].bottom, inRgn.rect[r2].bottom);
-		if (yBottom > yTop) {
-			overlap(rect, r1, r1BandEnd, inRgn.rect, r2, r2BandEnd, yTop, yBottom, inSelector);
-		}
-		// Coalesce again
-		if (gRectCount != currentBand) {
-		  previousBand = coalesceBands(previousBand, currentBand);
-		}
+static Rect *
+ArenaReserve(ArrayIndex inCount)
+{
+	if (tArena.isInUse) {
+		Rect * list = new Rect[MAX(inCount, 1)];
+		if (list == NULL)
+			OutOfMemory();
+		return list;
+	}
+	if (inCount > tArena.allocCount) {
+		ArrayIndex newCount = MAX(inCount, 2*tArena.allocCount);
+		Rect * newList = new Rect[newCount];
+		if (newList == NULL)
+			OutOfMemory();
+		if (tArena.rect)
+			delete[] tArena.rect;
+		tArena.rect = newList;
+		tArena.allocCount = newCount;
+	}
+	tArena.isInUse = true;
+	return tArena.rect;
+}
 
-		// If we're done with a band, skip forward in the region to the next band
-		if (rect[r1].bottom == yBottom) r1 = r1BandEnd;
-		if (inRgn.rect[r2].bottom == yBottom) r2 = r2BandEnd;
+static void
+ArenaRelease(Rect * inList)
+{
+	if (tArena.isInUse && inList == tArena.rect)
+		tArena.isInUse = false;
+	else
+		delete[] inList;
+}
 
-	} while (r1 != r1End && r2 != r2End);
 
-	currentBand = gRectCount;
+/* -----------------------------------------------------------------------------
+	Cursor over the bands of one region during the sweep.
+----------------------------------------------------------------------------- */
 
-	//
-	// Deal with whichever region still has rectangles left
-	//
-	if (r1 != r1End) {
-		do {
-			for (r1BandEnd = r1; r1BandEnd < r1End && rect[r1BandEnd].top == rect[r1].top; ++r1BandEnd) {
-			  ;
-			}
-			top = MAX(rect[r1].top, yBottom);
-			bottom = rect[r1].bottom;
-		  
-			nonOverlap1(rect, r1, r1BandEnd, top, bottom, inSelector);
-			r1 = r1BandEnd;
-		  
-		} while (r1 != r1End);
-	} else if (r2 != r2End) {
-		do {
-			for (r2BandEnd = r2; r2BandEnd < r2End && rect[r2BandEnd].top == rect[r2].top; ++r2BandEnd) {
-			  ;
-			}
+struct BandCursor
+{
+	const Rect *	r;			// first rect of the current band
+	const Rect *	bandEnd;
+	const Rect *	rEnd;
+};
 
-		  top = MAX(inRgn.rect[r2].top, yBottom);
-		  bottom = inRgn.rect[r2].bottom;
-		  
-		  nonOverlap2(inRgn.rect, r2, r2BandEnd, top, bottom, inSelector);
-		  r2 = r2BandEnd;
-		} while (r2 != r2End);
+static inline void
+FindBandEnd(BandCursor & ioBand)
+{
+	const Rect * r = ioBand.r;
+	if (r != ioBand.rEnd) {
+		short top = r->top;
+		for (++r; r != ioBand.rEnd && r->top == top; ++r)
+			;
 	}
+	ioBand.bandEnd = r;
+}
+
+static inline void
+InitBandCursor(BandCursor & outBand, const Rect * inRect, int inCount)
+{
+	outBand.r = inRect;
+	outBand.rEnd = inRect + inCount;
+	FindBandEnd(outBand);
+}
 
-	// Coalesce again
-	if (currentBand != gRectCount) {
-		coalesceBands(previousBand, currentBand);
+// move past the band if the sweep has reached its bottom
+static inline void
+SkipBandAbove(BandCursor & ioBand, int y)
+{
+	if (ioBand.r != ioBand.rEnd && ioBand.r->bottom <= y) {
+		ioBand.r = ioBand.bandEnd;
+		FindBandEnd(ioBand);
 	}
+}
 
-	// Copy the work region into this
-	checkMemory(rect, gRectCount);
-	memcpy(rect, gRect, gRectCount*sizeof(Rect));
-	count = gRectCount;
 
-	// unlock access to gRect
-//dump("-->");
+static inline bool
+IsInResult(bool inA, bool inB, int inSelector)
+{
+	return inSelector == opUnion ? (inA || inB)
+		  : inSelector == opDiff  ? (inA && !inB)
+		  :								 (inA && inB);
 }
 
 
-void
-CBaseRegion::nonOverlap1(Rect * inRect, int r, int rEnd, int yTop, int yBottom, int inSelector)
-{
-	if (inSelector == opUnion || inSelector == opDiff) {
-		// add global rects
-		ArrayIndex i;
-		for (i = gRectCount; r != rEnd; ++i, ++r) {
-			checkMemory(NULL, i + 1);
-
-			gRect[i].top = yTop;
-			gRect[i].bottom = yBottom;
-			gRect[i].left = inRect[r].left;
-			gRect[i].right = inRect[r].right;
+/* -----------------------------------------------------------------------------
+	Merge the spans of two bands.
+	Walks the left and right edges of both in x order in a single pass,
+	emitting a rect wherever the result switches from outside to inside and
+	back. Edges at the same x are taken together so that abutting spans come
+	out as one.
+	Args:		a, aEnd			spans of the first band
+				b, bEnd			spans of the second band
+				inSelector		how to combine them
+				inTop				the output band
+				inBottom
+				outRect			where to put the result
+	Return:	the end of the result
+----------------------------------------------------------------------------- */
+
+static Rect *
+MergeSpans(const Rect * a, const Rect * aEnd, const Rect * b, const Rect * bEnd, int inSelector, short inTop, short inBottom, Rect * outRect)
+{
+	bool inA = false, inB = false, isIn = false;
+	int left = 0;
+	for ( ; ; ) {
+		int xa = (a == aEnd) ? 0x7FFFFFFF : (inA ? a->right : a->left);
+		int xb = (b == bEnd) ? 0x7FFFFFFF : (inB ? b->right : b->left);
+		int x = MIN(xa, xb);
+		if (x == 0x7FFFFFFF)
+			break;
+		while (a != aEnd && (inA ? a->right : a->left) == x) {
+			if (inA) ++a;
+			inA = !inA;
 		}
-		gRectCount = i;
+		while (b != bEnd && (inB ? b->right : b->left) == x) {
+			if (inB) ++b;
+			inB = !inB;
+		}
+		bool wasIn = isIn;
+		isIn = IsInResult(inA, inB, inSelector);
+		if (isIn && !wasIn) {
+			left = x;
+		} else if (wasIn && !isIn) {
+			outRect->top = inTop;
+			outRect->left = left;
+			outRect->bottom = inBottom;
+			outRect->right = x;
+			++outRect;
+		}
+		// nothing more can be added once the operand that limits the result runs out
+		if ((inSelector == opSect && (a == aEnd || b == bEnd))
+		||  (inSelector == opDiff && a == aEnd))
+			break;
 	}
+	return outRect;
 }
 
 
+/* -----------------------------------------------------------------------------
+	Sweep down two regions, calling back for each stretch of y covered by
+	either. Shared by the sizing and building passes of combine() so that
+	they can't disagree.
+----------------------------------------------------------------------------- */
 
-void
-CBaseRegion::nonOverlap2(Rect * inRect, int r, int rEnd, int yTop, int yBottom, int inSelector)
-{
-	if (inSelector == opUnion) {
-		// add global rects
-		ArrayIndex i;
-		for (i = gRectCount; r != rEnd; ++i, ++r) {
-			checkMemory(NULL, i + 1);
-
-			gRect[i].top = yTop;
-			gRect[i].bottom = yBottom;
-			gRect[i].right = inRect[r].right;
-			gRect[i].left = inRect[r].left;
+template <class Action>
+static void
+SweepBands(const Rect * inRect1, int inCount1, const Rect * inRect2, int inCount2, int inSelector, Action & inAction)
+{
+	BandCursor a, b;
+	InitBandCursor(a, inRect1, inCount1);
+	InitBandCursor(b, inRect2, inCount2);
+
+	int y = -0x7FFFFFFF;
+	for ( ; ; ) {
+		SkipBandAbove(a, y);
+		SkipBandAbove(b, y);
+		bool isALive = a.r != a.rEnd;
+		bool isBLive = b.r != b.rEnd;
+		if (!(isALive || isBLive)
+		||  (inSelector == opSect && !(isALive && isBLive))
+		||  (inSelector == opDiff && !isALive))
+			break;
+
+		int aTop = isALive ? a.r->top : 0x7FFFFFFF;
+		int bTop = isBLive ? b.r->top : 0x7FFFFFFF;
+		bool inA = aTop <= y;
+		bool inB = bTop <= y;
+		if (!inA && !inB) {
+			// gap between bands
+			y = MIN(aTop, bTop);
+			continue;
 		}
-		gRectCount = i;
+		int yNext = MIN(inA ? a.r->bottom : aTop, inB ? b.r->bottom : bTop);
+		inAction.band(inA ? a.r : NULL, inA ? a.bandEnd : NULL,
+						  inB ? b.r : NULL, inB ? b.bandEnd : NULL, y, yNext);
+		y = yNext;
 	}
 }
 
 
-void
-CBaseRegion::overlap(Rect * inRect1, int r1, int r1End, Rect * inRect2, int r2, int r2End, int yTop, int yBottom, int inSelector)
-{
-	int i = gRectCount;
-
-	//
-	// UNION
-	//
-	if (inSelector == opUnion) {
-		while (r1 != r1End && r2 != r2End) {
-			if (inRect1[r1].left < inRect2[r2].left) {
-				if (gRectCount > 0 &&
-					 gRect[i-1].top == yTop &&
-					 gRect[i-1].bottom == yBottom &&
-					 gRect[i-1].right >= inRect1[r1].left) {
-					if (gRect[i-1].right < inRect1[r1].right)
-						gRect[i-1].right = inRect1[r1].right;
-				} else {
-					checkMemory(NULL, gRectCount + 1);
-					
-					gRect[i].top = yTop;
-					gRect[i].bottom = yBottom;
-					gRect[i].left = inRect1[r1].left;
-					gRect[i].right = inRect1[r1].right;
-					++i;
-					++gRectCount;
-				}
-				++r1;
-			} else {
-				if (gRectCount > 0 &&
-					 gRect[i-1].top == yTop &&
-					 gRect[i-1].bottom == yBottom &&
-					 gRect[i-1].right >= inRect2[r2].left) {
-					if (gRect[i-1].right < inRect2[r2].right)
-						gRect[i-1].right = inRect2[r2].right;
-				} else {
-					checkMemory(NULL, gRectCount + 1);
-
-					gRect[i].top = yTop;
-					gRect[i].bottom = yBottom;
-					gRect[i].left = inRect2[r2].left;
-					gRect[i].right = inRect2[r2].right;
-					++i;
-					++gRectCount;
-				}
-				++r2;
-			}
-		}
-
-		if (r1 != r1End) {
-			do {
-				if (gRectCount > 0 &&
-					 gRect[i-1].top == yTop &&
-					 gRect[i-1].bottom == yBottom &&
-					 gRect[i-1].right >= inRect1[r1].left) {
-					if (gRect[i-1].right < inRect1[r1].right)
-					  gRect[i-1].right = inRect1[r1].right;
-				} else {
-					checkMemory(NULL, gRectCount + 1);
-
-					gRect[i].top = yTop;
-					gRect[i].bottom = yBottom;
-					gRect[i].left = inRect1[r1].left;
-					gRect[i].right = inRect1[r1].right;
-					++i;
-					++gRectCount;
-				}
-				++r1;
-			} while (r1 != r1End);
-		} else {
-			while (r2 != r2End) {
-				if (gRectCount > 0 &&
-					 gRect[i-1].top == yTop &&
-					 gRect[i-1].bottom == yBottom &&
-					 gRect[i-1].right >= inRect2[r2].left) {
-					if (gRect[i-1].right < inRect2[r2].right) {
-						gRect[i-1].right = inRect2[r2].right;
-					}
-				} else {
-					checkMemory(NULL, gRectCount + 1);
-
-					gRect[i].top = yTop;
-					gRect[i].bottom = yBottom;
-					gRect[i].left = inRect2[r2].left;
-					gRect[i].right = inRect2[r2].right;
-					++i;
-					++gRectCount;
-				}
-				++r2;
-			}
-		}
+// first pass: the most rects each output band could hold
+struct CountBands
+{
+	int			selector;
+	ArrayIndex	count;
 
-	//
-	// SUBTRACT
-	//
-	} else if (inSelector == opDiff) {
-		int x1 = inRect1[r1].left;
-
-		while (r1 != r1End && r2 != r2End) {
-			if (inRect2[r2].right <= x1) {
-				++r2;
-			} else if (inRect2[r2].left <= x1) {
-				x1 = inRect2[r2].right;
-				if (x1 >= inRect1[r1].right) {
-					++r1;
-					if (r1 != r1End) x1 = inRect1[r1].left;
-				} else {
-					++r2;
-				}
-			} else if (inRect2[r2].left < inRect1[r1].right) {
-				checkMemory(NULL, gRectCount + 1);
-				 
-				gRect[i].top = yTop;
-				gRect[i].bottom = yBottom;
-				gRect[i].left = x1;
-				gRect[i].right = inRect2[r2].left;
-				++i;
-				++gRectCount;
-
-				x1 = inRect2[r2].right;
-				if (x1 >= inRect1[r1].right) {
-					++r1;
-					if (r1 != r1End)
-						x1 = inRect1[r1].left;
-					else
-						++r2;
-				}
-			} else {
-				if (inRect1[r1].right > x1) {
-					checkMemory(NULL, gRectCount + 1);
-					
-					gRect[i].top = yTop;
-					gRect[i].bottom = yBottom;
-					gRect[i].left = x1;
-					gRect[i].right = inRect1[r1].right;
-					++i;
-					++gRectCount;
-				}
-				 
-				++r1;
-				if (r1 != r1End)
-					x1 = inRect1[r1].left;
-			}
-		}
-		while (r1 != r1End) {
-			checkMemory(NULL, gRectCount + 1);
-			 
-			gRect[i].top = yTop;
-			gRect[i].bottom = yBottom;
-			gRect[i].left = x1;
-			gRect[i].right = inRect1[r1].right;
-			++i;
-			++gRectCount;
-
-			r1++;
-			if (r1 != r1End) {
-				x1 = inRect1[r1].left;
-			}
-		}
+	void	band(const Rect * a, const Rect * aEnd, const Rect * b, const Rect * bEnd, int yTop, int yBottom)
+	{
+		bool isA = a != aEnd, isB = b != bEnd;
+		if (selector == opUnion || (isA && (isB || selector == opDiff)))
+			count += (aEnd - a) + (bEnd - b);
+	}
+};
 
-	//
-	// INTERSECT
-	//
-	} else if (inSelector == opSect) {
-		// iterate over both sets of rects
-		while (r1 != r1End && r2 != r2End) {
-			// ->  <-
-			int x1 = MAX(inRect1[r1].left, inRect2[r2].left);
-			int x2 = MIN(inRect1[r1].right, inRect2[r2].right);
-
-			if (x1 < x2) {
-				// theres an intersection -- add it to the global list
-				checkMemory(NULL, gRectCount + 1);
-
-				gRect[i].top = yTop;
-				gRect[i].bottom = yBottom;
-				gRect[i].left = x1;
-				gRect[i].right = x2;
-				++i;
-				++gRectCount;
+// second pass: merge the spans and coalesce each band with the one above
+struct BuildBands
+{
+	int			selector;
+	Rect *		end;
+	Rect *		previousBand;
+
+	void	band(const Rect * a, const Rect * aEnd, const Rect * b, const Rect * bEnd, int yTop, int yBottom)
+	{
+		Rect * currentBand = end;
+		end = MergeSpans(a, aEnd, b, bEnd, selector, yTop, yBottom, currentBand);
+		if (end == currentBand)
+			return;
+
+		ArrayIndex n = end - currentBand;
+		if (previousBand != NULL
+		&&  currentBand - previousBand == n
+		&&  previousBand->bottom == yTop) {
+			Rect * r1 = previousBand, * r2 = currentBand;
+			for ( ; r2 != end; ++r1, ++r2) {
+				if (r1->left != r2->left || r1->right != r2->right)
+					break;
 			}
-
-			if (inRect1[r1].right < inRect2[r2].right) {
-				// r1 is leftmost
-				r1++;
-			} else if (inRect2[r2].right < inRect1[r1].right) {
-				// r2 is leftmost
-				r2++;
-			} else {
-				// same
-				r1++;
-				r2++;
+			if (r2 == end) {
+				// same spans -- extend the band above
+				for (r1 = previousBand; r1 != currentBand; ++r1)
+					r1->bottom = yBottom;
+				end = currentBand;
+				return;
 			}
 		}
+		previousBand = currentBand;
 	}
-}
-
+};
 
 
-/**
-* Corresponds to miCoalesce in Region.c of X11.
-*/
-int
-CBaseRegion::coalesceBands(int previousBand, int currentBand)
-{
-	int r1   = previousBand;
-	int r2   = currentBand;
-	int rEnd = gRectCount;
-
-	// Number of rectangles in prevoius band
-	int nRectanglesInPreviousBand = currentBand - previousBand;
-
-	// Number of rectangles in current band
-	int nRectanglesInCurrentBand  = 0;
-	int y = gRect[r2].top;
-	int r;
-	for (r = r2; r != rEnd && gRect[r].top == y; ++r) {
-		nRectanglesInCurrentBand++;
-	}
+/* -----------------------------------------------------------------------------
+	Combine our region with another in some way.
+	The result is built in the arena, which is sized first from the band
+	structure of both regions, then copied back.
+	Args:		inRgn			another region
+				inSelector	how to combine them
+	Return:	--
+----------------------------------------------------------------------------- */
 
-	// If more than one band was added, we have to find the start
-	// of the last band added so the next coalescing job can start
-	// at the right place.
-	if (r != rEnd) {
-		for (--rEnd; gRect[rEnd-1].top == gRect[rEnd].top; --rEnd) {
-			;
-		}
-		rEnd -= 4;
-		while (gRect[rEnd-1].top == gRect[rEnd].top)
-			--rEnd;
+void
+CBaseRegion::combine(const CBaseRegion& inRgn, int inSelector)
+{
+	CountBands sizer = { inSelector, 0 };
+	SweepBands(rect, count, inRgn.rect, inRgn.count, inSelector, sizer);
 
-		currentBand = rEnd - gRectCount;
-		rEnd = gRectCount;
-	}
+	Rect * work = ArenaReserve(sizer.count);
+	BuildBands builder = { inSelector, work, NULL };
+	SweepBands(rect, count, inRgn.rect, inRgn.count, inSelector, builder);
 
-	if (nRectanglesInCurrentBand == nRectanglesInPreviousBand && nRectanglesInCurrentBand != 0) {
-
-		// The bands may only be coalesced if the bottom of the previous
-		// band matches the top of the current.
-		if (gRect[r1].bottom == gRect[r2].top) {
-
-			// Chek that the bands have boxes in the same places
-			do {
-				if ((gRect[r1].left != gRect[r2].left) || (gRect[r1].right != gRect[r2].right))
-					return currentBand; // No coalescing
-			 
-				++r1;
-				++r2;
-			 
-				nRectanglesInPreviousBand--;
-			} while (nRectanglesInPreviousBand != 0);
-
-			//
-			// OK, the band can be coalesced
-			//
-
-			// Adjust number of rectangles and set pointers back to start
-			gRectCount -= nRectanglesInCurrentBand;
-			r1 -= nRectanglesInCurrentBand << 2;
-			r2 -= nRectanglesInCurrentBand << 2;        
-
-			// Do the merge
-			do {
-				gRect[r1].bottom = gRect[r2].bottom;
-				++r1;
-				++r2;
-				nRectanglesInCurrentBand--;
-			} while (nRectanglesInCurrentBand != 0);
-
-			// If only one band was added we back up the current pointer
-			if (r2 == rEnd) {
-				currentBand = previousBand;
-			} else {
-				do {
-					gRect[r1] = gRect[r2];
-					r1++;
-					r2++;
-				} while (r2 != rEnd);
-			}
+	ArrayIndex newCount = builder.end - work;
+	if (newCount > allocCount) {
+		// nothing of ours needs keeping -- inRgn may be this, but the sweep is done
+		Rect * newList = new Rect[newCount];
+		if (newList == NULL) {
+			ArenaRelease(work);
+			OutOfMemory();
 		}
+		if (rect)
+			delete[] rect;
+		rect = newList;
+		allocCount = newCount;
 	}
-
-	return currentBand;
+	if (newCount > 0)
+		memcpy(rect, work, newCount*sizeof(Rect));
+	ArenaRelease(work);
+	count = newCount;
+	updateExtent();
 }
 
 
-
 /* -----------------------------------------------------------------------------
 	Update the extent from the rects of our region.
 	Args:		--
@@ -798,14 +615,10 @@ CBaseRegion::dump(const char * inTitle) const
 
 CRectangularRegion::CRectangularRegion(Rect inRect)
 {
-	if (EmptyRect(&inRect)) {
-		extent = gZeroRect;
-		count = 0;
-		rect = NULL;
-	} else {
+	// CBaseRegion has already allocated our rect list
+	if (!EmptyRect(&inRect)) {
 		extent = inRect;
 		count = 1;
-		rect = new Rect[1];
 		rect[0] = inRect;
 	}
 }
@@ -962,11 +775,27 @@ CRegion::stealRegion(void)
 ----------------------------------------------------------------------------- */
 #include "View.h"
 
+// generations are unique across all clippers, so a view can't mistake one clipper's for another's
+static ULong gClipperGeneration = 0;
+
 CClipper::CClipper()
 {
 	fFullRgn = new CRegionStruct;
 	x04 = new CRegionStruct;
 	fIsVisible = false;
+	fGeneration = ++gClipperGeneration;
+}
+
+CClipper::~CClipper()
+{
+	delete fFullRgn;
+	delete x04;
+}
+
+void
+CClipper::invalidate(void)
+{
+	fGeneration = ++gClipperGeneration;
 }
 
 void
@@ -994,6 +823,7 @@ CClipper::updateRegions(CView * inView)
 	CRectangularRegion wideOpenRgn(wideOpenBox);
 	x04->fRegion->setRegion(wideOpenRgn);
 //	RectRgn(*x04, &openBox);
+	invalidate();
 }
 
 void
@@ -1001,15 +831,34 @@ CClipper::offset(Point inPt)
 {
 	fFullRgn->fRegion->offset(inPt.h, inPt.v);
 //	OffsetRgn(*fFullRgn, inPt.h, inPt.v);
+	invalidate();
 }
 
-void
+/* -----------------------------------------------------------------------------
+	Recalculate the visible region: our full region less whatever is in front.
+	The generation only moves on if the result is different.
+	Args:		inRgn			the region obscuring us
+	Return:	true => the visible region changed
+----------------------------------------------------------------------------- */
+
+bool
 CClipper::recalcVisible(CBaseRegion& inRgn)
 {
-	x04->fRegion->setRegion(*fFullRgn->fRegion);
-	x04->fRegion->diffRegion(inRgn);
-	fIsVisible = x04->fRegion->isEqual(*fFullRgn->fRegion);
+	CBaseRegion * visRgn = NewCachedRgn();
+	visRgn->setRegion(*fFullRgn->fRegion);
+	visRgn->diffRegion(inRgn);
+	fIsVisible = visRgn->isEqual(*fFullRgn->fRegion);
 //	DiffRgn(*fFullRgn, inRgn, *x04);
 //	fIsVisible = EqualRgn(*x04, *fFullRgn);
+
+	bool isChanged = !visRgn->isEqual(*x04->fRegion);
+	if (isChanged) {
+		DisposeCachedRgn(x04->fRegion);
+		x04->fRegion = visRgn;
+		invalidate();
+	} else {
+		DisposeCachedRgn(visRgn);
+	}
+	return isChanged;
 }
 
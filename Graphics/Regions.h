@@ -59,6 +59,8 @@ public:
 	bool		isEqual(const CBaseRegion& inRgn) const;
 	bool		contains(Point inPt) const;
 	bool		intersects(const Rect * inRect) const;		// same semantics as RectInRgn?
+	ArrayIndex	rectCount(void) const;
+	const Rect *	rects(void) const;
 	CBaseRegion& setRegion(const CBaseRegion& inRgn);
 	CBaseRegion& unionRegion(const CBaseRegion& inRgn);
 	CBaseRegion& diffRegion(const CBaseRegion& inRgn);
@@ -68,11 +70,6 @@ public:
 
 protected:
 	void		combine(const CBaseRegion& inRgn, int inSelector);
-	void		nonOverlap1(Rect * inRect, int r, int rEnd, int yTop, int yBottom, int inSelector);
-	void		nonOverlap2(Rect * inRect, int r, int rEnd, int yTop, int yBottom, int inSelector);
-	void		overlap(Rect * inRect1, int r1, int r1End, Rect * inRect2, int r2, int r2End, int yTop, int yBottom, int inSelector);
-	int		coalesceBands(int inPreviousBand, int inCurrentBand);
-	void		checkMemory(Rect * inRects, ArrayIndex inCount);
 	void		updateExtent(void);
 
 	Rect		extent;
@@ -81,6 +78,9 @@ protected:
 	Rect *	rect;
 };
 
+inline ArrayIndex		CBaseRegion::rectCount(void) const	{ return count; }
+inline const Rect *	CBaseRegion::rects(void) const		{ return rect; }
+
 // a single Rect that defines an invalid display area that needs drawing
 class CRectangularRegion : public CBaseRegion
 {
@@ -152,6 +152,9 @@ private:
 /*------------------------------------------------------------------------------
 	C C l i p p e r
 	Represents the clipping region for a view.
+	The generation changes whenever the visible region might have changed, or
+	the geometry of any view within the clipped view; views use it to tell
+	whether their cached visRgn is still good.
 ------------------------------------------------------------------------------*/
 class CView;
 
@@ -159,14 +162,17 @@ class CClipper
 {
 public:
 				CClipper();
+				~CClipper();
 
 	void		updateRegions(CView * inView);
 	void		offset(Point inPt);
-	void		recalcVisible(CBaseRegion& inRgn);
+	bool		recalcVisible(CBaseRegion& inRgn);
+	void		invalidate(void);
 
 	CRegionStruct *	fFullRgn;	// +00
 	CRegionStruct *	x04;
 	bool					fIsVisible;	// +08
+	ULong					fGeneration;
 };
 
 
@@ -0,0 +1,314 @@
+/*
+	File:		Scaling.cc
+
+	Contains:	Bitmap scaling and depth conversion.
+					Bitmaps are scaled and converted between depths a row at a
+					time. Source rows are unpacked to 8-bit darkness -- 0 is
+					white, 255 is black -- through a table that turns a source
+					byte into all its pixels at once; the rows are filtered to
+					the destination size and packed to its depth.
+
+	Written by:	Newton Research Group, 2007.
+*/
+
+#include "Scaling.h"
+#include "NewtonWidgets.h"
+#include "Geometry.h"
+#include "NewtonMemory.h"
+#include "OSErrors.h"
+
+#include <string.h>
+
+
+struct ScaleSource
+{
+	const UByte *	bits;
+	int				rowBytes;
+	int				depth;
+	UByte				expand[256][8];	// source byte -> darkness of each of its pixels
+};
+
+
+
+/*------------------------------------------------------------------------------
+	Set up to unpack the rows of a pixel map.
+	Args:		inPixmap
+				outSource
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+InitScaleSource(const NativePixelMap * inPixmap, ScaleSource * outSource)
+{
+	int	depth = PixelDepth(inPixmap);
+	int	maxLevel = (1 << depth) - 1;
+	int	pixPerByte = 8 / depth;
+	UByte	level[256];
+
+	outSource->bits = (const UByte *)PixelMapBits(inPixmap);
+	outSource->rowBytes = inPixmap->rowBytes;
+	outSource->depth = depth;
+
+	for (int i = 0; i <= maxLevel; ++i)
+	{
+		int	value = inPixmap->grayTable ? inPixmap->grayTable[i] & maxLevel : i;
+		level[i] = (value * 255 + maxLevel/2) / maxLevel;
+	}
+	for (int b = 0; b < 256; ++b)
+	{
+		for (int i = 0; i < pixPerByte; ++i)
+			outSource->expand[b][i] = level[(b >> (8 - depth - i * depth)) & maxLevel];
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	Unpack a row of source pixels to 8-bit darkness.
+	Args:		inSource
+				inY				row, from the top of the pixel map
+				inWidth			pixels to unpack
+				outRow			room for inWidth rounded up to a multiple of 8
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+UnpackRow(const ScaleSource * inSource, int inY, int inWidth, UByte * outRow)
+{
+	const UByte *	src = inSource->bits + inY * inSource->rowBytes;
+	switch (inSource->depth)
+	{
+	case 1:
+		for (int x = 0; x < inWidth; x += 8, outRow += 8)
+			memcpy(outRow, inSource->expand[*src++], 8);
+		break;
+	case 2:
+		for (int x = 0; x < inWidth; x += 4, outRow += 4)
+			memcpy(outRow, inSource->expand[*src++], 4);
+		break;
+	case 4:
+		for (int x = 0; x < inWidth; x += 2, outRow += 2)
+			memcpy(outRow, inSource->expand[*src++], 2);
+		break;
+	case 8:
+		for (int x = 0; x < inWidth; ++x)
+			*outRow++ = inSource->expand[*src++][0];
+		break;
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	Pack a row of 8-bit darkness to a destination depth.
+	Args:		inRow
+				inWidth
+				inDepth
+				outBits
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+PackRow(const UByte * inRow, int inWidth, int inDepth, UByte * outBits)
+{
+	if (inDepth == 8)
+	{
+		memcpy(outBits, inRow, inWidth);
+		return;
+	}
+
+	int	shift = 8 - inDepth;
+	int	bits = 0;
+	int	numOfBits = 0;
+	for (int x = 0; x < inWidth; ++x)
+	{
+		bits = (bits << inDepth) | (inRow[x] >> shift);
+		if ((numOfBits += inDepth) == 8)
+		{
+			*outBits++ = bits;
+			bits = numOfBits = 0;
+		}
+	}
+	if (numOfBits)
+		*outBits = bits << (8 - numOfBits);
+}
+
+
+/*------------------------------------------------------------------------------
+	Box filter: each destination pixel is the average of the source pixels that
+	map onto it. Enlarging, this degenerates to nearest neighbour.
+	Args:		inSource
+				inSrcWidth, inSrcHeight
+				inDstWidth, inDstHeight
+				inDstDepth
+				outBits			inDstHeight rows, inRowBytes apart
+				inRowBytes
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+static NewtonErr
+BoxScale(const ScaleSource * inSource, int inSrcWidth, int inSrcHeight,
+			int inDstWidth, int inDstHeight, int inDstDepth, UByte * outBits, size_t inRowBytes)
+{
+	size_t	rowSize = ALIGN(inSrcWidth, 8);
+	Ptr		buf = NewPtr(rowSize + inDstWidth + inDstWidth * (sizeof(ULong) + 2 * sizeof(int)));
+	if (buf == NULL)
+		return kOSErrNoMemory;
+
+	ULong *	sum = (ULong *)buf;
+	int *		xStart = (int *)(sum + inDstWidth);
+	int *		xEnd = xStart + inDstWidth;
+	UByte *	row = (UByte *)(xEnd + inDstWidth);
+	UByte *	out = row + rowSize;
+
+	for (int x = 0; x < inDstWidth; ++x)
+	{
+		xStart[x] = x * inSrcWidth / inDstWidth;
+		xEnd[x] = MAX((x + 1) * inSrcWidth / inDstWidth, xStart[x] + 1);
+	}
+
+	for (int y = 0; y < inDstHeight; ++y, outBits += inRowBytes)
+	{
+		int	yStart = y * inSrcHeight / inDstHeight;
+		int	yEnd = MAX((y + 1) * inSrcHeight / inDstHeight, yStart + 1);
+
+		memset(sum, 0, inDstWidth * sizeof(ULong));
+		for (int sy = yStart; sy < yEnd; ++sy)
+		{
+			UnpackRow(inSource, sy, inSrcWidth, row);
+			for (int x = 0; x < inDstWidth; ++x)
+			{
+				ULong	rowSum = 0;
+				for (int sx = xStart[x]; sx < xEnd[x]; ++sx)
+					rowSum += row[sx];
+				sum[x] += rowSum;
+			}
+		}
+		for (int x = 0; x < inDstWidth; ++x)
+		{
+			ULong	area = (xEnd[x] - xStart[x]) * (yEnd - yStart);
+			out[x] = (sum[x] + area/2) / area;
+		}
+		PackRow(out, inDstWidth, inDstDepth, outBits);
+	}
+
+	FreePtr(buf);
+	return noErr;
+}
+
+
+/*------------------------------------------------------------------------------
+	Bilinear filter: each destination pixel is interpolated between the four
+	source pixels nearest its centre. Shrinking by more than half, this skips
+	source pixels; use the box filter.
+	Source rows are unpacked once each, however many destination rows use them.
+	Args:		as BoxScale
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+static NewtonErr
+BilinearScale(const ScaleSource * inSource, int inSrcWidth, int inSrcHeight,
+				  int inDstWidth, int inDstHeight, int inDstDepth, UByte * outBits, size_t inRowBytes)
+{
+	size_t	rowSize = ALIGN(inSrcWidth, 8);
+	Ptr		buf = NewPtr(2 * rowSize + inDstWidth + inDstWidth * 3 * sizeof(int));
+	if (buf == NULL)
+		return kOSErrNoMemory;
+
+	int *		x0 = (int *)buf;
+	int *		x1 = x0 + inDstWidth;
+	int *		fx = x1 + inDstWidth;
+	UByte *	row[2] = { (UByte *)(fx + inDstWidth), (UByte *)(fx + inDstWidth) + rowSize };
+	int		rowY[2] = { -1, -1 };
+	UByte *	out = row[1] + rowSize;
+
+	// positions of destination pixel centres in the source, in 1/256 pixel
+	for (int x = 0; x < inDstWidth; ++x)
+	{
+		int	pos = MAX((2 * x + 1) * inSrcWidth * 128 / inDstWidth - 128, 0);
+		x0[x] = pos >> 8;
+		x1[x] = MIN(x0[x] + 1, inSrcWidth - 1);
+		fx[x] = pos & 0xFF;
+	}
+
+	for (int y = 0; y < inDstHeight; ++y, outBits += inRowBytes)
+	{
+		int	pos = MAX((2 * y + 1) * inSrcHeight * 128 / inDstHeight - 128, 0);
+		int	y0 = pos >> 8;
+		int	y1 = MIN(y0 + 1, inSrcHeight - 1);
+		int	fy = pos & 0xFF;
+
+		// bring rows y0 and y1 into row[0] and row[1], reusing what we have
+		if (rowY[0] != y0)
+		{
+			if (rowY[1] == y0)
+			{
+				UByte * r = row[0]; row[0] = row[1]; row[1] = r;
+				rowY[0] = y0; rowY[1] = -1;
+			}
+			else
+			{
+				UnpackRow(inSource, y0, inSrcWidth, row[0]);
+				rowY[0] = y0;
+			}
+		}
+		if (rowY[1] != y1)
+		{
+			UnpackRow(inSource, y1, inSrcWidth, row[1]);
+			rowY[1] = y1;
+		}
+
+		const UByte *	r0 = row[0];
+		const UByte *	r1 = row[1];
+		for (int x = 0; x < inDstWidth; ++x)
+		{
+			ULong	top = r0[x0[x]] * (256 - fx[x]) + r0[x1[x]] * fx[x];
+			ULong	bottom = r1[x0[x]] * (256 - fx[x]) + r1[x1[x]] * fx[x];
+			out[x] = (top * (256 - fy) + bottom * fy + 32768) >> 16;
+		}
+		PackRow(out, inDstWidth, inDstDepth, outBits);
+	}
+
+	FreePtr(buf);
+	return noErr;
+}
+
+
+/*------------------------------------------------------------------------------
+	Scale a pixel map, converting depth as necessary.
+	The source must be gray, 1, 2, 4 or 8 bits deep; the result is packed to
+	the same depths, a row at a time, and must not overlap the source.
+	Args:		inSrc
+				inFilter			kScaleBox or kScaleBilinear
+				inDstWidth, inDstHeight
+				inDstDepth
+				outBits			inDstHeight rows...
+				inRowBytes		...this far apart
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+ScalePixels(const NativePixelMap * inSrc, int inFilter,
+				int inDstWidth, int inDstHeight, int inDstDepth, UByte * outBits, size_t inRowBytes)
+{
+	int	srcDepth = PixelDepth(inSrc);
+	int	srcWidth = RectGetWidth(inSrc->bounds);
+	int	srcHeight = RectGetHeight(inSrc->bounds);
+
+	if ((srcDepth != 1 && srcDepth != 2 && srcDepth != 4 && srcDepth != 8)
+	||  (inDstDepth != 1 && inDstDepth != 2 && inDstDepth != 4 && inDstDepth != 8))
+		return kOSErrBadParameters;
+	if (srcWidth <= 0 || srcHeight <= 0 || inDstWidth <= 0 || inDstHeight <= 0)
+		return noErr;
+
+	ScaleSource *	source = (ScaleSource *)NewPtr(sizeof(ScaleSource));
+	if (source == NULL)
+		return kOSErrNoMemory;
+
+	NewtonErr	err;
+	InitScaleSource(inSrc, source);
+	if (inFilter == kScaleBilinear)
+		err = BilinearScale(source, srcWidth, srcHeight, inDstWidth, inDstHeight, inDstDepth, outBits, inRowBytes);
+	else
+		err = BoxScale(source, srcWidth, srcHeight, inDstWidth, inDstHeight, inDstDepth, outBits, inRowBytes);
+	FreePtr((Ptr)source);
+	return err;
+}
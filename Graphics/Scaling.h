@@ -0,0 +1,24 @@
+/*
+	File:		Scaling.h
+
+	Contains:	Bitmap scaling declarations.
+
+	Written by:	Newton Research Group, 2007.
+*/
+
+#if !defined(__SCALING_H)
+#define __SCALING_H 1
+
+#include "QDTypes.h"
+#include <stddef.h>
+
+enum
+{
+	kScaleBox,			// average the source pixels under each destination pixel
+	kScaleBilinear		// interpolate between the nearest four source pixels
+};
+
+extern NewtonErr	ScalePixels(const NativePixelMap * inSrc, int inFilter,
+									int inDstWidth, int inDstHeight, int inDstDepth, UByte * outBits, size_t inRowBytes);
+
+#endif	/* __SCALING_H */
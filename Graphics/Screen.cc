@@ -39,6 +39,8 @@ alternatively...
 
 #include "Screen.h"
 #include "ScreenDriver.h"
+#include "Damage.h"
+#include "HeadlessDisplay.h"
 #include "ViewFlags.h"
 #include "QDDrawing.h"
 #include "Tablet.h"
@@ -75,6 +77,9 @@ const ScreenParams gScreenConstants =		// was qdConstants 00380BCC
 NativePixelMap	gScreenPixelMap;				// was qd.pixmap
 
 
+#define forDamageStats		0	// log damage and updates in the form Testing/Host/ScreenDamage replays
+
+
 /* -----------------------------------------------------------------------------
 	D a t a
 ----------------------------------------------------------------------------- */
@@ -84,14 +89,16 @@ CGContextRef	quartz;
 int				gScreenWidth;			// 0C104C58
 int				gScreenHeight;			// 0C104C5C
 
+ULong				gScreenPixelsBlitted;
+
 struct
 {
 	CScreenDriver *		driver;			// +00	 actually CMainDisplayDriver protocol
 	CScreenDriver *		auxDriver;		// +04
 	int						f08;				// +08
-	Rect						dirtyBounds;	// +0C
-	CUTask *					updateTask;		// +14
-	CUSemaphoreGroup *	semaphore;		// +18
+	DamageSet				damage;			// +0C	was Rect dirtyBounds, 8 bytes; everything after it has moved
+	CUTask *					updateTask;		// +50	was +14
+	CUSemaphoreGroup *	semaphore;		// +54	was +18
 	CUSemaphoreOpList *	f1C;				// acquire display
 	CUSemaphoreOpList *	f20;				// release display
 	CUSemaphoreOpList *	f24;
@@ -100,7 +107,7 @@ struct
 	CUSemaphoreOpList *	f30;
 	CUSemaphoreOpList *	f34;
 	CUSemaphoreOpList *	f38;
-	CULockingSemaphore *	lock;				// +3C
+	CULockingSemaphore *	lock;				// +78	was +3C
 } gScreen;	// 0C101A4C
 
 
@@ -121,6 +128,9 @@ AlertScreenInfo gAlertScreenInfo;		// 0C105EF0
 
 static void	SetupScreen(void);
 static void	SetupScreenPixelMap(void);
+#if defined(forSoftQuartz)
+static void	SetupScreenContext(void);
+#endif
 
 void	SetScreenInfo(void);
 void	SetAlertScreenInfo(AlertScreenInfo * info);
@@ -196,8 +206,11 @@ InitScreen(void)
 		memset(gScreenPixelMap.baseAddr, 0, screenBytes);
 		SetScreenInfo();
 	}
+#if defined(forSoftQuartz)
+	SetupScreenContext();
+#endif
 
-	SetEmptyRect(&gScreen.dirtyBounds);
+	ClearDamage(&gScreen.damage);
 	InitScreenTask();
 #endif
 }
@@ -212,7 +225,11 @@ InitScreen(void)
 static void
 SetupScreen(void)
 {
-	gScreen.driver = (CScreenDriver *)MakeByName("CScreenDriver", "CMainDisplayDriver");
+	gScreen.driver = NULL;
+	if (gWantHeadlessDisplay)
+		gScreen.driver = (CScreenDriver *)MakeByName("CScreenDriver", "CHeadlessDisplayDriver");
+	if (gScreen.driver == NULL)
+		gScreen.driver = (CScreenDriver *)MakeByName("CScreenDriver", "CMainDisplayDriver");
 	gScreen.auxDriver = NULL;
 	gScreen.f08 = 0;
 }
@@ -243,6 +260,24 @@ SetupScreenPixelMap(void)
 }
 
 
+#if defined(forSoftQuartz)
+/*------------------------------------------------------------------------------
+	Point the software Quartz context at the screen pixmap.
+	Must be redone whenever the pixmap changes shape.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+SetupScreenContext(void)
+{
+	if (quartz)
+		CGContextRelease(quartz);
+	quartz = CGPixelMapContextCreate(&gScreenPixelMap);
+}
+#endif
+
+
 /*------------------------------------------------------------------------------
 	Set up the screen info record.
 	Args:		--
@@ -403,6 +438,9 @@ SetGrafInfo(int inSelector, int inValue)
 			gScreen.driver->setFeature(4, inValue);
 		SetupScreenPixelMap();
 		memset(PixelMapBits(&gScreenPixelMap), 0, (gScreenPixelMap.bounds.bottom - gScreenPixelMap.bounds.top) * gScreenPixelMap.rowBytes);
+#if defined(forSoftQuartz)
+		SetupScreenContext();
+#endif
 		break;
 
 	case kGrafBacklight:
@@ -600,12 +638,27 @@ void
 UpdateHardwareScreen(void)
 {
 	Rect r;
+	ULong numOfPixels = 0;
 
-	// only bother if the dirty area is actually on-screen
-	if (SectRect(&gScreen.dirtyBounds, &gScreenPixelMap.bounds, &r))
-		BlitToScreens(&gScreenPixelMap, &r, &r, modeCopy);
+	StartFrameTiming(kFrameBlit);
+	// blit each damaged rect -- if it is actually on-screen
+	for (ArrayIndex i = 0; i < gScreen.damage.count; ++i)
+	{
+		if (SectRect(&gScreen.damage.rect[i], &gScreenPixelMap.bounds, &r))
+		{
+			BlitToScreens(&gScreenPixelMap, &r, &r, modeCopy);
+			numOfPixels += RectArea(&r);
+		}
+	}
+#if forDamageStats
+	if (gScreen.damage.count > 0)
+		printf("update %u\n", numOfPixels);
+#endif
 	// it's no longer dirty
-	SetEmptyRect(&gScreen.dirtyBounds);
+	ClearDamage(&gScreen.damage);
+	StopFrameTiming(kFrameBlit);
+
+	gScreenPixelsBlitted = numOfPixels;
 }
 
 
@@ -669,7 +722,10 @@ StopDrawing(NativePixelMap * inPixmap, Rect * inBounds)
 		{
 			Rect	bbox = *inBounds;
 			OffsetRect(&bbox, -inPixmap->bounds.left, -inPixmap->bounds.top);
-			UnionRect(&bbox, &gScreen.dirtyBounds, &gScreen.dirtyBounds);
+			AddDamage(&gScreen.damage, &bbox);
+#if forDamageStats
+			printf("damage %d %d %d %d\n", bbox.left, bbox.top, bbox.right, bbox.bottom);
+#endif
 		}
 
 #if !defined(forFramework)
@@ -716,12 +772,15 @@ QDStopDrawing(NativePixelMap * inPixmap, Rect * inBounds)
 
 	if (PixelMapBits(inPixmap) == PixelMapBits(&gScreenPixelMap))
 	{
-		bool	isAnythingToDraw = !EmptyRect(&gScreen.dirtyBounds);
+		bool	isAnythingToDraw = (gScreen.damage.count != 0);
 		if (inBounds)
 		{
 			Rect	bbox = *inBounds;
 			OffsetRect(&bbox, -inPixmap->bounds.left, -inPixmap->bounds.top);
-			UnionRect(&bbox, &gScreen.dirtyBounds, &gScreen.dirtyBounds);
+			AddDamage(&gScreen.damage, &bbox);
+#if forDamageStats
+			printf("damage %d %d %d %d\n", bbox.left, bbox.top, bbox.right, bbox.bottom);
+#endif
 		}
 
 #if !defined(forFramework)
@@ -86,6 +86,8 @@ extern NativePixelMap		gScreenPixelMap;
 extern int	gScreenWidth;
 extern int	gScreenHeight;
 
+extern ULong	gScreenPixelsBlitted;	// by the last update -- for debugging
+
 
 /*------------------------------------------------------------------------------
 	P u b l i c   I n t e r f a c e
@@ -9,6 +9,7 @@
 #include "Geometry.h"
 
 #include "ScreenDriver.h"
+#include "FrameBuffer.h"
 #include "ViewFlags.h"
 #include "QDDrawing.h"
 #include "NewtonGestalt.h"
@@ -24,26 +25,6 @@
 #define kScreenDPI		100
 
 
-/*------------------------------------------------------------------------------
-	B l i t R e c
-
-	Data passed to landscape blit functions.
-------------------------------------------------------------------------------*/
-
-struct BlitRec
-{
-	int		srcRowOffset;	// +00
-	int		dstRowOffset;	// +04
-	int		x08;
-	Ptr		srcAddr;			// +0C
-	Ptr		dstAddr;			// +10
-	int		mode;				// +14
-	int		numOfRows;		// +18
-	int		numOfBytes;		// +1C
-//	size +20
-};
-
-
 /*------------------------------------------------------------------------------
 	C M a i n D i s p l a y D r i v e r
 ------------------------------------------------------------------------------*/
@@ -255,6 +236,8 @@ CMainDisplayDriver::blit(NativePixelMap * inPixmap, Rect * inSrcBounds, Rect * i
 	size_t	pixmapHeight = RectGetHeight(inPixmap->bounds);
 	size_t	pixmapDepth = PixelDepth(inPixmap);
 
+#if !defined(forSoftQuartz)
+	// with the software Quartz we draw into the screen pixmap itself; the host displays that
 	CGImageRef			image = NULL;
 	CGColorSpaceRef	baseColorSpace = CGColorSpaceCreateWithName(kCGColorSpaceGenericGray);
 	CGColorSpaceRef	colorSpace = CGColorSpaceCreateIndexed(baseColorSpace, (1 << pixmapDepth)-1, colorTable[pixmapDepth]);
@@ -283,208 +266,17 @@ printf("CMainDisplayDriver::blit(pixmap={w:%lu,h:%lu}, srcBounds={t:%d,l:%d,b:%d
 	} else {
 printf("image=NULL -- ");
 	}
+#endif
 
 
 #if defined(correct)
-	BlitRec	blitParms;
-
 //	g20000000 = fContrast + fContrast2 + 0x66;
 
-	if (fOrientation == kLandscape || fOrientation == kLandscapeFlip)
-	{
-		// byte-aligned leftmost pixel in image
-		int	srcLeft = (inSrcBounds->left - inPixmap->bounds.left) & ~0x07;
-		// byte-aligned rightmost pixel in image
-		int	srcRight = (inSrcBounds->right - inPixmap->bounds.left + 0x07) & ~0x07;
-		// number of bytes in row to be transferred
-		int	byteWd = (srcRight - srcLeft) * kScreenDepth / 8;
-		// offset to first byte in image
-		int	srcOffset = inPixmap->rowBytes * (inSrcBounds->top - inPixmap->bounds.top) + srcLeft * kScreenDepth / 8;
-		// offset to first byte on screen
-		int	dstOffset = fPixMap.rowBytes * inDstBounds->top + (inDstBounds->left & ~0x07) * kScreenDepth / 8;
-		if (fOrientation != kLandscape)		// ie flipped
-			dstOffset = 76796 - dstOffset; 	// 480*320*4/8-4
- 
-		blitParms.srcRowOffset = inPixmap->rowBytes - byteWd;
-		blitParms.dstRowOffset = fPixMap.rowBytes - byteWd;
-		blitParms.srcAddr = PixelMapBits(inPixmap) + srcOffset;
-		blitParms.dstAddr = PixelMapBits(&fPixMap) + dstOffset;
-		blitParms.mode = inTransferMode;
-		blitParms.numOfRows = inDstBounds->bottom - inDstBounds->top;
-		blitParms.numOfBytes = byteWd;
-	}
-
-	switch (fOrientation)
-	{
-	case kPortrait:
-		blitPortrait(inPixmap, inSrcBounds, inDstBounds, inTransferMode, inTransferMode);
-		break;
-	case kLandscape:
-		blitLandscape(&blitParms);
-		break;
-	case kPortraitFlip:
-		blitPortraitFlip(inPixmap, inSrcBounds, inDstBounds, inTransferMode, inTransferMode);
-		break;
-	case kLandscapeFlip:
-		blitLandscapeFlip(&blitParms);
-		break;
-	}
+	BlitFrameBuffer(inPixmap, inSrcBounds, inDstBounds, inTransferMode, &fPixMap, fOrientation);
 #endif
 }
 
 
-void
-CMainDisplayDriver::blitLandscape(BlitRec * inBlit)	// 007A6070
-{
-	register int * srcPtr = (int *)inBlit->srcAddr;
-	register int * dstPtr = (int *)inBlit->dstAddr;
-	register int mode = inBlit->mode;
-	register ArrayIndex numOfLongs = inBlit->numOfBytes / 4;	// do 32 bits at a time
-
-	for (ArrayIndex row = inBlit->numOfRows; row > 0; row--)
-	{
-		if (mode == modeCopy)
-			for (ArrayIndex i = numOfLongs; i > 0; i--)
-				*dstPtr++ = *srcPtr++;
-		else /*srcOr*/
-			for (ArrayIndex i = numOfLongs; i > 0; i--)
-				*dstPtr++ |= *srcPtr++;
-	}
-}
-
-
-void
-CMainDisplayDriver::blitLandscapeFlip(BlitRec * inBlit)	// 007A60E8
-{
-	register int * srcPtr = (int *)inBlit->srcAddr;
-	register int * dstPtr = (int *)inBlit->dstAddr;
-	register int mode = inBlit->mode;
-	register ArrayIndex numOfLongs = inBlit->numOfBytes / 4;
-	register ULong src, flipper;
-
-	for (ArrayIndex row = inBlit->numOfRows; row > 0; row--)
-	{
-		if (mode == modeCopy)
-			for (ArrayIndex i = numOfLongs; i > 0; i--)
-			{
-				src = *srcPtr++;
-				flipper =   src         << 28;
-				src >>= 4;
-				flipper |= (src & 0x0F) << 24;
-				src >>= 4;
-				flipper |= (src & 0x0F) << 20;
-				src >>= 4;
-				flipper |= (src & 0x0F) << 16;
-				src >>= 4;
-				flipper |= (src & 0x0F) << 12;
-				src >>= 4;
-				flipper |= (src & 0x0F) <<  8;
-				src >>= 4;
-				flipper |= (src & 0x0F) <<  4;
-				src >>= 4;
-				flipper |= (src & 0x0F);
-				*dstPtr-- = flipper;
-			}
-		else /*srcOr*/
-			for (ArrayIndex i = numOfLongs; i > 0; i--)
-			{
-				src = *srcPtr++;
-				flipper =   src         << 28;
-				src >>= 4;
-				flipper |= (src & 0x0F) << 24;
-				src >>= 4;
-				flipper |= (src & 0x0F) << 20;
-				src >>= 4;
-				flipper |= (src & 0x0F) << 16;
-				src >>= 4;
-				flipper |= (src & 0x0F) << 12;
-				src >>= 4;
-				flipper |= (src & 0x0F) <<  8;
-				src >>= 4;
-				flipper |= (src & 0x0F) <<  4;
-				src >>= 4;
-				flipper |= (src & 0x0F);
-				*dstPtr-- |= flipper;
-			}
-	}
-}
-
-
-void
-CMainDisplayDriver::blitPortrait(NativePixelMap * inPixmap, Rect * inSrcBounds, Rect * inDstBounds, int inTransferMode, int inMode)
-{
-return;	// don’t risk this yet
-// r9: r4..
-//sp-24
-	int sp04 = fScreenWidth * kScreenDepth / 8;
-	int sp00 = sp04 / 4;
-	
-	// byte-aligned leftmost pixel in image
-	int	r6 = (inSrcBounds->left - inPixmap->bounds.left) & ~0x07;			//srcLeft?
-	// byte-aligned rightmost pixel in image
-	int	r7 = (inSrcBounds->right - inPixmap->bounds.left + 0x07) & ~0x07;	//srcRight?
-
-	int r5 = (inSrcBounds->top - inPixmap->bounds.top) & ~0x07;					// srcTop?
-	int r8 = (inSrcBounds->bottom - inPixmap->bounds.top + 7) & ~0x07;		// srcBottom?
-
-	int r10 = (inDstBounds->left & ~0x07);
-	int sp20 = (inDstBounds->top & ~0x07);
-
-	//sp-04
-	int r1 = r5 * inPixmap->rowBytes;
-	int spm04 = r1 + (r6/8)*4;
-
-	Ptr sp0C = PixelMapBits(inPixmap) + spm04;
-	int r4 = inPixmap->rowBytes / 4;
-	r1 = sp04 * r10;
-	r10 = r1 + (fScreenWidth - sp20 - 1) / 8 * 4;
-
-	Ptr sp08 = PixelMapBits(&fPixMap) + r10;
-	r1 = (r8 - r5)/8;
-	int sp1C = (r7 - r6)/8;
-	int sp14 = r1;
-	int sp18 = (r4 * 8) - sp1C;
-	for (int sp14 = r1; sp14 != 0; sp14--)
-	{
-		for (int sp10 = sp1C; sp10 != 0; sp10--)
-		{
-			int * r1 = (int *)sp0C++;	// assuming (int *)sp0C
-			int r7 = *r1; r1 += r4;
-			int r6 = *r1; r1 += r4;
-			int r5 = *r1; r1 += r4;
-			int lk = *r1; r1 += r4;
-			int r12 = *r1; r1 += r4;
-			int r3 = *r1; r1 += r4;
-			int r2 = *r1; r1 += r4;
-			int r1x = *r1;
-			for (ArrayIndex r8 = 8; r8 != 0; r8--)
-			{
-				int r9 = r7 >> 28; r7 <<= 4;
-				r9 |= (r6 & 0xF0000000) >> 24; r6 <<= 4;
-				r9 |= (r5 & 0xF0000000) >> 20; r5 <<= 4;
-				r9 |= (lk & 0xF0000000) >> 16; lk <<= 4;
-				r9 |= (r12 & 0xF0000000) >> 12; r12 <<= 4;
-				r9 |= (r3 & 0xF0000000) >> 8; r3 <<= 4;
-				r9 |= (r2 & 0xF0000000) >> 4; r2 <<= 4;
-				r9 |= (r1x & 0xF0000000); r1x <<= 4;
-				if (inTransferMode != 0)
-					r9 |= *sp08;
-				*sp08 = r9;
-				sp08 += sp00;	// assuming int*
-			}
-		}
-		sp0C += sp18 * 4;
-		sp08 -= 4;
-	}
-}
-
-
-void
-CMainDisplayDriver::blitPortraitFlip(NativePixelMap * inPixmap, Rect * inSrcBounds, Rect * inDstBounds, int inTransferMode, int inMode)
-{
-}
-
-
 void
 CMainDisplayDriver::doubleBlit(NativePixelMap * inArg1, NativePixelMap * inPixmap, Rect * inSrcBounds, Rect * inDstBounds, int inTransferMode)
 {	/* this really does nothing */	}
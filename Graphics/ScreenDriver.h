@@ -47,7 +47,6 @@ public:
 	C M a i n D i s p l a y D r i v e r
 	LCD display driver implementation.
 ------------------------------------------------------------------------------*/
-struct BlitRec;
 
 PROTOCOL CMainDisplayDriver : public CScreenDriver
 {
@@ -76,11 +75,6 @@ public:
 	void	exitIdleMode(void);
 
 private:
-	void	blitLandscape(BlitRec * inBlit);
-	void	blitLandscapeFlip(BlitRec * inBlit);
-	void	blitPortrait(NativePixelMap * inPixmap, Rect * inSrcBounds, Rect * inDstBounds, int inTransferMode, int inMode);
-	void	blitPortraitFlip(NativePixelMap * inPixmap, Rect * inSrcBounds, Rect * inDstBounds, int inTransferMode, int inMode);
-
 	ScreenGeometry			fInfo;			// +00
 	NativePixelMap			fPixMap;			// +10
 	int						fOrientation;	// +2C
@@ -0,0 +1,2883 @@
+/*
+	File:		SoftQuartz.cc
+
+	Contains:	Software implementation of the subset of Quartz (CoreGraphics)
+					that Newton drawing uses.
+
+					Paths are held in device space (Quartz orientation, y up) as
+					they are built, so a later change to the CTM does not move them.
+					Drawing flattens them into polygons in pixel coordinates
+					(y down) and accumulates the signed area each edge covers in
+					each pixel; a running sum along a row then gives the winding
+					coverage of every pixel, which is blended into the pixel map.
+					Coverage is the clamped magnitude of the winding for the
+					nonzero rule and its distance from the nearest even number for
+					the even-odd rule -- exact for simple paths, and a union for
+					the consistently wound polygons a stroke is built from.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "Quartz.h"
+
+#if defined(forSoftQuartz)
+
+#include "NewtonWidgets.h"
+#include "Geometry.h"
+#include "Regions.h"
+#include "ViewFlags.h"
+
+#include <math.h>
+#include <string.h>
+
+#define kFlattenTolerance	0.1		// device pixels
+#define kMaxCurveSegments	64
+#define kDefaultMiterLimit	10.0
+
+
+/* -----------------------------------------------------------------------------
+	T y p e s
+----------------------------------------------------------------------------- */
+
+enum
+{
+	kSpaceGray,
+	kSpaceRGB,
+	kSpaceIndexed
+};
+
+struct CGColorSpace
+{
+	int					refCount;
+	int					model;
+	size_t				lastIndex;
+	UByte					luminance[256];		// indexed only: 0 = black .. 255 = white
+};
+
+struct CGColor
+{
+	int					refCount;
+	CGFloat				gray;
+	CGFloat				alpha;
+};
+
+struct CGDataProvider
+{
+	int					refCount;
+	void *				info;
+	const UByte *		data;
+	size_t				size;
+	CGDataProviderReleaseDataCallback	releaseProc;
+};
+
+struct CGImage
+{
+	int					refCount;
+	size_t				width;
+	size_t				height;
+	size_t				bitsPerPixel;
+	size_t				bytesPerRow;
+	CGDataProviderRef	provider;
+	UByte					darkness[256];			// sample value -> 0 = white .. 255 = black
+	CGImageRef			mask;						// its darkness is our alpha
+	int					maskLo, maskHi;		// samples in this range are transparent
+};
+
+enum
+{
+	kPathMove,
+	kPathLine,
+	kPathCurve,
+	kPathClose
+};
+
+struct PathElement
+{
+	int					op;
+	CGPoint				pt[3];
+};
+
+struct CGPath
+{
+	int					refCount;
+	ArrayIndex			count;
+	ArrayIndex			allocCount;
+	PathElement *		element;
+	CGPoint				start;
+	CGPoint				current;
+	bool					hasCurrent;
+};
+
+struct GState
+{
+	GState *				next;
+	CGAffineTransform	ctm;
+	CGFloat				fillGray, fillAlpha;
+	CGFloat				strokeGray, strokeAlpha;
+	CGFloat				alpha;
+	CGFloat				lineWidth;
+	CGLineCap			lineCap;
+	CGLineJoin			lineJoin;
+	CGFloat				miterLimit;
+	int					blendMode;
+	bool					isAntialiased;
+	bool					shouldCacheGlyphs;
+	ArrayIndex			clipCount;
+	Rect *				clip;						// disjoint, in pixel coordinates
+	Rect					clipBounds;
+	CGAffineTransform	textMatrix;
+	CGFloat				fontSize;
+	CGTextDrawingMode	textMode;
+};
+
+/* A set of closed polygons in pixel coordinates, ready to rasterise. */
+struct Flat
+{
+	ArrayIndex			count;
+	ArrayIndex			allocCount;
+	CGPoint *			pt;
+	ArrayIndex			contourCount;
+	ArrayIndex			contourAllocCount;
+	ArrayIndex *		contourEnd;				// index past the last point of each contour
+	bool *				isClosed;
+};
+
+struct CGContext
+{
+	int					refCount;
+	NativePixelMap *	pixmap;
+	GState *				gs;
+	CGPath				path;
+	Flat					flat;
+	Flat					outline;
+	float *				coverage;
+	size_t				coverageSize;
+	CGPoint				textPosition;
+};
+
+// private blend modes for the QuickDraw transfer modes, in darkness space
+enum
+{
+	kBlendQDCopy = 100,
+	kBlendQDOr,
+	kBlendQDXor,
+	kBlendQDBic,
+	kBlendQDNot = 0x100
+};
+
+
+/* -----------------------------------------------------------------------------
+	G e o m e t r y
+----------------------------------------------------------------------------- */
+
+const CGPoint					CGPointZero = { 0, 0 };
+const CGRect					CGRectZero = { { 0, 0 }, { 0, 0 } };
+const CGAffineTransform		CGAffineTransformIdentity = { 1, 0, 0, 1, 0, 0 };
+
+const char * const	kCGColorSpaceGenericGray = "kCGColorSpaceGenericGray";
+const char * const	kCGColorSpaceGenericRGB = "kCGColorSpaceGenericRGB";
+
+
+CGRect
+CGRectStandardize(CGRect inRect)
+{
+	return CGRectMake(CGRectGetMinX(inRect), CGRectGetMinY(inRect), CGRectGetWidth(inRect), CGRectGetHeight(inRect));
+}
+
+
+CGRect
+CGRectInset(CGRect inRect, CGFloat dx, CGFloat dy)
+{
+	CGRect r = CGRectStandardize(inRect);
+	r.origin.x += dx;
+	r.origin.y += dy;
+	r.size.width -= 2*dx;
+	r.size.height -= 2*dy;
+	if (r.size.width < 0 || r.size.height < 0)
+		r = CGRectZero;
+	return r;
+}
+
+
+CGRect
+CGRectOffset(CGRect inRect, CGFloat dx, CGFloat dy)
+{
+	CGRect r = CGRectStandardize(inRect);
+	r.origin.x += dx;
+	r.origin.y += dy;
+	return r;
+}
+
+
+CGRect
+CGRectIntersection(CGRect inRect1, CGRect inRect2)
+{
+	CGFloat left = MAX(CGRectGetMinX(inRect1), CGRectGetMinX(inRect2));
+	CGFloat right = MIN(CGRectGetMaxX(inRect1), CGRectGetMaxX(inRect2));
+	CGFloat bottom = MAX(CGRectGetMinY(inRect1), CGRectGetMinY(inRect2));
+	CGFloat top = MIN(CGRectGetMaxY(inRect1), CGRectGetMaxY(inRect2));
+	if (left >= right || bottom >= top)
+		return CGRectZero;
+	return CGRectMake(left, bottom, right - left, top - bottom);
+}
+
+
+CGAffineTransform
+CGAffineTransformMake(CGFloat a, CGFloat b, CGFloat c, CGFloat d, CGFloat tx, CGFloat ty)
+{
+	CGAffineTransform t;
+	t.a = a; t.b = b;
+	t.c = c; t.d = d;
+	t.tx = tx; t.ty = ty;
+	return t;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Concatenate transforms: apply t1, then t2.
+----------------------------------------------------------------------------- */
+
+CGAffineTransform
+CGAffineTransformConcat(CGAffineTransform t1, CGAffineTransform t2)
+{
+	return CGAffineTransformMake(t1.a * t2.a + t1.b * t2.c,
+										  t1.a * t2.b + t1.b * t2.d,
+										  t1.c * t2.a + t1.d * t2.c,
+										  t1.c * t2.b + t1.d * t2.d,
+										  t1.tx * t2.a + t1.ty * t2.c + t2.tx,
+										  t1.tx * t2.b + t1.ty * t2.d + t2.ty);
+}
+
+
+CGAffineTransform
+CGAffineTransformInvert(CGAffineTransform t)
+{
+	CGFloat det = t.a * t.d - t.b * t.c;
+	if (det == 0)
+		return t;
+	return CGAffineTransformMake( t.d / det, -t.b / det,
+										 -t.c / det,  t.a / det,
+										 (t.c * t.ty - t.d * t.tx) / det,
+										 (t.b * t.tx - t.a * t.ty) / det);
+}
+
+
+CGPoint
+CGPointApplyAffineTransform(CGPoint p, CGAffineTransform t)
+{
+	return CGPointMake(t.a * p.x + t.c * p.y + t.tx, t.b * p.x + t.d * p.y + t.ty);
+}
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	C o l o r
+----------------------------------------------------------------------------- */
+
+static inline CGFloat
+Clamp01(CGFloat inValue)
+{
+	return inValue < 0 ? 0 : (inValue > 1 ? 1 : inValue);
+}
+
+
+static inline CGFloat
+Luminance(CGFloat inRed, CGFloat inGreen, CGFloat inBlue)
+{
+	return 0.299 * Clamp01(inRed) + 0.587 * Clamp01(inGreen) + 0.114 * Clamp01(inBlue);
+}
+
+
+static CGColorSpaceRef
+NewColorSpace(int inModel)
+{
+	CGColorSpaceRef space = new CGColorSpace;
+	space->refCount = 1;
+	space->model = inModel;
+	space->lastIndex = 0;
+	return space;
+}
+
+
+CGColorSpaceRef
+CGColorSpaceCreateWithName(const char * inName)
+{
+	return NewColorSpace(strcmp(inName, kCGColorSpaceGenericRGB) == 0 ? kSpaceRGB : kSpaceGray);
+}
+
+
+CGColorSpaceRef
+CGColorSpaceCreateDeviceGray(void)
+{
+	return NewColorSpace(kSpaceGray);
+}
+
+
+CGColorSpaceRef
+CGColorSpaceCreateDeviceRGB(void)
+{
+	return NewColorSpace(kSpaceRGB);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Create an indexed colour space.
+	The table holds one entry of base colour space components per index; we
+	keep just the luminance of each.
+----------------------------------------------------------------------------- */
+
+CGColorSpaceRef
+CGColorSpaceCreateIndexed(CGColorSpaceRef inBase, size_t inLastIndex, const unsigned char * inTable)
+{
+	if (inBase == NULL || inBase->model == kSpaceIndexed || inTable == NULL || inLastIndex > 255)
+		return NULL;
+
+	CGColorSpaceRef space = NewColorSpace(kSpaceIndexed);
+	space->lastIndex = inLastIndex;
+	for (ArrayIndex i = 0; i < 256; ++i)
+	{
+		ArrayIndex index = MIN(i, inLastIndex);
+		if (inBase->model == kSpaceRGB)
+		{
+			const unsigned char * rgb = inTable + index * 3;
+			space->luminance[i] = (299 * rgb[0] + 587 * rgb[1] + 114 * rgb[2] + 500) / 1000;
+		}
+		else
+			space->luminance[i] = inTable[index];
+	}
+	return space;
+}
+
+
+CGColorSpaceRef
+CGColorSpaceRetain(CGColorSpaceRef inSpace)
+{
+	if (inSpace)
+		inSpace->refCount++;
+	return inSpace;
+}
+
+
+void
+CGColorSpaceRelease(CGColorSpaceRef inSpace)
+{
+	if (inSpace && --inSpace->refCount == 0)
+		delete inSpace;
+}
+
+
+CGColorRef
+CGColorCreate(CGColorSpaceRef inSpace, const CGFloat * inComponents)
+{
+	if (inSpace == NULL || inComponents == NULL)
+		return NULL;
+	if (inSpace->model == kSpaceRGB)
+		return CGColorCreateGenericRGB(inComponents[0], inComponents[1], inComponents[2], inComponents[3]);
+	if (inSpace->model == kSpaceGray)
+		return CGColorCreateGenericGray(inComponents[0], inComponents[1]);
+	return NULL;
+}
+
+
+CGColorRef
+CGColorCreateGenericGray(CGFloat inGray, CGFloat inAlpha)
+{
+	CGColorRef color = new CGColor;
+	color->refCount = 1;
+	color->gray = Clamp01(inGray);
+	color->alpha = Clamp01(inAlpha);
+	return color;
+}
+
+
+CGColorRef
+CGColorCreateGenericRGB(CGFloat inRed, CGFloat inGreen, CGFloat inBlue, CGFloat inAlpha)
+{
+	return CGColorCreateGenericGray(Luminance(inRed, inGreen, inBlue), inAlpha);
+}
+
+
+CGColorRef
+CGColorRetain(CGColorRef inColor)
+{
+	if (inColor)
+		inColor->refCount++;
+	return inColor;
+}
+
+
+void
+CGColorRelease(CGColorRef inColor)
+{
+	if (inColor && --inColor->refCount == 0)
+		delete inColor;
+}
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	I m a g e s
+----------------------------------------------------------------------------- */
+
+CGDataProviderRef
+CGDataProviderCreateWithData(void * info, const void * inData, size_t inSize, CGDataProviderReleaseDataCallback inReleaseProc)
+{
+	CGDataProviderRef provider = new CGDataProvider;
+	provider->refCount = 1;
+	provider->info = info;
+	provider->data = (const UByte *)inData;
+	provider->size = inSize;
+	provider->releaseProc = inReleaseProc;
+	return provider;
+}
+
+
+CGDataProviderRef
+CGDataProviderRetain(CGDataProviderRef inProvider)
+{
+	if (inProvider)
+		inProvider->refCount++;
+	return inProvider;
+}
+
+
+void
+CGDataProviderRelease(CGDataProviderRef inProvider)
+{
+	if (inProvider && --inProvider->refCount == 0)
+	{
+		if (inProvider->releaseProc)
+			inProvider->releaseProc(inProvider->info, inProvider->data, inProvider->size);
+		delete inProvider;
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Create an image.
+	We handle gray and indexed samples of 1, 2, 4 or 8 bits with no alpha,
+	which is everything Newton pixel maps can hold.
+----------------------------------------------------------------------------- */
+
+CGImageRef
+CGImageCreate(size_t inWidth, size_t inHeight, size_t inBitsPerComponent, size_t inBitsPerPixel, size_t inBytesPerRow,
+				  CGColorSpaceRef inSpace, CGBitmapInfo inBitmapInfo, CGDataProviderRef inProvider,
+				  const CGFloat * inDecode, bool inShouldInterpolate, CGColorRenderingIntent inIntent)
+{
+	if (inSpace == NULL || inSpace->model == kSpaceRGB || inProvider == NULL
+	||  inBitsPerPixel != inBitsPerComponent
+	||  (inBitsPerPixel != 1 && inBitsPerPixel != 2 && inBitsPerPixel != 4 && inBitsPerPixel != 8)
+	||  inBytesPerRow * 8 < inWidth * inBitsPerPixel)
+		return NULL;
+
+	CGImageRef image = new CGImage;
+	image->refCount = 1;
+	image->width = inWidth;
+	image->height = inHeight;
+	image->bitsPerPixel = inBitsPerPixel;
+	image->bytesPerRow = inBytesPerRow;
+	image->provider = CGDataProviderRetain(inProvider);
+	image->mask = NULL;
+	image->maskLo = 1;
+	image->maskHi = 0;
+
+	int maxSample = (1 << inBitsPerPixel) - 1;
+	for (int i = 0; i < 256; ++i)
+	{
+		int sample = MIN(i, maxSample);
+		int luminance = (inSpace->model == kSpaceIndexed) ? inSpace->luminance[sample] : (sample * 255) / maxSample;
+		image->darkness[i] = 255 - luminance;
+	}
+	return image;
+}
+
+
+CGImageRef
+CGImageCreateWithMask(CGImageRef inImage, CGImageRef inMask)
+{
+	if (inImage == NULL || inMask == NULL || inImage->mask != NULL)
+		return NULL;
+
+	CGImageRef image = new CGImage;
+	*image = *inImage;
+	image->refCount = 1;
+	CGDataProviderRetain(image->provider);
+	image->mask = CGImageRetain(inMask);
+	return image;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Create an image in which samples within a range are transparent.
+	Our images have a single component -- gray level or colour table index.
+----------------------------------------------------------------------------- */
+
+CGImageRef
+CGImageCreateWithMaskingColors(CGImageRef inImage, const CGFloat * inComponents)
+{
+	if (inImage == NULL || inComponents == NULL || inImage->mask != NULL)
+		return NULL;
+
+	CGImageRef image = new CGImage;
+	*image = *inImage;
+	image->refCount = 1;
+	CGDataProviderRetain(image->provider);
+	image->maskLo = (int)inComponents[0];
+	image->maskHi = (int)inComponents[1];
+	return image;
+}
+
+
+CGImageRef
+CGImageCreateWithPNGDataProvider(CGDataProviderRef inSource, const CGFloat * inDecode, bool inShouldInterpolate, CGColorRenderingIntent inIntent)
+{
+	return NULL;
+}
+
+
+CGImageRef
+CGImageRetain(CGImageRef inImage)
+{
+	if (inImage)
+		inImage->refCount++;
+	return inImage;
+}
+
+
+void
+CGImageRelease(CGImageRef inImage)
+{
+	if (inImage && --inImage->refCount == 0)
+	{
+		CGImageRelease(inImage->mask);
+		CGDataProviderRelease(inImage->provider);
+		delete inImage;
+	}
+}
+
+
+size_t
+CGImageGetWidth(CGImageRef inImage)
+{
+	return inImage ? inImage->width : 0;
+}
+
+
+size_t
+CGImageGetHeight(CGImageRef inImage)
+{
+	return inImage ? inImage->height : 0;
+}
+
+
+static inline int
+GetSample(CGImageRef inImage, size_t x, size_t y)
+{
+	size_t offset = y * inImage->bytesPerRow + ((x * inImage->bitsPerPixel) >> 3);
+	if (offset >= inImage->provider->size)
+		return -1;
+	int depth = inImage->bitsPerPixel;
+	int shift = 8 - depth - ((x * depth) & 7);
+	return (inImage->provider->data[offset] >> shift) & ((1 << depth) - 1);
+}
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	P a t h s
+----------------------------------------------------------------------------- */
+
+static void
+InitPath(CGPath * ioPath)
+{
+	ioPath->refCount = 1;
+	ioPath->count = 0;
+	ioPath->allocCount = 0;
+	ioPath->element = NULL;
+	ioPath->hasCurrent = false;
+}
+
+
+static void
+AddElement(CGPath * ioPath, int inOp, CGPoint inPt0, CGPoint inPt1, CGPoint inPt2)
+{
+	if (ioPath->count == ioPath->allocCount)
+	{
+		ArrayIndex newCount = ioPath->allocCount ? ioPath->allocCount * 2 : 16;
+		PathElement * newElement = new PathElement[newCount];
+		if (ioPath->count > 0)
+			memcpy(newElement, ioPath->element, ioPath->count * sizeof(PathElement));
+		if (ioPath->element)
+			delete[] ioPath->element;
+		ioPath->element = newElement;
+		ioPath->allocCount = newCount;
+	}
+	PathElement * element = &ioPath->element[ioPath->count++];
+	element->op = inOp;
+	element->pt[0] = inPt0;
+	element->pt[1] = inPt1;
+	element->pt[2] = inPt2;
+}
+
+
+static void
+PathMoveTo(CGPath * ioPath, CGPoint inPt)
+{
+	// consecutive moves replace one another
+	if (ioPath->count > 0 && ioPath->element[ioPath->count - 1].op == kPathMove)
+		ioPath->count--;
+	AddElement(ioPath, kPathMove, inPt, inPt, inPt);
+	ioPath->start = ioPath->current = inPt;
+	ioPath->hasCurrent = true;
+}
+
+
+static void
+PathLineTo(CGPath * ioPath, CGPoint inPt)
+{
+	if (!ioPath->hasCurrent)
+		PathMoveTo(ioPath, inPt);
+	else
+	{
+		AddElement(ioPath, kPathLine, inPt, inPt, inPt);
+		ioPath->current = inPt;
+	}
+}
+
+
+static void
+PathCurveTo(CGPath * ioPath, CGPoint inCp1, CGPoint inCp2, CGPoint inPt)
+{
+	if (!ioPath->hasCurrent)
+		PathMoveTo(ioPath, inCp1);
+	AddElement(ioPath, kPathCurve, inCp1, inCp2, inPt);
+	ioPath->current = inPt;
+}
+
+
+static void
+PathClose(CGPath * ioPath)
+{
+	if (ioPath->hasCurrent && ioPath->count > 0 && ioPath->element[ioPath->count - 1].op != kPathClose)
+	{
+		AddElement(ioPath, kPathClose, ioPath->start, ioPath->start, ioPath->start);
+		ioPath->current = ioPath->start;
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Add an ellipse to a path as four cubic Bezier curves, transformed by
+	inTransform. Quartz starts at the rightmost point and runs
+	counterclockwise.
+----------------------------------------------------------------------------- */
+
+static void
+PathAddEllipse(CGPath * ioPath, const CGAffineTransform & inTransform, CGRect inRect)
+{
+	const CGFloat kappa = 0.5522847498;
+	CGFloat cx = CGRectGetMidX(inRect), cy = CGRectGetMidY(inRect);
+	CGFloat rx = CGRectGetWidth(inRect) / 2, ry = CGRectGetHeight(inRect) / 2;
+	CGFloat kx = rx * kappa, ky = ry * kappa;
+	const CGAffineTransform & t = inTransform;
+
+	PathMoveTo(ioPath, CGPointApplyAffineTransform(CGPointMake(cx + rx, cy), t));
+	PathCurveTo(ioPath, CGPointApplyAffineTransform(CGPointMake(cx + rx, cy + ky), t),
+							  CGPointApplyAffineTransform(CGPointMake(cx + kx, cy + ry), t),
+							  CGPointApplyAffineTransform(CGPointMake(cx, cy + ry), t));
+	PathCurveTo(ioPath, CGPointApplyAffineTransform(CGPointMake(cx - kx, cy + ry), t),
+							  CGPointApplyAffineTransform(CGPointMake(cx - rx, cy + ky), t),
+							  CGPointApplyAffineTransform(CGPointMake(cx - rx, cy), t));
+	PathCurveTo(ioPath, CGPointApplyAffineTransform(CGPointMake(cx - rx, cy - ky), t),
+							  CGPointApplyAffineTransform(CGPointMake(cx - kx, cy - ry), t),
+							  CGPointApplyAffineTransform(CGPointMake(cx, cy - ry), t));
+	PathCurveTo(ioPath, CGPointApplyAffineTransform(CGPointMake(cx + kx, cy - ry), t),
+							  CGPointApplyAffineTransform(CGPointMake(cx + rx, cy - ky), t),
+							  CGPointApplyAffineTransform(CGPointMake(cx + rx, cy), t));
+	PathClose(ioPath);
+}
+
+
+static void
+PathAddRect(CGPath * ioPath, const CGAffineTransform & inTransform, CGRect inRect)
+{
+	CGFloat left = CGRectGetMinX(inRect), right = CGRectGetMaxX(inRect);
+	CGFloat bottom = CGRectGetMinY(inRect), top = CGRectGetMaxY(inRect);
+	PathMoveTo(ioPath, CGPointApplyAffineTransform(CGPointMake(left, bottom), inTransform));
+	PathLineTo(ioPath, CGPointApplyAffineTransform(CGPointMake(right, bottom), inTransform));
+	PathLineTo(ioPath, CGPointApplyAffineTransform(CGPointMake(right, top), inTransform));
+	PathLineTo(ioPath, CGPointApplyAffineTransform(CGPointMake(left, top), inTransform));
+	PathClose(ioPath);
+}
+
+
+CGMutablePathRef
+CGPathCreateMutable(void)
+{
+	CGMutablePathRef path = new CGPath;
+	InitPath(path);
+	return path;
+}
+
+
+void
+CGPathRelease(CGPathRef inPath)
+{
+	CGMutablePathRef path = (CGMutablePathRef)inPath;
+	if (path && --path->refCount == 0)
+	{
+		if (path->element)
+			delete[] path->element;
+		delete path;
+	}
+}
+
+
+void
+CGPathMoveToPoint(CGMutablePathRef inPath, const CGAffineTransform * m, CGFloat x, CGFloat y)
+{
+	CGPoint p = CGPointMake(x, y);
+	PathMoveTo(inPath, m ? CGPointApplyAffineTransform(p, *m) : p);
+}
+
+
+void
+CGPathAddLineToPoint(CGMutablePathRef inPath, const CGAffineTransform * m, CGFloat x, CGFloat y)
+{
+	CGPoint p = CGPointMake(x, y);
+	PathLineTo(inPath, m ? CGPointApplyAffineTransform(p, *m) : p);
+}
+
+
+void
+CGPathAddCurveToPoint(CGMutablePathRef inPath, const CGAffineTransform * m, CGFloat cp1x, CGFloat cp1y, CGFloat cp2x, CGFloat cp2y, CGFloat x, CGFloat y)
+{
+	const CGAffineTransform & t = m ? *m : CGAffineTransformIdentity;
+	PathCurveTo(inPath, CGPointApplyAffineTransform(CGPointMake(cp1x, cp1y), t),
+							  CGPointApplyAffineTransform(CGPointMake(cp2x, cp2y), t),
+							  CGPointApplyAffineTransform(CGPointMake(x, y), t));
+}
+
+
+void
+CGPathAddRect(CGMutablePathRef inPath, const CGAffineTransform * m, CGRect inRect)
+{
+	PathAddRect(inPath, m ? *m : CGAffineTransformIdentity, inRect);
+}
+
+
+void
+CGPathAddEllipseInRect(CGMutablePathRef inPath, const CGAffineTransform * m, CGRect inRect)
+{
+	PathAddEllipse(inPath, m ? *m : CGAffineTransformIdentity, inRect);
+}
+
+
+void
+CGPathCloseSubpath(CGMutablePathRef inPath)
+{
+	PathClose(inPath);
+}
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	F l a t t e n i n g
+	Paths are flattened into polygons in pixel coordinates: y runs down from
+	the top of the pixel map.
+----------------------------------------------------------------------------- */
+
+static void
+InitFlat(Flat * ioFlat)
+{
+	ioFlat->count = ioFlat->allocCount = 0;
+	ioFlat->pt = NULL;
+	ioFlat->contourCount = ioFlat->contourAllocCount = 0;
+	ioFlat->contourEnd = NULL;
+	ioFlat->isClosed = NULL;
+}
+
+
+static void
+FreeFlat(Flat * ioFlat)
+{
+	if (ioFlat->pt)
+		delete[] ioFlat->pt;
+	if (ioFlat->contourEnd)
+		delete[] ioFlat->contourEnd;
+	if (ioFlat->isClosed)
+		delete[] ioFlat->isClosed;
+	InitFlat(ioFlat);
+}
+
+
+static void
+FlatAddPoint(Flat * ioFlat, CGPoint inPt)
+{
+	// drop repeated points -- they have no direction for stroking -- and
+	// anything a degenerate transform has made infinite
+	if (!isfinite(inPt.x) || !isfinite(inPt.y))
+		return;
+	ArrayIndex contourStart = ioFlat->contourCount > 0 ? ioFlat->contourEnd[ioFlat->contourCount - 1] : 0;
+	if (ioFlat->count > contourStart)
+	{
+		CGPoint last = ioFlat->pt[ioFlat->count - 1];
+		if (last.x == inPt.x && last.y == inPt.y)
+			return;
+	}
+	if (ioFlat->count == ioFlat->allocCount)
+	{
+		ArrayIndex newCount = ioFlat->allocCount ? ioFlat->allocCount * 2 : 256;
+		CGPoint * newPt = new CGPoint[newCount];
+		if (ioFlat->count > 0)
+			memcpy(newPt, ioFlat->pt, ioFlat->count * sizeof(CGPoint));
+		if (ioFlat->pt)
+			delete[] ioFlat->pt;
+		ioFlat->pt = newPt;
+		ioFlat->allocCount = newCount;
+	}
+	ioFlat->pt[ioFlat->count++] = inPt;
+}
+
+
+static void
+FlatEndContour(Flat * ioFlat, bool inIsClosed)
+{
+	ArrayIndex contourStart = ioFlat->contourCount > 0 ? ioFlat->contourEnd[ioFlat->contourCount - 1] : 0;
+	if (ioFlat->count == contourStart)
+		return;
+
+	if (ioFlat->contourCount == ioFlat->contourAllocCount)
+	{
+		ArrayIndex newCount = ioFlat->contourAllocCount ? ioFlat->contourAllocCount * 2 : 16;
+		ArrayIndex * newEnd = new ArrayIndex[newCount];
+		bool * newClosed = new bool[newCount];
+		if (ioFlat->contourCount > 0)
+		{
+			memcpy(newEnd, ioFlat->contourEnd, ioFlat->contourCount * sizeof(ArrayIndex));
+			memcpy(newClosed, ioFlat->isClosed, ioFlat->contourCount * sizeof(bool));
+		}
+		if (ioFlat->contourEnd)
+			delete[] ioFlat->contourEnd;
+		if (ioFlat->isClosed)
+			delete[] ioFlat->isClosed;
+		ioFlat->contourEnd = newEnd;
+		ioFlat->isClosed = newClosed;
+		ioFlat->contourAllocCount = newCount;
+	}
+	ioFlat->contourEnd[ioFlat->contourCount] = ioFlat->count;
+	ioFlat->isClosed[ioFlat->contourCount] = inIsClosed;
+	ioFlat->contourCount++;
+}
+
+
+static inline CGPoint
+ToPixel(CGPoint inPt, int inHeight)
+{
+	return CGPointMake(inPt.x, inHeight - inPt.y);
+}
+
+
+static void
+FlattenCurve(Flat * ioFlat, CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3)
+{
+	// the number of segments needed to keep within the tolerance depends on the second difference
+	CGFloat ddx = MAX(fabsf(p0.x - 2*p1.x + p2.x), fabsf(p1.x - 2*p2.x + p3.x));
+	CGFloat ddy = MAX(fabsf(p0.y - 2*p1.y + p2.y), fabsf(p1.y - 2*p2.y + p3.y));
+	CGFloat dd = sqrtf(ddx*ddx + ddy*ddy);
+	int n = (int)ceilf(sqrtf(dd * 0.75 / kFlattenTolerance));
+	if (n < 1)
+		n = 1;
+	else if (n > kMaxCurveSegments)
+		n = kMaxCurveSegments;
+
+	for (int i = 1; i <= n; ++i)
+	{
+		CGFloat t = (CGFloat)i / n, u = 1 - t;
+		CGFloat a = u*u*u, b = 3*u*u*t, c = 3*u*t*t, d = t*t*t;
+		FlatAddPoint(ioFlat, CGPointMake(a*p0.x + b*p1.x + c*p2.x + d*p3.x, a*p0.y + b*p1.y + c*p2.y + d*p3.y));
+	}
+}
+
+
+static void
+FlattenPath(const CGPath * inPath, int inHeight, Flat * outFlat)
+{
+	outFlat->count = 0;
+	outFlat->contourCount = 0;
+
+	CGPoint current = CGPointZero;
+	for (ArrayIndex i = 0; i < inPath->count; ++i)
+	{
+		const PathElement * element = &inPath->element[i];
+		switch (element->op)
+		{
+		case kPathMove:
+			FlatEndContour(outFlat, false);
+			current = ToPixel(element->pt[0], inHeight);
+			FlatAddPoint(outFlat, current);
+			break;
+		case kPathLine:
+			current = ToPixel(element->pt[0], inHeight);
+			FlatAddPoint(outFlat, current);
+			break;
+		case kPathCurve:
+			{
+				CGPoint p3 = ToPixel(element->pt[2], inHeight);
+				FlattenCurve(outFlat, current, ToPixel(element->pt[0], inHeight), ToPixel(element->pt[1], inHeight), p3);
+				current = p3;
+			}
+			break;
+		case kPathClose:
+			FlatEndContour(outFlat, true);
+			current = ToPixel(element->pt[0], inHeight);
+			break;
+		}
+	}
+	FlatEndContour(outFlat, false);
+}
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	S t r o k i n g
+	Each segment, join and cap becomes a small convex polygon, wound the same
+	way so that the rasteriser's nonzero rule gives their union.
+----------------------------------------------------------------------------- */
+
+static void
+AddConvexPolygon(Flat * ioFlat, const CGPoint * inPt, ArrayIndex inCount)
+{
+	CGFloat area = 0;
+	for (ArrayIndex i = 0, j = inCount - 1; i < inCount; j = i++)
+		area += (inPt[j].x - inPt[i].x) * (inPt[j].y + inPt[i].y);
+	if (area == 0)
+		return;
+	if (area > 0)
+		for (ArrayIndex i = 0; i < inCount; ++i)
+			FlatAddPoint(ioFlat, inPt[i]);
+	else
+		for (ArrayIndex i = inCount; i > 0; --i)
+			FlatAddPoint(ioFlat, inPt[i - 1]);
+	FlatEndContour(ioFlat, true);
+}
+
+
+static void
+AddDisc(Flat * ioFlat, CGPoint inCentre, CGFloat inRadius)
+{
+	CGPoint pt[kMaxCurveSegments];
+	int n = 8 + (int)(inRadius * 4);
+	if (n > kMaxCurveSegments)
+		n = kMaxCurveSegments;
+	for (int i = 0; i < n; ++i)
+	{
+		CGFloat angle = (2 * M_PI * i) / n;
+		pt[i] = CGPointMake(inCentre.x + inRadius * cosf(angle), inCentre.y + inRadius * sinf(angle));
+	}
+	AddConvexPolygon(ioFlat, pt, n);
+}
+
+
+static void
+AddJoin(Flat * ioFlat, const GState * inGS, CGPoint p, CGPoint d0, CGPoint d1, CGFloat hw)
+{
+	CGFloat cross = d0.x * d1.y - d0.y * d1.x;
+	CGFloat dot = d0.x * d1.x + d0.y * d1.y;
+	if (fabsf(cross) < 1e-6 && dot > 0)
+		return;	// straight on
+
+	if (inGS->lineJoin == kCGLineJoinRound)
+	{
+		AddDisc(ioFlat, p, hw);
+		return;
+	}
+
+	// the outside of the turn
+	CGFloat s = (cross > 0) ? -hw : hw;
+	CGPoint pt[4];
+	pt[0] = p;
+	pt[1] = CGPointMake(p.x - d0.y * s, p.y + d0.x * s);
+	pt[3] = CGPointMake(p.x - d1.y * s, p.y + d1.x * s);
+	if (inGS->lineJoin == kCGLineJoinMiter && dot > -0.9999
+	&&  1 / sqrtf((1 + dot) / 2) <= inGS->miterLimit)
+	{
+		CGFloat k = s / (1 + dot);
+		pt[2] = CGPointMake(p.x - (d0.y + d1.y) * k, p.y + (d0.x + d1.x) * k);
+		AddConvexPolygon(ioFlat, pt, 4);
+	}
+	else
+	{
+		pt[2] = pt[3];
+		AddConvexPolygon(ioFlat, pt, 3);
+	}
+}
+
+
+static void
+AddCap(Flat * ioFlat, const GState * inGS, CGPoint p, CGPoint d, CGFloat hw)
+{
+	// d points out of the line
+	if (inGS->lineCap == kCGLineCapRound)
+		AddDisc(ioFlat, p, hw);
+	else if (inGS->lineCap == kCGLineCapSquare)
+	{
+		CGPoint pt[4];
+		pt[0] = CGPointMake(p.x - d.y * hw, p.y + d.x * hw);
+		pt[1] = CGPointMake(pt[0].x + d.x * hw, pt[0].y + d.y * hw);
+		pt[3] = CGPointMake(p.x + d.y * hw, p.y - d.x * hw);
+		pt[2] = CGPointMake(pt[3].x + d.x * hw, pt[3].y + d.y * hw);
+		AddConvexPolygon(ioFlat, pt, 4);
+	}
+}
+
+
+static inline CGPoint
+Direction(CGPoint inFrom, CGPoint inTo)
+{
+	CGFloat dx = inTo.x - inFrom.x, dy = inTo.y - inFrom.y;
+	CGFloat len = sqrtf(dx*dx + dy*dy);
+	return CGPointMake(dx / len, dy / len);
+}
+
+
+static void
+StrokeFlat(const Flat * inFlat, const GState * inGS, CGFloat hw, Flat * outFlat)
+{
+	outFlat->count = 0;
+	outFlat->contourCount = 0;
+
+	ArrayIndex start = 0;
+	for (ArrayIndex c = 0; c < inFlat->contourCount; start = inFlat->contourEnd[c++])
+	{
+		const CGPoint * pt = inFlat->pt + start;
+		ArrayIndex n = inFlat->contourEnd[c] - start;
+		bool isClosed = inFlat->isClosed[c];
+		if (isClosed && n > 2 && pt[n-1].x == pt[0].x && pt[n-1].y == pt[0].y)
+			n--;
+
+		if (n == 1)
+		{
+			// a zero-length subpath only shows its caps
+			if (inGS->lineCap != kCGLineCapButt)
+			{
+				AddCap(outFlat, inGS, pt[0], CGPointMake(1, 0), hw);
+				AddCap(outFlat, inGS, pt[0], CGPointMake(-1, 0), hw);
+			}
+			continue;
+		}
+
+		ArrayIndex segCount = isClosed ? n : n - 1;
+		for (ArrayIndex i = 0; i < segCount; ++i)
+		{
+			CGPoint p0 = pt[i], p1 = pt[(i + 1) % n];
+			CGPoint d = Direction(p0, p1);
+			CGPoint quad[4];
+			quad[0] = CGPointMake(p0.x - d.y * hw, p0.y + d.x * hw);
+			quad[1] = CGPointMake(p1.x - d.y * hw, p1.y + d.x * hw);
+			quad[2] = CGPointMake(p1.x + d.y * hw, p1.y - d.x * hw);
+			quad[3] = CGPointMake(p0.x + d.y * hw, p0.y - d.x * hw);
+			AddConvexPolygon(outFlat, quad, 4);
+
+			if (i + 1 < segCount || isClosed)
+			{
+				CGPoint p2 = pt[(i + 2) % n];
+				AddJoin(outFlat, inGS, p1, d, Direction(p1, p2), hw);
+			}
+		}
+		if (!isClosed)
+		{
+			AddCap(outFlat, inGS, pt[0], Direction(pt[1], pt[0]), hw);
+			AddCap(outFlat, inGS, pt[n-1], Direction(pt[n-2], pt[n-1]), hw);
+		}
+	}
+}
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	P i x e l s
+	We blend in darkness space, 0 = white .. 255 = black, which is the way
+	round Newton pixel values run.
+----------------------------------------------------------------------------- */
+
+static inline int
+Blend(int inMode, int S, int D)
+{
+	if (inMode & kBlendQDNot)
+		S = 255 - S;
+	switch (inMode & ~kBlendQDNot)
+	{
+	case kCGBlendModeMultiply:		return S + D - (S * D) / 255;
+	case kCGBlendModeScreen:		return (S * D) / 255;
+	case kCGBlendModeDarken:
+	case kBlendQDOr:					return MAX(S, D);
+	case kCGBlendModeLighten:		return MIN(S, D);
+	case kCGBlendModeDifference:	return 255 - (S > D ? S - D : D - S);
+	case kBlendQDXor:					return S > D ? S - D : D - S;
+	case kBlendQDBic:					return MIN(D, 255 - S);
+	}
+	return S;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Blend a run of pixels.
+	Args:		inRow			first byte of the pixel map row
+				inDepth		bits per pixel
+				x				first pixel
+				inCount		number of pixels
+				inCoverage	per pixel coverage, 0..1; NULL => all 1
+				inDarkness	per pixel source darkness; NULL => inSrc for all
+				inSrc			source darkness
+				inAlpha		source alpha, 0..256
+				inMode		blend mode
+	Return:	--
+----------------------------------------------------------------------------- */
+
+static void
+BlendRun(UByte * inRow, int inDepth, int x, int inCount, const float * inCoverage, const short * inDarkness, int inSrc, int inAlpha, int inMode)
+{
+	int maxValue = (1 << inDepth) - 1;
+	for (int i = 0; i < inCount; ++i, ++x)
+	{
+		int alpha = inAlpha;
+		if (inCoverage)
+			alpha = (int)(inCoverage[i] * inAlpha + 0.5);
+		int src = inDarkness ? inDarkness[i] : inSrc;
+		if (alpha <= 0 || src < 0)
+			continue;
+
+		UByte * p = inRow + ((x * inDepth) >> 3);
+		int shift = 8 - inDepth - ((x * inDepth) & 7);
+		int value = (*p >> shift) & maxValue;
+		int D = (value * 255) / maxValue;
+		int B = Blend(inMode, src, D);
+		int result = (alpha >= 256) ? B : D + (((B - D) * alpha) >> 8);
+		value = (result * maxValue + 127) / 255;
+		*p = (*p & ~(maxValue << shift)) | (value << shift);
+	}
+}
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	R a s t e r i s i n g
+----------------------------------------------------------------------------- */
+
+/* SectRect succeeds for rects that merely touch; we want some pixels. */
+static inline bool
+SectPixels(const Rect * inRect1, const Rect * inRect2, Rect * outRect)
+{
+	return SectRect(inRect1, inRect2, outRect) && outRect->left < outRect->right && outRect->top < outRect->bottom;
+}
+
+struct Raster
+{
+	float *	acc;
+	int		width;		// of the area being rasterised; acc rows are width+2 long
+	int		height;
+	CGFloat	left;			// pixel coordinates of the area
+	CGFloat	top;
+};
+
+
+/* -----------------------------------------------------------------------------
+	Accumulate the signed area a line covers in each pixel it crosses.
+	Pixels to the right of the line inherit its full coverage through the
+	running sum along the row, so only the pixels it actually passes through
+	are touched. The line must lie within 0 <= x <= width.
+----------------------------------------------------------------------------- */
+
+static void
+AccumulateLine(Raster * ioRaster, CGPoint p0, CGPoint p1)
+{
+	if (p0.y == p1.y)
+		return;
+
+	CGFloat dir = 1;
+	if (p0.y > p1.y)
+	{
+		CGPoint t = p0; p0 = p1; p1 = t;
+		dir = -1;
+	}
+	if (p1.y <= 0 || p0.y >= ioRaster->height)
+		return;
+
+	int stride = ioRaster->width + 2;
+	CGFloat dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+	CGFloat x = p0.x;
+	int y = 0;
+	if (p0.y < 0)
+		x -= p0.y * dxdy;
+	else
+		y = (int)p0.y;
+	int yLimit = MIN(ioRaster->height, (int)ceilf(p1.y));
+
+	for ( ; y < yLimit; ++y)
+	{
+		float * row = ioRaster->acc + y * stride;
+		CGFloat dy = MIN((CGFloat)(y + 1), p1.y) - MAX((CGFloat)y, p0.y);
+		CGFloat xNext = x + dxdy * dy;
+		CGFloat d = dy * dir;
+		CGFloat xa = x, xb = xNext;
+		if (xa > xb) { CGFloat t = xa; xa = xb; xb = t; }
+		// guard against rounding carrying us outside the raster
+		if (xa < 0) xa = 0;
+		if (xb > ioRaster->width) xb = ioRaster->width;
+		if (xb < xa) xb = xa;
+		CGFloat xaFloor = floorf(xa);
+		int xai = (int)xaFloor;
+		CGFloat xbCeil = ceilf(xb);
+		int xbi = (int)xbCeil;
+
+		if (xbi <= xai + 1)
+		{
+			// within one pixel
+			CGFloat xm = 0.5 * (xa + xb) - xaFloor;
+			row[xai] += d - d * xm;
+			row[xai + 1] += d * xm;
+		}
+		else
+		{
+			CGFloat s = 1 / (xb - xa);
+			CGFloat xaf = xa - xaFloor;
+			CGFloat a0 = 0.5 * s * (1 - xaf) * (1 - xaf);
+			CGFloat xbf = xb - xbCeil + 1;
+			CGFloat am = 0.5 * s * xbf * xbf;
+			row[xai] += d * a0;
+			if (xbi == xai + 2)
+				row[xai + 1] += d * (1 - a0 - am);
+			else
+			{
+				CGFloat a1 = s * (1.5 - xaf);
+				row[xai + 1] += d * (a1 - a0);
+				for (int xi = xai + 2; xi < xbi - 1; ++xi)
+					row[xi] += d * s;
+				CGFloat a2 = a1 + (xbi - xai - 3) * s;
+				row[xbi - 1] += d * (1 - a2 - am);
+			}
+			row[xbi] += d * am;
+		}
+		x = xNext;
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Add an edge, in raster-relative coordinates.
+	Anything left of the raster collapses onto its left edge, which keeps the
+	winding right; anything right of it can be dropped.
+----------------------------------------------------------------------------- */
+
+static void
+AddEdge(Raster * ioRaster, CGPoint p0, CGPoint p1)
+{
+	CGFloat right = ioRaster->width;
+	if (p0.x >= right && p1.x >= right)
+		return;
+
+	// split at the right edge
+	if ((p0.x > right) != (p1.x > right))
+	{
+		CGFloat y = p0.y + (right - p0.x) * (p1.y - p0.y) / (p1.x - p0.x);
+		CGPoint mid = CGPointMake(right, y);
+		if (p0.x > right)
+			p0 = mid;
+		else
+			p1 = mid;
+	}
+	// split at the left edge
+	if ((p0.x < 0) != (p1.x < 0))
+	{
+		CGFloat y = p0.y - p0.x * (p1.y - p0.y) / (p1.x - p0.x);
+		CGPoint mid = CGPointMake(0, y);
+		if (p0.x < 0)
+		{
+			AccumulateLine(ioRaster, CGPointMake(0, p0.y), mid);
+			p0 = mid;
+		}
+		else
+		{
+			AccumulateLine(ioRaster, mid, CGPointMake(0, p1.y));
+			p1 = mid;
+		}
+	}
+	else if (p0.x < 0)
+	{
+		p0.x = p1.x = 0;
+	}
+	AccumulateLine(ioRaster, p0, p1);
+}
+
+
+static bool
+FlatBounds(const Flat * inFlat, Rect * outBounds)
+{
+	if (inFlat->count == 0)
+		return false;
+	CGFloat left = inFlat->pt[0].x, right = left, top = inFlat->pt[0].y, bottom = top;
+	for (ArrayIndex i = 1; i < inFlat->count; ++i)
+	{
+		CGPoint p = inFlat->pt[i];
+		if (p.x < left) left = p.x; else if (p.x > right) right = p.x;
+		if (p.y < top) top = p.y; else if (p.y > bottom) bottom = p.y;
+	}
+	// NaNs fail every comparison; huge coordinates are clamped, the raster is clipped anyway
+	if (!(left <= right && top <= bottom))
+		return false;
+	left = MAX(left, -32000.0f); top = MAX(top, -32000.0f);
+	right = MIN(right, 32000.0f); bottom = MIN(bottom, 32000.0f);
+	if (left > right || top > bottom)
+		return false;
+	SetRect(outBounds, (short)floorf(left), (short)floorf(top), (short)ceilf(right) + 1, (short)ceilf(bottom) + 1);
+	return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Blend a flat colour through coverage, clipped to the current clip.
+	Args:		ctx				the context
+				inBox				pixels covered, within the clip bounds
+				inCoverage		coverage of each, 0..1, row by row
+				inRowLength		distance between rows of coverage
+				inGray			colour, 0 = black .. 1 = white
+				inAlpha			its alpha, 0..256
+	Return:	--
+----------------------------------------------------------------------------- */
+
+static void
+BlendCoverage(CGContextRef ctx, const Rect * inBox, const float * inCoverage, int inRowLength, CGFloat inGray, int inAlpha)
+{
+	GState * gs = ctx->gs;
+	NativePixelMap * pixmap = ctx->pixmap;
+	int depth = PixelDepth(pixmap);
+	int src = (int)((1 - inGray) * 255 + 0.5);
+	for (int pixY = inBox->top; pixY < inBox->bottom; ++pixY)
+	{
+		const float * row = inCoverage + (pixY - inBox->top) * inRowLength;
+		UByte * pixRow = (UByte *)PixelMapBits(pixmap) + pixY * pixmap->rowBytes;
+		for (ArrayIndex i = 0; i < gs->clipCount; ++i)
+		{
+			const Rect * r = &gs->clip[i];
+			if (pixY < r->top || pixY >= r->bottom)
+				continue;
+			int left = MAX(r->left, inBox->left), right = MIN(r->right, inBox->right);
+			if (left < right)
+				BlendRun(pixRow, depth, left, right - left, row + (left - inBox->left), NULL, src, inAlpha, gs->blendMode);
+		}
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Rasterise polygons into coverage.
+	Args:		inFlat			polygons in pixel coordinates
+				inIsEvenOdd		fill rule
+				inIsAntialiased	false => coverage is all or nothing
+				inBox				pixels to cover
+				ioCoverage		(width+2) * height zeroes; coverage of each
+									pixel, 0..1, row by row
+	Return:	--
+----------------------------------------------------------------------------- */
+
+static void
+RasteriseFlat(const Flat * inFlat, bool inIsEvenOdd, bool inIsAntialiased, const Rect * inBox, float * ioCoverage)
+{
+	Raster raster;
+	raster.width = inBox->right - inBox->left;
+	raster.height = inBox->bottom - inBox->top;
+	raster.left = inBox->left;
+	raster.top = inBox->top;
+	raster.acc = ioCoverage;
+
+	ArrayIndex start = 0;
+	for (ArrayIndex c = 0; c < inFlat->contourCount; start = inFlat->contourEnd[c++])
+	{
+		ArrayIndex end = inFlat->contourEnd[c];
+		for (ArrayIndex i = start; i < end; ++i)
+		{
+			CGPoint p0 = inFlat->pt[i];
+			CGPoint p1 = inFlat->pt[(i + 1 < end) ? i + 1 : start];
+			AddEdge(&raster, CGPointMake(p0.x - raster.left, p0.y - raster.top), CGPointMake(p1.x - raster.left, p1.y - raster.top));
+		}
+	}
+
+	for (int y = 0; y < raster.height; ++y)
+	{
+		// turn accumulated area into coverage
+		float * row = raster.acc + y * (raster.width + 2);
+		float sum = 0;
+		for (int x = 0; x < raster.width; ++x)
+		{
+			sum += row[x];
+			float cover = fabsf(sum);
+			if (inIsEvenOdd)
+			{
+				cover = fmodf(cover, 2);
+				if (cover > 1)
+					cover = 2 - cover;
+			}
+			else if (cover > 1)
+				cover = 1;
+			if (!inIsAntialiased)
+				cover = (cover >= 0.5) ? 1 : 0;
+			row[x] = cover;
+		}
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Make sure the context's coverage buffer is big enough, and clear it.
+----------------------------------------------------------------------------- */
+
+static float *
+ClearCoverage(CGContextRef ctx, size_t inSize)
+{
+	if (inSize > ctx->coverageSize)
+	{
+		if (ctx->coverage)
+			delete[] ctx->coverage;
+		ctx->coverage = new float[inSize];
+		ctx->coverageSize = inSize;
+	}
+	memset(ctx->coverage, 0, inSize * sizeof(float));
+	return ctx->coverage;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Fill polygons with a flat colour, clipped to the current clip.
+	Args:		ctx				the context
+				inFlat			polygons in pixel coordinates
+				inIsEvenOdd		fill rule
+				inGray			colour, 0 = black .. 1 = white
+				inAlpha			its alpha
+	Return:	--
+----------------------------------------------------------------------------- */
+
+static void
+FillFlat(CGContextRef ctx, const Flat * inFlat, bool inIsEvenOdd, CGFloat inGray, CGFloat inAlpha)
+{
+	GState * gs = ctx->gs;
+	int alpha = (int)(inAlpha * gs->alpha * 256 + 0.5);
+	Rect bounds, box;
+	if (alpha <= 0 || !FlatBounds(inFlat, &bounds) || !SectPixels(&bounds, &gs->clipBounds, &box))
+		return;
+
+	int rowLength = box.right - box.left + 2;
+	float * coverage = ClearCoverage(ctx, rowLength * (box.bottom - box.top));
+	RasteriseFlat(inFlat, inIsEvenOdd, gs->isAntialiased, &box, coverage);
+	BlendCoverage(ctx, &box, coverage, rowLength, inGray, alpha);
+}
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	C o n t e x t
+----------------------------------------------------------------------------- */
+
+static void
+ResetClip(CGContextRef ctx)
+{
+	GState * gs = ctx->gs;
+	if (gs->clip)
+		delete[] gs->clip;
+	gs->clip = new Rect[1];
+	gs->clipCount = 1;
+	SetRect(&gs->clip[0], 0, 0, RectGetWidth(ctx->pixmap->bounds), RectGetHeight(ctx->pixmap->bounds));
+	gs->clipBounds = gs->clip[0];
+}
+
+
+/* -----------------------------------------------------------------------------
+	Intersect the clip with a set of rects.
+	The result of intersecting two sets of disjoint rects is itself disjoint.
+----------------------------------------------------------------------------- */
+
+static void
+SectClip(CGContextRef ctx, const Rect * inRect, ArrayIndex inCount, int dh, int dv)
+{
+	GState * gs = ctx->gs;
+	Rect * newClip = new Rect[MAX(gs->clipCount * inCount, 1)];
+	ArrayIndex newCount = 0;
+	Rect newBounds;
+	SetEmptyRect(&newBounds);
+	for (ArrayIndex i = 0; i < inCount; ++i)
+	{
+		Rect r = inRect[i];
+		OffsetRect(&r, dh, dv);
+		if (!SectPixels(&r, &gs->clipBounds, &r))
+			continue;
+		for (ArrayIndex j = 0; j < gs->clipCount; ++j)
+		{
+			Rect * sect = &newClip[newCount];
+			if (SectPixels(&r, &gs->clip[j], sect))
+			{
+				if (newCount == 0)
+					newBounds = *sect;
+				else
+					UnionRect(&newBounds, sect, &newBounds);
+				newCount++;
+			}
+		}
+	}
+	delete[] gs->clip;
+	gs->clip = newClip;
+	gs->clipCount = newCount;
+	gs->clipBounds = newBounds;
+}
+
+
+CGContextRef
+CGPixelMapContextCreate(NativePixelMap * inPixmap)
+{
+	int depth = PixelDepth(inPixmap);
+	if (depth != 1 && depth != 2 && depth != 4 && depth != 8)
+		return NULL;
+
+	CGContextRef ctx = new CGContext;
+	ctx->refCount = 1;
+	ctx->pixmap = inPixmap;
+	InitPath(&ctx->path);
+	InitFlat(&ctx->flat);
+	InitFlat(&ctx->outline);
+	ctx->coverage = NULL;
+	ctx->coverageSize = 0;
+	ctx->textPosition = CGPointZero;
+
+	GState * gs = new GState;
+	gs->next = NULL;
+	gs->ctm = CGAffineTransformIdentity;
+	gs->fillGray = gs->strokeGray = 0;
+	gs->fillAlpha = gs->strokeAlpha = 1;
+	gs->alpha = 1;
+	gs->lineWidth = 1;
+	gs->lineCap = kCGLineCapButt;
+	gs->lineJoin = kCGLineJoinMiter;
+	gs->miterLimit = kDefaultMiterLimit;
+	gs->blendMode = kCGBlendModeNormal;
+	gs->isAntialiased = true;
+	gs->shouldCacheGlyphs = true;
+	gs->clip = NULL;
+	gs->textMatrix = CGAffineTransformIdentity;
+	gs->fontSize = 0;
+	gs->textMode = kCGTextFill;
+	ctx->gs = gs;
+	ResetClip(ctx);
+
+	return ctx;
+}
+
+
+NativePixelMap *
+CGPixelMapContextGetPixelMap(CGContextRef ctx)
+{
+	return ctx->pixmap;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Create an image of everything drawn into a context so far, the counterpart
+	of CGBitmapContextCreateImage. Its samples are the pixel map's own pixel
+	values, so drawing it back at the same depth is exact.
+	Unlike CGBitmapContextCreateImage the image shares the pixels rather than
+	copying them: release it before drawing into the context again.
+----------------------------------------------------------------------------- */
+
+CGImageRef
+CGPixelMapContextCreateImage(CGContextRef ctx)
+{
+	NativePixelMap * pixmap = ctx->pixmap;
+	size_t width = RectGetWidth(pixmap->bounds);
+	size_t height = RectGetHeight(pixmap->bounds);
+	CGDataProviderRef source = CGDataProviderCreateWithData(NULL, PixelMapBits(pixmap), height * pixmap->rowBytes, NULL);
+	if (source == NULL)
+		return NULL;
+
+	// Newton pixel values are already darkness: 0 is white
+	CGColorSpaceRef space = CGColorSpaceCreateDeviceGray();
+	int depth = PixelDepth(pixmap);
+	CGImageRef image = CGImageCreate(width, height, depth, depth, pixmap->rowBytes,
+												space, kCGImageAlphaNone, source,
+												NULL, false, kCGRenderingIntentDefault);
+	if (image)
+	{
+		int maxSample = (1 << depth) - 1;
+		for (int i = 0; i < 256; ++i)
+			image->darkness[i] = (MIN(i, maxSample) * 255) / maxSample;
+	}
+	CGColorSpaceRelease(space);
+	CGDataProviderRelease(source);
+	return image;
+}
+
+
+CGContextRef
+CGContextRetain(CGContextRef ctx)
+{
+	if (ctx)
+		ctx->refCount++;
+	return ctx;
+}
+
+
+void
+CGContextRelease(CGContextRef ctx)
+{
+	if (ctx && --ctx->refCount == 0)
+	{
+		for (GState * gs = ctx->gs, * next; gs != NULL; gs = next)
+		{
+			next = gs->next;
+			delete[] gs->clip;
+			delete gs;
+		}
+		if (ctx->path.element)
+			delete[] ctx->path.element;
+		FreeFlat(&ctx->flat);
+		FreeFlat(&ctx->outline);
+		if (ctx->coverage)
+			delete[] ctx->coverage;
+		delete ctx;
+	}
+}
+
+
+void
+CGContextFlush(CGContextRef ctx)
+{ }
+
+
+void
+CGContextSynchronize(CGContextRef ctx)
+{ }
+
+
+void
+CGContextSaveGState(CGContextRef ctx)
+{
+	GState * gs = new GState;
+	*gs = *ctx->gs;
+	gs->clip = new Rect[MAX(gs->clipCount, 1)];
+	memcpy(gs->clip, ctx->gs->clip, gs->clipCount * sizeof(Rect));
+	gs->next = ctx->gs;
+	ctx->gs = gs;
+}
+
+
+void
+CGContextRestoreGState(CGContextRef ctx)
+{
+	GState * gs = ctx->gs;
+	if (gs->next)
+	{
+		ctx->gs = gs->next;
+		delete[] gs->clip;
+		delete gs;
+	}
+}
+
+#pragma mark -
+
+void
+CGContextTranslateCTM(CGContextRef ctx, CGFloat tx, CGFloat ty)
+{
+	CGContextConcatCTM(ctx, CGAffineTransformMake(1, 0, 0, 1, tx, ty));
+}
+
+
+void
+CGContextScaleCTM(CGContextRef ctx, CGFloat sx, CGFloat sy)
+{
+	CGContextConcatCTM(ctx, CGAffineTransformMake(sx, 0, 0, sy, 0, 0));
+}
+
+
+void
+CGContextRotateCTM(CGContextRef ctx, CGFloat inAngle)
+{
+	CGFloat c = cosf(inAngle), s = sinf(inAngle);
+	CGContextConcatCTM(ctx, CGAffineTransformMake(c, s, -s, c, 0, 0));
+}
+
+
+void
+CGContextConcatCTM(CGContextRef ctx, CGAffineTransform inTransform)
+{
+	ctx->gs->ctm = CGAffineTransformConcat(inTransform, ctx->gs->ctm);
+}
+
+
+CGAffineTransform
+CGContextGetCTM(CGContextRef ctx)
+{
+	return ctx->gs->ctm;
+}
+
+
+void
+CGContextSetLineWidth(CGContextRef ctx, CGFloat inWidth)
+{
+	ctx->gs->lineWidth = inWidth < 0 ? 0 : inWidth;
+}
+
+
+void
+CGContextSetLineCap(CGContextRef ctx, CGLineCap inCap)
+{
+	ctx->gs->lineCap = inCap;
+}
+
+
+void
+CGContextSetLineJoin(CGContextRef ctx, CGLineJoin inJoin)
+{
+	ctx->gs->lineJoin = inJoin;
+}
+
+
+void
+CGContextSetMiterLimit(CGContextRef ctx, CGFloat inLimit)
+{
+	ctx->gs->miterLimit = inLimit;
+}
+
+
+void
+CGContextSetAlpha(CGContextRef ctx, CGFloat inAlpha)
+{
+	ctx->gs->alpha = Clamp01(inAlpha);
+}
+
+
+void
+CGContextSetBlendMode(CGContextRef ctx, CGBlendMode inMode)
+{
+	ctx->gs->blendMode = inMode;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Set a view transfer mode.
+	Args:		ctx
+				inTransferMode		modeCopy .. modeNotBic; higher bits ignored
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CGContextSetTransferMode(CGContextRef ctx, int inTransferMode)
+{
+	static const int blendMode[8] =
+	{
+		kBlendQDCopy, kBlendQDOr, kBlendQDXor, kBlendQDBic,
+		kBlendQDCopy + kBlendQDNot, kBlendQDOr + kBlendQDNot, kBlendQDXor + kBlendQDNot, kBlendQDBic + kBlendQDNot
+	};
+	ctx->gs->blendMode = blendMode[inTransferMode & (modeMask - 1)];
+}
+
+
+void
+CGContextSetShouldAntialias(CGContextRef ctx, bool inAntialias)
+{
+	ctx->gs->isAntialiased = inAntialias;
+}
+
+
+void
+CGContextSetAllowsAntialiasing(CGContextRef ctx, bool inAllows)
+{
+	ctx->gs->isAntialiased = inAllows;
+}
+
+
+void
+CGContextSetFillColorSpace(CGContextRef ctx, CGColorSpaceRef inSpace)
+{ }
+
+
+void
+CGContextSetStrokeColorSpace(CGContextRef ctx, CGColorSpaceRef inSpace)
+{ }
+
+
+void
+CGContextSetFillColorWithColor(CGContextRef ctx, CGColorRef inColor)
+{
+	if (inColor)
+		CGContextSetGrayFillColor(ctx, inColor->gray, inColor->alpha);
+}
+
+
+void
+CGContextSetStrokeColorWithColor(CGContextRef ctx, CGColorRef inColor)
+{
+	if (inColor)
+		CGContextSetGrayStrokeColor(ctx, inColor->gray, inColor->alpha);
+}
+
+
+void
+CGContextSetGrayFillColor(CGContextRef ctx, CGFloat inGray, CGFloat inAlpha)
+{
+	ctx->gs->fillGray = Clamp01(inGray);
+	ctx->gs->fillAlpha = Clamp01(inAlpha);
+}
+
+
+void
+CGContextSetGrayStrokeColor(CGContextRef ctx, CGFloat inGray, CGFloat inAlpha)
+{
+	ctx->gs->strokeGray = Clamp01(inGray);
+	ctx->gs->strokeAlpha = Clamp01(inAlpha);
+}
+
+
+void
+CGContextSetRGBFillColor(CGContextRef ctx, CGFloat inRed, CGFloat inGreen, CGFloat inBlue, CGFloat inAlpha)
+{
+	CGContextSetGrayFillColor(ctx, Luminance(inRed, inGreen, inBlue), inAlpha);
+}
+
+
+void
+CGContextSetRGBStrokeColor(CGContextRef ctx, CGFloat inRed, CGFloat inGreen, CGFloat inBlue, CGFloat inAlpha)
+{
+	CGContextSetGrayStrokeColor(ctx, Luminance(inRed, inGreen, inBlue), inAlpha);
+}
+
+
+void
+CGContextSetShadow(CGContextRef ctx, CGSize inOffset, CGFloat inBlur)
+{ }
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	P a t h   c o n s t r u c t i o n
+	Points are transformed into device space as they are added.
+----------------------------------------------------------------------------- */
+
+static inline CGPoint
+UserToDevice(CGContextRef ctx, CGFloat x, CGFloat y)
+{
+	return CGPointApplyAffineTransform(CGPointMake(x, y), ctx->gs->ctm);
+}
+
+
+void
+CGContextBeginPath(CGContextRef ctx)
+{
+	ctx->path.count = 0;
+	ctx->path.hasCurrent = false;
+}
+
+
+void
+CGContextMoveToPoint(CGContextRef ctx, CGFloat x, CGFloat y)
+{
+	PathMoveTo(&ctx->path, UserToDevice(ctx, x, y));
+}
+
+
+void
+CGContextAddLineToPoint(CGContextRef ctx, CGFloat x, CGFloat y)
+{
+	PathLineTo(&ctx->path, UserToDevice(ctx, x, y));
+}
+
+
+void
+CGContextAddCurveToPoint(CGContextRef ctx, CGFloat cp1x, CGFloat cp1y, CGFloat cp2x, CGFloat cp2y, CGFloat x, CGFloat y)
+{
+	PathCurveTo(&ctx->path, UserToDevice(ctx, cp1x, cp1y), UserToDevice(ctx, cp2x, cp2y), UserToDevice(ctx, x, y));
+}
+
+
+void
+CGContextAddQuadCurveToPoint(CGContextRef ctx, CGFloat cpx, CGFloat cpy, CGFloat x, CGFloat y)
+{
+	// raise to a cubic: control points are 2/3 of the way to the quadratic control point
+	CGAffineTransform inverse = CGAffineTransformInvert(ctx->gs->ctm);
+	CGPoint p0 = ctx->path.hasCurrent ? CGPointApplyAffineTransform(ctx->path.current, inverse) : CGPointMake(cpx, cpy);
+	CGContextAddCurveToPoint(ctx, p0.x + 2 * (cpx - p0.x) / 3, p0.y + 2 * (cpy - p0.y) / 3,
+											x + 2 * (cpx - x) / 3, y + 2 * (cpy - y) / 3,
+											x, y);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Add an arc of a circle, as cubic curves of no more than a quarter turn.
+	Angles are in radians; inClockwise is in the flipped sense Quartz uses,
+	ie clockwise on a y-up display.
+----------------------------------------------------------------------------- */
+
+void
+CGContextAddArc(CGContextRef ctx, CGFloat x, CGFloat y, CGFloat inRadius, CGFloat inStartAngle, CGFloat inEndAngle, int inClockwise)
+{
+	CGFloat sweep = inEndAngle - inStartAngle;
+	if (inClockwise)
+	{
+		while (sweep > 0) sweep -= 2 * M_PI;
+		if (sweep < -2 * M_PI) sweep = -2 * M_PI;
+	}
+	else
+	{
+		while (sweep < 0) sweep += 2 * M_PI;
+		if (sweep > 2 * M_PI) sweep = 2 * M_PI;
+	}
+
+	CGFloat a0 = inStartAngle;
+	CGPoint start = CGPointMake(x + inRadius * cosf(a0), y + inRadius * sinf(a0));
+	if (ctx->path.hasCurrent)
+		CGContextAddLineToPoint(ctx, start.x, start.y);
+	else
+		CGContextMoveToPoint(ctx, start.x, start.y);
+
+	int n = (int)ceilf(fabsf(sweep) / (M_PI / 2) - 1e-4);
+	if (n < 1)
+		return;
+	CGFloat step = sweep / n;
+	CGFloat k = 4.0 / 3.0 * tanf(step / 4) * inRadius;
+	for (int i = 0; i < n; ++i)
+	{
+		CGFloat a1 = a0 + step;
+		CGFloat c0 = cosf(a0), s0 = sinf(a0), c1 = cosf(a1), s1 = sinf(a1);
+		CGContextAddCurveToPoint(ctx, x + inRadius * c0 - k * s0, y + inRadius * s0 + k * c0,
+												x + inRadius * c1 + k * s1, y + inRadius * s1 - k * c1,
+												x + inRadius * c1, y + inRadius * s1);
+		a0 = a1;
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Add an arc tangent to the lines from the current point to (x1,y1) and
+	from (x1,y1) to (x2,y2).
+----------------------------------------------------------------------------- */
+
+void
+CGContextAddArcToPoint(CGContextRef ctx, CGFloat x1, CGFloat y1, CGFloat x2, CGFloat y2, CGFloat inRadius)
+{
+	if (!ctx->path.hasCurrent)
+	{
+		CGContextMoveToPoint(ctx, x1, y1);
+		return;
+	}
+	CGPoint p0 = CGPointApplyAffineTransform(ctx->path.current, CGAffineTransformInvert(ctx->gs->ctm));
+
+	CGFloat ax = p0.x - x1, ay = p0.y - y1;
+	CGFloat bx = x2 - x1, by = y2 - y1;
+	CGFloat la = sqrtf(ax*ax + ay*ay), lb = sqrtf(bx*bx + by*by);
+	if (la == 0 || lb == 0 || inRadius == 0)
+	{
+		CGContextAddLineToPoint(ctx, x1, y1);
+		return;
+	}
+	ax /= la; ay /= la;
+	bx /= lb; by /= lb;
+	CGFloat cross = ax * by - ay * bx;
+	if (fabsf(cross) < 1e-6)
+	{
+		CGContextAddLineToPoint(ctx, x1, y1);
+		return;
+	}
+
+	// half the angle between the lines gives the distance to the tangent points
+	CGFloat cosTheta = ax * bx + ay * by;
+	CGFloat halfAngle = atan2f(fabsf(cross), cosTheta) / 2;
+	CGFloat tangentDist = inRadius / tanf(halfAngle);
+	if (!isfinite(tangentDist))
+	{
+		CGContextAddLineToPoint(ctx, x1, y1);
+		return;
+	}
+	CGPoint t0 = CGPointMake(x1 + ax * tangentDist, y1 + ay * tangentDist);
+	CGPoint t1 = CGPointMake(x1 + bx * tangentDist, y1 + by * tangentDist);
+
+	CGFloat centreDist = inRadius / sinf(halfAngle);
+	CGFloat mx = ax + bx, my = ay + by;
+	CGFloat ml = sqrtf(mx*mx + my*my);
+	CGPoint centre = CGPointMake(x1 + mx / ml * centreDist, y1 + my / ml * centreDist);
+
+	CGFloat startAngle = atan2f(t0.y - centre.y, t0.x - centre.x);
+	CGFloat endAngle = atan2f(t1.y - centre.y, t1.x - centre.x);
+	CGContextAddArc(ctx, centre.x, centre.y, inRadius, startAngle, endAngle, cross > 0);
+}
+
+
+void
+CGContextAddLines(CGContextRef ctx, const CGPoint * inPoints, size_t inCount)
+{
+	if (inCount == 0)
+		return;
+	CGContextMoveToPoint(ctx, inPoints[0].x, inPoints[0].y);
+	for (size_t i = 1; i < inCount; ++i)
+		CGContextAddLineToPoint(ctx, inPoints[i].x, inPoints[i].y);
+}
+
+
+void
+CGContextAddRect(CGContextRef ctx, CGRect inRect)
+{
+	PathAddRect(&ctx->path, ctx->gs->ctm, inRect);
+}
+
+
+void
+CGContextAddEllipseInRect(CGContextRef ctx, CGRect inRect)
+{
+	PathAddEllipse(&ctx->path, ctx->gs->ctm, inRect);
+}
+
+
+void
+CGContextAddPath(CGContextRef ctx, CGPathRef inPath)
+{
+	const CGAffineTransform & t = ctx->gs->ctm;
+	for (ArrayIndex i = 0; i < inPath->count; ++i)
+	{
+		const PathElement * element = &inPath->element[i];
+		switch (element->op)
+		{
+		case kPathMove:
+			PathMoveTo(&ctx->path, CGPointApplyAffineTransform(element->pt[0], t));
+			break;
+		case kPathLine:
+			PathLineTo(&ctx->path, CGPointApplyAffineTransform(element->pt[0], t));
+			break;
+		case kPathCurve:
+			PathCurveTo(&ctx->path, CGPointApplyAffineTransform(element->pt[0], t),
+											CGPointApplyAffineTransform(element->pt[1], t),
+											CGPointApplyAffineTransform(element->pt[2], t));
+			break;
+		case kPathClose:
+			PathClose(&ctx->path);
+			break;
+		}
+	}
+}
+
+
+void
+CGContextClosePath(CGContextRef ctx)
+{
+	PathClose(&ctx->path);
+}
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	P a t h   d r a w i n g
+	Drawing a path consumes it.
+----------------------------------------------------------------------------- */
+
+static inline int
+PixelMapHeight(CGContextRef ctx)
+{
+	return RectGetHeight(ctx->pixmap->bounds);
+}
+
+
+static void
+FillCurrentPath(CGContextRef ctx, bool inIsEvenOdd)
+{
+	FlattenPath(&ctx->path, PixelMapHeight(ctx), &ctx->flat);
+	FillFlat(ctx, &ctx->flat, inIsEvenOdd, ctx->gs->fillGray, ctx->gs->fillAlpha);
+}
+
+
+static void
+StrokeCurrentPath(CGContextRef ctx)
+{
+	GState * gs = ctx->gs;
+	// line width is in user space; a zero width line is one pixel wide
+	CGFloat scale = sqrtf(fabsf(gs->ctm.a * gs->ctm.d - gs->ctm.b * gs->ctm.c));
+	CGFloat hw = gs->lineWidth * scale / 2;
+	if (hw == 0)
+		hw = 0.5;
+
+	FlattenPath(&ctx->path, PixelMapHeight(ctx), &ctx->flat);
+	StrokeFlat(&ctx->flat, gs, hw, &ctx->outline);
+	FillFlat(ctx, &ctx->outline, false, gs->strokeGray, gs->strokeAlpha);
+}
+
+
+void
+CGContextDrawPath(CGContextRef ctx, CGPathDrawingMode inMode)
+{
+	if (inMode == kCGPathFill || inMode == kCGPathFillStroke)
+		FillCurrentPath(ctx, false);
+	else if (inMode == kCGPathEOFill || inMode == kCGPathEOFillStroke)
+		FillCurrentPath(ctx, true);
+	if (inMode == kCGPathStroke || inMode == kCGPathFillStroke || inMode == kCGPathEOFillStroke)
+		StrokeCurrentPath(ctx);
+	CGContextBeginPath(ctx);
+}
+
+
+void
+CGContextFillPath(CGContextRef ctx)
+{
+	CGContextDrawPath(ctx, kCGPathFill);
+}
+
+
+void
+CGContextEOFillPath(CGContextRef ctx)
+{
+	CGContextDrawPath(ctx, kCGPathEOFill);
+}
+
+
+void
+CGContextStrokePath(CGContextRef ctx)
+{
+	CGContextDrawPath(ctx, kCGPathStroke);
+}
+
+
+void
+CGContextFillRect(CGContextRef ctx, CGRect inRect)
+{
+	CGContextBeginPath(ctx);
+	CGContextAddRect(ctx, inRect);
+	CGContextFillPath(ctx);
+}
+
+
+void
+CGContextStrokeRect(CGContextRef ctx, CGRect inRect)
+{
+	CGContextBeginPath(ctx);
+	CGContextAddRect(ctx, inRect);
+	CGContextStrokePath(ctx);
+}
+
+
+void
+CGContextStrokeRectWithWidth(CGContextRef ctx, CGRect inRect, CGFloat inWidth)
+{
+	CGFloat savedWidth = ctx->gs->lineWidth;
+	CGContextSetLineWidth(ctx, inWidth);
+	CGContextStrokeRect(ctx, inRect);
+	ctx->gs->lineWidth = savedWidth;
+}
+
+
+void
+CGContextFillEllipseInRect(CGContextRef ctx, CGRect inRect)
+{
+	CGContextBeginPath(ctx);
+	CGContextAddEllipseInRect(ctx, inRect);
+	CGContextFillPath(ctx);
+}
+
+
+void
+CGContextStrokeEllipseInRect(CGContextRef ctx, CGRect inRect)
+{
+	CGContextBeginPath(ctx);
+	CGContextAddEllipseInRect(ctx, inRect);
+	CGContextStrokePath(ctx);
+}
+
+
+void
+CGContextStrokeLineSegments(CGContextRef ctx, const CGPoint * inPoints, size_t inCount)
+{
+	CGContextBeginPath(ctx);
+	for (size_t i = 0; i + 1 < inCount; i += 2)
+	{
+		CGContextMoveToPoint(ctx, inPoints[i].x, inPoints[i].y);
+		CGContextAddLineToPoint(ctx, inPoints[i+1].x, inPoints[i+1].y);
+	}
+	CGContextStrokePath(ctx);
+}
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	C l i p p i n g
+	Clip edges are snapped to whole pixels.
+----------------------------------------------------------------------------- */
+
+void
+CGContextClipToRect(CGContextRef ctx, CGRect inRect)
+{
+	int height = PixelMapHeight(ctx);
+	CGFloat left = 0, top = 0, right = 0, bottom = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		CGPoint p = ToPixel(UserToDevice(ctx, (i & 1) ? CGRectGetMaxX(inRect) : CGRectGetMinX(inRect),
+														  (i & 2) ? CGRectGetMaxY(inRect) : CGRectGetMinY(inRect)), height);
+		if (i == 0 || p.x < left) left = p.x;
+		if (i == 0 || p.x > right) right = p.x;
+		if (i == 0 || p.y < top) top = p.y;
+		if (i == 0 || p.y > bottom) bottom = p.y;
+	}
+	Rect r;
+	r.left = (short)MAX(-32000.0f, floorf(left + 0.5));
+	r.top = (short)MAX(-32000.0f, floorf(top + 0.5));
+	r.right = (short)MIN(32000.0f, floorf(right + 0.5));
+	r.bottom = (short)MIN(32000.0f, floorf(bottom + 0.5));
+	SectClip(ctx, &r, 1, 0, 0);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Clip to a region.
+	Args:		ctx
+				inRgn			region in pixel map coordinates
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CGContextClipToRegion(CGContextRef ctx, const CBaseRegion & inRgn)
+{
+	SectClip(ctx, inRgn.rects(), inRgn.rectCount(), -ctx->pixmap->bounds.left, -ctx->pixmap->bounds.top);
+}
+
+
+CGRect
+CGContextGetClipBoundingBox(CGContextRef ctx)
+{
+	const Rect & r = ctx->gs->clipBounds;
+	int height = PixelMapHeight(ctx);
+	CGAffineTransform inverse = CGAffineTransformInvert(ctx->gs->ctm);
+	CGPoint p0 = CGPointApplyAffineTransform(CGPointMake(r.left, height - r.bottom), inverse);
+	CGPoint p1 = CGPointApplyAffineTransform(CGPointMake(r.right, height - r.top), inverse);
+	return CGRectStandardize(CGRectMake(p0.x, p0.y, p1.x - p0.x, p1.y - p0.y));
+}
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	Draw an image into a rect.
+	The image is sampled (nearest neighbour) at the centre of every pixel the
+	rect covers, through the inverse of the CTM, so any affine transform works.
+	Args:		ctx
+				inRect		user space rect; the top row of the image is at its top
+				inImage
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CGContextDrawImage(CGContextRef ctx, CGRect inRect, CGImageRef inImage)
+{
+	if (inImage == NULL || CGRectIsEmpty(inRect) || inImage->width == 0 || inImage->height == 0)
+		return;
+
+	GState * gs = ctx->gs;
+	int alpha = (int)(gs->alpha * 256 + 0.5);
+	if (alpha <= 0)
+		return;
+
+	// pixel -> image: pixel -> device -> user -> image
+	NativePixelMap * pixmap = ctx->pixmap;
+	int height = PixelMapHeight(ctx);
+	inRect = CGRectStandardize(inRect);
+	CGAffineTransform toDevice = CGAffineTransformMake(1, 0, 0, -1, 0, height);
+	CGAffineTransform toUser = CGAffineTransformInvert(gs->ctm);
+	CGAffineTransform toImage = CGAffineTransformMake(inImage->width / inRect.size.width, 0,
+																	  0, -(CGFloat)inImage->height / inRect.size.height,
+																	  -inRect.origin.x * inImage->width / inRect.size.width,
+																	  (inRect.origin.y + inRect.size.height) * inImage->height / inRect.size.height);
+	CGAffineTransform t = CGAffineTransformConcat(CGAffineTransformConcat(toDevice, toUser), toImage);
+
+	// pixel bounds of the image
+	Rect box;
+	CGFloat left = 0, top = 0, right = 0, bottom = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		CGPoint p = ToPixel(UserToDevice(ctx, inRect.origin.x + ((i & 1) ? inRect.size.width : 0),
+														  inRect.origin.y + ((i & 2) ? inRect.size.height : 0)), height);
+		if (i == 0 || p.x < left) left = p.x;
+		if (i == 0 || p.x > right) right = p.x;
+		if (i == 0 || p.y < top) top = p.y;
+		if (i == 0 || p.y > bottom) bottom = p.y;
+	}
+	if (left < -32000 || top < -32000 || right > 32000 || bottom > 32000)
+		return;
+	SetRect(&box, (short)floorf(left), (short)floorf(top), (short)ceilf(right), (short)ceilf(bottom));
+	if (!SectPixels(&box, &gs->clipBounds, &box))
+		return;
+
+	int depth = PixelDepth(pixmap);
+	int runLength = RectGetWidth(box);
+	short * darkness = new short[runLength];
+	float * coverage = new float[runLength];
+	CGImageRef mask = inImage->mask;
+
+	for (int y = box.top; y < box.bottom; ++y)
+	{
+		UByte * pixRow = (UByte *)PixelMapBits(pixmap) + y * pixmap->rowBytes;
+		for (ArrayIndex i = 0; i < gs->clipCount; ++i)
+		{
+			const Rect * r = &gs->clip[i];
+			if (y < r->top || y >= r->bottom)
+				continue;
+			int x0 = MAX(r->left, box.left), x1 = MIN(r->right, box.right);
+			if (x0 >= x1)
+				continue;
+
+			CGFloat u = t.a * (x0 + 0.5) + t.c * (y + 0.5) + t.tx;
+			CGFloat v = t.b * (x0 + 0.5) + t.d * (y + 0.5) + t.ty;
+			for (int x = x0; x < x1; ++x, u += t.a, v += t.b)
+			{
+				int n = x - x0;
+				darkness[n] = -1;
+				coverage[n] = 1;
+				if (u < 0 || v < 0 || u >= inImage->width || v >= inImage->height)
+					continue;
+				int sample = GetSample(inImage, (size_t)u, (size_t)v);
+				if (sample < 0 || (sample >= inImage->maskLo && sample <= inImage->maskHi))
+					continue;
+				if (mask)
+				{
+					int maskSample = GetSample(mask, (size_t)u * mask->width / inImage->width, (size_t)v * mask->height / inImage->height);
+					if (maskSample < 0)
+						continue;
+					coverage[n] = mask->darkness[maskSample] / 255.0f;
+				}
+				darkness[n] = inImage->darkness[sample];
+			}
+			BlendRun(pixRow, depth, x0, x1 - x0, mask ? coverage : NULL, darkness, 0, alpha, gs->blendMode);
+		}
+	}
+
+	delete[] darkness;
+	delete[] coverage;
+}
+
+#pragma mark -
+
+/* -----------------------------------------------------------------------------
+	T e x t
+	There is no font rasteriser here. Whatever font is selected, text is drawn
+	in a built-in stroke font: each glyph is a few polylines on a grid 4 units
+	wide and 6 high, with 2 more below the baseline, stroked one unit wide with
+	round ends. A unit is a tenth of the font size, so 10 point text is a pixel
+	per unit. Every glyph advances the same 6 units.
+	The font covers ASCII; the MacRoman quotes are drawn as their ASCII ones
+	and any other character as a box.
+	Strokes are "x,y x,y ..." separated by semicolons.
+----------------------------------------------------------------------------- */
+
+#define kGlyphUnitsPerEm	10
+#define kGlyphAdvance		6
+#define kGlyphAscent			8		// including half the stroke and some leading
+#define kGlyphDescent		3
+
+static const char * const kGlyphStrokes[0x7F - 0x20] =
+{
+	"",										// space
+	"2,6 2,2;2,1 2,0",							// !
+	"1,6 1,5;3,6 3,5",							// "
+	"1,6 1,0;3,6 3,0;0,4 4,4;0,2 4,2",			// #
+	"4,5 1,5 0,4 1,3 3,3 4,2 3,1 0,1;2,6 2,0",	// $
+	"0,0 4,6;0,6 1,6 1,5 0,5 0,6;3,1 4,1 4,0 3,0 3,1",	// %
+	"4,0 1,4 1,5 2,6 3,5 3,4 0,2 0,1 1,0 2,0 4,2",	// &
+	"2,6 2,5",									// '
+	"3,6 2,4 2,2 3,0",							// (
+	"1,6 2,4 2,2 1,0",							// )
+	"2,5 2,1;0,4 4,2;0,2 4,4",					// *
+	"2,5 2,1;0,3 4,3",							// +
+	"2,1 2,0 1,-1",							// ,
+	"0,3 4,3",									// -
+	"2,1 2,0",									// .
+	"0,0 4,6",									// /
+	"1,0 3,0 4,1 4,5 3,6 1,6 0,5 0,1 1,0;0,1 4,5",	// 0
+	"1,5 2,6 2,0;1,0 3,0",						// 1
+	"0,5 1,6 3,6 4,5 4,4 0,0 4,0",				// 2
+	"0,5 1,6 3,6 4,5 4,4 3,3 4,2 4,1 3,0 1,0 0,1;1,3 3,3",	// 3
+	"3,0 3,6 0,2 4,2",							// 4
+	"4,6 0,6 0,3 3,3 4,2 4,1 3,0 0,0",			// 5
+	"3,6 1,6 0,5 0,1 1,0 3,0 4,1 4,2 3,3 0,3",	// 6
+	"0,6 4,6 1,0",								// 7
+	"1,3 0,4 0,5 1,6 3,6 4,5 4,4 3,3 1,3 0,2 0,1 1,0 3,0 4,1 4,2 3,3",	// 8
+	"4,3 1,3 0,4 0,5 1,6 3,6 4,5 4,1 3,0 1,0",	// 9
+	"2,4 2,3;2,1 2,0",							// :
+	"2,4 2,3;2,1 2,0 1,-1",					// ;
+	"4,5 0,3 4,1",								// <
+	"0,4 4,4;0,2 4,2",							// =
+	"0,5 4,3 0,1",								// >
+	"0,5 1,6 3,6 4,5 4,4 2,3 2,2;2,1 2,0",		// ?
+	"3,2 1,2 1,4 3,4 3,1 4,1 4,5 3,6 1,6 0,5 0,1 1,0 3,0",	// @
+	"0,0 0,4 2,6 4,4 4,0;0,3 4,3",				// A
+	"0,0 0,6 3,6 4,5 4,4 3,3 0,3;3,3 4,2 4,1 3,0 0,0",	// B
+	"4,5 3,6 1,6 0,5 0,1 1,0 3,0 4,1",			// C
+	"0,0 0,6 3,6 4,5 4,1 3,0 0,0",				// D
+	"4,6 0,6 0,0 4,0;0,3 3,3",					// E
+	"4,6 0,6 0,0;0,3 3,3",						// F
+	"4,5 3,6 1,6 0,5 0,1 1,0 3,0 4,1 4,3 2,3",	// G
+	"0,6 0,0;4,6 4,0;0,3 4,3",					// H
+	"1,6 3,6;2,6 2,0;1,0 3,0",					// I
+	"4,6 4,1 3,0 1,0 0,1",						// J
+	"0,6 0,0;4,6 0,2;1,3 4,0",					// K
+	"0,6 0,0 4,0",								// L
+	"0,0 0,6 2,3 4,6 4,0",						// M
+	"0,0 0,6 4,0 4,6",							// N
+	"1,0 3,0 4,1 4,5 3,6 1,6 0,5 0,1 1,0",		// O
+	"0,0 0,6 3,6 4,5 4,4 3,3 0,3",				// P
+	"1,0 3,0 4,1 4,5 3,6 1,6 0,5 0,1 1,0;2,2 4,0",	// Q
+	"0,0 0,6 3,6 4,5 4,4 3,3 0,3;2,3 4,0",		// R
+	"4,5 3,6 1,6 0,5 0,4 1,3 3,3 4,2 4,1 3,0 1,0 0,1",	// S
+	"0,6 4,6;2,6 2,0",							// T
+	"0,6 0,1 1,0 3,0 4,1 4,6",					// U
+	"0,6 2,0 4,6",								// V
+	"0,6 1,0 2,3 3,0 4,6",						// W
+	"0,6 4,0;0,0 4,6",							// X
+	"0,6 2,3 4,6;2,3 2,0",						// Y
+	"0,6 4,6 0,0 4,0",							// Z
+	"3,6 1,6 1,0 3,0",							// [
+	"0,6 4,0",									// backslash
+	"1,6 3,6 3,0 1,0",							// ]
+	"0,4 2,6 4,4",								// ^
+	"0,-1 4,-1",								// _
+	"1,6 2,5",									// `
+	"0,4 3,4 4,3 4,0;4,2 1,2 0,1 1,0 3,0 4,1",	// a
+	"0,6 0,0 3,0 4,1 4,3 3,4 0,4",				// b
+	"4,4 1,4 0,3 0,1 1,0 4,0",					// c
+	"4,6 4,0 1,0 0,1 0,3 1,4 4,4",				// d
+	"0,2 4,2 4,3 3,4 1,4 0,3 0,1 1,0 4,0",		// e
+	"4,6 3,6 2,5 2,0;0,4 4,4",					// f
+	"4,0 1,0 0,1 0,3 1,4 4,4 4,-1 3,-2 1,-2",	// g
+	"0,6 0,0;0,4 3,4 4,3 4,0",					// h
+	"2,4 2,0;2,6 2,5",							// i
+	"3,4 3,-1 2,-2 1,-2;3,6 3,5",				// j
+	"0,6 0,0;4,4 0,1;1,2 4,0",					// k
+	"1,6 2,6 2,0;1,0 3,0",						// l
+	"0,0 0,4;0,3 1,4 2,3 2,0;2,3 3,4 4,3 4,0",	// m
+	"0,0 0,4;0,3 1,4 3,4 4,3 4,0",				// n
+	"1,0 3,0 4,1 4,3 3,4 1,4 0,3 0,1 1,0",		// o
+	"0,-2 0,4 3,4 4,3 4,1 3,0 0,0",			// p
+	"4,-2 4,4 1,4 0,3 0,1 1,0 4,0",			// q
+	"0,0 0,4;0,3 1,4 4,4",						// r
+	"4,4 1,4 0,3 1,2 3,2 4,1 3,0 0,0",			// s
+	"2,6 2,1 3,0 4,0;0,4 4,4",					// t
+	"0,4 0,1 1,0 3,0 4,1;4,4 4,0",				// u
+	"0,4 2,0 4,4",								// v
+	"0,4 1,0 2,2 3,0 4,4",						// w
+	"0,4 4,0;0,0 4,4",							// x
+	"0,4 0,1 1,0 4,0;4,4 4,-1 3,-2 0,-2",		// y
+	"0,4 4,4 0,0 4,0",							// z
+	"3,6 2,5 2,4 1,3 2,2 2,1 3,0",				// {
+	"2,6 2,-1",								// |
+	"1,6 2,5 2,4 3,3 2,2 2,1 1,0",				// }
+	"0,3 1,4 3,2 4,3",							// ~
+};
+
+static const char * const kMissingGlyphStrokes = "0,0 4,0 4,6 0,6 0,0";
+
+
+static const char *
+GlyphStrokes(unsigned char inChar)
+{
+	switch (inChar)
+	{
+	case 0xD2: case 0xD3:	inChar = '"'; break;		// MacRoman double quotes
+	case 0xD4: case 0xD5:	inChar = '\''; break;	// and single quotes
+	case 0xA5:					inChar = '*'; break;		// bullet
+	}
+	if (inChar >= 0x20 && inChar < 0x7F)
+		return kGlyphStrokes[inChar - 0x20];
+	return kMissingGlyphStrokes;
+}
+
+
+static inline int
+GlyphCoordinate(const char *& ioStrokes)
+{
+	int sign = 1;
+	if (*ioStrokes == '-')
+	{
+		sign = -1;
+		ioStrokes++;
+	}
+	return sign * (*ioStrokes++ - '0');
+}
+
+
+/* -----------------------------------------------------------------------------
+	Add the strokes of a glyph to the current path.
+	Args:		ctx
+				inStrokes	the glyph
+				inTransform	glyph units -> device space
+	Return:	--
+----------------------------------------------------------------------------- */
+
+static void
+AddGlyph(CGContextRef ctx, const char * inStrokes, const CGAffineTransform & inTransform)
+{
+	bool isNewStroke = true;
+	while (*inStrokes != 0)
+	{
+		if (*inStrokes == ';')
+			isNewStroke = true;
+		if (*inStrokes == ';' || *inStrokes == ' ')
+		{
+			inStrokes++;
+			continue;
+		}
+		int x = GlyphCoordinate(inStrokes);
+		inStrokes++;		// skip the comma
+		int y = GlyphCoordinate(inStrokes);
+		CGPoint pt = CGPointApplyAffineTransform(CGPointMake(x, y), inTransform);
+		if (isNewStroke)
+			PathMoveTo(&ctx->path, pt);
+		else
+			PathLineTo(&ctx->path, pt);
+		isNewStroke = false;
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	G l y p h   c a c h e
+	Not in the original.
+	A run of text used to be flattened, stroked and rasterised whole every
+	time it was drawn. Unrotated glyphs of the same size land on the same
+	fraction of a pixel over and over -- at 10 points the advance is a whole
+	six pixels -- so the coverage of each glyph is kept, keyed on the glyph,
+	its scale and where in a pixel its origin falls, and a run is drawn by
+	adding up the coverage of its glyphs. Glyphs don't overlap, so that is the
+	coverage of the run.
+----------------------------------------------------------------------------- */
+
+#define kGlyphCacheSize		512		// direct mapped
+
+// glyph units every glyph's strokes lie within, with half a stroke to spare
+#define kGlyphBoxLeft		-1
+#define kGlyphBoxRight		5
+#define kGlyphBoxBottom		-3
+#define kGlyphBoxTop			7
+
+struct GlyphMask
+{
+	bool					isUsed;
+	UByte					glyph;		// MacRoman character code
+	CGFloat				a, d;			// glyph units -> device space
+	CGFloat				fx, fy;		// where in its pixel the origin falls
+	Rect					bounds;		// of its coverage, relative to that pixel
+	float *				coverage;	// row by row, each width+2 long
+};
+
+static GlyphMask		gGlyphCache[kGlyphCacheSize];
+static ULong			gGlyphCacheHits = 0;
+static ULong			gGlyphCacheMisses = 0;
+
+
+/* -----------------------------------------------------------------------------
+	Find the coverage of a glyph in the glyph cache, rasterising it if it is
+	not there.
+	Args:		ctx
+				inGlyph		MacRoman character code
+				inTransform	glyph units -> device space; unrotated
+				inGlyphState	state to stroke it with
+				hw				half the stroke width
+				outPixel		pixel in which the glyph's origin falls
+	Return:	its coverage
+----------------------------------------------------------------------------- */
+
+static const GlyphMask *
+GetGlyphMask(CGContextRef ctx, UByte inGlyph, const CGAffineTransform & inTransform, const GState * inGlyphState, CGFloat hw, Point * outPixel)
+{
+	CGPoint origin = ToPixel(CGPointMake(inTransform.tx, inTransform.ty), PixelMapHeight(ctx));
+	CGFloat px = floorf(origin.x), py = floorf(origin.y);
+	CGFloat fx = origin.x - px, fy = origin.y - py;
+	outPixel->h = px;
+	outPixel->v = py;
+
+	// glyphs of the same size on the same fraction of a pixel never collide
+	ULong hash = inGlyph;
+	hash = hash * 31 + (ULong)(fx * 16);
+	hash = hash * 31 + (ULong)(fy * 16);
+	hash = hash * 31 + (ULong)(fabsf(inTransform.a) * 16);
+	GlyphMask * mask = &gGlyphCache[hash % kGlyphCacheSize];
+	if (mask->isUsed && mask->glyph == inGlyph
+	&&  mask->a == inTransform.a && mask->d == inTransform.d
+	&&  mask->fx == fx && mask->fy == fy)
+	{
+		gGlyphCacheHits++;
+		return mask;
+	}
+
+	gGlyphCacheMisses++;
+	if (mask->coverage)
+		delete[] mask->coverage;
+	mask->isUsed = true;
+	mask->glyph = inGlyph;
+	mask->a = inTransform.a;
+	mask->d = inTransform.d;
+	mask->fx = fx;
+	mask->fy = fy;
+	mask->coverage = NULL;
+	SetRect(&mask->bounds, 0, 0, 0, 0);
+
+	// rasterise the glyph where it is, and keep its coverage relative to its pixel
+	ctx->path.count = 0;
+	ctx->path.hasCurrent = false;
+	AddGlyph(ctx, GlyphStrokes(inGlyph), inTransform);
+	FlattenPath(&ctx->path, PixelMapHeight(ctx), &ctx->flat);
+	StrokeFlat(&ctx->flat, inGlyphState, hw, &ctx->outline);
+	Rect bounds;
+	if (FlatBounds(&ctx->outline, &bounds))
+	{
+		size_t size = (bounds.right - bounds.left + 2) * (bounds.bottom - bounds.top);
+		mask->coverage = new float[size];
+		memset(mask->coverage, 0, size * sizeof(float));
+		RasteriseFlat(&ctx->outline, false, true, &bounds, mask->coverage);
+		OffsetRect(&bounds, -(short)px, -(short)py);
+		mask->bounds = bounds;
+	}
+	return mask;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Draw unrotated glyphs from the glyph cache.
+	Args:		ctx
+				inStr			MacRoman text
+				inLength		its length
+				inTransform	glyph units -> device space for the first glyph
+				inAdvance	device space between glyphs
+				inGlyphState	state to stroke them with
+				hw				half the stroke width
+				inGray		colour, 0 = black .. 1 = white
+				inAlpha		its alpha
+	Return:	--
+----------------------------------------------------------------------------- */
+
+static void
+ShowCachedGlyphs(CGContextRef ctx, const char * inStr, size_t inLength, CGAffineTransform inTransform, CGFloat inAdvance,
+					  const GState * inGlyphState, CGFloat hw, CGFloat inGray, CGFloat inAlpha)
+{
+	GState * gs = ctx->gs;
+	int alpha = (int)(inAlpha * gs->alpha * 256 + 0.5);
+	if (alpha <= 0 || inLength == 0)
+		return;
+
+	// the pixels the run can cover, from the glyph box of its first and last glyphs
+	Flat corners;
+	InitFlat(&corners);
+	for (int i = 0; i < 2; ++i)
+	{
+		CGAffineTransform t = inTransform;
+		t.tx += i * (inLength - 1) * inAdvance;
+		FlatAddPoint(&corners, ToPixel(CGPointApplyAffineTransform(CGPointMake(kGlyphBoxLeft, kGlyphBoxBottom), t), PixelMapHeight(ctx)));
+		FlatAddPoint(&corners, ToPixel(CGPointApplyAffineTransform(CGPointMake(kGlyphBoxRight, kGlyphBoxTop), t), PixelMapHeight(ctx)));
+	}
+	Rect bounds, box;
+	bool isVisible = FlatBounds(&corners, &bounds) && SectPixels(&bounds, &gs->clipBounds, &box);
+	FreeFlat(&corners);
+	if (!isVisible)
+		return;
+
+	int rowLength = box.right - box.left;
+	float * coverage = ClearCoverage(ctx, rowLength * (box.bottom - box.top));
+	for (size_t i = 0; i < inLength; ++i, inTransform.tx += inAdvance)
+	{
+		Point pixel;
+		const GlyphMask * mask = GetGlyphMask(ctx, inStr[i], inTransform, inGlyphState, hw, &pixel);
+		Rect glyphBox, r;
+		glyphBox = mask->bounds;
+		OffsetRect(&glyphBox, pixel.h, pixel.v);
+		if (mask->coverage == NULL || !SectPixels(&glyphBox, &box, &r))
+			continue;
+		int maskRowLength = glyphBox.right - glyphBox.left + 2;
+		for (int y = r.top; y < r.bottom; ++y)
+		{
+			const float * src = mask->coverage + (y - glyphBox.top) * maskRowLength + (r.left - glyphBox.left);
+			float * dst = coverage + (y - box.top) * rowLength + (r.left - box.left);
+			for (int x = r.left; x < r.right; ++x)
+				*dst++ += *src++;
+		}
+	}
+
+	for (float * p = coverage, * end = coverage + rowLength * (box.bottom - box.top); p < end; ++p)
+	{
+		if (*p > 1)
+			*p = 1;
+		if (!gs->isAntialiased)
+			*p = (*p >= 0.5) ? 1 : 0;
+	}
+	BlendCoverage(ctx, &box, coverage, rowLength, inGray, alpha);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Draw text at the text position, and advance the text position past it.
+	The path being built is left alone.
+	Args:		ctx
+				inStr			MacRoman text
+				inLength		its length
+	Return:	--
+----------------------------------------------------------------------------- */
+
+static void
+ShowText(CGContextRef ctx, const char * inStr, size_t inLength)
+{
+	GState * gs = ctx->gs;
+	CGFloat unit = gs->fontSize / kGlyphUnitsPerEm;
+	CGAffineTransform textMatrix = gs->textMatrix;
+	textMatrix.tx = ctx->textPosition.x;
+	textMatrix.ty = ctx->textPosition.y;
+	// glyph units -> text space -> user space -> device space
+	CGAffineTransform t = CGAffineTransformConcat(CGAffineTransformConcat(CGAffineTransformMake(unit, 0, 0, unit, 0, 0), textMatrix), gs->ctm);
+
+	if (gs->textMode != kCGTextInvisible && unit > 0)
+	{
+		// put the origin of unrotated text at the centre of a pixel, so that
+		// one pixel per unit draws crisp lines
+		CGAffineTransform glyphToDevice = t;
+		if (t.b == 0 && t.c == 0)
+		{
+			glyphToDevice.tx = floorf(t.tx) + 0.5;
+			glyphToDevice.ty = floorf(t.ty) + 0.5;
+		}
+
+		GState glyphState = *gs;
+		glyphState.lineCap = kCGLineCapRound;
+		glyphState.lineJoin = kCGLineJoinRound;
+		CGFloat hw = sqrtf(fabsf(t.a * t.d - t.b * t.c)) / 2;
+		CGFloat gray = (gs->textMode == kCGTextFill) ? gs->fillGray : gs->strokeGray;
+		CGFloat alpha = (gs->textMode == kCGTextFill) ? gs->fillAlpha : gs->strokeAlpha;
+
+		CGPath savedPath = ctx->path;
+		InitPath(&ctx->path);
+		if (gs->shouldCacheGlyphs && t.b == 0 && t.c == 0)
+			ShowCachedGlyphs(ctx, inStr, inLength, glyphToDevice, kGlyphAdvance * t.a, &glyphState, hw, gray, alpha);
+		else
+		{
+			for (size_t i = 0; i < inLength; ++i)
+			{
+				AddGlyph(ctx, GlyphStrokes(inStr[i]), glyphToDevice);
+				glyphToDevice.tx += kGlyphAdvance * t.a;
+				glyphToDevice.ty += kGlyphAdvance * t.b;
+			}
+			FlattenPath(&ctx->path, PixelMapHeight(ctx), &ctx->flat);
+			StrokeFlat(&ctx->flat, &glyphState, hw, &ctx->outline);
+			FillFlat(ctx, &ctx->outline, false, gray, alpha);
+		}
+
+		if (ctx->path.element)
+			delete[] ctx->path.element;
+		ctx->path = savedPath;
+	}
+
+	ctx->textPosition.x += inLength * kGlyphAdvance * unit * gs->textMatrix.a;
+	ctx->textPosition.y += inLength * kGlyphAdvance * unit * gs->textMatrix.b;
+}
+
+
+void
+CGContextSetTextMatrix(CGContextRef ctx, CGAffineTransform inTransform)
+{
+	ctx->gs->textMatrix = inTransform;
+}
+
+void
+CGContextSetTextPosition(CGContextRef ctx, CGFloat x, CGFloat y)
+{
+	ctx->textPosition = CGPointMake(x, y);
+}
+
+void
+CGContextSetTextDrawingMode(CGContextRef ctx, CGTextDrawingMode inMode)
+{
+	ctx->gs->textMode = inMode;
+}
+
+void
+CGContextSelectFont(CGContextRef ctx, const char * inName, CGFloat inSize, CGTextEncoding inEncoding)
+{
+	ctx->gs->fontSize = inSize;
+}
+
+void
+CGContextShowTextAtPoint(CGContextRef ctx, CGFloat x, CGFloat y, const char * inStr, size_t inLength)
+{
+	ctx->textPosition = CGPointMake(x, y);
+	ShowText(ctx, inStr, inLength);
+}
+
+void
+CGContextSetShouldCacheGlyphs(CGContextRef ctx, bool inShould)
+{
+	ctx->gs->shouldCacheGlyphs = inShould;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Glyph cache statistics.
+	Args:		outHits		number of times a glyph was found in the cache
+				outMisses	number of times it had to be rasterised
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CGGlyphCacheGetStatistics(ULong * outHits, ULong * outMisses)
+{
+	*outHits = gGlyphCacheHits;
+	*outMisses = gGlyphCacheMisses;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Measure text in the selected font.
+	Args:		ctx
+				inStr			MacRoman text
+				inLength		its length
+	Return:	its advance, in text space
+----------------------------------------------------------------------------- */
+
+CGFloat
+CGContextGetTextWidth(CGContextRef ctx, const char * inStr, size_t inLength)
+{
+	return inLength * kGlyphAdvance * ctx->gs->fontSize / kGlyphUnitsPerEm;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Get the line metrics of the selected font.
+	Args:		ctx
+				outAscent	above the baseline, in text space
+				outDescent	below it
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CGContextGetFontMetrics(CGContextRef ctx, CGFloat * outAscent, CGFloat * outDescent)
+{
+	CGFloat unit = ctx->gs->fontSize / kGlyphUnitsPerEm;
+	*outAscent = kGlyphAscent * unit;
+	*outDescent = kGlyphDescent * unit;
+}
+
+void
+CGContextSetAllowsFontSmoothing(CGContextRef ctx, bool inAllows)
+{ }
+
+void
+CGContextSetShouldSmoothFonts(CGContextRef ctx, bool inShould)
+{ }
+
+void
+CGContextSetAllowsFontSubpixelPositioning(CGContextRef ctx, bool inAllows)
+{ }
+
+void
+CGContextSetShouldSubpixelPositionFonts(CGContextRef ctx, bool inShould)
+{ }
+
+void
+CGContextSetAllowsFontSubpixelQuantization(CGContextRef ctx, bool inAllows)
+{ }
+
+void
+CGContextSetShouldSubpixelQuantizeFonts(CGContextRef ctx, bool inShould)
+{ }
+
+#endif	/* forSoftQuartz */
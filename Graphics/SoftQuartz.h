@@ -0,0 +1,342 @@
+/*
+	File:		SoftQuartz.h
+
+	Contains:	Software implementation of the subset of Quartz (CoreGraphics)
+					that Newton drawing uses, for hosts without CoreGraphics.
+
+					Everything is drawn into a NativePixelMap of depth 1, 2, 4 or 8
+					(Newton pixels: 0 is white, all ones is black).
+					Paths are flattened in device space and filled with an
+					anti-aliasing coverage accumulator; strokes are expanded into
+					polygons and filled the same way. Clipping is a list of
+					disjoint device rects, so a view can be clipped to its update
+					region rather than just its bounds.
+
+					Text is drawn in a built-in stroke font whatever font is
+					selected, and covers ASCII only.
+					Not implemented: shadows, PNG decoding, CGContextClip to an
+					arbitrary path. Those calls are accepted and do nothing.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__SOFTQUARTZ_H)
+#define __SOFTQUARTZ_H 1
+
+#include "QDTypes.h"
+#include <stddef.h>
+
+class CBaseRegion;
+
+
+/* -----------------------------------------------------------------------------
+	G e o m e t r y
+----------------------------------------------------------------------------- */
+
+typedef float CGFloat;
+
+struct CGPoint
+{
+	CGFloat	x;
+	CGFloat	y;
+};
+
+struct CGSize
+{
+	CGFloat	width;
+	CGFloat	height;
+};
+
+struct CGRect
+{
+	CGPoint	origin;
+	CGSize	size;
+};
+
+struct CGAffineTransform
+{
+	CGFloat	a, b, c, d;
+	CGFloat	tx, ty;
+};
+
+extern const CGPoint					CGPointZero;
+extern const CGRect					CGRectZero;
+extern const CGAffineTransform	CGAffineTransformIdentity;
+
+inline CGPoint	CGPointMake(CGFloat x, CGFloat y)								{ CGPoint p; p.x = x; p.y = y; return p; }
+inline CGSize	CGSizeMake(CGFloat w, CGFloat h)									{ CGSize s; s.width = w; s.height = h; return s; }
+inline CGRect	CGRectMake(CGFloat x, CGFloat y, CGFloat w, CGFloat h)	{ CGRect r; r.origin.x = x; r.origin.y = y; r.size.width = w; r.size.height = h; return r; }
+
+inline CGFloat	CGRectGetWidth(CGRect r)		{ return r.size.width < 0 ? -r.size.width : r.size.width; }
+inline CGFloat	CGRectGetHeight(CGRect r)		{ return r.size.height < 0 ? -r.size.height : r.size.height; }
+inline CGFloat	CGRectGetMinX(CGRect r)			{ return r.size.width < 0 ? r.origin.x + r.size.width : r.origin.x; }
+inline CGFloat	CGRectGetMinY(CGRect r)			{ return r.size.height < 0 ? r.origin.y + r.size.height : r.origin.y; }
+inline CGFloat	CGRectGetMaxX(CGRect r)			{ return CGRectGetMinX(r) + CGRectGetWidth(r); }
+inline CGFloat	CGRectGetMaxY(CGRect r)			{ return CGRectGetMinY(r) + CGRectGetHeight(r); }
+inline CGFloat	CGRectGetMidX(CGRect r)			{ return CGRectGetMinX(r) + CGRectGetWidth(r) / 2; }
+inline CGFloat	CGRectGetMidY(CGRect r)			{ return CGRectGetMinY(r) + CGRectGetHeight(r) / 2; }
+inline bool		CGRectIsEmpty(CGRect r)			{ return r.size.width == 0 || r.size.height == 0; }
+
+extern CGRect	CGRectStandardize(CGRect inRect);
+extern CGRect	CGRectInset(CGRect inRect, CGFloat dx, CGFloat dy);
+extern CGRect	CGRectOffset(CGRect inRect, CGFloat dx, CGFloat dy);
+extern CGRect	CGRectIntersection(CGRect inRect1, CGRect inRect2);
+
+extern CGAffineTransform	CGAffineTransformMake(CGFloat a, CGFloat b, CGFloat c, CGFloat d, CGFloat tx, CGFloat ty);
+extern CGAffineTransform	CGAffineTransformConcat(CGAffineTransform t1, CGAffineTransform t2);
+extern CGAffineTransform	CGAffineTransformInvert(CGAffineTransform t);
+extern CGPoint					CGPointApplyAffineTransform(CGPoint p, CGAffineTransform t);
+
+
+/* -----------------------------------------------------------------------------
+	C o l o r
+	The destination is always gray, so a colour is reduced to its luminance
+	and alpha when it is created.
+----------------------------------------------------------------------------- */
+
+typedef struct CGColorSpace *		CGColorSpaceRef;
+typedef struct CGColor *			CGColorRef;
+
+extern const char * const	kCGColorSpaceGenericGray;
+extern const char * const	kCGColorSpaceGenericRGB;
+
+extern CGColorSpaceRef	CGColorSpaceCreateWithName(const char * inName);
+extern CGColorSpaceRef	CGColorSpaceCreateDeviceGray(void);
+extern CGColorSpaceRef	CGColorSpaceCreateDeviceRGB(void);
+extern CGColorSpaceRef	CGColorSpaceCreateIndexed(CGColorSpaceRef inBase, size_t inLastIndex, const unsigned char * inTable);
+extern CGColorSpaceRef	CGColorSpaceRetain(CGColorSpaceRef inSpace);
+extern void					CGColorSpaceRelease(CGColorSpaceRef inSpace);
+
+extern CGColorRef	CGColorCreate(CGColorSpaceRef inSpace, const CGFloat * inComponents);
+extern CGColorRef	CGColorCreateGenericGray(CGFloat inGray, CGFloat inAlpha);
+extern CGColorRef	CGColorCreateGenericRGB(CGFloat inRed, CGFloat inGreen, CGFloat inBlue, CGFloat inAlpha);
+extern CGColorRef	CGColorRetain(CGColorRef inColor);
+extern void			CGColorRelease(CGColorRef inColor);
+
+
+/* -----------------------------------------------------------------------------
+	I m a g e s
+	Gray or indexed samples of 1, 2, 4 or 8 bits, packed most significant
+	pixel first -- ie Newton pixel maps.
+----------------------------------------------------------------------------- */
+
+typedef struct CGDataProvider *	CGDataProviderRef;
+typedef struct CGImage *			CGImageRef;
+
+typedef void (*CGDataProviderReleaseDataCallback)(void * info, const void * data, size_t size);
+
+typedef uint32_t CGBitmapInfo;
+enum
+{
+	kCGImageAlphaNone,
+	kCGImageAlphaPremultipliedLast,
+	kCGImageAlphaPremultipliedFirst,
+	kCGImageAlphaLast,
+	kCGImageAlphaFirst,
+	kCGImageAlphaNoneSkipLast,
+	kCGImageAlphaNoneSkipFirst,
+	kCGImageAlphaOnly
+};
+
+typedef int CGColorRenderingIntent;
+enum
+{
+	kCGRenderingIntentDefault,
+	kCGRenderingIntentAbsoluteColorimetric,
+	kCGRenderingIntentRelativeColorimetric,
+	kCGRenderingIntentPerceptual,
+	kCGRenderingIntentSaturation
+};
+
+extern CGDataProviderRef	CGDataProviderCreateWithData(void * info, const void * inData, size_t inSize, CGDataProviderReleaseDataCallback inReleaseProc);
+extern CGDataProviderRef	CGDataProviderRetain(CGDataProviderRef inProvider);
+extern void						CGDataProviderRelease(CGDataProviderRef inProvider);
+
+extern CGImageRef	CGImageCreate(size_t inWidth, size_t inHeight, size_t inBitsPerComponent, size_t inBitsPerPixel, size_t inBytesPerRow,
+									  CGColorSpaceRef inSpace, CGBitmapInfo inBitmapInfo, CGDataProviderRef inProvider,
+									  const CGFloat * inDecode, bool inShouldInterpolate, CGColorRenderingIntent inIntent);
+extern CGImageRef	CGImageCreateWithMask(CGImageRef inImage, CGImageRef inMask);
+extern CGImageRef	CGImageCreateWithMaskingColors(CGImageRef inImage, const CGFloat * inComponents);
+extern CGImageRef	CGImageCreateWithPNGDataProvider(CGDataProviderRef inSource, const CGFloat * inDecode, bool inShouldInterpolate, CGColorRenderingIntent inIntent);
+extern CGImageRef	CGImageRetain(CGImageRef inImage);
+extern void			CGImageRelease(CGImageRef inImage);
+extern size_t		CGImageGetWidth(CGImageRef inImage);
+extern size_t		CGImageGetHeight(CGImageRef inImage);
+
+
+/* -----------------------------------------------------------------------------
+	P a t h s
+----------------------------------------------------------------------------- */
+
+typedef struct CGPath *			CGMutablePathRef;
+typedef const struct CGPath *	CGPathRef;
+
+extern CGMutablePathRef	CGPathCreateMutable(void);
+extern void		CGPathRelease(CGPathRef inPath);
+extern void		CGPathMoveToPoint(CGMutablePathRef inPath, const CGAffineTransform * m, CGFloat x, CGFloat y);
+extern void		CGPathAddLineToPoint(CGMutablePathRef inPath, const CGAffineTransform * m, CGFloat x, CGFloat y);
+extern void		CGPathAddCurveToPoint(CGMutablePathRef inPath, const CGAffineTransform * m, CGFloat cp1x, CGFloat cp1y, CGFloat cp2x, CGFloat cp2y, CGFloat x, CGFloat y);
+extern void		CGPathAddRect(CGMutablePathRef inPath, const CGAffineTransform * m, CGRect inRect);
+extern void		CGPathAddEllipseInRect(CGMutablePathRef inPath, const CGAffineTransform * m, CGRect inRect);
+extern void		CGPathCloseSubpath(CGMutablePathRef inPath);
+
+
+/* -----------------------------------------------------------------------------
+	C o n t e x t
+----------------------------------------------------------------------------- */
+
+typedef struct CGContext *		CGContextRef;
+
+typedef int CGLineCap;
+enum
+{
+	kCGLineCapButt,
+	kCGLineCapRound,
+	kCGLineCapSquare
+};
+
+typedef int CGLineJoin;
+enum
+{
+	kCGLineJoinMiter,
+	kCGLineJoinRound,
+	kCGLineJoinBevel
+};
+
+typedef int CGPathDrawingMode;
+enum
+{
+	kCGPathFill,
+	kCGPathEOFill,
+	kCGPathStroke,
+	kCGPathFillStroke,
+	kCGPathEOFillStroke
+};
+
+typedef int CGBlendMode;
+enum
+{
+	kCGBlendModeNormal,
+	kCGBlendModeMultiply,
+	kCGBlendModeScreen,
+	kCGBlendModeDarken = 4,
+	kCGBlendModeLighten,
+	kCGBlendModeDifference = 10,
+	kCGBlendModeCopy = 17
+};
+
+typedef int CGTextDrawingMode;
+enum
+{
+	kCGTextFill,
+	kCGTextStroke,
+	kCGTextFillStroke,
+	kCGTextInvisible
+};
+
+typedef int CGTextEncoding;
+enum
+{
+	kCGEncodingFontSpecific,
+	kCGEncodingMacRoman
+};
+
+extern CGContextRef	CGContextRetain(CGContextRef ctx);
+extern void		CGContextRelease(CGContextRef ctx);
+extern void		CGContextFlush(CGContextRef ctx);
+extern void		CGContextSynchronize(CGContextRef ctx);
+
+extern void		CGContextSaveGState(CGContextRef ctx);
+extern void		CGContextRestoreGState(CGContextRef ctx);
+
+extern void		CGContextTranslateCTM(CGContextRef ctx, CGFloat tx, CGFloat ty);
+extern void		CGContextScaleCTM(CGContextRef ctx, CGFloat sx, CGFloat sy);
+extern void		CGContextRotateCTM(CGContextRef ctx, CGFloat inAngle);
+extern void		CGContextConcatCTM(CGContextRef ctx, CGAffineTransform inTransform);
+extern CGAffineTransform	CGContextGetCTM(CGContextRef ctx);
+
+extern void		CGContextSetLineWidth(CGContextRef ctx, CGFloat inWidth);
+extern void		CGContextSetLineCap(CGContextRef ctx, CGLineCap inCap);
+extern void		CGContextSetLineJoin(CGContextRef ctx, CGLineJoin inJoin);
+extern void		CGContextSetMiterLimit(CGContextRef ctx, CGFloat inLimit);
+extern void		CGContextSetAlpha(CGContextRef ctx, CGFloat inAlpha);
+extern void		CGContextSetBlendMode(CGContextRef ctx, CGBlendMode inMode);
+extern void		CGContextSetShouldAntialias(CGContextRef ctx, bool inAntialias);
+extern void		CGContextSetAllowsAntialiasing(CGContextRef ctx, bool inAllows);
+
+extern void		CGContextSetFillColorSpace(CGContextRef ctx, CGColorSpaceRef inSpace);
+extern void		CGContextSetStrokeColorSpace(CGContextRef ctx, CGColorSpaceRef inSpace);
+extern void		CGContextSetFillColorWithColor(CGContextRef ctx, CGColorRef inColor);
+extern void		CGContextSetStrokeColorWithColor(CGContextRef ctx, CGColorRef inColor);
+extern void		CGContextSetGrayFillColor(CGContextRef ctx, CGFloat inGray, CGFloat inAlpha);
+extern void		CGContextSetGrayStrokeColor(CGContextRef ctx, CGFloat inGray, CGFloat inAlpha);
+extern void		CGContextSetRGBFillColor(CGContextRef ctx, CGFloat inRed, CGFloat inGreen, CGFloat inBlue, CGFloat inAlpha);
+extern void		CGContextSetRGBStrokeColor(CGContextRef ctx, CGFloat inRed, CGFloat inGreen, CGFloat inBlue, CGFloat inAlpha);
+extern void		CGContextSetShadow(CGContextRef ctx, CGSize inOffset, CGFloat inBlur);
+
+extern void		CGContextBeginPath(CGContextRef ctx);
+extern void		CGContextMoveToPoint(CGContextRef ctx, CGFloat x, CGFloat y);
+extern void		CGContextAddLineToPoint(CGContextRef ctx, CGFloat x, CGFloat y);
+extern void		CGContextAddCurveToPoint(CGContextRef ctx, CGFloat cp1x, CGFloat cp1y, CGFloat cp2x, CGFloat cp2y, CGFloat x, CGFloat y);
+extern void		CGContextAddQuadCurveToPoint(CGContextRef ctx, CGFloat cpx, CGFloat cpy, CGFloat x, CGFloat y);
+extern void		CGContextAddArc(CGContextRef ctx, CGFloat x, CGFloat y, CGFloat inRadius, CGFloat inStartAngle, CGFloat inEndAngle, int inClockwise);
+extern void		CGContextAddArcToPoint(CGContextRef ctx, CGFloat x1, CGFloat y1, CGFloat x2, CGFloat y2, CGFloat inRadius);
+extern void		CGContextAddLines(CGContextRef ctx, const CGPoint * inPoints, size_t inCount);
+extern void		CGContextAddRect(CGContextRef ctx, CGRect inRect);
+extern void		CGContextAddEllipseInRect(CGContextRef ctx, CGRect inRect);
+extern void		CGContextAddPath(CGContextRef ctx, CGPathRef inPath);
+extern void		CGContextClosePath(CGContextRef ctx);
+
+extern void		CGContextFillPath(CGContextRef ctx);
+extern void		CGContextEOFillPath(CGContextRef ctx);
+extern void		CGContextStrokePath(CGContextRef ctx);
+extern void		CGContextDrawPath(CGContextRef ctx, CGPathDrawingMode inMode);
+extern void		CGContextFillRect(CGContextRef ctx, CGRect inRect);
+extern void		CGContextStrokeRect(CGContextRef ctx, CGRect inRect);
+extern void		CGContextStrokeRectWithWidth(CGContextRef ctx, CGRect inRect, CGFloat inWidth);
+extern void		CGContextFillEllipseInRect(CGContextRef ctx, CGRect inRect);
+extern void		CGContextStrokeEllipseInRect(CGContextRef ctx, CGRect inRect);
+extern void		CGContextStrokeLineSegments(CGContextRef ctx, const CGPoint * inPoints, size_t inCount);
+
+extern void		CGContextClipToRect(CGContextRef ctx, CGRect inRect);
+extern CGRect	CGContextGetClipBoundingBox(CGContextRef ctx);
+
+extern void		CGContextDrawImage(CGContextRef ctx, CGRect inRect, CGImageRef inImage);
+
+extern void		CGContextSetTextMatrix(CGContextRef ctx, CGAffineTransform inTransform);
+extern void		CGContextSetTextPosition(CGContextRef ctx, CGFloat x, CGFloat y);
+extern void		CGContextSetTextDrawingMode(CGContextRef ctx, CGTextDrawingMode inMode);
+extern void		CGContextSelectFont(CGContextRef ctx, const char * inName, CGFloat inSize, CGTextEncoding inEncoding);
+extern void		CGContextShowTextAtPoint(CGContextRef ctx, CGFloat x, CGFloat y, const char * inStr, size_t inLength);
+extern void		CGContextSetAllowsFontSmoothing(CGContextRef ctx, bool inAllows);
+extern void		CGContextSetShouldSmoothFonts(CGContextRef ctx, bool inShould);
+extern void		CGContextSetAllowsFontSubpixelPositioning(CGContextRef ctx, bool inAllows);
+extern void		CGContextSetShouldSubpixelPositionFonts(CGContextRef ctx, bool inShould);
+extern void		CGContextSetAllowsFontSubpixelQuantization(CGContextRef ctx, bool inAllows);
+extern void		CGContextSetShouldSubpixelQuantizeFonts(CGContextRef ctx, bool inShould);
+
+
+/* -----------------------------------------------------------------------------
+	N e w t o n   e x t e n s i o n s
+	A context draws into a NativePixelMap. Its default user space is the
+	usual Quartz one: origin at bottom-left, y up, one unit per pixel.
+	Regions are in pixel map (QuickDraw) coordinates.
+	CGContextSetTransferMode selects a view transfer mode (modeCopy ..
+	modeNotBic) in place of the blend mode. Like the original blitter these
+	work on pixel values, so eg modeXor of black onto black gives white.
+	There is no CoreText, so text is measured here, in the selected font.
+	Glyphs are cached as they are drawn; CGContextSetShouldCacheGlyphs(false)
+	draws them afresh, as they were.
+----------------------------------------------------------------------------- */
+
+extern CGContextRef	CGPixelMapContextCreate(NativePixelMap * inPixmap);
+extern NativePixelMap *	CGPixelMapContextGetPixelMap(CGContextRef ctx);
+extern CGImageRef	CGPixelMapContextCreateImage(CGContextRef ctx);
+extern void		CGContextClipToRegion(CGContextRef ctx, const CBaseRegion & inRgn);
+extern void		CGContextSetTransferMode(CGContextRef ctx, int inTransferMode);
+extern CGFloat	CGContextGetTextWidth(CGContextRef ctx, const char * inStr, size_t inLength);
+extern void		CGContextGetFontMetrics(CGContextRef ctx, CGFloat * outAscent, CGFloat * outDescent);
+extern void		CGContextSetShouldCacheGlyphs(CGContextRef ctx, bool inShould);
+extern void		CGGlyphCacheGetStatistics(ULong * outHits, ULong * outMisses);
+
+#endif	/* __SOFTQUARTZ_H */
@@ -0,0 +1,405 @@
+/*
+	File:		TextCache.cc
+
+	Contains:	Text layout cache.
+					Not in the original.
+					Lists redraw the same short strings over and over as they
+					scroll, and laying text out is expensive. So we keep the
+					layout of each string recently drawn, keyed on the string and
+					everything that affects its layout. The least recently used
+					entry makes way for a new one.
+					With CoreText an entry keeps a framesetter, the frame it last
+					laid out and the height of its text. SoftQuartz has no
+					CoreText; its layout is the line breaks and justification of
+					the text in the built-in font.
+					Split out of DrawText.cc so the cache can be built and tested
+					on its own.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "TextCache.h"
+#if !defined(forSoftQuartz)
+#include <CoreText/CoreText.h>
+#endif
+#include "NewtonMemory.h"
+#include "Unicode.h"
+#include "ViewFlags.h"
+
+#include <string.h>
+
+#define kTextCacheSize 128
+
+#if defined(forSoftQuartz)
+struct TextLine
+{
+	size_t				start;			// offset of first char in the line
+	size_t				end;				// offset past its last char, less trailing spaces
+	CGFloat				offset;			// from the left of the box, to justify it
+};
+#endif
+
+struct TextCacheEntry
+{
+	ULong					hash;				// of the text; 0 => entry is unused
+	UniChar *			text;
+	size_t				length;
+	ULong					justify;
+	CGColorRef			color;
+	CGFloat				width;
+#if !defined(forSoftQuartz)
+	CTFramesetterRef	framesetter;
+	CTFrameRef			frame;			// laid out in a box at the origin
+	CGFloat				frameHeight;	// of that box
+	CGFloat				textHeight;		// height of all the text; < 0 => not yet measured
+#else
+	char *				str;				// the text in the font's encoding
+	TextLine *			lines;
+	ArrayIndex			numOfLines;
+	CGFloat				ascent;
+	CGFloat				descent;
+#endif
+	ULong					lastUse;
+};
+
+static TextCacheEntry	gTextCache[kTextCacheSize];
+static ULong				gTextCacheClock = 0;
+static ULong				gTextCacheHits = 0;
+static ULong				gTextCacheMisses = 0;
+#if !defined(forSoftQuartz)
+static CTFontRef			gTextFont = NULL;
+#endif
+
+
+/*------------------------------------------------------------------------------
+	Hash text for the text cache.
+	Args:		inStr
+				inLength
+	Return:	hash; never 0
+------------------------------------------------------------------------------*/
+
+static ULong
+HashText(const UniChar * inStr, size_t inLength)
+{
+	ULong  hash = 2166136261U;		// FNV-1a
+	for ( ; inLength > 0; inLength--, inStr++)
+		hash = (hash ^ *inStr) * 16777619U;
+	return hash ? hash : 1;
+}
+
+
+/*------------------------------------------------------------------------------
+	Free a text cache entry.
+	Args:		inEntry
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+FreeTextCacheEntry(TextCacheEntry * inEntry)
+{
+	if (inEntry->hash != 0)
+	{
+#if !defined(forSoftQuartz)
+		if (inEntry->frame)
+			CFRelease(inEntry->frame);
+		CFRelease(inEntry->framesetter);
+#else
+		FreePtr(inEntry->str);
+		FreePtr((Ptr)inEntry->lines);
+#endif
+		CGColorRelease(inEntry->color);
+		FreePtr((Ptr)inEntry->text);
+		inEntry->hash = 0;
+	}
+}
+
+
+#if !defined(forSoftQuartz)
+/*------------------------------------------------------------------------------
+	Create the framesetter for a text cache entry.
+	Args:		ioEntry				entry with its text, colour and justification
+	Return:	true => created
+------------------------------------------------------------------------------*/
+
+static bool
+LayOutText(TextCacheEntry * ioEntry)
+{
+	// create font -- fixed for now
+	if (gTextFont == NULL)
+		gTextFont = CTFontCreateWithName(CFSTR("Helvetica"), 10.0, NULL);	// CTFontCreateUIFontForLanguage(kCTFontMiniSystemFontType, 0.0, NULL);
+
+	//	inJustifyH -> CTParagraphStyleSetting
+	//    create paragraph style and assign text alignment to it
+	CTTextAlignment alignment = ioEntry->justify;
+	CTParagraphStyleSetting _settings[] = { { kCTParagraphStyleSpecifierAlignment, sizeof(alignment), &alignment } };
+	CTParagraphStyleRef paraStyle = CTParagraphStyleCreate(_settings, sizeof(_settings) / sizeof(_settings[0]));
+
+	CFStringRef keys[] = { kCTFontAttributeName, kCTStrokeColorAttributeName, kCTParagraphStyleAttributeName };
+	CFTypeRef values[] = { gTextFont, ioEntry->color, paraStyle };
+	CFDictionaryRef attributes = CFDictionaryCreate(kCFAllocatorDefault, (const void **)&keys, (const void **)&values, sizeof(keys) / sizeof(keys[0]), &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+
+	// Initialize an attributed string.
+	CFStringRef string = CFStringCreateWithCharacters(kCFAllocatorDefault, ioEntry->text, ioEntry->length);
+	CFAttributedStringRef attrStr = CFAttributedStringCreate(kCFAllocatorDefault, string, attributes);
+	CFRelease(string);
+	CFRelease(attributes);
+	CFRelease(paraStyle);
+
+	// Create the framesetter with the attributed string.
+	ioEntry->framesetter = CTFramesetterCreateWithAttributedString(attrStr);
+	CFRelease(attrStr);
+	ioEntry->frame = NULL;
+	ioEntry->frameHeight = 0.0;
+	ioEntry->textHeight = -1.0;
+	return ioEntry->framesetter != NULL;
+}
+
+#else
+
+/*------------------------------------------------------------------------------
+	Lay out text in the SoftQuartz built-in font, breaking lines at spaces to
+	fit the width.
+	Args:		ioEntry				entry with its text, width and justification
+	Return:	true => laid out
+------------------------------------------------------------------------------*/
+
+static bool
+LayOutText(TextCacheEntry * ioEntry)
+{
+	size_t length = ioEntry->length;
+	char * str = NewPtr(length + 1);
+	// there can be no more lines than chars
+	TextLine * lines = (TextLine *)NewPtr(MAX(length, 1) * sizeof(TextLine));
+	if (str == NULL || lines == NULL)
+	{
+		FreePtr(str);
+		FreePtr((Ptr)lines);
+		return false;
+	}
+	ConvertFromUnicode(ioEntry->text, str, length);
+
+	CGContextSaveGState(quartz);
+	CGContextSelectFont(quartz, "Helvetica", 10.0, kCGEncodingMacRoman);
+	CGContextGetFontMetrics(quartz, &ioEntry->ascent, &ioEntry->descent);
+	CGFloat width = ioEntry->width;
+	ArrayIndex numOfLines = 0;
+
+	for (size_t lineStart = 0; lineStart < length; )
+	{
+		// find the most whole words that fit; break a word only if it fits on no line
+		size_t lineEnd = length, nextStart = length;
+		size_t lastSpace = kIndexNotFound;
+		CGFloat lineWidth = 0;
+		for (size_t i = lineStart; i < length; ++i)
+		{
+			if (str[i] == '\r' || str[i] == '\n')
+			{
+				lineEnd = i;
+				nextStart = i + 1;
+				break;
+			}
+			if (str[i] == ' ')
+				lastSpace = i;
+			lineWidth += CGContextGetTextWidth(quartz, str + i, 1);
+			if (lineWidth > width)
+			{
+				if (lastSpace != kIndexNotFound)
+				{
+					lineEnd = lastSpace;
+					nextStart = lastSpace + 1;
+				}
+				else
+					lineEnd = nextStart = MAX(i, lineStart + 1);
+				break;
+			}
+		}
+		while (lineEnd > lineStart && str[lineEnd - 1] == ' ')
+			lineEnd--;
+
+		TextLine * line = &lines[numOfLines++];
+		line->start = lineStart;
+		line->end = lineEnd;
+		line->offset = 0;
+		CGFloat slack = width - CGContextGetTextWidth(quartz, str + lineStart, lineEnd - lineStart);
+		if ((ioEntry->justify & vjHMask) == vjCenterH)
+			line->offset = slack / 2;
+		else if ((ioEntry->justify & vjHMask) == vjRightH)
+			line->offset = slack;
+		lineStart = nextStart;
+	}
+
+	CGContextRestoreGState(quartz);
+	ioEntry->str = str;
+	ioEntry->lines = lines;
+	ioEntry->numOfLines = numOfLines;
+	return true;
+}
+#endif
+
+
+/*------------------------------------------------------------------------------
+	Find text in the text cache, adding it if it is not there.
+	Args:		inStr					text
+				inLength				its length
+				inWidth				width of box it is laid out in
+				inColor				its colour
+				inJustify			its justification
+	Return:	cache entry; NULL => could not add it
+------------------------------------------------------------------------------*/
+
+static TextCacheEntry *
+GetTextCacheEntry(const UniChar * inStr, size_t inLength, CGFloat inWidth, CGColorRef inColor, ULong inJustify)
+{
+	ULong	hash = HashText(inStr, inLength);
+	TextCacheEntry *	entry, * lruEntry = gTextCache;
+
+	inJustify &= vjHMask;
+	for (entry = gTextCache; entry < gTextCache + kTextCacheSize; entry++)
+	{
+		if (entry->hash == hash
+		&&  entry->length == inLength
+		&&  entry->width == inWidth
+		&&  entry->color == inColor
+		&&  entry->justify == inJustify
+		&&  memcmp(entry->text, inStr, inLength * sizeof(UniChar)) == 0)
+		{
+			gTextCacheHits++;
+			entry->lastUse = ++gTextCacheClock;
+			return entry;
+		}
+		if (entry->hash == 0
+		||  (lruEntry->hash != 0 && entry->lastUse < lruEntry->lastUse))
+			lruEntry = entry;
+	}
+
+	gTextCacheMisses++;
+	entry = lruEntry;
+	FreeTextCacheEntry(entry);
+
+	UniChar *	text = (UniChar *)NewPtr(inLength * sizeof(UniChar));
+	if (text == NULL)
+		return NULL;
+	memmove(text, inStr, inLength * sizeof(UniChar));
+
+	entry->text = text;
+	entry->length = inLength;
+	entry->justify = inJustify;
+	entry->color = inColor;
+	entry->width = inWidth;
+	if (!LayOutText(entry))
+	{
+		FreePtr((Ptr)text);
+		return NULL;
+	}
+	CGColorRetain(inColor);
+	entry->hash = hash;
+	entry->lastUse = ++gTextCacheClock;
+	return entry;
+}
+
+
+/*------------------------------------------------------------------------------
+	Draw text into a box.
+	The text is laid out in the box's width, or found already laid out in the
+	text cache, and drawn wherever the box now is.
+	Args:		inStr					text
+				inLength				its length
+				inBox					box to draw it in; the first line hangs from its top
+				inColor				colour to draw it in
+				inJustify			horizontal justification
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+DrawCachedText(const UniChar * inStr, size_t inLength, CGRect inBox, CGColorRef inColor, ULong inJustify)
+{
+	TextCacheEntry * entry = GetTextCacheEntry(inStr, inLength, inBox.size.width, inColor, inJustify);
+	if (entry == NULL)
+		return;
+
+#if !defined(forSoftQuartz)
+	// draw the frame laid out at the origin into the box
+	if (entry->frame == NULL || entry->frameHeight != inBox.size.height)
+	{
+		if (entry->frame)
+			CFRelease(entry->frame);
+		CGMutablePathRef path = CGPathCreateMutable();
+		CGPathAddRect(path, NULL, CGRectMake(0.0, 0.0, entry->width, inBox.size.height));
+		entry->frame = CTFramesetterCreateFrame(entry->framesetter, CFRangeMake(0, 0), path, NULL);
+		entry->frameHeight = inBox.size.height;
+		CGPathRelease(path);
+	}
+	CGContextSaveGState(quartz);
+	CGContextTranslateCTM(quartz, inBox.origin.x, inBox.origin.y);
+	CTFrameDraw(entry->frame, quartz);
+	CGContextRestoreGState(quartz);
+
+#else
+	CGContextSaveGState(quartz);
+	CGContextSelectFont(quartz, "Helvetica", 10.0, kCGEncodingMacRoman);
+	CGFloat baseline = CGRectGetMaxY(inBox) - entry->ascent;
+	for (ArrayIndex i = 0; i < entry->numOfLines; ++i)
+	{
+		TextLine * line = &entry->lines[i];
+		CGContextShowTextAtPoint(quartz, CGRectGetMinX(inBox) + line->offset, baseline, entry->str + line->start, line->end - line->start);
+		baseline -= entry->ascent + entry->descent;
+	}
+	CGContextRestoreGState(quartz);
+#endif
+}
+
+
+/*------------------------------------------------------------------------------
+	Measure the height of text laid out in a width.
+	Args:		inStr					text
+				inLength				its length
+				inWidth				width of box it is laid out in
+				inColor				colour it is drawn in
+				inJustify			horizontal justification
+	Return:	height
+------------------------------------------------------------------------------*/
+
+CGFloat
+MeasureCachedText(const UniChar * inStr, size_t inLength, CGFloat inWidth, CGColorRef inColor, ULong inJustify)
+{
+	TextCacheEntry * entry = GetTextCacheEntry(inStr, inLength, inWidth, inColor, inJustify);
+	if (entry == NULL)
+		return 0.0;
+
+#if !defined(forSoftQuartz)
+	if (entry->textHeight < 0.0)
+		entry->textHeight = CTFramesetterSuggestFrameSizeWithConstraints(entry->framesetter, CFRangeMake(0, 0), NULL, CGSizeMake(entry->width, CGFLOAT_MAX), NULL).height;
+	return entry->textHeight;
+#else
+	return entry->numOfLines * (entry->ascent + entry->descent);
+#endif
+}
+
+
+/*------------------------------------------------------------------------------
+	Empty the text cache.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+FlushTextCache(void)
+{
+	for (ArrayIndex i = 0; i < kTextCacheSize; ++i)
+		FreeTextCacheEntry(&gTextCache[i]);
+}
+
+
+/*------------------------------------------------------------------------------
+	Text cache statistics.
+	Args:		outHits				number of times text was found in the cache
+				outMisses			number of times it had to be laid out
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+TextCacheStatistics(ULong * outHits, ULong * outMisses)
+{
+	*outHits = gTextCacheHits;
+	*outMisses = gTextCacheMisses;
+}
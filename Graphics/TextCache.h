@@ -0,0 +1,23 @@
+/*
+	File:		TextCache.h
+
+	Contains:	Text layout cache declarations.
+					Text drawn into a box is laid out once and kept, keyed on the
+					text and everything that affects its layout, so that lists can
+					redraw the same strings without laying them out again.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__TEXTCACHE_H)
+#define __TEXTCACHE_H 1
+
+#include "Quartz.h"
+
+extern void			DrawCachedText(const UniChar * inStr, size_t inLength, CGRect inBox, CGColorRef inColor, ULong inJustify);
+extern CGFloat		MeasureCachedText(const UniChar * inStr, size_t inLength, CGFloat inWidth, CGColorRef inColor, ULong inJustify);
+
+extern void			FlushTextCache(void);
+extern void			TextCacheStatistics(ULong * outHits, ULong * outMisses);
+
+#endif	/* __TEXTCACHE_H */
@@ -2,11 +2,26 @@
 	File:		FakePointers.cc
 
 	Contains:	Pointer allocation based on malloc.
+					Small blocks are carved from size-class slabs and cached per thread;
+					large blocks go straight to malloc.
 
 	Written by:	Newton Research Group, 2008.
 */
 
 #include "Newton.h"
+#include <pthread.h>
+#include <stdio.h>
+
+/*------------------------------------------------------------------------------
+	Debug options.
+	These add to the size of every block so are normally off.
+------------------------------------------------------------------------------*/
+
+#define forPtrGuards			0	// pad each block with guard bytes; check them when it’s freed
+#define forPtrLeakReport	0	// list blocks still allocated at exit
+#define forPtrSiteCounts	0	// count allocations per call site; list them at exit
+
+#define forPtrTracking		(forPtrLeakReport || forPtrSiteCounts)
 
 
 /*------------------------------------------------------------------------------
@@ -32,7 +47,8 @@ MemError(void)
 	P o i n t e r   O p e r a t i o n s
 ------------------------------------------------------------------------------*/
 
-struct Block
+// the header is padded to a multiple of 16 bytes so that what follows it is aligned for any type
+struct alignas(16) Block
 {
 	Size				size;		// first b/c it’s 64-bit
 	union {
@@ -40,33 +56,470 @@ struct Block
 		ULong			name;
 	};
 	HeapBlockType	type;		// 8-bit
+	UByte				sizeClass;	// slab size class, or kLargeBlock if malloc’d
+#if forPtrTracking
+	Block *			next;		// in list of live blocks
+	Block *			prev;
+	void *			site;		// caller of NewPtr et al
+#endif
 };
 
+#define kLargeBlock		0xFF
+
+#if forPtrGuards
+#define kGuardSize		16
+#define kGuardByte		0xFD
+#else
+#define kGuardSize		0
+#endif
+
+
 /*------------------------------------------------------------------------------
-	Create a new pointer.
+	S i z e   C l a s s e s
+
+	Blocks up to kMaxPoolSize are rounded up to one of these sizes. There are
+	four classes per power of two above 128 bytes, so no more than 25% of a
+	block is wasted. Free blocks of each class are kept on a per-thread list,
+	which is refilled from and drained to a central list in batches; the
+	central list is refilled by carving up a new slab. When a thread exits,
+	its lists are drained to the central lists for other threads to use.
+	Slabs are shared by all threads, so are never returned to the host.
+------------------------------------------------------------------------------*/
+
+#define kMaxPoolSize		4096
+#define kSlabSize			(64*KByte)
+#define kBatchSize		32
+#define kMaxCacheSize	(2*kBatchSize)
+
+static const Size	kClassSize[] =
+{
+	  16,   32,   48,   64,   80,   96,  112,  128,
+	 160,  192,  224,  256,  320,  384,  448,  512,
+	 640,  768,  896, 1024, 1280, 1536, 1792, 2048,
+	2560, 3072, 3584, 4096
+};
+#define kNumOfSizeClasses (sizeof(kClassSize)/sizeof(kClassSize[0]))
+
+struct FreeBlock
+{
+	FreeBlock *		next;
+};
+
+struct SizeClassCache
+{
+	FreeBlock *		head;
+	ArrayIndex		count;
+};
+
+static UByte				gSizeClassOf[kMaxPoolSize/16 + 1];	// indexed by (size+15)/16
+static pthread_once_t	gSizeClassOfOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t	gPoolLock = PTHREAD_MUTEX_INITIALIZER;
+static SizeClassCache	gPool[kNumOfSizeClasses];				// central free lists; protected by gPoolLock
+static thread_local SizeClassCache	tCache[kNumOfSizeClasses];	// this thread’s free lists
+static thread_local bool	tIsCacheRegistered = false;
+static pthread_key_t		gCacheKey;
+static pthread_once_t	gCacheKeyOnce = PTHREAD_ONCE_INIT;
+
+
+/*------------------------------------------------------------------------------
+	Build the size -> size class lookup table.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+InitSizeClasses(void)
+{
+	ArrayIndex sizeClass = 0;
+	for (ArrayIndex i = 0; i <= kMaxPoolSize/16; ++i)
+	{
+		while (kClassSize[sizeClass] < (Size)(i*16))
+			++sizeClass;
+		gSizeClassOf[i] = sizeClass;
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	Return the size class of a block.
+	Args:		inSize		size of block, including guard bytes but not its header
+	Return:	size class
+------------------------------------------------------------------------------*/
+
+static inline ArrayIndex
+SizeClassOf(Size inSize)
+{
+	if (inSize > kMaxPoolSize)
+		return kLargeBlock;
+	pthread_once(&gSizeClassOfOnce, InitSizeClasses);
+	return gSizeClassOf[(inSize + 15) / 16];
+}
+
+
+/*------------------------------------------------------------------------------
+	Carve a new slab into free blocks of a size class and add them to the
+	central free list.
+	Called with gPoolLock held.
+	Args:		inClass		size class
+	Return:	false => no memory
+------------------------------------------------------------------------------*/
+
+static bool
+NewSlab(ArrayIndex inClass)
+{
+	Size elementSize = sizeof(Block) + kClassSize[inClass];
+	char * slab = (char *)malloc(kSlabSize);
+	if (slab == NULL)
+		return false;
+
+	SizeClassCache * pool = &gPool[inClass];
+	for (char * p = slab, * limit = slab + kSlabSize - elementSize; p <= limit; p += elementSize)
+	{
+		FreeBlock * block = (FreeBlock *)p;
+		block->next = pool->head;
+		pool->head = block;
+		pool->count++;
+	}
+	return true;
+}
+
+
+/*------------------------------------------------------------------------------
+	Drain a thread’s free lists to the central lists.
+	Called when the thread exits.
+	Args:		inCache		the thread’s tCache
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+DrainThreadCache(void * inCache)
+{
+	SizeClassCache * cache = (SizeClassCache *)inCache;
+	pthread_mutex_lock(&gPoolLock);
+	for (ArrayIndex sizeClass = 0; sizeClass < kNumOfSizeClasses; ++sizeClass, ++cache)
+	{
+		SizeClassCache * pool = &gPool[sizeClass];
+		while (cache->head != NULL)
+		{
+			FreeBlock * block = cache->head;
+			cache->head = block->next;
+			block->next = pool->head;
+			pool->head = block;
+			pool->count++;
+		}
+		cache->count = 0;
+	}
+	pthread_mutex_unlock(&gPoolLock);
+}
+
+
+static void
+MakeCacheKey(void)
+{
+	pthread_key_create(&gCacheKey, DrainThreadCache);
+}
+
+
+static void
+RegisterThreadCache(void)
+{
+	pthread_once(&gCacheKeyOnce, MakeCacheKey);
+	pthread_setspecific(gCacheKey, tCache);
+	tIsCacheRegistered = true;
+}
+
+
+/*------------------------------------------------------------------------------
+	Allocate a block from a size class.
+	Args:		inClass		size class
+	Return:	the block, NULL if no memory
+------------------------------------------------------------------------------*/
+
+static Block *
+PoolAlloc(ArrayIndex inClass)
+{
+	SizeClassCache * cache = &tCache[inClass];
+	if (cache->head == NULL)
+	{
+		// first time this thread has needed a refill: have its cache drained when it exits
+		if (!tIsCacheRegistered)
+			RegisterThreadCache();
+		// refill this thread’s cache from the central list
+		SizeClassCache * pool = &gPool[inClass];
+		pthread_mutex_lock(&gPoolLock);
+		if (pool->count < kBatchSize)
+			NewSlab(inClass);
+		for (ArrayIndex i = 0; i < kBatchSize && pool->head != NULL; ++i)
+		{
+			FreeBlock * block = pool->head;
+			pool->head = block->next;
+			pool->count--;
+			block->next = cache->head;
+			cache->head = block;
+			cache->count++;
+		}
+		pthread_mutex_unlock(&gPoolLock);
+		if (cache->head == NULL)
+			return NULL;
+	}
+
+	FreeBlock * block = cache->head;
+	cache->head = block->next;
+	cache->count--;
+	return (Block *)block;
+}
+
+
+/*------------------------------------------------------------------------------
+	Return a block to its size class.
+	Args:		inBlock		the block
+				inClass		its size class
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+PoolFree(Block * inBlock, ArrayIndex inClass)
+{
+	SizeClassCache * cache = &tCache[inClass];
+	FreeBlock * block = (FreeBlock *)inBlock;
+	if (!tIsCacheRegistered)
+		RegisterThreadCache();
+	block->next = cache->head;
+	cache->head = block;
+	if (++cache->count > kMaxCacheSize)
+	{
+		// too many cached -- give a batch back to the central list
+		SizeClassCache * pool = &gPool[inClass];
+		pthread_mutex_lock(&gPoolLock);
+		for (ArrayIndex i = 0; i < kBatchSize; ++i)
+		{
+			block = cache->head;
+			cache->head = block->next;
+			cache->count--;
+			block->next = pool->head;
+			pool->head = block;
+			pool->count++;
+		}
+		pthread_mutex_unlock(&gPoolLock);
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	D e b u g   S u p p o r t
+------------------------------------------------------------------------------*/
+#if forPtrTracking
+
+static Block *	gLiveBlocks;					// protected by gPoolLock
+static bool		gIsReportRegistered = false;
+
+#if forPtrSiteCounts
+struct SiteCount
+{
+	void *		site;
+	ULong			count;
+	Size			size;
+};
+
+#define kNumOfSites 1024
+static SiteCount	gSiteCount[kNumOfSites];	// open-addressed on call site
+#endif
+
+
+/*------------------------------------------------------------------------------
+	Print the debug report.
+	Registered with atexit() on first allocation.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+ReportPtrUsage(void)
+{
+	pthread_mutex_lock(&gPoolLock);
+#if forPtrLeakReport
+	printf("Pointers still allocated:\n");
+	for (Block * block = gLiveBlocks; block != NULL; block = block->next)
+		printf("  %p  size %6ld  name %08X  type %d  from %p\n", block + 1, block->size, block->name, block->type, block->site);
+#endif
+#if forPtrSiteCounts
+	printf("Pointer allocations by call site:\n");
+	for (ArrayIndex i = 0; i < kNumOfSites; ++i)
+	{
+		SiteCount * entry = &gSiteCount[i];
+		if (entry->site != NULL)
+			printf("  %p  %8u blocks  %10ld bytes\n", entry->site, entry->count, entry->size);
+	}
+#endif
+	pthread_mutex_unlock(&gPoolLock);
+}
+
+
+/*------------------------------------------------------------------------------
+	Add a block to the list of live blocks, and count its allocation.
+	Args:		inBlock		the block
+				inSite		its caller
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+TrackBlock(Block * inBlock, void * inSite)
+{
+	inBlock->site = inSite;
+	inBlock->prev = NULL;
+	pthread_mutex_lock(&gPoolLock);
+	if (!gIsReportRegistered)
+	{
+		atexit(ReportPtrUsage);
+		gIsReportRegistered = true;
+	}
+	inBlock->next = gLiveBlocks;
+	if (gLiveBlocks != NULL)
+		gLiveBlocks->prev = inBlock;
+	gLiveBlocks = inBlock;
+#if forPtrSiteCounts
+	ArrayIndex i = ((uintptr_t)inSite >> 2) % kNumOfSites;
+	for (ArrayIndex probe = 0; probe < kNumOfSites; ++probe, i = (i + 1) % kNumOfSites)
+	{
+		SiteCount * entry = &gSiteCount[i];
+		if (entry->site == inSite || entry->site == NULL)
+		{
+			entry->site = inSite;
+			entry->count++;
+			entry->size += inBlock->size;
+			break;
+		}
+	}
+#endif
+	pthread_mutex_unlock(&gPoolLock);
+}
+
+
+/*------------------------------------------------------------------------------
+	Remove a block from the list of live blocks.
+	Args:		inBlock		the block
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+UntrackBlock(Block * inBlock)
+{
+	pthread_mutex_lock(&gPoolLock);
+	if (inBlock->prev != NULL)
+		inBlock->prev->next = inBlock->next;
+	else
+		gLiveBlocks = inBlock->next;
+	if (inBlock->next != NULL)
+		inBlock->next->prev = inBlock->prev;
+	pthread_mutex_unlock(&gPoolLock);
+}
+#endif
+
+
+#if forPtrGuards
+/*------------------------------------------------------------------------------
+	Set or check the guard bytes that follow a block.
+	Args:		inBlock		the block
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+SetGuard(Block * inBlock)
+{
+	memset((Ptr)(inBlock + 1) + inBlock->size, kGuardByte, kGuardSize);
+}
+
+static void
+CheckGuard(Block * inBlock)
+{
+	UByte * guard = (UByte *)(inBlock + 1) + inBlock->size;
+	for (ArrayIndex i = 0; i < kGuardSize; ++i)
+	{
+		if (guard[i] != kGuardByte)
+		{
+			printf("Pointer %p (size %ld, name %08X) has been overrun\n", inBlock + 1, inBlock->size, inBlock->name);
+			break;
+		}
+	}
+}
+#endif
+
+
+/*------------------------------------------------------------------------------
+	Allocate a block.
 	Args:		inSize		size required
+				inSite		caller, for debug
 	Return:	a pointer
 ------------------------------------------------------------------------------*/
 
-Ptr
-NewPtr(Size inSize)
+static Ptr
+AllocPtr(Size inSize, void * inSite)
 {
-	NewtonErr	err;
-	Block *	newPtr;
+	Block *	block = NULL;
+	ArrayIndex	sizeClass = kLargeBlock;
 
-	newPtr = (Block *)malloc(sizeof(Block) + inSize);
-	if (newPtr == NULL)
-		err = memFullErr;
-	else
+	if (inSize >= 0)
 	{
-		newPtr->size = inSize;
-		newPtr->name = 0;
-		newPtr->type = 0;
-		err = noErr;
+		sizeClass = SizeClassOf(inSize + kGuardSize);
+		if (sizeClass == kLargeBlock)
+			block = (Block *)malloc(sizeof(Block) + inSize + kGuardSize);
+		else
+			block = PoolAlloc(sizeClass);
 	}
-	SetMemError(err);
+	if (block == NULL)
+	{
+		SetMemError(memFullErr);
+		return NULL;
+	}
+
+	block->size = inSize;
+	block->name = 0;
+	block->type = 0;
+	block->sizeClass = sizeClass;
+#if forPtrGuards
+	SetGuard(block);
+#endif
+#if forPtrTracking
+	TrackBlock(block, inSite);
+#endif
+	SetMemError(noErr);
 
-	return (newPtr == NULL) ? NULL : (Ptr) (newPtr + 1);
+	return (Ptr) (block + 1);
+}
+
+
+/*------------------------------------------------------------------------------
+	Release a block to the pool or the host.
+	Args:		inBlock		the block
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+ReleaseBlock(Block * inBlock)
+{
+#if forPtrGuards
+	CheckGuard(inBlock);
+#endif
+#if forPtrTracking
+	UntrackBlock(inBlock);
+#endif
+	if (inBlock->sizeClass == kLargeBlock)
+		free(inBlock);
+	else
+		PoolFree(inBlock, inBlock->sizeClass);
+}
+
+
+/*------------------------------------------------------------------------------
+	Create a new pointer.
+	Args:		inSize		size required
+	Return:	a pointer
+------------------------------------------------------------------------------*/
+
+Ptr
+NewPtr(Size inSize)
+{
+	return AllocPtr(inSize, __builtin_return_address(0));
 }
 
 
@@ -80,7 +533,7 @@ NewPtr(Size inSize)
 Ptr
 NewNamedPtr(Size inSize, ULong inName)
 {
-	Ptr p = NewPtr(inSize);
+	Ptr p = AllocPtr(inSize, __builtin_return_address(0));
 	if (p != NULL)
 		SetPtrName(p, inName);
 	return p;
@@ -96,7 +549,7 @@ NewNamedPtr(Size inSize, ULong inName)
 Ptr
 NewPtrClear(Size inSize)
 {
-	Ptr p = NewPtr(inSize);
+	Ptr p = AllocPtr(inSize, __builtin_return_address(0));
 	if (p != NULL)
 		memset(p, 0, inSize);
 	return p;
@@ -115,7 +568,7 @@ FreePtr(Ptr inPtr)
 	if (inPtr != NULL)
 	{
 		Block *	block = ((Block *)inPtr) - 1;
-		free(block);
+		ReleaseBlock(block);
 		SetMemError(noErr);
 	}
 }
@@ -124,6 +577,7 @@ FreePtr(Ptr inPtr)
 /*------------------------------------------------------------------------------
 	Set a pointer’s size.
 	(The function formerly known as SetPtrSize.)
+	A pooled block that still fits its size class is resized in place.
 	Args:		inPtr			the pointer in question
 				inSize		its new size
 	Return:	error code
@@ -132,7 +586,24 @@ FreePtr(Ptr inPtr)
 Ptr
 ReallocPtr(Ptr inPtr, Size inSize)
 {
-	Ptr	newPtr = NewPtr(inSize);
+	if (inPtr != NULL && inSize >= 0)
+	{
+		Block *	block = ((Block *)inPtr) - 1;
+		if (block->sizeClass != kLargeBlock && inSize + kGuardSize <= kClassSize[block->sizeClass])
+		{
+#if forPtrGuards
+			CheckGuard(block);
+#endif
+			block->size = inSize;
+#if forPtrGuards
+			SetGuard(block);
+#endif
+			SetMemError(noErr);
+			return inPtr;
+		}
+	}
+
+	Ptr	newPtr = AllocPtr(inSize, __builtin_return_address(0));
 
 	if (inPtr != NULL && newPtr != NULL)
 	{
@@ -142,6 +142,12 @@ private:
 // returns a CTime moment representing the current time.
 CTime	GetGlobalTime(void);
 
+// SetVirtualClock, AdvanceVirtualClock, IsVirtualAlarmPending -
+// stop the clock, and move it on; for deterministic replay of recorded events.
+void	SetVirtualClock(bool inIsVirtual);
+bool	AdvanceVirtualClock(CTime inDelta);
+bool	IsVirtualAlarmPending(void);
+
 // GetTaskTime -
 // returns a CTime duration representing the time spent in the specified task.
 CTime	GetTaskTime(ObjectId inTaskId = 0);
@@ -0,0 +1,354 @@
+/*
+	File:		HostStack.cc
+
+	Contains:	Growable task stacks for the host.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostStack.h"
+#include "NewtonExceptions.h"
+#include "OSErrors.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS	MAP_ANON
+#endif
+#if !defined(MAP_NORESERVE)
+#define MAP_NORESERVE	0
+#endif
+
+
+/* -----------------------------------------------------------------------------
+	T y p e s
+----------------------------------------------------------------------------- */
+
+struct HostStack
+{
+	VAddr		start;			// start of reservation; 0 => slot is free, 1 => being set up
+	VAddr		bottom;			// lowest byte the stack can grow to, above the guard
+	VAddr		committed;		// lowest committed byte
+	VAddr		top;				// byte after the stack
+};
+
+
+/* -----------------------------------------------------------------------------
+	D a t a
+	The fault handler can run at any time, so the stack table is a fixed array
+	read without locking. A slot is claimed by swapping its start from 0 to 1,
+	and published by storing its real start last.
+----------------------------------------------------------------------------- */
+
+static HostStack			gHostStack[kMaxNumOfHostStacks];
+static HostStackStatistics	gHostStackStats;
+
+static pthread_once_t	gHostStackHandlerOnce = PTHREAD_ONCE_INIT;
+static NewtonErr			gHostStackHandlerErr = noErr;
+static struct sigaction	gPrevSEGVAction;
+static struct sigaction	gPrevBUSAction;
+static size_t				gHostPageSize;
+
+static thread_local bool	tHasSignalStack = false;
+
+
+/*------------------------------------------------------------------------------
+	Find the stack, if any, whose reservation includes an address.
+	Args:		inAddr		the address
+	Return:	the stack
+				NULL => none does
+------------------------------------------------------------------------------*/
+
+static HostStack *
+FindHostStack(VAddr inAddr)
+{
+	for (ArrayIndex i = 0; i < kMaxNumOfHostStacks; ++i)
+	{
+		HostStack *	stack = &gHostStack[i];
+		VAddr			start = __atomic_load_n(&stack->start, __ATOMIC_ACQUIRE);
+		if (start > 1 && inAddr >= start && inAddr < stack->top)
+			return stack;
+	}
+	return NULL;
+}
+
+
+/*------------------------------------------------------------------------------
+	Pass a fault that isn’t ours on to the handler that was there before.
+	If that was the default action, reinstate it and return; the faulting
+	instruction will fault again and the default action will be taken.
+	Args:		inSignal		SIGSEGV or SIGBUS
+				inInfo
+				inContext
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+ChainHostStackFault(int inSignal, siginfo_t * inInfo, void * inContext)
+{
+	struct sigaction *	prev = (inSignal == SIGBUS) ? &gPrevBUSAction : &gPrevSEGVAction;
+
+	if ((prev->sa_flags & SA_SIGINFO) != 0)
+		prev->sa_sigaction(inSignal, inInfo, inContext);
+	else if (prev->sa_handler != SIG_DFL && prev->sa_handler != SIG_IGN)
+		prev->sa_handler(inSignal);
+	else
+	{
+		// ignoring a fault would spin on it, so treat SIG_IGN as SIG_DFL
+		struct sigaction dfl;
+		memset(&dfl, 0, sizeof(dfl));
+		dfl.sa_handler = SIG_DFL;
+		sigemptyset(&dfl.sa_mask);
+		sigaction(inSignal, &dfl, NULL);
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	Handle a fault.
+	This runs on the alternate signal stack.
+	If the fault is in the uncommitted part of a task stack, commit the chunk
+	containing it and return so the faulting instruction runs again.
+	If it is in the guard -- or committing fails -- the stack has overflowed
+	despite CheckHostStack, in code that doesn’t call it.
+	There is no safe way on from there: the task could have been anywhere,
+	holding any host lock, when it faulted, and nothing that unwinds it is
+	async-signal-safe. So report the overflow, with write() since stdio isn’t
+	safe here either, and abort.
+	Args:		inSignal		SIGSEGV or SIGBUS
+				inInfo		fault details
+				inContext	machine context
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+HostStackFaultHandler(int inSignal, siginfo_t * inInfo, void * inContext)
+{
+	VAddr			addr = (VAddr)inInfo->si_addr;
+	HostStack *	stack = FindHostStack(addr);
+
+	if (stack == NULL)
+	{
+		ChainHostStackFault(inSignal, inInfo, inContext);
+		return;
+	}
+
+	if (addr >= stack->bottom)
+	{
+		VAddr	committed = __atomic_load_n(&stack->committed, __ATOMIC_ACQUIRE);
+		if (addr >= committed)
+			// already committed -- nothing to do but try again
+			return;
+
+		VAddr	newCommitted = committed;
+		while (newCommitted > addr)
+			newCommitted -= kHostStackGrowSize;
+		if (newCommitted < stack->bottom)
+			newCommitted = stack->bottom;
+		if (mprotect((void *)newCommitted, committed - newCommitted, PROT_READ | PROT_WRITE) == 0)
+		{
+			__atomic_store_n(&stack->committed, newCommitted, __ATOMIC_RELEASE);
+			__atomic_add_fetch(&gHostStackStats.committed, committed - newCommitted, __ATOMIC_RELAXED);
+			__atomic_add_fetch(&gHostStackStats.numOfGrowths, 1, __ATOMIC_RELAXED);
+			return;
+		}
+	}
+
+	// the stack has overflowed
+	__atomic_add_fetch(&gHostStackStats.numOfOverflows, 1, __ATOMIC_RELAXED);
+	static const char msg[] = "Task stack overflow\n";
+	write(STDERR_FILENO, msg, sizeof(msg) - 1);
+	abort();
+}
+
+
+/*------------------------------------------------------------------------------
+	Install the fault handler. Called once only.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+InstallHostStackFaultHandler(void)
+{
+	struct sigaction	action;
+
+	gHostPageSize = sysconf(_SC_PAGESIZE);
+
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = HostStackFaultHandler;
+	action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGSEGV, &action, &gPrevSEGVAction) != 0
+	||  sigaction(SIGBUS, &action, &gPrevBUSAction) != 0)
+		gHostStackHandlerErr = kOSErrCouldNotCreateObject;
+}
+
+
+/*------------------------------------------------------------------------------
+	Give the calling thread an alternate signal stack, if it hasn’t got one
+	already, for the fault handler to run on.
+	NewHostStack does this for the thread that creates a task stack, which is
+	the thread that runs Newton tasks; any other thread that runs on a host
+	stack must call this itself.
+	Args:		--
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+PrepareHostStackThread(void)
+{
+	if (!tHasSignalStack)
+	{
+		stack_t	ss;
+		if (sigaltstack(NULL, &ss) != 0)
+			return kOSErrCouldNotCreateObject;
+		if ((ss.ss_flags & SS_DISABLE) != 0 || ss.ss_size < kHostSignalStackSize)
+		{
+			// never freed; it must outlast anything that runs on this thread
+			if ((ss.ss_sp = malloc(kHostSignalStackSize)) == NULL)
+				return kOSErrNoMemory;
+			ss.ss_size = kHostSignalStackSize;
+			ss.ss_flags = 0;
+			if (sigaltstack(&ss, NULL) != 0)
+			{
+				free(ss.ss_sp);
+				return kOSErrCouldNotCreateObject;
+			}
+		}
+		tHasSignalStack = true;
+	}
+	return noErr;
+}
+
+
+/*------------------------------------------------------------------------------
+	Create a stack.
+	Args:		inSize				size to commit now; the stack can grow beyond
+										this by kHostStackGrowRoom
+				outTopOfStack		byte after the stack
+				outBottomOfStack	lowest byte the stack can grow to
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+NewHostStack(size_t inSize, VAddr * outTopOfStack, VAddr * outBottomOfStack)
+{
+	NewtonErr	err = noErr;
+	HostStack *	stack = NULL;
+	void *		mem = MAP_FAILED;
+	size_t		commitSize, reserveSize;
+
+	XTRY
+	{
+		pthread_once(&gHostStackHandlerOnce, InstallHostStackFaultHandler);
+		XFAIL(err = gHostStackHandlerErr)
+		XFAIL(err = PrepareHostStackThread())
+
+		// claim a slot
+		for (ArrayIndex i = 0; i < kMaxNumOfHostStacks; ++i)
+		{
+			VAddr	unused = 0;
+			if (__atomic_compare_exchange_n(&gHostStack[i].start, &unused, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			{
+				stack = &gHostStack[i];
+				break;
+			}
+		}
+		XFAILIF(stack == NULL, err = kOSErrCouldNotCreateObject;)
+
+		// reserve address space for all of it, but commit only the top
+		commitSize = (inSize + gHostPageSize - 1) & ~(gHostPageSize - 1);
+		reserveSize = kHostStackGuardSize + kHostStackGrowRoom + commitSize;
+		mem = mmap(NULL, reserveSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		XFAILIF(mem == MAP_FAILED, err = kOSErrNoMemory;)
+		XFAILIF(commitSize > 0 && mprotect((char *)mem + reserveSize - commitSize, commitSize, PROT_READ | PROT_WRITE) != 0, err = kOSErrNoMemory;)
+
+		stack->bottom = (VAddr)mem + kHostStackGuardSize;
+		stack->top = (VAddr)mem + reserveSize;
+		stack->committed = stack->top - commitSize;
+		__atomic_store_n(&stack->start, (VAddr)mem, __ATOMIC_RELEASE);
+
+		__atomic_add_fetch(&gHostStackStats.numOfStacks, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&gHostStackStats.reserved, reserveSize, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&gHostStackStats.committed, commitSize, __ATOMIC_RELAXED);
+
+		*outTopOfStack = stack->top;
+		*outBottomOfStack = stack->bottom;
+	}
+	XENDTRY;
+
+	XDOFAIL(err)
+	{
+		if (mem != MAP_FAILED)
+			munmap(mem, reserveSize);
+		if (stack != NULL)
+			__atomic_store_n(&stack->start, 0, __ATOMIC_RELEASE);
+	}
+	XENDFAIL;
+
+	return err;
+}
+
+
+/*------------------------------------------------------------------------------
+	Free a stack.
+	Args:		inTopOfStack		byte after the stack, as returned by NewHostStack
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+FreeHostStack(VAddr inTopOfStack)
+{
+	for (ArrayIndex i = 0; i < kMaxNumOfHostStacks; ++i)
+	{
+		HostStack *	stack = &gHostStack[i];
+		VAddr			start = __atomic_load_n(&stack->start, __ATOMIC_ACQUIRE);
+		if (start > 1 && stack->top == inTopOfStack)
+		{
+			__atomic_sub_fetch(&gHostStackStats.numOfStacks, 1, __ATOMIC_RELAXED);
+			__atomic_sub_fetch(&gHostStackStats.reserved, stack->top - start, __ATOMIC_RELAXED);
+			__atomic_sub_fetch(&gHostStackStats.committed, stack->top - stack->committed, __ATOMIC_RELAXED);
+			munmap((void *)start, stack->top - start);
+			__atomic_store_n(&stack->start, 0, __ATOMIC_RELEASE);
+			break;
+		}
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	The current task has run its stack down into the reserve: throw
+	exOutOfStack, unwinding it to whoever can handle that.
+	Args:		--
+	Return:	--		never
+------------------------------------------------------------------------------*/
+
+void
+HostStackOverflow(void)
+{
+	__atomic_add_fetch(&gHostStackStats.numOfOverflows, 1, __ATOMIC_RELAXED);
+	ThrowErr(exOutOfStack, kStackErrStackOverflow);
+}
+
+
+/*------------------------------------------------------------------------------
+	Return stack usage.
+	Args:		outStats		the statistics
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+GetHostStackStatistics(HostStackStatistics * outStats)
+{
+	outStats->numOfStacks = __atomic_load_n(&gHostStackStats.numOfStacks, __ATOMIC_RELAXED);
+	outStats->reserved = __atomic_load_n(&gHostStackStats.reserved, __ATOMIC_RELAXED);
+	outStats->committed = __atomic_load_n(&gHostStackStats.committed, __ATOMIC_RELAXED);
+	outStats->numOfGrowths = __atomic_load_n(&gHostStackStats.numOfGrowths, __ATOMIC_RELAXED);
+	outStats->numOfOverflows = __atomic_load_n(&gHostStackStats.numOfOverflows, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,96 @@
+/*
+	File:		HostStack.h
+
+	Contains:	Growable task stacks for the host.
+					On the Newton, task stacks are demand-paged by the stack manager
+					and overflow is caught by the MMU. On the host, each task stack
+					is a large reservation of address space: the top is committed,
+					the rest is committed a chunk at a time as the stack grows into
+					it, and below that is a guard zone.
+					Code that recurses as deep as its input takes it calls
+					CheckHostStack on the way down, which throws exOutOfStack
+					while there is still room to unwind. Anything that gets past
+					that to the guard reports the overflow and aborts, rather
+					than let the task run on over whatever lies below.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__HOSTSTACK_H)
+#define __HOSTSTACK_H 1
+
+#include "Newton.h"
+#include "TaskGlobals.h"
+#include <stddef.h>
+
+
+/*------------------------------------------------------------------------------
+	H o s t   S t a c k
+	A stack looks like this:
+		top			->	.--.
+							|	|	committed when created
+							|	|
+							|	|	committed on demand, kHostStackGrowSize at a time
+							|	|	kHostStackReserveSize; CheckHostStack throws here
+		bottom		->	|--|
+							|	|	kHostStackGuardSize guard; never committed
+							!__!
+	Faults below the committed part are caught by a SIGSEGV/SIGBUS handler
+	that runs on an alternate signal stack, since the task stack is the one
+	that has run out. Faults anywhere else are passed on to whatever handler
+	was there before.
+	A frame bigger than the guard can jump right over it; nothing can be
+	done about that.
+------------------------------------------------------------------------------*/
+
+#define kHostStackGuardSize		(64*1024)
+#define kHostStackReserveSize		(64*1024)
+#define kHostStackGrowSize			(64*1024)
+#if __LP64__
+#define kHostStackGrowRoom			(8*1024*1024)		// reserved beyond the size asked for
+#else
+#define kHostStackGrowRoom			(1024*1024)
+#endif
+#define kHostSignalStackSize		(64*1024)
+#define kMaxNumOfHostStacks		256
+
+struct HostStackStatistics
+{
+	ArrayIndex	numOfStacks;		// currently allocated
+	size_t		reserved;			// bytes of address space, including guards
+	size_t		committed;			// bytes
+	ArrayIndex	numOfGrowths;		// faults that grew a stack
+	ArrayIndex	numOfOverflows;	// exOutOfStacks thrown, and faults that hit a guard
+};
+
+
+/*------------------------------------------------------------------------------
+	P u b l i c   I n t e r f a c e
+------------------------------------------------------------------------------*/
+
+extern NewtonErr	NewHostStack(size_t inSize, VAddr * outTopOfStack, VAddr * outBottomOfStack);
+extern void			FreeHostStack(VAddr inTopOfStack);
+extern NewtonErr	PrepareHostStackThread(void);
+
+extern void			GetHostStackStatistics(HostStackStatistics * outStats);
+
+extern void			HostStackOverflow(void);
+
+
+/*------------------------------------------------------------------------------
+	Throw exOutOfStack if the current task is within kHostStackReserveSize of
+	the bottom of its stack.
+	Only the task's own stack counts: running on any other stack -- a host
+	thread's, say -- the unsigned difference is huge and nothing is thrown.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+inline void
+CheckHostStack(void)
+{
+	if ((VAddr)__builtin_frame_address(0) - TaskSwitchedGlobals()->fStackBottom < kHostStackReserveSize)
+		HostStackOverflow();
+}
+
+#endif	/* __HOSTSTACK_H */
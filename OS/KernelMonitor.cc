@@ -286,7 +286,10 @@ CMonitor::setUpEntry(CTask * inTask)
 	//	fMonitorTask->fRegister[11] = inTask->fRegister[11];	// huh?
 		fMonitorTask->fRegister[kcTheStack] = fMonitorTask->fTaskData;	// top of stack is bottom of data
 
-#if defined(__i386__)
+#if defined(hasPortableSWI)
+		// args are passed in registers as per ARM
+
+#elif defined(__i386__)
 		// args are passed on the stack
 		unsigned long * sp = (unsigned long *)fMonitorTask->fTaskData;
 		fMonitorTask->fRegister[kcTheFrame] = (VAddr)sp;
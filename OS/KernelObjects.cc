@@ -733,7 +733,7 @@ ObjectGetRegister(ObjectMessage * inMsg, size_t inSize, ULong * outResult)
 		XFAILIF(inSize != MSG_SIZE(1), err = kOSErrBadParameters;)
 
 		XFAILIF((reg = inMsg->request.reg.number) >= kNumOfRegisters, err = kOSErrBadRegisterNumber;)
-		XFAIL((task = (CTask *)IdToObj(kTaskType, inMsg->target)) == NULL)
+		XFAILIF((task = (CTask *)IdToObj(kTaskType, inMsg->target)) == NULL, err = kOSErrBadObjectId;)
 
 		EnterAtomic();
 		*outResult = task->fRegister[reg];
@@ -781,8 +781,8 @@ SetDomainFaultMonitor(ObjectMessage * inMsg, size_t inSize)
 		CMonitor *	monitor;
 
 		XFAILIF(inSize != MSG_SIZE(2), err = kOSErrBadParameters;)
-		XFAILNOT(domain == (CDomain *)IdToObj(kDomainType, inMsg->request.faultMonitor.domainId), err = kOSErrBadParameters;)
-		XFAILNOT(monitor == (CMonitor *)IdToObj(kMonitorType, inMsg->request.faultMonitor.monitorId), err = kOSErrBadObjectId;)
+		XFAILNOT(domain = (CDomain *)IdToObj(kDomainType, inMsg->request.faultMonitor.domainId), err = kOSErrBadParameters;)
+		XFAILNOT(monitor = (CMonitor *)IdToObj(kMonitorType, inMsg->request.faultMonitor.monitorId), err = kOSErrBadObjectId;)
 		err = domain->setFaultMonitor(inMsg->request.faultMonitor.monitorId);
 	}
 	XENDTRY;
@@ -805,7 +805,7 @@ SetDomainFaultMonitor(ObjectMessage * inMsg, size_t inSize)
 ScavengeProcPtr
 ObjectScavenger(CObject * inObject, ObjectId inId)
 {
-	ScavengeProcPtr	scavenger;
+	ScavengeProcPtr	scavenger = NULL;	// => can't be scavenged yet
 
 	switch (ObjectType(*inObject))
 	{
@@ -939,10 +939,25 @@ DeleteNothing(CObject * inObj)
 		memory architecture page object table
 ------------------------------------------------------------------------------*/
 
+/*------------------------------------------------------------------------------
+	Hash an object id.
+	Multiplying by an odd constant maps ids one-to-one onto hashes, and spreads
+	consecutive ids across the top bits -- which index the table.
+	Args:		inId			the objects id
+	Return:	its hash
+------------------------------------------------------------------------------*/
+
+static inline ULong
+HashId(ObjectId inId)
+{
+	return (ULong)inId * 2654435769U;
+}
+
+
 /*------------------------------------------------------------------------------
 	Initialize the object table.
 	Set up a null scavenging procedure and clear the table.
-	The table is a hash table indexed by object id (without object type).
+	The table is a hash table indexed by the top bits of the object ids hash.
 	Args:		--
 	Return:	error code
 ------------------------------------------------------------------------------*/
@@ -952,13 +967,64 @@ CObjectTable::init(void)
 {
 	fScavenge = NullScavenger;
 	fScavengeIndex = 0;
-	for (ArrayIndex i = 0; i < kObjectTableSize; ++i)
+	fThisObj = fPrevObj = NULL;
+	fCount = 0;
+	fSize = kObjectTableSize;
+	fShift = 32 - __builtin_ctz(kObjectTableSize);
+	if ((fObject = (CObject **)NewPtr(fSize * sizeof(CObject *))) == NULL)
+		return kOSErrNoMemory;
+	for (ArrayIndex i = 0; i < fSize; ++i)
 		fObject[i] = NULL;
 
 	return noErr;
 }
 
 
+/*------------------------------------------------------------------------------
+	Double the number of chains in the table.
+	Chain i splits into chains 2i and 2i+1 according to the next bit of the
+	hash; appending to their tails keeps them in hash order.
+	Objects are rechained with FIQs disabled so that nothing can look one up
+	half way; doubling keeps the cost of that to O(1) per object added.
+	If theres no memory for a bigger table we carry on with longer chains.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CObjectTable::grow(void)
+{
+	ArrayIndex	newSize = 2 * fSize;
+	CObject **	newTable = (CObject **)NewPtr(newSize * sizeof(CObject *));
+	if (newTable == NULL)
+		return;
+
+	EnterFIQAtomic();
+	for (ArrayIndex i = 0; i < fSize; ++i)
+	{
+		CObject **	tail[2] = { &newTable[2*i], &newTable[2*i+1] };
+		CObject *	next;
+		for (CObject * obj = fObject[i]; obj != NULL; obj = next)
+		{
+			ArrayIndex	half = (HashId(obj->fId) >> (fShift - 1)) & 1;
+			next = obj->fNext;
+			*tail[half] = obj;
+			tail[half] = &obj->fNext;
+		}
+		*tail[0] = NULL;
+		*tail[1] = NULL;
+	}
+	CObject **	oldTable = fObject;
+	fObject = newTable;
+	fSize = newSize;
+	fShift--;
+	fScavengeIndex *= 2;
+	ExitFIQAtomic();
+
+	FreePtr((Ptr)oldTable);
+}
+
+
 /*------------------------------------------------------------------------------
 	Set the function that determines the scavenging procedure.
 	Args:		--
@@ -1004,6 +1070,7 @@ CObjectTable::scavenge(void)
 						fPrevObj->fNext = deadObject->fNext;
 					else
 						fObject[fScavengeIndex] = deadObject->fNext;
+					fCount--;
 					// delete the dead object
 					scavenger(deadObject);
 				}
@@ -1017,7 +1084,7 @@ CObjectTable::scavenge(void)
 		}
 		fPrevObj = NULL;
 		// try the next entry next time
-		fScavengeIndex = (fScavengeIndex + 1) & kObjectTableMask;
+		fScavengeIndex = (fScavengeIndex + 1) & (fSize - 1);
 	}
 }
 
@@ -1032,7 +1099,7 @@ CObjectTable::scavenge(void)
 void
 CObjectTable::scavengeAll(void)
 {
-	for (ArrayIndex i = 0; i < kObjectTableSize; ++i)
+	for (ArrayIndex i = 0, count = fSize; i < count; ++i)
 		scavenge();
 }
 
@@ -1049,7 +1116,7 @@ CObjectTable::reassignOwnership(ObjectId inOwnerId, ObjectId inNewOwnerId)
 {
 	if (exists(inNewOwnerId))
 	{
-		for (ArrayIndex i = 0; i < kObjectTableSize; ++i)
+		for (ArrayIndex i = 0; i < fSize; ++i)
 			for (CObject * obj = fObject[i]; obj != NULL; obj = obj->fNext)
 				if (obj->owner() == inOwnerId)
 					obj->setOwner(inNewOwnerId);
@@ -1081,14 +1148,14 @@ static ObjectId	gNextGlobalUniqueId = 0;		// 0C105544
 
 
 /*------------------------------------------------------------------------------
-	Convert ObjectId to index into object table.
-	Args:		inId
+	Convert an ObjectIds hash to an index into the object table.
+	Args:		inHash
 	Return:	the index
 ------------------------------------------------------------------------------*/
 
 inline ArrayIndex
-CObjectTable::tableIndex(ObjectId inId)
-{ return (inId >> kObjectTypeBits) & kObjectTableMask; }
+CObjectTable::tableIndex(ULong inHash)
+{ return inHash >> fShift; }
 
 
 /*------------------------------------------------------------------------------
@@ -1106,8 +1173,8 @@ CObjectTable::newId(KernelTypes inType)
 	{
 		bool				isPhys = (inType == kPhysType || inType == kExtPhysType);
 		CObjectTable *	object = (this == gObjectTable) ? gTheMemArchObjTbl : gObjectTable;
-		// check new id doesnt already exist
-		while (exists(uid) && isPhys && object->exists(uid))
+		// check new id doesnt already exist -- phys objects mustnt clash across tables either
+		while (exists(uid) || (isPhys && object->exists(uid)))
 			uid = (nextGlobalUniqueId() << kObjectTypeBits) | inType;
 	}
 	
@@ -1124,11 +1191,13 @@ CObjectTable::newId(KernelTypes inType)
 bool
 CObjectTable::exists(ObjectId inId)
 {
-	ArrayIndex i = tableIndex(inId);
-	for (CObject * obj = fObject[i]; obj != NULL; obj = obj->fNext)
+	ULong hash = HashId(inId);
+	for (CObject * obj = fObject[tableIndex(hash)]; obj != NULL; obj = obj->fNext)
 	{
 		if (obj->fId == inId)
 			return true;
+		if (HashId(obj->fId) > hash)
+			break;		// chains are in hash order
 	}
 
 	return false;
@@ -1144,8 +1213,8 @@ CObjectTable::exists(ObjectId inId)
 CObject *
 CObjectTable::get(ObjectId inId)
 {
-	ArrayIndex i = tableIndex(inId);
-	for (CObject * obj = fObject[i]; obj != NULL; obj = obj->fNext)
+	ULong hash = HashId(inId);
+	for (CObject * obj = fObject[tableIndex(hash)]; obj != NULL; obj = obj->fNext)
 	{
 		if (obj->fId == inId)
 		{
@@ -1153,6 +1222,8 @@ CObjectTable::get(ObjectId inId)
 				return obj;
 			break;
 		}
+		if (HashId(obj->fId) > hash)
+			break;		// chains are in hash order
 	}
 
 	return NULL;
@@ -1179,13 +1250,20 @@ CObjectTable::add(CObject * ioObject, KernelTypes inType, ObjectId inOwnerId)
 	ioObject->setOwner(inOwnerId);
 	ioObject->assignToTask(inOwnerId);
 
+	// keep the chains short
+	if (fCount >= kObjectTableMaxLoad * fSize)
+		grow();
+
 	EnterFIQAtomic();
 	// hash the id to get the table entry
-	ArrayIndex i = tableIndex(id);
-	CObject ** tableEntry = &fObject[i];
-	// insert the object at the head of the hash chain
-	ioObject->fNext = *tableEntry;
-	*tableEntry = ioObject;
+	ULong hash = HashId(id);
+	CObject ** link = &fObject[tableIndex(hash)];
+	// insert the object into the hash chain, in hash order
+	while (*link != NULL && HashId((*link)->fId) < hash)
+		link = &(*link)->fNext;
+	ioObject->fNext = *link;
+	*link = ioObject;
+	fCount++;
 	ExitFIQAtomic();
 	return *ioObject;
 }
@@ -1203,7 +1281,7 @@ CObjectTable::remove(ObjectId inId)
 	if (ObjectType(inId) != kNoType)
 	{
 		CObject * prev = NULL;
-		ArrayIndex i = tableIndex(inId);
+		ArrayIndex i = tableIndex(HashId(inId));
 
 		for (CObject * obj = fObject[i]; obj != NULL; prev = obj, obj = obj->fNext)
 		{
@@ -1219,6 +1297,7 @@ CObjectTable::remove(ObjectId inId)
 						prev->fNext = obj->fNext;
 					else
 						fObject[i] = obj->fNext;
+					fCount--;
 					if (obj == fThisObj)
 						// this object was due for scavenging so update pointer
 						fThisObj = obj->fNext;
@@ -1243,16 +1322,16 @@ CObjectTable::remove(ObjectId inId)
 
 /*------------------------------------------------------------------------------
 	Constructor.
+	Iterators run in the tables hash order, which doesnt change when the
+	table grows; an iterator carries on from the hash of the last id it
+	returned, so it remains valid whatever happens to the table.
 	Args:		inTable			the table
-				inId				id of object where iteration is to start
+				inId				id of object after which iteration is to start
 	Return:	--
 ------------------------------------------------------------------------------*/
 
 CObjectTableIterator::CObjectTableIterator(CObjectTable * inTable, ObjectId inId)
 {
-	fInitialIndex = (inId >> kObjectTypeMask) & kObjectTableMask;
-	fInitialId = inId;
-	fObject = NULL;
 	fTable = inTable;
 	setCurrentPosition(inId);
 }
@@ -1260,53 +1339,16 @@ CObjectTableIterator::CObjectTableIterator(CObjectTable * inTable, ObjectId inId
 
 /*------------------------------------------------------------------------------
 	Set the iterator at a position.
-	Args:		inId				the objects id
+	The object need no longer exist.
+	Args:		inId				the objects id; kNoId => before the first
 	Return:	true if the position was set successfully
 ------------------------------------------------------------------------------*/
 
 bool
 CObjectTableIterator::setCurrentPosition(ObjectId inId)
 {
-	fObject = NULL;
-	fIndex = fTable->tableIndex(inId);
-	fIsDone = (fIndex == fInitialIndex && inId > fInitialId);
-	do
-	{
-		if (!getThisLineNextEntry())
-			return false;
-	} while (fId != kNoId && fId > inId);
-
-	return true;
-}
-
-
-/*------------------------------------------------------------------------------
-	Update parameters for the next entry in the hash chain.
-	Args:		--
-	Return:	true if there is an entry
-------------------------------------------------------------------------------*/
-
-bool
-CObjectTableIterator::getThisLineNextEntry(void)
-{
-	fObject = fTable->fObject[(fObject == NULL) ? fInitialIndex : fIndex];
-	if (fObject)
-	{
-		// we found an object, its id is the iterators value
-		fId = (ObjectId)*fObject;
-		return true;
-	}
-
-	// if were done, say so now
-	fId = kNoId;
-	if (fIsDone)
-		return false;
-
-	// update the index - if wrapped to the beginning, were done
-	fIndex = (fIndex + 1) & kObjectTableMask;
-	if (fIndex == fInitialIndex)
-		fIsDone = true;
-
+	fId = inId;
+	fIsDone = false;
 	return true;
 }
 
@@ -1314,22 +1356,28 @@ CObjectTableIterator::getThisLineNextEntry(void)
 /*------------------------------------------------------------------------------
 	Return the next id existing in the table.
 	Args:		--
-	Return:	the id
+	Return:	the id; kNoId => there are no more
 ------------------------------------------------------------------------------*/
 
 ObjectId
 CObjectTableIterator::getNextTableId(void)
 {
-	do
+	if (!fIsDone)
 	{
-		if (!getThisLineNextEntry())
-			return fId;
-	} while (fId == kNoId);
-
-	if (fIsDone && fId <= fInitialId)
-		fId = kNoId;
+		// find the first object in hash order after the last one
+		ULong hash = HashId(fId);
+		for (ArrayIndex i = fTable->tableIndex(hash); i < fTable->fSize; ++i)
+		{
+			for (CObject * obj = fTable->fObject[i]; obj != NULL; obj = obj->fNext)
+			{
+				if (HashId(obj->fId) > hash)
+					return fId = obj->fId;
+			}
+		}
+		fIsDone = true;
+	}
 
-	return fId;
+	return kNoId;
 }
 
 
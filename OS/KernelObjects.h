@@ -188,9 +188,16 @@ private:
 
 /*--------------------------------------------------------------------------------
 	C O b j e c t T a b l e
+	A hash table of chains, doubled in size whenever there are more than
+	kObjectTableMaxLoad objects per chain.
+	An object is hashed by multiplying its id by a large odd constant -- a
+	one-to-one mapping -- and is chained by the top bits of its hash, in hash
+	order. So the table is always in hash order, whatever its size: doubling
+	splits each chain in two without disturbing that order, and iterators can
+	carry on from where they were.
 --------------------------------------------------------------------------------*/
-#define kObjectTableSize	0x80
-#define kObjectTableMask	0x7F
+#define kObjectTableSize		0x80		// initial number of chains
+#define kObjectTableMaxLoad	2
 
 typedef void (*ScavengeProcPtr)(CObject *);
 typedef ScavengeProcPtr (*GetScavengeProcPtr)(CObject *, ULong);
@@ -216,13 +223,17 @@ private:
 	friend class CObjectTableIterator;
 
 	ObjectId			nextGlobalUniqueId(void);
-	ArrayIndex		tableIndex(ObjectId inId);
+	ArrayIndex		tableIndex(ULong inHash);
+	void				grow(void);
 
 	GetScavengeProcPtr	fScavenge;				// +00
 	CObject *		fThisObj;
 	CObject *		fPrevObj;
 	ArrayIndex		fScavengeIndex;
-	CObject *		fObject[kObjectTableSize];	// +10
+	CObject **		fObject;			// chains
+	ArrayIndex		fSize;			// number of chains, a power of 2
+	ArrayIndex		fShift;			// 32 - log2(fSize)
+	ArrayIndex		fCount;			// number of objects
 };
 
 
@@ -241,14 +252,8 @@ public:
 	CObject *		getNextTypedObject(KernelTypes inType);
 
 private:
-	bool				getThisLineNextEntry(void);
-
-	ArrayIndex		fIndex;
-	ArrayIndex		fInitialIndex;
-	ObjectId			fId;
-	ObjectId			fInitialId;
+	ObjectId			fId;				// last id returned; kNoId => before the first
 	bool				fIsDone;
-	CObject *		fObject;
 	CObjectTable *	fTable;
 };
 
@@ -8,6 +8,7 @@
 
 #include "KernelPorts.h"
 #include "KernelGlobals.h"
+#include "KernelTrace.h"
 #include "Timers.h"
 #include "OSErrors.h"
 
@@ -30,13 +31,17 @@ extern "C" void	PortResetKernelGlue(ObjectId inPortId, ULong inSenderFlags, ULon
 CUPort *	gUNullPort;
 
 
+#pragma mark CPort
+/*--------------------------------------------------------------------------------
+	C P o r t
+--------------------------------------------------------------------------------*/
+
+
 /*--------------------------------------------------------------------------------
 	Constructor.
 --------------------------------------------------------------------------------*/
 
 CPort::CPort()
-	:	fSenders(offsetof(CSharedMemMsg, f80)),
-		fReceivers(offsetof(CSharedMemMsg, f80))
 { }
 
 
@@ -129,23 +134,16 @@ CPort::resetFilter(CSharedMemMsg * inMsg, ULong inFilter)
 		CSharedMemMsg * msg;
 
 		// someone must be waiting to receive the message
-		for (msg = (CSharedMemMsg *)fReceivers.peek(); msg != NULL; msg = (CSharedMemMsg *)fReceivers.getNext(msg))
-			if (msg == inMsg)
-				break;
-		XFAILNOT(msg, err = kOSErrNoMessageWaiting;)
+		XFAILNOT(fReceivers.contains(inMsg), err = kOSErrNoMessageWaiting;)
 
 		// update the messages filter
 		inMsg->fFilter = inFilter;
+		fReceivers.rekey(inMsg, inFilter);
 
 		// see if someones sent a suitable message
-		for (msg = (CSharedMemMsg *)fSenders.peek(); msg != NULL; msg = (CSharedMemMsg *)fSenders.getNext(msg))
-			if (msg->fFilter == kMsgType_MatchAll
-			|| (msg->fFilter & inMsg->fType) != 0)
-				break;
-		if (msg)
+		if ((msg = fSenders.removeMatch(inFilter)) != NULL)
 		{
 			// they have, it can be completed immediately
-			fSenders.removeFromQueue(msg);
 			inMsg->completeReceiver(msg);
 		}
 	}
@@ -165,6 +163,7 @@ NewtonErr
 CPort::send(CSharedMemMsg * inMsg, ULong inFlags)
 {
 	NewtonErr err = noErr;
+	TraceEvent(kTracePortSend, *this, inMsg->fType);
 	XTRY
 	{
 		CSharedMemMsg * msg;
@@ -172,15 +171,13 @@ CPort::send(CSharedMemMsg * inMsg, ULong inFlags)
 		// if message is to be sent async, queue it
 		if (FLAGTEST(inFlags, kPortFlags_TimerWanted) && inMsg->fTimeout != 0)
 		{
-			XFAILNOT(gTimerEngine->queueTimeout(inMsg), err = kOSErrMessageTimedOut;)
+			XFAIL(err = gTimerEngine->reserve())
+			XFAILNOT(gTimerEngine->queueTimeout(inMsg, true), err = kOSErrMessageTimedOut;)
 			inMsg->fFlags |= 0x0080;
 		}
 
 		// see if someones waiting for this message
-		for (msg = (CSharedMemMsg *)fReceivers.peek(); msg != NULL; msg = (CSharedMemMsg *)fReceivers.getNext(msg))
-			if (msg->fFilter == kMsgType_MatchAll
-			|| (msg->fFilter & inMsg->fType) != 0)
-				break;
+		msg = fReceivers.removeMatch(inMsg->fType);
 
 		if (FLAGTEST(inFlags, kPortFlags_CanRemoveTask))
 			UnScheduleTask(gCurrentTask);
@@ -190,16 +187,12 @@ CPort::send(CSharedMemMsg * inMsg, ULong inFlags)
 			// someones waiting for this message, let the receiver have it
 			if (FLAGTEST(inFlags, kPortFlags_ScheduleOnSend))
 				WantSchedule();
-			fReceivers.removeFromQueue(msg);
 			msg->completeReceiver(inMsg);
 		}
 		else
 		{
 			// noones waiting for this message, add it to the senders
-			if (FLAGTEST(inFlags, kPortFlags_Urgent))
-				fSenders.addToFront(inMsg);
-			else
-				fSenders.add(inMsg);
+			fSenders.add(inMsg, inMsg->fType, FLAGTEST(inFlags, kPortFlags_Urgent));
 		}
 	}
 	XENDTRY;
@@ -223,6 +216,7 @@ NewtonErr
 CPort::receive(CSharedMemMsg * inMsg, ULong inFlags)
 {
 	NewtonErr err = noErr;
+	TraceEvent(kTracePortReceive, *this, inMsg->fFilter);
 	XTRY
 	{
 		CSharedMemMsg * msg;
@@ -230,14 +224,12 @@ CPort::receive(CSharedMemMsg * inMsg, ULong inFlags)
 		// if message is async, queue it up
 		if (FLAGTEST(inFlags, kPortFlags_TimerWanted) && inMsg->fTimeout != 0)
 		{
-			XFAILNOT(gTimerEngine->queueTimeout(inMsg), err = kOSErrMessageTimedOut;)
+			XFAIL(err = gTimerEngine->reserve())
+			XFAILNOT(gTimerEngine->queueTimeout(inMsg, true), err = kOSErrMessageTimedOut;)
 		}
 
 		// see if someones sent a suitable message
-		for (msg = (CSharedMemMsg *)fSenders.peek(); msg != NULL; msg = (CSharedMemMsg *)fSenders.getNext(msg))
-			if (inMsg->fFilter == kMsgType_MatchAll
-			|| (inMsg->fFilter & msg->fType) != 0)
-				break;
+		msg = fSenders.removeMatch(inMsg->fFilter);
 
 		// if the caller wants to check whether its available, stop it timing out
 		if (FLAGTEST(inFlags, kPortFlags_IsMsgAvail))
@@ -250,7 +242,6 @@ CPort::receive(CSharedMemMsg * inMsg, ULong inFlags)
 		if (msg != NULL)
 		{
 			// someones sent the message were waiting for
-			fSenders.removeFromQueue(msg);
 			inMsg->completeReceiver(msg);
 		}
 		else
@@ -269,10 +260,7 @@ CPort::receive(CSharedMemMsg * inMsg, ULong inFlags)
 					// stop this task
 					UnScheduleTask(gCurrentTask);
 				// add message to the receivers waiting
-				if (FLAGTEST(inFlags, kPortFlags_Urgent))
-					fReceivers.addToFront(inMsg);
-				else
-					fReceivers.add(inMsg);
+				fReceivers.add(inMsg, inMsg->fFilter, FLAGTEST(inFlags, kPortFlags_Urgent));
 			}
 		}
 	}
@@ -339,7 +327,11 @@ PortSendKernelGlue(ObjectId inPortId, ObjectId inMsgId, ObjectId inMemId, ULong
 		if (!FLAGTEST(inFlags, kPortFlags_Async))
 			inFlags |= kPortFlags_CanRemoveTask;
 
-		if (FLAGTEST(inFlags, kPortFlags_WantDelay) && gTimerEngine->queueDelay(msg))
+		if (FLAGTEST(inFlags, kPortFlags_WantDelay))
+		{
+			XFAIL(err = gTimerEngine->reserve())
+		}
+		if (FLAGTEST(inFlags, kPortFlags_WantDelay) && gTimerEngine->queueDelay(msg, true))
 		{
 			if (FLAGTEST(inFlags, kPortFlags_CanRemoveTask))
 				UnScheduleTask(gCurrentTask);
@@ -12,6 +12,58 @@
 #include "KernelObjects.h"
 #include "SharedMem.h"
 
+/*--------------------------------------------------------------------------------
+	C P o r t Q u e u e
+	Messages waiting at a port -- senders keyed by their type, receivers by
+	their filter.
+	Messages with a single-bit key are queued in a bucket for that bit, so the
+	oldest match for a type is at the head of its bucket; match-all and
+	multi-bit keys go in a fallback queue. Every message is stamped as it is
+	queued so the oldest match across buckets can be found: FIFO order, and
+	urgent messages jumping the queue, work as if there were only one queue.
+	Most ports only ever see match-all messages, so the buckets are allocated
+	when a single-bit key is first queued. Until then -- or if there is no
+	memory for them -- everything goes in the fallback queue, which matches
+	any key, just more slowly.
+--------------------------------------------------------------------------------*/
+
+#define kNumOfPortBuckets	32
+
+class CPortBucket : public CDoubleQContainer
+{
+public:
+					CPortBucket();
+};
+
+class CPortQueue
+{
+public:
+					CPortQueue();
+					~CPortQueue();
+
+	void					add(CSharedMemMsg * inMsg, ULong inKey, bool inIsUrgent);
+	CSharedMemMsg *	remove(void);
+	CSharedMemMsg *	removeMatch(ULong inProbe);
+	bool					contains(CSharedMemMsg * inMsg);
+	void					rekey(CSharedMemMsg * inMsg, ULong inKey);
+
+private:
+	ArrayIndex			bucketFor(ULong inKey);
+	CDoubleQContainer *	queueAt(ArrayIndex inIndex);
+
+	CPortBucket		fOther;			// +00	match-all and multi-bit keys
+	CPortBucket *	fBucket;			// +14	kNumOfPortBuckets of them; NULL => not yet needed
+	ULong				fBucketMask;	// +18	buckets that may be non-empty
+	ULong				fFrontStamp;	// +1C	next stamp for an urgent message
+	ULong				fBackStamp;		// +20	next stamp for any other
+// size +24
+};
+
+
+/*--------------------------------------------------------------------------------
+	C P o r t
+--------------------------------------------------------------------------------*/
+
 class CPort : public CObject
 {
 public:
@@ -23,9 +75,9 @@ public:
 	NewtonErr	send(CSharedMemMsg * inMsg, ULong inFlags);
 	NewtonErr	receive(CSharedMemMsg * inMsg, ULong inFlags);
 
-	CDoubleQContainer	fSenders;	// +10
-	CDoubleQContainer	fReceivers;	// +24
-// size +38
+	CPortQueue	fSenders;		// +10
+	CPortQueue	fReceivers;		// +34
+// size +58 -- the original's plain queues made +38
 };
 
 #endif	/* __KERNELPORTS_H */
@@ -10,6 +10,10 @@
 
 #include "KernelTasks.h"
 #include "KernelGlobals.h"
+#include "KernelTrace.h"
+#if !defined(correct)
+#include "HostStack.h"
+#endif
 #include "Scheduler.h"
 #include "VirtualMemory.h"
 #include "OSErrors.h"
@@ -69,6 +73,7 @@ void
 SwapInGlobals(CTask * inTask)
 {
 //LogSwapIn(inTask);
+	TraceTaskEvent(inTask, kTraceSwapIn, inTask->fName);
 	gCurrentTaskId = *inTask;
 	gCurrentGlobals = inTask->fGlobals;
 	gCurrentMonitorId = inTask->fMonitorId;
@@ -91,7 +96,7 @@ InitializeExceptionGlobals(ExceptionGlobals * inGlobals)
 void
 TaskKillSelf(void)
 {
-#if __LP64__
+#if __LP64__ && !defined(hasPortableSWI)
 //	we RETURN into this function so we need to adjust the stack
 //	we will never return from this anyway
 __asm__ (
@@ -237,7 +242,11 @@ ResetAccountTimeKernelGlue(void)
 
 	EnterAtomic();
 	while ((task = (CTask *)iter.getNextTypedObject(kTaskType)) != NULL)
+	{
 		task->fTaskTime = 0;
+		task->fSwitchCount = 0;
+		task->fWaitTime = 0;
+	}
 	gTaskTimeStart = 0;
 	ExitAtomic();
 
@@ -355,6 +364,10 @@ CTask::CTask()
 	fSharedMemMsg = kNoId;
 	fGlobals = NULL;
 	fTaskTime = 0;
+	fSwitchCount = 0;
+	fWaitTime = 0;
+	fReadyTime = 0;
+	fTraceRing = NULL;
 	fTaskDataSize = 0;
 	fPtrsUsed = 0;
 	fHandlesUsed = 0;
@@ -369,6 +382,9 @@ CTask::CTask()
 	fBequeathId = kNoId;
 	fInheritedId = kNoId;
 	fPriority = kIdleTaskPriority;
+#if defined(hasPortableSWI)
+	fContext = NULL;
+#endif
 }
 
 
@@ -389,6 +405,10 @@ CTask::~CTask()
 		delete fEnvironment;
 	gObjectTable->remove(fSharedMem);
 	gObjectTable->remove(fSharedMemMsg);
+	ReleaseTraceRing(this);
+#if defined(hasPortableSWI)
+	DisposeTaskContext(fContext);
+#endif
 }
 
 
@@ -444,10 +464,17 @@ CTask::init(TaskProcPtr inProc, size_t inStackSize, ObjectId inTaskId, ObjectId
 #if __LP64__
 		stackSize *= 2;
 #endif
-		stackSize += sizeof(long)*16*KByte;	// add stack buffer since we don’t grow the stack automatically; idle task has zero stack size!
+		stackSize += sizeof(long)*16*KByte;	// commit a buffer up front so the stack seldom has to grow; idle task has zero stack size!
 //		taskDataSize += 256;		// add guard zone
 #endif
 
+#if !defined(correct)
+		// on the host, reserve a stack that grows on demand down to a guard zone; see HostStack.h
+		fState &= ~kMemIsVirtual;
+		XFAILIF(err = NewHostStack(stackSize + kABIStackAlignment + taskDataSize, &fStackTop, &fStackBase), fStackBase = 0;)
+		// round down, so the data stays inside the stack
+		fTaskData = TRUNC(fStackTop - taskDataSize, kABIStackAlignment);
+#else
 		if (gOSIsRunning)
 		{
 			// we’ve got the VM system, so create a new stack with a bit extra for the task data
@@ -470,6 +497,7 @@ CTask::init(TaskProcPtr inProc, size_t inStackSize, ObjectId inTaskId, ObjectId
 			fTaskData = ALIGN(fStackBase + stackSize, kABIStackAlignment);
 			fStackTop = fTaskData + taskDataSize;
 		}
+#endif
 //printf("CTask::init(stackSize=%08X,name=%c%c%c%c) stack=#%p-#%p...\n", (unsigned int)inStackSize, inName >> 24, inName >> 16, inName >> 8, inName, (void *)fStackBase, (void *)fStackTop);
 
 		// create shared memory
@@ -543,6 +571,17 @@ CTask::init(TaskProcPtr inProc, size_t inStackSize, ObjectId inTaskId, ObjectId
 		fRegister[kcTheStack] = fTaskData;		// top of stack
 		fRegister[kcTheLink] = (VAddr) TaskKillSelf;	// kill self when done
 
+#elif defined(hasPortableSWI)
+		// registers as per ARM; the SWI handler starts the task on its own stack
+		XFAILNOT(fContext = NewTaskContext(), err = kOSErrNoMemory;)
+		fRegister[kParm0] = (VAddr) fGlobals;
+		fRegister[kParm1] = dataSize;
+		fRegister[kParm2] = inTaskId;
+		for (ArrayIndex i = 3; i < kcTheStack; ++i)
+			fRegister[i] = 0;
+		fRegister[kcTheStack] = fTaskData;		// top of stack
+		fRegister[kcTheLink] = (VAddr) TaskKillSelf;	// kill self when done
+
 #elif defined(__i386__)
 		fRegister[0] = fRegister[1] = fRegister[2] = fRegister[3] = fRegister[4] = fRegister[5] = 0;	// eax, ebx, ecx, edx, esi, edi
 		/*
@@ -612,10 +651,14 @@ CTask::freeStack(void)
 {
 	if (fStackBase != 0)
 	{
+#if !defined(correct)
+		FreeHostStack(fStackTop);
+#else
 		if ((fState & kMemIsVirtual) != 0)
 			FreePagedMem(fStackTop - 1);
 		else
 			FreePtr((Ptr)fStackBase);
+#endif
 	}
 }
 
@@ -84,6 +84,8 @@ private:
 --------------------------------------------------------------------------------*/
 class CEnvironment;
 class CMonitor;
+struct TaskContext;
+struct TraceRing;
 
 class CTask : public CObject
 {
@@ -123,7 +125,7 @@ public:
 	ObjectId			fMonitor;			// +D4	if task is running in a monitor, that monitor
 	ObjectId			fMonitorId;			// +D8	if this task is a monitor, its id
 	VAddr				fCopySavedPC;		// +DC	PC register saved during copy task
-#if defined(__i386__) || defined(__x86_64__)
+#if !defined(hasPortableSWI) && (defined(__i386__) || defined(__x86_64__))
 	VAddr				fCopySavedesi;
 	VAddr				fCopySavededi;
 #endif
@@ -136,10 +138,23 @@ public:
 	VAddr				fTaskData;			// +F8	address of task globals (usually == this)
 	ObjectId			fBequeathId;		// +FC
 	ObjectId			fInheritedId;		// +100
+// not in the original
+	ULong				fSwitchCount;		// times this task has been switched in
+	CTime				fWaitTime;			// time spent ready to run but not running
+	CTime				fReadyTime;			// when it was last made ready to run
+	TraceRing *		fTraceRing;			// ring it logs trace events into
+#if defined(hasPortableSWI)
+	TaskContext *	fContext;			// host context it was switched out in
+#endif
 };
 
 
 extern "C" void	SwapInGlobals(CTask * inTask);
 
+#if defined(hasPortableSWI)
+extern TaskContext *	NewTaskContext(void);
+extern void				DisposeTaskContext(TaskContext * inContext);
+#endif
+
 
 #endif	/* __KERNELTASKS_H */
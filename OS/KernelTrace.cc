@@ -0,0 +1,519 @@
+/*
+	File:		KernelTrace.cc
+
+	Contains:	Kernel event trace implementation.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "KernelTrace.h"
+#include "KernelTasks.h"
+#include "Objects.h"
+#include "Unicode.h"
+#include "OSErrors.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+
+/* -----------------------------------------------------------------------------
+	P l a i n   C   F u n c t i o n   I n t e r f a c e
+----------------------------------------------------------------------------- */
+
+extern "C" {
+Ref	FKernelTrace(RefArg inRcvr, RefArg inOn);
+Ref	FDumpKernelTrace(RefArg inRcvr, RefArg inFilename);
+}
+
+
+/* -----------------------------------------------------------------------------
+	D a t a
+----------------------------------------------------------------------------- */
+
+bool					gKernelTraceOn = false;
+
+static TraceRing *	gTraceRings = NULL;			// kNumOfTraceRings of them
+static ArrayIndex		gTraceRingsUsed = 1;			// ring 0 is for interrupt level
+static char *			gTraceExitPath = NULL;
+static uint64_t		gTraceStartTicks;			// clocks read when tracing was first started
+static uint64_t		gTraceStartNanos;
+
+
+/*------------------------------------------------------------------------------
+	Read the host clock.
+	Args:		--
+	Return:	nanoseconds
+------------------------------------------------------------------------------*/
+
+static inline uint64_t
+HostNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/*------------------------------------------------------------------------------
+	Read the CPU’s cycle counter.
+	This is what events are stamped with: it costs a fraction of what
+	clock_gettime does. Ticks are converted to nanoseconds when the trace is
+	dumped, by timing them against HostNanoseconds.
+	Args:		--
+	Return:	ticks
+------------------------------------------------------------------------------*/
+
+static inline uint64_t
+HostTicks(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#elif defined(__aarch64__)
+	uint64_t ticks;
+	__asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (ticks));
+	return ticks;
+#else
+	return HostNanoseconds();
+#endif
+}
+
+
+#pragma mark Logging
+/*------------------------------------------------------------------------------
+	Start logging events.
+	The rings are allocated the first time; they are never freed, since the
+	trace may be dumped at any time.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+StartKernelTrace(void)
+{
+	if (gTraceRings == NULL)
+	{
+		gTraceRings = (TraceRing *) calloc(kNumOfTraceRings, sizeof(TraceRing));
+		if (gTraceRings == NULL)
+			return;
+		gTraceStartTicks = HostTicks();
+		gTraceStartNanos = HostNanoseconds();
+	}
+	gKernelTraceOn = true;
+}
+
+
+/*------------------------------------------------------------------------------
+	Stop logging events.
+	What has been logged is kept, so it can still be dumped.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+StopKernelTrace(void)
+{
+	gKernelTraceOn = false;
+}
+
+
+/*------------------------------------------------------------------------------
+	Assign a ring to a task.
+	A ring released by a dead task is reused first; what it logged stays in
+	the ring, still marked with its own task id, until it is overwritten.
+	Args:		inTask		the task
+	Return:	its ring
+------------------------------------------------------------------------------*/
+
+static TraceRing *
+AssignTraceRing(CTask * inTask)
+{
+	TraceRing *	newRing = NULL;
+	ArrayIndex	numOfRings = MIN(__atomic_load_n(&gTraceRingsUsed, __ATOMIC_RELAXED), kNumOfTraceRings);
+	for (ArrayIndex i = 1; i < numOfRings && newRing == NULL; ++i)
+	{
+		ULong	numOfUsers = 0;
+		if (__atomic_compare_exchange_n(&gTraceRings[i].numOfUsers, &numOfUsers, 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			newRing = &gTraceRings[i];
+	}
+	if (newRing == NULL)
+	{
+		ArrayIndex	index = __atomic_fetch_add(&gTraceRingsUsed, 1, __ATOMIC_RELAXED);
+		if (index >= kNumOfTraceRings)
+		{
+			// they have all gone -- share the last one
+			index = kNumOfTraceRings - 1;
+			__atomic_store_n(&gTraceRingsUsed, kNumOfTraceRings, __ATOMIC_RELAXED);
+		}
+		newRing = &gTraceRings[index];
+		__atomic_fetch_add(&newRing->numOfUsers, 1, __ATOMIC_RELAXED);
+	}
+
+	TraceRing *	ring = NULL;
+	// if something else got in first, use its choice
+	if (!__atomic_compare_exchange_n(&inTask->fTraceRing, &ring, newRing, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{
+		__atomic_fetch_sub(&newRing->numOfUsers, 1, __ATOMIC_RELAXED);
+		return ring;
+	}
+	return newRing;
+}
+
+
+/*------------------------------------------------------------------------------
+	Release a task's ring, if it has one, when the task is destroyed.
+	Args:		inTask		the task
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+ReleaseTraceRing(CTask * inTask)
+{
+	TraceRing *	ring = __atomic_exchange_n(&inTask->fTraceRing, (TraceRing *)NULL, __ATOMIC_RELAXED);
+	if (ring != NULL)
+		__atomic_fetch_sub(&ring->numOfUsers, 1, __ATOMIC_RELEASE);
+}
+
+
+/*------------------------------------------------------------------------------
+	Log an event.
+	The record is claimed, and its seq cleared, before anything else is
+	written, and its seq is set after; a reader that sees the same seq
+	before and after copying it knows it has a whole record.
+	Args:		inTask		the task to log against; NULL => interrupt level
+				inEvent		ETraceEvent
+				inArg1		event-specific data
+				inArg2
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+AddTraceEvent(CTask * inTask, ULong inEvent, ULong inArg1, ULong inArg2)
+{
+	TraceRing *	ring;
+	if (inTask == NULL)
+		ring = &gTraceRings[0];
+	else if ((ring = inTask->fTraceRing) == NULL)
+		ring = AssignTraceRing(inTask);
+
+	ULong				index = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+	TraceRecord *	record = &ring->record[index & (kTraceRingSize - 1)];
+	__atomic_store_n(&record->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&record->time, HostTicks(), __ATOMIC_RELAXED);
+	__atomic_store_n(&record->task, inTask ? (ObjectId)*inTask : kNoId, __ATOMIC_RELAXED);
+	__atomic_store_n(&record->event, inEvent, __ATOMIC_RELAXED);
+	__atomic_store_n(&record->arg1, inArg1, __ATOMIC_RELAXED);
+	__atomic_store_n(&record->arg2, inArg2, __ATOMIC_RELAXED);
+	__atomic_store_n(&record->seq, index + 1, __ATOMIC_RELEASE);
+}
+
+
+#pragma mark -
+#pragma mark Dumping
+/*------------------------------------------------------------------------------
+	Copy the records out of a ring.
+	Records that are being written, or have been overwritten, as we copy them
+	are skipped.
+	Args:		inRing		the ring
+				outRecords	where to copy them: room for kTraceRingSize
+	Return:	number of records copied
+------------------------------------------------------------------------------*/
+
+static ArrayIndex
+CopyTraceRing(TraceRing * inRing, TraceRecord * outRecords)
+{
+	ArrayIndex	count = 0;
+	ULong			head = __atomic_load_n(&inRing->head, __ATOMIC_ACQUIRE);
+	ULong			index = head > kTraceRingSize ? head - kTraceRingSize : 0;
+	for ( ; index != head; ++index)
+	{
+		TraceRecord *	record = &inRing->record[index & (kTraceRingSize - 1)];
+		TraceRecord *	copy = &outRecords[count];
+		ULong				seq = __atomic_load_n(&record->seq, __ATOMIC_ACQUIRE);
+		if (seq != index + 1)
+			continue;
+		copy->time = __atomic_load_n(&record->time, __ATOMIC_RELAXED);
+		copy->task = __atomic_load_n(&record->task, __ATOMIC_RELAXED);
+		copy->event = __atomic_load_n(&record->event, __ATOMIC_RELAXED);
+		copy->arg1 = __atomic_load_n(&record->arg1, __ATOMIC_RELAXED);
+		copy->arg2 = __atomic_load_n(&record->arg2, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&record->seq, __ATOMIC_RELAXED) == seq)
+		{
+			copy->seq = seq;
+			count++;
+		}
+	}
+	return count;
+}
+
+
+static int
+CompareTraceRecords(const void * inRec1, const void * inRec2)
+{
+	const TraceRecord *	rec1 = (const TraceRecord *)inRec1;
+	const TraceRecord *	rec2 = (const TraceRecord *)inRec2;
+	if (rec1->time != rec2->time)
+		return rec1->time < rec2->time ? -1 : 1;
+	// same time, same ring => keep them in order
+	return (rec1->seq > rec2->seq) - (rec1->seq < rec2->seq);
+}
+
+
+/*------------------------------------------------------------------------------
+	Write a JSON timestamp: microseconds since the start of the trace.
+	Args:		inFile
+				inTicks		ticks since the start of the trace
+				inScale		nanoseconds per tick
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+PrintTraceTime(FILE * inFile, uint64_t inTicks, double inScale)
+{
+	uint64_t	nanos = (uint64_t)(inTicks * inScale);
+	fprintf(inFile, "%llu.%03u", (unsigned long long)(nanos / 1000), (unsigned)(nanos % 1000));
+}
+
+
+/*------------------------------------------------------------------------------
+	Write a task’s name, the first time it is seen, as trace metadata.
+	Args:		inFile
+				inRecord		its swap-in record
+				ioSeen		ids of tasks already named
+				ioNumOfSeen
+	Return:	--
+------------------------------------------------------------------------------*/
+
+#define kMaxNamedTasks 256
+
+static void
+PrintTraceTaskName(FILE * inFile, const TraceRecord * inRecord, ObjectId * ioSeen, ArrayIndex * ioNumOfSeen)
+{
+	ArrayIndex i;
+	for (i = 0; i < *ioNumOfSeen; ++i)
+		if (ioSeen[i] == inRecord->task)
+			return;
+	if (*ioNumOfSeen < kMaxNamedTasks)
+		ioSeen[(*ioNumOfSeen)++] = inRecord->task;
+
+	char name[5];
+	for (i = 0; i < 4; ++i)
+	{
+		char ch = (inRecord->arg1 >> (24 - 8*i)) & 0xFF;
+		name[i] = (ch >= ' ' && ch <= '~' && ch != '"' && ch != '\\') ? ch : '.';
+	}
+	name[4] = 0;
+	fprintf(inFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s #%u\"}}", inRecord->task, name, inRecord->task);
+}
+
+
+/*------------------------------------------------------------------------------
+	Write the events logged so far as a Chrome/Perfetto JSON trace.
+	Each task is a thread; the time between its swap-in and the next task’s
+	is shown as a run slice. Rings wrap at different rates, so the oldest
+	part of the trace may be missing some tasks’ events.
+	Args:		inPath				file to write
+				outNumOfEvents		number of events written; may be NULL
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+DumpKernelTrace(const char * inPath, ArrayIndex * outNumOfEvents)
+{
+	NewtonErr		err = noErr;
+	TraceRecord *	records = NULL;
+	ArrayIndex		count = 0;
+	FILE *			file = NULL;
+
+	XTRY
+	{
+		XFAILIF((file = fopen(inPath, "w")) == NULL, err = kOSErrBadParameters;)
+
+		if (gTraceRings != NULL)
+		{
+			ArrayIndex numOfRings = MIN(__atomic_load_n(&gTraceRingsUsed, __ATOMIC_RELAXED), kNumOfTraceRings);
+			XFAILIF((records = (TraceRecord *) NewPtr(numOfRings * kTraceRingSize * sizeof(TraceRecord))) == NULL, err = kOSErrNoMemory;)
+			for (ArrayIndex i = 0; i < numOfRings; ++i)
+				count += CopyTraceRing(&gTraceRings[i], records + count);
+			qsort(records, count, sizeof(TraceRecord), CompareTraceRecords);
+		}
+
+		fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+		fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Newton\"}}");
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"interrupts\"}}");
+
+		// time the ticks we have seen against the host clock
+		uint64_t				ticks = HostTicks() - gTraceStartTicks;
+		double				scale = ticks != 0 ? (double)(HostNanoseconds() - gTraceStartNanos) / ticks : 1.0;
+
+		ObjectId				named[kMaxNamedTasks];
+		ArrayIndex			numOfNamed = 0;
+		const TraceRecord *	running = NULL;
+		uint64_t				start = count > 0 ? records[0].time : 0;
+		for (ArrayIndex i = 0; i < count; ++i)
+		{
+			const TraceRecord *	record = &records[i];
+			const char *			name = NULL;
+			const char *			phase = "i";
+			switch (record->event)
+			{
+			case kTraceSwapIn:
+				PrintTraceTaskName(file, record, named, &numOfNamed);
+				break;
+			case kTracePortSend:
+				name = "send";
+				break;
+			case kTracePortReceive:
+				name = "receive";
+				break;
+			case kTraceTimerAlarm:
+				name = "alarm";
+				break;
+			case kTraceGCBegin:
+				name = "GC", phase = "B";
+				break;
+			case kTraceGCEnd:
+				name = "GC", phase = "E";
+				break;
+			case kTraceCommitBegin:
+				name = "commit", phase = "B";
+				break;
+			case kTraceCommitEnd:
+				name = "commit", phase = "E";
+				break;
+			}
+
+			if (record->event == kTraceSwapIn)
+			{
+				// the task that was running stops now
+				if (running != NULL)
+				{
+					fprintf(file, ",\n{\"name\":\"run\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":", running->task);
+					PrintTraceTime(file, running->time - start, scale);
+					fprintf(file, ",\"dur\":");
+					PrintTraceTime(file, record->time - running->time, scale);
+					fprintf(file, "}");
+				}
+				running = record;
+			}
+			else if (name != NULL)
+			{
+				fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":", name, phase, record->task);
+				PrintTraceTime(file, record->time - start, scale);
+				if (*phase == 'i')
+					fprintf(file, ",\"s\":\"t\"");
+				if (record->event == kTracePortSend)
+					fprintf(file, ",\"args\":{\"port\":%u,\"type\":\"%08X\"}", record->arg1, record->arg2);
+				else if (record->event == kTracePortReceive)
+					fprintf(file, ",\"args\":{\"port\":%u,\"filter\":\"%08X\"}", record->arg1, record->arg2);
+				else if (record->event == kTraceTimerAlarm)
+					fprintf(file, ",\"args\":{\"msg\":%u}", record->arg1);
+				fprintf(file, "}");
+			}
+		}
+		// the last task is still running at the end of the trace
+		if (running != NULL)
+		{
+			fprintf(file, ",\n{\"name\":\"run\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":", running->task);
+			PrintTraceTime(file, running->time - start, scale);
+			fprintf(file, ",\"dur\":");
+			PrintTraceTime(file, records[count-1].time - running->time, scale);
+			fprintf(file, "}");
+		}
+		fprintf(file, "\n]}\n");
+		XFAILIF(ferror(file), err = kOSErrBadParameters;)
+	}
+	XENDTRY;
+
+	if (file != NULL)
+		fclose(file);
+	if (records != NULL)
+		FreePtr((Ptr)records);
+	if (outNumOfEvents != NULL)
+		*outNumOfEvents = (err == noErr) ? count : 0;
+	return err;
+}
+
+
+static void
+DumpKernelTraceAtExit(void)
+{
+	if (gTraceExitPath != NULL)
+	{
+		gKernelTraceOn = false;
+		DumpKernelTrace(gTraceExitPath, NULL);
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	Dump the trace when the host exits.
+	Args:		inPath				file to write; NULL => don’t
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+DumpKernelTraceOnExit(const char * inPath)
+{
+	static bool isRegistered = false;
+
+	if (gTraceExitPath != NULL)
+		free(gTraceExitPath), gTraceExitPath = NULL;
+	if (inPath != NULL)
+	{
+		gTraceExitPath = strdup(inPath);
+		if (!isRegistered)
+		{
+			atexit(DumpKernelTraceAtExit);
+			isRegistered = true;
+		}
+	}
+}
+
+
+#pragma mark -
+/*------------------------------------------------------------------------------
+	K e r n e l T r a c e ( o n )
+	Turn the event trace on or off.
+	Args:		inRcvr
+				inOn			non-nil => on
+	Return:	whether it was on before
+------------------------------------------------------------------------------*/
+
+Ref
+FKernelTrace(RefArg inRcvr, RefArg inOn)
+{
+	bool wasOn = gKernelTraceOn;
+	if (NOTNIL(inOn))
+		StartKernelTrace();
+	else
+		StopKernelTrace();
+	return MAKEBOOLEAN(wasOn);
+}
+
+
+/*------------------------------------------------------------------------------
+	D u m p K e r n e l T r a c e ( f i l e n a m e )
+	Write the events logged so far as a Chrome/Perfetto JSON trace.
+	Args:		inRcvr
+				inFilename	path of the file to write
+	Return:	number of events written, or nil if the file could not be written
+------------------------------------------------------------------------------*/
+
+Ref
+FDumpKernelTrace(RefArg inRcvr, RefArg inFilename)
+{
+	char			filename[256];
+	ArrayIndex	count;
+
+	ConvertFromUnicode(GetUString(inFilename), filename, 255);
+	if (DumpKernelTrace(filename, &count) != noErr)
+		return NILREF;
+	return MAKEINT(count);
+}
@@ -0,0 +1,368 @@
+/*
+	File:		NameRegistry.cc
+
+	Contains:	The name servers registry of names.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "NameServer.h"
+
+
+/*--------------------------------------------------------------------------------
+	F u n c t i o n   P r o t o t y p e s
+--------------------------------------------------------------------------------*/
+
+extern void		ReleaseResArbInfo(CResArbitrationInfo * inInfo);
+
+
+/*--------------------------------------------------------------------------------
+	C R e g i s t r y L i s t e n e r
+--------------------------------------------------------------------------------*/
+
+CRegistryListener::CRegistryListener()
+	:	fNext(NULL), fMsgToken(), fName(NULL), fType(NULL), fHash(0)
+{ }
+
+#pragma mark -
+
+/*--------------------------------------------------------------------------------
+	C O b j e c t N a m e E n t r y
+--------------------------------------------------------------------------------*/
+
+CObjectNameEntry::CObjectNameEntry()
+	:	fNext(NULL), fName(NULL), fType(NULL), fResArbInfo(NULL), fHash(0)
+{ }
+
+CObjectNameEntry::CObjectNameEntry(const char * inName, const char * inType, OpaqueRef inThing, OpaqueRef inSpec)
+	:	fNext(NULL), fResArbInfo(NULL), fHash(0)
+{
+	fName = inName;
+	fType = inType;
+	fThing = inThing;
+	fSpec = inSpec;
+}
+
+#pragma mark -
+
+/*--------------------------------------------------------------------------------
+	C O b j e c t N a m e L i s t
+--------------------------------------------------------------------------------*/
+
+CObjectNameList::CObjectNameList()
+	:	fRegisterListeners(NULL), fUnregisterListeners(NULL), fRegistry(NULL)
+{ }
+
+
+/*--------------------------------------------------------------------------------
+	Reply to, and delete, the listeners in a queue waiting for a name.
+	Args:		ioQueue			the queue
+				inHash			hash of the key
+				inName			key part 1
+				inType			key part 2
+				inReply			reply to send them
+	Return:	--
+--------------------------------------------------------------------------------*/
+
+static void
+ReplyToListeners(CRegistryListener ** ioQueue, ULong inHash, const char * inName, const char * inType, CNameServerReply * inReply)
+{
+	CRegistryListener *	listener;
+	while ((listener = *ioQueue) != NULL)
+	{
+		if (listener->fHash == inHash
+		&&  strcmp(listener->fName, inName) == 0
+		&&  strcmp(listener->fType, inType) == 0)
+		{
+			// found one! reply with the original message token
+			listener->fMsgToken.replyRPC(inReply, sizeof(CNameServerReply));
+			// can now unthread the listener
+			*ioQueue = listener->fNext;
+			// delete the name/type buffers
+			FreePtr((Ptr)listener->fName);
+			FreePtr((Ptr)listener->fType);
+			// and delete the listener itself
+			delete listener;
+		}
+		else
+			ioQueue = &listener->fNext;
+	}
+}
+
+
+/*--------------------------------------------------------------------------------
+	Add a CObjectNameEntry to the list.
+	Args:		inHash			hash of the key
+				inName			key part 1
+				inType			key part 2
+				inThing			data part 1
+				inSpec			data part 2
+	Return:	true => it was added successfully
+--------------------------------------------------------------------------------*/
+
+bool
+CObjectNameList::add(ULong inHash, const char * inName, const char * inType, OpaqueRef inThing, OpaqueRef inSpec)
+{
+	// create a new entry
+	CObjectNameEntry *	entry = new CObjectNameEntry(inName, inType, inThing, inSpec);
+	if (entry != NULL)
+	{
+		// thread it onto the registry list
+		entry->fHash = inHash;
+		entry->fNext = fRegistry;
+		fRegistry = entry;
+		// if there are listeners waiting for names to be registered,
+		// see if they are now satisfied
+		CNameServerReply	reply;
+		reply.fThing = entry->fThing;
+		reply.fSpec = entry->fSpec;
+		ReplyToListeners(&fRegisterListeners, inHash, inName, inType, &reply);
+		return true;	// it was added okay
+	}
+	return false;	// we couldnt create an entry
+}
+
+
+/*--------------------------------------------------------------------------------
+	Remove a CObjectNameEntry from the list.
+	Args:		inHash			hash of the key
+				inName			key part 1
+				inType			key part 2
+	Return:	true => it was removed successfully
+--------------------------------------------------------------------------------*/
+
+bool
+CObjectNameList::remove(ULong inHash, const char * inName, const char * inType)
+{
+	CResArbitrationInfo *	info;
+	CObjectNameEntry *		entry;
+	CObjectNameEntry **		link;
+
+	for (link = &fRegistry; (entry = *link) != NULL; link = &entry->fNext)
+	{
+		if (entry->fHash == inHash
+		&&  strcmp(entry->fName, inName) == 0
+		&&  strcmp(entry->fType, inType) == 0)
+		{
+			// found the name! unthread it from the list
+			*link = entry->fNext;
+			// if theres resArbInfo, can delete that now
+			if ((info = entry->fResArbInfo) != NULL)
+				ReleaseResArbInfo(info);
+			// if there are listeners waiting for names to be unregistered,
+			// see if they are now satisfied
+			CNameServerReply	reply;
+			ReplyToListeners(&fUnregisterListeners, inHash, inName, inType, &reply);
+			// and finally, delete the entry
+			FreePtr((Ptr)entry->fName);
+			FreePtr((Ptr)entry->fType);
+			delete entry;
+			return true;	// it was removed okay
+		}
+	}
+	return false;	// we couldnt find the name
+}
+
+
+/*--------------------------------------------------------------------------------
+	Look up a CObjectNameEntry in the list.
+	Args:		inHash			hash of the key
+				inName			key part 1
+				inType			key part 2
+				outThing			where to put the data
+				outSpec
+				outEntry			optional: the actual entry
+	Return:	true => it was found
+--------------------------------------------------------------------------------*/
+
+bool
+CObjectNameList::lookup(ULong inHash, const char * inName, const char * inType, OpaqueRef * outThing, OpaqueRef * outSpec, CObjectNameEntry ** outEntry)
+{
+	CObjectNameEntry *	entry;
+
+	for (entry = fRegistry; entry != NULL; entry = entry->fNext)
+	{
+		if (entry->fHash == inHash
+		&&  strcmp(entry->fName, inName) == 0
+		&&  strcmp(entry->fType, inType) == 0)
+		{
+			*outThing = entry->fThing;
+			*outSpec = entry->fSpec;
+			if (outEntry != NULL)
+				*outEntry = entry;
+			return true;
+		}
+	}
+	return false;
+}
+
+#pragma mark -
+
+/*--------------------------------------------------------------------------------
+	C O b j e c t N a m e T a b l e
+--------------------------------------------------------------------------------*/
+
+CObjectNameTable::CObjectNameTable()
+	:	fList(NULL), fSize(0), fCount(0)
+{ }
+
+
+/*--------------------------------------------------------------------------------
+	Initialize the table.
+	Args:		--
+	Return:	error code
+--------------------------------------------------------------------------------*/
+
+NewtonErr
+CObjectNameTable::init(void)
+{
+	fSize = kObjectNameHashBucketSize;
+	fCount = 0;
+	fList = new CObjectNameList[fSize];
+	return (fList == NULL) ? kOSErrNoMemory : noErr;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Hash a name/type key for indexing into the CObjectNameList table.
+	This is FNV-1a over both strings, with a final mix so that the low bits
+	we index by depend on every byte.
+	Args:		inName		a C string
+				inType		a C string
+	Return:	hash; the table index is in its low bits
+--------------------------------------------------------------------------------*/
+
+ULong
+CObjectNameTable::hash(const char * inName, const char * inType)
+{
+	ULong	n = 2166136261U;
+	UChar	c;
+	while ((c = *inName++) != 0)
+		n = (n ^ c) * 16777619U;
+	n *= 16777619U;	// separate name from type, so "ab"+"c" != "a"+"bc"
+	while ((c = *inType++) != 0)
+		n = (n ^ c) * 16777619U;
+	n ^= n >> 16;
+	n *= 0x85EBCA6BU;
+	n ^= n >> 13;
+	n *= 0xC2B2AE35U;
+	n ^= n >> 16;
+	return n;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Split a chain of name entries or listeners in two by one bit of their hash,
+	keeping their order.
+	Args:		inChain		the chain
+				inBit			hash bit to split on
+				outLo			chain of items with the bit clear
+				outHi			chain of items with the bit set
+	Return:	--
+--------------------------------------------------------------------------------*/
+
+template <class T>
+static void
+SplitChain(T * inChain, ULong inBit, T ** outLo, T ** outHi)
+{
+	T **	lo = outLo;
+	T **	hi = outHi;
+	for ( ; inChain != NULL; inChain = inChain->fNext)
+	{
+		if ((inChain->fHash & inBit) != 0)
+			*hi = inChain, hi = &inChain->fNext;
+		else
+			*lo = inChain, lo = &inChain->fNext;
+	}
+	*lo = NULL;
+	*hi = NULL;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Double the size of the table.
+	List i of the old table splits into lists i and i + old size of the new.
+	Args:		--
+	Return:	error code; the old table stays in use if the new one cant be had
+--------------------------------------------------------------------------------*/
+
+NewtonErr
+CObjectNameTable::grow(void)
+{
+	ArrayIndex			newSize = 2 * fSize;
+	CObjectNameList *	newList = new CObjectNameList[newSize];
+	if (newList == NULL)
+		return kOSErrNoMemory;
+
+	for (ArrayIndex i = 0; i < fSize; ++i)
+	{
+		CObjectNameList *	db = &fList[i];
+		CObjectNameList *	lo = &newList[i];
+		CObjectNameList *	hi = &newList[i + fSize];
+		SplitChain(db->fRegistry, fSize, &lo->fRegistry, &hi->fRegistry);
+		SplitChain(db->fRegisterListeners, fSize, &lo->fRegisterListeners, &hi->fRegisterListeners);
+		SplitChain(db->fUnregisterListeners, fSize, &lo->fUnregisterListeners, &hi->fUnregisterListeners);
+	}
+	delete[] fList;
+	fList = newList;
+	fSize = newSize;
+	return noErr;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Add a name to the table.
+	Args:		inHash			hash of the key
+				inName			key part 1
+				inType			key part 2
+				inThing			data part 1
+				inSpec			data part 2
+	Return:	true => it was added successfully
+--------------------------------------------------------------------------------*/
+
+bool
+CObjectNameTable::add(ULong inHash, const char * inName, const char * inType, OpaqueRef inThing, OpaqueRef inSpec)
+{
+	if (!bucketFor(inHash)->add(inHash, inName, inType, inThing, inSpec))
+		return false;
+	// keep the lists short; if we cant grow the table, it still works
+	if (++fCount > fSize * kObjectNameMaxLoad)
+		grow();
+	return true;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Remove a name from the table.
+	Args:		inHash			hash of the key
+				inName			key part 1
+				inType			key part 2
+	Return:	true => it was removed successfully
+--------------------------------------------------------------------------------*/
+
+bool
+CObjectNameTable::remove(ULong inHash, const char * inName, const char * inType)
+{
+	if (!bucketFor(inHash)->remove(inHash, inName, inType))
+		return false;
+	fCount--;
+	return true;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Look up a name in the table.
+	Args:		inHash			hash of the key
+				inName			key part 1
+				inType			key part 2
+				outThing			where to put the data
+				outSpec
+				outEntry			optional: the actual entry
+	Return:	true => it was found
+--------------------------------------------------------------------------------*/
+
+bool
+CObjectNameTable::lookup(ULong inHash, const char * inName, const char * inType, OpaqueRef * outThing, OpaqueRef * outSpec, CObjectNameEntry ** outEntry)
+{
+	return bucketFor(inHash)->lookup(inHash, inName, inType, outThing, outSpec, outEntry);
+}
@@ -135,8 +135,9 @@ CNameServer::taskConstructor(void)
 		XFAIL(err = fPort.init())
 		XFAIL(err = fReplyMem.init())
 		gNameServer = &fPort;
-		fSysEvents = new CList;
+		fSysEvents = new CSortedList(&fSysEventCmp);
 		XFAILIF(fSysEvents == NULL, err = kOSErrNoMemory;)
+		XFAIL(err = fDB.init())
 	}
 	XENDTRY;
 	return err;
@@ -177,12 +178,12 @@ CNameServer::taskMain(void)
 			}
 			else if (info->fType == 2)
 			{
-				resArbHandleReply((CResArbitrationInfo *)info->fData);
+			// a system event has been had by one task; send it on to the next
 				SysEvent *	eventInfo;
 				while ((eventInfo = (SysEvent *)fSysEventIter->nextItem()) != NULL)
 				{
 					fSysEventPort = eventInfo->fSysEventObjId;
-					if (fSysEventPort.sendRPC(&fSysEventMsg, kPortSend_BufferAlreadySet, 0, NULL, 0, eventInfo->fSysEventSendFilter, NULL, eventInfo->fSysEventTimeOut) != noErr)
+					if (fSysEventPort.sendRPC(&fSysEventMsg, kPortSend_BufferAlreadySet, 0, NULL, 0, eventInfo->fSysEventTimeOut, NULL, eventInfo->fSysEventSendFilter) == noErr)
 						break;
 				}
 				if (eventInfo == NULL)
@@ -199,25 +200,29 @@ CNameServer::taskMain(void)
 		}
 		else if (err == noErr)
 		{
+			// system event requests arent laid out as name requests where OpaqueRefs are longer than ULongs
+			CSysEventRequest *	sysEventRequest = (CSysEventRequest *)&request;
 			isReplyWanted = true;
 			switch (request.fCommand)
 			{
 			case kRegisterForSystemEvent:
-				err = registerForSystemEvent(request.fThing, request.fSpec, request.fParam1, request.fParam2);
+				err = registerForSystemEvent(sysEventRequest->fTheEvent, sysEventRequest->fSysEventObjId, sysEventRequest->fSysEventTimeOut, sysEventRequest->fSysEventSendFilter);
 				token.replyRPC(&reply, sizeof(reply), err);
 				break;
 
 			case kUnregisterForSystemEvent:
-				err = unregisterForSystemEvent(request.fThing, request.fSpec);
+				err = unregisterForSystemEvent(sysEventRequest->fTheEvent, sysEventRequest->fSysEventObjId);
 				token.replyRPC(&reply, sizeof(reply), err);
 				break;
 
 			case kSendSystemEvent:
 				fSysEventToken = token;
-				err = sendSystemEvent(request.fThing, request.fSpec);
+				err = sendSystemEvent(sysEventRequest->fTheEvent, sysEventRequest->fSysEventObjId);
 				if (err == noErr)
 					isReplyWanted = false;
-				token.replyRPC(&reply, sizeof(reply), err);
+				else
+				// otherwise the sender is replied to once every registered task has had it
+					token.replyRPC(&reply, sizeof(reply), err);
 				break;
 
 			case kGestalt:
@@ -262,23 +267,6 @@ CNameServer::taskMain(void)
 }
 
 
-/*--------------------------------------------------------------------------------
-	Hash a name for indexing into the CNameObjectEntry table.
-	Args:		inName		a C string
-	Return:	index
---------------------------------------------------------------------------------*/
-
-ULong
-CNameServer::hash(const char * inName)
-{
-	ULong	n = 0;
-	UChar	c;
-	while ((c = *inName++) != 0)
-		n += c;
-	return n & kObjectNameHashBucketMask;
-}
-
-
 /*--------------------------------------------------------------------------------
 	Build name and type buffers from shared memory objects of the same.
 	This is done for every name server request that needs name/type key access.
@@ -311,7 +299,9 @@ CNameServer::buildNameAndType(ObjectId inName, ObjectId inType)
 		// allocate type buffer and copy contents of type object
 		XFAIL(err = typeObject.getSize(&size))
 		XFAILNOT(fType = NewPtr(size), err = kOSErrNoMemory;)
-		err = typeObject.copyFromShared(&size, (void*)fType, size);
+		XFAIL(err = typeObject.copyFromShared(&size, (void*)fType, size))
+		// hash the key once for all the table operations on it
+		fHash = CObjectNameTable::hash(fName, fType);
 	}
 	XENDTRY;
 	return err;
@@ -348,8 +338,7 @@ CNameServer::registerName(OpaqueRef inThing, OpaqueRef inSpec)
 	XTRY
 	{
 		OpaqueRef whatever;
-		CObjectNameList *	db = &fDB[hash(fName)];
-		XFAILIF(db->lookup(fName, fType, &whatever, &whatever, NULL) != noErr || !db->add(fName, fType, inThing, inSpec), err = kOSErrAlreadyRegistered;)
+		XFAILIF(fDB.lookup(fHash, fName, fType, &whatever, &whatever, NULL) || !fDB.add(fHash, fName, fType, inThing, inSpec), err = kOSErrAlreadyRegistered;)
 		// NULL out the key pointers so theyre not freed
 		// we want them to stay in the CObjectNameEntry
 		fName = fType = NULL;
@@ -371,9 +360,7 @@ CNameServer::unregisterName(void)
 	NewtonErr err = noErr;
 	XTRY
 	{
-		OpaqueRef whatever;
-		CObjectNameList *	db = &fDB[hash(fName)];
-		XFAILIF(db->lookup(fName, fType, &whatever, &whatever, NULL) == noErr || !db->remove(fName, fType), err = kOSErrNotRegistered;)
+		XFAILNOT(fDB.remove(fHash, fName, fType), err = kOSErrNotRegistered;)
 	}
 	XENDTRY;
 	return err;
@@ -409,9 +396,10 @@ CNameServer::queueForRegister(CUMsgToken * ioToken)
 			XFAILIF(listener == NULL, err = kOSErrNoMemory;)
 			listener->fName = fName;
 			listener->fType = fType;
+			listener->fHash = fHash;
 			listener->fMsgToken = *ioToken;
 			// thread new listener onto front of queue
-			CObjectNameList *	db = &fDB[hash(fName)];
+			CObjectNameList *	db = fDB.bucketFor(fHash);
 			listener->fNext = db->fRegisterListeners;
 			db->fRegisterListeners = listener;
 			// NULL out keys; we must retain them
@@ -450,9 +438,10 @@ CNameServer::queueForUnregister(CUMsgToken * ioToken)
 			XFAILIF(listener == NULL, err = kOSErrNoMemory;)
 			listener->fName = fName;
 			listener->fType = fType;
+			listener->fHash = fHash;
 			listener->fMsgToken = *ioToken;
 			// thread new listener onto front of queue
-			CObjectNameList *	db = &fDB[hash(fName)];
+			CObjectNameList *	db = fDB.bucketFor(fHash);
 			listener->fNext = db->fUnregisterListeners;
 			db->fUnregisterListeners = listener;
 			// NULL out keys; we must retain them
@@ -475,7 +464,7 @@ CNameServer::queueForUnregister(CUMsgToken * ioToken)
 NewtonErr
 CNameServer::lookup(OpaqueRef * outThing, OpaqueRef * outSpec)
 {
-	return fDB[hash(fName)].lookup(fName, fType, outThing, outSpec, NULL) ? noErr : kOSErrNotRegistered;
+	return fDB.lookup(fHash, fName, fType, outThing, outSpec, NULL) ? noErr : kOSErrNotRegistered;
 }
 
 
@@ -599,7 +588,7 @@ CNameServer::resourceArbitration(CUMsgToken & ioToken, CResArbitrationRequest *
 	OpaqueRef			thing;
 	OpaqueRef			spec;
 
-	if (fDB[hash(fName)].lookup(fName, fType, &thing, &spec, &entry))
+	if (fDB.lookup(fHash, fName, fType, &thing, &spec, &entry))
 	{
 		CResArbitrationInfo *	arbInfo = entry->fResArbInfo;
 		CResOwnerInfo *			owner;
@@ -778,17 +767,16 @@ CNameServer::registerForSystemEvent(ULong inEvtId, ULong inEventClass, ULong inf
 	NewtonErr err = noErr;
 	XTRY
 	{
-		CSysEventTester	tester(inEvtId);
 		ArrayIndex			index;
 		CEventMasterListItem *	sysEvt;
 
-		if ((sysEvt = (CEventMasterListItem *)fSysEvents->search(&tester, index)) == NULL)
+		if ((sysEvt = findSystemEvent(inEvtId, index)) == NULL)
 		{
 			// sys evt doesnt exist yet so try to create one
 			sysEvt = new CEventMasterListItem;
 			XFAILIF(sysEvt == NULL, err = kOSErrNoMemory;)
-			XFAIL(err = sysEvt->init(inEvtId))
-			XFAIL(err = fSysEvents->insertFirst(sysEvt))
+			XFAILIF(err = sysEvt->init(inEvtId), delete sysEvt;)
+			XFAILIF(err = fSysEvents->insertAt(index, sysEvt), delete sysEvt;)
 		}
 
 		// add new system event to the sublist
@@ -812,6 +800,24 @@ CNameServer::registerForSystemEvent(ULong inEvtId, ULong inEventClass, ULong inf
 }
 
 
+/*--------------------------------------------------------------------------------
+	Find a system event in the list of those registered.
+	Args:		inEvtId			event id
+				outIndex			its index, or where it would be inserted
+	Return:	the event; NULL => not registered
+--------------------------------------------------------------------------------*/
+
+CEventMasterListItem *
+CNameServer::findSystemEvent(ULong inEvtId, ArrayIndex & outIndex)
+{
+	// the list is sorted by id, and the comparer compares CEventMasterListItems
+	CEventMasterListItem	key;
+	key.fEvtId = inEvtId;
+	fSysEventCmp.setTestItem(&key);
+	return (CEventMasterListItem *)fSysEvents->search(&fSysEventCmp, outIndex);
+}
+
+
 /*--------------------------------------------------------------------------------
 	.
 	Args:		inEvtId
@@ -826,11 +832,10 @@ CNameServer::unregisterForSystemEvent(ULong inEvtId, ULong inArg2)
 	XTRY
 	{
 		ULong					evtId;
-		CSysEventTester	tester(inEvtId);
 		ArrayIndex			index;
 		CEventMasterListItem *	sysEvt;
 
-		XFAILNOT(sysEvt = (CEventMasterListItem *)fSysEvents->search(&tester, index), err = kOSErrNotRegistered;)
+		XFAILNOT(sysEvt = findSystemEvent(inEvtId, index), err = kOSErrNotRegistered;)
 		evtId = inArg2;
 		sysEvt->fCmp.setTestItem(&evtId);
 
@@ -864,11 +869,10 @@ CNameServer::sendSystemEvent(ULong inEvtId, ObjectId inMemMsg)
 	NewtonErr err = noErr;
 	XTRY
 	{
-		CSysEventTester	tester(inEvtId);
 		ArrayIndex			index;
 		CEventMasterListItem *	sysEvt;
 
-		XFAILIF((sysEvt = (CEventMasterListItem *)fSysEvents->search(&tester, index)) == NULL
+		XFAILIF((sysEvt = findSystemEvent(inEvtId, index)) == NULL
 			  ||  sysEvt->fEventList->isEmpty(), err = kOSErrNotRegistered;)
 
 		CUAsyncMessage	msg(inMemMsg, fReplyMem);
@@ -883,13 +887,17 @@ CNameServer::sendSystemEvent(ULong inEvtId, ObjectId inMemMsg)
 		for (eventInfo = (SysEvent *)fSysEventIter->firstItem(); eventInfo != NULL; eventInfo = (SysEvent *)fSysEventIter->nextItem())
 		{
 			fSysEventPort = eventInfo->fSysEventObjId;
-			if (fSysEventPort.sendRPC(&fSysEventMsg, kPortSend_BufferAlreadySet, 0, NULL, 0, eventInfo->fSysEventSendFilter, NULL, eventInfo->fSysEventTimeOut) == noErr)
+			if (fSysEventPort.sendRPC(&fSysEventMsg, kPortSend_BufferAlreadySet, 0, NULL, 0, eventInfo->fSysEventTimeOut, NULL, eventInfo->fSysEventSendFilter) == noErr)
 				break;
 		}
-		delete fSysEventIter;
 		if (eventInfo == NULL)
+		{
 			// there arent any SysEvents
+			delete fSysEventIter;
+			fSysEventIter = NULL;
 			err = kOSErrNotRegistered;
+		}
+		// else the rest are sent on as each is had
 	}
 	XENDTRY;
 	return err;
@@ -1024,194 +1032,6 @@ CNameServer::gestalt(GestaltSelector inSelector, CUMsgToken * ioToken)
 
 #pragma mark -
 
-/*--------------------------------------------------------------------------------
-	C R e g i s t r y L i s t e n e r
---------------------------------------------------------------------------------*/
-
-CRegistryListener::CRegistryListener()
-	:	fNext(NULL), fMsgToken(), fName(NULL), fType(NULL)
-{ }
-
-#pragma mark -
-
-/*--------------------------------------------------------------------------------
-	C O b j e c t N a m e E n t r y
---------------------------------------------------------------------------------*/
-
-CObjectNameEntry::CObjectNameEntry()
-	:	fNext(NULL), fName(NULL), fType(NULL), fResArbInfo(NULL)
-{ }
-
-CObjectNameEntry::CObjectNameEntry(const char * inName, const char * inType, OpaqueRef inThing, OpaqueRef inSpec)
-	:	fNext(NULL), fResArbInfo(NULL)
-{
-	fName = inName;
-	fType = inType;
-	fThing = inThing;
-	fSpec = inSpec;
-}
-
-#pragma mark -
-
-/*--------------------------------------------------------------------------------
-	C O b j e c t N a m e L i s t
---------------------------------------------------------------------------------*/
-
-CObjectNameList::CObjectNameList()
-	:	fRegisterListeners(NULL), fUnregisterListeners(NULL), fRegistry(NULL)
-{ }
-
-
-/*--------------------------------------------------------------------------------
-	Add a CObjectNameEntry to the list.
-	Args:		inName			key part 1
-				inType			key part 2
-				inThing			data part 1
-				inSpec			data part 2
-	Return:	true => it was added successfully
---------------------------------------------------------------------------------*/
-
-bool
-CObjectNameList::add(const char * inName, const char * inType, OpaqueRef inThing, OpaqueRef inSpec)
-{
-	// create a new entry
-	CObjectNameEntry *	entry = new CObjectNameEntry(inName, inType, inThing, inSpec);
-	if (entry != NULL)
-	{
-		CRegistryListener *	listener, * prevListener, * nextListener;
-		// thread it onto the registry list
-		entry->fNext = fRegistry;
-		fRegistry = entry;
-		// if there are listeners waiting for names to be registered,
-		// see if they are now satisfied
-		for (prevListener = NULL, listener = fRegisterListeners; listener != NULL; prevListener = listener, listener = listener->fNext)
-		{
-			if (strcmp(listener->fName, inName) == 0
-			&&  strcmp(listener->fType, inType) == 0)
-			{
-				// found one! reply with the original message token
-				CNameServerReply	reply;
-				reply.fThing = entry->fThing;
-				reply.fSpec = entry->fSpec;
-				listener->fMsgToken.replyRPC(&reply, sizeof(reply));
-				// can now unthread the listener
-				nextListener = listener->fNext;
-				if (prevListener != NULL)
-					prevListener->fNext = nextListener;
-				else
-					fRegisterListeners = nextListener;
-				// delete the name/type buffers
-				FreePtr((Ptr)listener->fName);
-				FreePtr((Ptr)listener->fType);
-				// and delete the listener itself
-				delete listener;
-				listener = (CRegistryListener *)&nextListener;
-			}
-		}
-		return true;	// it was added okay
-	}
-	return false;	// we couldnt create an entry
-}
-
-
-/*--------------------------------------------------------------------------------
-	Remove a CObjectNameEntry from the list.
-	Args:		inName			key part 1
-				inType			key part 2
-	Return:	true => it was removed successfully
---------------------------------------------------------------------------------*/
-
-bool
-CObjectNameList::remove(const char * inName, const char * inType)
-{
-	CResArbitrationInfo *	info;
-	CObjectNameEntry *		prevEntry, * entry;
-
-	for (prevEntry = NULL, entry = fRegistry; entry != NULL; prevEntry = entry, entry = entry->fNext)
-	{
-		if (strcmp(entry->fName, inName) == 0)
-		{
-			// found the name! unthread it from the list
-			if (prevEntry != NULL)
-				prevEntry->fNext = entry->fNext;
-			else
-				fRegistry = entry->fNext;
-			// if theres resArbInfo, can delete that now
-			if ((info = entry->fResArbInfo) != NULL)
-			{
-				if ((info->f00 & 0x01) != 0)
-					info->f00 |= 0x02;
-				else
-					delete info;
-			}
-			// if there are listeners waiting for names to be unregistered,
-			// see if they are now satisfied
-			CRegistryListener *	listener, * prevListener, * nextListener;
-			for (prevListener = NULL, listener = fUnregisterListeners; listener != NULL; prevListener = listener, listener = listener->fNext)
-			{
-				if (strcmp(listener->fName, inName) == 0
-				&&  strcmp(listener->fType, inType) == 0)
-				{
-					// found one! reply with the original message token
-					CNameServerReply	reply;
-					listener->fMsgToken.replyRPC(&reply, sizeof(reply));
-					// can now unthread the listener
-					nextListener = listener->fNext;
-					if (prevListener != NULL)
-						prevListener->fNext = nextListener;
-					else
-						fUnregisterListeners = nextListener;
-					// delete the name/type buffers
-					FreePtr((Ptr)listener->fName);
-					FreePtr((Ptr)listener->fType);
-					// and delete the listener itself
-					delete listener;
-					listener = (CRegistryListener *)&nextListener;
-				}
-			}
-			// and finally, delete the entry
-			FreePtr((Ptr)entry->fName);
-			FreePtr((Ptr)entry->fType);
-			delete entry;
-			return true;	// it was removed okay
-		}
-	}
-	return false;	// we couldnt find the name
-}
-
-
-/*--------------------------------------------------------------------------------
-	Look up a CObjectNameEntry in the list.
-	Args:		inName			key part 1
-				inType			key part 2
-				outThing			where to put the data
-				outSpec
-				outEntry			optional: the actual entry
-	Return:	true => it was found
---------------------------------------------------------------------------------*/
-
-bool
-CObjectNameList::lookup(const char * inName, const char * inType, OpaqueRef * outThing, OpaqueRef * outSpec, CObjectNameEntry ** outEntry)
-{
-	CObjectNameEntry *	entry;
-
-	for (entry = fRegistry; entry != NULL; entry = entry->fNext)
-	{
-		if (strcmp(entry->fName, inName) == 0
-		&&  strcmp(entry->fType, inType) == 0)
-		{
-			*outThing = entry->fThing;
-			*outSpec = entry->fSpec;
-			if (outEntry != NULL)
-				*outEntry = entry;
-			return true;
-		}
-	}
-	return false;
-}
-
-#pragma mark -
-
 /*--------------------------------------------------------------------------------
 	C R e s O w n e r I n f o
 --------------------------------------------------------------------------------*/
@@ -1263,6 +1083,23 @@ CResArbitrationInfo::init(CUPort * inPort)
 	return err;
 }
 
+
+/*--------------------------------------------------------------------------------
+	Release the resource arbitration record of a name being unregistered.
+	If a claim is in progress it is only marked, and deleted when thats done.
+	Args:		inInfo			the record
+	Return:	--
+--------------------------------------------------------------------------------*/
+
+void
+ReleaseResArbInfo(CResArbitrationInfo * inInfo)
+{
+	if ((inInfo->f00 & 0x01) != 0)
+		inInfo->f00 |= 0x02;
+	else
+		delete inInfo;
+}
+
 #pragma mark -
 
 /*--------------------------------------------------------------------------------
@@ -1299,10 +1136,12 @@ CEventMasterListItem::init(ULong inEvtId)
 CompareResult
 CSysEventItemComparer::testItem(const void * inItem) const
 {
-	long	result = ((CEventMasterListItem *)fItem)->fEvtId - ((CEventMasterListItem *)inItem)->fEvtId;
-	if (result < 0)
+	// compare, dont subtract: ids are unsigned and the difference can overflow
+	ULong	testId = ((CEventMasterListItem *)fItem)->fEvtId;
+	ULong	itemId = ((CEventMasterListItem *)inItem)->fEvtId;
+	if (testId < itemId)
 		return kItemLessThanCriteria;
-	if (result > 0)
+	if (testId > itemId)
 		return kItemGreaterThanCriteria;
 	return kItemEqualCriteria;
 }
@@ -240,18 +240,6 @@ public:
 	CSortedList *				fEventList;		// +10
 };
 
-class CSysEventTester : public CItemTester
-{
-public:
-					CSysEventTester(ULong inEventId);
-	virtual CompareResult	testItem(const void * inItem) const;
-	ULong			fEventId;
-};
-
-inline					CSysEventTester::CSysEventTester(ULong inEventId)  { fEventId = inEventId; }
-inline CompareResult	CSysEventTester::testItem(const void * inItem) const  { return (fEventId == ((CEventMasterListItem *)inItem)->fEvtId ) ? kItemEqualCriteria : kItemLessThanCriteria; }
-
-
 class CNameServerReply : public SingleObject
 {
 public:
@@ -272,6 +260,7 @@ public:
 	CUMsgToken				fMsgToken;	// +04
 	const char *			fName;		// +14
 	const char *			fType;		// +18
+	ULong						fHash;		// not in the original
 };
 
 
@@ -287,6 +276,7 @@ public:
 	const char *			fName;		// +0C
 	const char *			fType;		// +10
 	CResArbitrationInfo *fResArbInfo;// +14
+	ULong						fHash;		// not in the original
 };
 
 
@@ -295,9 +285,9 @@ class CObjectNameList
 public:
 					CObjectNameList();
 
-	bool			add(const char * inName, const char * inType, OpaqueRef inThing, OpaqueRef inSpec);
-	bool			remove(const char * inName, const char * inType);
-	bool			lookup(const char * inName, const char * inType, OpaqueRef * outThing, OpaqueRef * outSpec, CObjectNameEntry ** outEntry);
+	bool			add(ULong inHash, const char * inName, const char * inType, OpaqueRef inThing, OpaqueRef inSpec);
+	bool			remove(ULong inHash, const char * inName, const char * inType);
+	bool			lookup(ULong inHash, const char * inName, const char * inType, OpaqueRef * outThing, OpaqueRef * outSpec, CObjectNameEntry ** outEntry);
 
 	CRegistryListener *	fRegisterListeners;		// +00
 	CRegistryListener *	fUnregisterListeners;	// +04
@@ -306,8 +296,36 @@ public:
 	CObjectNameEntry *	fRegistry;	// +10
 };
 
+/*	The registry is a hash table keyed on both name and type.
+	It starts with kObjectNameHashBucketSize lists, and doubles whenever the
+	number of names registered exceeds kObjectNameMaxLoad per list.
+*/
 #define kObjectNameHashBucketSize		16
-#define kObjectNameHashBucketMask		(kObjectNameHashBucketSize - 1)
+#define kObjectNameMaxLoad					2
+
+class CObjectNameTable
+{
+public:
+					CObjectNameTable();
+
+	NewtonErr	init(void);
+
+	static ULong	hash(const char * inName, const char * inType);
+	CObjectNameList *	bucketFor(ULong inHash);
+
+	bool			add(ULong inHash, const char * inName, const char * inType, OpaqueRef inThing, OpaqueRef inSpec);
+	bool			remove(ULong inHash, const char * inName, const char * inType);
+	bool			lookup(ULong inHash, const char * inName, const char * inType, OpaqueRef * outThing, OpaqueRef * outSpec, CObjectNameEntry ** outEntry);
+
+private:
+	NewtonErr	grow(void);
+
+	CObjectNameList *	fList;		// the lists
+	ArrayIndex			fSize;		// number of them, a power of 2
+	ArrayIndex			fCount;		// number of names registered
+};
+
+inline CObjectNameList *	CObjectNameTable::bucketFor(ULong inHash)  { return &fList[inHash & (fSize - 1)]; }
 
 
 /*--------------------------------------------------------------------------------
@@ -323,7 +341,6 @@ public:
 	virtual NewtonErr	taskConstructor(void);
 	virtual void		taskMain(void);
 
-	ULong			hash(const char * inName);
 	NewtonErr	buildNameAndType(ObjectId inName, ObjectId inType);
 	void			deleteNameAndType(void);
 
@@ -348,10 +365,11 @@ public:
 	NewtonErr	registerForSystemEvent(ULong inEvtId, ULong inEventClass, ULong infEventId, ULong inSysEventType);
 	NewtonErr	unregisterForSystemEvent(ULong inEvtId, ULong);
 	NewtonErr	sendSystemEvent(ULong inEvtId, ObjectId inMemMsg);
+	CEventMasterListItem *	findSystemEvent(ULong inEvtId, ArrayIndex & outIndex);
 
 private:
 	CUPort				fPort;			// +18
-	CList *				fSysEvents;		// +20
+	CSortedList *		fSysEvents;		// +20	sorted by event id
 	CListIterator *	fSysEventIter;	// +24
 	CUAsyncMessage		fSysEventMsg;	// +28
 	CRPCInfo				fInfo;			// +38
@@ -360,7 +378,9 @@ private:
 	CUSharedMem			fReplyMem;		// +58
 	const char *		fName;			// +60
 	const char *		fType;			// +64
-	CObjectNameList	fDB[kObjectNameHashBucketSize];	// +68
+	ULong					fHash;			// of fName and fType
+	CObjectNameTable	fDB;				// hash table of names
+	CSysEventItemComparer	fSysEventCmp;
 };
 
 #define kGestaltImplementationVersion	1
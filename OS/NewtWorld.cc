@@ -18,6 +18,7 @@
 #include "SystemEvents.h"
 #include "NewtWorld.h"
 #include "ScreenDriver.h"
+#include "HeadlessDisplay.h"
 #include "TabletDriver.h"
 #include "OSErrors.h"
 #include "Preference.h"
@@ -207,6 +208,7 @@ printf("=> err=%d\n", err);
 	if (!inFrames)
 	{
 		CMainDisplayDriver::classInfo()->registerProtocol();
+		CHeadlessDisplayDriver::classInfo()->registerProtocol();
 	}
 }
 
@@ -923,10 +925,19 @@ CNewtWorld::preMain(void)
 	if (err == noErr)
 	{
 	//	send an event (via the name server) to say the OS is up
+	//	in a shared buffer, so tasks that can share it neednt copy it
 		CEventSystemEvent	liveEvent(kSysEvent_AppAlive);
 		CSendSystemEvent	sender(kSysEvent_AppAlive);
+		CSharedBuffer *	liveBuf;
 		sender.init();
-		sender.sendSystemEvent(&liveEvent, sizeof(liveEvent));
+		if ((liveBuf = CSharedBuffer::make(sizeof(liveEvent))) != NULL)
+		{
+			memmove(liveBuf->data(), &liveEvent, sizeof(liveEvent));
+			sender.sendSystemEvent(liveBuf, sizeof(liveEvent));
+			liveBuf->release();
+		}
+		else
+			sender.sendSystemEvent(&liveEvent, sizeof(liveEvent));
 	}
 
 	gNewtIsAliveAndWell = true;
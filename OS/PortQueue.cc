@@ -0,0 +1,249 @@
+/*
+	File:		PortQueue.cc
+
+	Contains:	Kernel port message queue implementation.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "KernelPorts.h"
+#include "SharedMem.h"
+#include <new>
+
+/*--------------------------------------------------------------------------------
+	C P o r t Q u e u e
+--------------------------------------------------------------------------------*/
+
+CPortBucket::CPortBucket()
+	:	CDoubleQContainer(offsetof(CSharedMemMsg, f80))
+{ }
+
+
+/*--------------------------------------------------------------------------------
+	Compare queue stamps. They wrap, so compare their difference.
+	Args:		inStamp1
+				inStamp2
+	Return:	true => inStamp1 was queued ahead of inStamp2
+--------------------------------------------------------------------------------*/
+
+static inline bool
+IsAhead(ULong inStamp1, ULong inStamp2)
+{
+	return (int32_t)(inStamp1 - inStamp2) < 0;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Match a message type against a filter.
+	Args:		inKey				a queued messages key
+				inProbe			the type or filter to match it
+	Return:	true => they match
+--------------------------------------------------------------------------------*/
+
+static inline bool
+KeyMatches(ULong inKey, ULong inProbe)
+{
+	return inKey == kMsgType_MatchAll
+		 || inProbe == kMsgType_MatchAll
+		 || (inKey & inProbe) != 0;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Constructor.
+--------------------------------------------------------------------------------*/
+
+CPortQueue::CPortQueue()
+	:	fBucket(NULL), fBucketMask(0), fFrontStamp(0xFFFFFFFF), fBackStamp(0)
+{ }
+
+
+/*--------------------------------------------------------------------------------
+	Destructor.
+	The port has already dequeued its messages.
+--------------------------------------------------------------------------------*/
+
+CPortQueue::~CPortQueue()
+{
+	if (fBucket)
+		FreePtr((Ptr)fBucket);
+}
+
+
+/*--------------------------------------------------------------------------------
+	Return the bucket for a key, allocating the buckets if need be.
+	We allocate with NewPtr rather than new so that, if memory is short, we
+	can carry on with the fallback queue instead of throwing from inside a
+	send or receive.
+	Args:		inKey
+	Return:	bucket index; kNumOfPortBuckets => the fallback queue
+--------------------------------------------------------------------------------*/
+
+ArrayIndex
+CPortQueue::bucketFor(ULong inKey)
+{
+	if (inKey != 0 && (inKey & (inKey - 1)) == 0)
+	{
+		if (fBucket == NULL)
+		{
+			CPortBucket * buckets = (CPortBucket *)NewPtr(kNumOfPortBuckets * sizeof(CPortBucket));
+			if (buckets != NULL)
+			{
+				for (ArrayIndex i = 0; i < kNumOfPortBuckets; ++i)
+					new (&buckets[i]) CPortBucket;
+				fBucket = buckets;
+			}
+		}
+		if (fBucket != NULL)
+			return 31 - __builtin_clz(inKey);
+	}
+	return kNumOfPortBuckets;
+}
+
+
+CDoubleQContainer *
+CPortQueue::queueAt(ArrayIndex inIndex)
+{
+	return (inIndex < kNumOfPortBuckets) ? &fBucket[inIndex] : &fOther;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Queue a message.
+	Args:		inMsg				the message
+				inKey				its type if its a sender, its filter if a receiver
+				inIsUrgent		true => put it ahead of everything else
+	Return:	--
+--------------------------------------------------------------------------------*/
+
+void
+CPortQueue::add(CSharedMemMsg * inMsg, ULong inKey, bool inIsUrgent)
+{
+	ArrayIndex				index = bucketFor(inKey);
+	CDoubleQContainer *	queue = queueAt(index);
+
+	inMsg->fPortKey = inKey;
+	if (inIsUrgent)
+	{
+		inMsg->fPortStamp = fFrontStamp--;
+		queue->addToFront(inMsg);
+	}
+	else
+	{
+		inMsg->fPortStamp = fBackStamp++;
+		queue->add(inMsg);
+	}
+	if (index < kNumOfPortBuckets)
+		fBucketMask |= BIT(index);
+}
+
+
+/*--------------------------------------------------------------------------------
+	Dequeue the message at the front of the queue, whatever its key.
+	Args:		--
+	Return:	the message; NULL => the queue is empty
+--------------------------------------------------------------------------------*/
+
+CSharedMemMsg *
+CPortQueue::remove(void)
+{
+	return removeMatch(kMsgType_MatchAll);
+}
+
+
+/*--------------------------------------------------------------------------------
+	Dequeue the message nearest the front of the queue that matches a type or
+	filter.
+	Messages are also dequeued behind our back when they complete or time out,
+	so a bucket in fBucketMask may turn out to be empty.
+	Args:		inProbe			type of a sender, or filter of a receiver
+	Return:	the message; NULL => nothing matches
+--------------------------------------------------------------------------------*/
+
+CSharedMemMsg *
+CPortQueue::removeMatch(ULong inProbe)
+{
+	CDoubleQContainer *	bestQueue = NULL;
+	CSharedMemMsg *		best = NULL;
+	CSharedMemMsg *		msg;
+
+	// the oldest message keyed by each bit of the probe is at the head of that bits bucket
+	ULong	bits = fBucketMask;
+	if (inProbe != kMsgType_MatchAll)
+		bits &= inProbe;
+	while (bits != 0)
+	{
+		ArrayIndex	bit = 31 - __builtin_clz(bits);
+		bits &= ~BIT(bit);
+		if ((msg = (CSharedMemMsg *)fBucket[bit].peek()) == NULL)
+			fBucketMask &= ~BIT(bit);
+		else if (best == NULL || IsAhead(msg->fPortStamp, best->fPortStamp))
+		{
+			best = msg;
+			bestQueue = &fBucket[bit];
+		}
+	}
+
+	// the fallback queue must be searched -- but only as far as the best so far
+	for (msg = (CSharedMemMsg *)fOther.peek(); msg != NULL; msg = (CSharedMemMsg *)fOther.getNext(msg))
+	{
+		if (best != NULL && IsAhead(best->fPortStamp, msg->fPortStamp))
+			break;
+		if (KeyMatches(msg->fPortKey, inProbe))
+		{
+			best = msg;
+			bestQueue = &fOther;
+			break;
+		}
+	}
+
+	if (best != NULL)
+		bestQueue->removeFromQueue(best);
+	return best;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Determine whether a message is queued here.
+	Args:		inMsg				the message
+	Return:	true => it is
+--------------------------------------------------------------------------------*/
+
+bool
+CPortQueue::contains(CSharedMemMsg * inMsg)
+{
+	CDoubleQContainer *	queue = inMsg->f80.fContainer;
+	if (queue == &fOther)
+		return true;
+	return fBucket != NULL
+		 && queue >= &fBucket[0] && queue < &fBucket[kNumOfPortBuckets];
+}
+
+
+/*--------------------------------------------------------------------------------
+	Change the key of a queued message.
+	It keeps its place in the queue.
+	Args:		inMsg				the message
+				inKey				its new key
+	Return:	--
+--------------------------------------------------------------------------------*/
+
+void
+CPortQueue::rekey(CSharedMemMsg * inMsg, ULong inKey)
+{
+	ArrayIndex				index = bucketFor(inKey);
+	CDoubleQContainer *	queue = queueAt(index);
+	CSharedMemMsg *		msg;
+
+	inMsg->f80.fContainer->removeFromQueue(inMsg);
+	inMsg->fPortKey = inKey;
+	for (msg = (CSharedMemMsg *)queue->peek(); msg != NULL; msg = (CSharedMemMsg *)queue->getNext(msg))
+		if (IsAhead(inMsg->fPortStamp, msg->fPortStamp))
+			break;
+	if (msg != NULL)
+		queue->addBefore(msg, inMsg);
+	else
+		queue->add(inMsg);
+	if (index < kNumOfPortBuckets)
+		fBucketMask |= BIT(index);
+}
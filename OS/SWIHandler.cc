@@ -0,0 +1,968 @@
+/*
+	File:		SWIHandler.cc
+
+	Contains:	Portable SWI handler and glue.
+					Does the job of asm-LP64/SWIHandler.s and SWIGlue.s in C++, so it
+					runs on any host that has ucontext -- AArch64 Linux included --
+					and under AddressSanitizer.
+					Define hasPortableSWI, and leave the assembler SWIHandler.s and
+					SWIGlue.s out of the build, to use it.
+
+	Written by:	Newton Research Group.
+*/
+
+#if defined(hasPortableSWI)
+
+#if defined(__APPLE__)
+#define _XOPEN_SOURCE 600		// for ucontext
+#endif
+#include <ucontext.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SharedTypes.h"
+#include "KernelTasks.h"
+#include "KernelGlobals.h"
+#include "SharedMem.h"
+#include "Scheduler.h"
+#include "UserGlobals.h"
+#include "OSErrors.h"
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define hasAddressSanitizer 1
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+#define hasAddressSanitizer 1
+#endif
+#if defined(hasAddressSanitizer)
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+
+/*------------------------------------------------------------------------------
+	How it works.
+	The assembler SWI saves and restores machine registers at fixed offsets in
+	the CTask. Here, each task has a TaskContext instead: the host context it
+	was switched out in, the middle of some SWI. The CTask registers keep the
+	ARM layout (see SharedTypes.h) and mean what they did on the ARM:
+		r0..r3		args on SWI entry; results on exit
+		kcThePC		where the task will run when it is next switched in
+		kcTheStack	its stack pointer when it was switched out
+		kcTheLink	where it goes when its task proc returns
+	Every SWI sets kcThePC to ResumeTaskContext, meaning "carry on where it was
+	switched out". If anything else sets kcThePC -- a monitor entry, Throw,
+	TaskKillSelf -- the task is started afresh at that address on its own stack,
+	below kcTheStack, with r0..r3 as args.
+------------------------------------------------------------------------------*/
+
+struct TaskContext
+{
+	ucontext_t		context;
+	const void *	stackBottom;	// for AddressSanitizer, which needs to
+	size_t			stackSize;		// know which stack we are switching to
+	void *			fakeStack;
+};
+
+#define kRestarterStackSize	(16*KByte)
+
+
+/*------------------------------------------------------------------------------
+	D a t a
+------------------------------------------------------------------------------*/
+
+extern ULong			gCPSR;
+extern bool				gWantSchedulerToRun;
+extern int				gAtomicIRQNestCountFast;
+extern int				gAtomicFIQNestCountFast;
+extern int				gAtomicNestCount;
+extern int				gAtomicFIQNestCount;
+
+extern "C" void		ServicePendingInterrupts(void);
+extern "C" ObjectId	GetPortInfo(int inWhat);
+extern "C" long		GenericSWIHandler(int inSelector, OpaqueRef inArg1, OpaqueRef inArg2, OpaqueRef inArg3, OpaqueRef inArg4);
+extern "C" NewtonErr	DoSemaphoreOp(ObjectId inGroupId, ObjectId inListId, SemFlags inBlocking, CTask * inTask);
+extern "C" void		PortSendKernelGlue(ObjectId inPortId, ObjectId inMsgId, ObjectId inMemId, ULong inMsgType, ULong inFlags);
+extern "C" void		PortReceiveKernelGlue(ObjectId inPortId, ObjectId inMsgId, ULong inMsgFilter, ULong inFlags);
+extern "C" void		PortResetFilterKernelGlue(ObjectId inPortId, ObjectId inMsgId, ULong inMsgFilter);
+extern "C"
+{
+	NewtonErr	MonitorEntryGlue(CTask * inContext, int inSelector, void * inData, ProcPtr inProc);
+	NewtonErr	MonitorDispatchKernelGlue(void);
+	NewtonErr	MonitorExitKernelGlue(NewtonErr inMonitorResult);
+	NewtonErr	MonitorThrowKernelGlue(char * inName, void * inData, void * inDestructor);
+	NewtonErr	MonitorFlushKernelGlue(ObjectId inId);
+
+	NewtonErr	SMemSetBufferKernelGlue(ObjectId inId, void * inBuffer, size_t inSize, ULong inPermissions);
+	NewtonErr	SMemGetSizeKernelGlue(ObjectId inId);
+	NewtonErr	SMemCopyToKernelGlue(ObjectId inId, void * inBuffer, size_t inSize, ULong inOffset, ObjectId inSendersMsgId, ULong inSendersSignature);
+	NewtonErr	SMemCopyFromKernelGlue(ObjectId inId, void * outBuffer, size_t inSize, ULong inOffset, ObjectId inSendersMsgId, ULong inSendersSignature);
+	NewtonErr	SMemMsgSetTimerParmsKernelGlue(ObjectId inId, Timeout inTimeout, int64_t inDelay);
+	NewtonErr	SMemMsgSetMsgAvailPortKernelGlue(ObjectId inId, ObjectId inPortId);
+	NewtonErr	SMemMsgGetSenderTaskIdKernelGlue(ObjectId inId);
+	NewtonErr	SMemMsgSetUserRefConKernelGlue(ObjectId inId, OpaqueRef inRefCon);
+	NewtonErr	SMemMsgGetUserRefConKernelGlue(ObjectId inId);
+	NewtonErr	SMemMsgCheckForDoneKernelGlue(ObjectId inId, ULong inFlags);
+	NewtonErr	SMemMsgMsgDoneKernelGlue(ObjectId inId, long inResult, ULong inSignature);
+	NewtonErr	LowLevelCopyDoneFromKernelGlue(NewtonErr inErr, CTask * inTask, VAddr inReturn);
+}
+extern void				TaskKillSelf(void);
+
+// glue that isn't declared elsewhere
+extern "C"
+{
+	ULong			Swap(ULong * inAddr, ULong inValue);
+	ULong			LowLevelGetCPUType(void);
+	ULong			LowLevelProcRevLevel(void);
+	void			LowLevelProcSpeed(ULong inNumOfIterations);
+	int			GetCPUVersion(void);
+	void			ClearFIQMask(void);
+	NewtonErr	EnterAtomicSWI(void);
+	NewtonErr	ExitAtomicSWI(void);
+	NewtonErr	EnterFIQAtomicSWI(void);
+	NewtonErr	ExitFIQAtomicSWI(void);
+	NewtonErr	DoSchedulerSWI(void);
+}
+
+static TaskContext	gBootContext;			// the host thread before there are any tasks
+static TaskContext	gRestarter;				// starts tasks afresh, off their own stacks
+static CTask *			gRestartTask;			// the task it is to start
+static TaskContext *	gSwitchedFrom;			// the context we last switched out of
+
+
+#pragma mark -
+/*------------------------------------------------------------------------------
+	T a s k   C o n t e x t s
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+	Create a context for a new task. It is filled in when the task is first
+	switched out, or started.
+	Args:		--
+	Return:	the context; NULL => no memory
+------------------------------------------------------------------------------*/
+
+TaskContext *
+NewTaskContext(void)
+{
+	TaskContext *	context = (TaskContext *) calloc(1, sizeof(TaskContext));
+	return context;
+}
+
+
+void
+DisposeTaskContext(TaskContext * inContext)
+{
+	if (inContext != NULL)
+		free(inContext);
+}
+
+
+/*------------------------------------------------------------------------------
+	The address a task's kcThePC holds while it is switched out in a SWI.
+	It is never actually called.
+------------------------------------------------------------------------------*/
+
+static void
+ResumeTaskContext(void)
+{
+	DebugStr("ResumeTaskContext called!");
+}
+
+
+/*------------------------------------------------------------------------------
+	Switch host context.
+	Returns when something switches back to inFrom.
+	Args:		inFrom		context to save
+				inTo			context to switch to
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static inline void
+FinishSwitch(void * inFakeStack)
+{
+#if defined(hasAddressSanitizer)
+	__sanitizer_finish_switch_fiber(inFakeStack, &gSwitchedFrom->stackBottom, &gSwitchedFrom->stackSize);
+#endif
+}
+
+
+static void
+SwitchContext(TaskContext * inFrom, TaskContext * inTo)
+{
+	gSwitchedFrom = inFrom;
+#if defined(hasAddressSanitizer)
+	__sanitizer_start_switch_fiber(&inFrom->fakeStack, inTo->stackBottom, inTo->stackSize);
+#endif
+	swapcontext(&inFrom->context, &inTo->context);
+	FinishSwitch(inFrom->fakeStack);
+}
+
+
+/*------------------------------------------------------------------------------
+	Start a task afresh at its kcThePC.
+	This is the entry point of a context made by the restarter; the task's
+	registers are as the kernel left them.
+	Args:		--
+	Return:	--		never
+------------------------------------------------------------------------------*/
+
+typedef void (*TaskEntryProcPtr)(unsigned long, unsigned long, unsigned long, unsigned long);
+
+static void
+StartTask(void)
+{
+	FinishSwitch(NULL);
+
+	CTask *	task = gRestartTask;
+	TaskEntryProcPtr	proc = (TaskEntryProcPtr) task->fRegister[kcThePC];
+	task->fRegister[kcThePC] = (VAddr) ResumeTaskContext;
+	proc(task->fRegister[0], task->fRegister[1], task->fRegister[2], task->fRegister[3]);
+
+	// the task proc returned: go where the link register says
+	if (task->fRegister[kcTheLink] != 0)
+		((void (*)(void)) task->fRegister[kcTheLink])();
+	TaskKillSelf();
+}
+
+
+/*------------------------------------------------------------------------------
+	The restarter.
+	We can't make a fresh context on a task's stack while we're running on it
+	-- a monitor task that exits straight into its next entry does just that --
+	so we switch to the restarter, which has a stack of its own, to do it.
+	Args:		--
+	Return:	--		never
+------------------------------------------------------------------------------*/
+
+static void
+RestartTasks(void)
+{
+	FinishSwitch(NULL);
+
+	for ( ; ; )
+	{
+		CTask *			task = gRestartTask;
+		TaskContext *	context = task->fContext;
+
+		getcontext(&context->context);
+		context->stackBottom = (const void *) task->fStackBase;
+		context->stackSize = TRUNC(task->fRegister[kcTheStack], 16) - task->fStackBase;
+		context->context.uc_stack.ss_sp = (void *) context->stackBottom;
+		context->context.uc_stack.ss_size = context->stackSize;
+		context->context.uc_link = NULL;
+		makecontext(&context->context, StartTask, 0);
+		SwitchContext(&gRestarter, context);
+	}
+}
+
+
+static void
+InitRestarter(void)
+{
+	void *	stack = malloc(kRestarterStackSize);
+	if (stack == NULL)
+		DebugStr("Can't allocate the task restarter!");
+	getcontext(&gRestarter.context);
+	gRestarter.stackBottom = stack;
+	gRestarter.stackSize = kRestarterStackSize;
+	gRestarter.context.uc_stack.ss_sp = stack;
+	gRestarter.context.uc_stack.ss_size = kRestarterStackSize;
+	gRestarter.context.uc_link = NULL;
+	makecontext(&gRestarter.context, RestartTasks, 0);
+}
+
+
+/*------------------------------------------------------------------------------
+	Switch tasks.
+	Save the previous task's state, and run the next: resume it if it was
+	switched out in a SWI, otherwise start it afresh. Returns when the previous
+	task is switched back in.
+	Args:		inPrev		task to switch out; NULL => the boot context
+				inPSR			its PSR at SWI entry
+				inNext		task to switch in
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+SwapTask(CTask * inPrev, ULong inPSR, CTask * inNext)
+{
+	TaskContext *	from;
+
+	if (inPrev != NULL)
+	{
+		inPrev->fPSR = inPSR;
+		if (inPrev->fRegister[kcThePC] == (VAddr) ResumeTaskContext)
+		{
+			// anything that restarts this task must do so below where it is now
+			VAddr	frame = (VAddr) __builtin_frame_address(0);
+			inPrev->fRegister[kcTheFrame] = frame;
+			inPrev->fRegister[kcTheStack] = frame;
+		}
+		from = inPrev->fContext;
+	}
+	else
+		from = &gBootContext;
+
+	SwapInGlobals(inNext);
+	gCPSR = inNext->fPSR;		// restore interrupt mode
+	ServicePendingInterrupts();
+
+	if (inNext->fRegister[kcThePC] == (VAddr) ResumeTaskContext)
+	{
+		if (inNext != inPrev)
+			SwitchContext(from, inNext->fContext);
+	}
+	else
+	{
+		if (gRestarter.stackBottom == NULL)
+			InitRestarter();
+		gRestartTask = inNext;
+		SwitchContext(from, &gRestarter);
+	}
+}
+
+
+#pragma mark -
+/*------------------------------------------------------------------------------
+	S W I
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+	Enter a SWI.
+	Go into supervisor mode with interrupts disabled, and save the caller's
+	args in its registers as the ARM would -- the kernel reads some of them
+	from there.
+	Args:		inCaller		the current task; NULL during boot
+				inArg0..3	args to the SWI
+	Return:	PSR at entry
+------------------------------------------------------------------------------*/
+
+static ULong
+EnterSWI(CTask * inCaller, unsigned long inArg0, unsigned long inArg1, unsigned long inArg2, unsigned long inArg3)
+{
+	ULong	psr = __atomic_exchange_n(&gCPSR, kSuperMode + kIRQDisable + kFIQDisable, __ATOMIC_SEQ_CST);
+	if ((psr & kModeMask) != kUserMode)
+		DebugStr("SWI from non-user mode (rebooting).");
+
+	if (inCaller != NULL)
+	{
+		inCaller->fRegister[0] = inArg0;
+		inCaller->fRegister[1] = inArg1;
+		inCaller->fRegister[2] = inArg2;
+		inCaller->fRegister[3] = inArg3;
+		inCaller->fRegister[kcThePC] = (VAddr) ResumeTaskContext;
+	}
+	return psr;
+}
+
+
+/*------------------------------------------------------------------------------
+	Exit a SWI.
+	The SWI work is done. If the scheduler wants, switch tasks now.
+	If the caller blocked in the SWI, its result is whatever the task that
+	wakes it puts in its result register.
+	Args:		inCaller		the task that made the SWI; NULL during boot
+				inPSR			PSR at entry
+				inResult		result of the SWI
+	Return:	result for the caller
+------------------------------------------------------------------------------*/
+
+static long
+ExitSWI(CTask * inCaller, ULong inPSR, long inResult)
+{
+	gCPSR = kSuperMode + kIRQDisable + kFIQDisable;
+
+	if (inCaller != NULL && inCaller == gCurrentTask)
+	{
+		if (gCopyDone)
+		{
+			// a copy finished: its result is in the caller's registers
+			gCopyDone = false;
+			inResult = inCaller->fRegister[kResultReg];
+		}
+		else
+			// keep the result in case the caller is switched out
+			inCaller->fRegister[kResultReg] = inResult;
+	}
+
+	// if in nested interrupt, don't swap task
+	if (gAtomicFIQNestCountFast == 0
+	&&  gAtomicIRQNestCountFast == 0
+	&&  gAtomicNestCount == 0
+	&&  gAtomicFIQNestCount == 0)
+	{
+		gCPSR = kSuperMode + kIRQDisable;
+		if (gWantDeferred)
+		{
+			gCPSR = kSuperMode;
+			DoDeferrals();
+			gCPSR = kSuperMode + kIRQDisable;
+		}
+		if (gDoSchedule)
+		{
+			CTask *	next = Scheduler();		// can never be NULL
+			if (gWantSchedulerToRun)
+				StartScheduler();
+			if (next != gCurrentTask)
+			{
+				gCurrentTask = next;
+				SwapTask(inCaller, inPSR, next);
+				// we're back
+				return inCaller->fRegister[kResultReg];
+			}
+		}
+	}
+
+	if (gWantSchedulerToRun)
+		StartScheduler();
+
+	gCPSR = inPSR;		// restore interrupt mode
+	ServicePendingInterrupts();
+	return inResult;
+}
+
+
+/*------------------------------------------------------------------------------
+	Run the copy engine.
+	SMemCopyTo/FromKernelGlue set up the caller's copy registers and return
+	1 or 4 for a copy to be done in user mode; when it's done we make the
+	LowLevelCopyDone SWI for the result.
+	Args:		inCaller		the task that made the SWI
+				inPSR			PSR at entry
+				inResult		result of the kernel glue
+	Return:	result for the caller
+------------------------------------------------------------------------------*/
+
+static long
+CopyEngine(CTask * inCaller, ULong inPSR, long inResult)
+{
+	if (inResult != 1 && inResult != 4)
+		return ExitSWI(inCaller, inPSR, inResult);
+
+	// return to the copy engine
+	char *	to = (char *) inCaller->fRegister[kCopyToBuf];
+	char *	from = (char *) inCaller->fRegister[kCopyFromBuf];
+	size_t	size = inCaller->fRegister[kCopySize];
+	ExitSWI(inCaller, inPSR, inResult);
+	if (inCaller->fCopySavedMemId == kNoId)
+		// the copy was aborted while we were switched out
+		return inCaller->fRegister[kResultReg];
+
+	memmove(to, from, size);
+
+	// DoLowLevelCopyDone
+	inPSR = EnterSWI(inCaller, (VAddr) to, (VAddr) from, size, 0);
+	LowLevelCopyDoneFromKernelGlue(noErr, inCaller, (VAddr) ResumeTaskContext);
+	return ExitSWI(inCaller, inPSR, noErr);
+}
+
+
+#pragma mark -
+/*------------------------------------------------------------------------------
+	M i s c e l l a n e o u s
+	All have C linkage.
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+	Perform atomic bit twiddling.
+	Args:		ioTarget			bits to be twiddled
+				inSetBits		bits to be set in target
+				inClearBits		bits to be cleared in target
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+SetAndClearBitsAtomic(ULong * ioTarget, ULong inSetBits, ULong inClearBits)
+{
+	ULong	bits = __atomic_load_n(ioTarget, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(ioTarget, &bits, (bits | inSetBits) & ~inClearBits, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		;
+}
+
+
+/*------------------------------------------------------------------------------
+	Swap a value into memory atomically.
+	Args:		inAddr			where to swap
+				inValue			value to swap in
+	Return:	value swapped out
+------------------------------------------------------------------------------*/
+
+ULong
+Swap(ULong * inAddr, ULong inValue)
+{
+	return __atomic_exchange_n(inAddr, inValue, __ATOMIC_SEQ_CST);
+}
+
+
+ULong
+LowLevelGetCPUType(void)
+{
+	return 6;
+}
+
+
+ULong
+LowLevelProcRevLevel(void)
+{
+	return 0;
+}
+
+
+void
+LowLevelProcSpeed(ULong inNumOfIterations)
+{ }
+
+
+int
+GetCPUVersion(void)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, 0, 0, 0, 0);
+	return ExitSWI(caller, psr, 0);
+}
+
+
+int
+GetCPUMode(void)
+{
+	return gCPSR & kModeMask;
+}
+
+
+bool
+IsSuperMode(void)
+{
+	return (gCPSR & kModeMask) != kUserMode;
+}
+
+
+void
+ClearFIQMask(void)
+{
+	gCPSR &= ~kFIQDisable;
+}
+
+
+/*------------------------------------------------------------------------------
+	Atomic actions by SWI.
+	Don't think these are used.
+------------------------------------------------------------------------------*/
+
+NewtonErr
+EnterAtomicSWI(void)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, 0, 0, 0, 0);
+	gAtomicNestCount++;
+	return ExitSWI(caller, psr, noErr);
+}
+
+
+NewtonErr
+ExitAtomicSWI(void)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, 0, 0, 0, 0);
+	if (--gAtomicNestCount < 0)
+		DebugStr("Exit Atomic called too many times!!!");
+	return ExitSWI(caller, psr, noErr);
+}
+
+
+NewtonErr
+EnterFIQAtomicSWI(void)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, 0, 0, 0, 0);
+	gAtomicFIQNestCount++;
+	return ExitSWI(caller, psr, noErr);
+}
+
+
+NewtonErr
+ExitFIQAtomicSWI(void)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, 0, 0, 0, 0);
+	if (--gAtomicFIQNestCount < 0)
+		DebugStr("Exit FIQ Atomic called too many times!!!");
+	return ExitSWI(caller, psr, noErr);
+}
+
+
+/*------------------------------------------------------------------------------
+	Handle a generic SWI.
+	Args:		inSelector	generic SWI sub-selector
+				...			up to four args
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+GenericSWI(int inSelector, ...)
+{
+	if (IsSuperMode())
+		DebugStr("Zot! GenericSWI called from non-user mode.");
+
+	va_list	args;
+	va_start(args, inSelector);
+	OpaqueRef	arg1 = va_arg(args, OpaqueRef);
+	OpaqueRef	arg2 = va_arg(args, OpaqueRef);
+	OpaqueRef	arg3 = va_arg(args, OpaqueRef);
+	OpaqueRef	arg4 = va_arg(args, OpaqueRef);
+	va_end(args);
+
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, inSelector, arg1, arg2, arg3);
+	long		result = GenericSWIHandler(inSelector, arg1, arg2, arg3, arg4);
+	return ExitSWI(caller, psr, result);
+}
+
+
+/*------------------------------------------------------------------------------
+	Handle a generic SWI that returns information.
+	Args:		inSelector	generic SWI sub-selector
+				inp1..3		args
+				outp1..3		results; may be NULL
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+GenericWithReturnSWI(int inSelector, ULong inp1, ULong inp2, ULong inp3, OpaqueRef * outp1, OpaqueRef * outp2, OpaqueRef * outp3)
+{
+	CTask *		caller = gCurrentTask;
+	ULong			psr = EnterSWI(caller, inSelector, inp1, inp2, inp3);
+	NewtonErr	result = ExitSWI(caller, psr, GenericSWIHandler(inSelector, inp1, inp2, inp3, 0));
+	if (outp1 != NULL)
+		*outp1 = caller->fRegister[kReturnParm1];
+	if (outp2 != NULL)
+		*outp2 = caller->fRegister[kReturnParm2];
+	if (outp3 != NULL)
+		*outp3 = caller->fRegister[kReturnParm3];
+	return result;
+}
+
+
+#pragma mark -
+/*------------------------------------------------------------------------------
+	P o r t s
+------------------------------------------------------------------------------*/
+
+ObjectId
+GetPortSWI(int inWhat)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, inWhat, 0, 0, 0);
+	return ExitSWI(caller, psr, GetPortInfo(inWhat));
+}
+
+
+/*------------------------------------------------------------------------------
+	Send a message from a port.
+	The kernel glue leaves its result in the caller's result register;
+	if the send blocks the caller, so does whatever completes it.
+------------------------------------------------------------------------------*/
+
+NewtonErr
+PortSendSWI(ObjectId inId, ObjectId inMsgId, ObjectId inReplyId, ULong inMsgType, ULong inFlags)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, inId, inMsgId, inReplyId, inMsgType);
+	PortSendKernelGlue(inId, inMsgId, inReplyId, inMsgType, inFlags);
+	return ExitSWI(caller, psr, caller->fRegister[kResultReg]);
+}
+
+
+/*------------------------------------------------------------------------------
+	Receive a message at a port.
+	Sender info is returned in the caller's registers r1..r4.
+------------------------------------------------------------------------------*/
+
+NewtonErr
+PortReceiveSWI(ObjectId inId, ObjectId inMsgId, ULong inMsgFilter, ULong inFlags, ObjectId * outSenderMsgId, ObjectId * outReplyMemId, ULong * outMsgType, ULong * outSignature)
+{
+	CTask *		caller = gCurrentTask;
+	ULong			psr = EnterSWI(caller, inId, inMsgId, inMsgFilter, inFlags);
+	PortReceiveKernelGlue(inId, inMsgId, inMsgFilter, inFlags);
+	NewtonErr	result = ExitSWI(caller, psr, caller->fRegister[kResultReg]);
+	if (outSenderMsgId != NULL)
+		*outSenderMsgId = caller->fRegister[kReturnParm1];
+	if (outReplyMemId != NULL)
+		*outReplyMemId = caller->fRegister[kReturnParm2];
+	if (outMsgType != NULL)
+		*outMsgType = caller->fRegister[kReturnParm3];
+	if (outSignature != NULL)
+		*outSignature = caller->fRegister[kReturnParm4];
+	return result;
+}
+
+
+NewtonErr
+PortResetFilterSWI(ObjectId inId, ObjectId inMsgId, ULong inMsgFilter)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, inId, inMsgId, inMsgFilter, 0);
+	PortResetFilterKernelGlue(inId, inMsgId, inMsgFilter);
+	return ExitSWI(caller, psr, caller->fRegister[kResultReg]);
+}
+
+
+#pragma mark -
+/*------------------------------------------------------------------------------
+	S e m a p h o r e s
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+	Perform a semaphore operation.
+	If it blocks, the op is run again when the caller is woken.
+	Args:		inGroupId		semaphore group
+				inListId			op list
+				inBlocking		block or fail if the op can't be performed
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+SemaphoreOpGlue(ObjectId inGroupId, ObjectId inListId, SemFlags inBlocking)
+{
+	CTask *	caller = gCurrentTask;
+	for ( ; ; )
+	{
+		ULong		psr = EnterSWI(caller, inGroupId, inListId, inBlocking, 0);
+		NewtonErr	result = DoSemaphoreOp(inGroupId, inListId, inBlocking, caller);
+		bool			isBlocked = (gCurrentTask != caller);
+		result = ExitSWI(caller, psr, result);
+		if (!isBlocked)
+			return result;
+	}
+}
+
+
+#pragma mark -
+/*------------------------------------------------------------------------------
+	S h a r e d   M e m o r y
+------------------------------------------------------------------------------*/
+
+NewtonErr
+SMemSetBufferSWI(ObjectId inId, void * inBuffer, size_t inSize, ULong inPermissions)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, inId, (VAddr) inBuffer, inSize, inPermissions);
+	return ExitSWI(caller, psr, SMemSetBufferKernelGlue(inId, inBuffer, inSize, inPermissions));
+}
+
+
+NewtonErr
+SMemGetSizeSWI(ObjectId inId, size_t * outSize, void ** outBuffer, OpaqueRef * outRefCon)
+{
+	CTask *		caller = gCurrentTask;
+	ULong			psr = EnterSWI(caller, inId, 0, 0, 0);
+	NewtonErr	result = ExitSWI(caller, psr, SMemGetSizeKernelGlue(inId));
+	if (outSize != NULL)
+		*outSize = caller->fRegister[kReturnParm1];
+	if (outBuffer != NULL)
+		*outBuffer = (void *) caller->fRegister[kReturnParm2];
+	if (outRefCon != NULL)
+		*outRefCon = caller->fRegister[kReturnParm3];
+	return result;
+}
+
+
+NewtonErr
+SMemCopyToSharedSWI(ObjectId inId, void * inBuffer, size_t inSize, ULong inOffset, ULong inSendersMsgId, ULong inSignature)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, inId, (VAddr) inBuffer, inSize, inOffset);
+	return CopyEngine(caller, psr, SMemCopyToKernelGlue(inId, inBuffer, inSize, inOffset, inSendersMsgId, inSignature));
+}
+
+
+NewtonErr
+SMemCopyFromSharedSWI(ObjectId inId, void * inBuffer, size_t inSize, ULong inOffset, ULong inSendersMsgId, ULong inSignature, size_t * outSize)
+{
+	CTask *		caller = gCurrentTask;
+	ULong			psr = EnterSWI(caller, inId, (VAddr) inBuffer, inSize, inOffset);
+	NewtonErr	result = CopyEngine(caller, psr, SMemCopyFromKernelGlue(inId, inBuffer, inSize, inOffset, inSendersMsgId, inSignature));
+	if (outSize != NULL)
+		*outSize = caller->fRegister[kReturnParm1];
+	return result;
+}
+
+
+NewtonErr
+SMemMsgSetTimerParmsSWI(ObjectId inId, ULong inTimeout, int64_t inDelay)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, inId, inTimeout, inDelay, 0);
+	return ExitSWI(caller, psr, SMemMsgSetTimerParmsKernelGlue(inId, inTimeout, inDelay));
+}
+
+
+NewtonErr
+SMemMsgSetMsgAvailPortSWI(ObjectId inId, ULong inPortId)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, inId, inPortId, 0, 0);
+	return ExitSWI(caller, psr, SMemMsgSetMsgAvailPortKernelGlue(inId, inPortId));
+}
+
+
+NewtonErr
+SMemMsgGetSenderTaskIdSWI(ObjectId inId, ObjectId * outSenderTaskId)
+{
+	CTask *		caller = gCurrentTask;
+	ULong			psr = EnterSWI(caller, inId, 0, 0, 0);
+	NewtonErr	result = ExitSWI(caller, psr, SMemMsgGetSenderTaskIdKernelGlue(inId));
+	if (outSenderTaskId != NULL)
+		*outSenderTaskId = caller->fRegister[kReturnParm1];
+	return result;
+}
+
+
+NewtonErr
+SMemMsgSetUserRefConSWI(ObjectId inId, OpaqueRef inRefCon)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, inId, inRefCon, 0, 0);
+	return ExitSWI(caller, psr, SMemMsgSetUserRefConKernelGlue(inId, inRefCon));
+}
+
+
+NewtonErr
+SMemMsgGetUserRefConSWI(ObjectId inId, OpaqueRef * outRefCon)
+{
+	CTask *		caller = gCurrentTask;
+	ULong			psr = EnterSWI(caller, inId, 0, 0, 0);
+	NewtonErr	result = ExitSWI(caller, psr, SMemMsgGetUserRefConKernelGlue(inId));
+	if (outRefCon != NULL)
+		*outRefCon = caller->fRegister[kReturnParm1];
+	return result;
+}
+
+
+/*------------------------------------------------------------------------------
+	Check whether a message has been replied to.
+	Like a receive, this may block; sender info is returned in r1..r4.
+------------------------------------------------------------------------------*/
+
+NewtonErr
+SMemMsgCheckForDoneSWI(ObjectId inId, ULong inFlags, ObjectId * outSentById, ObjectId * outReplyMemId, ULong * outMsgType, ULong * outSignature)
+{
+	CTask *		caller = gCurrentTask;
+	ULong			psr = EnterSWI(caller, inId, inFlags, 0, 0);
+	SMemMsgCheckForDoneKernelGlue(inId, inFlags);
+	NewtonErr	result = ExitSWI(caller, psr, caller->fRegister[kResultReg]);
+	if (outSentById != NULL)
+		*outSentById = caller->fRegister[kReturnParm1];
+	if (outReplyMemId != NULL)
+		*outReplyMemId = caller->fRegister[kReturnParm2];
+	if (outMsgType != NULL)
+		*outMsgType = caller->fRegister[kReturnParm3];
+	if (outSignature != NULL)
+		*outSignature = caller->fRegister[kReturnParm4];
+	return result;
+}
+
+
+NewtonErr
+SMemMsgMsgDoneSWI(ObjectId inId, NewtonErr inResult, ULong inSignature)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, inId, inResult, inSignature, 0);
+	return ExitSWI(caller, psr, SMemMsgMsgDoneKernelGlue(inId, inResult, inSignature));
+}
+
+
+#pragma mark -
+/*------------------------------------------------------------------------------
+	M o n i t o r s
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+	Run a task member function as a monitor.
+	The monitor task starts here afresh for every entry.
+	Args:		inContext		instance of task in which to run
+				inSelector
+				inData
+				inProc
+	Return:	error code	-- never returns, actually
+------------------------------------------------------------------------------*/
+
+typedef NewtonErr (*MonitorEntryProcPtr)(CTask *, int, void *);
+
+NewtonErr
+MonitorEntryGlue(CTask * inContext, int inSelector, void * inData, ProcPtr inProc)
+{
+	if (IsSuperMode())
+		DebugStr("Zot! Check SVC mode in MonitorEntryGlue.");
+
+	// inProc is really the monitor's member function; cast via a generic
+	// function pointer type, which is what it has been all along
+	NewtonErr	result = ((MonitorEntryProcPtr) (void (*)(void)) inProc)(inContext, inSelector, inData);
+	return MonitorExitSWI(result, NULL);
+}
+
+
+NewtonErr
+MonitorDispatchSWI(ObjectId inMonitorId, int inSelector, OpaqueRef inData)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, inMonitorId, inSelector, inData, 0);
+	return ExitSWI(caller, psr, MonitorDispatchKernelGlue());
+}
+
+
+NewtonErr
+MonitorExitSWI(int inMonitorResult, void * inContinuationPC)
+{
+	CTask *		caller = gCurrentTask;
+	ULong			psr = EnterSWI(caller, inMonitorResult, (VAddr) inContinuationPC, 0, 0);
+	NewtonErr	result = ExitSWI(caller, psr, MonitorExitKernelGlue(inMonitorResult));
+	// we should never return
+	DebugStr("MonitorExitSWI failed! This should never happen...");
+	return result;
+}
+
+
+void
+MonitorThrowSWI(ExceptionName inName, void * inData, ExceptionDestructor inDestructor)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, (VAddr) inName, (VAddr) inData, (VAddr) inDestructor, 0);
+	ExitSWI(caller, psr, MonitorThrowKernelGlue((char *) inName, inData, (void *) inDestructor));
+	// we should never return
+	DebugStr("MonitorThrowSWI failed; check your head.");
+}
+
+
+NewtonErr
+MonitorFlushSWI(ObjectId inMonitorId)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, inMonitorId, 0, 0, 0);
+	return ExitSWI(caller, psr, MonitorFlushKernelGlue(inMonitorId));
+}
+
+
+#pragma mark -
+/*------------------------------------------------------------------------------
+	S c h e d u l e r
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+	Actually, the scheduler gets updated on every SWI;
+	we just need to provide a legitimate SWI.
+	Args:		--
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+DoSchedulerSWI(void)
+{
+	CTask *	caller = gCurrentTask;
+	ULong		psr = EnterSWI(caller, 0, 0, 0, 0);
+	return ExitSWI(caller, psr, noErr);
+}
+
+#endif	/* hasPortableSWI */
@@ -9,6 +9,7 @@
 #include "Scheduler.h"
 #include "KernelGlobals.h"
 #include "Semaphore.h"
+#include "OSErrors.h"
 
 
 /*------------------------------------------------------------------------------
@@ -96,6 +97,7 @@ Scheduler(void)
 		gSavedPtrsUsed = gPtrsUsed;
 		gCurrentMemCountTask = task;
 		gNumberOfTaskSwaps++;
+		task->fSwitchCount++;
 	}
 
 	if (gCountTaskTime)
@@ -119,9 +121,16 @@ Scheduler(void)
 				gFIQAccumulatedIntOverhead += fiqOverhead;
 				gIRQAccumulatedIntOverhead += irqOverhead;
 				taskOverhead = fiqOverhead + irqOverhead;
-				taskTime = now - gTaskTimeStart - taskOverhead;
+				taskTime = now;	// CTime arithmetic works in place -- dont disturb now
+				taskTime = taskTime - gTaskTimeStart - taskOverhead;
 				gCurrentTimedTask->fTaskTime = gCurrentTimedTask->fTaskTime + taskTime;
 			}
+			if (task->fReadyTime != CTime(0))
+			{
+				CTime	waitTime(now);
+				task->fWaitTime = task->fWaitTime + (waitTime - task->fReadyTime);
+				task->fReadyTime = 0;
+			}
 			gCurrentTimedTask = task;
 			gTaskTimeStart = now;
 		}
@@ -213,6 +222,37 @@ SleepTask(void)
 }
 
 
+/*------------------------------------------------------------------------------
+	Return a tasks scheduling statistics.
+	The running tasks run time is brought up to date.
+	Args:		inTaskId		the task
+				outStats		its statistics
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+GetTaskStatistics(ObjectId inTaskId, TaskStatistics * outStats)
+{
+	NewtonErr	err = noErr;
+	CTask *		task;
+
+	EnterAtomic();
+	if ((task = (CTask *)IdToObj(kTaskType, inTaskId)) != NULL)
+	{
+		outStats->runTime = task->fTaskTime;
+		if (gCountTaskTime && task == gCurrentTimedTask)
+			outStats->runTime = outStats->runTime + (GetGlobalTime() - gTaskTimeStart - CTime(gIRQInterruptOverhead + gFIQInterruptOverhead));
+		outStats->waitTime = task->fWaitTime;
+		outStats->switches = task->fSwitchCount;
+	}
+	else
+		err = kOSErrTaskDoesNotExist;
+	ExitAtomic();
+
+	return err;
+}
+
+
 #pragma mark -
 /*------------------------------------------------------------------------------
 	C S c h e d u l e r
@@ -278,6 +318,8 @@ CScheduler::add(CTask * inTask)
 
 //	Add the task to its queue (according to priority)
 	fTasks[priority].add(inTask, 0x00020000, this);
+	if (gCountTaskTime && inTask->fReadyTime == CTime(0))
+		inTask->fReadyTime = GetGlobalTime();
 
 //	If were only idling, schedule the task we just added
 	if (gCurrentTask == gIdleTask)
@@ -327,6 +369,7 @@ CScheduler::remove(CTask * inTask)
 		//	Remove the task from its queue (according to priority)
 			ArrayIndex priority = inTask->fPriority;
 			fTasks[priority].removeFromQueue(inTask, 0x00020000);
+			inTask->fReadyTime = 0;
 
 		//	If there are no more tasks at this priority, clear the priority mask accordingly
 			if (fTasks[priority].peek() == NULL)
@@ -388,6 +431,8 @@ CScheduler::removeHighestPriority(void)
 
 /*------------------------------------------------------------------------------
 	Update the highest priority task available.
+	The highest bit set in the priority mask is the highest priority with
+	tasks queued; count its leading zeros rather than test bit by bit.
 	Args:		--
 	Return:	--
 ------------------------------------------------------------------------------*/
@@ -395,17 +440,6 @@ CScheduler::removeHighestPriority(void)
 void
 CScheduler::updateCurrentBucket(void)
 {
-	if (fHighestPriority > 0)
-	{
-		for (ArrayIndex i = fHighestPriority - 1; i > 0; i--)
-		{
-			if (fPriorityMask & BIT(i))
-			{
-				fHighestPriority = i;
-				return;
-			}
-		}
-		fHighestPriority = 0;
-	}
+	fHighestPriority = (fPriorityMask != 0) ? 31 - __builtin_clz(fPriorityMask) : 0;
 }
 
@@ -47,6 +47,19 @@ inline CTask *	CScheduler::currentTask(void)		{ return fCurrentTask; }
 inline void		CScheduler::setCurrentTask(CTask * inTask)	{ fCurrentTask = inTask; }
 
 
+/*------------------------------------------------------------------------------
+	T a s k   S t a t i s t i c s
+	Times are only accumulated while gCountTaskTime is set.
+------------------------------------------------------------------------------*/
+
+struct TaskStatistics
+{
+	CTime		runTime;			// time spent running, less interrupt overhead
+	CTime		waitTime;		// time spent ready to run but not running
+	ULong		switches;		// times switched in
+};
+
+
 /*------------------------------------------------------------------------------
 	P u b l i c   I n t e r f a c e
 ------------------------------------------------------------------------------*/
@@ -61,6 +74,7 @@ extern void		AllowSchedule(void);
 extern void		ScheduleTask(CTask * inTask);
 extern void		UnScheduleTask(CTask * inTask);
 extern void		SleepTask(void);
+extern NewtonErr	GetTaskStatistics(ObjectId inTaskId, TaskStatistics * outStats);
 
 
 #endif	/* __SCHEDULER_H */
@@ -7,6 +7,9 @@
 */
 
 #include "SerialTool.h"
+#if !defined(correct)
+#include "HostSerial.h"
+#endif
 
 
 /*--------------------------------------------------------------------------------
@@ -152,7 +155,11 @@ CCommTool::getComplete(NewtonErr inStatus, bool inEndOfFrame, size_t inGetBytesC
 
 CAsyncSerTool::CAsyncSerTool(ULong inId)
 	:	CSerTool(inId)
-{ }
+{
+#if !defined(correct)
+	fHostPort = NULL;
+#endif
+}
 
 CAsyncSerTool::~CAsyncSerTool()
 { }	// both CCircleBufs have destructors
@@ -311,6 +318,93 @@ CAsyncSerTool::emptyInputBuffer(ULong * outArg)
 	return status;
 }
 
+#if !defined(correct)
+/*--------------------------------------------------------------------------------
+	There is no serial chip on the host. Instead the tool opens the host serial
+	port named by gHostSerialSpec and moves bytes between it and its buffers on
+	its own task: after every message, and on a timer tick at the interval the
+	chip would have sent for input available.
+--------------------------------------------------------------------------------*/
+
+void
+CAsyncSerTool::turnOnSerChip(void)
+{
+	if (fHostPort == NULL && gHostSerialSpec != NULL)
+	{
+		fHostPort = new CHostSerialPort;
+		if (fHostPort != NULL && fHostPort->open(gHostSerialSpec) != noErr)
+		{
+			delete fHostPort;
+			fHostPort = NULL;
+		}
+	}
+	fTimeout = f470.fInputDelay;
+	fTimeoutRemaining = fTimeout;
+}
+
+void
+CAsyncSerTool::turnOffSerChip(void)
+{
+	if (fHostPort != NULL)
+	{
+		delete fHostPort;		// closes it
+		fHostPort = NULL;
+	}
+	fTimeout = kNoTimeout;
+}
+
+void
+CAsyncSerTool::startOutputST(void)
+{
+	transferHostBytes();
+}
+
+void
+CAsyncSerTool::continueOutputST(bool inArg1)
+{
+	transferHostBytes();
+}
+
+void
+CAsyncSerTool::doInput(void)
+{
+	ULong eom = 0;
+	NewtonErr status = emptyInputBuffer(&eom);
+	if (status == 6)
+		getComplete(noErr);
+	else if (status == 1000)
+		getComplete(noErr, true);
+	else if (status != noErr)
+		getComplete(status);
+	// else wait for more bytes to arrive
+}
+
+void
+CAsyncSerTool::handleInternalEvent(void)
+{
+	transferHostBytes();
+}
+
+void
+CAsyncSerTool::handleTimerTick(void)
+{
+	transferHostBytes();
+}
+
+void
+CAsyncSerTool::transferHostBytes(void)
+{
+	if (fHostPort != NULL)
+	{
+		ULong result = fHostPort->transfer(&fRecvBuf, &fSendBuf);
+		if (FLAGTEST(result, kHostSerialReceived))
+			rxDataAvailable();
+		if (FLAGTEST(result, kHostSerialSent))
+			txDataSent();
+	}
+}
+#endif
+
 #pragma mark -
 
 /*--------------------------------------------------------------------------------
@@ -496,6 +590,15 @@ CFramedAsyncSerTool::fillOutputBuffer(void)
 
 //	append char to output buffer
 				case 1:
+					if (!fIsPutCharStacked && fPutBuffer.bufferCount() > 1)
+					{
+						ArrayIndex runSize = putFramedRun();
+						if (runSize > 0)
+						{
+							numOfBytesInFrame += runSize;
+							break;
+						}
+					}
 					if (fIsPutCharStacked)
 					{
 						fIsPutCharStacked = false;
@@ -618,6 +721,7 @@ CFramedAsyncSerTool::emptyInputBuffer(ULong * outArg)
 					fGetFCS.reset();
 					if (framing.fDoHeader)
 					{
+						skipToSYN();
 						do
 						{
 							XFAIL(status = fRecvBuf.getNextByte(&ch, outArg))
@@ -657,6 +761,8 @@ CFramedAsyncSerTool::emptyInputBuffer(ULong * outArg)
 
 //	read char from input buffer
 				case 3:
+					if (!fIsGetCharStacked && !fIsGetCharEscaped && getFramedRun() > 0)
+						break;
 					if (fIsGetCharStacked)
 					{
 						fIsGetCharStacked = false;
@@ -772,130 +878,143 @@ CFramedAsyncSerTool::emptyInputBuffer(ULong * outArg)
 }
 
 
-void
-CFramedAsyncSerTool::resetFramingStats(void)
-{
-	framingStats.fPreHeaderByteCount = 0;
-}
-
-
-void
-CFramedAsyncSerTool::setFramingCtl(CCMOFramingParms * inParms)
-{
-	framing = *inParms;
-}
-
-
-void
-CFramedAsyncSerTool::getFramingCtl(CCMOFramingParms * outParms)
-{
-	*outParms = framing;
-}
-
-#pragma mark -
-
 /*--------------------------------------------------------------------------------
-	CRC16
+	Move a run of bytes from the put buffer to the send buffer, doubling any
+	escape chars, and add them to the frame check sequence.
+	The bytes are scanned where they lie in the put buffer, which may be in
+	two spans, and copied straight to the send buffer.
+	The run is limited to half the free space in the send buffer so it always
+	fits even if every byte has to be escaped.
+	Args:		--
+	Return:	number of bytes added to the send buffer
 --------------------------------------------------------------------------------*/
 
-static const UShort kCRC16LoTable[16] =
+ArrayIndex
+CFramedAsyncSerTool::putFramedRun(void)
 {
-	0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
-	0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440
-};
+	UByte * span[2];
+	ArrayIndex spanSize[2];
+	ArrayIndex runSize = fSendBuf.bufferSpace() / 2;
+	if (runSize == 0 || fPutBuffer.peekSpans(&span[0], &spanSize[0], &span[1], &spanSize[1]) != noErr)
+		return 0;
 
-static const UShort kCRC16HiTable[16] =
-{
-	0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
-	0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
-};
+	ArrayIndex numOfBytesTaken = 0;
+	ArrayIndex numOfBytesPut = 0;
+	for (ArrayIndex i = 0; i < 2 && numOfBytesTaken < runSize; ++i)
+	{
+		ArrayIndex size = spanSize[i];
+		if (size > runSize - numOfBytesTaken)
+			size = runSize - numOfBytesTaken;
+		if (framing.fDoPutFCS)
+			fPutFCS.computeCRC(span[i], size);
+		numOfBytesTaken += size;
+
+		UByte * p = span[i];
+		UByte * pEnd = p + size;
+		while (p < pEnd)
+		{
+			UByte * esc = (UByte *)memchr(p, framing.fEscapeChar, pEnd - p);
+			UByte * escSpanEnd = (esc != NULL) ? esc + 1 : pEnd;
+			ArrayIndex escSpanSize = escSpanEnd - p;
+			numOfBytesPut += escSpanSize;
+			fSendBuf.copyIn(p, &escSpanSize);
+			if (esc != NULL)
+			{
+				fSendBuf.putNextByte(framing.fEscapeChar);
+				numOfBytesPut++;
+			}
+			p = escSpanEnd;
+		}
+	}
+	fPutBuffer.updateStart(numOfBytesTaken);
+	return numOfBytesPut;
+}
 
 
 /*--------------------------------------------------------------------------------
-	Reset the CRC.
+	Move a run of unescaped bytes from the receive buffer to the get buffer,
+	adding them to the frame check sequence.
+	Stops at the first escape char, which is left for the byte-at-a-time
+	state machine along with any EOM marker.
+	The bytes are scanned where they lie in the receive buffer, which may be
+	in two spans, and copied straight to the get buffer.
 	Args:		--
-	Return:	--
+	Return:	number of bytes moved
 --------------------------------------------------------------------------------*/
 
-void
-CRC16::reset(void)
+ArrayIndex
+CFramedAsyncSerTool::getFramedRun(void)
 {
-	workingCRC = 0;
+	UByte * span[2];
+	ArrayIndex spanSize[2];
+	ArrayIndex runSize = fGetBuffer.bufferSpace();
+	if (runSize == 0 || fRecvBuf.peekSpans(&span[0], &spanSize[0], &span[1], &spanSize[1]) != noErr)
+		return 0;
+
+	ArrayIndex numOfBytesMoved = 0;
+	for (ArrayIndex i = 0; i < 2 && numOfBytesMoved < runSize; ++i)
+	{
+		ArrayIndex size = spanSize[i];
+		if (size > runSize - numOfBytesMoved)
+			size = runSize - numOfBytesMoved;
+		UByte * esc = (UByte *)memchr(span[i], framing.fEscapeChar, size);
+		if (esc != NULL)
+			size = esc - span[i];
+		if (size > 0)
+		{
+			ArrayIndex amtLeft = size;
+			fGetBuffer.copyIn(span[i], &amtLeft);
+			if (framing.fDoGetFCS)
+				fGetFCS.computeCRC(span[i], size);
+			numOfBytesMoved += size;
+		}
+		if (esc != NULL)
+			break;
+	}
+	fRecvBuf.updateStart(numOfBytesMoved);
+	return numOfBytesMoved;
 }
 
 
 /*--------------------------------------------------------------------------------
-	Add character into CRC computation.
-	Args:		inChar
+	Discard bytes in the receive buffer up to the next SYN start-of-frame char.
+	Args:		--
 	Return:	--
 --------------------------------------------------------------------------------*/
 
 void
-CRC16::computeCRC(UByte inChar)
+CFramedAsyncSerTool::skipToSYN(void)
 {
-	ULong index = ((workingCRC & 0xFF) ^ inChar);
-	ULong loCRC = kCRC16LoTable[index & 0x0F];
-	ULong hiCRC = kCRC16HiTable[(index & 0xF0) >> 4];
-	workingCRC = (workingCRC >> 8) ^ (hiCRC ^ loCRC);
+	UByte * span[2];
+	ArrayIndex spanSize[2];
+	while (fRecvBuf.peekSpans(&span[0], &spanSize[0], &span[1], &spanSize[1]) == noErr)
+	{
+		UByte * syn = (UByte *)memchr(span[0], chSYN, spanSize[0]);
+		ArrayIndex skipSize = (syn != NULL) ? syn - span[0] : spanSize[0];
+		fRecvBuf.updateStart(skipSize);
+		framingStats.fPreHeaderByteCount += skipSize;
+		if (syn != NULL)
+			break;
+	}
 }
 
 
-/*--------------------------------------------------------------------------------
-	Add characters in buffer into CRC computation.
-	Args:		inData
-	Return:	--
---------------------------------------------------------------------------------*/
-
 void
-CRC16::computeCRC(CBufferList& inData)
+CFramedAsyncSerTool::resetFramingStats(void)
 {
-	int ch;
-	inData.seek(0, kSeekFromBeginning);
-	while ((ch = inData.get()) != -1)
-	{
-		ULong index = ((workingCRC & 0xFF) ^ ch);
-		ULong loCRC = kCRC16LoTable[index & 0x0F];
-		ULong hiCRC = kCRC16HiTable[(index & 0xF0) >> 4];
-		workingCRC = (workingCRC >> 8) ^ (hiCRC ^ loCRC);
-	}
+	framingStats.fPreHeaderByteCount = 0;
 }
 
 
-/*--------------------------------------------------------------------------------
-	Add characters in buffer into CRC computation.
-	Args:		inData
-				inSize
-	Return:	--
---------------------------------------------------------------------------------*/
-
 void
-CRC16::computeCRC(UByte * inData, size_t inSize)
+CFramedAsyncSerTool::setFramingCtl(CCMOFramingParms * inParms)
 {
-	for ( ; inSize > 0; inSize--)
-	{
-		ULong index = ((workingCRC & 0xFF) ^ *inData++);
-		ULong loCRC = kCRC16LoTable[index & 0x0F];
-		ULong hiCRC = kCRC16HiTable[(index & 0xF0) >> 4];
-		workingCRC = (workingCRC >> 8) ^ (hiCRC ^ loCRC);
-	}
+	framing = *inParms;
 }
 
 
-/*--------------------------------------------------------------------------------
-	Copy 16-bit CRC into two chars in reverse network byte order.
-	Args:		--
-	Return:	--
---------------------------------------------------------------------------------*/
-
 void
-CRC16::get(void)
+CFramedAsyncSerTool::getFramingCtl(CCMOFramingParms * outParms)
 {
-#if defined(hasByteSwapping)
-	crc16[0] = workingCRC;
-	crc16[1] = workingCRC >> 8;
-#else
-	crc16[1] = workingCRC;
-	crc16[0] = workingCRC >> 8;
-#endif
+	*outParms = framing;
 }
-
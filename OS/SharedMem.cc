@@ -7,6 +7,7 @@
 */
 
 #include "SharedMem.h"
+#include "UserSharedMem.h"
 #include "KernelGlobals.h"
 #include "PageManager.h"
 #include "OSErrors.h"
@@ -27,7 +28,7 @@ extern "C"
 	NewtonErr	SMemMsgSetTimerParmsKernelGlue(ObjectId inId, Timeout inTimeout, int64_t inDelay);
 	NewtonErr	SMemMsgSetMsgAvailPortKernelGlue(ObjectId inId, ObjectId inPortId);
 	NewtonErr	SMemMsgGetSenderTaskIdKernelGlue(ObjectId inId);
-	NewtonErr	SMemMsgSetUserRefConKernelGlue(ObjectId inId, ULong inRefCon);
+	NewtonErr	SMemMsgSetUserRefConKernelGlue(ObjectId inId, OpaqueRef inRefCon);
 	NewtonErr	SMemMsgGetUserRefConKernelGlue(ObjectId inId);
 	NewtonErr	SMemMsgCheckForDoneKernelGlue(ObjectId inId, ULong inFlags);
 	NewtonErr	SMemMsgMsgDoneKernelGlue(ObjectId inId, long inResult, ULong inSignature);
@@ -40,6 +41,8 @@ extern "C"
 
 bool  gWantDeferred = false;
 
+static SMemCopyStatistics	gSMemCopyStats[kNumOfSMemCopyTypes];
+
 
 /*--------------------------------------------------------------------------------
 	G l u e
@@ -96,7 +99,8 @@ SMemGetSizeKernelGlue(ObjectId inId)
 			XFAIL(err = ConvertIdToObj(kTaskType, memOwner, &task))
 			memOwner = task->fBequeathId;
 		}
-		gCurrentTask->fRegister[kReturnParm2] = isMemOwnedByTask ? (VAddr) mem->fAddr : 0;
+		// a SharedBufferRef is there for the receiver to read in place
+		gCurrentTask->fRegister[kReturnParm2] = (isMemOwnedByTask || FLAGTEST(mem->fPerm, kSMemSharedBuffer)) ? (VAddr) mem->fAddr : 0;
 		gCurrentTask->fRegister[kReturnParm3] = (ConvertIdToObj(kSharedMemMsgType, inId, &msg) == noErr)? msg->fRefCon : 0;	// refCon
 	}
 	XENDTRY;
@@ -152,11 +156,12 @@ SMemCopyToKernelGlue(ObjectId inId, void * inBuffer, size_t inSize, ULong inOffs
 
 		if (inSize != 0)
 		{
+			CountSMemCopy(sendersMsg != NULL ? sendersMsg->fType : (ULong)kMsgType_MatchAll, inSize, false);
 			if (sendersMsg != NULL)
 				sendersMsg->fCopyTask = *gCurrentTask;
 			gCurrentTask->fCopySavedMemMsgId = inSendersMsgId;
 			gCurrentTask->fCopySavedPC = gCurrentTask->fRegister[kcThePC];
-#if defined(__i386__) || defined(__x86_64__)
+#if !defined(hasPortableSWI) && (defined(__i386__) || defined(__x86_64__))
 			gCurrentTask->fCopySavedesi = gCurrentTask->fRegister[kcesi];
 			gCurrentTask->fCopySavededi = gCurrentTask->fRegister[kcedi];
 #endif
@@ -203,10 +208,22 @@ SMemCopyFromKernelGlue(ObjectId inId, void * outBuffer, size_t inSize, ULong inO
 	{
 		CSharedMemMsg *	sendersMsg = NULL;
 		CSharedMem *		mem;
+		VAddr					addr;
+		size_t				curSize;
 
 		gCurrentTask->fRegister[kCopySize] = 0;
 
 		XFAIL(err = ConvertMemOrMsgIdToObj(inId, &mem))
+		addr = (VAddr) mem->fAddr;
+		curSize = mem->fCurSize;
+		if (FLAGTEST(mem->fPerm, kSMemSharedBuffer))
+		{
+			// a plain receive of a CSharedBuffer: copy its content, not the reference to it
+			SharedBufferRef *	ref = (SharedBufferRef *)mem->fAddr;
+			XFAILIF(ref == NULL || ref->check != ~(uintptr_t)ref->buf, err = kOSErrBadParameters;)
+			addr = (VAddr) ref->buf->data();
+			curSize = ref->size;
+		}
 		if (inSendersMsgId != kNoId)
 		{
 			XFAIL(err = ConvertIdToObj(kSharedMemMsgType, inSendersMsgId, &sendersMsg))
@@ -215,23 +232,24 @@ SMemCopyFromKernelGlue(ObjectId inId, void * outBuffer, size_t inSize, ULong inO
 			XFAILIF(sendersMsg->fSignature != inSendersSignature, err = kOSErrBadSignature;)
 		}
 		if (inSize != 0
-		&&  inOffset < mem->fCurSize)
+		&&  inOffset < curSize)
 		{
-			if (inOffset + inSize > mem->fCurSize)
-				inSize = mem->fCurSize - inOffset;
+			if (inOffset + inSize > curSize)
+				inSize = curSize - inOffset;
 			if (inSize != 0)
 			{
+				CountSMemCopy(sendersMsg != NULL ? sendersMsg->fType : (ULong)kMsgType_MatchAll, inSize, false);
 				if (sendersMsg != NULL)
 					sendersMsg->fCopyTask = *gCurrentTask;
 				gCurrentTask->fCopySavedMemMsgId = inSendersMsgId;
 				gCurrentTask->fCopySavedPC = gCurrentTask->fRegister[kcThePC];
-#if defined(__i386__) || defined(__x86_64__)
+#if !defined(hasPortableSWI) && (defined(__i386__) || defined(__x86_64__))
 				gCurrentTask->fCopySavedesi = gCurrentTask->fRegister[kcesi];
 				gCurrentTask->fCopySavededi = gCurrentTask->fRegister[kcedi];
 #endif
 				gCurrentTask->fCopiedSize = inSize;
 				gCurrentTask->fRegister[kCopySize] = inSize;
-				gCurrentTask->fRegister[kCopyFromBuf] = (VAddr) mem->fAddr + inOffset;
+				gCurrentTask->fRegister[kCopyFromBuf] = addr + inOffset;
 				gCurrentTask->fRegister[kCopyToBuf] = (VAddr) outBuffer;
 				gCurrentTask->fSMemEnvironment = mem->fEnvironment;
 				gCopyTasks->add(gCurrentTask);
@@ -321,7 +339,7 @@ SMemMsgGetSenderTaskIdKernelGlue(ObjectId inId)
 --------------------------------------------------------------------------------*/
 
 NewtonErr
-SMemMsgSetUserRefConKernelGlue(ObjectId inId, ULong inRefCon)
+SMemMsgSetUserRefConKernelGlue(ObjectId inId, OpaqueRef inRefCon)
 {
 	NewtonErr err;
 	XTRY
@@ -471,7 +489,7 @@ LowLevelCopyDoneFromKernelGlue(NewtonErr inErr, CTask * inTask, VAddr inReturn)
 	inTask->fSMemEnvironment = NULL;
 	inTask->fRegister[kReturnParm1] = inTask->fCopiedSize;
 	inTask->fRegister[kcThePC] = inTask->fCopySavedPC;
-#if defined(__i386__) || defined(__x86_64__)
+#if !defined(hasPortableSWI) && (defined(__i386__) || defined(__x86_64__))
 	gCurrentTask->fRegister[kcesi] = gCurrentTask->fCopySavedesi;
 	gCurrentTask->fRegister[kcedi] = gCurrentTask->fCopySavededi;
 #endif
@@ -485,6 +503,112 @@ LowLevelCopyDoneFromKernelGlue(NewtonErr inErr, CTask * inTask, VAddr inReturn)
 
 #pragma mark -
 
+/*--------------------------------------------------------------------------------
+	C o p y   S t a t i s t i c s
+--------------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------------
+	Count a copy between tasks.
+	Tasks can count copies of their own as well as the kernel, so slots are
+	claimed and counters bumped atomically.
+	Args:		inMsgType		type of message copied for
+				inSize			number of bytes
+				inHandedOff		the bytes were passed by reference, not copied
+	Return:	--
+--------------------------------------------------------------------------------*/
+
+void
+CountSMemCopy(ULong inMsgType, size_t inSize, bool inHandedOff)
+{
+	if (inMsgType != kMsgType_MatchAll)
+	{
+		inMsgType &= kMsgType_ReservedMask;
+		if (inMsgType == 0)
+			inMsgType = kMsgType_NoMsgTypeSet;
+	}
+
+	// types are often single bits, so hash on the top bits of the product
+	ArrayIndex	index = (uint32_t)(inMsgType * 2654435761U) >> (32 - 6);
+	for (ArrayIndex i = 0; i < kNumOfSMemCopyTypes; ++i, index = (index + 1) & (kNumOfSMemCopyTypes - 1))
+	{
+		SMemCopyStatistics *	stats = &gSMemCopyStats[index];
+		ULong	type = __atomic_load_n(&stats->msgType, __ATOMIC_RELAXED);
+		// claim a free slot; if someone else beats us to it, type is theirs
+		if (type == 0
+		&&  __atomic_compare_exchange_n(&stats->msgType, &type, inMsgType, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			type = inMsgType;
+		if (type == inMsgType)
+		{
+			if (inHandedOff)
+			{
+				__atomic_fetch_add(&stats->handOffs, 1, __ATOMIC_RELAXED);
+				__atomic_fetch_add(&stats->bytesHandedOff, inSize, __ATOMIC_RELAXED);
+			}
+			else
+			{
+				__atomic_fetch_add(&stats->copies, 1, __ATOMIC_RELAXED);
+				__atomic_fetch_add(&stats->bytesCopied, inSize, __ATOMIC_RELAXED);
+			}
+			return;
+		}
+	}
+}
+
+
+/*--------------------------------------------------------------------------------
+	Return the copy statistics.
+	Args:		outStats			array to fill in
+				inMaxCount		number of entries it has room for
+	Return:	number of entries filled in
+--------------------------------------------------------------------------------*/
+
+ArrayIndex
+GetSMemCopyStatistics(SMemCopyStatistics * outStats, ArrayIndex inMaxCount)
+{
+	ArrayIndex	count = 0;
+	for (ArrayIndex i = 0; i < kNumOfSMemCopyTypes && count < inMaxCount; ++i)
+	{
+		SMemCopyStatistics *	stats = &gSMemCopyStats[i];
+		ULong	type = __atomic_load_n(&stats->msgType, __ATOMIC_RELAXED);
+		if (type != 0)
+		{
+			// the counters go on changing, so read each one atomically
+			SMemCopyStatistics *	outStat = &outStats[count++];
+			outStat->msgType = type;
+			outStat->copies = __atomic_load_n(&stats->copies, __ATOMIC_RELAXED);
+			outStat->bytesCopied = __atomic_load_n(&stats->bytesCopied, __ATOMIC_RELAXED);
+			outStat->handOffs = __atomic_load_n(&stats->handOffs, __ATOMIC_RELAXED);
+			outStat->bytesHandedOff = __atomic_load_n(&stats->bytesHandedOff, __ATOMIC_RELAXED);
+		}
+	}
+	return count;
+}
+
+
+/*--------------------------------------------------------------------------------
+	Start counting again.
+	Other tasks may be counting meanwhile, so the counters are cleared
+	atomically; slots keep the types that claimed them, so a count can never
+	land in a slot that is being freed.
+	Args:		--
+	Return:	--
+--------------------------------------------------------------------------------*/
+
+void
+ResetSMemCopyStatistics(void)
+{
+	for (ArrayIndex i = 0; i < kNumOfSMemCopyTypes; ++i)
+	{
+		SMemCopyStatistics *	stats = &gSMemCopyStats[i];
+		__atomic_store_n(&stats->copies, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&stats->bytesCopied, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&stats->handOffs, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&stats->bytesHandedOff, 0, __ATOMIC_RELAXED);
+	}
+}
+
+#pragma mark -
+
 /*--------------------------------------------------------------------------------
 	C S h a r e d M e m
 	
@@ -515,7 +639,7 @@ CSharedMem::init(CEnvironment * inEnvironment)
 --------------------------------------------------------------------------------*/
 
 CSharedMemMsg::CSharedMemMsg(void)
-	: f8C(offsetof(CSharedMemMsg, f80))
+	: f8C(offsetof(CSharedMemMsg, f80)), fTimerIndex(kIndexNotFound)
 { }
 
 
@@ -616,6 +740,10 @@ CSharedMemMsg::completeReceiver(CSharedMemMsg * inMsg, NewtonErr inErr)
 			fSendersSig = inMsg->fSignature = inMsg->fSequenceNo;	// sync signatures
 			if (++inMsg->fSequenceNo == 0)			// bump senders sequence number (uid)
 				inMsg->fSequenceNo = 1;
+			if (FLAGTEST(inMsg->fPerm, kSMemSharedBuffer))
+				// the sender must hold its CSharedBuffer until the receiver has taken it,
+				// so it can no longer time out
+				gTimerEngine->remove(inMsg);
 		}
 	}
 	return completeMsg(isCollector, kMsgType_CollectedReceiver, inErr);
@@ -829,7 +957,8 @@ PortDeferredSendNotify(void)
 	{
 		if (FLAGTEST(msg->fFlags, 0x0020))
 		{
-			if (!gTimerEngine->queueDelay(msg))
+			// if it cant be delayed, send it now
+			if (gTimerEngine->reserve() != noErr || !gTimerEngine->queueDelay(msg, true))
 				NotifySend(msg);
 		}
 		else
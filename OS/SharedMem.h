@@ -64,7 +64,7 @@ public:
 	ULong					fFlags;			// +3C
 	ObjectId				fSendingPort;	// +40	port sending this message
 	NewtonErr			fStatus;			// +44
-	int					fRefCon;			// +48
+	OpaqueRef			fRefCon;			// +48
 	ObjectId				fReplyMem;		// +4C
 	ULong					fType;			// +50	message type (sender)
 	ULong					fFilter;			// +54	message types accepted (receiver)
@@ -82,7 +82,10 @@ public:
 	CDoubleQContainer	f8C;
 	void *				fCallbackData;	// +A0
 	TimeoutProcPtr		fCallback;		// +A4	function to call on timeout
-// size +A8
+	ArrayIndex			fTimerIndex;	// +A8	slot in gTimerEngine heap, kIndexNotFound if not timed
+	ULong					fPortKey;		// +AC	type or filter it is queued by at a port
+	ULong					fPortStamp;		// +B0	order in which it was queued at a port
+// size +B4
 };
 
 // non-error fStatus value
@@ -93,4 +96,28 @@ public:
 extern "C" void		DoDeferrals(void);
 
 
+/*--------------------------------------------------------------------------------
+	C o p y   S t a t i s t i c s
+	Bytes copied between tasks are counted by the type of message they were
+	copied for: copies not made for a message count as kMsgType_MatchAll, and
+	messages sent with no type as kMsgType_NoMsgTypeSet. CSharedBuffers
+	passed without being copied are counted separately.
+--------------------------------------------------------------------------------*/
+
+#define kNumOfSMemCopyTypes	64		// 2^6; any more types go uncounted
+
+struct SMemCopyStatistics
+{
+	ULong			msgType;
+	ULong			copies;
+	uint64_t		bytesCopied;
+	ULong			handOffs;			// CSharedBuffers passed by reference
+	uint64_t		bytesHandedOff;
+};
+
+extern void			CountSMemCopy(ULong inMsgType, size_t inSize, bool inHandedOff);
+extern ArrayIndex	GetSMemCopyStatistics(SMemCopyStatistics * outStats, ArrayIndex inMaxCount);
+extern void			ResetSMemCopyStatistics(void);
+
+
 #endif	/* __SHAREDMEM_H */
@@ -16,8 +16,9 @@
 typedef void (*TaskProcPtr)(void*, size_t, ObjectId);			// taskInstance, taskDataSize, taskId (ie CUTaskWorld::taskEntry)
 typedef NewtonErr (*MonitorProcPtr)(int, void*);		// monitorInstance, selector, msg
 
-#if defined(correct)
-/* ARM ABI */
+#if defined(correct) || defined(hasPortableSWI)
+/* ARM ABI
+	The portable SWI handler keeps task registers in this layout too. */
 enum TaskRegisters
 {
 	// result
@@ -188,6 +189,7 @@ enum MiscItems
 	kSMemReadOnly					= 0x01,			// allow only read operations (if not set, read/write)
 	kSMemReadWrite					= 0x00,			// allow read/write operations
 	kSMemNoSizeChangeOnCopyTo	= 0x02,			// don't allow size to change when copyto takes place (use initial size)
+	kSMemSharedBuffer				= 0x04,			// buffer holds a SharedBufferRef, not the content (not in the original)
 
 	// message type stuff
 	kMsgType_MatchAll				= 0xFFFFFFFF,	// match any message on receive
@@ -91,6 +91,47 @@ CSendSystemEvent::sendSystemEvent(void * inMessage, size_t inMessageSize)
 }
 
 
+/*--------------------------------------------------------------------------------
+	Send a system event whose message is a shared buffer.
+	The name server passes our message on to each task registered for the
+	event; a task that receives it as a shared buffer takes a reference to
+	ours, and any other gets a copy of its content, so however many are
+	registered the content is not copied for those that can share it.
+	The caller must not write to the buffer again without
+	CSharedBuffer::prepareToWrite.
+	Args:		inMessage		the buffer
+				inMessageSize	number of bytes of its content to send
+	Return:	error code
+--------------------------------------------------------------------------------*/
+
+NewtonErr
+CSendSystemEvent::sendSystemEvent(CSharedBuffer * inMessage, size_t inMessageSize)
+{
+	NewtonErr err;
+	XTRY
+	{
+		// we wait for every registered task to have had it, so the reference can live on our stack
+		SharedBufferRef	ref;
+		ref.signature = kSharedBufferSignature;
+		ref.size = (inMessageSize < inMessage->size()) ? inMessageSize : inMessage->size();
+		ref.buf = inMessage;
+		ref.check = ~(uintptr_t)inMessage;
+		XFAIL(err = fMsgToSend.setBuffer(&ref, sizeof(ref), kSMemReadOnly + kSMemSharedBuffer))
+
+		size_t replySize;
+		CSysEventRequest request;
+		request.fCommand = kSendSystemEvent;
+		request.fTheEvent = fEvent;
+		request.fSysEventObjId = fMsgToSend;
+		err = fSystemPort.sendRPC(&replySize, &request, sizeof(request), NULL, 0, kNoTimeout, 1);
+		// dont leave the message pointing at our stack
+		fMsgToSend.setBuffer(NULL, 0);
+	}
+	XENDTRY;
+	return err;
+}
+
+
 NewtonErr
 CSendSystemEvent::sendSystemEvent(CUAsyncMessage * inAsyncMessage, void * inMessage, size_t inMessageSize, void * outReply, ULong outReplySize)
 {
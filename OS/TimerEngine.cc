@@ -0,0 +1,406 @@
+/*
+	File:		TimerEngine.cc
+
+	Contains:	Timer engine implementation.
+					The heap of pending timer messages, kept apart from the rest of
+					Timers.cc so that it can be built and tested on its own.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "Timers.h"
+#include "KernelGlobals.h"
+#include "KernelTrace.h"
+#include "OSErrors.h"
+
+extern CTime	GetClock(void);
+extern bool		SetAlarmAtomic(CTime & inTime);
+extern void		ClearAlarmAtomic(void);
+
+#if !defined(forFramework)
+
+/*------------------------------------------------------------------------------
+	C T i m e r E n g i n e
+------------------------------------------------------------------------------*/
+
+#define kTimerHeapArity			4
+#define kTimerHeapInitialSize	64
+
+CTimerEngine::CTimerEngine()
+	:	fHeap(NULL), fCount(0), fAllocated(0), fSequence(0), fReserved(0)
+{ }
+
+CTimerEngine::~CTimerEngine()
+{
+	if (fHeap)
+		FreePtr((Ptr)fHeap);
+}
+
+void
+CTimerEngine::init(void)
+{
+	// preallocate the heap so that common timer loads never need to grow it
+	if (reserve() == noErr)
+		unreserve();
+}
+
+void
+CTimerEngine::start(void)
+{ /* this really does nothing */ }
+
+
+/* -----------------------------------------------------------------------------
+	Fire the callbacks of all timers that have expired, then set the timer
+	interrupt for the next one.
+	Args:		--
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CTimerEngine::alarm(void)
+{
+	EnterAtomic();
+
+	CSharedMemMsg * msg = peek();
+	if (msg == NULL)
+	{
+		// nothing in the queue, disable the timer interrupt
+		ClearAlarmAtomic();
+	}
+
+	else
+	{
+		do
+		{
+			if (msg->fExpiryTime <= GetClock())
+			{
+				// message has expired, remove alarm from queue
+				removeAt(0);
+				if (MASKTEST(msg->fFlags, kSMemMsgFlags_TimerMask) == kSMemMsgFlags_Timer)
+					msg->fFlags = MASKCLEAR(msg->fFlags, kSMemMsgFlags_TimerMask);
+				// fire the callback
+				TraceInterruptEvent(kTraceTimerAlarm, *msg);
+				msg->fCallback(msg->fCallbackData);
+			}
+		} while ((msg = peek()) != NULL && !SetAlarmAtomic(msg->fExpiryTime));	// if alarms in the queue, reset timer interrupt
+	}
+
+	ExitAtomic();
+}
+
+
+/* -----------------------------------------------------------------------------
+	Queue a message to time out.
+	The queueTimer, queueTimeout and queueDelay calls each take a message and,
+	if inIsReserved, the slot the caller reserved for it -- which is released
+	whether or not the message is queued.
+	Args:		inMsg				message
+				inIsReserved	caller has reserve()d a slot for it
+	Return:	true => message was queued
+----------------------------------------------------------------------------- */
+
+bool
+CTimerEngine::queueTimer(CSharedMemMsg * inMsg, Timeout inTimeout, void * inData, TimeoutProcPtr inProc, bool inIsReserved)
+{
+	bool	isQueued;
+
+	if (inMsg->fTimerIndex != kIndexNotFound
+	||  MASKTEST(inMsg->fFlags, kSMemMsgFlags_TimerMask) != 0)
+	{
+		if (inIsReserved)
+			unreserve();
+		return false;	// message is already timed
+	}
+	
+	inMsg->fCallbackData = inData;
+	inMsg->fCallback = inProc;
+	inMsg->fExpiryTime = GetClock() + CTime(inTimeout);
+
+	EnterAtomic();
+	FLAGSET(inMsg->fFlags, kSMemMsgFlags_Timer);
+	isQueued = queue(inMsg, inIsReserved);
+	if (!isQueued)
+		inMsg->fFlags = MASKCLEAR(inMsg->fFlags, kSMemMsgFlags_TimerMask);
+	ExitAtomic();
+
+	return isQueued;
+}
+
+
+bool
+CTimerEngine::queueTimeout(CSharedMemMsg * inMsg, bool inIsReserved)
+{
+	bool	isQueued;
+
+	if (inMsg->fTimeout == kTimeOutImmediate)
+	{
+		if (inIsReserved)
+			unreserve();
+		return false;
+	}
+	
+	inMsg->fCallbackData = inMsg;
+	inMsg->fCallback = (TimeoutProcPtr) QueueNotify;
+	inMsg->fExpiryTime = GetClock() + CTime(inMsg->fTimeout);
+
+	EnterAtomic();
+	FLAGSET(inMsg->fFlags, kSMemMsgFlags_Timeout);
+	isQueued = queue(inMsg, inIsReserved);
+	if (!isQueued)
+		inMsg->fFlags = MASKCLEAR(inMsg->fFlags, kSMemMsgFlags_TimerMask);
+	ExitAtomic();
+
+	return isQueued;
+}
+
+
+bool
+CTimerEngine::queueDelay(CSharedMemMsg * inMsg, bool inIsReserved)
+{
+	bool	isQueued;
+
+	if (inMsg->fExpiryTime == CTime(0))
+	{
+		if (inIsReserved)
+			unreserve();
+		return false;
+	}
+
+	inMsg->fCallbackData = inMsg;
+	inMsg->fCallback = (TimeoutProcPtr) QueueNotify;
+
+	EnterAtomic();
+	FLAGSET(inMsg->fFlags, kSMemMsgFlags_Delay);
+	isQueued = queue(inMsg, inIsReserved);
+	if (!isQueued)
+		inMsg->fFlags = MASKCLEAR(inMsg->fFlags, kSMemMsgFlags_TimerMask);
+	ExitAtomic();
+
+	return isQueued;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Add a message to the timer heap.
+	If it becomes the next timer to expire, the timer interrupt is reset.
+	The heap cannot grow here, since were atomic; callers that can allocate
+	should reserve() a slot first, and are then sure of it. Callers that
+	cant may only use slots nobody has reserved.
+	Args:		inMsg				message; its fExpiryTime is already set
+				inIsReserved	caller has reserve()d a slot for it
+	Return:	true => message was queued
+				false => message has already expired (or, if no slot was
+							reserved, the heap is full) and was not queued
+----------------------------------------------------------------------------- */
+
+bool
+CTimerEngine::queue(CSharedMemMsg * inMsg, bool inIsReserved)
+{
+	bool	isSet = true;
+
+	EnterAtomic();
+	if (inIsReserved)
+		fReserved--;
+	if (fCount + fReserved >= fAllocated)
+		isSet = false;
+
+	else
+	{
+		TimerSlot	slot;
+		slot.fExpiryTime = inMsg->fExpiryTime;
+		slot.fSequence = fSequence++;
+		slot.fMsg = inMsg;
+		siftUp(fCount++, slot);
+
+		if (inMsg == peek())
+		{
+			// message will expire before everything else in the queue
+			if ((isSet = SetAlarmAtomic(inMsg->fExpiryTime)) == false)	// intentional assignment
+			{
+				// no alarm set, take it out again and fire anything else that has expired
+				removeAt(0);
+				alarm();
+			}
+		}
+	}
+	ExitAtomic();
+
+	return isSet;
+}
+
+
+void
+CTimerEngine::remove(CSharedMemMsg * inMsg)
+{
+	EnterAtomic();
+	if (gTimerDeferred->removeFromQueue(inMsg) == false)
+	{
+		// message wasnt in the gTimerDeferred queue
+		ArrayIndex index = inMsg->fTimerIndex;
+		if (index != kIndexNotFound)
+		{
+			// message is in our queue, remove it
+			removeAt(index);
+			if (index == 0)
+			{
+				// message was first in our queue
+				if (fCount > 0)
+					// more in the queue, fire an alarm to check them now
+					alarm();
+				else
+					// queue is now empty, no alarm required
+					ClearAlarmAtomic();
+			}
+		}
+	}
+	inMsg->fFlags = MASKCLEAR(inMsg->fFlags, kSMemMsgFlags_TimerMask);
+	ExitAtomic();
+}
+
+
+/* -----------------------------------------------------------------------------
+	Reserve a slot in the heap for the callers next queue call, growing the
+	heap if necessary. The slot is claimed within the same atomic section that
+	finds it free, so nothing queued in the meantime can take it.
+	Must NOT be called within EnterAtomic: the new heap is allocated outside
+	the atomic section and only swapped in within it.
+	Args:		--
+	Return:	error code
+----------------------------------------------------------------------------- */
+
+NewtonErr
+CTimerEngine::reserve(void)
+{
+	for ( ; ; )
+	{
+		EnterAtomic();
+		if (fCount + fReserved < fAllocated)
+		{
+			fReserved++;
+			ExitAtomic();
+			return noErr;
+		}
+		ArrayIndex	newSize = fAllocated ? fAllocated * 2 : kTimerHeapInitialSize;
+		ExitAtomic();
+
+		TimerSlot *	newHeap = (TimerSlot *)NewPtr(newSize * sizeof(TimerSlot));
+		if (newHeap == NULL)
+			return kOSErrNoMemory;
+
+		EnterAtomic();
+		if (newSize > fAllocated)
+		{
+			// still needed -- swap in the new heap
+			for (ArrayIndex i = 0; i < fCount; ++i)
+				newHeap[i] = fHeap[i];
+			TimerSlot * oldHeap = fHeap;
+			fHeap = newHeap;
+			fAllocated = newSize;
+			newHeap = oldHeap;
+		}
+		ExitAtomic();
+
+		// free whichever heap were not using
+		if (newHeap != NULL)
+			FreePtr((Ptr)newHeap);
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Give back a reserved slot that wont be queued.
+	Args:		--
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CTimerEngine::unreserve(void)
+{
+	EnterAtomic();
+	fReserved--;
+	ExitAtomic();
+}
+
+
+/* -----------------------------------------------------------------------------
+	Heap maintenance.
+	All of these are called within EnterAtomic.
+----------------------------------------------------------------------------- */
+
+
+bool
+CTimerEngine::isEarlier(const TimerSlot & inSlot1, const TimerSlot & inSlot2) const
+{
+	if (inSlot1.fExpiryTime < inSlot2.fExpiryTime)
+		return true;
+	if (inSlot1.fExpiryTime == inSlot2.fExpiryTime)
+		// same expiry time -- first come, first served; allow for sequence wrap
+		return (int32_t)(inSlot1.fSequence - inSlot2.fSequence) < 0;
+	return false;
+}
+
+
+void
+CTimerEngine::place(ArrayIndex index, const TimerSlot & inSlot)
+{
+	fHeap[index] = inSlot;
+	inSlot.fMsg->fTimerIndex = index;
+}
+
+
+void
+CTimerEngine::siftUp(ArrayIndex index, TimerSlot inSlot)
+{
+	while (index > 0)
+	{
+		ArrayIndex parent = (index - 1) / kTimerHeapArity;
+		if (!isEarlier(inSlot, fHeap[parent]))
+			break;
+		place(index, fHeap[parent]);
+		index = parent;
+	}
+	place(index, inSlot);
+}
+
+
+void
+CTimerEngine::siftDown(ArrayIndex index, TimerSlot inSlot)
+{
+	for ( ; ; )
+	{
+		ArrayIndex child = index * kTimerHeapArity + 1;
+		if (child >= fCount)
+			break;
+		// find the earliest of up to kTimerHeapArity children
+		ArrayIndex earliest = child;
+		ArrayIndex lastChild = child + kTimerHeapArity;
+		if (lastChild > fCount)
+			lastChild = fCount;
+		for (++child; child < lastChild; ++child)
+			if (isEarlier(fHeap[child], fHeap[earliest]))
+				earliest = child;
+		if (!isEarlier(fHeap[earliest], inSlot))
+			break;
+		place(index, fHeap[earliest]);
+		index = earliest;
+	}
+	place(index, inSlot);
+}
+
+
+void
+CTimerEngine::removeAt(ArrayIndex index)
+{
+	fHeap[index].fMsg->fTimerIndex = kIndexNotFound;
+	if (--fCount > index)
+	{
+		// fill the hole with the last slot and restore heap order
+		TimerSlot last = fHeap[fCount];
+		if (index > 0 && isEarlier(last, fHeap[(index - 1) / kTimerHeapArity]))
+			siftUp(index, last);
+		else
+			siftDown(index, last);
+	}
+}
+
+#endif	/* !defined(forFramework) */
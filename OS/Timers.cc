@@ -13,6 +13,7 @@
 
 #include "Objects.h"
 #include "KernelGlobals.h"
+#include "KernelTrace.h"
 #include "NewtonTime.h"
 #include "Interrupt.h"
 #include "LongTime.h"	// CURealTimeAlarm
@@ -23,6 +24,14 @@
 
 extern void SetPlatformAlarm(int64_t inDelta);
 
+#if !defined(correct)
+// the virtual clock, for deterministic replay -- not in the original
+extern bool		IsClockVirtual(void);
+extern CTime	GetVirtualClock(void);
+extern void		SetVirtualAlarm(CTime inTime);
+extern void		VirtualAlarmTaken(void);
+#endif
+
 
 #if defined(forFramework)
 // we need a stub for the scheduler
@@ -74,6 +83,10 @@ TimerInterruptHandler(void * intObj)
 {
 	gTimerInterruptCount++;
 	gTimerEngine->alarm();
+#if !defined(correct)
+	if (IsClockVirtual())
+		VirtualAlarmTaken();
+#endif
 }
 
 #if defined(correct)
@@ -144,7 +157,8 @@ PrimRegisterDelayedFunction(ObjectId inMsgId, Timeout inTimeout, void * inData,
 	{
 		CSharedMemMsg * msg;
 		XFAILNOT(msg = (CSharedMemMsg *)IdToObj(kSharedMemMsgType, inMsgId), err = kOSErrBadObjectId;)	// original says kOSErrBadObject
-		XFAILNOT(gTimerEngine->queueTimer(msg, inTimeout, inData, inProc), err = kOSErrTimerExpired;)
+		XFAIL(err = gTimerEngine->reserve())
+		XFAILNOT(gTimerEngine->queueTimer(msg, inTimeout, inData, inProc, true), err = kOSErrTimerExpired;)
 	}
 	XENDTRY;
 	return err;
@@ -193,6 +207,8 @@ DisableAlarm1(void)
 	g0F184000 &= ~0x0020;
 	gIntMaskShadowReg &= ~0x0020;
 	g0F183800 = 0x0020;
+#else
+	SetVirtualAlarm(CTime(0));
 #endif
 }
 
@@ -237,7 +253,13 @@ SetAlarm(CTime & inTime)
 	{
 		CTime delta = inTime - now;
 		// if alarm is more than 1s away, set up interrupt
-		if (delta > CTime(1*kMicroseconds))
+		if (IsClockVirtual())
+		{
+			// AdvanceVirtualClock() will interrupt when the time comes
+			SetVirtualAlarm(inTime);
+			isSet = true;
+		}
+		else if (delta > CTime(1*kMicroseconds))
 		{
 //printf(" ->SetPlatformAlarm(%ld)\n", (long)delta);
 			SetPlatformAlarm(delta);
@@ -282,204 +304,6 @@ ClearAlarmAtomic(void)
 }
 
 
-#pragma mark -
-
-/*------------------------------------------------------------------------------
-	C T i m e r E n g i n e
-------------------------------------------------------------------------------*/
-
-CTimerEngine::CTimerEngine()
-	: CDoubleQContainer(offsetof(CSharedMemMsg, fTimerQItem))
-{ }
-
-void
-CTimerEngine::init(void)
-{ /* this really does nothing */ }
-
-void
-CTimerEngine::start(void)
-{ /* this really does nothing */ }
-
-
-void
-CTimerEngine::alarm(void)
-{
-	EnterAtomic();
-
-	CSharedMemMsg * msg = (CSharedMemMsg *)peek();
-	if (msg == NULL)
-	{
-		// nothing in the queue, disable the timer interrupt
-		ClearAlarmAtomic();
-//printf("CTimerEngine::alarm() empty queue\n");
-	}
-
-	else
-	{
-		do
-		{
-			if (msg->fExpiryTime <= GetClock())
-			{
-				// message has expired, remove alarm from queue
-				CDoubleQContainer::remove();
-				if (MASKTEST(msg->fFlags, kSMemMsgFlags_TimerMask) == kSMemMsgFlags_Timer)
-					msg->fFlags = MASKCLEAR(msg->fFlags, kSMemMsgFlags_TimerMask);
-				// fire the callback
-//printf("CTimerEngine::alarm() callback sender=%d notify=%d\n", msg->fSendingPort,msg->fNotify);
-				msg->fCallback(msg->fCallbackData);
-			}
-		} while ((msg = (CSharedMemMsg *)peek()) != NULL && !SetAlarmAtomic(msg->fExpiryTime));	// if alarms in the queue, reset timer interrupt
-	}
-
-	ExitAtomic();
-}
-
-
-bool
-CTimerEngine::queueTimer(CSharedMemMsg * inMsg, Timeout inTimeout, void * inData, TimeoutProcPtr inProc)
-{
-	bool	isQueued;
-
-	checkBeforeAdd(inMsg);
-	if (MASKTEST(inMsg->fFlags, kSMemMsgFlags_TimerMask) != 0)
-		return false;	// message is already timed
-	
-	inMsg->fCallbackData = inData;
-	inMsg->fCallback = inProc;
-	inMsg->fExpiryTime = GetClock() + CTime(inTimeout);
-
-	EnterAtomic();
-	FLAGSET(inMsg->fFlags, kSMemMsgFlags_Timer);
-	isQueued = queue(inMsg);
-	if (!isQueued)
-		inMsg->fFlags = MASKCLEAR(inMsg->fFlags, kSMemMsgFlags_TimerMask);
-	ExitAtomic();
-
-	return isQueued;
-}
-
-
-bool
-CTimerEngine::queueTimeout(CSharedMemMsg * inMsg)
-{
-	bool	isQueued;
-
-	if (inMsg->fTimeout == kTimeOutImmediate)
-		return false;
-	
-	inMsg->fCallbackData = inMsg;
-	inMsg->fCallback = (TimeoutProcPtr) QueueNotify;
-	inMsg->fExpiryTime = GetClock() + CTime(inMsg->fTimeout);
-
-	EnterAtomic();
-	FLAGSET(inMsg->fFlags, kSMemMsgFlags_Timeout);
-	isQueued = queue(inMsg);
-	if (!isQueued)
-		inMsg->fFlags = MASKCLEAR(inMsg->fFlags, kSMemMsgFlags_TimerMask);
-	ExitAtomic();
-
-	return isQueued;
-}
-
-
-bool
-CTimerEngine::queueDelay(CSharedMemMsg * inMsg)
-{
-	bool	isQueued;
-
-	if (inMsg->fExpiryTime == CTime(0))
-		return 0;
-
-	inMsg->fCallbackData = inMsg;
-	inMsg->fCallback = (TimeoutProcPtr) QueueNotify;
-
-	EnterAtomic();
-	FLAGSET(inMsg->fFlags, kSMemMsgFlags_Delay);
-	isQueued = queue(inMsg);
-	if (!isQueued)
-		inMsg->fFlags = MASKCLEAR(inMsg->fFlags, kSMemMsgFlags_TimerMask);
-	ExitAtomic();
-
-	return isQueued;
-}
-
-
-bool
-CTimerEngine::queue(CSharedMemMsg * inMsg)
-{
-	bool	isSet = true;
-	CSharedMemMsg *	msg;
-
-	EnterAtomic();
-	if ((msg = (CSharedMemMsg *)peek()) != NULL)
-	{
-		// theres something already in the queue -- find where to place the new message
-		for ( ; msg != NULL; msg = (CSharedMemMsg *)getNext(msg))
-		{
-			if (inMsg->fExpiryTime < msg->fExpiryTime)
-			{
-				// message will expire before this message in queue
-//printf("CTimerEngine::queue() %d -> %d\n", inMsg->fSendingPort,inMsg->fNotify);
-				if (msg == peek())
-				{
-					if ((isSet = SetAlarmAtomic(inMsg->fExpiryTime)))	// intentional assignment
-						addToFront(inMsg);
-					else
-						alarm();
-				}
-				else
-				{
-					addBefore(msg, inMsg);
-				}
-				break;
-			}
-		}
-		if (msg == NULL)
-			add(inMsg);
-	}
-	else
-	{
-		// queue is empty
-//printf("CTimerEngine::queue() empty sender=%d notify=%d\n", inMsg->fSendingPort,inMsg->fNotify);
-		if ((isSet = SetAlarmAtomic(inMsg->fExpiryTime)))	// intentional assignment
-			// alarm was set OK, add message to the queue
-			addToFront(inMsg);
-		else
-			// no alarm set, better fire it now
-			alarm();
-	}
-	ExitAtomic();
-
-	return isSet;
-}
-
-
-void
-CTimerEngine::remove(CSharedMemMsg * inMsg)
-{
-	EnterAtomic();
-	if (gTimerDeferred->removeFromQueue(inMsg) == false)
-	{
-		// message wasnt in the gTimerDeferred queue
-		if (inMsg == peek())
-		{
-			// message is first in our queue, remove it
-			CDoubleQContainer::remove();
-			if (peek())
-				// more in the queue, fire an alarm to check them now
-				alarm();
-			else
-				// queue is now empty, no alarm required
-				ClearAlarmAtomic();
-		}
-		else
-			// message is in our queue, remove it
-			removeFromQueue(inMsg);
-	}
-	inMsg->fFlags = MASKCLEAR(inMsg->fFlags, kSMemMsgFlags_TimerMask);
-	ExitAtomic();
-}
-
 #pragma mark -
 
 /*------------------------------------------------------------------------------
@@ -1420,6 +1244,9 @@ GetClock(void)
 	return now;
 
 #else
+	if (IsClockVirtual())
+		return GetVirtualClock();
+
 	kern_return_t ret;
 	clock_serv_t theClock;
 	mach_timespec_t theTime;
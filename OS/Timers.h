@@ -14,23 +14,57 @@
 
 /*--------------------------------------------------------------------------------
 	C T i m e r E n g i n e
+	Pending timer messages are held in a 4-ary min-heap keyed on expiry time.
+	Each message remembers its slot in the heap (CSharedMemMsg::fTimerIndex)
+	so it can be cancelled in O(log n). Messages that expire at the same time
+	fire in the order in which they were queued.
 --------------------------------------------------------------------------------*/
 
-class CTimerEngine : public CDoubleQContainer
+struct TimerSlot
+{
+	CTime					fExpiryTime;	// +00	copy of the message's expiry time
+	ULong					fSequence;		// +08	queue order, to break ties
+	CSharedMemMsg *	fMsg;				// +0C
+};
+
+
+class CTimerEngine
 {
 public:
 				CTimerEngine();
+				~CTimerEngine();
 
 	void		init(void);
 	void		start(void);
 	void		alarm(void);
-	bool		queueTimer(CSharedMemMsg * inMsg, Timeout inTimeout, void * inData, TimeoutProcPtr inProc);
-	bool		queueTimeout(CSharedMemMsg * inMsg);
-	bool		queueDelay(CSharedMemMsg * inMsg);
-	bool		queue(CSharedMemMsg * inMsg);
+	bool		queueTimer(CSharedMemMsg * inMsg, Timeout inTimeout, void * inData, TimeoutProcPtr inProc, bool inIsReserved = false);
+	bool		queueTimeout(CSharedMemMsg * inMsg, bool inIsReserved = false);
+	bool		queueDelay(CSharedMemMsg * inMsg, bool inIsReserved = false);
+	bool		queue(CSharedMemMsg * inMsg, bool inIsReserved = false);
 	void		remove(CSharedMemMsg * inMsg);
+	NewtonErr	reserve(void);
+	void		unreserve(void);
+
+	CSharedMemMsg *	peek(void) const;
+	ArrayIndex			count(void) const;
+
+private:
+	bool		isEarlier(const TimerSlot & inSlot1, const TimerSlot & inSlot2) const;
+	void		place(ArrayIndex index, const TimerSlot & inSlot);
+	void		siftUp(ArrayIndex index, TimerSlot inSlot);
+	void		siftDown(ArrayIndex index, TimerSlot inSlot);
+	void		removeAt(ArrayIndex index);
+
+	TimerSlot *	fHeap;			// +00	heap of pending timers; fHeap[0] expires first
+	ArrayIndex	fCount;			// +04	number of pending timers
+	ArrayIndex	fAllocated;		// +08	number of slots allocated
+	ULong			fSequence;		// +0C	next queue order number
+	ArrayIndex	fReserved;		// +10	number of slots reserved but not yet queued
 };
 
+inline CSharedMemMsg *	CTimerEngine::peek(void) const  { return fCount > 0 ? fHeap[0].fMsg : NULL; }
+inline ArrayIndex			CTimerEngine::count(void) const  { return fCount; }
+
 
 /*----------------------------------------------------------------------
 	C R e a l T i m e C l o c k
@@ -58,7 +92,7 @@ public:
 	static NewtonErr	alarm(void);
 
 	static bool			checkAlarmsStaySleeping(void);
-	static bool			sleepingCheckFire(void)	{ checkAlarmsStaySleeping(); }
+	static bool			sleepingCheckFire(void)	{ return checkAlarmsStaySleeping(); }
 	static NewtonErr	interruptEntry(void*)	{ return alarm(); }
 	static void			cleanUp(void)				{ alarm(); }
 
@@ -8,6 +8,7 @@
 
 #include "UserPorts.h"
 #include "KernelObjects.h"
+#include "SharedMem.h"
 #include "OSErrors.h"
 
 extern CTime GetClock(void);
@@ -272,6 +273,122 @@ CUPort::receive(CUAsyncMessage * inAsync, Timeout inTimeout, ULong inMsgFilter,
 }
 
 
+/*------------------------------------------------------------------------------
+	Send a shared buffer without copying its content.
+	The receiver takes a reference to the buffer before this returns, so the
+	callers own reference is all it needs; but the caller must not write to
+	the buffer again without CSharedBuffer::prepareToWrite.
+	Once received, the message no longer times out.
+	Args:		inBuf						the buffer
+				inSize					number of bytes of its content to send
+				inTimeout				time after which to give up if not received
+				inMsgType				type of message
+				inUrgent					send ahead of non-urgent messages
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CUPort::send(CSharedBuffer * inBuf, size_t inSize, Timeout inTimeout, ULong inMsgType, bool inUrgent)
+{
+	NewtonErr err = noErr;
+	XTRY
+	{
+		SharedBufferRef	ref;
+		ref.signature = kSharedBufferSignature;
+		ref.size = (inSize < inBuf->size()) ? inSize : inBuf->size();
+		ref.buf = inBuf;
+		ref.check = ~(uintptr_t)inBuf;
+		inBuf->fMsgType = inMsgType;
+
+		XFAIL(err = SMemSetBufferSWI(kBuiltInSMemMsgId, &ref, sizeof(ref), kSMemReadOnly + kSMemSharedBuffer))
+		err = sendGoo(kBuiltInSMemMsgId, 0, kPortSend_BufferAlreadySet, sizeof(ref), inMsgType, 0, inUrgent, inTimeout, NULL);
+		// dont leave the message pointing at our stack
+		SMemSetBufferSWI(kBuiltInSMemMsgId, NULL, 0, kSMemReadOnly);
+	}
+	XENDTRY;
+	return err;
+}
+
+
+/*------------------------------------------------------------------------------
+	Receive a message as a shared buffer.
+	A CSharedBuffer sent by reference is taken without copying; any other
+	message is copied into a new one, so either kind of sender can be served.
+	Args:		outBuf					the buffer; the caller must release it
+				outSize					number of bytes of its content that were sent
+				outMsgType				type of received message
+				inTimeout				time after which to give up if no message received
+				inMsgFilter				type of messages were interested in
+				onMsgAvail				only bother if message is already available
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CUPort::receive(CSharedBuffer ** outBuf, size_t * outSize, ULong * outMsgType, Timeout inTimeout, ULong inMsgFilter, bool onMsgAvail)
+{
+	NewtonErr err = noErr;
+	CSharedBuffer * buf = NULL;
+	size_t size = 0;
+	XTRY
+	{
+		ObjectId		senderMsgId;
+		ObjectId		replyMemId;
+		ULong			msgType = 0;
+		ULong			signature = 0;
+
+		ULong	flags = onMsgAvail ? kPortFlags_ReceiveOnMsgAvail : 0;
+		if (inTimeout != kNoTimeout)
+		{
+			flags |= kPortFlags_WantTimeout;
+			XFAIL(err = SMemMsgSetTimerParmsSWI(kBuiltInSMemMsgId, inTimeout, 0))
+		}
+
+		XFAIL(err = PortReceiveSWI((ObjectId)*this, kBuiltInSMemMsgId, inMsgFilter, flags, &senderMsgId, &replyMemId, &msgType, &signature))
+
+		if (((msgType & kMsgType_CollectedReceiver) == 0  ||  (err = SMemMsgCheckForDoneSWI(senderMsgId, 0, &senderMsgId, &replyMemId, &msgType, &signature)) == noErr)
+		&&  (msgType & kMsgType_CollectedSender) == 0)
+		{
+			SharedBufferRef *	ref;
+			if ((err = SMemGetSizeSWI(senderMsgId, &size, (void **)&ref, NULL)) == noErr)
+			{
+				if (ref != NULL && size == sizeof(SharedBufferRef)
+				&&  ref->signature == kSharedBufferSignature && ref->check == ~(uintptr_t)ref->buf)
+				{
+					// take our reference while the sender still holds its own
+					buf = ref->buf;
+					buf->retain();
+					size = ref->size;
+					CountSMemCopy(msgType, size, true);
+				}
+				else if ((buf = CSharedBuffer::make(size)) == NULL)
+					err = kOSErrNoMemory;
+				else
+					err = SMemCopyFromSharedSWI(senderMsgId, buf->data(), size, 0, senderMsgId, signature, &size);
+			}
+		}
+
+		if (outMsgType != NULL)
+			*outMsgType = msgType;
+
+		NewtonErr result = err;
+		if (result == noErr && replyMemId != kNoId)
+			result = kOSErrReceiverDidNotDoRPC;
+		SMemMsgMsgDoneSWI(senderMsgId, result, signature);
+	}
+	XENDTRY;
+
+	if (err != noErr && buf != NULL)
+	{
+		buf->release();
+		buf = NULL;
+	}
+	*outBuf = buf;
+	if (outSize != NULL)
+		*outSize = size;
+	return err;
+}
+
+
 /*------------------------------------------------------------------------------
 	Reset the filter for messages were interested in.
 	Args:		inAsync					message area
@@ -167,6 +167,10 @@ public:
 	NewtonErr	receive(size_t * outSize, void * inContent, size_t inSize, CUMsgToken * inToken = NULL, ULong * outMsgType = NULL, Timeout inTimeout = kNoTimeout, ULong inMsgFilter = kMsgType_MatchAll, bool onMsgAvail = false, bool tokenOnly = false);
 	NewtonErr	receive(CUAsyncMessage * inAsync, Timeout inTimeout = kNoTimeout, ULong inMsgFilter = kMsgType_MatchAll, bool onMsgAvail = false);
 
+				// zero-copy versions, passing a CSharedBuffer by reference (not in the original)
+	NewtonErr	send(CSharedBuffer * inBuf, size_t inSize, Timeout inTimeout = kNoTimeout, ULong inMsgType = 0, bool inUrgent = false);
+	NewtonErr	receive(CSharedBuffer ** outBuf, size_t * outSize, ULong * outMsgType = NULL, Timeout inTimeout = kNoTimeout, ULong inMsgFilter = kMsgType_MatchAll, bool onMsgAvail = false);
+
 	NewtonErr	isMsgAvailable(ULong inMsgFilter = kMsgType_MatchAll)
 							{ return receive(NULL, (Timeout) kNoTimeout, inMsgFilter); }
 
@@ -9,6 +9,8 @@
 #include "UserSharedMem.h"
 #include "KernelObjects.h"
 #include "UserPorts.h"
+#include "SharedMem.h"
+#include "OSErrors.h"
 
 
 /*------------------------------------------------------------------------------
@@ -119,3 +121,83 @@ CUSharedMemMsg::getUserRefCon(OpaqueRef * outRefCon)
 {
 	return SMemMsgGetUserRefConSWI(fId, outRefCon);
 }
+
+#pragma mark -
+/*------------------------------------------------------------------------------
+	C S h a r e d B u f f e r
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+	Make a new shared buffer, with one reference to it.
+	Args:		inSize		size of its content
+	Return:	the buffer; NULL => no memory
+------------------------------------------------------------------------------*/
+
+CSharedBuffer *
+CSharedBuffer::make(size_t inSize)
+{
+	CSharedBuffer *	buf;
+	if ((buf = (CSharedBuffer *)NewPtr(sizeof(CSharedBuffer) + inSize)) != NULL)
+	{
+		buf->fRefCount = 1;
+		buf->fSize = inSize;
+		buf->fMsgType = kMsgType_MatchAll;
+	}
+	return buf;
+}
+
+
+/*------------------------------------------------------------------------------
+	Make sure the caller's buffer is its own before it writes to it.
+	If anyone else holds a reference, the content is copied to a new buffer
+	and the caller's reference moves to that.
+	Args:		ioBuf			the caller's buffer
+	Return:	error code; the buffer is unchanged if there is no memory
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CSharedBuffer::prepareToWrite(CSharedBuffer ** ioBuf)
+{
+	CSharedBuffer *	buf = *ioBuf;
+	if (buf->isShared())
+	{
+		CSharedBuffer *	copy;
+		if ((copy = make(buf->fSize)) == NULL)
+			return kOSErrNoMemory;
+		memmove(copy->data(), buf->data(), buf->fSize);
+		copy->fMsgType = buf->fMsgType;
+		CountSMemCopy(buf->fMsgType, buf->fSize, false);
+		buf->release();
+		*ioBuf = copy;
+	}
+	return noErr;
+}
+
+
+void
+CSharedBuffer::retain(void)
+{
+	__atomic_add_fetch(&fRefCount, 1, __ATOMIC_RELAXED);
+}
+
+
+void
+CSharedBuffer::release(void)
+{
+	if (__atomic_sub_fetch(&fRefCount, 1, __ATOMIC_ACQ_REL) == 0)
+		FreePtr((Ptr)this);
+}
+
+
+/*------------------------------------------------------------------------------
+	Does anyone else hold a reference?
+	If not, nobody else can get one, so it's safe to write to the content.
+	Args:		--
+	Return:	true => copy before writing
+------------------------------------------------------------------------------*/
+
+bool
+CSharedBuffer::isShared(void) const
+{
+	return __atomic_load_n(&fRefCount, __ATOMIC_ACQUIRE) > 1;
+}
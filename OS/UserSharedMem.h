@@ -1 +1 @@
-/*	File:		UserSharedMem.h	Contains:	User task interface to shared memory objects.	Written by:	Newton Research Group.*/#if !defined(__USERSHAREDMEM_H)#define __USERSHAREDMEM_H 1#if !defined(__NEWTON_H)#include "Newton.h"#endif#if !defined(__USEROBJECTS_H)#include "UserObjects.h"#endif#include "SharedTypes.h"#include "UserGlobals.h"#include "LongTime.h"class CUMsgToken;/*--------------------------------------------------------------------------------	C U S h a r e d M e m--------------------------------------------------------------------------------*/class CUSharedMem : public CUObject{public:					CUSharedMem(ObjectId id = 0);    CUSharedMem&	operator=(const CUSharedMem & inCopy);	NewtonErr	init(void);	NewtonErr	setBuffer(void * inBuffer, size_t inSize, ULong inPermissions = kSMemReadOnly);	NewtonErr	getSize(size_t * outSize, void ** outBuffer = NULL);	NewtonErr	copyToShared(void * inBuffer, size_t inSize, ULong inOffset = 0, CUMsgToken * inToken = NULL);	NewtonErr	copyFromShared(size_t * outSize, void * outBuffer, size_t inSize, ULong inOffset = 0, CUMsgToken * inToken = NULL);};/*------------------------------------------------------------------------------	C U S h a r e d M e m   I n l i n e s------------------------------------------------------------------------------*/inline			CUSharedMem::CUSharedMem(ObjectId id) : CUObject(id) { }inline CUSharedMem& CUSharedMem::operator=(const CUSharedMem & inCopy){    copyObject(inCopy);    return *this;}/*--------------------------------------------------------------------------------	U S h a r e d M e m M s g--------------------------------------------------------------------------------*/class CUSharedMemMsg : public CUSharedMem{public:					CUSharedMemMsg(ObjectId id = 0);    CUSharedMemMsg& operator=(const CUSharedMemMsg & inCopy);	NewtonErr	init(void);	NewtonErr	setTimerParms(Timeout inTimeout = kNoTimeout, CTime * inDelay = NULL);	NewtonErr	setMsgAvailPort(ObjectId inAvailPortId);	NewtonErr	getSenderTaskId(ObjectId * outSenderTaskId);	NewtonErr	getSize(size_t * outSize, void ** outBuffer = NULL, OpaqueRef * outRefCon = NULL);	NewtonErr	setUserRefCon(OpaqueRef inRefCon);	NewtonErr	getUserRefCon(OpaqueRef * outRefCon);	NewtonErr	checkForDone(ULong inFlags, ObjectId * inSentById = NULL, ObjectId * inReplyMemId = NULL, ULong * inMsgType = NULL, ULong * inSignature = NULL);	NewtonErr	msgDone(NewtonErr inResult, ObjectId inSignature);};/*------------------------------------------------------------------------------	C U S h a r e d M e m M s g   I n l i n e s------------------------------------------------------------------------------*/inline			CUSharedMemMsg::CUSharedMemMsg(ObjectId id) : CUSharedMem(id) { }inline CUSharedMemMsg& CUSharedMemMsg::operator=(const CUSharedMemMsg & inCopy){    copyObject(inCopy);    return *this;}inline NewtonErr	CUSharedMemMsg::checkForDone(ULong inFlags, ObjectId * inSentById, ObjectId * inReplyMemId, ULong * inMsgType, ULong * inSignature){ return SMemMsgCheckForDoneSWI(fId, inFlags, inSentById, inReplyMemId, inMsgType, inSignature); }inline NewtonErr	CUSharedMemMsg::msgDone(NewtonErr inResult, ObjectId inSignature){ return SMemMsgMsgDoneSWI(fId, inResult, inSignature); }#endif	/* __USERSHAREDMEM_H */
\ No newline at end of file
+/*	File:		UserSharedMem.h	Contains:	User task interface to shared memory objects.	Written by:	Newton Research Group.*/#if !defined(__USERSHAREDMEM_H)#define __USERSHAREDMEM_H 1#if !defined(__NEWTON_H)#include "Newton.h"#endif#if !defined(__USEROBJECTS_H)#include "UserObjects.h"#endif#include "SharedTypes.h"#include "UserGlobals.h"#include "LongTime.h"class CUMsgToken;/*--------------------------------------------------------------------------------	C U S h a r e d M e m--------------------------------------------------------------------------------*/class CUSharedMem : public CUObject{public:					CUSharedMem(ObjectId id = 0);    CUSharedMem&	operator=(const CUSharedMem & inCopy);	NewtonErr	init(void);	NewtonErr	setBuffer(void * inBuffer, size_t inSize, ULong inPermissions = kSMemReadOnly);	NewtonErr	getSize(size_t * outSize, void ** outBuffer = NULL);	NewtonErr	copyToShared(void * inBuffer, size_t inSize, ULong inOffset = 0, CUMsgToken * inToken = NULL);	NewtonErr	copyFromShared(size_t * outSize, void * outBuffer, size_t inSize, ULong inOffset = 0, CUMsgToken * inToken = NULL);};/*------------------------------------------------------------------------------	C U S h a r e d M e m   I n l i n e s------------------------------------------------------------------------------*/inline			CUSharedMem::CUSharedMem(ObjectId id) : CUObject(id) { }inline CUSharedMem& CUSharedMem::operator=(const CUSharedMem & inCopy){    copyObject(inCopy);    return *this;}/*--------------------------------------------------------------------------------	U S h a r e d M e m M s g--------------------------------------------------------------------------------*/class CUSharedMemMsg : public CUSharedMem{public:					CUSharedMemMsg(ObjectId id = 0);    CUSharedMemMsg& operator=(const CUSharedMemMsg & inCopy);	NewtonErr	init(void);	NewtonErr	setTimerParms(Timeout inTimeout = kNoTimeout, CTime * inDelay = NULL);	NewtonErr	setMsgAvailPort(ObjectId inAvailPortId);	NewtonErr	getSenderTaskId(ObjectId * outSenderTaskId);	NewtonErr	getSize(size_t * outSize, void ** outBuffer = NULL, OpaqueRef * outRefCon = NULL);	NewtonErr	setUserRefCon(OpaqueRef inRefCon);	NewtonErr	getUserRefCon(OpaqueRef * outRefCon);	NewtonErr	checkForDone(ULong inFlags, ObjectId * inSentById = NULL, ObjectId * inReplyMemId = NULL, ULong * inMsgType = NULL, ULong * inSignature = NULL);	NewtonErr	msgDone(NewtonErr inResult, ObjectId inSignature);};/*------------------------------------------------------------------------------	C U S h a r e d M e m M s g   I n l i n e s------------------------------------------------------------------------------*/inline			CUSharedMemMsg::CUSharedMemMsg(ObjectId id) : CUSharedMem(id) { }inline CUSharedMemMsg& CUSharedMemMsg::operator=(const CUSharedMemMsg & inCopy){    copyObject(inCopy);    return *this;}inline NewtonErr	CUSharedMemMsg::checkForDone(ULong inFlags, ObjectId * inSentById, ObjectId * inReplyMemId, ULong * inMsgType, ULong * inSignature){ return SMemMsgCheckForDoneSWI(fId, inFlags, inSentById, inReplyMemId, inMsgType, inSignature); }inline NewtonErr	CUSharedMemMsg::msgDone(NewtonErr inResult, ObjectId inSignature){ return SMemMsgMsgDoneSWI(fId, inResult, inSignature); }/*--------------------------------------------------------------------------------	C S h a r e d B u f f e r	A reference-counted buffer that can be passed through a port without its	content being copied -- all tasks share the host address space, so the	receiver can use the sender's bytes where they are.	The sender keeps its own reference while the message is in flight, and the	receiver takes one before the send completes. Once the buffer is shared	the content must not change, so a holder that wants to write to it calls	prepareToWrite first, which copies it to a buffer of its own if anyone	else holds a reference (copy-on-write).	The content follows the header in the same block.--------------------------------------------------------------------------------*/class CSharedBuffer{public:	static CSharedBuffer *	make(size_t inSize);	static NewtonErr	prepareToWrite(CSharedBuffer ** ioBuf);	void			retain(void);	void			release(void);	bool			isShared(void) const;	UByte *		data(void);	size_t		size(void) const;private:	friend class CUPort;	long			fRefCount;	size_t		fSize;	ULong			fMsgType;		// type it was last sent as, for copy statistics};inline UByte *	CSharedBuffer::data(void)				{ return (UByte *)this + sizeof(CSharedBuffer); }inline size_t	CSharedBuffer::size(void) const		{ return fSize; }/*--------------------------------------------------------------------------------	S h a r e d B u f f e r R e f	What a CSharedBuffer message actually carries; its shared memory has the	kSMemSharedBuffer permission.--------------------------------------------------------------------------------*/#define kSharedBufferSignature	'shbf'struct SharedBufferRef{	ULong					signature;	// kSharedBufferSignature	size_t				size;			// bytes of content sent	CSharedBuffer *	buf;	uintptr_t			check;		// ~buf, so a plain message is never mistaken for one};#endif	/* __USERSHAREDMEM_H */
\ No newline at end of file
@@ -0,0 +1,140 @@
+/*
+	File:		VirtualClock.cc
+
+	Contains:	The virtual clock, for deterministic replay of recorded events.
+					Not in the original. Kept apart from Timers.cc, which reads it
+					and sets its alarm, so that it can be built and tested with
+					the event replayer on its own.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "NewtonTime.h"
+
+extern void SetPlatformAlarm(int64_t inDelta);
+
+#if !defined(correct)
+
+/* -----------------------------------------------------------------------------
+	D a t a
+	The replayer moves the clock on from a host thread while the kernel reads
+	it, so the times are only ever accessed atomically.
+----------------------------------------------------------------------------- */
+
+static bool		gIsClockVirtual = false;
+static int64_t	gVirtualTime = 0;
+static int64_t	gVirtualAlarmTime = 0;			// 0 => no alarm set
+static bool		gIsVirtualAlarmPending = false;	// fired, but the timer interrupt has yet to run
+
+
+/* -----------------------------------------------------------------------------
+	For Timers.cc.
+----------------------------------------------------------------------------- */
+
+bool
+IsClockVirtual(void)
+{
+	return gIsClockVirtual;
+}
+
+
+CTime
+GetVirtualClock(void)
+{
+	return CTime(__atomic_load_n(&gVirtualTime, __ATOMIC_ACQUIRE));
+}
+
+
+/*------------------------------------------------------------------------------
+	Set the alarm: AdvanceVirtualClock() will fire the timer interrupt when the
+	clock reaches it.
+	Args:		inTime		when; 0 => clear the alarm
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+SetVirtualAlarm(CTime inTime)
+{
+	__atomic_store_n(&gVirtualAlarmTime, (int64_t)inTime, __ATOMIC_RELEASE);
+}
+
+
+/*------------------------------------------------------------------------------
+	The timer interrupt has run.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+VirtualAlarmTaken(void)
+{
+	__atomic_store_n(&gIsVirtualAlarmPending, false, __ATOMIC_RELEASE);
+}
+
+
+#pragma mark -
+/* -----------------------------------------------------------------------------
+	P u b l i c   I n t e r f a c e
+----------------------------------------------------------------------------- */
+
+/*------------------------------------------------------------------------------
+	Make the clock virtual, or real again.
+	While it is virtual, time stands still until AdvanceVirtualClock() moves
+	it on, so a replay of recorded events runs the same way however fast the
+	host is. Switch it before booting: timers already queued against one clock
+	make no sense against the other.
+	Args:		inIsVirtual
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+SetVirtualClock(bool inIsVirtual)
+{
+	gIsClockVirtual = inIsVirtual;
+	__atomic_store_n(&gVirtualTime, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&gVirtualAlarmTime, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&gIsVirtualAlarmPending, false, __ATOMIC_RELEASE);
+}
+
+
+/*------------------------------------------------------------------------------
+	Move the virtual clock on, firing the timer interrupt if that makes the
+	alarm due. Called from a host thread.
+	Args:		inDelta		time to move on by
+	Return:	true => the alarm fired; IsVirtualAlarmPending() until it has been handled
+------------------------------------------------------------------------------*/
+
+bool
+AdvanceVirtualClock(CTime inDelta)
+{
+	if (gIsClockVirtual)
+	{
+		int64_t	now = __atomic_add_fetch(&gVirtualTime, (int64_t)inDelta, __ATOMIC_ACQ_REL);
+		int64_t	alarmTime = __atomic_load_n(&gVirtualAlarmTime, __ATOMIC_ACQUIRE);
+		// claim the alarm -- unless the kernel has just set another
+		if (alarmTime != 0 && alarmTime <= now
+		&&  __atomic_compare_exchange_n(&gVirtualAlarmTime, &alarmTime, 0, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		{
+			__atomic_store_n(&gIsVirtualAlarmPending, true, __ATOMIC_RELEASE);
+			SetPlatformAlarm(1);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/*------------------------------------------------------------------------------
+	Has the timer interrupt for the last alarm AdvanceVirtualClock() fired yet
+	to run?
+	Args:		--
+	Return:	true => it has not
+------------------------------------------------------------------------------*/
+
+bool
+IsVirtualAlarmPending(void)
+{
+	return __atomic_load_n(&gIsVirtualAlarmPending, __ATOMIC_ACQUIRE);
+}
+
+#endif
@@ -0,0 +1,378 @@
+/*
+	File:		EventReplay.cc
+
+	Contains:	Recording and replay of host input events.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "EventReplay.h"
+#include "TabletBuffer.h"
+#include "HeadlessDisplay.h"
+#include "KernelGlobals.h"
+#include "OSErrors.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <thread>
+
+extern CTime		GetClock(void);
+extern NewtonErr	InsertFakeTabletSample(ULong inSample, ArrayIndex inTablet);
+extern bool			gNewtIsAliveAndWell;
+
+
+/* -----------------------------------------------------------------------------
+	D a t a
+----------------------------------------------------------------------------- */
+
+CEventRecorder *	gEventRecorder = NULL;
+
+
+/*------------------------------------------------------------------------------
+	Sleep the host thread.
+	Only ever used to poll the Newton while its clock stands still, so how
+	long the host sleeps makes no difference to what the Newton sees.
+	Args:		inMicroseconds
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+HostSleep(long inMicroseconds)
+{
+	struct timespec delay;
+	delay.tv_sec = inMicroseconds / 1000000;
+	delay.tv_nsec = (inMicroseconds % 1000000) * 1000;
+	nanosleep(&delay, NULL);
+}
+
+
+#pragma mark CEventRecorder
+/* -----------------------------------------------------------------------------
+	C E v e n t R e c o r d e r
+----------------------------------------------------------------------------- */
+
+CEventRecorder::CEventRecorder()
+{
+	fFile = NULL;
+}
+
+
+CEventRecorder::~CEventRecorder()
+{
+	stop();
+}
+
+
+/*------------------------------------------------------------------------------
+	Start recording to a new log.
+	Args:		inPath				file to write
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CEventRecorder::start(const char * inPath)
+{
+	stop();
+	fFile = fopen(inPath, "w");
+	if (fFile == NULL)
+		return kOSErrBadParameters;
+	fprintf(fFile, "%s\n", kEventLogSignature);
+	fStartTime = GetClock();
+	gEventRecorder = this;
+	return noErr;
+}
+
+
+/*------------------------------------------------------------------------------
+	Stop recording and close the log.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CEventRecorder::stop(void)
+{
+	if (gEventRecorder == this)
+		gEventRecorder = NULL;
+	if (fFile)
+		fclose(fFile), fFile = NULL;
+}
+
+
+/*------------------------------------------------------------------------------
+	Log a tablet sample.
+	Args:		inSample				TabletSample.intValue
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CEventRecorder::record(ULong inSample)
+{
+	if (fFile)
+	{
+		CTime now(GetClock());
+		fprintf(fFile, "%lld pen %08X\n", (long long)(int64_t)(now - fStartTime), inSample);
+	}
+}
+
+
+#pragma mark -
+#pragma mark CEventReplayer
+/* -----------------------------------------------------------------------------
+	C E v e n t R e p l a y e r
+----------------------------------------------------------------------------- */
+
+CEventReplayer::CEventReplayer()
+{
+	fEvents = NULL;
+	fCount = 0;
+	fAllocated = 0;
+	fNow = 0;
+}
+
+
+CEventReplayer::~CEventReplayer()
+{
+	if (fEvents)
+		FreePtr((Ptr)fEvents);
+}
+
+
+/*------------------------------------------------------------------------------
+	Set up the world for replay: a virtual clock and a headless display.
+	Must be called before the Newton world is started.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CEventReplayer::prepare(void)
+{
+	SetVirtualClock(true);
+	gWantHeadlessDisplay = true;
+}
+
+
+/*------------------------------------------------------------------------------
+	Load a log written by CEventRecorder.
+	Events must be in time order; anything other than pen events is rejected.
+	Args:		inPath				file to read
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CEventReplayer::load(const char * inPath)
+{
+	NewtonErr	err = noErr;
+	FILE *		file;
+	char			line[128];
+
+	fCount = 0;
+	if ((file = fopen(inPath, "r")) == NULL)
+		return kOSErrItemNotFound;
+
+	XTRY
+	{
+		XFAILIF(fgets(line, sizeof(line), file) == NULL
+			  || strncmp(line, kEventLogSignature, strlen(kEventLogSignature)) != 0, err = kOSErrBadParameters;)
+
+		int64_t	prevTime = 0;
+		while (err == noErr && fgets(line, sizeof(line), file) != NULL)
+		{
+			long long	time;
+			unsigned		sample;
+			char			kind[8];
+			if (line[0] == '#' || line[0] == '\n')
+				continue;
+			if (sscanf(line, "%lld %7s %x", &time, kind, &sample) != 3
+			||  strcmp(kind, "pen") != 0
+			||  time < prevTime)
+			{
+				err = kOSErrBadParameters;
+				break;
+			}
+			if (fCount == fAllocated)
+			{
+				ArrayIndex		newSize = fAllocated ? 2 * fAllocated : 256;
+				ReplayEvent *	events = (ReplayEvent *)(fEvents ? ReallocPtr((Ptr)fEvents, newSize * sizeof(ReplayEvent))
+																			: NewPtr(newSize * sizeof(ReplayEvent)));
+				if (events == NULL)
+				{
+					err = kOSErrNoMemory;
+					break;
+				}
+				fEvents = events;
+				fAllocated = newSize;
+			}
+			fEvents[fCount].time = time;
+			fEvents[fCount].sample = sample;
+			fCount++;
+			prevTime = time;
+		}
+	}
+	XENDTRY;
+
+	fclose(file);
+	if (err)
+		fCount = 0;
+	return err;
+}
+
+
+/*------------------------------------------------------------------------------
+	Replay the log. Call on a host thread once the Newton world has been
+	started; it waits, driving the clock, for the world to come up.
+	Args:		inCaptureDir		where to write frames; NULL => don't
+				inGoldenDir			where to find golden frames; NULL => don't compare
+				inReport				where to print frame timings; NULL => don't
+	Return:	error code
+				kOSErrMessageTimedOut => the Newton stopped responding
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CEventReplayer::run(const char * inCaptureDir, const char * inGoldenDir, FILE * inReport)
+{
+	NewtonErr	err = noErr;
+
+	fNow = 0;
+	XTRY
+	{
+		// boot
+		while (!gNewtIsAliveAndWell)
+		{
+			XFAILIF(fNow >= kReplayMaxBootTime || !advanceTo(fNow + kReplayTick), err = kOSErrMessageTimedOut;)
+		}
+		XFAIL(err)
+
+		// the log's times are from the start of recording, which was after boot
+		if (gHeadlessDisplay)
+			gHeadlessDisplay->setFrameDirectories(inCaptureDir, inGoldenDir);
+		int64_t	startTime = fNow;
+		for (ArrayIndex i = 0; i < fCount; ++i)
+		{
+			XFAILIF(!advanceTo(startTime + fEvents[i].time), err = kOSErrMessageTimedOut;)
+			// the Newton has settled, so the sample buffer is empty
+			XFAIL(err = InsertFakeTabletSample(fEvents[i].sample, kReplayTabletSamples))
+		}
+		XFAIL(err)
+
+		// let the last events take effect
+		XFAILIF(!waitForSettle() || !advanceTo(fNow + kReplaySettleTime), err = kOSErrMessageTimedOut;)
+	}
+	XENDTRY;
+
+	if (gHeadlessDisplay)
+	{
+		if (inReport && gHeadlessDisplay->reportTimings(inReport) != 0 && err == noErr)
+			err = kOSErrBadParameters;		// frames differ from golden
+		gHeadlessDisplay->setFrameDirectories(NULL, NULL);
+	}
+	return err;
+}
+
+
+/*------------------------------------------------------------------------------
+	Move the virtual clock on to a time, a tick at a time, letting the Newton
+	settle after each tick so that timers fire in between as they would have.
+	Args:		inTime				virtual microseconds since start
+	Return:	false => the Newton did not settle
+------------------------------------------------------------------------------*/
+
+bool
+CEventReplayer::advanceTo(int64_t inTime)
+{
+	if (!waitForSettle())
+		return false;
+	while (fNow < inTime)
+	{
+		int64_t	delta = MIN(inTime - fNow, (int64_t)kReplayTick);
+		AdvanceVirtualClock(CTime(delta));
+		fNow += delta;
+		if (!waitForSettle())
+			return false;
+	}
+	return true;
+}
+
+
+/*------------------------------------------------------------------------------
+	Wait for the Newton to settle: the last alarm handled, all the samples
+	inserted so far consumed, and nothing left to run but the idle task.
+	Args:		--
+	Return:	false => timed out
+------------------------------------------------------------------------------*/
+
+bool
+CEventReplayer::waitForSettle(void)
+{
+	for (long waited = 0; waited < kReplayMaxWait; waited += 1000)
+	{
+		if (!IsVirtualAlarmPending()
+		&&  gFakeTabletSamples[kReplayTabletSamples].isEmpty()
+		&&  TabletBufferEmpty()
+		&&  __atomic_load_n(&gCurrentTask, __ATOMIC_ACQUIRE) == gIdleTask)
+			return true;
+		HostSleep(1000);
+	}
+	return false;
+}
+
+
+#pragma mark -
+/* -----------------------------------------------------------------------------
+	P u b l i c   I n t e r f a c e
+----------------------------------------------------------------------------- */
+
+/*------------------------------------------------------------------------------
+	Record the host's input events for the rest of the session.
+	Args:		inPath				file to write the log to
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+RecordEvents(const char * inPath)
+{
+	CEventRecorder * recorder = new CEventRecorder;
+	if (recorder == NULL)
+		return kOSErrNoMemory;
+	NewtonErr err = recorder->start(inPath);
+	if (err)
+		delete recorder;
+	return err;
+}
+
+
+/*------------------------------------------------------------------------------
+	Replay a log on a thread of its own, then quit.
+	Sets up the virtual clock and headless display, so must be called before
+	the Newton world is started.
+	Args:		inPath				log to replay
+				inCaptureDir		where to write frames; NULL => don't
+				inGoldenDir			where to find golden frames; NULL => don't compare
+	Return:	error code -- if the log can't be loaded
+------------------------------------------------------------------------------*/
+
+NewtonErr
+ReplayEvents(const char * inPath, const char * inCaptureDir, const char * inGoldenDir)
+{
+	CEventReplayer * replayer = new CEventReplayer;
+	if (replayer == NULL)
+		return kOSErrNoMemory;
+	NewtonErr err = replayer->load(inPath);
+	if (err)
+	{
+		delete replayer;
+		return err;
+	}
+	CEventReplayer::prepare();
+
+	std::thread([replayer, inCaptureDir, inGoldenDir]()
+	{
+		NewtonErr result = replayer->run(inCaptureDir, inGoldenDir, stdout);
+		printf("replayed %u events: %s (%d)\n", (unsigned)replayer->count(), result ? "failed" : "ok", (int)result);
+		fflush(stdout);
+		exit(result ? EXIT_FAILURE : EXIT_SUCCESS);
+	}).detach();
+	return noErr;
+}
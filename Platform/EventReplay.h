@@ -0,0 +1,117 @@
+/*
+	File:		EventReplay.h
+
+	Contains:	Recording and replay of host input events.
+					Pen samples fed in by the host are recorded with their times,
+					and can be fed in again later against a virtual clock, so that
+					a UI session runs the same way every time -- with a headless
+					display, for timing drawing and catching rendering regressions.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__EVENTREPLAY_H)
+#define __EVENTREPLAY_H 1
+
+#include "NewtonTime.h"
+#include <stdio.h>
+
+
+/* -----------------------------------------------------------------------------
+	E v e n t   L o g
+	A text file, one event per line:
+		<microseconds since recording started> pen <tablet sample in hex>
+	Lines starting with # are comments.
+----------------------------------------------------------------------------- */
+
+#define kEventLogSignature	"# Newton event log 1"
+
+struct ReplayEvent
+{
+	int64_t	time;			// microseconds since start
+	ULong		sample;		// TabletSample.intValue
+};
+
+
+/* -----------------------------------------------------------------------------
+	C E v e n t R e c o r d e r
+	While gEventRecorder is set, every sample the host inserts is logged.
+----------------------------------------------------------------------------- */
+
+class CEventRecorder
+{
+public:
+					CEventRecorder();
+					~CEventRecorder();
+
+	NewtonErr	start(const char * inPath);
+	void			stop(void);
+	void			record(ULong inSample);
+
+private:
+	FILE *		fFile;
+	CTime			fStartTime;
+};
+
+
+/* -----------------------------------------------------------------------------
+	C E v e n t R e p l a y e r
+	Feeds a recorded log back in on a host thread. The Newton clock must be
+	virtual, and the display headless, from boot: call prepare() before
+	starting the Newton world, and run() once it has started.
+	The replayer drives the virtual clock, a tick at a time, through the boot
+	and then to the time of each event in turn. It moves the clock on only
+	once the Newton has settled -- the timer interrupt for the last tick has
+	run, the tablet has taken every sample, and the idle task is running --
+	so what happens depends on the log alone, not on the speed of the host.
+----------------------------------------------------------------------------- */
+
+#define kReplayTick				(10*kMilliseconds)
+#define kReplaySettleTime		(1*kSeconds)		// after the last event
+#define kReplayMaxBootTime		(60*kSeconds)		// virtual time for the Newton world to start
+#define kReplayMaxWait			(2*kSeconds)		// real time to wait for the Newton to settle
+
+class CEventReplayer
+{
+public:
+					CEventReplayer();
+					~CEventReplayer();
+
+	static void	prepare(void);
+
+	NewtonErr	load(const char * inPath);
+	NewtonErr	run(const char * inCaptureDir, const char * inGoldenDir, FILE * inReport);
+
+	ArrayIndex	count(void) const;
+
+private:
+	bool			advanceTo(int64_t inTime);
+	bool			waitForSettle(void);
+
+	ReplayEvent *	fEvents;
+	ArrayIndex		fCount;
+	ArrayIndex		fAllocated;
+	int64_t			fNow;				// virtual microseconds since start
+};
+
+inline ArrayIndex	CEventReplayer::count(void) const  { return fCount; }
+
+
+/* -----------------------------------------------------------------------------
+	D a t a
+----------------------------------------------------------------------------- */
+
+extern CEventRecorder *	gEventRecorder;	// NULL => not recording
+
+
+/* -----------------------------------------------------------------------------
+	P u b l i c   I n t e r f a c e
+	For the host's launch options. Call either before starting the Newton
+	world; replay quits the app when it is done, with a non-zero status if it
+	failed or any frame differed from its golden frame.
+----------------------------------------------------------------------------- */
+
+extern NewtonErr	RecordEvents(const char * inPath);
+extern NewtonErr	ReplayEvents(const char * inPath, const char * inCaptureDir, const char * inGoldenDir);
+
+#endif	/* __EVENTREPLAY_H */
@@ -0,0 +1,819 @@
+/*
+	File:		HostSerial.cc
+
+	Contains:	Host serial port implementation.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostSerial.h"
+#include "CommErrors.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+
+const char *	gHostSerialSpec = NULL;
+
+
+/* -----------------------------------------------------------------------------
+	Make a file descriptor non-blocking.
+	Args:		inFd			file descriptor
+	Return:	true => OK
+----------------------------------------------------------------------------- */
+
+static bool
+SetNonBlocking(int inFd)
+{
+	int flags = fcntl(inFd, F_GETFL, 0);
+	return flags >= 0 && fcntl(inFd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+
+static void
+CloseFd(int & ioFd)
+{
+	if (ioFd >= 0)
+	{
+		::close(ioFd);
+		ioFd = -1;
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	C H o s t S e r i a l P o r t
+----------------------------------------------------------------------------- */
+
+CHostSerialPort::CHostSerialPort()
+	:	fMode(kHostSerialClosed),
+		fDataFd(-1), fSlaveFd(-1), fListenFd(-1), fEventFd(-1),
+		fIsWatchingInput(false), fIsWatchingOutput(false),
+		fIsThreadRunning(false), fIsConnected(false),
+		fTxStageIndex(0), fTxStageCount(0), fIsFlushingOutput(false),
+		fRxNotify(NULL), fTxNotify(NULL), fRefCon(NULL)
+{
+	fName[0] = 0;
+	fWakeFd[0] = fWakeFd[1] = -1;
+	pthread_mutex_init(&fLock, NULL);
+}
+
+
+CHostSerialPort::~CHostSerialPort()
+{
+	close();
+	pthread_mutex_destroy(&fLock);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Open the port as described by a spec string:
+		"pty"				pseudo-terminal
+		"tcp"				localhost:kHostSerialDefaultTCPPort
+		"tcp:<port>"	localhost:<port>
+	Args:		inSpec		the spec; typically taken from the environment
+	Return:	error code
+----------------------------------------------------------------------------- */
+
+NewtonErr
+CHostSerialPort::open(const char * inSpec)
+{
+	if (inSpec == NULL)
+		return kCommErrBadParameter;
+	if (strcmp(inSpec, "pty") == 0)
+		return openPTY();
+	if (strcmp(inSpec, "tcp") == 0)
+		return openTCP(kHostSerialDefaultTCPPort);
+	if (strncmp(inSpec, "tcp:", 4) == 0)
+	{
+		long port = strtol(inSpec + 4, NULL, 10);
+		if (port > 0 && port < 65536)
+			return openTCP((unsigned short)port);
+	}
+	return kCommErrBadParameter;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Open the port as a pseudo-terminal in raw mode.
+	The host connects to the slave device named by name().
+	Args:		--
+	Return:	error code
+----------------------------------------------------------------------------- */
+
+NewtonErr
+CHostSerialPort::openPTY(void)
+{
+	NewtonErr err = noErr;
+	XTRY
+	{
+		XFAILIF(fMode != kHostSerialClosed, err = kSerErrChannelInUse;)
+		XFAIL(err = allocateBuffers())
+
+		XFAILIF((fDataFd = posix_openpt(O_RDWR | O_NOCTTY)) < 0, err = kSerErrInternalError;)
+		XFAILIF(grantpt(fDataFd) != 0 || unlockpt(fDataFd) != 0, err = kSerErrInternalError;)
+		const char * slaveName = ptsname(fDataFd);
+		XFAILIF(slaveName == NULL, err = kSerErrInternalError;)
+		strncpy(fName, slaveName, sizeof(fName) - 1);
+		fName[sizeof(fName) - 1] = 0;
+
+		// raw 8-bit data, no echo, no line editing
+		struct termios tio;
+		XFAILIF(tcgetattr(fDataFd, &tio) != 0, err = kSerErrInternalError;)
+		cfmakeraw(&tio);
+		XFAILIF(tcsetattr(fDataFd, TCSANOW, &tio) != 0, err = kSerErrInternalError;)
+
+		// hold the slave open ourselves, otherwise the master reports hang-up
+		// (and polls readable) until a client opens it
+		XFAILIF((fSlaveFd = ::open(fName, O_RDWR | O_NOCTTY)) < 0, err = kSerErrInternalError;)
+		XFAILNOT(SetNonBlocking(fDataFd), err = kSerErrInternalError;)
+
+		fMode = kHostSerialPTY;
+		XFAIL(err = createEventQueue())
+		XFAIL(err = watch(fDataFd))
+		setConnected(true);
+		XFAIL(err = startIOThread())
+#if debugLevel > 0
+		printf("Serial port available at %s\n", fName);
+#endif
+	}
+	XENDTRY;
+	XDOFAIL(err)
+	{
+		close();
+	}
+	XENDFAIL;
+	return err;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Open the port as a TCP socket listening on the loopback interface.
+	One client may be connected at a time; further connections are refused
+	until it disconnects.
+	Args:		inPort		TCP port number
+	Return:	error code
+----------------------------------------------------------------------------- */
+
+NewtonErr
+CHostSerialPort::openTCP(unsigned short inPort)
+{
+	NewtonErr err = noErr;
+	XTRY
+	{
+		XFAILIF(fMode != kHostSerialClosed, err = kSerErrChannelInUse;)
+		XFAIL(err = allocateBuffers())
+
+		XFAILIF((fListenFd = socket(AF_INET, SOCK_STREAM, 0)) < 0, err = kSerErrInternalError;)
+		int yes = 1;
+		setsockopt(fListenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(inPort);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		XFAILIF(bind(fListenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0, err = kSerErrChannelInUse;)
+		XFAILIF(listen(fListenFd, 1) != 0, err = kSerErrInternalError;)
+		XFAILNOT(SetNonBlocking(fListenFd), err = kSerErrInternalError;)
+		snprintf(fName, sizeof(fName), "localhost:%u", inPort);
+
+		fMode = kHostSerialTCP;
+		XFAIL(err = createEventQueue())
+		XFAIL(err = watch(fListenFd))
+		XFAIL(err = startIOThread())
+#if debugLevel > 0
+		printf("Serial port listening on %s\n", fName);
+#endif
+	}
+	XENDTRY;
+	XDOFAIL(err)
+	{
+		close();
+	}
+	XENDFAIL;
+	return err;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Close the port: stop the I/O thread and release host resources.
+	Args:		--
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CHostSerialPort::close(void)
+{
+	if (fIsThreadRunning)
+	{
+		wake(kQuitIOThread);
+		pthread_join(fThread, NULL);
+		fIsThreadRunning = false;
+	}
+	setConnected(false);
+	CloseFd(fDataFd);
+	CloseFd(fSlaveFd);
+	CloseFd(fListenFd);
+	CloseFd(fEventFd);
+	CloseFd(fWakeFd[0]);
+	CloseFd(fWakeFd[1]);
+	fIsWatchingInput = fIsWatchingOutput = false;
+	fMode = kHostSerialClosed;
+	fName[0] = 0;
+
+	fSendBuf.deallocate();
+	fTxStageIndex = fTxStageCount = 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Set the procs to call when bytes arrive from the host, and when all bytes
+	written have been passed to the host.
+	They are called on the I/O thread.
+	Args:		inRxProc
+				inTxProc
+				inRefCon		passed to both procs
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CHostSerialPort::setNotify(HostSerialNotifyProc inRxProc, HostSerialNotifyProc inTxProc, void * inRefCon)
+{
+	pthread_mutex_lock(&fLock);
+	fRxNotify = inRxProc;
+	fTxNotify = inTxProc;
+	fRefCon = inRefCon;
+	pthread_mutex_unlock(&fLock);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Serial tool interface.
+----------------------------------------------------------------------------- */
+
+ArrayIndex
+CHostSerialPort::bytesAvailable(void)
+{
+	return (fMode != kHostSerialClosed) ? fRecvBuf.dataCount() : 0;
+}
+
+
+ArrayIndex
+CHostSerialPort::spaceAvailable(void)
+{
+	pthread_mutex_lock(&fLock);
+	ArrayIndex count = (fMode != kHostSerialClosed) ? fSendBuf.bufferSpace() : 0;
+	pthread_mutex_unlock(&fLock);
+	return count;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Read bytes received from the host.
+	Args:		outBuf		buffer to receive bytes
+				ioSize		on entry, size of buffer; on exit, number of bytes read
+	Return:	error code
+----------------------------------------------------------------------------- */
+
+NewtonErr
+CHostSerialPort::read(UByte * outBuf, ArrayIndex * ioSize)
+{
+	if (fMode == kHostSerialClosed)
+	{
+		*ioSize = 0;
+		return kSerErrToolNotReady;
+	}
+
+	ArrayIndex count = fRecvBuf.getn(outBuf, *ioSize);
+	*ioSize = count;
+	if (count > 0)
+	{
+		// if the buffer was full before we got from it, the I/O thread may have
+		// stopped reading -- restart it
+		// the fence pairs with the one in updateInterest(): either it sees the
+		// space we just made, or we see the put that filled the buffer
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (fRecvBuf.dataCount() + count >= fRecvBuf.getSize())
+			wake();
+	}
+	return noErr;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Write bytes to the host.
+	Args:		inBuf			bytes to write
+				ioSize		on entry, number of bytes to write; on exit, number
+								of bytes accepted, which may be fewer if the transmit
+								buffer is full
+	Return:	error code
+----------------------------------------------------------------------------- */
+
+NewtonErr
+CHostSerialPort::write(const UByte * inBuf, ArrayIndex * ioSize)
+{
+	if (fMode == kHostSerialClosed)
+	{
+		*ioSize = 0;
+		return kSerErrToolNotReady;
+	}
+
+	pthread_mutex_lock(&fLock);
+	ArrayIndex remaining = *ioSize;
+	fSendBuf.copyIn((UByte *)inBuf, &remaining);
+	pthread_mutex_unlock(&fLock);
+
+	*ioSize -= remaining;
+	if (*ioSize > 0)
+		wake();
+	return noErr;
+}
+
+
+void
+CHostSerialPort::flushInput(void)
+{
+	fRecvBuf.flush();
+	wake();
+}
+
+
+void
+CHostSerialPort::flushOutput(void)
+{
+	pthread_mutex_lock(&fLock);
+	fSendBuf.reset();
+	fIsFlushingOutput = true;		// the I/O thread owns fTxStage -- let it discard it
+	pthread_mutex_unlock(&fLock);
+	wake();
+}
+
+
+/* -----------------------------------------------------------------------------
+	Move bytes between the host and a serial tool.
+	Received bytes are read straight into the free space of the tool's receive
+	buffer; bytes in its send buffer are written as far as the transmit buffer
+	will take them. Neither buffer is touched by any other thread, so this is
+	called on the tool's task in place of the serial chip's interrupts.
+	Args:		ioRecvBuf	the tool's receive buffer
+				ioSendBuf	the tool's send buffer
+	Return:	kHostSerialReceived | kHostSerialSent
+----------------------------------------------------------------------------- */
+
+ULong
+CHostSerialPort::transfer(CCircleBuf * ioRecvBuf, CCircleBuf * ioSendBuf)
+{
+	ULong result = 0;
+	UByte * span1, * span2;
+	ArrayIndex len1, len2, count, amtMoved;
+
+	if (bytesAvailable() > 0 && ioRecvBuf->putSpans(&span1, &len1, &span2, &len2) == noErr)
+	{
+		count = len1;
+		read(span1, &count);
+		amtMoved = count;
+		if (count == len1 && len2 > 0)
+		{
+			count = len2;
+			read(span2, &count);
+			amtMoved += count;
+		}
+		if (amtMoved > 0)
+		{
+			ioRecvBuf->updateEnd(amtMoved);
+			result |= kHostSerialReceived;
+		}
+	}
+
+	if (ioSendBuf->peekSpans(&span1, &len1, &span2, &len2) == noErr)
+	{
+		count = len1;
+		write(span1, &count);
+		amtMoved = count;
+		if (count == len1 && len2 > 0)
+		{
+			count = len2;
+			write(span2, &count);
+			amtMoved += count;
+		}
+		ioSendBuf->skipBytes(amtMoved);
+		if (amtMoved > 0 && ioSendBuf->bufferCount() == 0)
+			result |= kHostSerialSent;
+	}
+
+	return result;
+}
+
+
+#pragma mark -
+/* -----------------------------------------------------------------------------
+	I / O   t h r e a d
+----------------------------------------------------------------------------- */
+
+NewtonErr
+CHostSerialPort::allocateBuffers(void)
+{
+	NewtonErr err;
+	XTRY
+	{
+		XFAILIF(fRecvBuf.init(kHostSerialBufferSize) != noErr, err = kSerErrMemoryError;)
+		XFAILIF(fSendBuf.allocate(kHostSerialBufferSize) != noErr, err = kSerErrMemoryError;)
+		fTxStageIndex = fTxStageCount = 0;
+		err = noErr;
+	}
+	XENDTRY;
+	return err;
+}
+
+
+NewtonErr
+CHostSerialPort::createEventQueue(void)
+{
+	NewtonErr err = noErr;
+	XTRY
+	{
+		XFAILIF(pipe(fWakeFd) != 0, err = kSerErrInternalError;)
+		SetNonBlocking(fWakeFd[0]);
+		SetNonBlocking(fWakeFd[1]);
+#if defined(__linux__)
+		XFAILIF((fEventFd = epoll_create1(EPOLL_CLOEXEC)) < 0, err = kSerErrInternalError;)
+#endif
+		err = watch(fWakeFd[0]);
+	}
+	XENDTRY;
+	return err;
+}
+
+
+NewtonErr
+CHostSerialPort::startIOThread(void)
+{
+	if (pthread_create(&fThread, NULL, ioThreadEntry, this) != 0)
+		return kSerErrInternalError;
+	fIsThreadRunning = true;
+	return noErr;
+}
+
+
+void
+CHostSerialPort::setConnected(bool inIsConnected)
+{
+	pthread_mutex_lock(&fLock);
+	fIsConnected = inIsConnected;
+	pthread_mutex_unlock(&fLock);
+}
+
+
+bool
+CHostSerialPort::isConnected(void)
+{
+	pthread_mutex_lock(&fLock);
+	bool isConnected = fIsConnected;
+	pthread_mutex_unlock(&fLock);
+	return isConnected;
+}
+
+
+void *
+CHostSerialPort::ioThreadEntry(void * inPort)
+{
+	((CHostSerialPort *)inPort)->ioThread();
+	return NULL;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Wake the I/O thread so it re-evaluates what it is waiting for.
+	Args:		inCommand	kQuitIOThread => make it exit
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CHostSerialPort::wake(UByte inCommand)
+{
+	if (fWakeFd[1] >= 0)
+		(void) ::write(fWakeFd[1], &inCommand, 1);
+}
+
+
+void
+CHostSerialPort::ioThread(void)
+{
+	IOEvent events[4];
+	bool isQuitting = false;
+
+	while (!isQuitting)
+	{
+		updateInterest();
+		int numOfEvents = waitForEvents(events, 4);
+		for (int i = 0; i < numOfEvents; ++i)
+		{
+			IOEvent * event = &events[i];
+			if (event->fd == fWakeFd[0])
+			{
+				UByte buf[64];
+				ssize_t count;
+				while ((count = ::read(fWakeFd[0], buf, sizeof(buf))) > 0)
+					if (memchr(buf, kQuitIOThread, count) != NULL)
+						isQuitting = true;
+			}
+			else if (event->fd == fListenFd)
+				acceptClient();
+			else if (event->fd == fDataFd)
+			{
+				if (event->isReadable || event->isHungUp)
+					receive();
+				if (event->isWritable && fDataFd >= 0)
+					transmit();
+			}
+		}
+		// there may be output queued since we last looked
+		if (!isQuitting && fDataFd >= 0 && !fIsWatchingOutput)
+			transmit();
+	}
+}
+
+
+#pragma mark -
+/* -----------------------------------------------------------------------------
+	Event multiplexing.
+	On Linux we use epoll; elsewhere poll() over our (at most three) fds.
+----------------------------------------------------------------------------- */
+
+NewtonErr
+CHostSerialPort::watch(int inFd)
+{
+#if defined(__linux__)
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = inFd;
+	if (epoll_ctl(fEventFd, EPOLL_CTL_ADD, inFd, &ev) != 0)
+		return kSerErrInternalError;
+#endif
+	if (inFd == fDataFd)
+	{
+		fIsWatchingInput = true;
+		fIsWatchingOutput = false;
+	}
+	return noErr;
+}
+
+
+void
+CHostSerialPort::unwatch(int inFd)
+{
+#if defined(__linux__)
+	epoll_ctl(fEventFd, EPOLL_CTL_DEL, inFd, NULL);
+#endif
+	if (inFd == fDataFd)
+		fIsWatchingInput = fIsWatchingOutput = false;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Only wait for input while there is room to receive it, and for output
+	while there is something to send.
+	Args:		--
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CHostSerialPort::updateInterest(void)
+{
+	if (fDataFd < 0)
+		return;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	bool wantInput = (fRecvBuf.freeCount() > 0);
+	pthread_mutex_lock(&fLock);
+	bool wantOutput = (fTxStageCount > 0 || fSendBuf.bufferCount() > 0);
+	pthread_mutex_unlock(&fLock);
+
+	if (wantInput != fIsWatchingInput || wantOutput != fIsWatchingOutput)
+	{
+#if defined(__linux__)
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = (wantInput ? (uint32_t)EPOLLIN : 0) | (wantOutput ? (uint32_t)EPOLLOUT : 0);
+		ev.data.fd = fDataFd;
+		epoll_ctl(fEventFd, EPOLL_CTL_MOD, fDataFd, &ev);
+#endif
+		fIsWatchingInput = wantInput;
+		fIsWatchingOutput = wantOutput;
+	}
+}
+
+
+int
+CHostSerialPort::waitForEvents(IOEvent * outEvents, int inMaxEvents)
+{
+	int numOfEvents = 0;
+#if defined(__linux__)
+	struct epoll_event ev[4];
+	if (inMaxEvents > 4)
+		inMaxEvents = 4;
+	int count = epoll_wait(fEventFd, ev, inMaxEvents, -1);
+	for (int i = 0; i < count; ++i)
+	{
+		outEvents[numOfEvents].fd = ev[i].data.fd;
+		outEvents[numOfEvents].isReadable = (ev[i].events & EPOLLIN) != 0;
+		outEvents[numOfEvents].isWritable = (ev[i].events & EPOLLOUT) != 0;
+		outEvents[numOfEvents].isHungUp = (ev[i].events & (EPOLLHUP | EPOLLERR)) != 0;
+		++numOfEvents;
+	}
+#else
+	struct pollfd pfd[3];
+	int numOfFds = 0;
+	pfd[numOfFds].fd = fWakeFd[0];
+	pfd[numOfFds++].events = POLLIN;
+	if (fListenFd >= 0)
+	{
+		pfd[numOfFds].fd = fListenFd;
+		pfd[numOfFds++].events = POLLIN;
+	}
+	if (fDataFd >= 0)
+	{
+		pfd[numOfFds].fd = fDataFd;
+		pfd[numOfFds++].events = (fIsWatchingInput ? POLLIN : 0) | (fIsWatchingOutput ? POLLOUT : 0);
+	}
+	if (poll(pfd, numOfFds, -1) > 0)
+	{
+		for (int i = 0; i < numOfFds && numOfEvents < inMaxEvents; ++i)
+		{
+			if (pfd[i].revents != 0)
+			{
+				outEvents[numOfEvents].fd = pfd[i].fd;
+				outEvents[numOfEvents].isReadable = (pfd[i].revents & POLLIN) != 0;
+				outEvents[numOfEvents].isWritable = (pfd[i].revents & POLLOUT) != 0;
+				outEvents[numOfEvents].isHungUp = (pfd[i].revents & (POLLHUP | POLLERR)) != 0;
+				++numOfEvents;
+			}
+		}
+	}
+#endif
+	return numOfEvents;
+}
+
+
+#pragma mark -
+/* -----------------------------------------------------------------------------
+	Host data transfer.
+	All called on the I/O thread.
+----------------------------------------------------------------------------- */
+
+void
+CHostSerialPort::acceptClient(void)
+{
+	int fd;
+	while ((fd = accept(fListenFd, NULL, NULL)) >= 0)
+	{
+		if (fDataFd >= 0)
+		{
+			// we already have a client; a serial line has only two ends
+			::close(fd);
+			continue;
+		}
+		int yes = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+		SetNonBlocking(fd);
+		fDataFd = fd;
+		watch(fDataFd);
+		setConnected(true);
+	}
+}
+
+
+void
+CHostSerialPort::dropClient(void)
+{
+	// stop watching the fd, or the I/O thread would spin on its error
+	unwatch(fDataFd);
+	CloseFd(fDataFd);
+	setConnected(false);
+	pthread_mutex_lock(&fLock);
+	fTxStageIndex = fTxStageCount = 0;
+	pthread_mutex_unlock(&fLock);
+	// a TCP client may connect again; a pty whose master has failed can't be
+	// reopened, so the port stays disconnected until it is closed
+	if (fMode == kHostSerialPTY)
+		CloseFd(fSlaveFd);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Read from the host into the receive buffer, then notify the serial tool.
+	Args:		--
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CHostSerialPort::receive(void)
+{
+	ArrayIndex amtReceived = 0;
+
+	for ( ; ; )
+	{
+		// read straight into the free space, which may wrap
+		struct iovec space[2];
+		UByte * buf1, * buf2;
+		size_t buf1Len, buf2Len;
+		fRecvBuf.computePutVectors(buf1, buf1Len, buf2, buf2Len);
+		if (buf1Len == 0)
+			break;
+		space[0].iov_base = buf1;
+		space[0].iov_len = buf1Len;
+		space[1].iov_base = buf2;
+		space[1].iov_len = buf2Len;
+
+		ssize_t count = ::readv(fDataFd, space, buf2Len > 0 ? 2 : 1);
+		if (count > 0)
+		{
+			fRecvBuf.updatePutVector(count);
+			amtReceived += count;
+		}
+		else
+		{
+			// for a pty, EIO means the host client has closed the slave -- we still hold it, so ignore
+			if (count == 0 || (errno != EAGAIN && errno != EINTR && !(fMode == kHostSerialPTY && errno == EIO)))
+				dropClient();
+			break;
+		}
+	}
+
+	if (amtReceived > 0 && fRxNotify != NULL)
+		fRxNotify(fRefCon);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Write from the transmit buffer to the host. When it empties, notify the
+	serial tool.
+	Args:		--
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CHostSerialPort::transmit(void)
+{
+	bool isDrained = false;
+	bool hasSent = false;
+
+	for ( ; ; )
+	{
+		pthread_mutex_lock(&fLock);
+		if (fIsFlushingOutput)
+		{
+			fTxStageCount = 0;
+			fIsFlushingOutput = false;
+		}
+		if (fTxStageCount == 0)
+		{
+			// refill the stage from the transmit buffer
+			ArrayIndex count = fSendBuf.bufferCount();
+			if (count > sizeof(fTxStage))
+				count = sizeof(fTxStage);
+			ArrayIndex remaining = count;
+			if (count > 0)
+				fSendBuf.copyOut(fTxStage, &remaining);
+			fTxStageIndex = 0;
+			fTxStageCount = count;
+			isDrained = (count == 0);
+		}
+		pthread_mutex_unlock(&fLock);
+		if (fTxStageCount == 0)
+			break;
+
+		ssize_t count = ::write(fDataFd, fTxStage + fTxStageIndex, fTxStageCount);
+		if (count > 0)
+		{
+			fTxStageIndex += count;
+			fTxStageCount -= count;
+			hasSent = true;
+		}
+		else
+		{
+			if (errno != EAGAIN && errno != EINTR)
+				dropClient();
+			break;
+		}
+	}
+
+	if (isDrained && hasSent && fTxNotify != NULL)
+		fTxNotify(fRefCon);
+}
@@ -0,0 +1,139 @@
+/*
+	File:		HostSerial.h
+
+	Contains:	Host serial port interface.
+					Exposes an emulated serial port to the host, either as a
+					pseudo-terminal or as a TCP socket listening on localhost,
+					so that a Newton Connection client or a test harness can talk
+					to the serial tools.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__HOSTSERIAL_H)
+#define __HOSTSERIAL_H 1
+
+#include "CircleBuf.h"
+#include "LockFreeRingBuffer.h"
+#include <pthread.h>
+
+
+/* -----------------------------------------------------------------------------
+	C H o s t S e r i a l P o r t
+	All host I/O is done on a private thread that waits on the port's file
+	descriptors (epoll on Linux, poll elsewhere) and moves bytes between them
+	and a pair of circle buffers. The serial tool reads and writes those
+	buffers; the receive buffer has just the I/O thread putting and the tool
+	getting, so it is lock-free and the I/O thread reads straight into it.
+	The notify procs are called on the I/O thread whenever bytes
+	arrive or the transmit buffer drains, in the way a serial chip would raise
+	its RxCAvail and TxBEmpty interrupts.
+----------------------------------------------------------------------------- */
+
+typedef void (*HostSerialNotifyProc)(void * inRefCon);
+
+enum EHostSerialMode
+{
+	kHostSerialClosed,
+	kHostSerialPTY,			// pseudo-terminal; name() is the slave device path
+	kHostSerialTCP				// localhost listen socket; one client at a time
+};
+
+#define kHostSerialBufferSize		(8*KByte)
+#define kWakeIOThread					0
+#define kQuitIOThread					1
+#define kHostSerialDefaultTCPPort	3679
+
+// what transfer() did
+#define kHostSerialReceived			0x01	// bytes were put in the receive buffer
+#define kHostSerialSent				0x02	// the send buffer was emptied
+
+
+class CHostSerialPort
+{
+public:
+					CHostSerialPort();
+					~CHostSerialPort();
+
+	NewtonErr	open(const char * inSpec);
+	NewtonErr	openPTY(void);
+	NewtonErr	openTCP(unsigned short inPort);
+	void			close(void);
+
+	EHostSerialMode	mode(void) const;
+	const char *		name(void) const;
+	bool					isConnected(void);
+
+	void			setNotify(HostSerialNotifyProc inRxProc, HostSerialNotifyProc inTxProc, void * inRefCon);
+
+	ArrayIndex	bytesAvailable(void);
+	ArrayIndex	spaceAvailable(void);
+	NewtonErr	read(UByte * outBuf, ArrayIndex * ioSize);
+	NewtonErr	write(const UByte * inBuf, ArrayIndex * ioSize);
+	void			flushInput(void);
+	void			flushOutput(void);
+
+	ULong			transfer(CCircleBuf * ioRecvBuf, CCircleBuf * ioSendBuf);
+
+private:
+	struct IOEvent
+	{
+		int		fd;
+		bool		isReadable;
+		bool		isWritable;
+		bool		isHungUp;
+	};
+
+	NewtonErr	allocateBuffers(void);
+	NewtonErr	createEventQueue(void);
+	NewtonErr	startIOThread(void);
+	static void *	ioThreadEntry(void * inPort);
+	void			ioThread(void);
+	void			wake(UByte inCommand = kWakeIOThread);
+	void			setConnected(bool inIsConnected);
+
+	NewtonErr	watch(int inFd);
+	void			unwatch(int inFd);
+	void			updateInterest(void);
+	int			waitForEvents(IOEvent * outEvents, int inMaxEvents);
+
+	void			acceptClient(void);
+	void			dropClient(void);
+	void			receive(void);
+	void			transmit(void);
+
+	EHostSerialMode	fMode;
+	char				fName[64];
+
+	int				fDataFd;				// pty master, or connected TCP client
+	int				fSlaveFd;			// pty slave, held open so the master doesn't hang up
+	int				fListenFd;			// TCP listen socket
+	int				fWakeFd[2];			// pipe to wake the I/O thread
+	int				fEventFd;			// epoll instance
+	bool				fIsWatchingInput;
+	bool				fIsWatchingOutput;
+
+	pthread_t		fThread;
+	bool				fIsThreadRunning;
+
+	pthread_mutex_t	fLock;			// protects fSendBuf, fTxStage and fIsConnected
+	bool				fIsConnected;
+	CLockFreeRingBuffer	fRecvBuf;	// I/O thread puts, serial tool gets
+	CCircleBuf		fSendBuf;
+	UByte				fTxStage[1*KByte];	// bytes taken from fSendBuf but not yet written to the host
+	ArrayIndex		fTxStageIndex;
+	ArrayIndex		fTxStageCount;
+	bool				fIsFlushingOutput;
+
+	HostSerialNotifyProc	fRxNotify;
+	HostSerialNotifyProc	fTxNotify;
+	void *			fRefCon;
+};
+
+inline EHostSerialMode	CHostSerialPort::mode(void) const  { return fMode; }
+inline const char *		CHostSerialPort::name(void) const  { return fName; }
+
+extern const char *	gHostSerialSpec;		// the port the serial tool should open, as for open(); NULL => none
+
+
+#endif	/* __HOSTSERIAL_H */
@@ -4,6 +4,8 @@
 #import "Platform.h"
 #import "NewtonTime.h"
 #import "UserGlobals.h"
+#import "HostSerial.h"
+#import "EventReplay.h"
 
 #define forLayerDrawing 1
 
@@ -69,6 +71,33 @@ MPWindowController * wc;
 {
 	[wc setupDrawing];
 
+	// -SerialPort pty|tcp|tcp:<port> exposes the serial port to the host
+	NSString * serialSpec = [[NSUserDefaults standardUserDefaults] stringForKey: @"SerialPort"];
+	if (serialSpec != nil)
+		gHostSerialSpec = strdup([serialSpec UTF8String]);
+
+	// -RecordEvents <log> records pen input
+	// -ReplayEvents <log> [-ReplayCaptureDir <dir>] [-ReplayGoldenDir <dir>] boots headless
+	//		on a virtual clock, replays the log, prints frame timings and quits
+	NSUserDefaults * defaults = [NSUserDefaults standardUserDefaults];
+	NSString * recordLog = [defaults stringForKey: @"RecordEvents"];
+	NSString * replayLog = [defaults stringForKey: @"ReplayEvents"];
+	if (replayLog != nil)
+	{
+		NSString * captureDir = [defaults stringForKey: @"ReplayCaptureDir"];
+		NSString * goldenDir = [defaults stringForKey: @"ReplayGoldenDir"];
+		NewtonErr err = ReplayEvents([replayLog fileSystemRepresentation],
+											  captureDir ? strdup([captureDir fileSystemRepresentation]) : NULL,
+											  goldenDir ? strdup([goldenDir fileSystemRepresentation]) : NULL);
+		if (err)
+		{
+			fprintf(stderr, "can't replay %s: %d\n", [replayLog fileSystemRepresentation], err);
+			exit(EXIT_FAILURE);
+		}
+	}
+	else if (recordLog != nil)
+		RecordEvents([recordLog fileSystemRepresentation]);
+
 	gNewtonQ = dispatch_queue_create("org.newton.messagepad", NULL);
 	gTimerQ = dispatch_queue_create("org.newton.messagepad.timer", NULL);
 
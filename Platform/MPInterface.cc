@@ -3,6 +3,7 @@
 	Objective-C interface to Newton C++.
 ------------------------------------------------------------------------------*/
 #include "TabletBuffer.h"
+#include "EventReplay.h"
 #include <thread>
 
 extern "C" void	PenDown(float inX, float inY);
@@ -10,42 +11,36 @@ extern "C" void	PenMoved(float inX, float inY);
 extern "C" void	PenUp(void);
 
 
-ARMisticeSamples gFakeTabletSamples;		// 033C0000
-
-pthread_mutex_t mutex;
+CLockFreeRingBuffer gFakeTabletSamples[kNumOfFakeTablets];		// 033C0000
+static UByte gFakeTabletSampleBuf[kNumOfFakeTablets][kFakeTabletSampleBufSize * sizeof(ULong)];
 
 void SetUpFakeTablet(void)
 {
-	int result = pthread_mutex_init(&mutex, NULL);
-// later...
-//	pthread_mutex_destroy(&mutex);
+	for (ArrayIndex i = 0; i < kNumOfFakeTablets; ++i)
+		gFakeTabletSamples[i].init(gFakeTabletSampleBuf[i], sizeof(gFakeTabletSampleBuf[i]));
 }
 
 /*------------------------------------------------------------------------------
 	A R M i s t i c e
 	Fill buffer with sample generated by host platform.
+	Each host thread puts into its own ring, so no lock is needed.
+	Args:		inSample			TabletSample.intValue
+				inTablet			kPenTabletSamples or kReplayTabletSamples
+	Return:	error code
 ------------------------------------------------------------------------------*/
 
 NewtonErr
-InsertFakeTabletSample(ULong inSample)
+InsertFakeTabletSample(ULong inSample, ArrayIndex inTablet)
 {
 	NewtonErr err = noErr;
 
-	int result = pthread_mutex_lock(&mutex);
-
-	ARMisticeSamples * samples = &gFakeTabletSamples;
-	ULong * samplePtr = samples->wrPtr;
-	*samplePtr = inSample;
-	// bump and wrap the sample pointer
-	++samplePtr;
-	if (samplePtr >= samples->bufEnd)
-		samplePtr = samples->bufStart;
-	if (samplePtr == samples->rdPtr)
+	// samples are only ever put whole, so there is either room for one or none
+	if (gFakeTabletSamples[inTablet].putn(&inSample, sizeof(ULong)) == 0)
 		err = -56006;	// Cannot add sample to buffer
-	else
-		samples->wrPtr = samplePtr;
 
-	pthread_mutex_unlock(&mutex);
+	// only live pen events are recorded; replayed ones came from a log
+	if (err == noErr && gEventRecorder && inTablet == kPenTabletSamples)
+		gEventRecorder->record(inSample);
 
 	return err;
 }
@@ -53,49 +48,40 @@ InsertFakeTabletSample(ULong inSample)
 
 /*------------------------------------------------------------------------------
 	A R M i s t i c e
-	Insert samples from buffer filled by host platform.
+	Insert samples from buffers filled by host platform.
+	Each ring is taken in turn; samples from one thread stay in order, and
+	only one thread puts at a time in practice -- the replayer drives the
+	pen while the UI's is idle.
 ------------------------------------------------------------------------------*/
 
 void
 InsertArmisticeSamples(void)
 {
-	int result = pthread_mutex_lock(&mutex);
-	for (bool isDone = false; !isDone; )
+	for (ArrayIndex tablet = 0; tablet < kNumOfFakeTablets; ++tablet)
 	{
-//		bool isLocked = false;
-		newton_try
+		CLockFreeRingBuffer * samplesBuf = &gFakeTabletSamples[tablet];
+		for (bool isDone = false; !isDone; )
 		{
-			// read sample from ARMistice buffer
-			ARMisticeSamples * samples = &gFakeTabletSamples;	//0x03380000->x04
-			// do 10 at a time
-			int count = 9;
-			// iterate over available samples
-			for (ULong * samplePtr = samples->rdPtr; samplePtr != samples->wrPtr & count >= 0; )
+			newton_try
 			{
-//				if (!isLocked)
+				// read samples from ARMistice buffer, 10 at a time
+				ULong samples[10];
+				size_t numOfSamples = samplesBuf->peekn(samples, sizeof(samples)) / sizeof(ULong);
+				for (size_t i = 0; i < numOfSamples; ++i)
 				{
-					NewtonErr err = InsertAndSendTabletSample(*samplePtr, 0);
-					if (err == noErr) {
-						--count;
-					} else if (err == -1) {	// there may be an err, but -1 can never happen
+					NewtonErr err = InsertAndSendTabletSample(samples[i], 0);
+					if (err == -1)	// there may be an err, but -1 can never happen
 						break;
-					}
+					// only consume the sample once it is in -- if that throws it will be retried
+					samplesBuf->skip(sizeof(ULong));
 				}
-				// bump and wrap the sample pointer
-//				isLocked = true;
-				++samplePtr;
-				if (samplePtr >= samples->bufEnd)
-					samplePtr = samples->bufStart;
-				samples->rdPtr = samplePtr;
-//				isLocked = false;
+				isDone = true;
 			}
-			isDone = true;
+			newton_catch(exAbort)
+			{ }
+			end_try;
 		}
-		newton_catch(exAbort)
-		{ }
-		end_try;
 	}
-	pthread_mutex_unlock(&mutex);
 }
 
 
@@ -110,7 +96,7 @@ PenDown(float inX, float inY)
 	TabletSample sample;
 	sample.intValue = kPenDownSample;
 //printf("PenDown(x=%f,y=%f)\n",inX,inY);
-	err = InsertFakeTabletSample(sample.intValue);
+	err = InsertFakeTabletSample(sample.intValue, kPenTabletSamples);
 	PenMoved(inX, inY);
 }
 
@@ -124,7 +110,7 @@ PenMoved(float inX, float inY)
 	sample.y = inY;
 	sample.z = kPenMidPressureSample;
 //printf("PenMoved(x=%f,y=%f)\n",inX,inY);
-	err = InsertFakeTabletSample(sample.intValue);
+	err = InsertFakeTabletSample(sample.intValue, kPenTabletSamples);
 }
 
 
@@ -135,6 +121,6 @@ PenUp(void)
 	TabletSample sample;
 	sample.intValue = kPenUpSample;
 //printf("PenUp()\n");
-	err = InsertFakeTabletSample(sample.intValue);
+	err = InsertFakeTabletSample(sample.intValue, kPenTabletSamples);
 }
 
@@ -639,11 +639,9 @@ CInker::iInker(void)
 		{
 			newton_try
 			{
-				ARMisticeSamples * samples = &gFakeTabletSamples;
-				samples->wrPtr = gFakeTabletSamples.buf;
-				samples->rdPtr = gFakeTabletSamples.buf;
-				samples->bufStart = gFakeTabletSamples.buf;
-				samples->bufEnd = gFakeTabletSamples.buf + kFakeTabletSampleBufSize;
+				// we are the consumer, so can empty them even while the host puts
+				for (ArrayIndex i = 0; i < kNumOfFakeTablets; ++i)
+					gFakeTabletSamples[i].flush();
 				done = true;
 //				0x03380000->x04 = samples;
 			}
@@ -11,6 +11,7 @@
 
 #include "TabletTypes.h"
 #include "NewtonTime.h"
+#include "LockFreeRingBuffer.h"
 
 class CUPort;
 
@@ -42,15 +43,15 @@ bool			StrokerBufferEmpty(void);
 
 
 // tablet samples generated by ARMistice card
+// each host thread that puts ULong samples has a ring of its own, so every ring
+// has one producer; the inker task is the one consumer of them all
 #define kFakeTabletSampleBufSize 128
-struct ARMisticeSamples
+enum
 {
-	ULong * wrPtr;
-	ULong * rdPtr;
-	ULong * bufStart;
-	ULong * bufEnd;
-	ULong buf[kFakeTabletSampleBufSize];
+	kPenTabletSamples,			// the UI thread's pen events
+	kReplayTabletSamples,		// the event replayer's
+	kNumOfFakeTablets
 };
-extern ARMisticeSamples gFakeTabletSamples;		// 033C0000
+extern CLockFreeRingBuffer gFakeTabletSamples[kNumOfFakeTablets];		// 033C0000
 
 #endif	/* __TABLETBUFFER_H */
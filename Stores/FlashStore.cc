@@ -15,6 +15,7 @@
 #include "RDM.h"
 #include "FlashStore.h"
 #include "FlashIterator.h"
+#include "KernelTrace.h"
 #include "OSErrors.h"
 extern void DumpHex(void * inBuf, size_t inLen);
 
@@ -1311,6 +1312,7 @@ CFlashStore::unlockStore(void)
 	if (fLockCount == 1 && fIsInTransaction)
 	{
 		vppOn();
+		TraceEvent(kTraceCommitBegin);
 		newton_try
 		{
 			markCommitPoint();
@@ -1324,6 +1326,7 @@ CFlashStore::unlockStore(void)
 			fObjListTail = NULL;
 		}
 		end_try;
+		TraceEvent(kTraceCommitEnd);
 		vppOff();
 	}
 
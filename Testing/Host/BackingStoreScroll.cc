@@ -0,0 +1,263 @@
+/*
+	File:		BackingStoreScroll.cc
+
+	Contains:	Backing store scroll benchmark.
+					Builds Views/BackingStore.cc on SoftQuartz and scrolls a list
+					of notes, each a framed paper with rich ink on it -- strokes
+					drawn as DrawInk.cc draws them -- up a 4-bit screen, a few
+					pixels a frame. First every note is drawn from its content
+					every frame, as views were; then each note is drawn once into
+					a backing store and copied to the screen after that. The
+					screens must match pixel for pixel after every frame; the
+					times are printed for comparison.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "BackingStore.h"
+#include "Regions.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define kNumOfNotes			12
+#define kNoteWidth			300
+#define kNoteHeight			140
+#define kNoteSpacing			150
+#define kNumOfStrokes		60
+#define kNumOfStrokePts		40
+#define kNumOfFrames			200
+#define kScrollStep			6
+
+
+// QDDrawing.cc brings in the whole object system, so just this from it
+Ptr
+PixelMapBits(const NativePixelMap * inPixmap)
+{
+	return (Ptr)inPixmap->baseAddr;
+}
+
+// Exceptions.cc doesn't build here; regions only throw when out of memory
+DefineException(exOutOfMemory, evt.ex.outofmem);
+extern "C" {
+void	AddExceptionHandler(CatchHeader * inHandler) { }
+void	RemoveExceptionHandler(CatchHeader * inHandler) { }
+void	Throw(ExceptionName inName, void * inData, ExceptionDestructor inDestructor) { abort(); }
+}
+
+// Screen.cc's, for a portrait screen
+CGContextRef		quartz;
+int					gScreenWidth = 320;
+int					gScreenHeight = 480;
+NativePixelMap		gScreenPixelMap;
+CGColorRef			gWhiteColor;
+
+// QDDrawing.cc's
+CGRect
+MakeCGRect(Rect inRect)
+{
+	return CGRectMake(inRect.left, gScreenHeight - inRect.bottom, RectGetWidth(inRect), RectGetHeight(inRect));
+}
+
+
+static double
+Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/* -----------------------------------------------------------------------------
+	A note: a paper with ruled lines and ink strokes in note coordinates.
+----------------------------------------------------------------------------- */
+
+struct Note
+{
+	CGPoint			pts[kNumOfStrokes][kNumOfStrokePts];
+	CBackingStore	store;
+};
+
+
+static void
+MakeInk(Note * outNote, unsigned int * ioSeed)
+{
+	for (ArrayIndex i = 0; i < kNumOfStrokes; ++i)
+	{
+		// handwriting: a wandering stroke starting on one of the lines
+		double x = 10 + rand_r(ioSeed) % (kNoteWidth - 60);
+		double y = 20 + (rand_r(ioSeed) % 6) * 20;
+		double angle = (rand_r(ioSeed) % 628) / 100.0;
+		for (ArrayIndex j = 0; j < kNumOfStrokePts; ++j)
+		{
+			angle += ((int)(rand_r(ioSeed) % 120) - 60) / 100.0;
+			x += cos(angle) * 1.5;
+			y += sin(angle) * 1.5;
+			x = MIN(MAX(x, 4), kNoteWidth - 4);
+			y = MIN(MAX(y, 4), kNoteHeight - 4);
+			// ink points are whole pixels
+			outNote->pts[i][j] = CGPointMake(floor(x), floor(y));
+		}
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	Draw a note from its content, as its view would.
+	Args:		inNote			the note
+				inBounds			where the view is
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+DrawNote(const Note * inNote, const Rect * inBounds)
+{
+	// the paper
+	CGContextSetGrayFillColor(quartz, 1.0, 1.0);
+	CGContextFillRect(quartz, MakeCGRect(*inBounds));
+	CGContextSetGrayStrokeColor(quartz, 0.0, 1.0);
+	CGContextSetLineWidth(quartz, 1.0);
+	CGContextStrokeRect(quartz, CGRectInset(MakeCGRect(*inBounds), 0.5, 0.5));
+	CGContextSetGrayStrokeColor(quartz, 0.67, 1.0);
+	for (int y = inBounds->top + 20; y < inBounds->bottom; y += 20)
+	{
+		CGContextBeginPath(quartz);
+		CGContextMoveToPoint(quartz, inBounds->left + 4, gScreenHeight - y + 0.5);
+		CGContextAddLineToPoint(quartz, inBounds->right - 4, gScreenHeight - y + 0.5);
+		CGContextStrokePath(quartz);
+	}
+
+	// the ink, as DrawInk.cc draws a stroke
+	CGPoint pts[kNumOfStrokePts];
+	CGContextSetGrayStrokeColor(quartz, 0.0, 1.0);
+	CGContextSetLineWidth(quartz, 2.0);
+	CGContextSetLineJoin(quartz, kCGLineJoinBevel);
+	for (ArrayIndex i = 0; i < kNumOfStrokes; ++i)
+	{
+		for (ArrayIndex j = 0; j < kNumOfStrokePts; ++j)
+			pts[j] = CGPointMake(inBounds->left + inNote->pts[i][j].x, gScreenHeight - (inBounds->top + inNote->pts[i][j].y));
+		CGContextBeginPath(quartz);
+		CGContextAddLines(quartz, pts, kNumOfStrokePts);
+		CGContextStrokePath(quartz);
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+	Draw a note from its backing store, drawing that first if need be --
+	as CView::draw does for a view with vfBackingStore.
+	Args:		ioNote			the note
+				inBounds			where the view is
+	Return:	--
+------------------------------------------------------------------------------*/
+
+static void
+DrawNoteFromStore(Note * ioNote, const Rect * inBounds)
+{
+	if (!ioNote->store.isValid(inBounds))
+	{
+		if (!ioNote->store.beginDrawing(inBounds))
+		{
+			DrawNote(ioNote, inBounds);
+			return;
+		}
+		DrawNote(ioNote, inBounds);
+		ioNote->store.endDrawing();
+	}
+	ioNote->store.draw(inBounds);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Scroll the list.
+----------------------------------------------------------------------------- */
+
+static void
+NoteBounds(ArrayIndex inIndex, int inScroll, Rect * outBounds)
+{
+	int top = 10 + inIndex * kNoteSpacing - inScroll;
+	SetRect(outBounds, 10, top, 10 + kNoteWidth, top + kNoteHeight);
+}
+
+
+static void
+DrawFrame(Note * inNotes, int inScroll, bool inUseStore)
+{
+	CGContextSetGrayFillColor(quartz, 1.0, 1.0);
+	CGContextFillRect(quartz, CGRectMake(0, 0, gScreenWidth, gScreenHeight));
+	for (ArrayIndex i = 0; i < kNumOfNotes; ++i)
+	{
+		Rect bounds;
+		NoteBounds(i, inScroll, &bounds);
+		if (bounds.bottom <= 0 || bounds.top >= gScreenHeight)
+			continue;
+		if (inUseStore)
+			DrawNoteFromStore(&inNotes[i], &bounds);
+		else
+			DrawNote(&inNotes[i], &bounds);
+	}
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	gScreenPixelMap.rowBytes = gScreenWidth * 4 / 8;
+	SetRect(&gScreenPixelMap.bounds, 0, 0, gScreenWidth, gScreenHeight);
+	gScreenPixelMap.pixMapFlags = kPixMapPtr + 4;
+	gScreenPixelMap.deviceRes.h = gScreenPixelMap.deviceRes.v = 0;
+	gScreenPixelMap.grayTable = NULL;
+	size_t screenSize = gScreenPixelMap.rowBytes * gScreenHeight;
+	gWhiteColor = CGColorCreateGenericGray(1.0, 1.0);
+
+	// one screen drawn from content, the other from backing stores
+	NativePixelMap referencePixMap = gScreenPixelMap;
+	referencePixMap.baseAddr = (Ptr)calloc(screenSize, 1);
+	gScreenPixelMap.baseAddr = (Ptr)calloc(screenSize, 1);
+	UByte * frames = (UByte *)malloc(screenSize * kNumOfFrames);
+	CGContextRef referenceContext = CGPixelMapContextCreate(&referencePixMap);
+	CGContextRef screenContext = CGPixelMapContextCreate(&gScreenPixelMap);
+
+	static Note notes[kNumOfNotes];
+	unsigned int seed = 36;
+	for (ArrayIndex i = 0; i < kNumOfNotes; ++i)
+		MakeInk(&notes[i], &seed);
+
+	quartz = referenceContext;
+	double startTime = Seconds();
+	for (ArrayIndex frame = 0; frame < kNumOfFrames; ++frame)
+	{
+		DrawFrame(notes, frame * kScrollStep, false);
+		memcpy(frames + frame * screenSize, referencePixMap.baseAddr, screenSize);
+	}
+	double contentTime = Seconds() - startTime;
+
+	quartz = screenContext;
+	ArrayIndex numOfDifferences = 0;
+	startTime = Seconds();
+	for (ArrayIndex frame = 0; frame < kNumOfFrames; ++frame)
+	{
+		DrawFrame(notes, frame * kScrollStep, true);
+		if (memcmp(frames + frame * screenSize, gScreenPixelMap.baseAddr, screenSize) != 0)
+		{
+			if (numOfDifferences++ == 0)
+				fprintf(stderr, "frame %u differs\n", frame);
+		}
+	}
+	double storeTime = Seconds() - startTime;
+	CHECK(quartz == screenContext);
+	CHECK(!CBackingStore::isDrawing());
+	CHECK(numOfDifferences == 0);
+
+	printf("%d frames scrolling %d inked notes: %.3fs -> %.3fs, %.0f -> %.0f frames/s\n",
+				kNumOfFrames, kNumOfNotes, contentTime, storeTime, kNumOfFrames / contentTime, kNumOfFrames / storeTime);
+
+	CGContextRelease(referenceContext);
+	CGContextRelease(screenContext);
+	free(frames);
+	return TestResult("BackingStoreScroll");
+}
@@ -0,0 +1,216 @@
+/*
+	File:		ContextSwitch.cc
+
+	Contains:	Context switch benchmark and task statistics test.
+					Two tasks on the host kernel (see HostKernel.h) play ping-pong
+					through a port: each RPC switches to the echo task and back.
+					Times the round trips, and checks that the scheduler's
+					per-task statistics account for them -- every switch in is
+					counted, and no task runs or waits longer than the test.
+					Then times finding the highest runnable priority in the
+					scheduler's priority mask by counting leading zeros against
+					the loop that tested it a bit at a time.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostKernel.h"
+#include "UserTasks.h"
+#include "UserPorts.h"
+#include "Semaphore.h"
+#include "Scheduler.h"
+#include "OSErrors.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#define kNumOfRPCs				100000
+#define kNumOfMasks				4096
+#define kNumOfSelections		1000
+#define kTaskStackSize			(16*KByte)
+
+#define kEchoMsgType				0x01
+#define kQuitMsgType				0x02
+
+extern bool		gCountTaskTime;
+
+
+static double
+Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/* -----------------------------------------------------------------------------
+	The echo task.
+	Replies to each message until told to quit.
+----------------------------------------------------------------------------- */
+
+static void
+EchoTask(void * inData, size_t inSize, ObjectId inTaskId)
+{
+	CUPort		port(*(ObjectId *)inData);
+	CUMsgToken	token;
+	ULong			msg, msgType;
+	size_t		msgSize;
+
+	for ( ; ; )
+	{
+		CHECK(port.receive(&msgSize, &msg, sizeof(msg), &token, &msgType) == noErr);
+		token.replyRPC(&msg, sizeof(msg));
+		if (msgType == kQuitMsgType)
+			break;
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Ping-pong.
+----------------------------------------------------------------------------- */
+
+static void
+PingPong(ObjectId inTestTaskId)
+{
+	CUPort			echoPort;
+	static CUTask	echoTask;
+	ObjectId			echoPortId;
+	TaskStatistics	testStats, echoStats;
+
+	CHECK(echoPort.init() == noErr);
+	echoPortId = echoPort;
+	CTime			startTime = GetGlobalTime();
+	gCountTaskTime = true;
+	CHECK(echoTask.init(EchoTask, kTaskStackSize, sizeof(echoPortId), &echoPortId, kUserTaskPriority, 'echo') == noErr);
+	CHECK(echoTask.start() == noErr);
+
+	ArrayIndex	numOfMismatches = 0;
+	double		startSeconds = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfRPCs; ++i)
+	{
+		ULong		msg = i, reply = 0;
+		size_t	replySize;
+		if (echoPort.sendRPC(&replySize, &msg, sizeof(msg), &reply, sizeof(reply), kNoTimeout, kEchoMsgType) != noErr
+		||  reply != i)
+			numOfMismatches++;
+	}
+	double		elapsedSeconds = Seconds() - startSeconds;
+	CHECK(numOfMismatches == 0);
+
+	// the echo task is waiting for the next ping, so its statistics are settled
+	CHECK(GetTaskStatistics(echoTask, &echoStats) == noErr);
+	CHECK(GetTaskStatistics(inTestTaskId, &testStats) == noErr);
+	// CTime arithmetic works in place, so sum them as plain numbers
+	int64_t		elapsed = GetGlobalTime() - startTime;
+
+	// each round trip switches the echo task in, and us back in
+	CHECK(echoStats.switches >= kNumOfRPCs && echoStats.switches <= kNumOfRPCs + 2);
+	CHECK(testStats.switches >= kNumOfRPCs);
+	CHECK(echoStats.runTime > CTime(0) && testStats.runTime > CTime(0));
+	CHECK((int64_t)echoStats.runTime + (int64_t)testStats.runTime <= elapsed);
+	// and whoever isn't running is mostly waiting for a reply, not to run
+	CHECK((int64_t)echoStats.waitTime + (int64_t)testStats.waitTime < elapsed);
+
+	CHECK(GetTaskStatistics(kNoId, &echoStats) == kOSErrTaskDoesNotExist);
+
+	size_t	replySize;
+	ULong		msg = 0;
+	CHECK(echoPort.sendRPC(&replySize, &msg, sizeof(msg), &msg, sizeof(msg), kNoTimeout, kQuitMsgType) == noErr);
+	gCountTaskTime = false;
+
+	printf("%d round trips: %.3fs, %.2fus per switch; echo task ran %luus, waited %luus\n",
+				kNumOfRPCs, elapsedSeconds, elapsedSeconds * 1e6 / (2 * kNumOfRPCs),
+				(unsigned long)CTime(echoStats.runTime).convertTo(kMicroseconds),
+				(unsigned long)CTime(echoStats.waitTime).convertTo(kMicroseconds));
+}
+
+
+/* -----------------------------------------------------------------------------
+	Priority selection.
+	The highest priority with tasks queued, found as CScheduler::
+	updateCurrentBucket did -- down from the last highest a bit at a time --
+	and as it does now.
+----------------------------------------------------------------------------- */
+
+static ULong
+OldHighestPriority(ULong inMask, ULong inHighestPriority)
+{
+	if (inHighestPriority > 0)
+	{
+		for (ArrayIndex i = inHighestPriority - 1; i > 0; i--)
+			if (inMask & BIT(i))
+				return i;
+	}
+	return 0;
+}
+
+static ULong
+NewHighestPriority(ULong inMask)
+{
+	return (inMask != 0) ? 31 - __builtin_clz(inMask) : 0;
+}
+
+
+static void
+PrioritySelection(void)
+{
+	static ULong	masks[kNumOfMasks];
+	unsigned int	seed = 1;
+	ArrayIndex		numOfMismatches = 0;
+	ULong				sum;
+	double			startTime, oldTime, newTime;
+
+	// as the scheduler has it: the last highest priority has just emptied,
+	// and a few lower ones -- the idle task's, at 0, among them -- have tasks queued
+	for (ArrayIndex i = 0; i < kNumOfMasks; ++i)
+		masks[i] = rand_r(&seed) & rand_r(&seed) & rand_r(&seed) & 0x7FFFFFFE;
+	for (ArrayIndex i = 0; i < kNumOfMasks; ++i)
+	{
+		if (OldHighestPriority(masks[i], 31) != NewHighestPriority(masks[i]))
+			numOfMismatches++;
+	}
+	CHECK(numOfMismatches == 0);
+
+	sum = 0;
+	startTime = Seconds();
+	for (ArrayIndex n = 0; n < kNumOfSelections; ++n)
+		for (ArrayIndex i = 0; i < kNumOfMasks; ++i)
+			sum += OldHighestPriority(masks[i], 31);
+	oldTime = Seconds() - startTime;
+
+	startTime = Seconds();
+	for (ArrayIndex n = 0; n < kNumOfSelections; ++n)
+		for (ArrayIndex i = 0; i < kNumOfMasks; ++i)
+			sum -= NewHighestPriority(masks[i]);
+	newTime = Seconds() - startTime;
+	CHECK(sum == 0);
+
+	printf("%d selections: %.3fs -> %.3fs\n", kNumOfMasks * kNumOfSelections, oldTime, newTime);
+}
+
+
+/* -----------------------------------------------------------------------------
+	The test task.
+----------------------------------------------------------------------------- */
+
+static void
+TestTask(void * inData, size_t inSize, ObjectId inTaskId)
+{
+	CHECK(CULockingSemaphore::staticInit() == noErr);
+
+	PingPong(inTaskId);
+	PrioritySelection();
+
+	fflush(stderr);
+	exit(TestResult("ContextSwitch"));
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	BootHostKernel(TestTask, kTaskStackSize);
+	return 1;
+}
@@ -0,0 +1,272 @@
+/*
+	File:		FrameBufferBlit.cc
+
+	Contains:	Frame buffer blit test and benchmark.
+					Builds Graphics/FrameBuffer.cc and blits random 4-bit pixmaps
+					through random dirty rects onto a frame buffer of random
+					pixels, in all four orientations with modeCopy and modeOr.
+					Every pixel of the frame buffer is checked against a plain
+					implementation that moves one pixel at a time: inside the
+					update (rounded out to bytes in landscape, to 8x8 tiles in
+					portrait) it must be the image's, outside it must be left as
+					it was. Then times full-screen blits in each orientation
+					against that implementation.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "FrameBuffer.h"
+#include "Geometry.h"
+#include "Screen.h"
+#include "ViewFlags.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define kScreenWidth			480		// the LCD, landscape
+#define kScreenHeight		320
+#define kNumOfBlits			2000
+#define kNumOfTimedBlits	1000
+
+
+// QDDrawing.cc brings in the whole object system, so just this from it
+Ptr
+PixelMapBits(const NativePixelMap * inPixmap)
+{
+	return (Ptr)inPixmap->baseAddr;
+}
+
+
+static double
+Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+static const char * kOrientationName[4] = { "portrait", "landscape", "portrait flip", "landscape flip" };
+
+
+/* -----------------------------------------------------------------------------
+	4-bit pixel maps, leftmost pixel in the high nibble.
+----------------------------------------------------------------------------- */
+
+static void
+InitPixmap(NativePixelMap * outPixmap, int inWidth, int inHeight)
+{
+	outPixmap->rowBytes = inWidth / 2;
+	outPixmap->baseAddr = (Ptr)malloc(outPixmap->rowBytes * inHeight);
+	SetRect(&outPixmap->bounds, 0, 0, inWidth, inHeight);
+	outPixmap->pixMapFlags = kPixMapPtr + 4;
+	outPixmap->deviceRes.h = outPixmap->deviceRes.v = 0;
+	outPixmap->grayTable = NULL;
+}
+
+
+static void
+FillRandom(NativePixelMap * ioPixmap, unsigned int * ioSeed)
+{
+	size_t size = ioPixmap->rowBytes * RectGetHeight(ioPixmap->bounds);
+	for (size_t i = 0; i < size; ++i)
+		ioPixmap->baseAddr[i] = rand_r(ioSeed);
+}
+
+
+static inline int
+GetPixel(const NativePixelMap * inPixmap, int x, int y)
+{
+	UByte bits = ((UByte *)inPixmap->baseAddr)[y * inPixmap->rowBytes + x/2];
+	return (x & 1) ? bits & 0x0F : bits >> 4;
+}
+
+
+static inline void
+SetPixel(NativePixelMap * ioPixmap, int x, int y, int inValue)
+{
+	UByte * bits = (UByte *)ioPixmap->baseAddr + y * ioPixmap->rowBytes + x/2;
+	if (x & 1)
+		*bits = (*bits & 0xF0) | inValue;
+	else
+		*bits = (*bits & 0x0F) | (inValue << 4);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Where screen pixel (x,y) is in the frame buffer.
+----------------------------------------------------------------------------- */
+
+static inline void
+FrameBufferPixel(int inOrientation, int x, int y, int * outX, int * outY)
+{
+	switch (inOrientation)
+	{
+	case kPortrait:
+		*outX = kScreenWidth - 1 - y;  *outY = x;
+		break;
+	case kPortraitFlip:
+		*outX = y;  *outY = kScreenHeight - 1 - x;
+		break;
+	case kLandscapeFlip:
+		*outX = kScreenWidth - 1 - x;  *outY = kScreenHeight - 1 - y;
+		break;
+	default:	// kLandscape
+		*outX = x;  *outY = y;
+		break;
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	The part of the screen a blit updates.
+	Landscape moves whole bytes of the image across -- whole longs, in fact,
+	but four-byte runs start on a byte boundary, so rounding the columns out
+	to eight pixels covers them. Portrait moves whole 8x8 tiles, clipped to
+	the screen.
+----------------------------------------------------------------------------- */
+
+static void
+UpdatedRect(int inOrientation, const Rect * inBounds, Rect * outRect)
+{
+	outRect->left = inBounds->left & ~0x07;
+	outRect->right = (inBounds->right + 7) & ~0x07;
+	outRect->top = inBounds->top;
+	outRect->bottom = inBounds->bottom;
+	if (inOrientation == kPortrait || inOrientation == kPortraitFlip)
+	{
+		outRect->top &= ~0x07;
+		outRect->bottom = (outRect->bottom + 7) & ~0x07;
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Blit a pixel at a time.
+----------------------------------------------------------------------------- */
+
+static void
+SlowBlit(NativePixelMap * inPixmap, const Rect * inBounds, int inTransferMode, NativePixelMap * inFrameBuffer, int inOrientation)
+{
+	Rect updated;
+	UpdatedRect(inOrientation, inBounds, &updated);
+	for (int y = updated.top; y < updated.bottom; ++y)
+	{
+		for (int x = updated.left; x < updated.right; ++x)
+		{
+			int fbx, fby;
+			FrameBufferPixel(inOrientation, x, y, &fbx, &fby);
+			int pixel = GetPixel(inPixmap, x, y);
+			if (inTransferMode != modeCopy)
+				pixel |= GetPixel(inFrameBuffer, fbx, fby);
+			SetPixel(inFrameBuffer, fbx, fby, pixel);
+		}
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Random dirty rects, every tenth the whole screen.
+----------------------------------------------------------------------------- */
+
+static void
+RandomRect(int inWidth, int inHeight, ArrayIndex inIndex, unsigned int * ioSeed, Rect * outRect)
+{
+	if (inIndex % 10 == 0)
+	{
+		SetRect(outRect, 0, 0, inWidth, inHeight);
+		return;
+	}
+	int x0 = rand_r(ioSeed) % inWidth, x1 = rand_r(ioSeed) % inWidth;
+	int y0 = rand_r(ioSeed) % inHeight, y1 = rand_r(ioSeed) % inHeight;
+	SetRect(outRect, MIN(x0, x1), MIN(y0, y1), MAX(x0, x1) + 1, MAX(y0, y1) + 1);
+}
+
+
+static void
+CheckBlits(int inOrientation)
+{
+	bool isPortrait = (inOrientation == kPortrait || inOrientation == kPortraitFlip);
+	int width = isPortrait ? kScreenHeight : kScreenWidth;
+	int height = isPortrait ? kScreenWidth : kScreenHeight;
+	NativePixelMap frameBuffer, expected, image;
+	InitPixmap(&frameBuffer, kScreenWidth, kScreenHeight);
+	InitPixmap(&expected, kScreenWidth, kScreenHeight);
+	InitPixmap(&image, width, height);
+	size_t fbSize = frameBuffer.rowBytes * kScreenHeight;
+	unsigned int seed = 1 + inOrientation;
+
+	ArrayIndex numOfFailures = 0;
+	for (ArrayIndex i = 0; i < kNumOfBlits; ++i)
+	{
+		int mode = (i & 1) ? modeOr : modeCopy;
+		Rect bounds;
+		RandomRect(width, height, i, &seed, &bounds);
+		FillRandom(&image, &seed);
+		FillRandom(&frameBuffer, &seed);
+		memcpy(expected.baseAddr, frameBuffer.baseAddr, fbSize);
+
+		BlitFrameBuffer(&image, &bounds, &bounds, mode, &frameBuffer, inOrientation);
+		SlowBlit(&image, &bounds, mode, &expected, inOrientation);
+		if (memcmp(frameBuffer.baseAddr, expected.baseAddr, fbSize) != 0)
+		{
+			if (numOfFailures++ == 0)
+				fprintf(stderr, "%s, %s, {%d,%d,%d,%d}: frame buffer differs\n", kOrientationName[inOrientation],
+								mode == modeCopy ? "modeCopy" : "modeOr", bounds.left, bounds.top, bounds.right, bounds.bottom);
+		}
+	}
+	CHECK(numOfFailures == 0);
+
+	free(frameBuffer.baseAddr);
+	free(expected.baseAddr);
+	free(image.baseAddr);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Full-screen blits per second.
+----------------------------------------------------------------------------- */
+
+static void
+TimeBlits(int inOrientation)
+{
+	bool isPortrait = (inOrientation == kPortrait || inOrientation == kPortraitFlip);
+	int width = isPortrait ? kScreenHeight : kScreenWidth;
+	int height = isPortrait ? kScreenWidth : kScreenHeight;
+	NativePixelMap frameBuffer, image;
+	InitPixmap(&frameBuffer, kScreenWidth, kScreenHeight);
+	InitPixmap(&image, width, height);
+	unsigned int seed = 1;
+	FillRandom(&image, &seed);
+	Rect bounds;
+	SetRect(&bounds, 0, 0, width, height);
+
+	double startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfTimedBlits / 10; ++i)
+		SlowBlit(&image, &bounds, modeCopy, &frameBuffer, inOrientation);
+	double slowTime = (Seconds() - startTime) * 10;
+
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfTimedBlits; ++i)
+		BlitFrameBuffer(&image, &bounds, &bounds, modeCopy, &frameBuffer, inOrientation);
+	double newTime = Seconds() - startTime;
+
+	printf("%s: %.0f -> %.0f full-screen blits/s\n", kOrientationName[inOrientation],
+				kNumOfTimedBlits / slowTime, kNumOfTimedBlits / newTime);
+
+	free(frameBuffer.baseAddr);
+	free(image.baseAddr);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	for (int orientation = kPortrait; orientation <= kLandscapeFlip; ++orientation)
+		CheckBlits(orientation);
+	for (int orientation = kPortrait; orientation <= kLandscapeFlip; ++orientation)
+		TimeBlits(orientation);
+	return TestResult("FrameBufferBlit");
+}
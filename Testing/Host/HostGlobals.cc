@@ -0,0 +1,15 @@
+/*
+	File:		HostGlobals.cc
+
+	Contains:	The task globals the parts of the tree host tests build expect
+					to find. Tests that build the kernel get them from there.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "TaskGlobals.h"
+
+// there are no tasks here, so there is just the one set of task globals
+static TaskGlobals	gTaskGlobals;
+void *	gCurrentGlobals = &gTaskGlobals + 1;
@@ -0,0 +1,413 @@
+/*
+	File:		HostKernel.cc
+
+	Contains:	A host kernel for tests.
+					The tasks, ports, semaphores, monitors, shared memory and the
+					object manager that creates them are the kernel's own, linked
+					with the portable SWI handler; what is here stands in for what
+					they need of the rest of the system. There is one environment
+					and no VM -- stacks are HostStacks, as they are in the app --
+					the clock is the host's, and the only interrupt is the timer,
+					which the idle task fires when it falls due.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostKernel.h"
+#include "TaskGlobals.h"
+#include "KernelTasks.h"
+#include "KernelGlobals.h"
+#include "KernelObjects.h"
+#include "KernelTrace.h"
+#include "UserGlobals.h"
+#include "UserMonitor.h"
+#include "UserPorts.h"
+#include "Environment.h"
+#include "KernelPhys.h"
+#include "PageManager.h"
+#include "MemObjManager.h"
+#include "Timers.h"
+#include "VirtualMemory.h"
+#include "SWI.h"
+#include "OSErrors.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+
+/* -----------------------------------------------------------------------------
+	D a t a
+	Defined in parts of the kernel that aren't built here.
+----------------------------------------------------------------------------- */
+
+ULong						gCPSR = kUserMode;
+bool						gCountTaskTime = false;
+bool						gKernelTraceOn = false;
+CTimerEngine *			gTimerEngine;
+CDoubleQContainer *	gTimerDeferred;
+CExtPageTrackerMgr *	gExtPageTrackerMgr;
+CObjectTable *			gTheMemArchObjTbl;
+
+ArrayIndex	gHandlesUsed;
+ArrayIndex	gPtrsUsed;
+ArrayIndex	gSavedHandlesUsed;
+ArrayIndex	gSavedPtrsUsed;
+
+// what the name server answers gestalt requests with
+SGlobalsThatLiveAcrossReboot	gGlobalsThatLiveAcrossReboot;
+ULong		gHardwareType;
+ULong		gROMManufacturer;
+ULong		gROMVersion;
+ULong		gROMStage;
+ULong		gMainCPUType;
+float		gMainCPUClockSpeed;
+ULong		gManufDate;
+ULong		gNewtonScriptVersion;
+
+static ObjectId		gKernelEnvironmentId;
+static int64_t			gAlarmTime;			// 0 => none
+static Heap				gHeap;
+
+extern NewtonErr		InitGlobalWorld(void);
+extern void				InitInterruptTables(void);
+extern void				HInitInterrupts(void);
+extern void				TimerInterruptHandler(void * inQueue);
+extern "C" NewtonErr	DoSchedulerSWI(void);
+
+
+/* -----------------------------------------------------------------------------
+	Environments and domains.
+	There is just the one environment, with no domains in it: everything can
+	get at everything.
+----------------------------------------------------------------------------- */
+
+CEnvironment::~CEnvironment()
+{ }
+
+NewtonErr
+CEnvironment::init(Heap inHeap)
+{
+	fDomainAccess = 0;
+	fHeap = inHeap;
+	fStackDomainId = kNoId;
+	fHeapDomainId = kNoId;
+	fRefCount = 0;
+	f24 = false;
+	fNextEnvironment = NULL;
+	return noErr;
+}
+
+NewtonErr	CEnvironment::add(CDomain * inDomain, bool inIsManager, bool inHasStack, bool inHasHeap) { return noErr; }
+NewtonErr	CEnvironment::remove(CDomain * inDomain) { return noErr; }
+void			CEnvironment::incrRefCount(void) { fRefCount++; }
+bool			CEnvironment::decrRefCount(void) { return --fRefCount == 0; }
+
+CDomain::CDomain() : fFaultMonitor(kNoId), fStart(0), fLength(0), fNumber(0), fNextDomain(NULL) { }
+NewtonErr	CDomain::init(ObjectId inMonitorId, VAddr inRangeStart, size_t inRangeLength) { return kOSErrBadParameters; }
+NewtonErr	CDomain::setFaultMonitor(ObjectId inMonitorId) { return kOSErrBadParameters; }
+
+NewtonErr
+MemObjManager::findEnvironmentId(ULong inName, ObjectId * outId)
+{
+	*outId = gKernelEnvironmentId;
+	return noErr;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Memory.
+	NewPtr is malloc, so there is no heap to speak of and no physical pages.
+----------------------------------------------------------------------------- */
+
+Heap			GetHeap(void) { return gHeap; }
+void			SetHeap(Heap inHeap) { gHeap = inHeap; }
+NewtonErr	UnlockHeapRange(VAddr inStart, VAddr inEnd) { return noErr; }
+
+CPhys::CPhys() { }
+CPhys::~CPhys() { }
+CLittlePhys::CLittlePhys() { }
+NewtonErr	CPhys::init(PAddr inBase, size_t inSize, bool inReadOnly, bool inCache) { return kOSErrBadParameters; }
+
+NewtonErr	CExtPageTrackerMgr::makeNewTracker(ObjectId inId1, PAddr inBase, size_t inSize) { return kOSErrBadParameters; }
+NewtonErr	CExtPageTrackerMgr::disposeTracker(ObjectId inId) { return kOSErrBadParameters; }
+void			CExtPageTrackerMgr::doDeferral(void) { }
+
+
+/* -----------------------------------------------------------------------------
+	The clock and the timer interrupt.
+	The alarm just remembers when it was set for; the idle task fires it.
+	CTime's own members are in Timers.cc too.
+----------------------------------------------------------------------------- */
+
+void
+CTime::set(ULong inAmount, TimeUnits inUnits)
+{
+	fTime = inAmount;
+	fTime *= inUnits;
+}
+
+ULong
+CTime::convertTo(TimeUnits inUnits)
+{
+	return fTime / inUnits;
+}
+
+CTime
+GetClock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return CTime(now.tv_sec, kSeconds) + CTime(now.tv_nsec / 1000, kMicroseconds);
+}
+
+CTime
+GetGlobalTime(void)
+{
+	return GetClock();
+}
+
+bool
+SetAlarmAtomic(CTime & inTime)
+{
+	if (inTime <= GetClock())
+		return false;
+	gAlarmTime = inTime;
+	return true;
+}
+
+void
+ClearAlarmAtomic(void)
+{
+	gAlarmTime = 0;
+}
+
+void
+TimerInterruptHandler(void * inQueue)
+{
+	gTimerEngine->alarm();
+}
+
+extern "C" void
+ServicePendingInterrupts(void)
+{ }
+
+
+/* -----------------------------------------------------------------------------
+	Generic SWIs.
+	Just those that tasks, ports and semaphores make, as SWInterrupt.cc
+	handles them; the rest of it is the memory architecture, power and the
+	debugger, none of which is here.
+----------------------------------------------------------------------------- */
+
+extern CTime		gTaskTimeStart;
+extern NewtonErr	SemGroupSetRefCon(ObjectId inSemGroupId, void * inRefCon);
+extern NewtonErr	SemGroupGetRefCon(ObjectId inSemGroupId, void ** outRefCon);
+extern "C" void	PortResetKernelGlue(ObjectId inPortId, ULong inSenderFlags, ULong inReceiverFlags);
+
+extern "C" long
+GenericSWIHandler(int inSelector, OpaqueRef inArg1, OpaqueRef inArg2, OpaqueRef inArg3, OpaqueRef inArg4)
+{
+	long result = noErr;
+	switch (inSelector)
+	{
+	case kGetGlobalTime:
+		{
+			CTime	theTime;
+			if (inArg1 == kNoId)
+				theTime = GetGlobalTime();
+			else
+			{
+				CTask *	task = (CTask *)IdToObj(kTaskType, inArg1);
+				if (task != NULL)
+				{
+					if (task == gCurrentTask)
+					{
+						theTime = GetGlobalTime() - gTaskTimeStart;
+						task->fTaskTime = task->fTaskTime + theTime;
+					}
+					else
+						theTime = task->fTaskTime;
+				}
+				else
+				{
+					theTime = CTime(0);
+					result = kOSErrTaskDoesNotExist;
+				}
+			}
+			gCurrentTask->fRegister[kReturnParm1] = theTime;
+		}
+		break;
+
+	case kTaskYield:
+		{
+			CTask *	task = (CTask *)IdToObj(kTaskType, (ObjectId) inArg1);
+			if (task == NULL)
+				result = kOSErrBadObject;
+			else
+			{
+				gKernelScheduler->setCurrentTask(task);
+				WantSchedule();
+			}
+		}
+		break;
+
+	case kSemGroupSetRefCon:
+		result = SemGroupSetRefCon((ObjectId) inArg1, (void *)inArg2);
+		break;
+
+	case kSemGroupGetRefCon:
+		result = SemGroupGetRefCon((ObjectId) inArg1, (void **) &gCurrentTask->fRegister[kReturnParm1]);
+		break;
+
+	case kResetPortFlags:
+		PortResetKernelGlue((ObjectId) inArg1, (ULong) inArg2, (ULong) inArg3);
+		break;
+
+	default:
+		fprintf(stderr, "GenericSWI %d not in the host kernel\n", inSelector);
+		abort();
+	}
+	return result;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Nothing here traces, reboots or throws; and there is no screen, tablet or
+	ROM extension for the name server's gestalt to describe.
+----------------------------------------------------------------------------- */
+
+DefineException(exOutOfStack, evt.ex.abt.stack);
+
+void	AddTraceEvent(CTask * inTask, ULong inEvent, ULong inArg1, ULong inArg2) { }
+void	ReleaseTraceRing(CTask * inTask) { }
+
+#define UNUSED_GLUE(proto) proto { fprintf(stderr, "%s called\n", #proto); abort(); }
+UNUSED_GLUE(NewtonErr Reboot(NewtonErr inError, ULong inRebootType, bool inSafe))
+UNUSED_GLUE(void Restart(void))
+UNUSED_GLUE(NewtonErr GetGrafInfo(int inSelector, void * outInfo))
+UNUSED_GLUE(void GetTabletResolution(float * outX, float * outY))
+UNUSED_GLUE(size_t InternalRAMInfo(int inSelector, size_t inAlign))
+extern "C" {
+UNUSED_GLUE(void Throw(ExceptionName inName, void * inData, ExceptionDestructor inDestructor))
+UNUSED_GLUE(RExHeader * GetRExPtr(ULong inId))
+}
+
+
+/* -----------------------------------------------------------------------------
+	The name server never stops, and what it holds is reachable only from its
+	stack, which LeakSanitizer doesn't scan.
+----------------------------------------------------------------------------- */
+
+extern "C" const char *
+__lsan_default_suppressions(void)
+{
+	return "leak:CNameServer::taskConstructor\n"
+			 "leak:CObjectNameTable::init\n";
+}
+
+extern "C" const char *
+__lsan_default_options(void)
+{
+	return "print_suppressions=0";
+}
+
+
+/* -----------------------------------------------------------------------------
+	The idle task.
+	It runs only when every other task is blocked. If a timer will wake one,
+	wait for it and fire it; if not, nothing ever will.
+----------------------------------------------------------------------------- */
+
+static void
+IdleTask(void)
+{
+	for ( ; ; )
+	{
+		if (gAlarmTime == 0)
+		{
+			fprintf(stderr, "every task is blocked: deadlock\n");
+			++gNumOfFailures;
+			exit(TestResult("HostKernel"));
+		}
+
+		int64_t	delay = gAlarmTime - (int64_t)GetClock();
+		if (delay > 0)
+		{
+			CTime	wait(delay);
+			struct timespec	interval;
+			interval.tv_sec = wait.convertTo(kSeconds);
+			interval.tv_nsec = (wait - CTime(interval.tv_sec, kSeconds)).convertTo(kMicroseconds) * 1000;
+			nanosleep(&interval, NULL);
+		}
+
+		// take the timer interrupt
+		EnterFIQAtomic();
+		gAlarmTime = 0;
+		TimerInterruptHandler(NULL);
+		ExitFIQAtomic();		// and switch to whatever it woke
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Boot, as OSBoot does.
+----------------------------------------------------------------------------- */
+
+void
+BootHostKernel(TaskProcPtr inProc, size_t inStackSize)
+{
+	CEnvironment	bootEnvironment, * environment;
+	CTask				bootTask, * task;
+	TaskGlobals		globals;
+
+	// a null task while we're booting, with empty task globals
+	gCurrentGlobals = &globals + 1;
+	bootEnvironment.init(NULL);
+	bootTask.fEnvironment = &bootEnvironment;
+	gCurrentTask = &bootTask;
+
+	HInitInterrupts();
+	InitInterruptTables();
+
+	gObjectTable = new CObjectTable;
+	gObjectTable->init();
+
+	environment = new CEnvironment;
+	environment->init(NULL);
+	RegisterObject(environment, kEnvironmentType, kSystemId, &gKernelEnvironmentId);
+
+	// no task swaps while we're adding new tasks
+	EnterFIQAtomic();
+
+	InitGlobalWorld();
+	gTimerDeferred = new CDoubleQContainer(offsetof(CSharedMemMsg, fTimerQItem));
+	gTimerEngine = new CTimerEngine();
+	gTimerEngine->init();
+
+	gUObjectMgrMonitor = new CUMonitor(GetPortSWI(kGetObjectPort));
+	gUNullPort = new CUPort(GetPortSWI(kGetNullPort));
+
+	// we become the idle task
+	task = new CTask();
+	gIdleTask = task;
+	RegisterObject(task, kTaskType, kSystemId, NULL);
+	task->init((TaskProcPtr) IdleTask, 0, kNoId, kNoId, kIdleTaskPriority, 'idle', environment);
+	gCurrentTask = gIdleTask;
+	SwapInGlobals(gIdleTask);
+
+	// the test task
+	ObjectId	taskId;
+	task = new CTask();
+	RegisterObject(task, kTaskType, kSystemId, &taskId);
+	task->init(inProc, inStackSize, taskId, kNoId, kUserTaskPriority, 'test', environment);
+
+	gTimerEngine->start();
+	StartScheduler();
+	ExitFIQAtomic();
+
+	EnterAtomic();
+	ScheduleTask(task);
+	ExitAtomic();		// which switches to it
+
+	IdleTask();
+}
@@ -0,0 +1,32 @@
+/*
+	File:		HostKernel.h
+
+	Contains:	A host kernel for tests.
+					Boots the kernel's own tasks, ports, semaphores, monitors and
+					shared memory on the portable SWI handler, as OSBoot does, and
+					runs a test task in it. The memory architecture, the clock and
+					interrupts are stubs; see HostKernel.cc. The name server is
+					linked in too, for a test to start with InitializeNameServer.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__HOSTKERNEL_H)
+#define __HOSTKERNEL_H 1
+
+#include "HostTest.h"
+#include "SharedTypes.h"
+
+/*------------------------------------------------------------------------------
+	Boot the kernel and start a task at inProc. The boot context then becomes
+	the idle task: it fires timers when they are due, and if every task is
+	blocked with no timer to wake any of them, reports the deadlock and exits.
+	The test task ends the test by calling exit().
+	Args:		inProc			the test task's proc
+				inStackSize		its stack size
+	Return:	--		never
+------------------------------------------------------------------------------*/
+
+extern void		BootHostKernel(TaskProcPtr inProc, size_t inStackSize);
+
+#endif	/* __HOSTKERNEL_H */
@@ -0,0 +1,293 @@
+/*
+	File:		HostStackOverflow.cc
+
+	Contains:	Growable host stack test.
+					Runs a recursion on a host stack, switched to with
+					swapcontext() as a task would be, and checks that the stack
+					grows to take it and that the thread carries on afterwards.
+					Then recurses without end, checking the stack on the way
+					down as the interpreter and NSOF reader do, and checks that
+					exOutOfStack is thrown, can be caught, and that the task can
+					carry on and recurse again. Then, in child processes,
+					recurses without end and without checking, and checks the
+					overflow is reported and aborts, and checks that a fault
+					nowhere near a stack still gets the default action.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "HostStack.h"
+#include "OSErrors.h"
+
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#define kStackSize			(16*KByte)		// committed to begin with
+#define kFrameSize			(4*KByte)
+#define kRecursionDepth		512				// 2MB of frames; well within kHostStackGrowRoom
+
+
+static ucontext_t	gMainContext;
+static ucontext_t	gStackContext;
+static ArrayIndex	gDepthReached;
+
+
+/* -----------------------------------------------------------------------------
+	A stub exception handler list, working as Frames/Exceptions.cc does but
+	without the NewtonScript objects that needs.
+----------------------------------------------------------------------------- */
+
+DefineException(exRootException, evt.ex);
+DefineException(exAbort, evt.ex.abt);
+DefineException(exOutOfStack, evt.ex.abt.stack);
+
+static CatchHeader *	gFirstHandler;
+
+void
+AddExceptionHandler(CatchHeader * inHandler)
+{
+	inHandler->next = gFirstHandler;
+	gFirstHandler = inHandler;
+}
+
+void
+ExitHandler(NewtonExceptionHandler * inHandler)
+{
+	if (gFirstHandler == &inHandler->header)
+		gFirstHandler = inHandler->header.next;
+}
+
+void
+Throw(ExceptionName inName, void * inData, ExceptionDestructor inDestructor)
+{
+	NewtonExceptionHandler * handler = (NewtonExceptionHandler *)gFirstHandler;
+	if (handler == NULL)
+		abort();
+	gFirstHandler = handler->header.next;
+	handler->exception.name = inName;
+	handler->exception.data = inData;
+	handler->exception.destructor = inDestructor;
+	longjmp(handler->state, 1);
+}
+
+void
+NextHandler(NewtonExceptionHandler * inHandler)
+{
+	Throw(inHandler->exception.name, inHandler->exception.data, inHandler->exception.destructor);
+}
+
+bool
+Subexception(ExceptionName inSub, ExceptionName inSuper)
+{
+	size_t superLen = strlen(inSuper);
+	return strncmp(inSub, inSuper, superLen) == 0 && (inSub[superLen] == 0 || inSub[superLen] == '.');
+}
+
+
+/* -----------------------------------------------------------------------------
+	Recurse, touching every frame all the way down and checking each on the
+	way back up, so that no frame can be optimised away.
+----------------------------------------------------------------------------- */
+
+static ArrayIndex
+Recurse(ArrayIndex inDepth, ArrayIndex inLimit)
+{
+	volatile UByte	frame[kFrameSize];
+	for (ArrayIndex i = 0; i < kFrameSize; i += 64)
+		frame[i] = (UByte)inDepth;
+	gDepthReached = inDepth;
+
+	ArrayIndex numOfMismatches = (inDepth < inLimit) ? Recurse(inDepth + 1, inLimit) : 0;
+	for (ArrayIndex i = 0; i < kFrameSize; i += 64)
+		if (frame[i] != (UByte)inDepth)
+			numOfMismatches++;
+	return numOfMismatches;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Recurse without end, but check the stack on the way down.
+----------------------------------------------------------------------------- */
+
+static ArrayIndex
+CheckedRecurse(ArrayIndex inDepth)
+{
+	volatile UByte	frame[kFrameSize];
+	for (ArrayIndex i = 0; i < kFrameSize; i += 64)
+		frame[i] = (UByte)inDepth;
+	CheckHostStack();
+	gDepthReached = inDepth;
+	// exOutOfStack is thrown long before this -- no stack could go so deep
+	if (inDepth > 2 * (kStackSize + kHostStackGrowRoom) / kFrameSize)
+		return 0;
+	return CheckedRecurse(inDepth + 1) + frame[0];
+}
+
+
+static ArrayIndex	gNumOfMismatches;
+static ArrayIndex	gRecursionLimit;
+static bool			gCaught;
+static long			gCaughtErr;
+static ArrayIndex	gCaughtDepth;
+
+static void
+StackProc(void)
+{
+	gNumOfMismatches = Recurse(1, gRecursionLimit);
+}
+
+
+static void
+CheckedStackProc(void)
+{
+	gCaught = false;
+	newton_try
+	{
+		CheckedRecurse(1);
+	}
+	newton_catch(exOutOfStack)
+	{
+		gCaught = true;
+		gCaughtErr = (long)CurrentException()->data;
+		gCaughtDepth = gDepthReached;
+	}
+	end_try;
+
+	// the task carries on, and has all its stack back
+	gNumOfMismatches = Recurse(1, kRecursionDepth);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Run a procedure on a new host stack, as a task.
+	Args:		inProc		the procedure
+				inLimit		recursion depth
+	Return:	--
+----------------------------------------------------------------------------- */
+
+static void
+RunOnHostStack(void (*inProc)(void), ArrayIndex inLimit)
+{
+	VAddr top, bottom;
+	CHECK(NewHostStack(kStackSize, &top, &bottom) == noErr);
+	gRecursionLimit = inLimit;
+	gNumOfMismatches = 0;
+	TaskSwitchedGlobals()->fStackTop = top;
+	TaskSwitchedGlobals()->fStackBottom = bottom;
+
+	getcontext(&gStackContext);
+	gStackContext.uc_stack.ss_sp = (void *)bottom;
+	gStackContext.uc_stack.ss_size = top - bottom;
+	gStackContext.uc_link = &gMainContext;
+	makecontext(&gStackContext, inProc, 0);
+	CHECK(swapcontext(&gMainContext, &gStackContext) == 0);
+
+	TaskSwitchedGlobals()->fStackTop = 0;
+	TaskSwitchedGlobals()->fStackBottom = 0;
+	FreeHostStack(top);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Run a test in a child process.
+	Args:		inTest		what the child does
+				outStderr	what it wrote to stderr
+				inSize		size of outStderr
+	Return:	its wait status
+----------------------------------------------------------------------------- */
+
+static int
+RunInChild(void (*inTest)(void), char * outStderr, size_t inSize)
+{
+	int fd[2];
+	CHECK(pipe(fd) == 0);
+	fflush(stderr);
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		dup2(fd[1], STDERR_FILENO);
+		close(fd[0]);
+		inTest();
+		_exit(0);
+	}
+
+	close(fd[1]);
+	size_t amtRead = 0;
+	ssize_t count;
+	while (amtRead < inSize - 1 && (count = read(fd[0], outStderr + amtRead, inSize - 1 - amtRead)) > 0)
+		amtRead += count;
+	outStderr[amtRead] = 0;
+	close(fd[0]);
+
+	int status = 0;
+	CHECK(waitpid(pid, &status, 0) == pid);
+	return status;
+}
+
+
+static void
+Overflow(void)
+{
+	RunOnHostStack(StackProc, ~0U);
+}
+
+
+static void
+FaultElsewhere(void)
+{
+	VAddr top, bottom;
+	NewHostStack(kStackSize, &top, &bottom);
+	*(volatile int *)sizeof(int) = 0;
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	HostStackStatistics stats;
+
+	// the stack grows to take the recursion, and we come back from it
+	RunOnHostStack(StackProc, kRecursionDepth);
+	CHECK(gDepthReached == kRecursionDepth);
+	CHECK(gNumOfMismatches == 0);
+	GetHostStackStatistics(&stats);
+	CHECK(stats.numOfGrowths >= kRecursionDepth * kFrameSize / kHostStackGrowSize - 1);
+	CHECK(stats.numOfOverflows == 0);
+	CHECK(stats.numOfStacks == 0 && stats.reserved == 0 && stats.committed == 0);
+
+	// and does it again, which shows the thread's signal stack survived
+	RunOnHostStack(StackProc, kRecursionDepth);
+	CHECK(gNumOfMismatches == 0);
+
+	// checked recursion without end throws exOutOfStack before the guard, and the task carries on
+	RunOnHostStack(CheckedStackProc, 0);
+	CHECK(gCaught);
+	CHECK(gCaughtErr == kStackErrStackOverflow);
+	CHECK(gCaughtDepth > kRecursionDepth);
+	CHECK(gNumOfMismatches == 0);
+	GetHostStackStatistics(&stats);
+	CHECK(stats.numOfOverflows == 1);
+	CHECK(stats.numOfStacks == 0);
+
+	// and can do so again
+	RunOnHostStack(CheckedStackProc, 0);
+	CHECK(gCaught);
+	CHECK(gNumOfMismatches == 0);
+
+	// recursing without end is reported, and aborts, rather than running off the stack
+	char msg[256];
+	int status = RunInChild(Overflow, msg, sizeof(msg));
+	CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+	CHECK(strstr(msg, "Task stack overflow") != NULL);
+
+	// faults that aren't on a host stack are left alone
+	status = RunInChild(FaultElsewhere, msg, sizeof(msg));
+	CHECK(WIFSIGNALED(status) && (WTERMSIG(status) == SIGSEGV || WTERMSIG(status) == SIGBUS));
+	CHECK(msg[0] == 0);
+
+	return TestResult("HostStackOverflow");
+}
@@ -0,0 +1,30 @@
+/*
+	File:		HostTest.cc
+
+	Contains:	Support for host tests.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+
+int		gNumOfFailures = 0;
+
+
+/* -----------------------------------------------------------------------------
+	Report the outcome of a test.
+	Args:		inName		test name
+	Return:	exit code
+----------------------------------------------------------------------------- */
+
+int
+TestResult(const char * inName)
+{
+	if (gNumOfFailures == 0)
+	{
+		printf("%s: passed\n", inName);
+		return 0;
+	}
+	printf("%s: %d failed\n", inName, gNumOfFailures);
+	return 1;
+}
@@ -0,0 +1,31 @@
+/*
+	File:		HostTest.h
+
+	Contains:	Support for host tests.
+					Each test is a standalone program built from the parts of the
+					tree it exercises; it prints what fails and returns nonzero.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__HOSTTEST_H)
+#define __HOSTTEST_H 1
+
+#include "Newton.h"
+#include <stdio.h>
+
+extern int	gNumOfFailures;
+
+// NewtonDebug.h's CHECK asserts; ours counts the failure and carries on
+#undef CHECK
+#define CHECK(expr) \
+		do { \
+			if (!(expr)) { \
+				fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+				++gNumOfFailures; \
+			} \
+		} while (0)
+
+extern int	TestResult(const char * inName);
+
+#endif	/* __HOSTTEST_H */
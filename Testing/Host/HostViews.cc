@@ -0,0 +1,408 @@
+/*
+	File:		HostViews.cc
+
+	Contains:	A host view system for tests.
+					Views are Views/View.cc's own, built as it stands; what is here
+					stands in for what it needs of the rest of the system. Frames
+					are a list of slots, symbols are distinct magic pointers,
+					scripts never run -- tests give their views vNoScripts -- and
+					the root view does nothing with what is invalidated. Anything
+					a test should never reach aborts.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostViews.h"
+#include "Quartz.h"
+#include "Objects.h"
+#include "Globals.h"
+#include "Funcs.h"
+#include "Arrays.h"
+#include "Lookup.h"
+#include "NewtonTime.h"
+
+#include "RootView.h"
+#include "Application.h"
+#include "Animation.h"
+#include "Modal.h"
+#include "DragAndDrop.h"
+#include "BusyBox.h"
+#include "DrawShape.h"
+#include "Unit.h"
+#include "Stroke.h"
+#include "StrokeCentral.h"
+#include "Regions.h"
+
+#include <stdlib.h>
+
+#define kMaxNumOfSlots		8
+
+
+/* -----------------------------------------------------------------------------
+	D a t a
+	Defined in parts of the view system that aren't built here.
+----------------------------------------------------------------------------- */
+
+CRootView *			gRootView;
+CApplication *		gApplication;
+CViewList *			gEmptyViewList;
+bool					gOutlineViews = false;
+int					gModalCount = 0;
+int					gSlowMotion = 0;
+CStrokeCentral		gStrokeWorld;
+extern const Ref *	gTagCache;			// View.cc's
+
+// Screen.cc's, for a portrait screen
+CGContextRef		quartz;
+int					gScreenWidth = 320;
+int					gScreenHeight = 480;
+NativePixelMap		gScreenPixelMap;
+CGColorRef			gWhiteColor;
+
+// QDDrawing.cc brings in the whole object system, so just these from it
+Ptr
+PixelMapBits(const NativePixelMap * inPixmap)
+{
+	return (Ptr)inPixmap->baseAddr;
+}
+
+CGRect
+MakeCGRect(Rect inRect)
+{
+	return CGRectMake(inRect.left, gScreenHeight - inRect.bottom, RectGetWidth(inRect), RectGetHeight(inRect));
+}
+
+
+/* -----------------------------------------------------------------------------
+	E x c e p t i o n s
+	Exceptions.cc doesn't build here; nothing a test reaches throws.
+----------------------------------------------------------------------------- */
+
+DefineException(exRootException, evt.ex);
+DefineException(exOutOfMemory, evt.ex.outofmem);
+
+extern "C" {
+void	AddExceptionHandler(CatchHeader * inHandler) { }
+void	RemoveExceptionHandler(CatchHeader * inHandler) { }
+void	ExitHandler(NewtonExceptionHandler * inHandler) { }
+void	NextHandler(NewtonExceptionHandler * inHandler) { abort(); }
+void	Throw(ExceptionName inName, void * inData, ExceptionDestructor inDestructor) { abort(); }
+void	ThrowMsg(const char * inMsg) { abort(); }
+bool	Subexception(ExceptionName inSub, ExceptionName inSuper) { abort(); }
+int	_RINTError(Ref r) { abort(); }
+}
+
+
+/* -----------------------------------------------------------------------------
+	O b j e c t s
+	A RefVar's handle is allocated on the host heap. A frame is a list of
+	slots; the display parameters are the only global that's asked for.
+----------------------------------------------------------------------------- */
+
+struct HostFrame
+{
+	ArrayIndex	numOfSlots;
+	Ref			tag[kMaxNumOfSlots];
+	Ref			value[kMaxNumOfSlots];
+};
+
+RefHandle *
+AllocateRefHandle(Ref inRef)
+{
+	RefHandle * h = (RefHandle *)malloc(sizeof(RefHandle));
+	h->ref = inRef;
+	h->stackPos = 0;
+	return h;
+}
+
+void
+DisposeRefHandle(RefHandle * inHandle)
+{
+	free(inHandle);
+}
+
+// symbols
+#define SYMBOL(_name) static RefHandle SYM##_name##Handle = { MAKEMAGICPTR(__COUNTER__), 0 }; Ref * RSSYM##_name = &SYM##_name##Handle.ref;
+SYMBOL(_cacheContext) SYMBOL(_defaultButtonBounds) SYMBOL(_parent) SYMBOL(_proto) SYMBOL(_uniqueId)
+SYMBOL(appAreaGlobalLeft) SYMBOL(appAreaGlobalTop) SYMBOL(appAreaHeight) SYMBOL(appAreaWidth)
+SYMBOL(boolean) SYMBOL(bounds) SYMBOL(char) SYMBOL(copyProtection) SYMBOL(correctInfo) SYMBOL(declareSelf)
+SYMBOL(dictionaries) SYMBOL(displayParams) SYMBOL(functions) SYMBOL(hideSound) SYMBOL(hilite) SYMBOL(hilites)
+SYMBOL(ink) SYMBOL(int) SYMBOL(lastTextChanged) SYMBOL(offset) SYMBOL(parameter) SYMBOL(poly) SYMBOL(postQuit)
+SYMBOL(preAllocatedContext) SYMBOL(realData) SYMBOL(recConfig) SYMBOL(showSound) SYMBOL(skip) SYMBOL(squareGrid)
+SYMBOL(stdForms) SYMBOL(stepChildren) SYMBOL(string) SYMBOL(textFlags) SYMBOL(trace)
+SYMBOL(viewAddChildScript) SYMBOL(viewAddDragInfoScript) SYMBOL(viewBounds) SYMBOL(viewCObject)
+SYMBOL(viewChildren) SYMBOL(viewClass) SYMBOL(viewClipper) SYMBOL(viewDragFeedbackScript)
+SYMBOL(viewDrawDragBackgroundScript) SYMBOL(viewDrawDragDataScript) SYMBOL(viewDropChildScript)
+SYMBOL(viewDropDoneScript) SYMBOL(viewDropMoveScript) SYMBOL(viewDropRemoveScript) SYMBOL(viewDropScript)
+SYMBOL(viewFillPattern) SYMBOL(viewFlags) SYMBOL(viewFont) SYMBOL(viewFormat) SYMBOL(viewFramePattern)
+SYMBOL(viewGestureScript) SYMBOL(viewGetDropDataScript) SYMBOL(viewGetDropTypesScript) SYMBOL(viewGrid)
+SYMBOL(viewHideScript) SYMBOL(viewJustify) SYMBOL(viewLinePattern) SYMBOL(viewLineSpacing)
+SYMBOL(viewOverviewScript) SYMBOL(viewPostQuitScript) SYMBOL(viewQuitScript) SYMBOL(viewScrollDownScript)
+SYMBOL(viewScrollUpScript) SYMBOL(viewSetupDoneScript) SYMBOL(viewSetupFormScript) SYMBOL(viewShowScript)
+SYMBOL(viewStationery) SYMBOL(viewStrokeScript) SYMBOL(viewTie) SYMBOL(viewWordScript)
+
+static RefHandle	gNILHandle = { NILREF, 0 };
+static RefHandle	gTRUEHandle = { TRUEREF, 0 };
+static RefHandle	gVarFrameHandle = { NILREF, 0 };
+Ref *		RSNILREF = &gNILHandle.ref;
+Ref *		RSTRUEREF = &gTRUEHandle.ref;
+Ref *		RSgVarFrame = &gVarFrameHandle.ref;
+
+
+Ref
+AllocateFrame(void)
+{
+	return MAKEPTR(calloc(1, sizeof(HostFrame)));
+}
+
+static HostFrame *
+FrameOf(Ref inObj)
+{
+	return ISREALPTR(inObj) ? (HostFrame *)(inObj - 1) : NULL;
+}
+
+Ref
+GetFrameSlot(RefArg inObj, RefArg inTag)
+{
+	HostFrame * frame = FrameOf(inObj);
+	if (frame != NULL)
+		for (ArrayIndex i = 0; i < frame->numOfSlots; ++i)
+			if (frame->tag[i] == inTag)
+				return frame->value[i];
+	if (frame == NULL && ISNIL(inObj) && inTag == SYMA(displayParams))
+	{
+		// the app area is the whole screen
+		static RefStruct displayParams;
+		if (ISNIL(displayParams))
+		{
+			displayParams = AllocateFrame();
+			SetFrameSlot(displayParams, SYMA(appAreaGlobalTop), MAKEINT(0));
+			SetFrameSlot(displayParams, SYMA(appAreaGlobalLeft), MAKEINT(0));
+			SetFrameSlot(displayParams, SYMA(appAreaHeight), MAKEINT(gScreenHeight));
+			SetFrameSlot(displayParams, SYMA(appAreaWidth), MAKEINT(gScreenWidth));
+		}
+		return displayParams;
+	}
+	return NILREF;
+}
+
+void
+SetFrameSlot(RefArg inObj, RefArg inTag, RefArg inValue)
+{
+	HostFrame * frame = FrameOf(inObj);
+	if (frame == NULL)
+		abort();
+	ArrayIndex i;
+	for (i = 0; i < frame->numOfSlots; ++i)
+		if (frame->tag[i] == inTag)
+			break;
+	if (i == frame->numOfSlots)
+	{
+		if (i == kMaxNumOfSlots)
+			abort();
+		frame->numOfSlots++;
+		frame->tag[i] = inTag;
+	}
+	frame->value[i] = inValue;
+}
+
+bool
+FrameHasSlot(RefArg inObj, RefArg inTag)
+{
+	HostFrame * frame = FrameOf(inObj);
+	if (frame != NULL)
+		for (ArrayIndex i = 0; i < frame->numOfSlots; ++i)
+			if (frame->tag[i] == inTag)
+				return true;
+	return false;
+}
+
+Ref
+GetProtoVariable(RefArg inContext, RefArg inName, bool * outExists)
+{
+	bool exists = FrameHasSlot(inContext, inName);
+	if (outExists)
+		*outExists = exists;
+	return GetFrameSlot(inContext, inName);
+}
+
+Ref
+GetVariable(RefArg inContext, RefArg inName, bool * outExists, int inLookup)
+{
+	return GetProtoVariable(inContext, inName, outExists);
+}
+
+// the address is the ref, as a pointer
+Ref
+AddressToRef(void * inAddr)
+{
+	return MAKEPTR(inAddr);
+}
+
+void *
+RefToAddress(Ref inRef)
+{
+	return (void *)(inRef - 1);
+}
+
+bool EQRef(Ref a, Ref b) { return a == b; }
+
+void AddArraySlot(RefArg inObj, RefArg inElement) { abort(); }
+void ArrayAppendInFrame(RefArg inFrame, RefArg inSlot, RefArg inElement) { abort(); }
+bool ArrayRemove(RefArg inArray, RefArg inElement) { abort(); }
+Ref ClassOf(Ref r) { abort(); }
+Ref Clone(RefArg inObj) { abort(); }
+Ref DoMessage(RefArg inRcvr, RefArg inMsg, RefArg inArgs) { abort(); }
+Ref DoProtoMessage(RefArg inRcvr, RefArg inMsg, RefArg inArgs) { abort(); }
+bool EnableFramesFunctionProfiling(bool inDoIt) { abort(); }
+bool FromObject(RefArg inObj, Rect * outBounds) { abort(); }
+Ref GetArraySlot(RefArg inArray, ArrayIndex inSlot) { abort(); }
+Ref GetArraySlotRef(Ref inObj, ArrayIndex inSlot) { abort(); }
+bool IsArray(Ref r) { abort(); }
+bool IsFrame(Ref r) { abort(); }
+bool IsSubclass(Ref inSub, Ref inSuper) { abort(); }
+ArrayIndex Length(Ref inObj) { abort(); }
+Ref MakeArray(ArrayIndex inLength) { abort(); }
+Ref MakePoint(Point inPt) { abort(); }
+unsigned ObjectFlags(Ref r) { abort(); }
+void SetArraySlot(RefArg inArray, ArrayIndex inSlot, RefArg inValue) { abort(); }
+void SetLength(RefArg inObj, ArrayIndex inLength) { abort(); }
+Ref SPrintObject(RefArg inObj) { abort(); }
+Ref ToObject(const Rect * inBounds) { abort(); }
+
+
+/* -----------------------------------------------------------------------------
+	V i e w s
+	The root view takes note of nothing it's asked to redraw. There is no
+	caret, popup or clipboard, and no animation.
+----------------------------------------------------------------------------- */
+
+VIEW_SOURCE_MACRO(clResponder, CResponder, CViewObject)
+VIEW_SOURCE_MACRO(clRootView, CRootView, CView)
+
+bool CResponder::doCommand(RefArg inCmd) { abort(); }
+
+CRootView::CRootView() { }
+CRootView::~CRootView() { }
+void CRootView::init(RefArg inContext, CView * inView) { abort(); }
+bool CRootView::realDoCommand(RefArg inCmd) { abort(); }
+void CRootView::dirty(const Rect * inRect) { }
+void CRootView::removeAllViews(void) { abort(); }
+void CRootView::postDraw(Rect & inRect) { abort(); }
+void CRootView::invalidate(const CBaseRegion & inRgn, CView * inView) { }
+void CRootView::smartInvalidate(const Rect * inRect) { }
+void CRootView::setPopup(CView * inView, bool inShow) { }
+void CRootView::caretViewGone(void) { }
+CView * CRootView::getClipboard(CView * inIconView) { return NULL; }
+void CRootView::forgetAboutView(CView * inView) { abort(); }
+Rect CRootView::getCaretRect(void) { abort(); }
+void CRootView::hideCaret(void) { abort(); }
+void CRootView::showCaret(void) { abort(); }
+
+bool ViewContainsCaretView(CView * inView) { return false; }
+CView * BuildView(CView * inView, RefArg inContext) { abort(); }
+void PurgeAreaCache(void) { abort(); }
+void SetModalView(CView * inView) { abort(); }
+void ModalSafeShow(CView * inView) { abort(); }
+void BusyBoxSend(int inSelector) { abort(); }
+void Wait(ULong inMilliseconds) { abort(); }
+
+CAnimate::CAnimate() { }
+CAnimate::~CAnimate() { }
+void CAnimate::setupPlainEffect(CView * inView, bool inShow, int inFX) { }
+void CAnimate::doEffect(RefArg inSoundEffect) { }
+
+CStrokeCentral::CStrokeCentral() { }
+CStrokeCentral::~CStrokeCentral() { }
+void CStrokeCentral::blockStrokes(void) { }
+void CStrokeCentral::unblockStrokes(void) { }
+bool CStrokeCentral::flushStrokes(void) { return false; }
+
+NewtonErr CApplication::dispatchCommand(RefArg inCmd) { abort(); }
+void CApplication::postUndoCommand(RefArg inCmd) { abort(); }
+void CApplication::postUndoCommand(ULong inId, CResponder * inRcvr, long inArg) { abort(); }
+bool CDragInfo::checkTypes(RefArg inTypes) const { abort(); }
+Ref CUnit::strokes(void) { abort(); }
+Ref CUnit::wordInfo(void) { abort(); }
+void CStroke::inkOff(bool inArg) { abort(); }
+
+extern "C" {
+Ref MakeCommand(ULong inId, CResponder * inRcvr, OpaqueRef inArg) { abort(); }
+void CommandSetId(RefArg inCmd, ULong inId) { abort(); }
+ULong CommandId(RefArg inCmd) { abort(); }
+void CommandSetResult(RefArg inCmd, NewtonErr inResult) { abort(); }
+void CommandSetParameter(RefArg inCmd, OpaqueRef inArg) { abort(); }
+OpaqueRef CommandParameter(RefArg inCmd) { abort(); }
+void CommandSetFrameParameter(RefArg inCmd, RefArg inArg) { abort(); }
+Ref CommandFrameParameter(RefArg inCmd) { abort(); }
+void CommandSetIndexParameter(RefArg inCmd, ArrayIndex index, int inArg) { abort(); }
+int CommandIndexParameter(RefArg inCmd, ArrayIndex index) { abort(); }
+}
+
+
+/* -----------------------------------------------------------------------------
+	D r a w i n g
+	Views are never drawn here.
+----------------------------------------------------------------------------- */
+
+void DrawPicture(RefArg inIcon, const Rect * inFrame, ULong inJustify, int inTransferMode) { abort(); }
+void FillRoundRect(Rect inBox, short inOvalWd, short inOvalHt) { abort(); }
+void StrokeLine(Point inFrom, Point inTo) { abort(); }
+void StrokeRect(Rect inBox) { abort(); }
+void StrokeRoundRect(Rect inBox, short inOvalWd, short inOvalHt) { abort(); }
+bool SetPattern(int inPatNo) { abort(); }
+void SetLineWidth(short inWidth) { abort(); }
+void StartDrawing(NativePixelMap * inPixmap, Rect * inBounds) { abort(); }
+void StopDrawing(NativePixelMap * inPixmap, Rect * inBounds) { abort(); }
+
+
+/* -----------------------------------------------------------------------------
+	P u b l i c   I n t e r f a c e
+----------------------------------------------------------------------------- */
+
+void
+InitHostViews(void)
+{
+	gEmptyViewList = static_cast<CViewList *>(CViewList::make());
+
+	// views look up only their flags in their frames
+	static Ref tagCache[kIndexView];
+	for (ArrayIndex i = 0; i < kIndexView; ++i)
+		tagCache[i] = NILREF;
+	tagCache[kIndexViewFlags] = SYMA(viewFlags);
+	gTagCache = tagCache;
+
+	gRootView = new CRootView;
+	gRootView->fContext = AllocateFrame();
+	gRootView->viewChildren = static_cast<CViewList *>(CViewList::make());
+	gRootView->fParent = gRootView;
+	SetRect(&gRootView->viewBounds, 0, 0, gScreenWidth, gScreenHeight);
+	gRootView->viewFlags = vVisible + vNoScripts;
+}
+
+
+CView *
+NewHostView(CView * inParent, const Rect * inBounds, ULong inFlags, ULong inFormat)
+{
+	CView * view = new CView;
+	view->fContext = AllocateFrame();
+	view->viewChildren = gEmptyViewList;
+	view->fParent = inParent;
+	view->viewBounds = *inBounds;
+	view->viewFlags = (inFlags & ~vVisible) | vNoScripts;
+	view->viewFormat = inFormat;
+	view->fTagCacheMaskLo = 1 << kIndexViewFlags;
+	SetFrameSlot(view->fContext, SYMA(viewFlags), MAKEINT(view->viewFlags));
+
+	if (inParent->viewChildren == gEmptyViewList)
+		inParent->viewChildren = static_cast<CViewList *>(CViewList::make());
+	inParent->viewChildren->insertLast(view);
+
+	if (inParent == gRootView)
+	{
+		CClipper * clip = new CClipper;
+		SetFrameSlot(view->fContext, SYMA(viewClipper), AddressToRef(clip));
+		clip->updateRegions(view);
+	}
+	return view;
+}
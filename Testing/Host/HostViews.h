@@ -0,0 +1,40 @@
+/*
+	File:		HostViews.h
+
+	Contains:	A host view system for tests.
+					Builds trees of Views/View.cc's own views under a root view
+					the size of the screen, as the view system would with
+					templates that have no scripts. Only what moving, showing,
+					hiding and reordering views needs of frames, the root view
+					and the rest of the system is there; see HostViews.cc.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__HOSTVIEWS_H)
+#define __HOSTVIEWS_H 1
+
+#include "HostTest.h"
+#include "RootView.h"
+
+/*------------------------------------------------------------------------------
+	Create the root view, as CRootView::init does.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+extern void		InitHostViews(void);
+
+/*------------------------------------------------------------------------------
+	Create a view, hidden, in front of its siblings. A child of the root view
+	gets a clipper, as it would.
+	Args:		inParent			its parent
+				inBounds			its bounds, global
+				inFlags			its view flags; vNoScripts is added
+				inFormat			its view format
+	Return:	the view
+------------------------------------------------------------------------------*/
+
+extern CView *	NewHostView(CView * inParent, const Rect * inBounds, ULong inFlags, ULong inFormat);
+
+#endif	/* __HOSTVIEWS_H */
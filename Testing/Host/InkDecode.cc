@@ -0,0 +1,383 @@
+/*
+	File:		InkDecode.cc
+
+	Contains:	Compressed ink decoder test and benchmark.
+					Decodes a corpus of ink words in both output modes and checks
+					every point, stroke boundary, return code and bit position
+					against what the bit-at-a-time decoder made of them -- the
+					corpus is generated from the code books, with every fourth
+					word random bytes and every seventh corrupted, and the
+					expected results are in Golden/. Then reads codewords from
+					every code table out of random bits through the lookups and
+					with the scan as it was, which must agree, and times both;
+					and times decoding the whole corpus in strokes per second.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+
+// the decoder's context and code tables are private to DrawInk.cc
+#include "DrawInk.cc"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define kGoldenDir			"Golden/"
+#define kCorpusName			"InkDecode-corpus"
+#define kMaxCorpusSize		(256*KByte)
+#define kStreamPadding		8
+#define kNumOfCodeBits		(1*MByte)
+#define kNumOfDecodes		50
+
+extern "C" _CODETABLE	kCompr1_1, kCompr2_1;
+
+
+static double
+Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/* -----------------------------------------------------------------------------
+	What DrawInk.cc needs of the rest of the tree, but the decoder does not.
+----------------------------------------------------------------------------- */
+
+CGContextRef	quartz;
+Ref *				RSSYMstrokes;
+
+void SetLineWidth(short inWidth) { }
+void CGContextSetLineJoin(CGContextRef c, CGLineJoin join) { }
+void CGContextBeginPath(CGContextRef c) { }
+void CGContextMoveToPoint(CGContextRef c, CGFloat x, CGFloat y) { }
+void CGContextAddLineToPoint(CGContextRef c, CGFloat x, CGFloat y) { }
+void CGContextAddLines(CGContextRef c, const CGPoint points[], size_t count) { }
+void CGContextStrokePath(CGContextRef c) { }
+
+extern "C" {
+Handle NewHandle(Size inSize) { abort(); }
+NewtonErr SetHandleSize(Handle inHandle, Size inSize) { abort(); }
+}
+RefHandle * AllocateRefHandle(Ref inRef) { abort(); }
+void DisposeRefHandle(RefHandle * inRefHandle) { abort(); }
+Ref GetArraySlot(RefArg inObj, ArrayIndex inSlot) { abort(); }
+Ref GetFrameSlot(RefArg inObj, RefArg inTag) { abort(); }
+ArrayIndex Length(Ref inObj) { abort(); }
+CObjectPtr::CObjectPtr(Ref inRef) { abort(); }
+CObjectPtr::~CObjectPtr() { }
+CDataPtr::operator char*() const { abort(); }
+CRecStroke * CRecStroke::make(ULong inNumOfPts) { abort(); }
+NewtonErr CRecStroke::addPoint(TabPt * inPt) { abort(); }
+void CRecStroke::endStroke(void) { abort(); }
+
+
+/* -----------------------------------------------------------------------------
+	The corpus.
+	Each word is its length, little-endian, then its bytes.
+----------------------------------------------------------------------------- */
+
+static UByte *
+ReadCorpus(const char * inPath, size_t * outSize)
+{
+	FILE * file = fopen(inPath, "rb");
+	if (file == NULL)
+		return NULL;
+	UByte * corpus = (UByte *)malloc(kMaxCorpusSize);
+	*outSize = fread(corpus, 1, kMaxCorpusSize, file);
+	fclose(file);
+	return corpus;
+}
+
+
+static const UByte *
+NextWord(const UByte * inCorpus, size_t * ioOffset, ULong * outSize)
+{
+	const UByte * p = inCorpus + *ioOffset;
+	*outSize = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+	*ioOffset += 4 + *outSize;
+	return p + 4;
+}
+
+
+/* -----------------------------------------------------------------------------
+	A decode proc that sums up what it is given.
+	Points are hashed in order, with a mark where each stroke ends; the points
+	of a stroke the decoder gave up on are left in the context at close.
+----------------------------------------------------------------------------- */
+
+struct Decoded
+{
+	ArrayIndex	numOfStrokes;
+	ArrayIndex	numOfPts;
+	ULong			hash;
+};
+
+static Decoded	gDecoded;
+
+
+static void
+HashValue(ULong inValue)
+{
+	gDecoded.hash = (gDecoded.hash ^ inValue) * 16777619;
+}
+
+
+static void
+HashPoints(const _POINT * inPts, ArrayIndex inNumOfPts)
+{
+	for (ArrayIndex i = 0; i < inNumOfPts; ++i)
+	{
+		HashValue((UShort)inPts[i].x);
+		HashValue((UShort)inPts[i].y);
+	}
+	gDecoded.numOfPts += inNumOfPts;
+}
+
+
+static int
+SumPointProc(short inSelector, _POINT * inPt, _DCC * inContext)
+{
+	switch (inSelector)
+	{
+	case kInkCoderAddStroke:
+		HashPoints(inPt, inContext->numOfPts);
+		break;
+	case kInkCoderRun:
+		HashValue(0x10000);
+		gDecoded.numOfStrokes++;
+		break;
+	case kInkCoderClose:
+		HashPoints(inContext->pts, inContext->numOfPts);
+		break;
+	}
+	return 1;
+}
+
+
+static int
+CountPointProc(short inSelector, _POINT * inPt, _DCC * inContext)
+{
+	if (inSelector == kInkCoderRun)
+		gDecoded.numOfStrokes++;
+	return 1;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Decode every word of the corpus, in both modes, and check the results
+	line for line against the expected ones.
+----------------------------------------------------------------------------- */
+
+static void
+CheckCorpus(const UByte * inCorpus, size_t inCorpusSize, bool inUpdate)
+{
+	const char * txtPath = kGoldenDir kCorpusName ".txt";
+	FILE * expected = fopen(txtPath, inUpdate ? "w" : "r");
+	if (expected == NULL)
+	{
+		fprintf(stderr, "%s: can't open\n", txtPath);
+		++gNumOfFailures;
+		return;
+	}
+
+	ArrayIndex numOfWords = 0, numOfMismatches = 0;
+	for (size_t offset = 0; offset < inCorpusSize; ++numOfWords)
+	{
+		ULong size;
+		const UByte * word = NextWord(inCorpus, &offset, &size);
+		for (UShort mode = 1; mode <= 3; mode += 2)
+		{
+			memset(&gDecoded, 0, sizeof(gDecoded));
+			gDecoded.hash = 2166136261U;
+			_DCC * context = DecoderOpen(size, (CSStrokeRef)word, 1, (CSParmsRef)word, mode);
+			CHECK(context != NULL);
+			if (context == NULL)
+				return;
+			context->proc = SumPointProc;
+			int result = DecoderRun(context);
+			int bitIndex[3] = { context->x2C, context->x30, context->x34 };
+			DecoderClose(context, NULL);
+
+			char line[128], expectedLine[128] = "";
+			snprintf(line, sizeof(line), "%u %d: run %d, %u strokes, %u points, bits %d %d %d, hash %08X\n",
+						numOfWords, mode, result, gDecoded.numOfStrokes, gDecoded.numOfPts,
+						bitIndex[0], bitIndex[1], bitIndex[2], gDecoded.hash);
+
+			if (inUpdate)
+				fputs(line, expected);
+			else if (fgets(expectedLine, sizeof(expectedLine), expected) == NULL
+				  ||  strcmp(line, expectedLine) != 0)
+			{
+				if (numOfMismatches++ < 10)
+					fprintf(stderr, "%s: expected %s     got %s", txtPath, expectedLine, line);
+			}
+		}
+	}
+	fclose(expected);
+	CHECK(numOfMismatches == 0);
+	CHECK(numOfWords > 0);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Codewords, read through the lookups and as they were.
+	The original read the stream a bit at a time, comparing the codewords of
+	each length in turn once it had read that many bits.
+----------------------------------------------------------------------------- */
+
+static int
+OldDecodeWord(const UByte * inStream, int * ioBitIndex, _CODETABLE * inCT, short * outWord)
+{
+	_CODEWORD *	theCW = inCT->codewords;
+	unsigned int	bit, word = 0;
+	int	codewordIndex = 0;
+
+	for (ArrayIndex i = 0; i < 32; ++i)
+	{
+		bit = (inStream[*ioBitIndex/8] >> (*ioBitIndex & 0x07)) & 0x01;
+		word |= (bit << i);
+		(*ioBitIndex)++;
+
+		for (ArrayIndex j = i+1; j == theCW->codeLen; theCW++)
+		{
+			if (word == theCW->codeWord)
+			{
+				short	sp00;
+				short	theWord = theCW->originalWord;
+				if (theCW->originalWord == inCT->x0A)	// at the limit; recurse
+				{
+					if (OldDecodeWord(inStream, ioBitIndex, inCT, &sp00) == 0) return 0;
+					theWord = inCT->x04 + sp00;
+				}
+				if (theCW->originalWord == inCT->x08)	// at the limit; recurse
+				{
+					if (OldDecodeWord(inStream, ioBitIndex, inCT, &sp00) == 0) return 0;
+					theWord = inCT->x06 + sp00;
+				}
+				*outWord = theWord;
+				return 1;
+			}
+			if (++codewordIndex == inCT->numOfCodewords)
+				return 0;
+		}
+	}
+
+	return 0;
+}
+
+
+static void
+CheckCodewords(void)
+{
+	static UByte	stream[kNumOfCodeBits/8 + kStreamPadding];
+	unsigned int	seed = 1;
+	double			oldTime = 0, newTime = 0;
+	ArrayIndex		numOfCodewords = 0, numOfMismatches = 0;
+
+	for (ArrayIndex i = 0; i < kNumOfCodeBits/8; ++i)
+		stream[i] = rand_r(&seed);
+
+	// the code books are eight tables each, laid out one after the other
+	CHECK((char *)&kCompr1 + kCompr1.size == (char *)&kCompr1_1);
+	CHECK((char *)&kCompr2 + kCompr2.size == (char *)&kCompr2_1);
+
+	_DCC * context = DecoderOpen(sizeof(stream) - kStreamPadding, (CSStrokeRef)stream, 1, (CSParmsRef)stream, 1);
+	for (short codeBook = 1; codeBook <= 2; ++codeBook)
+	{
+		context->x74 = codeBook;
+		CHECK(DecoderSelectCodeBook(context));
+		_CODETABLE * table = (codeBook == 1) ? &kCompr1 : &kCompr2;
+		_CODELOOKUP ** lookup = gCodeBookLookup[codeBook - 1];
+		for (ArrayIndex t = 0; t < 8; ++t, table = (_CODETABLE *)((char *)table + table->size))
+		{
+			// a failed read consumes the bits it scanned, so both read on from there
+			static short	oldWords[kNumOfCodeBits], newWords[kNumOfCodeBits];
+			static int		oldEnds[kNumOfCodeBits], newEnds[kNumOfCodeBits];
+			ArrayIndex		numOfOldWords = 0, numOfNewWords = 0;
+			int				limit = kNumOfCodeBits - 32*3;
+
+			double startTime = Seconds();
+			for (int bitIndex = 0; bitIndex < limit; )
+			{
+				if (!OldDecodeWord(stream, &bitIndex, table, &oldWords[numOfOldWords]))
+					oldWords[numOfOldWords] = -32768;
+				oldEnds[numOfOldWords++] = bitIndex;
+			}
+			oldTime += Seconds() - startTime;
+
+			context->x20 = stream;
+			context->x2C = 0;
+			context->bitBuffer = 0;
+			context->bitCount = 0;
+			context->byteIndex = 0;
+			startTime = Seconds();
+			while (context->x2C < limit)
+			{
+				if (!DecodeWord_OLD(context, lookup[t], &newWords[numOfNewWords]))
+					newWords[numOfNewWords] = -32768;
+				newEnds[numOfNewWords++] = context->x2C;
+			}
+			newTime += Seconds() - startTime;
+
+			CHECK(numOfOldWords == numOfNewWords);
+			for (ArrayIndex i = 0; i < MIN(numOfOldWords, numOfNewWords); ++i)
+				if (oldWords[i] != newWords[i] || oldEnds[i] != newEnds[i])
+					numOfMismatches++;
+			numOfCodewords += numOfOldWords;
+		}
+	}
+	DecoderClose(context, NULL);
+	CHECK(numOfMismatches == 0);
+
+	printf("%u codewords: %.3fs -> %.3fs\n", numOfCodewords, oldTime, newTime);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Strokes per second, decoding the whole corpus over and over.
+----------------------------------------------------------------------------- */
+
+static void
+TimeDecoding(const UByte * inCorpus, size_t inCorpusSize)
+{
+	memset(&gDecoded, 0, sizeof(gDecoded));
+	double startTime = Seconds();
+	for (ArrayIndex n = 0; n < kNumOfDecodes; ++n)
+	{
+		for (size_t offset = 0; offset < inCorpusSize; )
+		{
+			ULong size;
+			const UByte * word = NextWord(inCorpus, &offset, &size);
+			_DCC * context = DecoderOpen(size, (CSStrokeRef)word, 1, (CSParmsRef)word, 3);
+			context->proc = CountPointProc;
+			DecoderRun(context);
+			DecoderClose(context, NULL);
+		}
+	}
+	double elapsed = Seconds() - startTime;
+	CHECK(gDecoded.numOfStrokes > 0);
+
+	printf("%u strokes in %.3fs: %.0f strokes/s\n", gDecoded.numOfStrokes, elapsed, gDecoded.numOfStrokes / elapsed);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	bool isUpdate = (argc > 1 && strcmp(argv[1], "-update") == 0);
+	size_t corpusSize;
+	UByte * corpus = ReadCorpus(kGoldenDir kCorpusName ".bin", &corpusSize);
+	CHECK(corpus != NULL);
+	if (corpus != NULL)
+	{
+		CheckCorpus(corpus, corpusSize, isUpdate);
+		CheckCodewords();
+		TimeDecoding(corpus, corpusSize);
+		free(corpus);
+	}
+	return TestResult("InkDecode");
+}
@@ -0,0 +1,626 @@
+/*
+	File:		MNPDockLoopback.cc
+
+	Contains:	MNP and Dock session loopback test.
+					Runs a docking session over the host serial port's pty with
+					both ends on this machine. A desktop thread opens the slave
+					device as a connection client would; the Newton side moves
+					bytes through a serial tool's pair of circle buffers with
+					CHostSerialPort::transfer(), as CAsyncSerTool does.
+					Frames are framed as the framed async serial tool frames
+					them -- SYN DLE STX, escaped data, DLE ETX, the CRC16 FCS --
+					and carry the MNP link as CMNPTool speaks it: LR to connect,
+					LT and LA to transfer and acknowledge, LD to disconnect.
+					Over the link the two ends dock with the Dock protocol, and
+					the desktop queries a soup -- its name, its entry ids, and
+					each entry, one of them longer than an LT frame -- and checks
+					that every entry comes back as the Newton side has it.
+					The MNP tool and the Docker don't build yet, so the Newton
+					end of the session is scripted here from their protocols.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "HostSerial.h"
+#include "MNPTool.h"
+#include "DockProtocol.h"
+#include "DockerErrors.h"
+#include "SerialOptions.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define kToolBufferSize			997			// odd, so the spans wrap at odd places
+#define kMaxInfoSize				256			// N401, the most data in an LT frame
+#define kMaxFrameSize			(kMaxInfoSize + 8)
+#define kMaxMessageSize			(2*KByte)
+#define kSessionTimeLimit		20				// seconds
+
+#define kNumOfEntries			3
+#define kLongEntrySize			(kMaxInfoSize * 2 + 37)
+
+static const char	kNewtonName[] = "Loopback";
+static const char	kSoupName[] = "Names";
+
+
+static UByte
+PatternByte(ArrayIndex index)
+{
+	return (UByte)(index * 7 + (index >> 8));
+}
+
+
+/* -----------------------------------------------------------------------------
+	The soup the Newton side has: entry i has id i+1 and a pattern for its
+	flattened content, the second longer than an LT frame can carry.
+----------------------------------------------------------------------------- */
+
+static ArrayIndex
+EntrySize(ArrayIndex index)
+{
+	return (index == 1) ? kLongEntrySize : 20 + index;
+}
+
+
+static void
+FillEntry(ArrayIndex index, UByte * outData)
+{
+	for (ArrayIndex i = 0; i < EntrySize(index); ++i)
+		outData[i] = PatternByte(index * 1000 + i);
+}
+
+
+static void
+PutLong(UByte * outData, ULong inValue)
+{
+	outData[0] = inValue >> 24;
+	outData[1] = inValue >> 16;
+	outData[2] = inValue >> 8;
+	outData[3] = inValue;
+}
+
+
+static ULong
+GetLong(const UByte * inData)
+{
+	return (inData[0] << 24) | (inData[1] << 16) | (inData[2] << 8) | inData[3];
+}
+
+
+/* -----------------------------------------------------------------------------
+	One end of the link.
+	The Newton's end moves bytes with the port, the desktop's with its fd.
+----------------------------------------------------------------------------- */
+
+struct Link
+{
+	CHostSerialPort *	port;
+	int					fd;
+	CCircleBuf			recvBuf;
+	CCircleBuf			sendBuf;
+	UByte					sendSeq;				// N(S) of the last LT sent
+	UByte					recvSeq;				// of the last LT received
+	UByte					stream[kMaxMessageSize];	// LT data not yet made into a message
+	ArrayIndex			streamSize;
+	time_t				timeLimit;
+	ArrayIndex			numOfFCSErrors;
+};
+
+
+static bool
+InitLink(Link & ioLink, CHostSerialPort * inPort, int inFd)
+{
+	ioLink.port = inPort;
+	ioLink.fd = inFd;
+	ioLink.sendSeq = ioLink.recvSeq = 0;
+	ioLink.streamSize = 0;
+	ioLink.timeLimit = time(NULL) + kSessionTimeLimit;
+	ioLink.numOfFCSErrors = 0;
+	return ioLink.recvBuf.allocate(kToolBufferSize) == noErr
+		 && ioLink.sendBuf.allocate(kToolBufferSize) == noErr;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Move bytes between the link's buffers and the line.
+	Args:		ioLink
+	Return:	false => out of time
+----------------------------------------------------------------------------- */
+
+static bool
+Pump(Link & ioLink)
+{
+	bool isProgress = false;
+	if (ioLink.port != NULL)
+		isProgress = ioLink.port->transfer(&ioLink.recvBuf, &ioLink.sendBuf) != 0;
+	else
+	{
+		UByte * span1, * span2;
+		ArrayIndex len1, len2;
+		if (ioLink.recvBuf.putSpans(&span1, &len1, &span2, &len2) == noErr)
+		{
+			ssize_t count = read(ioLink.fd, span1, len1);
+			if (count > 0)
+			{
+				ioLink.recvBuf.updateEnd(count);
+				isProgress = true;
+			}
+		}
+		if (ioLink.sendBuf.peekSpans(&span1, &len1, &span2, &len2) == noErr)
+		{
+			ssize_t count = write(ioLink.fd, span1, len1);
+			if (count > 0)
+			{
+				ioLink.sendBuf.skipBytes(count);
+				isProgress = true;
+			}
+		}
+	}
+	if (!isProgress)
+		usleep(200);
+	return time(NULL) < ioLink.timeLimit;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Put a frame, as CFramedAsyncSerTool::putFramed() does.
+	Args:		ioLink
+				inData		the frame
+				inSize
+	Return:	false => out of time
+----------------------------------------------------------------------------- */
+
+static bool
+PutFrame(Link & ioLink, const UByte * inData, ArrayIndex inSize)
+{
+	// room for the worst case: every byte escaped
+	while (ioLink.sendBuf.bufferSpace() < 2*inSize + 7)
+		if (!Pump(ioLink))
+			return false;
+
+	CRC16 fcs;
+	ioLink.sendBuf.putNextByte(chSYN);
+	ioLink.sendBuf.putNextByte(chDLE);
+	ioLink.sendBuf.putNextByte(chSTX);
+	for (ArrayIndex i = 0; i < inSize; ++i)
+	{
+		ioLink.sendBuf.putNextByte(inData[i]);
+		if (inData[i] == chDLE)
+			ioLink.sendBuf.putNextByte(chDLE);
+	}
+	fcs.computeCRC((UByte *)inData, inSize);
+	ioLink.sendBuf.putNextByte(chDLE);
+	ioLink.sendBuf.putNextByte(chETX);
+	fcs.computeCRC(chETX);
+	fcs.get();
+	ioLink.sendBuf.putNextByte(fcs.crc16[1]);
+	ioLink.sendBuf.putNextByte(fcs.crc16[0]);
+	return Pump(ioLink);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Get a frame, as CFramedAsyncSerTool::getFramed() does: hunt for SYN DLE
+	STX, unescape to DLE ETX, and check the FCS.
+	Args:		ioLink
+				outData		the frame
+				outSize
+	Return:	false => out of time
+----------------------------------------------------------------------------- */
+
+static bool
+GetFrame(Link & ioLink, UByte * outData, ArrayIndex * outSize)
+{
+	enum { kHunt, kSYN, kDLE, kData, kEscape, kFCS1, kFCS2 };
+	int state = kHunt;
+	ArrayIndex size = 0;
+	CRC16 fcs;
+	for ( ; ; )
+	{
+		UByte ch;
+		if (ioLink.recvBuf.getNextByte(&ch) != noErr)
+		{
+			if (!Pump(ioLink))
+				return false;
+			continue;
+		}
+		switch (state)
+		{
+		case kHunt:
+			if (ch == chSYN)
+				state = kSYN;
+			break;
+		case kSYN:
+			state = (ch == chDLE) ? kDLE : kHunt;
+			break;
+		case kDLE:
+			state = (ch == chSTX) ? kData : kHunt;
+			size = 0;
+			fcs.reset();
+			break;
+		case kData:
+			if (ch == chDLE)
+				state = kEscape;
+			else if (size < kMaxFrameSize)
+				outData[size++] = ch;
+			break;
+		case kEscape:
+			if (ch == chETX)
+			{
+				fcs.computeCRC(outData, size);
+				fcs.computeCRC(chETX);
+				fcs.get();
+				state = kFCS1;
+			}
+			else
+			{
+				if (ch == chDLE && size < kMaxFrameSize)
+					outData[size++] = ch;
+				state = kData;
+			}
+			break;
+		case kFCS1:
+			state = (ch == fcs.crc16[1]) ? kFCS2 : kHunt;
+			if (state == kHunt)
+				ioLink.numOfFCSErrors++;
+			break;
+		case kFCS2:
+			if (ch == fcs.crc16[0])
+			{
+				*outSize = size;
+				return true;
+			}
+			ioLink.numOfFCSErrors++;
+			state = kHunt;
+			break;
+		}
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	M N P
+	LR as CMNPTool::xmitLR() sends it, optimised: k = 1, N401 = 256.
+----------------------------------------------------------------------------- */
+
+static bool
+SendLR(Link & ioLink)
+{
+	const UByte frame[] = { 23, kLRFrameType, 2,
+									1, 6, 1, 0, 0, 0, 0, 0xFF,		// constant parameter 2
+									2, 1, 2,								// octet-oriented framing
+									3, 1, 1,								// k
+									4, 2, kMaxInfoSize & 0xFF, kMaxInfoSize >> 8,
+									8, 1, 3 };							// fixed LT, LA frames
+	return PutFrame(ioLink, frame, sizeof(frame));
+}
+
+
+static bool
+ReceiveFrameOfType(Link & ioLink, UByte inType, UByte * outData, ArrayIndex * outSize)
+{
+	return GetFrame(ioLink, outData, outSize) && *outSize >= 2 && outData[1] == inType;
+}
+
+
+static bool
+SendLA(Link & ioLink)
+{
+	const UByte frame[] = { 3, kLAFrameType, ioLink.recvSeq, 1 };
+	return PutFrame(ioLink, frame, sizeof(frame));
+}
+
+
+static bool
+SendLD(Link & ioLink)
+{
+	const UByte frame[] = { 7, kLDFrameType, 1, 1, 0xFF, 2, 1, 0xFF };
+	return PutFrame(ioLink, frame, sizeof(frame));
+}
+
+
+/* -----------------------------------------------------------------------------
+	Send data in LT frames, one at a time, each acknowledged before the next.
+----------------------------------------------------------------------------- */
+
+static bool
+SendData(Link & ioLink, const UByte * inData, ArrayIndex inSize)
+{
+	while (inSize > 0)
+	{
+		UByte frame[kMaxFrameSize];
+		ArrayIndex count = MIN(inSize, kMaxInfoSize);
+		frame[0] = 2;
+		frame[1] = kLTFrameType;
+		frame[2] = ++ioLink.sendSeq;
+		memcpy(frame + 3, inData, count);
+		if (!PutFrame(ioLink, frame, 3 + count))
+			return false;
+
+		ArrayIndex ackSize;
+		if (!ReceiveFrameOfType(ioLink, kLAFrameType, frame, &ackSize) || ackSize != 4 || frame[2] != ioLink.sendSeq)
+			return false;
+		inData += count;
+		inSize -= count;
+	}
+	return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+	D o c k
+	A command is "newtdock", its id, its length, and its data padded to a
+	long, all longs big-endian.
+----------------------------------------------------------------------------- */
+
+static bool
+SendCommand(Link & ioLink, ULong inCommand, const void * inData, ArrayIndex inSize)
+{
+	UByte message[kMaxMessageSize];
+	ArrayIndex paddedSize = (inSize + 3) & ~3;
+	memcpy(message, "newtdock", 8);
+	PutLong(message + 8, inCommand);
+	PutLong(message + 12, inSize);
+	memcpy(message + 16, inData, inSize);
+	memset(message + 16 + inSize, 0, paddedSize - inSize);
+	return SendData(ioLink, message, 16 + paddedSize);
+}
+
+
+static bool
+SendCommand(Link & ioLink, ULong inCommand, ULong inValue)
+{
+	UByte data[4];
+	PutLong(data, inValue);
+	return SendCommand(ioLink, inCommand, data, sizeof(data));
+}
+
+
+static bool
+ReceiveCommand(Link & ioLink, ULong * outCommand, UByte * outData, ArrayIndex * outSize)
+{
+	for ( ; ; )
+	{
+		if (ioLink.streamSize >= 16)
+		{
+			if (memcmp(ioLink.stream, "newtdock", 8) != 0)
+				return false;
+			ArrayIndex size = GetLong(ioLink.stream + 12);
+			ArrayIndex messageSize = 16 + ((size + 3) & ~3);
+			if (messageSize > kMaxMessageSize)
+				return false;
+			if (ioLink.streamSize >= messageSize)
+			{
+				*outCommand = GetLong(ioLink.stream + 8);
+				*outSize = size;
+				memcpy(outData, ioLink.stream + 16, size);
+				ioLink.streamSize -= messageSize;
+				memmove(ioLink.stream, ioLink.stream + messageSize, ioLink.streamSize);
+				return true;
+			}
+		}
+
+		// take the next LT frame, and acknowledge it
+		UByte frame[kMaxFrameSize];
+		ArrayIndex frameSize;
+		if (!ReceiveFrameOfType(ioLink, kLTFrameType, frame, &frameSize) || frameSize < 3
+		||  frame[2] != (UByte)(ioLink.recvSeq + 1)
+		||  ioLink.streamSize + frameSize - 3 > kMaxMessageSize)
+			return false;
+		ioLink.recvSeq = frame[2];
+		memcpy(ioLink.stream + ioLink.streamSize, frame + 3, frameSize - 3);
+		ioLink.streamSize += frameSize - 3;
+		if (!SendLA(ioLink))
+			return false;
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	The desktop.
+	Accepts the Newton's link and docking, then queries the soup.
+----------------------------------------------------------------------------- */
+
+struct Desktop
+{
+	const char *	slaveName;
+	bool				isConnected;
+	bool				isDocked;
+	char				newtonName[64];
+	ArrayIndex		numOfEntries;
+	ArrayIndex		numOfEntriesMatched;
+	bool				isDisconnected;
+	ArrayIndex		numOfFCSErrors;
+};
+
+
+static void *
+DesktopThread(void * inDesktop)
+{
+	Desktop * desktop = (Desktop *)inDesktop;
+	int fd = open(desktop->slaveName, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0)
+		return NULL;
+	struct termios tio;
+	tcgetattr(fd, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(fd, TCSANOW, &tio);
+
+	Link link;
+	UByte data[kMaxMessageSize];
+	ArrayIndex size;
+	ULong command;
+	if (!InitLink(link, NULL, fd))
+		return NULL;
+
+	do
+	{
+		// the Newton asks for a link; we answer in kind, and it acknowledges
+		if (!ReceiveFrameOfType(link, kLRFrameType, data, &size)
+		||  !SendLR(link)
+		||  !ReceiveFrameOfType(link, kLAFrameType, data, &size))
+			break;
+		desktop->isConnected = true;
+
+		// docking
+		if (!ReceiveCommand(link, &command, data, &size) || command != kDRequestToDock
+		||  GetLong(data) != kDanteProtocolVersion
+		||  !SendCommand(link, kDInitiateDocking, kSettingUpSession)
+		||  !ReceiveCommand(link, &command, data, &size) || command != kDNewtonName
+		||  size >= sizeof(desktop->newtonName))
+			break;
+		memcpy(desktop->newtonName, data, size);
+		desktop->newtonName[size] = 0;
+		desktop->isDocked = true;
+
+		// the soup
+		if (!SendCommand(link, kDGetSoupNames, NULL, 0)
+		||  !ReceiveCommand(link, &command, data, &size) || command != kDSoupNames
+		||  size != sizeof(kSoupName) || memcmp(data, kSoupName, size) != 0
+		||  !SendCommand(link, kDSetCurrentSoup, kSoupName, sizeof(kSoupName))
+		||  !ReceiveCommand(link, &command, data, &size) || command != kDResult || GetLong(data) != noErr
+		||  !SendCommand(link, kDGetSoupIDs, NULL, 0)
+		||  !ReceiveCommand(link, &command, data, &size) || command != kDSoupIDs)
+			break;
+		desktop->numOfEntries = GetLong(data);
+		ULong ids[kNumOfEntries];
+		for (ArrayIndex i = 0; i < desktop->numOfEntries && i < kNumOfEntries; ++i)
+			ids[i] = GetLong(data + 4 + i*4);
+		for (ArrayIndex i = 0; i < desktop->numOfEntries && i < kNumOfEntries; ++i)
+		{
+			UByte entry[kMaxMessageSize];
+			if (!SendCommand(link, kDReturnEntry, ids[i])
+			||  !ReceiveCommand(link, &command, data, &size) || command != kDEntry)
+				break;
+			FillEntry(ids[i] - 1, entry);
+			if (size == EntrySize(ids[i] - 1) && memcmp(data, entry, size) == 0)
+				desktop->numOfEntriesMatched++;
+		}
+
+		// and we're done; the Newton drops the link
+		if (!SendCommand(link, kDDisconnect, NULL, 0)
+		||  !ReceiveFrameOfType(link, kLDFrameType, data, &size))
+			break;
+		desktop->isDisconnected = true;
+	} while (0);
+
+	desktop->numOfFCSErrors = link.numOfFCSErrors;
+	close(fd);
+	return NULL;
+}
+
+
+/* -----------------------------------------------------------------------------
+	The Newton.
+	Asks for a link and docking, then answers the desktop until it
+	disconnects.
+	Args:		ioLink		the Newton's end, on the port
+	Return:	number of commands answered
+----------------------------------------------------------------------------- */
+
+static ArrayIndex
+Newton(Link & ioLink)
+{
+	UByte data[kMaxMessageSize];
+	ArrayIndex size;
+	ULong command;
+	ArrayIndex numOfCommands = 0;
+
+	if (!SendLR(ioLink)
+	||  !ReceiveFrameOfType(ioLink, kLRFrameType, data, &size)
+	||  !SendLA(ioLink))
+		return 0;
+
+	if (!SendCommand(ioLink, kDRequestToDock, kDanteProtocolVersion)
+	||  !ReceiveCommand(ioLink, &command, data, &size) || command != kDInitiateDocking
+	||  GetLong(data) != kSettingUpSession
+	||  !SendCommand(ioLink, kDNewtonName, kNewtonName, strlen(kNewtonName)))
+		return 0;
+
+	bool isCurrentSoup = false;
+	while (ReceiveCommand(ioLink, &command, data, &size))
+	{
+		numOfCommands++;
+		bool isOK;
+		switch (command)
+		{
+		case kDGetSoupNames:
+			isOK = SendCommand(ioLink, kDSoupNames, kSoupName, sizeof(kSoupName));
+			break;
+		case kDSetCurrentSoup:
+			isCurrentSoup = (size == sizeof(kSoupName) && memcmp(data, kSoupName, size) == 0);
+			isOK = SendCommand(ioLink, kDResult, isCurrentSoup ? noErr : kDockErrSoupNotFound);
+			break;
+		case kDGetSoupIDs:
+			PutLong(data, kNumOfEntries);
+			for (ArrayIndex i = 0; i < kNumOfEntries; ++i)
+				PutLong(data + 4 + i*4, i + 1);
+			isOK = isCurrentSoup ? SendCommand(ioLink, kDSoupIDs, data, 4 + kNumOfEntries*4)
+										: SendCommand(ioLink, kDResult, kDockErrBadCurrentSoup);
+			break;
+		case kDReturnEntry:
+			{
+				ULong id = GetLong(data);
+				if (isCurrentSoup && id >= 1 && id <= kNumOfEntries)
+				{
+					FillEntry(id - 1, data);
+					isOK = SendCommand(ioLink, kDEntry, data, EntrySize(id - 1));
+				}
+				else
+					isOK = SendCommand(ioLink, kDResult, kDockErrEntryNotFound);
+			}
+			break;
+		case kDDisconnect:
+			SendLD(ioLink);
+			// hand the LD to the port; the desktop must have it before we close
+			while (ioLink.sendBuf.bufferCount() > 0 && Pump(ioLink))
+				;
+			return numOfCommands;
+		default:
+			isOK = SendCommand(ioLink, kDUnknownCommand, command);
+			break;
+		}
+		if (!isOK)
+			break;
+	}
+	return numOfCommands;
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	CHostSerialPort port;
+	NewtonErr err = port.open("pty");
+	CHECK(err == noErr);
+	if (err)
+		return TestResult("MNPDockLoopback");
+
+	Desktop desktop;
+	memset(&desktop, 0, sizeof(desktop));
+	desktop.slaveName = port.name();
+	pthread_t thread;
+	CHECK(pthread_create(&thread, NULL, DesktopThread, &desktop) == 0);
+
+	Link link;
+	CHECK(InitLink(link, &port, -1));
+	ArrayIndex numOfCommands = Newton(link);
+	pthread_join(thread, NULL);
+	port.close();
+
+	CHECK(desktop.isConnected);
+	CHECK(desktop.isDocked);
+	CHECK(strcmp(desktop.newtonName, kNewtonName) == 0);
+	CHECK(desktop.numOfEntries == kNumOfEntries);
+	CHECK(desktop.numOfEntriesMatched == kNumOfEntries);
+	CHECK(desktop.isDisconnected);
+	// get soup names, set current soup, get soup ids, an entry each, disconnect
+	CHECK(numOfCommands == 4 + kNumOfEntries);
+	CHECK(link.numOfFCSErrors == 0 && desktop.numOfFCSErrors == 0);
+	return TestResult("MNPDockLoopback");
+}
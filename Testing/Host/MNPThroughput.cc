@@ -0,0 +1,591 @@
+/*
+	File:		MNPThroughput.cc
+
+	Contains:	MNP loopback throughput test.
+					Pushes 100MB from one endpoint pipe to another through an
+					endpoint that loops it back as a pair of MNP tools would: the
+					sending tool takes the pipe's bytes into its put buffer and
+					frames them as LT frames -- SYN DLE STX, the header, escaped
+					data, DLE ETX, the CRC16 FCS -- onto the line; the receiving
+					tool unframes each into its get buffer, checks its FCS and
+					sequence number, and acknowledges it with an LA frame before
+					the next is sent.
+					It does so twice. As before: the pipes stage every chunk
+					through their buffers, as CBufferPipe does, and the tools
+					frame a byte at a time. As now: the pipes move whole buffers'
+					worth in place and read the rest by spans, and the tools frame
+					by circle buffer spans. Both must deliver every byte in every
+					frame; the times are printed for comparison.
+					The MNP tool and the comms manager don't build yet, so the
+					endpoint here is the two tools, scripted from the protocol.
+					Memory pipes' spans are checked too.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "EndpointPipe.h"
+#include "MemoryPipe.h"
+#include "CircleBuf.h"
+#include "CRC.h"
+#include "MNPTool.h"
+#include "CommErrors.h"
+#include "SerialOptions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define kTransferSize		(100*MByte)
+#define kChunkSize			(64*KByte)		// the client's writes and reads
+#define kPipeBufferSize		(2*KByte)		// as CEzEndpointPipe's
+#define kToolBufferSize		(4*KByte)
+#define kGetBufferSize		(kChunkSize + kToolBufferSize)	// a chunk is read once it's all written
+#define kMaxInfoSize			256				// N401, the most data in an LT frame
+#define kMaxHeaderSize		4
+#define kPatternPeriod		(37*251)
+
+
+/* -----------------------------------------------------------------------------
+	The bytes sent: plenty of DLEs, some of them in pairs, for the tools to
+	escape. The pattern repeats, so a chunk of it is sent where it lies.
+----------------------------------------------------------------------------- */
+
+static UByte	gPattern[kChunkSize + kPatternPeriod];
+
+static void
+InitPattern(void)
+{
+	for (ArrayIndex i = 0; i < sizeof(gPattern); ++i)
+	{
+		ArrayIndex index = i % kPatternPeriod;
+		gPattern[i] = ((index % 37) < 2) ? chDLE : (UByte)(index * 7 + (index >> 8));
+	}
+}
+
+
+static const UByte *
+Pattern(ArrayIndex inOffset)
+{
+	return gPattern + inOffset % kPatternPeriod;
+}
+
+
+static double
+Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/* -----------------------------------------------------------------------------
+	The loop.
+	One tool's put buffer is framed onto the line, and the other's get buffer
+	is filled from it; the LA frames come back on a line of their own.
+----------------------------------------------------------------------------- */
+
+struct Loopback
+{
+	bool			isSpans;			// frame by spans, else a byte at a time
+	CCircleBuf	putBuf;			// the sending tool's: sent, not yet framed
+	CCircleBuf	sendBuf;			// LT frames going out
+	CCircleBuf	recvBuf;			// LT frames coming in
+	CCircleBuf	ackBuf;			// LA frames coming back
+	CCircleBuf	getBuf;			// the receiving tool's: unframed, not yet received
+	UByte			sendSeq;			// N(S) of the last LT sent
+	UByte			recvSeq;			// of the last LT received
+	ArrayIndex	numOfFrames;
+	ArrayIndex	numOfBadFrames;
+};
+
+static Loopback	gLink;
+
+enum { kByte, kEnd, kBad };
+
+
+/* -----------------------------------------------------------------------------
+	Put a frame, as CFramedAsyncSerTool::putFramed() does: the header a byte
+	at a time, the data as the tool did, a byte at a time, or as
+	putFramedRun() now does, escaping runs of the put buffer's spans.
+	Args:		ioLine		the line
+				inHeader		the MNP header
+				ioData		the buffer to take its data from; NULL => none
+				inSize		how much to take
+				inIsSpans
+	Return:	--
+----------------------------------------------------------------------------- */
+
+static void
+PutEscaped(CCircleBuf & ioLine, UByte inByte)
+{
+	ioLine.putNextByte(inByte);
+	if (inByte == chDLE)
+		ioLine.putNextByte(chDLE);
+}
+
+
+static void
+PutFrame(CCircleBuf & ioLine, const UByte * inHeader, CCircleBuf * ioData, ArrayIndex inSize, bool inIsSpans)
+{
+	CRC16 fcs;
+	ioLine.putNextByte(chSYN);
+	ioLine.putNextByte(chDLE);
+	ioLine.putNextByte(chSTX);
+	for (ArrayIndex i = 0; i <= inHeader[0]; ++i)
+		PutEscaped(ioLine, inHeader[i]);
+	fcs.computeCRC((UByte *)inHeader, inHeader[0] + 1);
+
+	if (ioData != NULL && inIsSpans)
+	{
+		UByte * span[2];
+		ArrayIndex spanSize[2];
+		ioData->peekSpans(&span[0], &spanSize[0], &span[1], &spanSize[1]);
+		ArrayIndex numOfBytesTaken = 0;
+		for (ArrayIndex i = 0; i < 2 && numOfBytesTaken < inSize; ++i)
+		{
+			ArrayIndex size = MIN(spanSize[i], inSize - numOfBytesTaken);
+			numOfBytesTaken += size;
+			fcs.computeCRC(span[i], size);
+			UByte * p = span[i];
+			UByte * pEnd = p + size;
+			while (p < pEnd)
+			{
+				UByte * esc = (UByte *)memchr(p, chDLE, pEnd - p);
+				UByte * escSpanEnd = (esc != NULL) ? esc + 1 : pEnd;
+				ArrayIndex escSpanSize = escSpanEnd - p;
+				ioLine.copyIn(p, &escSpanSize);
+				if (esc != NULL)
+					ioLine.putNextByte(chDLE);
+				p = escSpanEnd;
+			}
+		}
+		ioData->updateStart(numOfBytesTaken);
+	}
+	else if (ioData != NULL)
+	{
+		UByte ch;
+		for (ArrayIndex i = 0; i < inSize && ioData->getNextByte(&ch) == noErr; ++i)
+		{
+			fcs.computeCRC(ch);
+			PutEscaped(ioLine, ch);
+		}
+	}
+
+	ioLine.putNextByte(chDLE);
+	ioLine.putNextByte(chETX);
+	fcs.computeCRC(chETX);
+	fcs.get();
+	ioLine.putNextByte(fcs.crc16[1]);
+	ioLine.putNextByte(fcs.crc16[0]);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Get a frame, as CFramedAsyncSerTool::getFramed() does: hunt for SYN DLE
+	STX, unescape to DLE ETX, and check the FCS. The data goes into the buffer
+	uncommitted -- a byte at a time with putNextPossible(), or by runs into
+	its free spans -- and is committed only if the FCS is good.
+	Args:		ioLine		the line
+				outHeader	the MNP header
+				outData		the buffer to put its data in; NULL => none
+				inIsSpans
+	Return:	false => no good frame
+----------------------------------------------------------------------------- */
+
+static int
+GetUnescaped(CCircleBuf & ioLine, UByte * outByte)
+{
+	if (ioLine.getNextByte(outByte) != noErr)
+		return kBad;
+	if (*outByte != chDLE)
+		return kByte;
+	if (ioLine.getNextByte(outByte) != noErr)
+		return kBad;
+	if (*outByte == chDLE)
+		return kByte;
+	return (*outByte == chETX) ? kEnd : kBad;
+}
+
+
+static bool
+PutPending(CCircleBuf & ioBuf, ArrayIndex inOffset, const UByte * inData, ArrayIndex inSize)
+{
+	UByte * span[2];
+	ArrayIndex spanSize[2];
+	if (ioBuf.putSpans(&span[0], &spanSize[0], &span[1], &spanSize[1]) != noErr
+	||  inOffset + inSize > spanSize[0] + spanSize[1])
+		return false;
+
+	ArrayIndex size1 = (inOffset < spanSize[0]) ? MIN(inSize, spanSize[0] - inOffset) : 0;
+	if (size1 > 0)
+		memcpy(span[0] + inOffset, inData, size1);
+	if (inSize > size1)
+		memcpy(span[1] + inOffset + size1 - spanSize[0], inData + size1, inSize - size1);
+	return true;
+}
+
+
+static bool
+GetFrame(CCircleBuf & ioLine, UByte * outHeader, CCircleBuf * outData, bool inIsSpans)
+{
+	UByte ch = 0, prev1 = 0, prev2 = 0;
+	do
+	{
+		prev2 = prev1;
+		prev1 = ch;
+		if (ioLine.getNextByte(&ch) != noErr)
+			return false;
+	} while (!(prev2 == chSYN && prev1 == chDLE && ch == chSTX));
+
+	// the header: its length, then the rest
+	CRC16 fcs;
+	if (GetUnescaped(ioLine, &outHeader[0]) != kByte || outHeader[0] >= kMaxHeaderSize)
+		return false;
+	for (ArrayIndex i = 1; i <= outHeader[0]; ++i)
+		if (GetUnescaped(ioLine, &outHeader[i]) != kByte)
+			return false;
+	fcs.computeCRC(outHeader, outHeader[0] + 1);
+
+	// the data, up to DLE ETX
+	ArrayIndex size = 0;
+	int result;
+	if (outData == NULL)
+		result = GetUnescaped(ioLine, &ch);
+	else if (inIsSpans)
+	{
+		for ( ; ; )
+		{
+			UByte * span[2];
+			ArrayIndex spanSize[2];
+			if (ioLine.peekSpans(&span[0], &spanSize[0], &span[1], &spanSize[1]) != noErr)
+				return false;
+			UByte * esc = (UByte *)memchr(span[0], chDLE, spanSize[0]);
+			ArrayIndex runSize = (esc != NULL) ? esc - span[0] : spanSize[0];
+			if (!PutPending(*outData, size, span[0], runSize))
+				return false;
+			fcs.computeCRC(span[0], runSize);
+			ioLine.updateStart(runSize);
+			size += runSize;
+			if (esc != NULL)
+			{
+				if ((result = GetUnescaped(ioLine, &ch)) != kByte)
+					break;
+				if (!PutPending(*outData, size, &ch, 1))
+					return false;
+				fcs.computeCRC(ch);
+				size++;
+			}
+		}
+	}
+	else
+	{
+		outData->putNextStart();
+		while ((result = GetUnescaped(ioLine, &ch)) == kByte)
+		{
+			if (outData->putNextPossible(ch) != noErr)
+				return false;
+			fcs.computeCRC(ch);
+			size++;
+		}
+	}
+	if (result != kEnd)
+		return false;
+
+	// the FCS
+	UByte fcs1, fcs2;
+	fcs.computeCRC(chETX);
+	fcs.get();
+	if (ioLine.getNextByte(&fcs1) != noErr || ioLine.getNextByte(&fcs2) != noErr
+	||  fcs1 != fcs.crc16[1] || fcs2 != fcs.crc16[0])
+		return false;
+
+	if (outData != NULL && inIsSpans)
+		outData->updateEnd(size);
+	else if (outData != NULL)
+		outData->putNextCommit();
+	return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Transfer one LT frame from the sending tool's put buffer to the receiving
+	tool's get buffer, and its LA back.
+	Args:		ioLink
+	Return:	false => a bad frame
+----------------------------------------------------------------------------- */
+
+static bool
+TransferLT(Loopback & ioLink)
+{
+	// send it
+	ArrayIndex size = MIN(ioLink.putBuf.bufferCount(), kMaxInfoSize);
+	UByte lt[] = { 2, kLTFrameType, ++ioLink.sendSeq };
+	PutFrame(ioLink.sendBuf, lt, &ioLink.putBuf, size, ioLink.isSpans);
+
+	// across the line
+	ioLink.recvBuf.getBytes(&ioLink.sendBuf);
+
+	// take it, and acknowledge it
+	UByte header[kMaxHeaderSize];
+	if (!GetFrame(ioLink.recvBuf, header, &ioLink.getBuf, ioLink.isSpans)
+	||  header[0] != 2 || header[1] != kLTFrameType || header[2] != (UByte)(ioLink.recvSeq + 1))
+		return false;
+	ioLink.recvSeq = header[2];
+	UByte la[] = { 3, kLAFrameType, ioLink.recvSeq, 1 };
+	PutFrame(ioLink.ackBuf, la, NULL, 0, ioLink.isSpans);
+
+	// and wait for that
+	if (!GetFrame(ioLink.ackBuf, header, NULL, ioLink.isSpans)
+	||  header[0] != 3 || header[1] != kLAFrameType || header[2] != ioLink.sendSeq)
+		return false;
+	ioLink.numOfFrames++;
+	return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+	The endpoint.
+	The pipes only send and receive. A send is framed and transferred before
+	it returns; a receive takes what the get buffer holds. It's a stream, so
+	there's always more to come.
+----------------------------------------------------------------------------- */
+
+static NewtonErr
+Send(const UByte * inData, ArrayIndex inSize)
+{
+	while (inSize > 0)
+	{
+		ArrayIndex amtLeft = inSize;
+		gLink.putBuf.copyIn((UByte *)inData, &amtLeft);
+		inData += inSize - amtLeft;
+		inSize = amtLeft;
+		while (gLink.putBuf.bufferCount() > 0)
+			if (!TransferLT(gLink))
+			{
+				gLink.numOfBadFrames++;
+				return kSerErrCRCError;
+			}
+	}
+	return noErr;
+}
+
+
+static NewtonErr
+Receive(UByte * outData, ArrayIndex * ioSize)
+{
+	ArrayIndex amtLeft = *ioSize;
+	gLink.getBuf.copyOut(outData, &amtLeft);
+	*ioSize -= amtLeft;
+	return (*ioSize > 0) ? noErr : kCommErrNoDataAvailable;
+}
+
+
+NewtonErr
+CEndpoint::nSnd(UByte * inBuf, ArrayIndex * ioCount, ULong inFlags, Timeout inTimeout, bool inSync, COptionArray * inOpt)
+{
+	return Send(inBuf, *ioCount);
+}
+
+
+NewtonErr
+CEndpoint::nSnd(CBufferSegment * inBuf, ULong inFlags, Timeout inTimeout, bool inSync, COptionArray * inOpt)
+{
+	UByte * data;
+	ArrayIndex size = inBuf->span(&data);
+	return Send(data, size);
+}
+
+
+NewtonErr
+CEndpoint::nRcv(UByte * outBuf, ArrayIndex * ioCount, ArrayIndex inThreshold, ULong * ioFlags, Timeout inTimeout, bool inSync, COptionArray * inOpt)
+{
+	*ioFlags = 0x01;
+	return Receive(outBuf, ioCount);
+}
+
+
+NewtonErr
+CEndpoint::nRcv(CBufferSegment * outBuf, ArrayIndex inThreshold, ULong * ioFlags, Timeout inTimeout, bool inSync, COptionArray * inOpt)
+{
+	UByte * data;
+	ArrayIndex size = outBuf->span(&data);
+	NewtonErr err = Receive(data, &size);
+	outBuf->hide(outBuf->getSize() - size, kSeekFromEnd);
+	*ioFlags = 0x01;
+	return err;
+}
+
+
+bool			CEndpoint::isPending(ULong inWhich) { return false; }
+NewtonErr	CEndpoint::nAbort(bool inSync) { ::abort(); }
+NewtonErr	CEndpoint::addToAppWorld(void) { ::abort(); }
+NewtonErr	CEndpoint::removeFromAppWorld(void) { ::abort(); }
+
+
+/* -----------------------------------------------------------------------------
+	What else the pipes need of the system.
+	Pipes.cc and Exceptions.cc don't build here; anything thrown is a failure.
+	Buffer segments are never shared.
+----------------------------------------------------------------------------- */
+
+DefineException(exPipe, evt.ex.pipe);
+
+extern "C" {
+void	Throw(ExceptionName inName, void * inData, ExceptionDestructor inDestructor)
+{
+	fprintf(stderr, "%s %ld thrown\n", inName, (long)inData);
+	abort();
+}
+}
+
+CPipe::CPipe() { }
+CPipe::~CPipe() { }
+void	CPipe::resetRead() { }
+void	CPipe::resetWrite() { }
+
+CUObject::~CUObject() { }
+void			CUObject::destroyObject(void) { }
+NewtonErr	CUSharedMem::init(void) { return noErr; }
+NewtonErr	CUSharedMem::setBuffer(void * inBuffer, size_t inSize, ULong inPermissions) { return noErr; }
+
+
+/* -----------------------------------------------------------------------------
+	Push kTransferSize bytes from one pipe to the other, a chunk at a time.
+	Args:		inIsInPlace		move the bytes in place and frame by spans, as
+									now; else stage them and frame by bytes, as
+									before
+	Return:	seconds taken
+----------------------------------------------------------------------------- */
+
+static double
+Loop(bool inIsInPlace)
+{
+	gLink.isSpans = inIsInPlace;
+	gLink.sendSeq = gLink.recvSeq = 0;
+	gLink.numOfFrames = gLink.numOfBadFrames = 0;
+	CHECK(gLink.putBuf.allocate(kToolBufferSize) == noErr);
+	CHECK(gLink.sendBuf.allocate(kToolBufferSize) == noErr);
+	CHECK(gLink.recvBuf.allocate(kToolBufferSize) == noErr);
+	CHECK(gLink.ackBuf.allocate(kToolBufferSize) == noErr);
+	CHECK(gLink.getBuf.allocate(kGetBufferSize) == noErr);
+
+	CEndpoint endpoint;
+	CEndpointPipe sender, receiver;
+	sender.init(&endpoint, 0, kPipeBufferSize, kNoTimeout, false, NULL);
+	receiver.init(&endpoint, kPipeBufferSize, 0, kNoTimeout, false, NULL);
+
+	UByte * chunk = (UByte *)malloc(kChunkSize);
+	ArrayIndex amtSent = 0, amtGot = 0, numOfMismatches = 0;
+	bool isEOF = false;
+	double startTime = Seconds();
+	for (ArrayIndex n = 0; amtSent < kTransferSize; ++n)
+	{
+		ArrayIndex count = MIN(kChunkSize, kTransferSize - amtSent);
+		const UByte * expected = Pattern(amtSent);
+		if (inIsInPlace)
+			sender.writeChunk(expected, count, true);
+		else
+			sender.CBufferPipe::writeChunk(expected, count, true);
+		amtSent += count;
+
+		size_t size = count;
+		if (!inIsInPlace)
+			receiver.CBufferPipe::readChunk(chunk, size, isEOF);
+		else if ((n & 1) == 0)
+			receiver.readChunk(chunk, size, isEOF);
+		else
+		{
+			// look at the bytes where they lie
+			for (size = 0; size < count; )
+			{
+				UByte * span;
+				size_t spanSize = receiver.readSpan(&span, isEOF);
+				if (spanSize == 0)
+					break;
+				spanSize = MIN(spanSize, count - size);
+				if (memcmp(span, expected + size, spanSize) != 0)
+					numOfMismatches++;
+				receiver.readSeek(spanSize, kSeekFromHere);
+				size += spanSize;
+			}
+		}
+		if (!(inIsInPlace && (n & 1) == 1) && memcmp(chunk, expected, size) != 0)
+			numOfMismatches++;
+		amtGot += size;
+		if (size < count || isEOF)
+			break;
+	}
+	double seconds = Seconds() - startTime;
+	free(chunk);
+
+	CHECK(amtGot == kTransferSize);
+	CHECK(numOfMismatches == 0);
+	CHECK(!isEOF);
+	CHECK(gLink.numOfBadFrames == 0);
+	CHECK(gLink.numOfFrames >= kTransferSize / kMaxInfoSize);
+	CHECK(gLink.getBuf.bufferCount() == 0);
+	gLink.putBuf.deallocate();
+	gLink.sendBuf.deallocate();
+	gLink.recvBuf.deallocate();
+	gLink.ackBuf.deallocate();
+	gLink.getBuf.deallocate();
+	return seconds;
+}
+
+
+/* -----------------------------------------------------------------------------
+	A memory pipe's spans are its memory, and it ends where its memory does.
+----------------------------------------------------------------------------- */
+
+static void
+CheckMemoryPipe(void)
+{
+	CBufferSegment * getBuf = CBufferSegment::make();
+	getBuf->init(gPattern, 1000);
+	CMemoryPipe reader;
+	reader.init(getBuf, NULL, true);
+
+	UByte * span;
+	bool isEOF;
+	CHECK(reader.readSpan(&span, isEOF) == 1000 && span == gPattern && !isEOF);
+	reader.readSeek(1000, kSeekFromHere);
+	CHECK(reader.readSpan(&span, isEOF) == 0 && isEOF);
+
+	// reading past the end returns what there is
+	UByte buf[200];
+	size_t size = sizeof(buf);
+	reader.readSeek(900, kSeekFromBeginning);
+	reader.readChunk(buf, size, isEOF);
+	CHECK(size == 100 && isEOF && memcmp(buf, gPattern + 900, 100) == 0);
+
+	UByte mem[64];
+	CBufferSegment * putBuf = CBufferSegment::make();
+	putBuf->init(mem, sizeof(mem));
+	CMemoryPipe writer;
+	writer.init(NULL, putBuf, true);
+
+	CHECK(writer.writeSpan(&span) == sizeof(mem) && span == mem);
+	memcpy(span, gPattern, 10);
+	writer.writeSeek(10, kSeekFromHere);
+	CHECK(writer.writePosition() == 10);
+	CHECK(writer.writeSpan(&span) == sizeof(mem) - 10 && span == mem + 10);
+	CHECK(memcmp(mem, gPattern, 10) == 0);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	InitPattern();
+	CheckMemoryPipe();
+
+	double stagedTime = Loop(false);
+	double inPlaceTime = Loop(true);
+	printf("MNP loopback of %d MB through endpoint pipes: staged by bytes %.2fs (%.0f MB/s), in place by spans %.2fs (%.0f MB/s)\n",
+				kTransferSize / MByte,
+				stagedTime, kTransferSize / MByte / stagedTime,
+				inPlaceTime, kTransferSize / MByte / inPlaceTime);
+	return TestResult("MNPThroughput");
+}
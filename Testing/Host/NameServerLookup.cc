@@ -0,0 +1,350 @@
+/*
+	File:		NameServerLookup.cc
+
+	Contains:	Name server registry test and benchmark.
+					Builds OS/NameRegistry.cc and registers 10000 names under a
+					handful of types, as ports, stores and gestalt records are,
+					checking that every one can be found, that names registered
+					under another type can't, that listeners waiting for a name
+					are answered when it arrives however much the table has
+					grown meanwhile, and that everything unregisters. Then times
+					registering, looking up and unregistering them against the
+					registry as it was: 16 lists indexed by the byte sum of the
+					name alone.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "NameServer.h"
+
+#include <string.h>
+#include <time.h>
+
+#define kNumOfNames			10000
+#define kNumOfTypes			4
+#define kNumOfListeners		16
+#define kNumOfLookups		10
+
+
+static double
+Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/* -----------------------------------------------------------------------------
+	A stub kernel: replies are checked and counted, not sent; and no name has
+	a resource arbitration record.
+----------------------------------------------------------------------------- */
+
+static ArrayIndex	gNumOfReplies;
+
+CNameServerReply::CNameServerReply()
+	:	fThing(0), fSpec(0), fResult(noErr)
+{ }
+
+NewtonErr
+CUMsgToken::replyRPC(void * inContent, size_t inSize, NewtonErr inReplyResult)
+{
+	// every thing registered is its name's index + 1
+	CRegistryListener * listener = (CRegistryListener *)((char *)this - offsetof(CRegistryListener, fMsgToken));
+	CNameServerReply * reply = (CNameServerReply *)inContent;
+	unsigned index;
+	if (sscanf(listener->fName, "Extras:Packages:App%u:Port", &index) == 1
+	&&  reply->fThing == (OpaqueRef)(index + 1))
+		gNumOfReplies++;
+	return noErr;
+}
+
+void
+ReleaseResArbInfo(CResArbitrationInfo * inInfo)
+{
+	abort();
+}
+
+
+/* -----------------------------------------------------------------------------
+	Names.
+	The registry keeps the name and type it is given, and frees them when
+	they're unregistered, so they must be NewPtrs.
+----------------------------------------------------------------------------- */
+
+static const char *	kTypes[kNumOfTypes] = { "CUPort", "CStore", "GSLT", "CUSoundDriver" };
+
+static char *
+NewString(const char * inStr)
+{
+	char * str = NewPtr(strlen(inStr) + 1);
+	strcpy(str, inStr);
+	return str;
+}
+
+static void
+MakeName(char * outName, ArrayIndex inIndex)
+{
+	sprintf(outName, "Extras:Packages:App%u:Port", (unsigned)inIndex);
+}
+
+static const char *
+TypeOf(ArrayIndex inIndex)
+{
+	return kTypes[inIndex % kNumOfTypes];
+}
+
+
+/* -----------------------------------------------------------------------------
+	The registry as it was.
+----------------------------------------------------------------------------- */
+
+struct OldEntry
+{
+	OldEntry *		fNext;
+	const char *	fName;
+	const char *	fType;
+	OpaqueRef		fThing;
+};
+
+static OldEntry *	gOldDB[16];
+
+static ArrayIndex
+OldHash(const char * inName)
+{
+	ULong sum = 0;
+	while (*inName)
+		sum += (UChar)*inName++;
+	return sum & 15;
+}
+
+static bool
+OldLookup(const char * inName, const char * inType, OpaqueRef * outThing)
+{
+	for (OldEntry * entry = gOldDB[OldHash(inName)]; entry != NULL; entry = entry->fNext)
+		if (strcmp(entry->fName, inName) == 0 && strcmp(entry->fType, inType) == 0)
+		{
+			*outThing = entry->fThing;
+			return true;
+		}
+	return false;
+}
+
+static bool
+OldRegister(const char * inName, const char * inType, OpaqueRef inThing)
+{
+	OpaqueRef thing;
+	if (OldLookup(inName, inType, &thing))
+		return false;
+	OldEntry * entry = new OldEntry;
+	entry->fName = inName;
+	entry->fType = inType;
+	entry->fThing = inThing;
+	entry->fNext = gOldDB[OldHash(inName)];
+	gOldDB[OldHash(inName)] = entry;
+	return true;
+}
+
+static bool
+OldUnregister(const char * inName, const char * inType)
+{
+	for (OldEntry ** link = &gOldDB[OldHash(inName)]; *link != NULL; link = &(*link)->fNext)
+	{
+		OldEntry * entry = *link;
+		if (strcmp(entry->fName, inName) == 0 && strcmp(entry->fType, inType) == 0)
+		{
+			*link = entry->fNext;
+			FreePtr((Ptr)entry->fName);
+			FreePtr((Ptr)entry->fType);
+			delete entry;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Register, look up and unregister through the registry as the name server
+	does: look up first, then add.
+----------------------------------------------------------------------------- */
+
+static bool
+Register(CObjectNameTable & ioDB, const char * inName, const char * inType, OpaqueRef inThing)
+{
+	OpaqueRef whatever;
+	ULong hash = CObjectNameTable::hash(inName, inType);
+	if (ioDB.lookup(hash, inName, inType, &whatever, &whatever, NULL))
+		return false;
+	return ioDB.add(hash, NewString(inName), NewString(inType), inThing, 0);
+}
+
+static bool
+Lookup(CObjectNameTable & ioDB, const char * inName, const char * inType, OpaqueRef * outThing)
+{
+	OpaqueRef spec;
+	return ioDB.lookup(CObjectNameTable::hash(inName, inType), inName, inType, outThing, &spec, NULL);
+}
+
+static bool
+Unregister(CObjectNameTable & ioDB, const char * inName, const char * inType)
+{
+	return ioDB.remove(CObjectNameTable::hash(inName, inType), inName, inType);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Correctness.
+----------------------------------------------------------------------------- */
+
+static void
+TestRegistry(void)
+{
+	CObjectNameTable	db;
+	char					name[64];
+	OpaqueRef			thing;
+
+	CHECK(db.init() == noErr);
+
+	// listeners waiting for names not yet registered, threaded on as queueForRegister does
+	gNumOfReplies = 0;
+	for (ArrayIndex i = 0; i < kNumOfListeners; ++i)
+	{
+		ArrayIndex nameIndex = i * (kNumOfNames / kNumOfListeners) + 7;
+		MakeName(name, nameIndex);
+		CRegistryListener * listener = new CRegistryListener;
+		listener->fName = NewString(name);
+		listener->fType = NewString(TypeOf(nameIndex));
+		listener->fHash = CObjectNameTable::hash(listener->fName, listener->fType);
+		CObjectNameList * list = db.bucketFor(listener->fHash);
+		listener->fNext = list->fRegisterListeners;
+		list->fRegisterListeners = listener;
+	}
+
+	ArrayIndex numOfMismatches = 0;
+	for (ArrayIndex i = 0; i < kNumOfNames; ++i)
+	{
+		MakeName(name, i);
+		if (!Register(db, name, TypeOf(i), (OpaqueRef)(i + 1)))
+			numOfMismatches++;
+	}
+	CHECK(numOfMismatches == 0);
+	CHECK(gNumOfReplies == kNumOfListeners);
+
+	// every name is there, once, under its own type only
+	for (ArrayIndex i = 0; i < kNumOfNames; ++i)
+	{
+		MakeName(name, i);
+		if (!Lookup(db, name, TypeOf(i), &thing) || thing != (OpaqueRef)(i + 1))
+			numOfMismatches++;
+		if (Lookup(db, name, TypeOf(i + 1), &thing))
+			numOfMismatches++;
+		if (Register(db, name, TypeOf(i), 0))
+			numOfMismatches++;
+	}
+	CHECK(numOfMismatches == 0);
+
+	// and the same name can be registered under another type
+	MakeName(name, 0);
+	CHECK(Register(db, name, TypeOf(1), (OpaqueRef)-1));
+	CHECK(Lookup(db, name, TypeOf(1), &thing) && thing == (OpaqueRef)-1);
+	CHECK(Unregister(db, name, TypeOf(1)));
+
+	for (ArrayIndex i = 0; i < kNumOfNames; ++i)
+	{
+		MakeName(name, i);
+		if (!Unregister(db, name, TypeOf(i)) || Lookup(db, name, TypeOf(i), &thing) || Unregister(db, name, TypeOf(i)))
+			numOfMismatches++;
+	}
+	CHECK(numOfMismatches == 0);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Benchmark.
+----------------------------------------------------------------------------- */
+
+static void
+Benchmark(void)
+{
+	CObjectNameTable	db;
+	char					name[64];
+	OpaqueRef			thing;
+	ArrayIndex			numOfMismatches = 0;
+	double				startTime, oldTime[3], newTime[3];
+
+	CHECK(db.init() == noErr);
+
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfNames; ++i)
+	{
+		MakeName(name, i);
+		if (!OldRegister(NewString(name), NewString(TypeOf(i)), (OpaqueRef)(i + 1)))
+			numOfMismatches++;
+	}
+	oldTime[0] = Seconds() - startTime;
+
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfNames; ++i)
+	{
+		MakeName(name, i);
+		if (!Register(db, name, TypeOf(i), (OpaqueRef)(i + 1)))
+			numOfMismatches++;
+	}
+	newTime[0] = Seconds() - startTime;
+
+	startTime = Seconds();
+	for (ArrayIndex n = 0; n < kNumOfLookups; ++n)
+		for (ArrayIndex i = 0; i < kNumOfNames; ++i)
+		{
+			MakeName(name, i);
+			if (!OldLookup(name, TypeOf(i), &thing) || thing != (OpaqueRef)(i + 1))
+				numOfMismatches++;
+		}
+	oldTime[1] = Seconds() - startTime;
+
+	startTime = Seconds();
+	for (ArrayIndex n = 0; n < kNumOfLookups; ++n)
+		for (ArrayIndex i = 0; i < kNumOfNames; ++i)
+		{
+			MakeName(name, i);
+			if (!Lookup(db, name, TypeOf(i), &thing) || thing != (OpaqueRef)(i + 1))
+				numOfMismatches++;
+		}
+	newTime[1] = Seconds() - startTime;
+
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfNames; ++i)
+	{
+		MakeName(name, i);
+		if (!OldUnregister(name, TypeOf(i)))
+			numOfMismatches++;
+	}
+	oldTime[2] = Seconds() - startTime;
+
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfNames; ++i)
+	{
+		MakeName(name, i);
+		if (!Unregister(db, name, TypeOf(i)))
+			numOfMismatches++;
+	}
+	newTime[2] = Seconds() - startTime;
+
+	CHECK(numOfMismatches == 0);
+	printf("%d names: register %.3fs -> %.3fs, lookup x%d %.3fs -> %.3fs, unregister %.3fs -> %.3fs\n",
+				kNumOfNames,
+				oldTime[0], newTime[0],
+				kNumOfLookups, oldTime[1], newTime[1],
+				oldTime[2], newTime[2]);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	TestRegistry();
+	Benchmark();
+	return TestResult("NameServerLookup");
+}
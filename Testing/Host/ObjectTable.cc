@@ -0,0 +1,305 @@
+/*
+	File:		ObjectTable.cc
+
+	Contains:	Kernel object table test and benchmark.
+					Fills a CObjectTable with 100k objects, growing it as it goes,
+					and times looking them up and removing them against the
+					table as it was -- 128 chains picked by the low bits of the
+					unique id, each object added at the head of its chain. Every
+					lookup must find its own object. Then iterates over a table
+					while adding to it, so that it grows under the iterator, and
+					while removing from it: every object there at the start must
+					be returned exactly once.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostKernel.h"
+#include "KernelObjects.h"
+#include "Semaphore.h"
+#include "OSErrors.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define kNumOfObjects			100000
+#define kNumOfLookups			200000
+#define kNumOfIterated			1000
+#define kTaskStackSize			(16*KByte)
+
+
+static double
+Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+static void
+DeleteObject(CObject * inObject)
+{
+	delete inObject;
+}
+
+static ScavengeProcPtr
+GetDeleter(CObject * inObject, ULong inId)
+{
+	return DeleteObject;
+}
+
+
+/* -----------------------------------------------------------------------------
+	The table as it was.
+----------------------------------------------------------------------------- */
+
+#define kOldTableSize		0x80
+#define kOldTableMask		0x7F
+
+struct OldEntry
+{
+	ObjectId		id;
+	OldEntry *	next;
+};
+
+
+class COldObjectTable
+{
+public:
+					COldObjectTable()		{ memset(fObject, 0, sizeof(fObject)); }
+
+	void			add(OldEntry * ioEntry);
+	OldEntry *	get(ObjectId inId);
+	bool			remove(ObjectId inId);
+
+private:
+	ArrayIndex	tableIndex(ObjectId inId)	{ return (inId >> kObjectTypeBits) & kOldTableMask; }
+
+	OldEntry *	fObject[kOldTableSize];
+};
+
+
+void
+COldObjectTable::add(OldEntry * ioEntry)
+{
+	OldEntry ** tableEntry = &fObject[tableIndex(ioEntry->id)];
+	ioEntry->next = *tableEntry;
+	*tableEntry = ioEntry;
+}
+
+
+OldEntry *
+COldObjectTable::get(ObjectId inId)
+{
+	for (OldEntry * entry = fObject[tableIndex(inId)]; entry != NULL; entry = entry->next)
+		if (entry->id == inId)
+			return entry;
+	return NULL;
+}
+
+
+bool
+COldObjectTable::remove(ObjectId inId)
+{
+	OldEntry * prev = NULL;
+	ArrayIndex i = tableIndex(inId);
+	for (OldEntry * entry = fObject[i]; entry != NULL; prev = entry, entry = entry->next)
+	{
+		if (entry->id == inId)
+		{
+			if (prev)
+				prev->next = entry->next;
+			else
+				fObject[i] = entry->next;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/* -----------------------------------------------------------------------------
+	100k objects.
+----------------------------------------------------------------------------- */
+
+static void
+ManyObjects(void)
+{
+	static ObjectId	ids[kNumOfObjects];
+	static CObject *	objects[kNumOfObjects];
+	static OldEntry	entries[kNumOfObjects];
+	static ArrayIndex	lookups[kNumOfLookups];
+	static CObjectTable	table;
+	COldObjectTable	oldTable;
+	unsigned int		seed = 1;
+	double				startTime, addTime, oldGetTime, newGetTime, oldRemoveTime, newRemoveTime;
+
+	CHECK(table.init() == noErr);
+	table.setScavengeProc(GetDeleter);
+
+	for (ArrayIndex i = 0; i < kNumOfObjects; ++i)
+		objects[i] = new CObject;
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfObjects; ++i)
+		ids[i] = table.add(objects[i], kPortType, kSystemId);
+	addTime = Seconds() - startTime;
+
+	// the old table takes the same ids
+	for (ArrayIndex i = 0; i < kNumOfObjects; ++i)
+	{
+		entries[i].id = ids[i];
+		oldTable.add(&entries[i]);
+	}
+
+	for (ArrayIndex i = 0; i < kNumOfLookups; ++i)
+		lookups[i] = rand_r(&seed) % kNumOfObjects;
+
+	ArrayIndex numOfMisses = 0;
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfLookups; ++i)
+		if (oldTable.get(ids[lookups[i]]) != &entries[lookups[i]])
+			numOfMisses++;
+	oldGetTime = Seconds() - startTime;
+	CHECK(numOfMisses == 0);
+
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfLookups; ++i)
+		if (table.get(ids[lookups[i]]) != objects[lookups[i]])
+			numOfMisses++;
+	newGetTime = Seconds() - startTime;
+	CHECK(numOfMisses == 0);
+
+	// ids that were never added
+	CHECK(!table.exists(kNoId));
+	CHECK(!table.exists(ids[kNumOfObjects - 1] + (1 << kObjectTypeBits)));
+	CHECK(table.get((ids[0] & ~((1 << kObjectTypeBits) - 1)) | kSemGroupType) == NULL);
+
+	// remove every other object, then the rest
+	ArrayIndex numOfFailures = 0;
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfObjects; i += 2)
+		if (!oldTable.remove(ids[i]))
+			numOfFailures++;
+	for (ArrayIndex i = 1; i < kNumOfObjects; i += 2)
+		if (!oldTable.remove(ids[i]))
+			numOfFailures++;
+	oldRemoveTime = Seconds() - startTime;
+	CHECK(numOfFailures == 0);
+
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfObjects; i += 2)
+		if (table.remove(ids[i]) != noErr)
+			numOfFailures++;
+	newRemoveTime = Seconds() - startTime;
+	CHECK(numOfFailures == 0);
+	for (ArrayIndex i = 0; i < kNumOfObjects; ++i)
+		if (table.exists(ids[i]) != (i & 1))
+			numOfFailures++;
+	CHECK(numOfFailures == 0);
+	startTime = Seconds();
+	for (ArrayIndex i = 1; i < kNumOfObjects; i += 2)
+		if (table.remove(ids[i]) != noErr)
+			numOfFailures++;
+	newRemoveTime += Seconds() - startTime;
+	CHECK(numOfFailures == 0);
+	CHECK(table.remove(ids[0]) == kOSErrItemNotFound);
+
+	CObjectTableIterator iter(&table, kNoId);
+	CHECK(iter.getNextTableId() == kNoId);
+
+	printf("%d objects, added in %.3fs: %d lookups %.3fs -> %.3fs, removal %.3fs -> %.3fs\n",
+				kNumOfObjects, addTime, kNumOfLookups, oldGetTime, newGetTime, oldRemoveTime, newRemoveTime);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Iterating while the table changes.
+	Unique ids are handed out in order, so the objects there at the start are
+	indexed by their unique id less the first's.
+----------------------------------------------------------------------------- */
+
+static void
+IterateWhileChanging(void)
+{
+	static ObjectId	ids[kNumOfIterated];
+	ArrayIndex			seen[kNumOfIterated];
+	static CObjectTable	table;
+
+	CHECK(table.init() == noErr);
+	table.setScavengeProc(GetDeleter);
+	for (ArrayIndex i = 0; i < kNumOfIterated; ++i)
+		ids[i] = table.add(new CObject, kPortType, kSystemId);
+	ObjectId firstUid = ids[0] >> kObjectTypeBits;
+	CHECK((ids[kNumOfIterated - 1] >> kObjectTypeBits) == firstUid + kNumOfIterated - 1);
+
+	// add two objects for every one returned: the table doubles twice under the iterator
+	memset(seen, 0, sizeof(seen));
+	ArrayIndex numOfOthers = 0;
+	CObjectTableIterator iter(&table, kNoId);
+	for (ObjectId id; (id = iter.getNextTableId()) != kNoId; )
+	{
+		ArrayIndex index = (id >> kObjectTypeBits) - firstUid;
+		if (index < kNumOfIterated)
+			seen[index]++;
+		else
+			numOfOthers++;
+		table.add(new CObject, kPortType, kSystemId);
+		table.add(new CObject, kPortType, kSystemId);
+	}
+	ArrayIndex numOfMisses = 0;
+	for (ArrayIndex i = 0; i < kNumOfIterated; ++i)
+		if (seen[i] != 1)
+			numOfMisses++;
+	CHECK(numOfMisses == 0);
+	// and some of those added came after it
+	CHECK(numOfOthers > 0);
+
+	// remove the object returned, and the next one, as we go
+	memset(seen, 0, sizeof(seen));
+	iter.setCurrentPosition(kNoId);
+	for (ObjectId id; (id = iter.getNextTableId()) != kNoId; )
+	{
+		ArrayIndex index = (id >> kObjectTypeBits) - firstUid;
+		if (index < kNumOfIterated)
+		{
+			seen[index]++;
+			if (index + 1 < kNumOfIterated && table.exists(ids[index + 1]))
+				CHECK(table.remove(ids[index + 1]) == noErr);
+		}
+		CHECK(table.remove(id) == noErr);
+	}
+	numOfMisses = 0;
+	for (ArrayIndex i = 0; i < kNumOfIterated; ++i)
+		if (seen[i] > 1)
+			numOfMisses++;
+	CHECK(numOfMisses == 0);
+	iter.setCurrentPosition(kNoId);
+	CHECK(iter.getNextTableId() == kNoId);
+}
+
+
+/* -----------------------------------------------------------------------------
+	The test task.
+----------------------------------------------------------------------------- */
+
+static void
+TestTask(void * inData, size_t inSize, ObjectId inTaskId)
+{
+	CHECK(CULockingSemaphore::staticInit() == noErr);
+
+	ManyObjects();
+	IterateWhileChanging();
+
+	fflush(stderr);
+	exit(TestResult("ObjectTable"));
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	BootHostKernel(TestTask, kTaskStackSize);
+	return 1;
+}
@@ -0,0 +1,475 @@
+/*
+	File:		PNGRoundTrip.cc
+
+	Contains:	PNG file test.
+					Builds Graphics/PNGFile.cc and writes random pixmaps at 1, 2,
+					4 and 8 bits a pixel, of odd widths and of sizes that take
+					more than one stored block. Each file is taken apart here,
+					with a CRC and an Adler-32 of our own, and must be a valid
+					PNG whose greys are the pixmap's inverted; it must read back
+					as written, and compare with the pixmap with no differences.
+					Pixels changed after writing must be counted and bounded
+					exactly, bits past the last pixel of a row ignored. Every
+					truncation and every single-byte corruption of a file must
+					be rejected. A fixed 4-bit image must match its golden file
+					byte for byte; run with -update to write that instead.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "PNGFile.h"
+#include "Geometry.h"
+#include "OSErrors.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define kGoldenDir			"Golden/"
+#define kScratchPath			"build/PNGRoundTrip.png"
+#define kNumOfChanges		21		// odd, so a 1x1 image still ends up changed
+
+
+// QDDrawing.cc brings in the whole object system, so just this from it
+Ptr
+PixelMapBits(const NativePixelMap * inPixmap)
+{
+	return (Ptr)inPixmap->baseAddr;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Pixel maps, leftmost pixel in the high bits.
+----------------------------------------------------------------------------- */
+
+static void
+InitPixmap(NativePixelMap * outPixmap, int inWidth, int inHeight, int inDepth)
+{
+	outPixmap->rowBytes = ((inWidth * inDepth + 31) / 32) * 4;
+	outPixmap->baseAddr = (Ptr)calloc(outPixmap->rowBytes * inHeight, 1);
+	SetRect(&outPixmap->bounds, 0, 0, inWidth, inHeight);
+	outPixmap->pixMapFlags = kPixMapPtr + inDepth;
+	outPixmap->deviceRes.h = outPixmap->deviceRes.v = 0;
+	outPixmap->grayTable = NULL;
+}
+
+
+static inline int
+GetPixel(const NativePixelMap * inPixmap, int x, int y)
+{
+	int depth = PixelDepth(inPixmap);
+	int bit = x * depth;
+	UByte bits = ((UByte *)inPixmap->baseAddr)[y * inPixmap->rowBytes + bit / 8];
+	return (bits >> (8 - depth - bit % 8)) & ((1 << depth) - 1);
+}
+
+
+static inline void
+SetPixel(NativePixelMap * ioPixmap, int x, int y, int inValue)
+{
+	int depth = PixelDepth(ioPixmap);
+	int bit = x * depth;
+	int shift = 8 - depth - bit % 8;
+	UByte * bits = (UByte *)ioPixmap->baseAddr + y * ioPixmap->rowBytes + bit / 8;
+	*bits = (*bits & ~(((1 << depth) - 1) << shift)) | (inValue << shift);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Files.
+----------------------------------------------------------------------------- */
+
+static UByte *
+ReadFile(const char * inPath, size_t * outSize)
+{
+	FILE * fp = fopen(inPath, "rb");
+	if (fp == NULL)
+		return NULL;
+	fseek(fp, 0, SEEK_END);
+	*outSize = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	UByte * data = (UByte *)malloc(*outSize + 1);
+	if (fread(data, 1, *outSize, fp) != *outSize)
+		free(data), data = NULL;
+	fclose(fp);
+	return data;
+}
+
+
+static void
+WriteFile(const char * inPath, const UByte * inData, size_t inSize)
+{
+	FILE * fp = fopen(inPath, "wb");
+	CHECK(fp != NULL);
+	if (fp != NULL)
+	{
+		CHECK(fwrite(inData, 1, inSize, fp) == inSize);
+		fclose(fp);
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	PNG, as the spec has it: a bit at a time.
+----------------------------------------------------------------------------- */
+
+static ULong
+CRC32(const UByte * inData, size_t inSize)
+{
+	ULong crc = 0xFFFFFFFF;
+	for (size_t i = 0; i < inSize; ++i)
+	{
+		crc ^= inData[i];
+		for (int bit = 0; bit < 8; ++bit)
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+	}
+	return ~crc;
+}
+
+
+static ULong
+Adler32(const UByte * inData, size_t inSize)
+{
+	ULong a = 1, b = 0;
+	for (size_t i = 0; i < inSize; ++i)
+	{
+		a = (a + inData[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	return (b << 16) | a;
+}
+
+
+static inline ULong
+BigLong(const UByte * inData)
+{
+	return ((ULong)inData[0] << 24) | (inData[1] << 16) | (inData[2] << 8) | inData[3];
+}
+
+
+/*------------------------------------------------------------------------------
+	Take a PNG file apart, checking it as we go.
+	Args:		inData				the file
+				inSize
+				outWidth				from its header
+				outHeight
+				outDepth
+				outNumOfBlocks		deflate blocks
+	Return:	the image data, filter bytes and all; caller must free()
+				NULL => the file is bad
+------------------------------------------------------------------------------*/
+
+static UByte *
+ParsePNG(const UByte * inData, size_t inSize, ULong * outWidth, ULong * outHeight, ULong * outDepth, ArrayIndex * outNumOfBlocks)
+{
+	static const UByte kSignature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+	if (inSize < 8 || memcmp(inData, kSignature, 8) != 0)
+		return NULL;
+
+	// IHDR first, IDAT next, IEND last
+	UByte * zdata = (UByte *)malloc(inSize);
+	size_t zsize = 0;
+	bool isGood = true;
+	ArrayIndex chunk = 0;
+	size_t i;
+	for (i = 8; i + 12 <= inSize && isGood; ++chunk)
+	{
+		size_t size = BigLong(inData + i);
+		const UByte * type = inData + i + 4;
+		if (i + 12 + size > inSize || CRC32(type, size + 4) != BigLong(type + 4 + size))
+			isGood = false;
+		else if (chunk == 0)
+		{
+			// greyscale, deflate, no filtering, no interlace
+			isGood = (memcmp(type, "IHDR", 4) == 0 && size == 13 && type[13] == 0 && type[14] == 0 && type[15] == 0 && type[16] == 0);
+			*outWidth = BigLong(type + 4);
+			*outHeight = BigLong(type + 8);
+			*outDepth = type[12];
+		}
+		else if (memcmp(type, "IDAT", 4) == 0)
+		{
+			memcpy(zdata + zsize, type + 4, size);
+			zsize += size;
+		}
+		else
+			isGood = (memcmp(type, "IEND", 4) == 0 && size == 0 && i + 12 == inSize);
+		i += 12 + size;
+	}
+	isGood = isGood && chunk == 3 && i == inSize && zsize >= 6;
+
+	// zlib header, stored blocks, Adler-32
+	UByte * raw = NULL;
+	if (isGood)
+	{
+		isGood = (zdata[0] == 0x78 && (zdata[0] * 256 + zdata[1]) % 31 == 0 && (zdata[1] & 0x20) == 0);
+		size_t rawSize = (1 + (*outWidth * *outDepth + 7) / 8) * *outHeight;
+		raw = (UByte *)malloc(rawSize + 1);
+		size_t rawIndex = 0, z = 2;
+		bool isFinal = false;
+		*outNumOfBlocks = 0;
+		while (isGood && !isFinal)
+		{
+			if (z + 5 > zsize - 4 || (zdata[z] & 0x06) != 0)
+			{
+				isGood = false;
+				break;
+			}
+			isFinal = zdata[z] & 1;
+			size_t len = zdata[z+1] | (zdata[z+2] << 8);
+			size_t nlen = zdata[z+3] | (zdata[z+4] << 8);
+			z += 5;
+			if ((len ^ 0xFFFF) != nlen || z + len > zsize - 4 || rawIndex + len > rawSize)
+			{
+				isGood = false;
+				break;
+			}
+			memcpy(raw + rawIndex, zdata + z, len);
+			rawIndex += len;
+			z += len;
+			(*outNumOfBlocks)++;
+		}
+		isGood = isGood && rawIndex == rawSize && z + 4 == zsize && Adler32(raw, rawSize) == BigLong(zdata + z);
+	}
+	free(zdata);
+	if (!isGood)
+		free(raw), raw = NULL;
+	return raw;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Round trips.
+----------------------------------------------------------------------------- */
+
+static void
+RoundTrip(int inWidth, int inHeight, int inDepth, unsigned int * ioSeed)
+{
+	NativePixelMap pixmap;
+	InitPixmap(&pixmap, inWidth, inHeight, inDepth);
+	size_t pixmapSize = pixmap.rowBytes * inHeight;
+	for (size_t i = 0; i < pixmapSize; ++i)
+		pixmap.baseAddr[i] = rand_r(ioSeed);
+
+	CHECK(WritePNG(&pixmap, kScratchPath) == noErr);
+
+	// a valid PNG, with the greys inverted
+	size_t fileSize;
+	UByte * file = ReadFile(kScratchPath, &fileSize);
+	CHECK(file != NULL);
+	ULong width = 0, height = 0, depth = 0;
+	ArrayIndex numOfBlocks = 0;
+	UByte * raw = file ? ParsePNG(file, fileSize, &width, &height, &depth, &numOfBlocks) : NULL;
+	CHECK(raw != NULL);
+	size_t rowSize = 1 + (inWidth * inDepth + 7) / 8;
+	if (raw != NULL)
+	{
+		CHECK(width == inWidth && height == inHeight && depth == inDepth);
+		CHECK(numOfBlocks == (rowSize * inHeight + 65534) / 65535);
+		ArrayIndex numOfBadRows = 0;
+		for (int y = 0; y < inHeight; ++y)
+		{
+			const UByte * row = raw + y * rowSize;
+			const UByte * bits = (const UByte *)pixmap.baseAddr + y * pixmap.rowBytes;
+			bool isGood = (row[0] == 0);
+			for (size_t i = 1; i < rowSize; ++i)
+				if (row[i] != (UByte)~bits[i-1])
+					isGood = false;
+			if (!isGood)
+				numOfBadRows++;
+		}
+		CHECK(numOfBadRows == 0);
+	}
+
+	// reads back as written
+	ULong readWidth, readHeight, readDepth;
+	UByte * readRaw = ReadPNG(kScratchPath, &readWidth, &readHeight, &readDepth);
+	CHECK(readRaw != NULL);
+	if (readRaw != NULL && raw != NULL)
+	{
+		CHECK(readWidth == inWidth && readHeight == inHeight && readDepth == inDepth);
+		CHECK(memcmp(readRaw, raw, rowSize * inHeight) == 0);
+	}
+	if (readRaw != NULL)
+		FreePtr((Ptr)readRaw);
+
+	// no differences, then exactly those made
+	ULong numOfPixels = 1;
+	Rect bounds;
+	CHECK(DiffPNG(&pixmap, kScratchPath, &numOfPixels, &bounds) == noErr);
+	CHECK(numOfPixels == 0 && EmptyRect(&bounds));
+
+	Rect changed;
+	SetRect(&changed, inWidth, inHeight, 0, 0);
+	for (ArrayIndex i = 0; i < kNumOfChanges; ++i)
+	{
+		// the lowest bit of a pixel, or all of them
+		int x = rand_r(ioSeed) % inWidth;
+		int y = rand_r(ioSeed) % inHeight;
+		SetPixel(&pixmap, x, y, GetPixel(&pixmap, x, y) ^ ((i & 1) ? 1 : (1 << inDepth) - 1));
+	}
+	// some may have been changed back: count what differs now, pixel by pixel
+	ArrayIndex numOfChanges = 0;
+	if (raw != NULL)
+	{
+		for (int y = 0; y < inHeight; ++y)
+		{
+			for (int x = 0; x < inWidth; ++x)
+			{
+				int bit = x * inDepth;
+				int written = ((UByte)~raw[y * rowSize + 1 + bit / 8] >> (8 - inDepth - bit % 8)) & ((1 << inDepth) - 1);
+				if (written != GetPixel(&pixmap, x, y))
+				{
+					numOfChanges++;
+					if (x < changed.left)	changed.left = x;
+					if (x >= changed.right)	changed.right = x + 1;
+					if (y < changed.top)		changed.top = y;
+					if (y >= changed.bottom)	changed.bottom = y + 1;
+				}
+			}
+		}
+		if (numOfChanges == 0)
+			SetRect(&changed, 0, 0, 0, 0);
+		CHECK(numOfChanges > 0);
+	}
+	// and bits past the last pixel of a row don't count
+	int padBits = (rowSize - 1) * 8 - inWidth * inDepth;
+	if (padBits > 0)
+		for (int y = 0; y < inHeight; ++y)
+			((UByte *)pixmap.baseAddr)[y * pixmap.rowBytes + rowSize - 2] ^= (1 << padBits) - 1;
+	CHECK(DiffPNG(&pixmap, kScratchPath, &numOfPixels, &bounds) == noErr);
+	CHECK(numOfPixels == numOfChanges);
+	CHECK(EqualRect(&bounds, &changed));
+
+	// not the same shape
+	NativePixelMap other;
+	InitPixmap(&other, inWidth + 1, inHeight, inDepth);
+	CHECK(DiffPNG(&other, kScratchPath, &numOfPixels, &bounds) == kOSErrBadParameters);
+	free(other.baseAddr);
+	InitPixmap(&other, inWidth, inHeight, inDepth == 8 ? 4 : inDepth * 2);
+	CHECK(DiffPNG(&other, kScratchPath, &numOfPixels, &bounds) == kOSErrBadParameters);
+	free(other.baseAddr);
+
+	printf("%dx%d at %d bits: %zu bytes, %u stored blocks, %u pixels changed\n",
+				inWidth, inHeight, inDepth, fileSize, numOfBlocks, numOfChanges);
+	free(raw);
+	free(file);
+	free(pixmap.baseAddr);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Damaged files.
+----------------------------------------------------------------------------- */
+
+static bool
+CanRead(const UByte * inData, size_t inSize)
+{
+	WriteFile(kScratchPath, inData, inSize);
+	ULong width, height, depth;
+	UByte * raw = ReadPNG(kScratchPath, &width, &height, &depth);
+	if (raw == NULL)
+		return false;
+	FreePtr((Ptr)raw);
+	return true;
+}
+
+
+static void
+DamagedFiles(void)
+{
+	unsigned int seed = 39;
+	NativePixelMap pixmap;
+	InitPixmap(&pixmap, 23, 9, 4);
+	for (size_t i = 0; i < pixmap.rowBytes * 9; ++i)
+		pixmap.baseAddr[i] = rand_r(&seed);
+	CHECK(WritePNG(&pixmap, kScratchPath) == noErr);
+	size_t fileSize;
+	UByte * file = ReadFile(kScratchPath, &fileSize);
+	CHECK(file != NULL);
+	if (file == NULL)
+		return;
+	CHECK(CanRead(file, fileSize));
+
+	ArrayIndex numOfTruncationsRead = 0, numOfCorruptionsRead = 0;
+	for (size_t size = 0; size < fileSize; ++size)
+		if (CanRead(file, size))
+			numOfTruncationsRead++;
+	for (size_t i = 0; i < fileSize; ++i)
+	{
+		UByte * damaged = (UByte *)malloc(fileSize);
+		memcpy(damaged, file, fileSize);
+		damaged[i] ^= 1 << (i % 8);
+		if (CanRead(damaged, fileSize))
+			numOfCorruptionsRead++;
+		free(damaged);
+	}
+	CHECK(numOfTruncationsRead == 0);
+	CHECK(numOfCorruptionsRead == 0);
+
+	// a block that is not stored, with the chunk's CRC made good
+	size_t idat = 8 + 12 + 13;
+	CHECK(memcmp(file + idat + 4, "IDAT", 4) == 0);
+	size_t idatSize = BigLong(file + idat);
+	file[idat + 8 + 2] |= 0x02;		// BTYPE = fixed Huffman
+	ULong crc = CRC32(file + idat + 4, idatSize + 4);
+	UByte * crcBytes = file + idat + 8 + idatSize;
+	crcBytes[0] = crc >> 24;  crcBytes[1] = crc >> 16;  crcBytes[2] = crc >> 8;  crcBytes[3] = crc;
+	CHECK(!CanRead(file, fileSize));
+
+	ULong numOfPixels;
+	Rect bounds;
+	CHECK(DiffPNG(&pixmap, "build/no such file.png", &numOfPixels, &bounds) == kOSErrItemNotFound);
+
+	printf("%zu byte file: every truncation and corruption rejected\n", fileSize);
+	free(file);
+	free(pixmap.baseAddr);
+}
+
+
+/* -----------------------------------------------------------------------------
+	The golden file: a 4-bit ramp across a 48x20 image, a pixel's worth of
+	each grey, then random pixels.
+----------------------------------------------------------------------------- */
+
+static void
+GoldenFile(bool inUpdate)
+{
+	NativePixelMap pixmap;
+	InitPixmap(&pixmap, 48, 20, 4);
+	unsigned int seed = 4;
+	for (int y = 0; y < 20; ++y)
+		for (int x = 0; x < 48; ++x)
+			SetPixel(&pixmap, x, y, y < 10 ? (x / 3) & 0x0F : rand_r(&seed) & 0x0F);
+
+	const char * goldenPath = kGoldenDir "PNGRoundTrip-4bit.png";
+	CHECK(WritePNG(&pixmap, inUpdate ? goldenPath : kScratchPath) == noErr);
+	size_t goldenSize, fileSize;
+	UByte * golden = ReadFile(goldenPath, &goldenSize);
+	UByte * file = ReadFile(inUpdate ? goldenPath : kScratchPath, &fileSize);
+	CHECK(golden != NULL && file != NULL);
+	if (golden != NULL && file != NULL)
+		CHECK(goldenSize == fileSize && memcmp(golden, file, fileSize) == 0);
+	free(golden);
+	free(file);
+	free(pixmap.baseAddr);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	bool isUpdate = (argc > 1 && strcmp(argv[1], "-update") == 0);
+	unsigned int seed = 1;
+	static const int kDepth[] = { 1, 2, 4, 8 };
+	for (ArrayIndex i = 0; i < sizeof(kDepth)/sizeof(kDepth[0]); ++i)
+	{
+		RoundTrip(1, 1, kDepth[i], &seed);
+		RoundTrip(13, 7, kDepth[i], &seed);
+		RoundTrip(480, 320, kDepth[i], &seed);
+	}
+	RoundTrip(319, 481, 8, &seed);
+	DamagedFiles();
+	GoldenFile(isUpdate);
+	remove(kScratchPath);
+	return TestResult("PNGRoundTrip");
+}
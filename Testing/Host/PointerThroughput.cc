@@ -0,0 +1,245 @@
+/*
+	File:		PointerThroughput.cc
+
+	Contains:	NewPtr allocator benchmark.
+					Runs two allocation workloads through NewPtr/FreePtr/ReallocPtr
+					and through plain malloc/free/realloc, as NewPtr used to be,
+					and prints the times for comparison:
+					boot	-- the kernel and utility objects created at startup:
+							mostly small and long-lived, with messages and list
+							nodes churning among them;
+					soup	-- entries built up a slot at a time, so grown by
+							ReallocPtr, indexed, then thrown away; on several
+							threads at once, as the store and the UI do.
+					Every block is filled and checked, and its size checked
+					through GetPtrSize, so the allocator must also be right.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#define kNumOfBootObjects		200000
+#define kBootChurn				4			// short-lived objects per long-lived one
+#define kNumOfSoupEntries		50000
+#define kMaxSoupSlots			24
+#define kNumOfSoupThreads		4
+
+
+static double
+Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/* -----------------------------------------------------------------------------
+	The two allocators.
+----------------------------------------------------------------------------- */
+
+struct Allocator
+{
+	const char *	name;
+	void *	(*alloc)(size_t inSize);
+	void *	(*realloc)(void * inPtr, size_t inSize);
+	void		(*free)(void * inPtr);
+	bool		hasSize;		// GetPtrSize works on its blocks
+};
+
+static void *	PtrAlloc(size_t inSize) { return NewPtr(inSize); }
+static void *	PtrRealloc(void * inPtr, size_t inSize) { return ReallocPtr((Ptr)inPtr, inSize); }
+static void		PtrFree(void * inPtr) { FreePtr((Ptr)inPtr); }
+
+static const Allocator	kNewPtr = { "NewPtr", PtrAlloc, PtrRealloc, PtrFree, true };
+static const Allocator	kMalloc = { "malloc", malloc, realloc, free, false };
+
+
+static void
+Fill(void * inPtr, size_t inSize, ArrayIndex inSeed)
+{
+	memset(inPtr, (int)(inSeed & 0xFF), inSize);
+}
+
+
+static bool
+IsFilled(const void * inPtr, size_t inSize, ArrayIndex inSeed)
+{
+	const UByte * p = (const UByte *)inPtr;
+	for (size_t i = 0; i < inSize; ++i)
+		if (p[i] != (UByte)(inSeed & 0xFF))
+			return false;
+	return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Boot.
+	Sizes are those of the commonest objects NewPtr sees while the system
+	starts: list and table nodes, CSharedMemMsgs, ports and semaphores,
+	task contexts, and now and then a buffer.
+----------------------------------------------------------------------------- */
+
+static const size_t	kBootSize[] = { 16, 24, 32, 40, 48, 64, 96, 112, 128, 200, 256, 512, 1024, 4000, 16384 };
+static const ArrayIndex	kBootWeight[] = { 20, 15, 12, 8, 10, 8, 6, 6, 5, 4, 2, 2, 1, 1, 0 };	// in 100ths; 16K once in 1000
+
+static size_t
+BootSize(unsigned int * ioSeed)
+{
+	ArrayIndex r = rand_r(ioSeed) % 1000;
+	if (r == 0)
+		return kBootSize[sizeof(kBootSize)/sizeof(kBootSize[0]) - 1];
+	r %= 100;
+	for (ArrayIndex i = 0; ; ++i)
+	{
+		if (r < kBootWeight[i])
+			return kBootSize[i];
+		r -= kBootWeight[i];
+	}
+}
+
+
+static ArrayIndex
+Boot(const Allocator & inAllocator)
+{
+	unsigned int seed = 1;
+	void ** kept = (void **)malloc(kNumOfBootObjects * sizeof(void *));
+	size_t * keptSize = (size_t *)malloc(kNumOfBootObjects * sizeof(size_t));
+	void * churn[kBootChurn];
+	ArrayIndex numOfMismatches = 0;
+
+	for (ArrayIndex i = 0; i < kNumOfBootObjects; ++i)
+	{
+		for (ArrayIndex j = 0; j < kBootChurn; ++j)
+		{
+			size_t size = BootSize(&seed);
+			churn[j] = inAllocator.alloc(size);
+			Fill(churn[j], size, j);
+		}
+		keptSize[i] = BootSize(&seed);
+		kept[i] = inAllocator.alloc(keptSize[i]);
+		Fill(kept[i], keptSize[i], i);
+		for (ArrayIndex j = 0; j < kBootChurn; ++j)
+			inAllocator.free(churn[j]);
+	}
+
+	for (ArrayIndex i = 0; i < kNumOfBootObjects; ++i)
+	{
+		if (!IsFilled(kept[i], keptSize[i], i)
+		||  (inAllocator.hasSize && GetPtrSize((Ptr)kept[i]) != (Size)keptSize[i]))
+			numOfMismatches++;
+		inAllocator.free(kept[i]);
+	}
+	free(kept);
+	free(keptSize);
+	return numOfMismatches;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Soup.
+----------------------------------------------------------------------------- */
+
+struct SoupWork
+{
+	const Allocator *	allocator;
+	unsigned int		seed;
+	ArrayIndex			numOfMismatches;
+};
+
+
+static void *
+Soup(void * inWork)
+{
+	SoupWork * work = (SoupWork *)inWork;
+	const Allocator & allocator = *work->allocator;
+	void * index[64] = { NULL };
+
+	for (ArrayIndex i = 0; i < kNumOfSoupEntries; ++i)
+	{
+		// build the entry a slot at a time
+		ArrayIndex numOfSlots = 1 + rand_r(&work->seed) % kMaxSoupSlots;
+		size_t size = 16;
+		UByte * entry = (UByte *)allocator.alloc(size);
+		Fill(entry, size, i);
+		for (ArrayIndex slot = 0; slot < numOfSlots; ++slot)
+		{
+			size_t slotSize = 8 + (rand_r(&work->seed) % 8) * 8;
+			entry = (UByte *)allocator.realloc(entry, size + slotSize);
+			Fill(entry + size, slotSize, i);
+			size += slotSize;
+		}
+		if (!IsFilled(entry, size, i)
+		||  (allocator.hasSize && GetPtrSize((Ptr)entry) != (Size)size))
+			work->numOfMismatches++;
+
+		// its index key replaces an old one
+		ArrayIndex keyIndex = rand_r(&work->seed) % 64;
+		if (index[keyIndex] != NULL)
+			allocator.free(index[keyIndex]);
+		index[keyIndex] = allocator.alloc(32);
+		Fill(index[keyIndex], 32, 0);
+
+		allocator.free(entry);
+	}
+
+	for (ArrayIndex i = 0; i < 64; ++i)
+		if (index[i] != NULL)
+			allocator.free(index[i]);
+	return NULL;
+}
+
+
+static ArrayIndex
+Soups(const Allocator & inAllocator)
+{
+	pthread_t thread[kNumOfSoupThreads];
+	SoupWork work[kNumOfSoupThreads];
+	for (ArrayIndex i = 0; i < kNumOfSoupThreads; ++i)
+	{
+		work[i].allocator = &inAllocator;
+		work[i].seed = i + 1;
+		work[i].numOfMismatches = 0;
+		CHECK(pthread_create(&thread[i], NULL, Soup, &work[i]) == 0);
+	}
+	ArrayIndex numOfMismatches = 0;
+	for (ArrayIndex i = 0; i < kNumOfSoupThreads; ++i)
+	{
+		pthread_join(thread[i], NULL);
+		numOfMismatches += work[i].numOfMismatches;
+	}
+	return numOfMismatches;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Time a workload with each allocator.
+----------------------------------------------------------------------------- */
+
+static void
+Compare(const char * inName, ArrayIndex (*inWorkload)(const Allocator &))
+{
+	const Allocator * allocator[] = { &kMalloc, &kNewPtr };
+	double seconds[2];
+	for (ArrayIndex i = 0; i < 2; ++i)
+	{
+		double startTime = Seconds();
+		CHECK(inWorkload(*allocator[i]) == 0);
+		seconds[i] = Seconds() - startTime;
+	}
+	printf("%s: %s %.3fs, %s %.3fs\n", inName, allocator[0]->name, seconds[0], allocator[1]->name, seconds[1]);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	Compare("boot", Boot);
+	Compare("soup", Soups);
+	return TestResult("PointerThroughput");
+}
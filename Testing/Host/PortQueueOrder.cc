@@ -0,0 +1,176 @@
+/*
+	File:		PortQueueOrder.cc
+
+	Contains:	Port queue ordering test.
+					Builds OS/PortQueue.cc and drives a port queue with a long
+					random mix of typed and untyped messages -- single-bit types
+					that get a bucket of their own, multi-bit types and
+					match-all that go to the fallback queue -- queued normally
+					and urgently, dequeued by every kind of type and filter,
+					rekeyed in place and removed behind the queue's back as
+					completions and timeouts do. After every step the queue must
+					agree with a plain list kept in queue order and searched
+					from the front.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "KernelPorts.h"
+#include "SharedMem.h"
+
+#include <deque>
+
+#define kNumOfMsgs		64
+#define kNumOfSteps		1000000
+
+
+/* -----------------------------------------------------------------------------
+	The reference: every queued message, in queue order.
+----------------------------------------------------------------------------- */
+
+typedef std::deque<CSharedMemMsg *> MsgList;
+
+static bool
+Matches(ULong inKey, ULong inProbe)
+{
+	return inKey == kMsgType_MatchAll
+		 || inProbe == kMsgType_MatchAll
+		 || (inKey & inProbe) != 0;
+}
+
+
+static CSharedMemMsg *
+RemoveMatch(MsgList & ioList, ULong inProbe)
+{
+	for (MsgList::iterator iter = ioList.begin(); iter != ioList.end(); ++iter)
+		if (Matches((*iter)->fPortKey, inProbe))
+		{
+			CSharedMemMsg * msg = *iter;
+			ioList.erase(iter);
+			return msg;
+		}
+	return NULL;
+}
+
+
+static void
+Remove(MsgList & ioList, CSharedMemMsg * inMsg)
+{
+	for (MsgList::iterator iter = ioList.begin(); iter != ioList.end(); ++iter)
+		if (*iter == inMsg)
+		{
+			ioList.erase(iter);
+			return;
+		}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Pick a type or filter, as senders and receivers use them: mostly one bit,
+	sometimes several, sometimes match-all.
+----------------------------------------------------------------------------- */
+
+static ULong
+RandomKey(unsigned int * ioSeed)
+{
+	ArrayIndex r = rand_r(ioSeed) % 10;
+	if (r < 6)
+		return BIT(rand_r(ioSeed) % 8);		// few types, so they collide
+	if (r < 8)
+		return BIT(rand_r(ioSeed) % 8) | BIT(rand_r(ioSeed) % 8);
+	if (r < 9)
+		return rand_r(ioSeed) | 1;
+	return kMsgType_MatchAll;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Stress the queue.
+----------------------------------------------------------------------------- */
+
+static void
+TestInterleaved(void)
+{
+	CPortQueue		queue;
+	MsgList			list;
+	CSharedMemMsg *	msg[kNumOfMsgs];
+	bool				isQueued[kNumOfMsgs];
+	unsigned int	seed = 1;
+	ArrayIndex		numOfMismatches = 0;
+
+	// the queue only uses a message's queue item and port fields, so don't construct a whole CSharedMemMsg
+	for (ArrayIndex i = 0; i < kNumOfMsgs; ++i)
+	{
+		msg[i] = (CSharedMemMsg *)calloc(1, sizeof(CSharedMemMsg));
+		isQueued[i] = false;
+	}
+
+	for (ArrayIndex step = 0; step < kNumOfSteps && numOfMismatches == 0; ++step)
+	{
+		ArrayIndex i = rand_r(&seed) % kNumOfMsgs;
+		ArrayIndex op = rand_r(&seed) % 16;
+		if (!isQueued[i])
+		{
+			// queue it: a sender by type or a receiver by filter, one in eight urgently
+			ULong key = RandomKey(&seed);
+			bool isUrgent = (op < 2);
+			queue.add(msg[i], key, isUrgent);
+			if (isUrgent)
+				list.push_front(msg[i]);
+			else
+				list.push_back(msg[i]);
+			isQueued[i] = true;
+		}
+		else if (op < 10)
+		{
+			// dequeue the first match for some probe -- perhaps nothing matches
+			ULong probe = RandomKey(&seed);
+			CSharedMemMsg * expected = RemoveMatch(list, probe);
+			CSharedMemMsg * got = (probe == kMsgType_MatchAll && (op & 1)) ? queue.remove() : queue.removeMatch(probe);
+			if (got != expected)
+				numOfMismatches++;
+			for (ArrayIndex j = 0; j < kNumOfMsgs; ++j)
+				if (msg[j] == got)
+					isQueued[j] = false;
+		}
+		else if (op < 13)
+		{
+			// reset its filter, which keeps its place
+			ULong key = RandomKey(&seed);
+			queue.rekey(msg[i], key);
+			msg[i]->fPortKey = key;
+		}
+		else
+		{
+			// it completes or times out, and is dequeued by its container
+			if (!queue.contains(msg[i]))
+				numOfMismatches++;
+			msg[i]->f80.fContainer->removeFromQueue(msg[i]);
+			Remove(list, msg[i]);
+			isQueued[i] = false;
+			if (queue.contains(msg[i]))
+				numOfMismatches++;
+		}
+	}
+	CHECK(numOfMismatches == 0);
+
+	// drain it: everything comes out in queue order
+	while (!list.empty())
+	{
+		CHECK(queue.remove() == list.front());
+		list.pop_front();
+	}
+	CHECK(queue.remove() == NULL);
+
+	for (ArrayIndex i = 0; i < kNumOfMsgs; ++i)
+		free(msg[i]);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	TestInterleaved();
+	return TestResult("PortQueueOrder");
+}
@@ -0,0 +1,244 @@
+/*
+	File:		PortableSWI.cc
+
+	Contains:	Portable SWI handler test.
+					Builds OS/SWIHandler.cc with hasPortableSWI, under
+					AddressSanitizer, with the kernel's own tasks, ports,
+					semaphores and monitors (see HostKernel.cc), and drives them
+					through the SWIs as tasks do:
+					o	the object manager monitor creates, starts and kills tasks;
+					o	a task RPCs an echo task many times, each time with a
+						pattern in its stack frame that must survive the switches,
+						and the reply, its size and its type -- returned in the
+						caller's registers -- must be what the echo task sent;
+					o	workers contend for a locking semaphore, each switching out
+						while it holds the lock, and no increment may be lost;
+					o	a receive with a timeout times out, by way of the timer
+						and the idle task.
+					Nothing here is specific to the host's processor: ucontext
+					does the switching on x86-64 and AArch64 alike.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostKernel.h"
+#include "UserTasks.h"
+#include "UserPorts.h"
+#include "Semaphore.h"
+#include "OSErrors.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define kNumOfRPCs				2000
+#define kNumOfWorkers			4
+#define kNumOfIncrements		200
+#define kTaskStackSize			(16*KByte)
+#define kPatternSize				256
+
+#define kEchoMsgType				0x01
+#define kQuitMsgType				0x02
+#define kDoneMsgType				0x04
+
+
+/* -----------------------------------------------------------------------------
+	The echo task.
+	Replies to each message with its content incremented, until told to quit.
+----------------------------------------------------------------------------- */
+
+struct EchoData
+{
+	ObjectId		port;
+};
+
+static void
+EchoTask(void * inData, size_t inSize, ObjectId inTaskId)
+{
+	EchoData *	data = (EchoData *)inData;
+	CUPort		port(data->port);
+	CUMsgToken	token;
+	ULong			msg, msgType;
+	size_t		msgSize;
+
+	CHECK(inSize == sizeof(EchoData));
+	for ( ; ; )
+	{
+		CHECK(port.receive(&msgSize, &msg, sizeof(msg), &token, &msgType) == noErr);
+		if (msgType == kQuitMsgType)
+		{
+			token.replyRPC(NULL, 0);
+			break;
+		}
+		CHECK(msgSize == sizeof(msg) && msgType == kEchoMsgType);
+		msg++;
+		token.replyRPC(&msg, sizeof(msg));
+	}
+}
+
+
+static void
+StartTask(CUTask * ioTask, TaskProcPtr inProc, void * inData, size_t inSize, ULong inName)
+{
+	CHECK(ioTask->init(inProc, kTaskStackSize, inSize, inData, kUserTaskPriority, inName) == noErr);
+	CHECK(ioTask->start() == noErr);
+}
+
+
+/* -----------------------------------------------------------------------------
+	RPCs to the echo task.
+----------------------------------------------------------------------------- */
+
+static void
+TestRPC(CUPort & inEchoPort)
+{
+	UByte			pattern[kPatternSize];
+	ArrayIndex	numOfMismatches = 0;
+
+	for (ArrayIndex i = 0; i < kNumOfRPCs; ++i)
+	{
+		ULong		msg = i, reply = 0;
+		size_t	replySize = 0;
+
+		memset(pattern, (int)(i * 17), sizeof(pattern));
+		if (inEchoPort.sendRPC(&replySize, &msg, sizeof(msg), &reply, sizeof(reply), kNoTimeout, kEchoMsgType) != noErr
+		||  replySize != sizeof(reply) || reply != i + 1)
+			numOfMismatches++;
+		for (ArrayIndex j = 0; j < sizeof(pattern); ++j)
+			if (pattern[j] != (UByte)(i * 17))
+			{
+				numOfMismatches++;
+				break;
+			}
+	}
+	CHECK(numOfMismatches == 0);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Workers contending for a lock.
+	Each RPCs the echo task while it holds the lock, so is switched out, and
+	the others block on the lock; then tells the test task it's done.
+----------------------------------------------------------------------------- */
+
+struct WorkerData
+{
+	ObjectId		echoPort;
+	ObjectId		donePort;
+	ObjectId		lock;
+	ArrayIndex	index;
+};
+
+static ArrayIndex	gCounter;
+
+static void
+WorkerTask(void * inData, size_t inSize, ObjectId inTaskId)
+{
+	WorkerData *		data = (WorkerData *)inData;
+	CUPort				echoPort(data->echoPort);
+	CUPort				donePort(data->donePort);
+	CULockingSemaphore	lock;
+
+	CHECK(lock.copyObject(data->lock) == noErr);
+	for (ArrayIndex i = 0; i < kNumOfIncrements; ++i)
+	{
+		CHECK(lock.acquire(kWaitOnBlock) == noErr);
+		ArrayIndex	count = gCounter;
+		ULong			msg = count, reply;
+		size_t		replySize;
+		CHECK(echoPort.sendRPC(&replySize, &msg, sizeof(msg), &reply, sizeof(reply), kNoTimeout, kEchoMsgType) == noErr);
+		gCounter = count + 1;
+		CHECK(lock.release() == noErr);
+	}
+	CHECK(donePort.send(&data->index, sizeof(data->index), kNoTimeout, kDoneMsgType) == noErr);
+	// and return, to be killed
+}
+
+
+static void
+TestLocking(CUPort & inEchoPort)
+{
+	CUPort				donePort;
+	CULockingSemaphore	lock;
+	static CUTask		worker[kNumOfWorkers];
+	WorkerData			data;
+	bool					isDone[kNumOfWorkers];
+
+	CHECK(donePort.init() == noErr);
+	CHECK(lock.init() == noErr);
+	gCounter = 0;
+	for (ArrayIndex i = 0; i < kNumOfWorkers; ++i)
+	{
+		data.echoPort = inEchoPort;
+		data.donePort = donePort;
+		data.lock = lock;
+		data.index = i;
+		isDone[i] = false;
+		StartTask(&worker[i], WorkerTask, &data, sizeof(data), 'wrkr');
+	}
+
+	for (ArrayIndex i = 0; i < kNumOfWorkers; ++i)
+	{
+		ArrayIndex	index;
+		size_t		msgSize;
+		ULong			msgType;
+		CHECK(donePort.receive(&msgSize, &index, sizeof(index), NULL, &msgType) == noErr);
+		CHECK(msgSize == sizeof(index) && msgType == kDoneMsgType && index < kNumOfWorkers && !isDone[index]);
+		isDone[index] = true;
+	}
+	CHECK(gCounter == kNumOfWorkers * kNumOfIncrements);
+}
+
+
+/* -----------------------------------------------------------------------------
+	A receive that times out.
+----------------------------------------------------------------------------- */
+
+static void
+TestTimeout(void)
+{
+	CUPort	port;
+	ULong		msg;
+	size_t	msgSize;
+
+	CHECK(port.init() == noErr);
+	CTime		startTime = GetGlobalTime();
+	CHECK(port.receive(&msgSize, &msg, sizeof(msg), NULL, NULL, 20*kMilliseconds) == kOSErrMessageTimedOut);
+	CHECK(GetGlobalTime() - startTime >= CTime(20, kMilliseconds));
+}
+
+
+/* -----------------------------------------------------------------------------
+	The test task.
+----------------------------------------------------------------------------- */
+
+static void
+TestTask(void * inData, size_t inSize, ObjectId inTaskId)
+{
+	CUPort			echoPort;
+	static CUTask	echoTask;
+	EchoData			data;
+
+	CHECK(CULockingSemaphore::staticInit() == noErr);
+
+	CHECK(echoPort.init() == noErr);
+	data.port = echoPort;
+	StartTask(&echoTask, EchoTask, &data, sizeof(data), 'echo');
+
+	TestRPC(echoPort);
+	TestLocking(echoPort);
+	TestTimeout();
+
+	size_t	replySize;
+	CHECK(echoPort.sendRPC(&replySize, NULL, 0, NULL, 0, kNoTimeout, kQuitMsgType) == noErr);
+
+	fflush(stderr);
+	exit(TestResult("PortableSWI"));
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	BootHostKernel(TestTask, kTaskStackSize);
+	return 1;
+}
@@ -0,0 +1,118 @@
+/*
+	File:		RegionThreads.cc
+
+	Contains:	Region arithmetic on several threads at once.
+					Each thread builds regions from random rects and checks every
+					result pixel by pixel against a bitmap of what it should be,
+					so threads that shared combine()'s scratch space would see one
+					another's rects.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "Regions.h"
+#include "Geometry.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define kNumOfThreads		4
+#define kNumOfIterations	2000
+#define kGridSize				48
+
+
+// Exceptions.cc doesn't build here; combine() only throws when out of memory
+DefineException(exOutOfMemory, evt.ex.outofmem);
+extern "C" {
+void	AddExceptionHandler(CatchHeader * inHandler) { }
+void	RemoveExceptionHandler(CatchHeader * inHandler) { }
+void	Throw(ExceptionName inName, void * inData, ExceptionDestructor inDestructor) { abort(); }
+}
+
+
+struct Bitmap
+{
+	bool	bit[kGridSize][kGridSize];
+};
+
+
+static void
+Paint(Bitmap & ioBits, const Rect & inRect, int inSelector)
+{
+	for (int y = 0; y < kGridSize; ++y)
+		for (int x = 0; x < kGridSize; ++x)
+		{
+			bool isIn = x >= inRect.left && x < inRect.right && y >= inRect.top && y < inRect.bottom;
+			if (inSelector == 0)
+				ioBits.bit[y][x] = ioBits.bit[y][x] || isIn;
+			else if (inSelector == 1)
+				ioBits.bit[y][x] = ioBits.bit[y][x] && !isIn;
+			else
+				ioBits.bit[y][x] = ioBits.bit[y][x] && isIn;
+		}
+}
+
+
+static bool
+Matches(const CBaseRegion & inRgn, const Bitmap & inBits)
+{
+	// the rects of a region don't overlap, so paint them with xor
+	Bitmap rgnBits;
+	memset(&rgnBits, 0, sizeof(rgnBits));
+	const Rect * r = inRgn.rects();
+	for (ArrayIndex i = 0; i < inRgn.rectCount(); ++i, ++r)
+		for (int y = r->top; y < r->bottom; ++y)
+			for (int x = r->left; x < r->right; ++x)
+				rgnBits.bit[y][x] = !rgnBits.bit[y][x];
+	return memcmp(&rgnBits, &inBits, sizeof(Bitmap)) == 0;
+}
+
+
+static void *
+CombineRegions(void * inSeed)
+{
+	unsigned int seed = (unsigned int)(uintptr_t)inSeed;
+	ArrayIndex numOfMismatches = 0;
+	for (ArrayIndex i = 0; i < kNumOfIterations; ++i)
+	{
+		CBaseRegion rgn;
+		Bitmap bits;
+		memset(&bits, 0, sizeof(bits));
+		for (int j = 0; j < 8; ++j)
+		{
+			Rect r;
+			int left = rand_r(&seed) % kGridSize, top = rand_r(&seed) % kGridSize;
+			SetRect(&r, left, top, left + 1 + rand_r(&seed) % (kGridSize - left), top + 1 + rand_r(&seed) % (kGridSize - top));
+			CRectangularRegion operand(r);
+			int selector = (j < 3) ? 0 : rand_r(&seed) % 3;
+			if (selector == 0)
+				rgn.unionRegion(operand);
+			else if (selector == 1)
+				rgn.diffRegion(operand);
+			else
+				rgn.sectRegion(operand);
+			Paint(bits, r, selector);
+		}
+		if (!Matches(rgn, bits))
+			numOfMismatches++;
+	}
+	return (void *)(uintptr_t)numOfMismatches;
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	pthread_t thread[kNumOfThreads];
+	for (int i = 0; i < kNumOfThreads; ++i)
+		CHECK(pthread_create(&thread[i], NULL, CombineRegions, (void *)(uintptr_t)(i + 1)) == 0);
+	for (int i = 0; i < kNumOfThreads; ++i)
+	{
+		void * numOfMismatches;
+		pthread_join(thread[i], &numOfMismatches);
+		CHECK(numOfMismatches == NULL);
+	}
+	return TestResult("RegionThreads");
+}
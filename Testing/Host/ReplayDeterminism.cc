@@ -0,0 +1,438 @@
+/*
+	File:		ReplayDeterminism.cc
+
+	Contains:	Event replay test.
+					Builds Platform/EventReplay.cc and OS/VirtualClock.cc against
+					a fake Newton: a host thread that takes the timer interrupt
+					when the virtual clock fires it, keeps a periodic alarm set as
+					the kernel's timers would, comes up some virtual time after
+					boot, and takes tablet samples from the replayer's ring --
+					all with random host delays. A session is recorded with
+					CEventRecorder against the virtual clock, loaded back, and
+					must be as recorded; malformed logs must be rejected. Then
+					the log is replayed twice, with different host delays: the
+					Newton must see every sample at the virtual time it was
+					recorded at, take the same timer interrupts, and end at the
+					same time, both times. A Newton that hangs, and one that never
+					comes up, must time the replay out.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "EventReplay.h"
+#include "HeadlessDisplay.h"
+#include "TabletBuffer.h"
+#include "KernelGlobals.h"
+#include "OSErrors.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <thread>
+
+#define kLogPath				"build/ReplayDeterminism.log"
+#define kNumOfEvents			400
+#define kMaxEventGap			(40*kMilliseconds)
+#define kWorldTick			(17*kMilliseconds)	// the Newton's own timers: not in step with the replayer's
+#define kBootTime				(2*kSeconds)
+#define kNeverBoot			(1000*kSeconds)
+
+
+/* -----------------------------------------------------------------------------
+	What EventReplay.cc needs of the rest of the app.
+----------------------------------------------------------------------------- */
+
+// VirtualClock.cc's, for Timers.cc
+extern bool		IsClockVirtual(void);
+extern CTime	GetVirtualClock(void);
+extern void		SetVirtualAlarm(CTime inTime);
+extern void		VirtualAlarmTaken(void);
+
+// Timers.cc's
+CTime
+GetClock(void)
+{
+	return GetVirtualClock();
+}
+
+// MPInterface.cc's
+CLockFreeRingBuffer	gFakeTabletSamples[kNumOfFakeTablets];
+
+NewtonErr
+InsertFakeTabletSample(ULong inSample, ArrayIndex inTablet)
+{
+	if (gFakeTabletSamples[inTablet].putn(&inSample, sizeof(ULong)) == 0)
+		return -56006;
+	if (gEventRecorder && inTablet == kPenTabletSamples)
+		gEventRecorder->record(inSample);
+	return noErr;
+}
+
+// KernelGlobals.h brings in the scheduler's vtable, as it does for Timers.cc in the framework
+void			CScheduler::remove(CTask * inTask) { }
+
+// there is no display here; the replayer only uses it if it's headless
+bool							gWantHeadlessDisplay = false;
+CHeadlessDisplayDriver *	gHeadlessDisplay = NULL;
+void			CHeadlessDisplayDriver::setFrameDirectories(const char * inCaptureDir, const char * inGoldenDir) { }
+ArrayIndex	CHeadlessDisplayDriver::reportTimings(FILE * inFile) { return 0; }
+
+
+/* -----------------------------------------------------------------------------
+	The fake Newton.
+	The idle task and a busy one are just markers for gCurrentTask; the
+	tablet buffer holds the one sample being taken.
+----------------------------------------------------------------------------- */
+
+bool			gNewtIsAliveAndWell;
+CTask *		gCurrentTask;
+CTask *		gIdleTask;
+
+static char		gIdle, gBusy;
+static bool		gIsInterruptRequested;
+static ArrayIndex	gTabletBufferCount;
+static bool		gIsWorldStopping;
+
+struct World
+{
+	unsigned int	seed;				// for host delays
+	long				maxDelay;		// microseconds
+	int64_t			bootTime;		// virtual
+	ArrayIndex		hangAt;			// stay busy from this sample on
+	int64_t			aliveTime;		// virtual time it came up at
+	int64_t			endTime;			// virtual time it was stopped at
+	ArrayIndex		numOfInterrupts;
+	ArrayIndex		numOfSamples;
+	ReplayEvent		samples[kNumOfEvents];	// as the Newton saw them
+};
+
+
+void
+SetPlatformAlarm(int64_t inDelta)
+{
+	__atomic_store_n(&gIsInterruptRequested, true, __ATOMIC_SEQ_CST);
+}
+
+bool
+TabletBufferEmpty(void)
+{
+	return __atomic_load_n(&gTabletBufferCount, __ATOMIC_SEQ_CST) == 0;
+}
+
+
+static void
+HostDelay(World * ioWorld)
+{
+	long delay = ioWorld->maxDelay ? rand_r(&ioWorld->seed) % ioWorld->maxDelay : 0;
+	struct timespec interval;
+	interval.tv_sec = 0;
+	interval.tv_nsec = delay * 1000;
+	if (delay)
+		nanosleep(&interval, NULL);
+}
+
+
+static void
+SetCurrentTask(void * inTask)
+{
+	__atomic_store_n(&gCurrentTask, (CTask *)inTask, __ATOMIC_SEQ_CST);
+}
+
+
+static void
+RunWorld(World * ioWorld)
+{
+	bool isHung = false;
+	while (!__atomic_load_n(&gIsWorldStopping, __ATOMIC_SEQ_CST))
+	{
+		if (isHung)
+			std::this_thread::yield();
+
+		else if (__atomic_exchange_n(&gIsInterruptRequested, false, __ATOMIC_SEQ_CST))
+		{
+			// the timer interrupt: as TimerInterruptHandler, set the next alarm before it's taken
+			SetCurrentTask(&gBusy);
+			HostDelay(ioWorld);
+			ioWorld->numOfInterrupts++;
+			CTime now = GetVirtualClock();
+			if (!gNewtIsAliveAndWell && (int64_t)now >= ioWorld->bootTime)
+			{
+				ioWorld->aliveTime = now;
+				__atomic_store_n(&gNewtIsAliveAndWell, true, __ATOMIC_SEQ_CST);
+			}
+			SetVirtualAlarm(now + CTime(kWorldTick));
+			VirtualAlarmTaken();
+			SetCurrentTask(&gIdle);
+		}
+
+		else if (!gFakeTabletSamples[kReplayTabletSamples].isEmpty())
+		{
+			// busy before the ring is empty, so the replayer can't see us settled in between
+			SetCurrentTask(&gBusy);
+			ULong sample;
+			__atomic_store_n(&gTabletBufferCount, 1, __ATOMIC_SEQ_CST);
+			gFakeTabletSamples[kReplayTabletSamples].getn(&sample, sizeof(sample));
+			HostDelay(ioWorld);
+			if (ioWorld->numOfSamples < kNumOfEvents)
+			{
+				ioWorld->samples[ioWorld->numOfSamples].time = GetVirtualClock();
+				ioWorld->samples[ioWorld->numOfSamples].sample = sample;
+			}
+			if (++ioWorld->numOfSamples == ioWorld->hangAt)
+			{
+				isHung = true;
+				continue;
+			}
+			__atomic_store_n(&gTabletBufferCount, 0, __ATOMIC_SEQ_CST);
+			SetCurrentTask(&gIdle);
+		}
+
+		else
+			std::this_thread::yield();
+	}
+	ioWorld->endTime = GetVirtualClock();
+}
+
+
+/*------------------------------------------------------------------------------
+	Boot the fake Newton and replay a log against it.
+	Args:		inPath				the log
+				ioWorld				the Newton
+	Return:	what CEventReplayer::run returned
+------------------------------------------------------------------------------*/
+
+static NewtonErr
+Replay(const char * inPath, World * ioWorld)
+{
+	static UByte sampleBuf[kNumOfFakeTablets][kFakeTabletSampleBufSize * sizeof(ULong)];
+	for (ArrayIndex i = 0; i < kNumOfFakeTablets; ++i)
+		gFakeTabletSamples[i].init(sampleBuf[i], sizeof(sampleBuf[i]));
+	gNewtIsAliveAndWell = false;
+	gIsInterruptRequested = false;
+	gTabletBufferCount = 0;
+	gIsWorldStopping = false;
+	gIdleTask = (CTask *)&gIdle;
+	gCurrentTask = gIdleTask;
+
+	CEventReplayer replayer;
+	NewtonErr err = replayer.load(inPath);
+	CHECK(err == noErr);
+	CEventReplayer::prepare();
+	CHECK(IsClockVirtual());
+	CHECK(gWantHeadlessDisplay);
+	gWantHeadlessDisplay = false;
+
+	// the kernel's first timer, set as it boots
+	SetVirtualAlarm(CTime(kWorldTick));
+	std::thread world(RunWorld, ioWorld);
+	if (err == noErr)
+		err = replayer.run(NULL, NULL, NULL);
+	__atomic_store_n(&gIsWorldStopping, true, __ATOMIC_SEQ_CST);
+	world.join();
+	SetVirtualClock(false);
+	return err;
+}
+
+
+static void
+InitWorld(World * outWorld, unsigned int inSeed, long inMaxDelay)
+{
+	memset(outWorld, 0, sizeof(World));
+	outWorld->seed = inSeed;
+	outWorld->maxDelay = inMaxDelay;
+	outWorld->bootTime = kBootTime;
+	outWorld->hangAt = kIndexNotFound;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Recording and loading.
+----------------------------------------------------------------------------- */
+
+static void
+RecordSession(ReplayEvent * outEvents)
+{
+	static UByte sampleBuf[kFakeTabletSampleBufSize * sizeof(ULong)];
+	gFakeTabletSamples[kPenTabletSamples].init(sampleBuf, sizeof(sampleBuf));
+	SetVirtualClock(true);
+
+	// some time passes before recording starts
+	AdvanceVirtualClock(CTime(1234567));
+	CEventRecorder recorder;
+	CHECK(recorder.start(kLogPath) == noErr);
+	CHECK(gEventRecorder == &recorder);
+	unsigned int seed = 39;
+	int64_t now = 0;
+	for (ArrayIndex i = 0; i < kNumOfEvents; ++i)
+	{
+		// strokes of samples a few milliseconds apart, some at the same time, with gaps between
+		int64_t gap = (i % 40 == 0) ? rand_r(&seed) % kMaxEventGap * 10 : rand_r(&seed) % kMaxEventGap;
+		if (rand_r(&seed) % 8 == 0)
+			gap = 0;
+		AdvanceVirtualClock(CTime(gap));
+		now += gap;
+		outEvents[i].time = now;
+		outEvents[i].sample = rand_r(&seed);
+		CHECK(InsertFakeTabletSample(outEvents[i].sample, kPenTabletSamples) == noErr);
+		// the inker takes it
+		gFakeTabletSamples[kPenTabletSamples].flush();
+	}
+	// samples from the replayer's ring are not recorded
+	static UByte replayBuf[kFakeTabletSampleBufSize * sizeof(ULong)];
+	gFakeTabletSamples[kReplayTabletSamples].init(replayBuf, sizeof(replayBuf));
+	CHECK(InsertFakeTabletSample(0x12345678, kReplayTabletSamples) == noErr);
+	recorder.stop();
+	CHECK(gEventRecorder == NULL);
+	SetVirtualClock(false);
+}
+
+
+static void
+WriteLog(const char * inText)
+{
+	FILE * fp = fopen(kLogPath, "w");
+	CHECK(fp != NULL);
+	if (fp != NULL)
+	{
+		fputs(inText, fp);
+		fclose(fp);
+	}
+}
+
+
+static void
+LoadLogs(const ReplayEvent * inEvents)
+{
+	CEventReplayer replayer;
+	CHECK(replayer.load(kLogPath) == noErr);
+	CHECK(replayer.count() == kNumOfEvents);
+
+	// compare the file with what was recorded, line by line
+	FILE * fp = fopen(kLogPath, "r");
+	CHECK(fp != NULL);
+	if (fp != NULL)
+	{
+		char line[128];
+		CHECK(fgets(line, sizeof(line), fp) != NULL && strncmp(line, kEventLogSignature, strlen(kEventLogSignature)) == 0);
+		ArrayIndex numOfBadLines = 0, numOfLines = 0;
+		while (fgets(line, sizeof(line), fp) != NULL)
+		{
+			long long time;
+			unsigned int sample;
+			if (numOfLines >= kNumOfEvents
+			||  sscanf(line, "%lld pen %x", &time, &sample) != 2
+			||  time != inEvents[numOfLines].time || sample != inEvents[numOfLines].sample)
+				numOfBadLines++;
+			numOfLines++;
+		}
+		fclose(fp);
+		CHECK(numOfLines == kNumOfEvents);
+		CHECK(numOfBadLines == 0);
+	}
+
+	// comments and blank lines are skipped
+	WriteLog(kEventLogSignature "\n# a comment\n\n0 pen 00000001\n10 pen 00000002\n10 pen 00000003\n");
+	CHECK(replayer.load(kLogPath) == noErr);
+	CHECK(replayer.count() == 3);
+
+	// anything else is rejected, leaving nothing to replay
+	static const char * kBadLogs[] =
+	{
+		"",
+		"0 pen 00000001\n",
+		"# Newton event log 2\n0 pen 00000001\n",
+		kEventLogSignature "\n0 pen 00000001\n10 key 00000002\n",
+		kEventLogSignature "\n10 pen 00000001\n9 pen 00000002\n",
+		kEventLogSignature "\n0 pen\n",
+		kEventLogSignature "\npen 00000001\n",
+	};
+	ArrayIndex numOfAccepted = 0;
+	for (ArrayIndex i = 0; i < sizeof(kBadLogs)/sizeof(kBadLogs[0]); ++i)
+	{
+		WriteLog(kBadLogs[i]);
+		if (replayer.load(kLogPath) != kOSErrBadParameters || replayer.count() != 0)
+		{
+			if (numOfAccepted++ == 0)
+				fprintf(stderr, "bad log %u accepted\n", i);
+		}
+	}
+	CHECK(numOfAccepted == 0);
+	CHECK(replayer.load("build/no such log") == kOSErrItemNotFound);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Replaying.
+----------------------------------------------------------------------------- */
+
+static void
+ReplayLog(const ReplayEvent * inEvents)
+{
+	static World worlds[2];
+	InitWorld(&worlds[0], 1, 0);
+	InitWorld(&worlds[1], 2, 300);
+
+	for (ArrayIndex w = 0; w < 2; ++w)
+	{
+		World * world = &worlds[w];
+		CHECK(Replay(kLogPath, world) == noErr);
+		CHECK(world->aliveTime >= kBootTime);
+		CHECK(world->numOfSamples == kNumOfEvents);
+		ArrayIndex numOfMisses = 0;
+		for (ArrayIndex i = 0; i < kNumOfEvents && i < world->numOfSamples; ++i)
+		{
+			if (world->samples[i].sample != inEvents[i].sample
+			||  world->samples[i].time != world->aliveTime + inEvents[i].time)
+			{
+				if (numOfMisses++ == 0)
+					fprintf(stderr, "replay %u: sample %u at %lld, recorded at %lld\n", w, i,
+									(long long)(world->samples[i].time - world->aliveTime), (long long)inEvents[i].time);
+			}
+		}
+		CHECK(numOfMisses == 0);
+		CHECK(world->endTime >= world->aliveTime + inEvents[kNumOfEvents-1].time + kReplaySettleTime);
+		printf("replay %u, host delays up to %ldus: %u samples, %u timer interrupts, %.3fs virtual\n",
+					w, world->maxDelay, world->numOfSamples, world->numOfInterrupts, world->endTime / 1e6);
+	}
+
+	// the same both times
+	CHECK(worlds[0].aliveTime == worlds[1].aliveTime);
+	CHECK(worlds[0].numOfInterrupts == worlds[1].numOfInterrupts);
+	CHECK(worlds[0].endTime == worlds[1].endTime);
+	CHECK(memcmp(worlds[0].samples, worlds[1].samples, sizeof(worlds[0].samples)) == 0);
+}
+
+
+static void
+ReplayTimesOut(void)
+{
+	static World world;
+	InitWorld(&world, 3, 100);
+	world.hangAt = kNumOfEvents / 2;
+	CHECK(Replay(kLogPath, &world) == kOSErrMessageTimedOut);
+	CHECK(world.numOfSamples == kNumOfEvents / 2);
+
+	InitWorld(&world, 4, 0);
+	world.bootTime = kNeverBoot;
+	CHECK(Replay(kLogPath, &world) == kOSErrMessageTimedOut);
+	CHECK(world.numOfSamples == 0);
+	CHECK(world.endTime >= kReplayMaxBootTime && world.endTime < kReplayMaxBootTime + kReplayTick + kWorldTick);
+	printf("a Newton that hangs, and one that never comes up: timed out\n");
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	static ReplayEvent events[kNumOfEvents];
+	RecordSession(events);
+	LoadLogs(events);
+
+	// the recording again, for replay
+	RecordSession(events);
+	ReplayLog(events);
+	ReplayTimesOut();
+	remove(kLogPath);
+	return TestResult("ReplayDeterminism");
+}
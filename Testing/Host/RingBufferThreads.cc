@@ -0,0 +1,231 @@
+/*
+	File:		RingBufferThreads.cc
+
+	Contains:	Lock-free ring buffer stress test.
+					Built under ThreadSanitizer. A producer thread streams a
+					pattern through the buffer to a consumer thread, in chunks of
+					several sizes and through both the copying and the span calls,
+					and the consumer checks every byte. Then two producers put
+					whole samples, each into a ring of its own as the fake
+					tablet's do, and the consumer, draining the rings in turn,
+					checks that none is lost, torn or reordered.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "LockFreeRingBuffer.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#define kBufferSize			1024
+#define kStreamSize			(512*KByte)
+#define kNumOfProducers		2
+#define kNumOfSamples		100000
+
+
+static UByte
+PatternByte(ArrayIndex index)
+{
+	return (UByte)(index * 7 + (index >> 8));
+}
+
+
+/* -----------------------------------------------------------------------------
+	Stream kStreamSize bytes from one thread to another.
+----------------------------------------------------------------------------- */
+
+struct Stream
+{
+	CLockFreeRingBuffer	buf;
+	size_t					chunkSize;
+	bool						isSpans;			// fill and drain through the span calls
+	ArrayIndex				numOfMismatches;
+};
+
+
+static void *
+StreamProducer(void * inStream)
+{
+	Stream *	stream = (Stream *)inStream;
+	UByte		chunk[4*KByte];
+	for (ArrayIndex index = 0; index < kStreamSize; )
+	{
+		size_t count = MIN(stream->chunkSize, kStreamSize - index);
+		size_t amtPut;
+		if (stream->isSpans)
+		{
+			UByte * span1, * span2;
+			size_t len1, len2;
+			stream->buf.computePutVectors(span1, len1, span2, len2);
+			amtPut = 0;
+			for ( ; amtPut < count && amtPut < len1; ++amtPut)
+				span1[amtPut] = PatternByte(index + amtPut);
+			for ( ; amtPut < count && amtPut < len1 + len2; ++amtPut)
+				span2[amtPut - len1] = PatternByte(index + amtPut);
+			stream->buf.updatePutVector(amtPut);
+		}
+		else
+		{
+			for (size_t i = 0; i < count; ++i)
+				chunk[i] = PatternByte(index + i);
+			amtPut = stream->buf.putn(chunk, count);
+		}
+		index += amtPut;
+		if (amtPut == 0)
+			sched_yield();
+	}
+	return NULL;
+}
+
+
+static void *
+StreamConsumer(void * inStream)
+{
+	Stream *	stream = (Stream *)inStream;
+	UByte		chunk[4*KByte];
+	for (ArrayIndex index = 0, pass = 0; index < kStreamSize; ++pass)
+	{
+		size_t count = MIN(stream->chunkSize, sizeof(chunk));
+		size_t amtGot;
+		if (stream->isSpans)
+		{
+			UByte * span1, * span2;
+			size_t len1, len2;
+			stream->buf.computeGetVectors(span1, len1, span2, len2);
+			amtGot = MIN(count, len1 + len2);
+			for (size_t i = 0; i < amtGot; ++i)
+				if ((i < len1 ? span1[i] : span2[i - len1]) != PatternByte(index + i))
+					stream->numOfMismatches++;
+			stream->buf.updateGetVector(amtGot);
+		}
+		else
+		{
+			// alternately get, and peek then skip
+			if (pass & 1)
+			{
+				amtGot = stream->buf.peekn(chunk, count);
+				CHECK(stream->buf.skip(amtGot) == amtGot);
+			}
+			else
+				amtGot = stream->buf.getn(chunk, count);
+			for (size_t i = 0; i < amtGot; ++i)
+				if (chunk[i] != PatternByte(index + i))
+					stream->numOfMismatches++;
+		}
+		index += amtGot;
+		if (amtGot == 0)
+			sched_yield();
+	}
+	return NULL;
+}
+
+
+static void
+TestStream(size_t inChunkSize, bool inIsSpans)
+{
+	Stream stream;
+	CHECK(stream.buf.init(kBufferSize) == noErr);
+	stream.chunkSize = inChunkSize;
+	stream.isSpans = inIsSpans;
+	stream.numOfMismatches = 0;
+
+	pthread_t producer, consumer;
+	CHECK(pthread_create(&producer, NULL, StreamProducer, &stream) == 0);
+	CHECK(pthread_create(&consumer, NULL, StreamConsumer, &stream) == 0);
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+
+	CHECK(stream.numOfMismatches == 0);
+	CHECK(stream.buf.isEmpty());
+}
+
+
+/* -----------------------------------------------------------------------------
+	Several producers putting whole samples, each into its own ring.
+	A sample is its producer in the top byte and its sequence number below.
+----------------------------------------------------------------------------- */
+
+static CLockFreeRingBuffer	gSamples[kNumOfProducers];
+
+
+static void *
+SampleProducer(void * inProducer)
+{
+	ULong producer = (ULong)(uintptr_t)inProducer;
+	for (ULong seq = 0; seq < kNumOfSamples; )
+	{
+		ULong sample = (producer << 24) | seq;
+		size_t amtPut = gSamples[producer].putn(&sample, sizeof(sample));
+		if (amtPut == sizeof(sample))
+			++seq;
+		else
+		{
+			CHECK(amtPut == 0);
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+
+static void
+TestSamples(void)
+{
+	static ULong samples[kNumOfProducers][128];
+	for (ArrayIndex i = 0; i < kNumOfProducers; ++i)
+		CHECK(gSamples[i].init((UByte *)samples[i], sizeof(samples[i])) == noErr);
+
+	pthread_t producer[kNumOfProducers];
+	for (ArrayIndex i = 0; i < kNumOfProducers; ++i)
+		CHECK(pthread_create(&producer[i], NULL, SampleProducer, (void *)(uintptr_t)i) == 0);
+
+	// as InsertArmisticeSamples does: each ring in turn, peek a few, skip each once it is used
+	ULong nextSeq[kNumOfProducers];
+	memset(nextSeq, 0, sizeof(nextSeq));
+	ArrayIndex numOfSamples = 0, numOfMismatches = 0;
+	while (numOfSamples < kNumOfProducers * kNumOfSamples)
+	{
+		size_t total = 0;
+		for (ArrayIndex ring = 0; ring < kNumOfProducers; ++ring)
+		{
+			ULong sample[10];
+			size_t count = gSamples[ring].peekn(sample, sizeof(sample));
+			CHECK(count % sizeof(ULong) == 0);
+			count /= sizeof(ULong);
+			for (size_t i = 0; i < count; ++i)
+			{
+				ULong producer = sample[i] >> 24;
+				if (producer != ring || (sample[i] & 0x00FFFFFF) != nextSeq[producer]++)
+					numOfMismatches++;
+				gSamples[ring].skip(sizeof(ULong));
+			}
+			total += count;
+		}
+		numOfSamples += total;
+		if (total == 0)
+			sched_yield();
+	}
+
+	for (ArrayIndex i = 0; i < kNumOfProducers; ++i)
+		pthread_join(producer[i], NULL);
+	CHECK(numOfMismatches == 0);
+	for (ArrayIndex i = 0; i < kNumOfProducers; ++i)
+		CHECK(gSamples[i].isEmpty());
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	const size_t chunkSize[] = { 1, 7, 1000, 4096 };
+	for (ArrayIndex i = 0; i < sizeof(chunkSize) / sizeof(chunkSize[0]); ++i)
+	{
+		TestStream(chunkSize[i], false);
+		TestStream(chunkSize[i], true);
+	}
+	TestSamples();
+	return TestResult("RingBufferThreads");
+}
@@ -0,0 +1,384 @@
+/*
+	File:		RingBufferThroughput.cc
+
+	Contains:	Lock-free ring buffer throughput test.
+					Times the lock-free ring buffer against a ring that takes a
+					lock round every call, as CTaskSafeRingBuffer does with its
+					semaphores -- here a pthread mutex, since the host has no
+					Newton tasks. First a stream of bytes between two threads,
+					through both the copying calls and the span calls; then two
+					producers putting tablet samples, into one ring under a lock
+					as the fake tablet did, and into a ring each as it does now.
+					Every byte and sample must come through; the times are
+					printed for comparison.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "LockFreeRingBuffer.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+#define kBufferSize			(4*KByte)
+#define kStreamSize			(64*MByte)
+#define kChunkSize			(1*KByte)
+#define kNumOfProducers		2
+#define kNumOfSamples		1000000
+#define kSampleBufSize		(128*sizeof(ULong))
+
+
+static UByte
+PatternByte(ArrayIndex index)
+{
+	return (UByte)(index * 7 + (index >> 8));
+}
+
+
+static double
+Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/* -----------------------------------------------------------------------------
+	A ring under a lock.
+	The put and get pointers and the copying follow CTaskSafeRingBuffer's
+	copyIn() and copyOut(): one byte is always left free, and each call holds
+	the lock while it copies.
+----------------------------------------------------------------------------- */
+
+class CMutexRingBuffer
+{
+public:
+					CMutexRingBuffer(size_t inSize);
+					~CMutexRingBuffer();
+
+	size_t		putn(const void * inBuf, size_t inCount);
+	size_t		getn(void * outBuf, size_t inCount);
+	bool			isEmpty(void);
+
+private:
+	UByte *		fBuf;
+	UByte *		fBufEnd;
+	UByte *		fGetPtr;
+	UByte *		fPutPtr;
+	pthread_mutex_t	fLock;
+};
+
+
+CMutexRingBuffer::CMutexRingBuffer(size_t inSize)
+{
+	fBuf = new UByte[inSize + 1];
+	fBufEnd = fBuf + inSize + 1;
+	fGetPtr = fPutPtr = fBuf;
+	pthread_mutex_init(&fLock, NULL);
+}
+
+
+CMutexRingBuffer::~CMutexRingBuffer()
+{
+	pthread_mutex_destroy(&fLock);
+	delete[] fBuf;
+}
+
+
+size_t
+CMutexRingBuffer::putn(const void * inBuf, size_t inCount)
+{
+	const UByte * p = (const UByte *)inBuf;
+	size_t amtPut = 0;
+	pthread_mutex_lock(&fLock);
+	while (amtPut < inCount)
+	{
+		// up to the end of the buffer, or to the byte before the get pointer
+		UByte * limit = (fGetPtr > fPutPtr) ? fGetPtr - 1 : (fGetPtr == fBuf ? fBufEnd - 1 : fBufEnd);
+		size_t count = MIN((size_t)(limit - fPutPtr), inCount - amtPut);
+		if (count == 0)
+			break;
+		memmove(fPutPtr, p + amtPut, count);
+		amtPut += count;
+		fPutPtr += count;
+		if (fPutPtr == fBufEnd)
+			fPutPtr = fBuf;
+	}
+	pthread_mutex_unlock(&fLock);
+	return amtPut;
+}
+
+
+size_t
+CMutexRingBuffer::getn(void * outBuf, size_t inCount)
+{
+	UByte * p = (UByte *)outBuf;
+	size_t amtGot = 0;
+	pthread_mutex_lock(&fLock);
+	while (amtGot < inCount)
+	{
+		UByte * limit = (fPutPtr >= fGetPtr) ? fPutPtr : fBufEnd;
+		size_t count = MIN((size_t)(limit - fGetPtr), inCount - amtGot);
+		if (count == 0)
+			break;
+		memmove(p + amtGot, fGetPtr, count);
+		amtGot += count;
+		fGetPtr += count;
+		if (fGetPtr == fBufEnd)
+			fGetPtr = fBuf;
+	}
+	pthread_mutex_unlock(&fLock);
+	return amtGot;
+}
+
+
+bool
+CMutexRingBuffer::isEmpty(void)
+{
+	pthread_mutex_lock(&fLock);
+	bool empty = (fGetPtr == fPutPtr);
+	pthread_mutex_unlock(&fLock);
+	return empty;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Stream kStreamSize bytes from one thread to another, kChunkSize at a time.
+----------------------------------------------------------------------------- */
+
+enum { kMutexStream, kCopyStream, kSpanStream };
+
+struct Stream
+{
+	int						kind;
+	CMutexRingBuffer *	mutexBuf;
+	CLockFreeRingBuffer	buf;
+	ArrayIndex				numOfMismatches;
+};
+
+
+static void *
+StreamProducer(void * inStream)
+{
+	Stream *	stream = (Stream *)inStream;
+	UByte		chunk[kChunkSize];
+	for (ArrayIndex index = 0; index < kStreamSize; )
+	{
+		size_t count = MIN((size_t)kChunkSize, kStreamSize - index);
+		size_t amtPut;
+		if (stream->kind == kSpanStream)
+		{
+			// fill the buffer in place
+			UByte * span1, * span2;
+			size_t len1, len2;
+			stream->buf.computePutVectors(span1, len1, span2, len2);
+			amtPut = MIN(count, len1 + len2);
+			size_t i = 0;
+			for ( ; i < amtPut && i < len1; ++i)
+				span1[i] = PatternByte(index + i);
+			for ( ; i < amtPut; ++i)
+				span2[i - len1] = PatternByte(index + i);
+			stream->buf.updatePutVector(amtPut);
+		}
+		else
+		{
+			for (size_t i = 0; i < count; ++i)
+				chunk[i] = PatternByte(index + i);
+			if (stream->kind == kMutexStream)
+				amtPut = stream->mutexBuf->putn(chunk, count);
+			else
+				amtPut = stream->buf.putn(chunk, count);
+		}
+		index += amtPut;
+		if (amtPut == 0)
+			sched_yield();
+	}
+	return NULL;
+}
+
+
+static void *
+StreamConsumer(void * inStream)
+{
+	Stream *	stream = (Stream *)inStream;
+	UByte		chunk[kChunkSize];
+	for (ArrayIndex index = 0; index < kStreamSize; )
+	{
+		size_t amtGot;
+		if (stream->kind == kSpanStream)
+		{
+			// check the buffer in place
+			UByte * span1, * span2;
+			size_t len1, len2;
+			stream->buf.computeGetVectors(span1, len1, span2, len2);
+			amtGot = MIN((size_t)kChunkSize, len1 + len2);
+			size_t i = 0;
+			for ( ; i < amtGot && i < len1; ++i)
+				if (span1[i] != PatternByte(index + i))
+					stream->numOfMismatches++;
+			for ( ; i < amtGot; ++i)
+				if (span2[i - len1] != PatternByte(index + i))
+					stream->numOfMismatches++;
+			stream->buf.updateGetVector(amtGot);
+		}
+		else
+		{
+			if (stream->kind == kMutexStream)
+				amtGot = stream->mutexBuf->getn(chunk, kChunkSize);
+			else
+				amtGot = stream->buf.getn(chunk, kChunkSize);
+			for (size_t i = 0; i < amtGot; ++i)
+				if (chunk[i] != PatternByte(index + i))
+					stream->numOfMismatches++;
+		}
+		index += amtGot;
+		if (amtGot == 0)
+			sched_yield();
+	}
+	return NULL;
+}
+
+
+static double
+TimeStream(int inKind)
+{
+	Stream stream;
+	CMutexRingBuffer mutexBuf(kBufferSize);
+	stream.kind = inKind;
+	stream.mutexBuf = &mutexBuf;
+	stream.numOfMismatches = 0;
+	CHECK(stream.buf.init(kBufferSize) == noErr);
+
+	double startTime = Seconds();
+	pthread_t producer, consumer;
+	CHECK(pthread_create(&producer, NULL, StreamProducer, &stream) == 0);
+	CHECK(pthread_create(&consumer, NULL, StreamConsumer, &stream) == 0);
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+	double elapsed = Seconds() - startTime;
+
+	CHECK(stream.numOfMismatches == 0);
+	CHECK(inKind == kMutexStream ? mutexBuf.isEmpty() : stream.buf.isEmpty());
+	return elapsed;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Tablet samples from two producers.
+	A sample is its producer in the top byte and its sequence number below.
+	Either both put into one ring under a lock, or each into a ring of its own.
+----------------------------------------------------------------------------- */
+
+struct Samples
+{
+	bool						isShared;
+	CMutexRingBuffer *	sharedBuf;
+	CLockFreeRingBuffer	buf[kNumOfProducers];
+};
+
+struct Producer
+{
+	Samples *	samples;
+	ULong			index;
+};
+
+
+static void *
+SampleProducer(void * inProducer)
+{
+	Producer *	producer = (Producer *)inProducer;
+	Samples *	samples = producer->samples;
+	for (ULong seq = 0; seq < kNumOfSamples; )
+	{
+		ULong sample = (producer->index << 24) | seq;
+		size_t amtPut = samples->isShared ? samples->sharedBuf->putn(&sample, sizeof(sample))
+													 : samples->buf[producer->index].putn(&sample, sizeof(sample));
+		if (amtPut == sizeof(sample))
+			++seq;
+		else
+		{
+			CHECK(amtPut == 0);
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+
+static double
+TimeSamples(bool inIsShared)
+{
+	Samples samples;
+	CMutexRingBuffer sharedBuf(kSampleBufSize);
+	samples.isShared = inIsShared;
+	samples.sharedBuf = &sharedBuf;
+	for (ArrayIndex i = 0; i < kNumOfProducers; ++i)
+		CHECK(samples.buf[i].init(kSampleBufSize) == noErr);
+
+	double startTime = Seconds();
+	pthread_t thread[kNumOfProducers];
+	Producer producer[kNumOfProducers];
+	for (ArrayIndex i = 0; i < kNumOfProducers; ++i)
+	{
+		producer[i].samples = &samples;
+		producer[i].index = i;
+		CHECK(pthread_create(&thread[i], NULL, SampleProducer, &producer[i]) == 0);
+	}
+
+	// as InsertArmisticeSamples does, 10 at a time
+	ULong nextSeq[kNumOfProducers];
+	memset(nextSeq, 0, sizeof(nextSeq));
+	ArrayIndex numOfSamples = 0, numOfMismatches = 0;
+	while (numOfSamples < kNumOfProducers * kNumOfSamples)
+	{
+		size_t total = 0;
+		for (ArrayIndex ring = 0; ring < (inIsShared ? 1 : kNumOfProducers); ++ring)
+		{
+			ULong sample[10];
+			size_t count = inIsShared ? sharedBuf.getn(sample, sizeof(sample))
+											  : samples.buf[ring].getn(sample, sizeof(sample));
+			CHECK(count % sizeof(ULong) == 0);
+			count /= sizeof(ULong);
+			for (size_t i = 0; i < count; ++i)
+			{
+				ULong producer = sample[i] >> 24;
+				if (producer >= kNumOfProducers || (!inIsShared && producer != ring)
+				||  (sample[i] & 0x00FFFFFF) != nextSeq[producer]++)
+					numOfMismatches++;
+			}
+			total += count;
+		}
+		numOfSamples += total;
+		if (total == 0)
+			sched_yield();
+	}
+
+	for (ArrayIndex i = 0; i < kNumOfProducers; ++i)
+		pthread_join(thread[i], NULL);
+	double elapsed = Seconds() - startTime;
+
+	CHECK(numOfMismatches == 0);
+	return elapsed;
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	double mutexTime = TimeStream(kMutexStream);
+	double copyTime = TimeStream(kCopyStream);
+	double spanTime = TimeStream(kSpanStream);
+	printf("%dMB in %dKB chunks: %.3fs -> %.3fs, %.3fs by spans\n",
+				kStreamSize / MByte, kChunkSize / KByte, mutexTime, copyTime, spanTime);
+
+	double sharedTime = TimeSamples(true);
+	double ownTime = TimeSamples(false);
+	printf("%d samples from %d producers: %.3fs -> %.3fs\n",
+				kNumOfProducers * kNumOfSamples, kNumOfProducers, sharedTime, ownTime);
+
+	return TestResult("RingBufferThroughput");
+}
@@ -0,0 +1,270 @@
+/*
+	File:		ScalingExact.cc
+
+	Contains:	Bitmap scaling test.
+					Builds Graphics/Scaling.cc and checks the box and bilinear
+					filters pixel for pixel: a few scaled by hand, then every
+					combination of source and destination depth, with and
+					without a gray table, shrinking and enlarging, against a
+					plain implementation that reads and writes one pixel at a
+					time.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "Scaling.h"
+#include "Geometry.h"
+#include "OSErrors.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+// QDDrawing.cc brings in the whole object system, so just this from it
+Ptr
+PixelMapBits(const NativePixelMap * inPixmap)
+{
+	return (Ptr)inPixmap->baseAddr;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Pixel maps.
+----------------------------------------------------------------------------- */
+
+struct Bitmap
+{
+	NativePixelMap	pixmap;
+
+					Bitmap(int inWidth, int inHeight, int inDepth);
+					~Bitmap();
+	int			depth(void) const { return PixelDepth(&pixmap); }
+	int			get(int x, int y) const;
+	void			set(int x, int y, int inValue);
+};
+
+
+Bitmap::Bitmap(int inWidth, int inHeight, int inDepth)
+{
+	// rows are padded, as MakeBitmap pads them, and the padding must be ignored
+	pixmap.rowBytes = ALIGN((inWidth * inDepth + 7) / 8, 4) + 4;
+	pixmap.baseAddr = (Ptr)malloc(pixmap.rowBytes * inHeight);
+	memset(pixmap.baseAddr, 0xA5, pixmap.rowBytes * inHeight);
+	SetRect(&pixmap.bounds, 0, 0, inWidth, inHeight);
+	pixmap.pixMapFlags = kPixMapPtr + inDepth;
+	pixmap.deviceRes.h = pixmap.deviceRes.v = 0;
+	pixmap.grayTable = NULL;
+}
+
+
+Bitmap::~Bitmap()
+{
+	free(pixmap.baseAddr);
+}
+
+
+int
+Bitmap::get(int x, int y) const
+{
+	int	bitPos = x * depth();
+	UByte	pixels = pixmap.baseAddr[y * pixmap.rowBytes + bitPos / 8];
+	return (pixels >> (8 - depth() - bitPos % 8)) & ((1 << depth()) - 1);
+}
+
+
+void
+Bitmap::set(int x, int y, int inValue)
+{
+	int	bitPos = x * depth();
+	int	shift = 8 - depth() - bitPos % 8;
+	UByte *	pixels = (UByte *)pixmap.baseAddr + y * pixmap.rowBytes + bitPos / 8;
+	*pixels = (*pixels & ~(((1 << depth()) - 1) << shift)) | (inValue << shift);
+}
+
+
+/* -----------------------------------------------------------------------------
+	The reference: a pixel at a time, straight from the definitions.
+	A pixel's darkness is its level, through the gray table if any, scaled to
+	0..255; darkness is packed to a depth by keeping its top bits.
+----------------------------------------------------------------------------- */
+
+static int
+Darkness(const Bitmap & inSrc, int x, int y)
+{
+	int	maxLevel = (1 << inSrc.depth()) - 1;
+	int	level = inSrc.get(x, y);
+	if (inSrc.pixmap.grayTable)
+		level = inSrc.pixmap.grayTable[level] & maxLevel;
+	return (level * 255 + maxLevel / 2) / maxLevel;
+}
+
+
+static int
+BoxPixel(const Bitmap & inSrc, int inDstWidth, int inDstHeight, int x, int y)
+{
+	int	srcWidth = RectGetWidth(inSrc.pixmap.bounds);
+	int	srcHeight = RectGetHeight(inSrc.pixmap.bounds);
+	int	x0 = x * srcWidth / inDstWidth;
+	int	x1 = MAX((x + 1) * srcWidth / inDstWidth, x0 + 1);
+	int	y0 = y * srcHeight / inDstHeight;
+	int	y1 = MAX((y + 1) * srcHeight / inDstHeight, y0 + 1);
+	int	sum = 0;
+	for (int sy = y0; sy < y1; ++sy)
+		for (int sx = x0; sx < x1; ++sx)
+			sum += Darkness(inSrc, sx, sy);
+	int	area = (x1 - x0) * (y1 - y0);
+	return (sum + area / 2) / area;
+}
+
+
+static int
+BilinearPixel(const Bitmap & inSrc, int inDstWidth, int inDstHeight, int x, int y)
+{
+	int	srcWidth = RectGetWidth(inSrc.pixmap.bounds);
+	int	srcHeight = RectGetHeight(inSrc.pixmap.bounds);
+	// the centre of the destination pixel in the source, in 1/256 pixel
+	int	px = MAX((2 * x + 1) * srcWidth * 128 / inDstWidth - 128, 0);
+	int	py = MAX((2 * y + 1) * srcHeight * 128 / inDstHeight - 128, 0);
+	int	x0 = px / 256, x1 = MIN(x0 + 1, srcWidth - 1), fx = px % 256;
+	int	y0 = py / 256, y1 = MIN(y0 + 1, srcHeight - 1), fy = py % 256;
+	long	top = Darkness(inSrc, x0, y0) * (256 - fx) + Darkness(inSrc, x1, y0) * fx;
+	long	bottom = Darkness(inSrc, x0, y1) * (256 - fx) + Darkness(inSrc, x1, y1) * fx;
+	return (top * (256 - fy) + bottom * fy + 32768) / 65536;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Scale through ScalePixels into a destination pixel map.
+----------------------------------------------------------------------------- */
+
+static NewtonErr
+Scale(const Bitmap & inSrc, Bitmap & ioDst, int inFilter)
+{
+	return ScalePixels(&inSrc.pixmap, inFilter,
+							 RectGetWidth(ioDst.pixmap.bounds), RectGetHeight(ioDst.pixmap.bounds), ioDst.depth(),
+							 (UByte *)ioDst.pixmap.baseAddr, ioDst.pixmap.rowBytes);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Scaled by hand.
+----------------------------------------------------------------------------- */
+
+static void
+TestByHand(void)
+{
+	// solid black 1-bit, 8x2, to 4-bit 4x1: all black
+	Bitmap black(8, 2, 1);
+	for (int y = 0; y < 2; ++y)
+		for (int x = 0; x < 8; ++x)
+			black.set(x, y, 1);
+	Bitmap gray4(4, 1, 4);
+	CHECK(Scale(black, gray4, kScaleBox) == noErr);
+	CHECK((UByte)gray4.pixmap.baseAddr[0] == 0xFF && (UByte)gray4.pixmap.baseAddr[1] == 0xFF);
+
+	// a 2x2 1-bit checkerboard, to 8-bit 1x1: half black, rounded up
+	Bitmap checker(2, 2, 1);
+	checker.set(0, 0, 1); checker.set(1, 0, 0);
+	checker.set(0, 1, 0); checker.set(1, 1, 1);
+	Bitmap gray8(1, 1, 8);
+	CHECK(Scale(checker, gray8, kScaleBox) == noErr);
+	CHECK((UByte)gray8.pixmap.baseAddr[0] == 128);
+
+	// a 4-bit ramp 0..15, halved to 8 bits: each pair of levels 17 apart averages
+	Bitmap ramp(16, 1, 4);
+	for (int x = 0; x < 16; ++x)
+		ramp.set(x, 0, x);
+	Bitmap halved(8, 1, 8);
+	CHECK(Scale(ramp, halved, kScaleBox) == noErr);
+	for (int x = 0; x < 8; ++x)
+		CHECK((UByte)halved.pixmap.baseAddr[x] == 34 * x + 9);
+
+	// 8-bit white-black, doubled: the centres fall a quarter and three quarters across
+	Bitmap pair(2, 1, 8);
+	pair.set(0, 0, 0);
+	pair.set(1, 0, 255);
+	Bitmap doubled(4, 1, 8);
+	CHECK(Scale(pair, doubled, kScaleBilinear) == noErr);
+	CHECK((UByte)doubled.pixmap.baseAddr[0] == 0);
+	CHECK((UByte)doubled.pixmap.baseAddr[1] == 64);
+	CHECK((UByte)doubled.pixmap.baseAddr[2] == 191);
+	CHECK((UByte)doubled.pixmap.baseAddr[3] == 255);
+
+	// and what can't be scaled isn't
+	Bitmap odd(4, 4, 3);
+	CHECK(Scale(odd, gray8, kScaleBox) == kOSErrBadParameters);
+	CHECK(Scale(gray8, odd, kScaleBox) == kOSErrBadParameters);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Every depth against the reference.
+----------------------------------------------------------------------------- */
+
+struct Extent
+{
+	int	width;
+	int	height;
+};
+
+static const int	kDepths[] = { 1, 2, 4, 8 };
+static const Extent	kSrcSizes[] = { { 1, 1 }, { 13, 7 }, { 64, 48 }, { 100, 37 } };
+static const Extent	kDstSizes[] = { { 1, 1 }, { 5, 3 }, { 16, 12 }, { 33, 17 }, { 71, 50 } };
+
+static void
+TestAgainstReference(void)
+{
+	unsigned int	seed = 1;
+	ArrayIndex		numOfCases = 0, numOfMismatches = 0;
+	UChar				grayTable[256];
+
+	for (int i = 0; i < 256; ++i)
+		grayTable[i] = 255 - i;				// inverts whatever the depth
+
+	for (int sd = 0; sd < 4; ++sd)
+	for (int dd = 0; dd < 4; ++dd)
+	for (int ss = 0; ss < 4; ++ss)
+	for (int ds = 0; ds < 5; ++ds)
+	for (int filter = kScaleBox; filter <= kScaleBilinear; ++filter)
+	for (int hasGrayTable = 0; hasGrayTable < 2; ++hasGrayTable)
+	{
+		Bitmap src(kSrcSizes[ss].width, kSrcSizes[ss].height, kDepths[sd]);
+		for (int y = 0; y < kSrcSizes[ss].height; ++y)
+			for (int x = 0; x < kSrcSizes[ss].width; ++x)
+				src.set(x, y, rand_r(&seed) & ((1 << kDepths[sd]) - 1));
+		if (hasGrayTable)
+			src.pixmap.grayTable = grayTable;
+
+		Bitmap dst(kDstSizes[ds].width, kDstSizes[ds].height, kDepths[dd]);
+		if (Scale(src, dst, filter) != noErr)
+			numOfMismatches++;
+
+		for (int y = 0; y < kDstSizes[ds].height; ++y)
+			for (int x = 0; x < kDstSizes[ds].width; ++x)
+			{
+				int darkness = (filter == kScaleBox) ? BoxPixel(src, kDstSizes[ds].width, kDstSizes[ds].height, x, y)
+																 : BilinearPixel(src, kDstSizes[ds].width, kDstSizes[ds].height, x, y);
+				if (dst.get(x, y) != darkness >> (8 - kDepths[dd]))
+				{
+					if (numOfMismatches++ == 0)
+						fprintf(stderr, "%d-bit %dx%d -> %d-bit %dx%d, filter %d, gray table %d: (%d,%d) is %d, not %d\n",
+									kDepths[sd], kSrcSizes[ss].width, kSrcSizes[ss].height,
+									kDepths[dd], kDstSizes[ds].width, kDstSizes[ds].height,
+									filter, hasGrayTable, x, y, dst.get(x, y), darkness >> (8 - kDepths[dd]));
+				}
+			}
+		numOfCases++;
+	}
+	CHECK(numOfCases == 4 * 4 * 4 * 5 * 2 * 2);
+	CHECK(numOfMismatches == 0);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	TestByHand();
+	TestAgainstReference();
+	return TestResult("ScalingExact");
+}
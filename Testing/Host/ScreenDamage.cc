@@ -0,0 +1,257 @@
+/*
+	File:		ScreenDamage.cc
+
+	Contains:	Screen damage replay test.
+					Builds Graphics/Damage.cc and replays drawing sequences in
+					the form Screen.cc logs with forDamageStats: a `damage` line
+					for each rect drawn into the screen, an `update` line with
+					the pixels blitted each time the screen is updated. At each
+					update the set must hold no more than kMaxDamageRects
+					disjoint rects, every pixel drawn must be in one of them,
+					and the pixels blitted must be as recorded. Run with
+					-update to write the replayed counts instead. Prints the
+					pixels blitted against a single bounding rect, as the
+					screen was. Then replays random sequences for the same
+					checks.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "Damage.h"
+#include "Geometry.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define kGoldenDir			"Golden/"
+#define kScreenWidth			320		// the screen, portrait
+#define kScreenHeight		480
+#define kNumOfSequences		20000
+#define kMaxLineSize			64
+
+static const char * kRecording[] = { "clock", "typing", "scroll", "slips", "ink" };
+
+
+/* -----------------------------------------------------------------------------
+	A frame: the damage set, and every pixel drawn into the screen since the
+	last update.
+----------------------------------------------------------------------------- */
+
+struct Frame
+{
+	DamageSet	damage;
+	Rect			bounds;		// the single rect the screen used to keep
+	bool			isDrawn[kScreenHeight][kScreenWidth];
+};
+
+
+static void
+ClearFrame(Frame * ioFrame)
+{
+	ClearDamage(&ioFrame->damage);
+	SetRect(&ioFrame->bounds, 0, 0, 0, 0);
+	memset(ioFrame->isDrawn, 0, sizeof(ioFrame->isDrawn));
+}
+
+
+static void
+DrawFrame(Frame * ioFrame, const Rect * inBounds)
+{
+	AddDamage(&ioFrame->damage, inBounds);
+	if (EmptyRect(inBounds))
+		return;
+	if (EmptyRect(&ioFrame->bounds))
+		ioFrame->bounds = *inBounds;
+	else
+		UnionRect(&ioFrame->bounds, inBounds, &ioFrame->bounds);
+
+	Rect screen, r;
+	SetRect(&screen, 0, 0, kScreenWidth, kScreenHeight);
+	if (SectRect(inBounds, &screen, &r))
+		for (int y = r.top; y < r.bottom; ++y)
+			for (int x = r.left; x < r.right; ++x)
+				ioFrame->isDrawn[y][x] = true;
+}
+
+
+/*------------------------------------------------------------------------------
+	Check the damage set at an update, as UpdateHardwareScreen would blit it.
+	Args:		inFrame			the frame
+				outPixels		pixels the damage set blits
+				outOldPixels	pixels the single rect would have blitted
+	Return:	true => the damage set is good
+------------------------------------------------------------------------------*/
+
+static bool
+CheckFrame(const Frame * inFrame, ULong * outPixels, ULong * outOldPixels)
+{
+	const DamageSet * damage = &inFrame->damage;
+	bool isGood = (damage->count <= kMaxDamageRects);
+
+	Rect screen, r, overlap;
+	SetRect(&screen, 0, 0, kScreenWidth, kScreenHeight);
+	*outPixels = 0;
+	for (ArrayIndex i = 0; i < damage->count; ++i)
+	{
+		if (SectRect(&damage->rect[i], &screen, &r))
+			*outPixels += RectArea(&r);
+		for (ArrayIndex j = i + 1; j < damage->count; ++j)
+			if (SectRect(&damage->rect[i], &damage->rect[j], &overlap))
+				isGood = false;
+	}
+	*outOldPixels = SectRect(&inFrame->bounds, &screen, &r) ? RectArea(&r) : 0;
+
+	for (int y = 0; y < kScreenHeight && isGood; ++y)
+	{
+		for (int x = 0; x < kScreenWidth; ++x)
+		{
+			if (inFrame->isDrawn[y][x])
+			{
+				Point pt;
+				pt.h = x;
+				pt.v = y;
+				ArrayIndex i;
+				for (i = 0; i < damage->count; ++i)
+					if (PtInRect(pt, &damage->rect[i]))
+						break;
+				if (i == damage->count)
+				{
+					isGood = false;
+					break;
+				}
+			}
+		}
+	}
+	return isGood;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Replay a recorded sequence.
+----------------------------------------------------------------------------- */
+
+static void
+ReplayRecording(const char * inName, bool inUpdate)
+{
+	char path[256];
+	snprintf(path, sizeof(path), kGoldenDir "ScreenDamage-%s.txt", inName);
+	FILE * fp = fopen(path, "r");
+	CHECK(fp != NULL);
+	if (fp == NULL)
+		return;
+
+	// with -update the file is written back with the replayed counts
+	size_t outSize = 0, outMax = 64*KByte;
+	char * out = (char *)malloc(outMax);
+
+	static Frame frame;
+	ClearFrame(&frame);
+	ArrayIndex numOfUpdates = 0, numOfBlits = 0, numOfBadFrames = 0, numOfMismatches = 0;
+	unsigned long long numOfPixels = 0, numOfOldPixels = 0;
+	char line[kMaxLineSize];
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		int left, top, right, bottom;
+		unsigned int recorded;
+		if (sscanf(line, "damage %d %d %d %d", &left, &top, &right, &bottom) == 4)
+		{
+			Rect bounds;
+			SetRect(&bounds, left, top, right, bottom);
+			DrawFrame(&frame, &bounds);
+		}
+		else if (sscanf(line, "update %u", &recorded) == 1)
+		{
+			ULong pixels, oldPixels;
+			if (!CheckFrame(&frame, &pixels, &oldPixels))
+			{
+				if (numOfBadFrames++ == 0)
+					fprintf(stderr, "%s: update %u: bad damage set\n", inName, numOfUpdates);
+			}
+			if (!inUpdate && pixels != recorded)
+			{
+				if (numOfMismatches++ == 0)
+					fprintf(stderr, "%s: update %u: %u pixels, recorded %u\n", inName, numOfUpdates, pixels, recorded);
+			}
+			snprintf(line, sizeof(line), "update %u\n", pixels);
+			numOfUpdates++;
+			numOfBlits += frame.damage.count;
+			numOfPixels += pixels;
+			numOfOldPixels += oldPixels;
+			ClearFrame(&frame);
+		}
+		size_t lineSize = strlen(line);
+		if (outSize + lineSize > outMax)
+			out = (char *)realloc(out, outMax *= 2);
+		memcpy(out + outSize, line, lineSize);
+		outSize += lineSize;
+	}
+	fclose(fp);
+	CHECK(numOfUpdates > 0);
+	CHECK(numOfBadFrames == 0);
+	CHECK(numOfMismatches == 0);
+
+	if (inUpdate)
+	{
+		fp = fopen(path, "w");
+		CHECK(fp != NULL);
+		if (fp != NULL)
+		{
+			fwrite(out, 1, outSize, fp);
+			fclose(fp);
+		}
+	}
+	free(out);
+
+	printf("%s: %u updates, %llu -> %llu pixels, %.1f blits an update\n",
+				inName, numOfUpdates, numOfOldPixels, numOfPixels, (double)numOfBlits / numOfUpdates);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Replay random sequences: up to 40 rects of all sizes, some off-screen,
+	some empty, between updates.
+----------------------------------------------------------------------------- */
+
+static void
+ReplayRandom(void)
+{
+	static Frame frame;
+	unsigned int seed = 32;
+	ArrayIndex numOfBadFrames = 0;
+	unsigned long long numOfPixels = 0, numOfOldPixels = 0;
+	for (ArrayIndex i = 0; i < kNumOfSequences; ++i)
+	{
+		ClearFrame(&frame);
+		for (ArrayIndex n = 1 + rand_r(&seed) % 40; n > 0; --n)
+		{
+			int size = (rand_r(&seed) & 1) ? 16 : kScreenWidth;
+			int left = rand_r(&seed) % (kScreenWidth + 40) - 20;
+			int top = rand_r(&seed) % (kScreenHeight + 40) - 20;
+			Rect bounds;
+			SetRect(&bounds, left, top, left + rand_r(&seed) % size, top + rand_r(&seed) % size);
+			DrawFrame(&frame, &bounds);
+		}
+		ULong pixels, oldPixels;
+		if (!CheckFrame(&frame, &pixels, &oldPixels))
+		{
+			if (numOfBadFrames++ == 0)
+				fprintf(stderr, "random sequence %u: bad damage set\n", i);
+		}
+		numOfPixels += pixels;
+		numOfOldPixels += oldPixels;
+	}
+	CHECK(numOfBadFrames == 0);
+	printf("%d random sequences: %llu -> %llu pixels\n", kNumOfSequences, numOfOldPixels, numOfPixels);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	bool isUpdate = (argc > 1 && strcmp(argv[1], "-update") == 0);
+	for (ArrayIndex i = 0; i < sizeof(kRecording)/sizeof(kRecording[0]); ++i)
+		ReplayRecording(kRecording[i], isUpdate);
+	ReplayRandom();
+	return TestResult("ScreenDamage");
+}
@@ -0,0 +1,186 @@
+/*
+	File:		SerialLoopback.cc
+
+	Contains:	Host serial port loopback test.
+					Connects to the port as a host client would, first over a pty
+					then over TCP, and sends a pattern that the Newton side echoes
+					back through a serial tool's pair of circle buffers, the way
+					CAsyncSerTool moves bytes on its task.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "HostSerial.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define kLoopbackSize			(256*KByte)
+#define kToolBufferSize			997			// odd, so the spans wrap at odd places
+#define kLoopbackTimeLimit		20				// seconds
+
+
+static UByte
+PatternByte(ArrayIndex index)
+{
+	return (UByte)(index * 7 + (index >> 8));
+}
+
+
+/* -----------------------------------------------------------------------------
+	Send kLoopbackSize bytes from the client and check they all come back.
+	Args:		inPort		the port, open
+				inClientFd	host client connected to it
+	Return:	--
+----------------------------------------------------------------------------- */
+
+static void
+Loopback(CHostSerialPort & inPort, int inClientFd)
+{
+	CCircleBuf recvBuf, sendBuf;
+	CHECK(recvBuf.allocate(kToolBufferSize) == noErr);
+	CHECK(sendBuf.allocate(kToolBufferSize) == noErr);
+	fcntl(inClientFd, F_SETFL, fcntl(inClientFd, F_GETFL, 0) | O_NONBLOCK);
+
+	UByte buf[4*KByte];
+	ArrayIndex amtSent = 0, amtEchoed = 0, numOfMismatches = 0;
+	ArrayIndex numOfReceived = 0, numOfSent = 0;
+	time_t timeLimit = time(NULL) + kLoopbackTimeLimit;
+
+	while (amtEchoed < kLoopbackSize && time(NULL) < timeLimit)
+	{
+		bool isProgress = false;
+
+		// host client -> port
+		if (amtSent < kLoopbackSize)
+		{
+			ArrayIndex count = MIN(sizeof(buf), kLoopbackSize - amtSent);
+			for (ArrayIndex i = 0; i < count; ++i)
+				buf[i] = PatternByte(amtSent + i);
+			ssize_t amtWritten = write(inClientFd, buf, count);
+			if (amtWritten > 0)
+			{
+				amtSent += amtWritten;
+				isProgress = true;
+			}
+		}
+
+		// port <-> tool buffers, echoing what arrives
+		ULong result = inPort.transfer(&recvBuf, &sendBuf);
+		if (FLAGTEST(result, kHostSerialReceived))
+			numOfReceived++;
+		if (FLAGTEST(result, kHostSerialSent))
+			numOfSent++;
+		UByte * span1, * span2;
+		ArrayIndex len1, len2;
+		if (recvBuf.peekSpans(&span1, &len1, &span2, &len2) == noErr)
+		{
+			ArrayIndex remaining = len1;
+			sendBuf.copyIn(span1, &remaining);
+			recvBuf.skipBytes(len1 - remaining);
+			isProgress = isProgress || (remaining < len1);
+		}
+
+		// port -> host client
+		ssize_t amtRead = read(inClientFd, buf, sizeof(buf));
+		if (amtRead > 0)
+		{
+			for (ssize_t i = 0; i < amtRead; ++i)
+				if (buf[i] != PatternByte(amtEchoed + i))
+					numOfMismatches++;
+			amtEchoed += amtRead;
+			isProgress = true;
+		}
+
+		if (!isProgress)
+			usleep(500);
+	}
+
+	CHECK(amtSent == kLoopbackSize);
+	CHECK(amtEchoed == kLoopbackSize);
+	CHECK(numOfMismatches == 0);
+	CHECK(numOfReceived > 0);
+	CHECK(numOfSent > 0);
+}
+
+
+static void
+TestPTY(void)
+{
+	CHostSerialPort port;
+	NewtonErr err = port.open("pty");
+	CHECK(err == noErr);
+	if (err)
+		return;
+	CHECK(port.mode() == kHostSerialPTY);
+	CHECK(port.isConnected());
+
+	int fd = open(port.name(), O_RDWR | O_NOCTTY);
+	CHECK(fd >= 0);
+	if (fd < 0)
+		return;
+	struct termios tio;
+	tcgetattr(fd, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(fd, TCSANOW, &tio);
+
+	Loopback(port, fd);
+	close(fd);
+	port.close();
+	CHECK(port.mode() == kHostSerialClosed);
+}
+
+
+static void
+TestTCP(void)
+{
+	CHostSerialPort port;
+	unsigned short portNo = 0;
+	for (unsigned short p = kHostSerialDefaultTCPPort + 1000; p < kHostSerialDefaultTCPPort + 1010; ++p)
+		if (port.openTCP(p) == noErr)
+		{
+			portNo = p;
+			break;
+		}
+	CHECK(portNo != 0);
+	if (portNo == 0)
+		return;
+	CHECK(port.mode() == kHostSerialTCP);
+	CHECK(!port.isConnected());
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(portNo);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	CHECK(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+	for (int i = 0; i < 1000 && !port.isConnected(); ++i)
+		usleep(1000);
+	CHECK(port.isConnected());
+
+	Loopback(port, fd);
+
+	// the port waits for another client once this one has gone
+	close(fd);
+	for (int i = 0; i < 1000 && port.isConnected(); ++i)
+		usleep(1000);
+	CHECK(!port.isConnected());
+	port.close();
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	TestPTY();
+	TestTCP();
+	return TestResult("SerialLoopback");
+}
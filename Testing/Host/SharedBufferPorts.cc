@@ -0,0 +1,337 @@
+/*
+	File:		SharedBufferPorts.cc
+
+	Contains:	Shared buffer port test.
+					Passes CSharedBuffers between tasks through the kernel's own
+					ports (see HostKernel.h) -- by reference, copied from a plain
+					message, and copied out to a plain receiver -- and checks the
+					content, that references are handed over rather than copied,
+					copy-on-write, and the copy statistics. Then sends system
+					events through the name server, as the app world says it's
+					alive, to one task that receives them as shared buffers and
+					one that receives them plainly: a shared buffer event must
+					reach the first by reference and the second by copy, and a
+					plain event both by copy.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostKernel.h"
+#include "UserTasks.h"
+#include "UserPorts.h"
+#include "UserSharedMem.h"
+#include "SharedMem.h"
+#include "SystemEvents.h"
+#include "Semaphore.h"
+#include "OSErrors.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define kTaskStackSize				(16*KByte)
+#define kTimeout						(5*kSeconds)
+
+#define kTestMsgType					0x00100000
+#define kEchoMsgType					0x00200000
+#define kEventMsgType				0x00400000
+#define kReadyMsgType				0x00800000
+
+#define kTestSize						(64*KByte)
+#define kPlainSize					(1*KByte)		// on the echo task's stack
+#define kEventSize					(4*KByte)
+#define kTestEvent					'test'
+
+extern NewtonErr	InitializeNameServer(void);
+
+
+static UByte
+PatternByte(ArrayIndex index)
+{
+	return (UByte)(index * 7 + (index >> 8));
+}
+
+
+static bool
+IsPattern(const UByte * inData, size_t inSize)
+{
+	for (ArrayIndex i = 0; i < inSize; ++i)
+		if (inData[i] != PatternByte(i))
+			return false;
+	return true;
+}
+
+
+static void
+StartTask(CUTask * ioTask, TaskProcPtr inProc, void * inData, size_t inSize, ULong inName)
+{
+	CHECK(ioTask->init(inProc, kTaskStackSize, inSize, inData, kUserTaskPriority, inName) == noErr);
+	CHECK(ioTask->start() == noErr);
+}
+
+
+static void
+GetTestStatistics(ULong inMsgType, SMemCopyStatistics * outStats)
+{
+	SMemCopyStatistics	stats[kNumOfSMemCopyTypes];
+	ArrayIndex	count = GetSMemCopyStatistics(stats, kNumOfSMemCopyTypes);
+	memset(outStats, 0, sizeof(SMemCopyStatistics));
+	for (ArrayIndex i = 0; i < count; ++i)
+		if (stats[i].msgType == inMsgType)
+			*outStats = stats[i];
+}
+
+
+/* -----------------------------------------------------------------------------
+	The echo task.
+	Receives two messages as shared buffers and sends each straight back by
+	reference; then receives one plainly and sends that back plainly.
+----------------------------------------------------------------------------- */
+
+struct EchoData
+{
+	ObjectId		testPort;			// the test sends to the echo task here
+	ObjectId		echoPort;			// and the echo task sends back here
+};
+
+static void
+EchoTask(void * inData, size_t inSize, ObjectId inTaskId)
+{
+	EchoData *	data = (EchoData *)inData;
+	CUPort		testPort(data->testPort);
+	CUPort		echoPort(data->echoPort);
+
+	for (ArrayIndex i = 0; i < 2; ++i)
+	{
+		CSharedBuffer *	buf;
+		size_t	size;
+		CHECK(testPort.receive(&buf, &size, NULL, kTimeout) == noErr);
+		CHECK(echoPort.send(buf, size, kTimeout, kEchoMsgType) == noErr);
+		buf->release();
+	}
+
+	UByte		content[kPlainSize];
+	size_t	size;
+	CHECK(testPort.receive(&size, content, sizeof(content), NULL, NULL, kTimeout) == noErr);
+	CHECK(echoPort.send(content, size, kTimeout, kEchoMsgType) == noErr);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Port to port.
+----------------------------------------------------------------------------- */
+
+static void
+TestPorts(void)
+{
+	CUPort			testPort, echoPort;
+	static CUTask	echoTask;
+	EchoData			data;
+
+	ResetSMemCopyStatistics();
+	CHECK(testPort.init() == noErr);
+	CHECK(echoPort.init() == noErr);
+	data.testPort = testPort;
+	data.echoPort = echoPort;
+	StartTask(&echoTask, EchoTask, &data, sizeof(data), 'echo');
+
+	// by reference both ways: what comes back is our own buffer
+	CSharedBuffer *	buf = CSharedBuffer::make(kTestSize);
+	CHECK(buf != NULL);
+	for (ArrayIndex i = 0; i < kTestSize; ++i)
+		buf->data()[i] = PatternByte(i);
+	CHECK(testPort.send(buf, kTestSize, kTimeout, kTestMsgType) == noErr);
+	CSharedBuffer *	echo = NULL;
+	size_t	size = 0;
+	CHECK(echoPort.receive(&echo, &size, NULL, kTimeout) == noErr);
+	CHECK(echo == buf);
+	CHECK(size == kTestSize);
+	// we hold two references to it now, so writing to one must copy it
+	CHECK(echo->isShared());
+	CHECK(CSharedBuffer::prepareToWrite(&echo) == noErr);
+	CHECK(echo != buf);
+	echo->data()[0] = ~PatternByte(0);
+	CHECK(IsPattern(buf->data(), kTestSize));
+	echo->release();
+	CSharedBuffer *	firstBuf = buf;
+
+	// from a plain message: what comes back is a copy
+	UByte	content[kPlainSize];
+	for (ArrayIndex i = 0; i < kPlainSize; ++i)
+		content[i] = PatternByte(i);
+	CHECK(testPort.send(content, kPlainSize, kTimeout, kTestMsgType) == noErr);
+	echo = NULL;
+	CHECK(echoPort.receive(&echo, &size, NULL, kTimeout) == noErr);
+	CHECK(size == kPlainSize);
+	CHECK(echo->data() != content && IsPattern(echo->data(), kPlainSize));
+	echo->release();
+	// the echo task let go of the first buffer before it took this message
+	CHECK(!firstBuf->isShared());
+	firstBuf->release();
+
+	// to a plain receiver: it gets the content
+	buf = CSharedBuffer::make(kPlainSize);
+	CHECK(buf != NULL);
+	for (ArrayIndex i = 0; i < kPlainSize; ++i)
+		buf->data()[i] = PatternByte(i);
+	CHECK(testPort.send(buf, kPlainSize, kTimeout, kTestMsgType) == noErr);
+	buf->release();
+	memset(content, 0, sizeof(content));
+	CHECK(echoPort.receive(&size, content, sizeof(content), NULL, NULL, kTimeout) == noErr);
+	CHECK(size == kPlainSize && IsPattern(content, kPlainSize));
+
+	// the first test message and the first two echoes were handed over, the rest copied
+	SMemCopyStatistics	stats;
+	GetTestStatistics(kTestMsgType, &stats);
+	CHECK(stats.handOffs == 1 && stats.bytesHandedOff == kTestSize);
+	CHECK(stats.copies >= 2);
+	GetTestStatistics(kEchoMsgType, &stats);
+	CHECK(stats.handOffs == 2 && stats.bytesHandedOff == kTestSize + kPlainSize);
+	CHECK(stats.copies >= 1);
+}
+
+
+/* -----------------------------------------------------------------------------
+	System event listeners.
+	Each registers for the test event, says it's ready, takes two events --
+	one sent as a shared buffer, one plain -- and says what it got.
+----------------------------------------------------------------------------- */
+
+struct ListenerData
+{
+	ObjectId		testPort;			// where to say it's ready
+	bool			isShared;			// receive as a shared buffer
+};
+
+struct ListenerResult
+{
+	CSharedBuffer *	buf[2];			// what a shared listener received
+	bool					isContent[2];	// whether what it received was the pattern
+};
+
+static ListenerResult	gListenerResult[2];
+
+static void
+ListenerTask(void * inData, size_t inSize, ObjectId inTaskId)
+{
+	ListenerData *		data = (ListenerData *)inData;
+	ListenerResult *	result = &gListenerResult[data->isShared];
+	CUPort				testPort(data->testPort);
+	CUPort				eventPort;
+	CSystemEvent		event(kTestEvent);
+
+	CHECK(eventPort.init() == noErr);
+	CHECK(event.registerForSystemEvent(eventPort, kEventMsgType, kTimeout) == noErr);
+	CHECK(testPort.send((void *)NULL, 0, kTimeout, kReadyMsgType) == noErr);
+
+	for (ArrayIndex i = 0; i < 2; ++i)
+	{
+		if (data->isShared)
+		{
+			CSharedBuffer *	buf = NULL;
+			size_t	size;
+			CHECK(eventPort.receive(&buf, &size, NULL, kTimeout) == noErr);
+			result->buf[i] = buf;
+			result->isContent[i] = (buf != NULL && size == kEventSize && IsPattern(buf->data(), kEventSize));
+			if (buf != NULL)
+				buf->release();
+		}
+		else
+		{
+			static UByte	content[kEventSize];
+			CUMsgToken		token;
+			size_t			size;
+			memset(content, 0, sizeof(content));
+			CHECK(eventPort.receive(&size, content, sizeof(content), &token, NULL, kTimeout) == noErr);
+			result->isContent[i] = (size == kEventSize && IsPattern(content, kEventSize));
+			CHECK(token.replyRPC(NULL, 0) == noErr);
+		}
+	}
+
+	CHECK(event.unregisterForSystemEvent(eventPort) == noErr);
+	CHECK(testPort.send((void *)NULL, 0, kTimeout, kReadyMsgType) == noErr);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Through the name server.
+----------------------------------------------------------------------------- */
+
+static void
+TestSystemEvents(void)
+{
+	CUPort			testPort;
+	static CUTask	listener[2];
+	ListenerData	data;
+	size_t			size;
+
+	ResetSMemCopyStatistics();
+	CHECK(InitializeNameServer() == noErr);
+	CHECK(testPort.init() == noErr);
+	for (ArrayIndex i = 0; i < 2; ++i)
+	{
+		data.testPort = testPort;
+		data.isShared = (i != 0);
+		StartTask(&listener[i], ListenerTask, &data, sizeof(data), 'lstn');
+	}
+	for (ArrayIndex i = 0; i < 2; ++i)
+		CHECK(testPort.receive(&size, NULL, 0, NULL, NULL, kTimeout) == noErr);
+
+	CSendSystemEvent	sender(kTestEvent);
+	CHECK(sender.init() == noErr);
+
+	// as a shared buffer: the sender's RPC returns once both listeners have had it
+	CSharedBuffer *	buf = CSharedBuffer::make(kEventSize);
+	CHECK(buf != NULL);
+	for (ArrayIndex i = 0; i < kEventSize; ++i)
+		buf->data()[i] = PatternByte(i);
+	CHECK(sender.sendSystemEvent(buf, kEventSize) == noErr);
+	CHECK(gListenerResult[true].buf[0] == buf && gListenerResult[true].isContent[0]);
+	CHECK(gListenerResult[false].isContent[0]);
+	CHECK(!buf->isShared());
+
+	// plainly: both get a copy
+	static UByte	content[kEventSize];
+	for (ArrayIndex i = 0; i < kEventSize; ++i)
+		content[i] = PatternByte(i);
+	CHECK(sender.sendSystemEvent(content, kEventSize) == noErr);
+	CHECK(gListenerResult[true].buf[1] != buf && gListenerResult[true].isContent[1]);
+	CHECK(gListenerResult[false].isContent[1]);
+	buf->release();
+
+	for (ArrayIndex i = 0; i < 2; ++i)
+		CHECK(testPort.receive(&size, NULL, 0, NULL, NULL, kTimeout) == noErr);
+
+	// one hand-off; the plain listener's copy of the first event, and both of the second
+	SMemCopyStatistics	stats;
+	GetTestStatistics(kEventMsgType, &stats);
+	CHECK(stats.handOffs == 1 && stats.bytesHandedOff == kEventSize);
+	CHECK(stats.copies == 3 && stats.bytesCopied == 3 * kEventSize);
+
+	// and with nobody listening there's nobody to send it to
+	CHECK(sender.sendSystemEvent(content, kEventSize) == kOSErrNotRegistered);
+}
+
+
+/* -----------------------------------------------------------------------------
+	The test task.
+----------------------------------------------------------------------------- */
+
+static void
+TestTask(void * inData, size_t inSize, ObjectId inTaskId)
+{
+	CHECK(CULockingSemaphore::staticInit() == noErr);
+
+	TestPorts();
+	TestSystemEvents();
+
+	fflush(stderr);
+	exit(TestResult("SharedBufferPorts"));
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	BootHostKernel(TestTask, kTaskStackSize);
+	return 1;
+}
@@ -0,0 +1,552 @@
+/*
+	File:		SoftQuartzGolden.cc
+
+	Contains:	SoftQuartz golden image test.
+					Draws scenes into pixel maps and compares them with the images
+					in Golden/. The shapes, primitives and blits scenes are drawn at
+					every depth a pixel map can have -- 1, 2, 4 and 8 bits; the rest
+					at 4 bits, as the screen is. The primitives are the shapes
+					FMakeShape makes -- round rects, wedges, polygons, regions and
+					bitmaps -- drawn with the calls QDDrawing.cc and DrawImage.cc
+					make for them. Run with -update to write the images instead,
+					and look at them before checking them in.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "Quartz.h"
+#include "Geometry.h"
+#include "Regions.h"
+#include "ViewFlags.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define kGoldenDir			"Golden/"
+#define kSceneWidth			160
+#define kSceneHeight			64
+
+
+// QDDrawing.cc brings in the whole object system, so just this from it
+Ptr
+PixelMapBits(const NativePixelMap * inPixmap)
+{
+	return (Ptr)inPixmap->baseAddr;
+}
+
+// Exceptions.cc doesn't build here; regions only throw when out of memory
+DefineException(exOutOfMemory, evt.ex.outofmem);
+extern "C" {
+void	AddExceptionHandler(CatchHeader * inHandler) { }
+void	RemoveExceptionHandler(CatchHeader * inHandler) { }
+void	Throw(ExceptionName inName, void * inData, ExceptionDestructor inDestructor) { abort(); }
+}
+
+
+/* -----------------------------------------------------------------------------
+	A white pixel map to draw a scene into.
+----------------------------------------------------------------------------- */
+
+struct Scene
+{
+	NativePixelMap	pixmap;
+	CGContextRef	ctx;
+	int				depth;
+
+					Scene(int inDepth = 4);
+					~Scene();
+	int			maxValue(void) const;
+	int			pixel(int x, int y) const;
+};
+
+
+Scene::Scene(int inDepth)
+{
+	depth = inDepth;
+	pixmap.rowBytes = kSceneWidth * inDepth / 8;
+	pixmap.baseAddr = (Ptr)calloc(pixmap.rowBytes, kSceneHeight);
+	SetRect(&pixmap.bounds, 0, 0, kSceneWidth, kSceneHeight);
+	pixmap.pixMapFlags = kPixMapPtr + inDepth;
+	pixmap.deviceRes.h = pixmap.deviceRes.v = 0;
+	pixmap.grayTable = NULL;
+	ctx = CGPixelMapContextCreate(&pixmap);
+}
+
+
+Scene::~Scene()
+{
+	CGContextRelease(ctx);
+	free(pixmap.baseAddr);
+}
+
+
+int
+Scene::maxValue(void) const
+{
+	return (1 << depth) - 1;
+}
+
+
+int
+Scene::pixel(int x, int y) const
+{
+	UByte pixels = pixmap.baseAddr[y * pixmap.rowBytes + x * depth / 8];
+	int shift = 8 - depth - (x * depth) % 8;
+	return (pixels >> shift) & maxValue();
+}
+
+
+/* -----------------------------------------------------------------------------
+	Compare a scene with its golden image, a plain PGM file.
+	4-bit images are SoftQuartz-<name>.pgm; others SoftQuartz-<name>-<depth>bit.pgm.
+	Args:		inScene
+				inName		name of the image
+				inUpdate		write the image rather than compare it
+	Return:	--
+----------------------------------------------------------------------------- */
+
+static void
+CheckGolden(const Scene & inScene, const char * inName, bool inUpdate)
+{
+	char path[256];
+	if (inScene.depth == 4)
+		snprintf(path, sizeof(path), kGoldenDir "SoftQuartz-%s.pgm", inName);
+	else
+		snprintf(path, sizeof(path), kGoldenDir "SoftQuartz-%s-%dbit.pgm", inName, inScene.depth);
+	int maxValue = inScene.maxValue();
+	// a level of 15 either way, for differences in float rounding
+	int tolerance = maxValue / 15;
+
+	if (inUpdate)
+	{
+		FILE * fp = fopen(path, "w");
+		CHECK(fp != NULL);
+		if (fp == NULL)
+			return;
+		fprintf(fp, "P2\n%d %d\n%d\n", kSceneWidth, kSceneHeight, maxValue);
+		for (int y = 0; y < kSceneHeight; ++y)
+			for (int x = 0; x < kSceneWidth; ++x)
+				fprintf(fp, "%d%c", maxValue - inScene.pixel(x, y), x == kSceneWidth - 1 ? '\n' : ' ');
+		fclose(fp);
+		printf("wrote %s\n", path);
+		return;
+	}
+
+	FILE * fp = fopen(path, "r");
+	CHECK(fp != NULL);
+	if (fp == NULL)
+		return;
+	int width, height, fileMaxValue;
+	CHECK(fscanf(fp, "P2 %d %d %d", &width, &height, &fileMaxValue) == 3);
+	CHECK(width == kSceneWidth && height == kSceneHeight && fileMaxValue == maxValue);
+	ArrayIndex numOfDifferences = 0;
+	for (int y = 0; y < kSceneHeight; ++y)
+		for (int x = 0; x < kSceneWidth; ++x)
+		{
+			int value;
+			if (fscanf(fp, "%d", &value) != 1)
+				value = -999;
+			// PGM is white at the top of the range, Newton pixels are black
+			int difference = (maxValue - value) - inScene.pixel(x, y);
+			if (difference < -tolerance || difference > tolerance)
+			{
+				if (numOfDifferences++ == 0)
+					fprintf(stderr, "%s: first difference at %d,%d\n", path, x, y);
+			}
+		}
+	fclose(fp);
+	CHECK(numOfDifferences == 0);
+}
+
+
+/* -----------------------------------------------------------------------------
+	The primitives, drawn as QDDrawing.cc and DrawImage.cc draw them.
+	Shapes are in QuickDraw coordinates: y down from the top of the scene.
+----------------------------------------------------------------------------- */
+
+// QDDrawing's, for a screen the size of a scene
+CGRect
+MakeCGRect(Rect inRect)
+{
+	return CGRectMake(inRect.left, kSceneHeight - inRect.bottom, RectGetWidth(inRect), RectGetHeight(inRect));
+}
+
+
+// QDDrawing's AddRoundedRectToPath
+static void
+AddRoundedRectToPath(CGContextRef ctx, CGRect inRect, CGFloat ovalWidth, CGFloat ovalHeight)
+{
+	CGContextSaveGState(ctx);
+	CGContextTranslateCTM(ctx, CGRectGetMinX(inRect), CGRectGetMinY(inRect));
+	CGContextScaleCTM(ctx, ovalWidth, ovalHeight);
+	CGFloat fw = CGRectGetWidth(inRect) / ovalWidth;
+	CGFloat fh = CGRectGetHeight(inRect) / ovalHeight;
+	CGContextMoveToPoint(ctx, fw, fh/2);
+	CGContextAddArcToPoint(ctx, fw, fh, fw/2, fh, 1);
+	CGContextAddArcToPoint(ctx, 0, fh, 0, fh/2, 1);
+	CGContextAddArcToPoint(ctx, 0, 0, fw/2, 0, 1);
+	CGContextAddArcToPoint(ctx, fw, 0, fw, fh/2, 1);
+	CGContextClosePath(ctx);
+	CGContextRestoreGState(ctx);
+}
+
+
+static void
+DrawRoundRect(CGContextRef ctx, const RoundRectShape & inShape, bool inFill, CGFloat inLineWidth)
+{
+	CGRect r = MakeCGRect(inShape.rect);
+	if (!inFill)
+		r = CGRectInset(r, inLineWidth / 2, inLineWidth / 2);
+	CGContextBeginPath(ctx);
+	AddRoundedRectToPath(ctx, r, inShape.hRadius, inShape.vRadius);
+	if (inFill)
+		CGContextFillPath(ctx);
+	else
+		CGContextStrokePath(ctx);
+}
+
+
+/*	QDDrawing's FillArc and StrokeArc are empty; a wedge is as QuickDraw had it:
+	arc1 degrees clockwise from twelve o'clock, through arc2 more. */
+static void
+DrawWedge(CGContextRef ctx, const WedgeShape & inShape, bool inFill)
+{
+	CGRect r = MakeCGRect(inShape.rect);
+	CGFloat startAngle = (90 - inShape.arc1) * M_PI / 180;
+	CGFloat endAngle = (90 - inShape.arc1 - inShape.arc2) * M_PI / 180;
+	CGContextBeginPath(ctx);
+	CGContextSaveGState(ctx);
+	CGContextTranslateCTM(ctx, CGRectGetMidX(r), CGRectGetMidY(r));
+	CGContextScaleCTM(ctx, CGRectGetWidth(r) / 2, CGRectGetHeight(r) / 2);
+	CGContextMoveToPoint(ctx, 0, 0);
+	CGContextAddArc(ctx, 0, 0, 1, startAngle, endAngle, inShape.arc2 > 0);
+	CGContextClosePath(ctx);
+	CGContextRestoreGState(ctx);
+	if (inFill)
+		CGContextFillPath(ctx);
+	else
+		CGContextStrokePath(ctx);
+}
+
+
+// QDDrawing's FillPoly and StrokePoly
+static void
+DrawPolygon(CGContextRef ctx, const Point * inPoints, ArrayIndex inCount, bool inFill)
+{
+	CGContextBeginPath(ctx);
+	CGContextMoveToPoint(ctx, inPoints[0].h, kSceneHeight - inPoints[0].v);
+	for (ArrayIndex i = 1; i < inCount; ++i)
+		CGContextAddLineToPoint(ctx, inPoints[i].h, kSceneHeight - inPoints[i].v);
+	if (inFill)
+		CGContextFillPath(ctx);
+	else
+		CGContextStrokePath(ctx);
+}
+
+
+/*	QDDrawing's FillRgn is empty too; Quartz has no regions, so fill the
+	region's bounds clipped to it. */
+static void
+FillRegion(CGContextRef ctx, const CBaseRegion & inRgn)
+{
+	CGContextSaveGState(ctx);
+	CGContextClipToRegion(ctx, inRgn);
+	CGContextFillRect(ctx, MakeCGRect(inRgn.bounds()));
+	CGContextRestoreGState(ctx);
+}
+
+
+// DrawImage's DrawBitmap, for a pixel map without a mask
+static const unsigned char colorTable1bit[] = { 0xFF, 0x00 };
+static const unsigned char colorTable2bit[] = { 0xFF, 0xAA, 0x55, 0x00 };
+static const unsigned char colorTable4bit[] = { 0xFF, 0xEE, 0xDD, 0xCC, 0xBB, 0xAA, 0x99, 0x88,
+																0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, 0x00 };
+static const unsigned char * colorTable[5] = { NULL, colorTable1bit, colorTable2bit, NULL, colorTable4bit };
+
+static void
+DrawBitmap(CGContextRef ctx, const UByte * inBits, int inWidth, int inHeight, int inDepth, const Rect * inRect, int inTransferMode)
+{
+	size_t rowBytes = (inWidth * inDepth + 7) / 8;
+	CGColorSpaceRef baseColorSpace = CGColorSpaceCreateWithName(kCGColorSpaceGenericGray);
+	CGColorSpaceRef colorSpace = CGColorSpaceCreateIndexed(baseColorSpace, (1 << inDepth)-1, colorTable[inDepth]);
+	CGDataProviderRef source = CGDataProviderCreateWithData(NULL, inBits, inHeight * rowBytes, NULL);
+	CGImageRef image = CGImageCreate(inWidth, inHeight, inDepth, inDepth, rowBytes,
+												colorSpace, kCGImageAlphaNone, source,
+												NULL, false, kCGRenderingIntentSaturation);
+	CGDataProviderRelease(source);
+	CGColorSpaceRelease(colorSpace);
+	CGColorSpaceRelease(baseColorSpace);
+	CHECK(image != NULL);
+
+	CGContextSetTransferMode(ctx, inTransferMode);
+	CGContextDrawImage(ctx, MakeCGRect(*inRect), image);
+	CGContextSetTransferMode(ctx, modeCopy);
+	CGImageRelease(image);
+}
+
+
+/* -----------------------------------------------------------------------------
+	The scenes.
+----------------------------------------------------------------------------- */
+
+static void
+DrawShapes(CGContextRef ctx)
+{
+	CGContextSetGrayFillColor(ctx, 0.75, 1.0);
+	CGContextFillRect(ctx, CGRectMake(4, 4, 40, 56));
+	CGContextSetGrayStrokeColor(ctx, 0.0, 1.0);
+	CGContextSetLineWidth(ctx, 2);
+	CGContextStrokeRect(ctx, CGRectMake(4, 4, 40, 56));
+
+	CGContextSetGrayFillColor(ctx, 0.0, 1.0);
+	CGContextFillEllipseInRect(ctx, CGRectMake(52, 8, 48, 32));
+	CGContextSetLineWidth(ctx, 3);
+	CGContextSetLineCap(ctx, kCGLineCapRound);
+	CGPoint line[2] = { { 52, 56 }, { 100, 44 } };
+	CGContextStrokeLineSegments(ctx, line, 2);
+
+	CGContextBeginPath(ctx);
+	CGContextSetLineWidth(ctx, 1);
+	CGContextAddArc(ctx, 130, 32, 24, 0, 3.14159265, 0);
+	CGContextStrokePath(ctx);
+}
+
+
+static void
+DrawPrimitives(CGContextRef ctx)
+{
+	// round rects: filled, and framed 2 wide
+	RoundRectShape roundRect;
+	SetRect(&roundRect.rect, 4, 4, 36, 28);
+	roundRect.hRadius = roundRect.vRadius = 8;
+	CGContextSetGrayFillColor(ctx, 0.5, 1.0);
+	DrawRoundRect(ctx, roundRect, true, 0);
+	SetRect(&roundRect.rect, 4, 34, 36, 60);
+	roundRect.hRadius = 10;
+	roundRect.vRadius = 6;
+	CGContextSetGrayStrokeColor(ctx, 0.0, 1.0);
+	CGContextSetLineWidth(ctx, 2);
+	DrawRoundRect(ctx, roundRect, false, 2);
+
+	// wedges: filled three quarters, and a framed slice going anticlockwise
+	WedgeShape wedge;
+	SetRect(&wedge.rect, 44, 2, 76, 34);
+	wedge.arc1 = 135;
+	wedge.arc2 = 270;
+	CGContextSetGrayFillColor(ctx, 0.0, 1.0);
+	DrawWedge(ctx, wedge, true);
+	SetRect(&wedge.rect, 42, 38, 82, 62);
+	wedge.arc1 = 30;
+	wedge.arc2 = -120;
+	CGContextSetLineWidth(ctx, 1);
+	DrawWedge(ctx, wedge, false);
+
+	// polygons: a filled star, which crosses itself, and an open zigzag
+	Point star[6];
+	for (ArrayIndex i = 0; i < 6; ++i)
+	{
+		double angle = (i * 4 % 10) * M_PI / 5;
+		SetPt(&star[i], 101 + (short)(16 * sin(angle)), 22 - (short)(16 * cos(angle)));
+	}
+	CGContextSetGrayFillColor(ctx, 0.25, 1.0);
+	DrawPolygon(ctx, star, 6, true);
+	Point zigzag[5];
+	for (ArrayIndex i = 0; i < 5; ++i)
+		SetPt(&zigzag[i], 86 + i * 8, (i & 1) ? 46 : 60);
+	CGContextSetLineWidth(ctx, 2);
+	DrawPolygon(ctx, zigzag, 5, false);
+
+	// a region: an L with a hole in it
+	Rect r;
+	SetRect(&r, 122, 4, 156, 16);
+	CBaseRegion rgn;
+	rgn.unionRegion(CRectangularRegion(r));
+	SetRect(&r, 122, 16, 136, 40);
+	rgn.unionRegion(CRectangularRegion(r));
+	SetRect(&r, 126, 8, 130, 12);
+	rgn.diffRegion(CRectangularRegion(r));
+	CGContextSetGrayFillColor(ctx, 0.0, 1.0);
+	FillRegion(ctx, rgn);
+
+	// a bitmap: 8x8, 1 bit deep, at its own size and at twice it
+	static const UByte kBitmap[8] = { 0x3C, 0x42, 0xA5, 0x81, 0xA5, 0x99, 0x42, 0x3C };
+	SetRect(&r, 140, 20, 148, 28);
+	DrawBitmap(ctx, kBitmap, 8, 8, 1, &r, modeCopy);
+	SetRect(&r, 140, 42, 156, 58);
+	DrawBitmap(ctx, kBitmap, 8, 8, 1, &r, modeCopy);
+}
+
+
+static void
+DrawModes(CGContextRef ctx)
+{
+	CGContextSetGrayFillColor(ctx, 0.0, 1.0);
+	CGContextFillRect(ctx, CGRectMake(8, 8, 64, 48));
+	CGContextSetTransferMode(ctx, modeXor);
+	CGContextFillEllipseInRect(ctx, CGRectMake(40, 16, 64, 32));
+	CGContextSetTransferMode(ctx, modeCopy);
+
+	CGContextSaveGState(ctx);
+	CGContextClipToRect(ctx, CGRectMake(112, 16, 24, 32));
+	CGContextSetGrayFillColor(ctx, 0.5, 1.0);
+	CGContextFillEllipseInRect(ctx, CGRectMake(100, 8, 56, 48));
+	CGContextRestoreGState(ctx);
+}
+
+
+/*	Every transfer mode, one column each: a 2-bit image of four stripes, white to
+	black, blitted across four bands of the same grays. */
+static void
+DrawBlits(CGContextRef ctx)
+{
+	for (int band = 0; band < 4; ++band)
+	{
+		CGContextSetGrayFillColor(ctx, 1.0 - band / 3.0, 1.0);
+		CGContextFillRect(ctx, CGRectMake(0, kSceneHeight - (band + 1) * 16, kSceneWidth, 16));
+	}
+
+	UByte stripes[4 * kSceneHeight];
+	for (int y = 0; y < kSceneHeight; ++y)
+		for (int x = 0; x < 4; ++x)
+			stripes[y * 4 + x] = x * 0x55;
+	for (int mode = modeCopy; mode <= modeNotBic; ++mode)
+	{
+		Rect r;
+		SetRect(&r, mode * 20 + 2, 0, mode * 20 + 18, kSceneHeight);
+		DrawBitmap(ctx, stripes, 16, kSceneHeight, 2, &r, mode);
+	}
+}
+
+
+/*	Clipped to a region that isn't a rect: fills and strokes must stay inside it. */
+static void
+DrawClipped(CGContextRef ctx, const CBaseRegion & inRgn)
+{
+	CGContextSaveGState(ctx);
+	CGContextClipToRegion(ctx, inRgn);
+	CGContextSetGrayFillColor(ctx, 0.5, 1.0);
+	CGContextFillEllipseInRect(ctx, CGRectMake(0, 0, kSceneWidth, kSceneHeight));
+	CGContextSetGrayStrokeColor(ctx, 0.0, 1.0);
+	CGContextSetLineWidth(ctx, 3);
+	for (int x = -64; x < kSceneWidth; x += 16)
+	{
+		CGPoint line[2] = { { (CGFloat)x, 0 }, { (CGFloat)x + kSceneHeight, kSceneHeight } };
+		CGContextStrokeLineSegments(ctx, line, 2);
+	}
+	CGContextSelectFont(ctx, "Helvetica", 10.0, kCGEncodingMacRoman);
+	CGContextSetTextDrawingMode(ctx, kCGTextStroke);
+	CGContextShowTextAtPoint(ctx, 4, 28, "Clipped to a region", 19);
+	CGContextRestoreGState(ctx);
+}
+
+
+static void
+DrawText(CGContextRef ctx)
+{
+	CGContextSelectFont(ctx, "Helvetica", 10.0, kCGEncodingMacRoman);
+	CGContextSetTextDrawingMode(ctx, kCGTextStroke);
+	CGContextSetGrayStrokeColor(ctx, 0.0, 1.0);
+	const char * line1 = "The quick brown fox";
+	const char * line2 = "JUMPS OVER 0123456789";
+	const char * line3 = "!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+	CGContextShowTextAtPoint(ctx, 2, 54, line1, strlen(line1));
+	CGContextShowTextAtPoint(ctx, 2, 42, line2, strlen(line2));
+	CGContextShowTextAtPoint(ctx, 2, 30, line3, strlen(line3));
+
+	CGContextSelectFont(ctx, "Helvetica", 20.0, kCGEncodingMacRoman);
+	CGContextShowTextAtPoint(ctx, 2, 4, "Newt", 4);
+	CGContextSetGrayFillColor(ctx, 0.5, 1.0);
+	CGContextSetTextDrawingMode(ctx, kCGTextFill);
+	CGContextShowTextAtPoint(ctx, 2 + CGContextGetTextWidth(ctx, "Newt", 4), 4, "on", 2);
+
+	CGFloat ascent, descent;
+	CGContextGetFontMetrics(ctx, &ascent, &descent);
+	CHECK(ascent == 16 && descent == 6);
+	CHECK(CGContextGetTextWidth(ctx, "Newton", 6) == 6 * 12);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	bool isUpdate = (argc > 1 && strcmp(argv[1], "-update") == 0);
+
+	for (int depth = 1; depth <= 8; depth *= 2)
+	{
+		Scene shapes(depth), primitives(depth), blits(depth);
+		CHECK(shapes.ctx != NULL);
+		DrawShapes(shapes.ctx);
+		CheckGolden(shapes, "shapes", isUpdate);
+		DrawPrimitives(primitives.ctx);
+		CheckGolden(primitives, "primitives", isUpdate);
+		DrawBlits(blits.ctx);
+		CheckGolden(blits, "blits", isUpdate);
+
+		// a solid black fill sets every bit, whatever the depth
+		Scene black(depth);
+		CGContextSetGrayFillColor(black.ctx, 0.0, 1.0);
+		CGContextFillRect(black.ctx, CGRectMake(0, 0, kSceneWidth, kSceneHeight));
+		for (int i = 0; i < black.pixmap.rowBytes * kSceneHeight; ++i)
+			CHECK((UByte)black.pixmap.baseAddr[i] == 0xFF);
+	}
+	{
+		Scene scene;
+		DrawModes(scene.ctx);
+		CheckGolden(scene, "modes", isUpdate);
+	}
+	{
+		// a region with a hole, and a piece on its own
+		Rect r;
+		CBaseRegion rgn;
+		SetRect(&r, 8, 8, 72, 56);
+		rgn.unionRegion(CRectangularRegion(r));
+		SetRect(&r, 24, 20, 56, 40);
+		rgn.diffRegion(CRectangularRegion(r));
+		SetRect(&r, 88, 16, 152, 48);
+		rgn.unionRegion(CRectangularRegion(r));
+
+		Scene scene;
+		DrawClipped(scene.ctx, rgn);
+		CheckGolden(scene, "clip", isUpdate);
+
+		ArrayIndex numOfStrays = 0;
+		for (int y = 0; y < kSceneHeight; ++y)
+			for (int x = 0; x < kSceneWidth; ++x)
+			{
+				Point pt;
+				SetPt(&pt, x, y);
+				if (scene.pixel(x, y) != 0 && !rgn.contains(pt))
+					numOfStrays++;
+			}
+		CHECK(numOfStrays == 0);
+
+		// the clip's bounds are the region's, in user space
+		CGContextSaveGState(scene.ctx);
+		CGContextClipToRegion(scene.ctx, rgn);
+		CGRect clipBox = CGContextGetClipBoundingBox(scene.ctx);
+		CGContextRestoreGState(scene.ctx);
+		CHECK(clipBox.origin.x == 8 && clipBox.origin.y == kSceneHeight - 56
+			&& clipBox.size.width == 144 && clipBox.size.height == 48);
+	}
+	{
+		Scene scene;
+		DrawText(scene.ctx);
+		CheckGolden(scene, "text", isUpdate);
+
+		// invisible text draws nothing
+		Scene blank;
+		CGContextSelectFont(blank.ctx, "Helvetica", 10.0, kCGEncodingMacRoman);
+		CGContextSetTextDrawingMode(blank.ctx, kCGTextInvisible);
+		CGContextShowTextAtPoint(blank.ctx, 2, 20, "Newton", 6);
+		ArrayIndex numOfInked = 0;
+		for (int y = 0; y < kSceneHeight; ++y)
+			for (int x = 0; x < kSceneWidth; ++x)
+				if (blank.pixel(x, y) != 0)
+					numOfInked++;
+		CHECK(numOfInked == 0);
+	}
+
+	return TestResult("SoftQuartzGolden");
+}
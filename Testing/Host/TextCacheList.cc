@@ -0,0 +1,358 @@
+/*
+	File:		TextCacheList.cc
+
+	Contains:	Text cache test and benchmark.
+					Builds Graphics/TextCache.cc on SoftQuartz and scrolls a list
+					of 1,000 rows of text -- short names, longer lines that wrap,
+					left, centred and right justified -- down a 4-bit screen and
+					back up again. Each row is drawn as DrawUnicodeText draws it:
+					first laid out and rasterised afresh every time, as SoftQuartz
+					text was, then through the text cache and SoftQuartz's glyph
+					cache. The screens must match
+					pixel for pixel after every frame; the times and the caches'
+					hit rates are printed. Then checks what hits and what misses
+					in the text cache.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "TextCache.h"
+#include "Geometry.h"
+#include "Unicode.h"
+#include "ViewFlags.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define kNumOfRows			1000
+#define kRowHeight			24
+#define kRowWidth				300
+#define kMaxRowLength		160
+#define kScrollStep			20
+
+
+// QDDrawing.cc brings in the whole object system, so just this from it
+Ptr
+PixelMapBits(const NativePixelMap * inPixmap)
+{
+	return (Ptr)inPixmap->baseAddr;
+}
+
+// Exceptions.cc doesn't build here; regions only throw when out of memory
+DefineException(exOutOfMemory, evt.ex.outofmem);
+extern "C" {
+void	AddExceptionHandler(CatchHeader * inHandler) { }
+void	RemoveExceptionHandler(CatchHeader * inHandler) { }
+void	Throw(ExceptionName inName, void * inData, ExceptionDestructor inDestructor) { abort(); }
+}
+
+// Unicode.cc needs its encoding tables; the rows are all ASCII
+extern "C" void
+ConvertFromUnicode(const UniChar * inStr, void * outStr, ArrayIndex inLength, CharEncoding inEncoding)
+{
+	char * str = (char *)outStr;
+	for ( ; inLength > 0 && *inStr != 0; inLength--)
+		*str++ = *inStr++;
+	*str = 0;
+}
+
+// Screen.cc's, for a portrait screen
+CGContextRef		quartz;
+int					gScreenWidth = 320;
+int					gScreenHeight = 480;
+
+
+static double
+Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/* -----------------------------------------------------------------------------
+	The rows.
+----------------------------------------------------------------------------- */
+
+struct Row
+{
+	UniChar	text[kMaxRowLength];
+	size_t	length;
+	ULong		justify;
+};
+
+static const char * kWords[] = { "Call", "Meeting", "with", "the", "Newton", "team", "about", "handwriting",
+											"recognition", "lunch", "Tuesday", "notes", "ink", "dock", "backup", "Cupertino" };
+
+
+static void
+MakeRow(ArrayIndex inIndex, unsigned int * ioSeed, Row * outRow)
+{
+	char str[kMaxRowLength];
+	int length = snprintf(str, sizeof(str), "%u.", inIndex + 1);
+	// most rows fit on a line; every fifth wraps
+	ArrayIndex numOfWords = (inIndex % 5 == 0) ? 8 + rand_r(ioSeed) % 4 : 1 + rand_r(ioSeed) % 4;
+	for (ArrayIndex i = 0; i < numOfWords; ++i)
+		length += snprintf(str + length, sizeof(str) - length, " %s", kWords[rand_r(ioSeed) % (sizeof(kWords)/sizeof(kWords[0]))]);
+	for (int i = 0; i < length; ++i)
+		outRow->text[i] = str[i];
+	outRow->length = length;
+	outRow->justify = (inIndex % 3 == 0) ? vjLeftH : (inIndex % 3 == 1) ? vjCenterH : vjRightH;
+}
+
+
+/*------------------------------------------------------------------------------
+	Lay out text and draw it, as DrawText.cc did for SoftQuartz before the
+	text cache.
+	Args:		inStr					text
+				inLength				its length
+				inBox					box to lay it out in; the first line hangs from its top
+				inJustify			horizontal justification
+				inDoDraw				draw it, or just measure it
+	Return:	height of the laid out text
+------------------------------------------------------------------------------*/
+
+static CGFloat
+LayOutSoftText(const UniChar * inStr, size_t inLength, CGRect inBox, ULong inJustify, bool inDoDraw)
+{
+	char * str = new char[inLength + 1];
+	ConvertFromUnicode(inStr, str, inLength);
+
+	CGContextSaveGState(quartz);
+	CGContextSelectFont(quartz, "Helvetica", 10.0, kCGEncodingMacRoman);
+	CGFloat ascent, descent;
+	CGContextGetFontMetrics(quartz, &ascent, &descent);
+	CGFloat width = CGRectGetWidth(inBox);
+	CGFloat baseline = CGRectGetMaxY(inBox) - ascent;
+	CGFloat height = 0;
+
+	for (size_t lineStart = 0; lineStart < inLength; )
+	{
+		size_t lineEnd = inLength, nextStart = inLength;
+		size_t lastSpace = kIndexNotFound;
+		CGFloat lineWidth = 0;
+		for (size_t i = lineStart; i < inLength; ++i)
+		{
+			if (str[i] == '\r' || str[i] == '\n')
+			{
+				lineEnd = i;
+				nextStart = i + 1;
+				break;
+			}
+			if (str[i] == ' ')
+				lastSpace = i;
+			lineWidth += CGContextGetTextWidth(quartz, str + i, 1);
+			if (lineWidth > width)
+			{
+				if (lastSpace != kIndexNotFound)
+				{
+					lineEnd = lastSpace;
+					nextStart = lastSpace + 1;
+				}
+				else
+					lineEnd = nextStart = MAX(i, lineStart + 1);
+				break;
+			}
+		}
+		while (lineEnd > lineStart && str[lineEnd - 1] == ' ')
+			lineEnd--;
+
+		if (inDoDraw)
+		{
+			CGFloat x = CGRectGetMinX(inBox);
+			CGFloat slack = width - CGContextGetTextWidth(quartz, str + lineStart, lineEnd - lineStart);
+			if ((inJustify & vjHMask) == vjCenterH)
+				x += slack / 2;
+			else if ((inJustify & vjHMask) == vjRightH)
+				x += slack;
+			CGContextShowTextAtPoint(quartz, x, baseline, str + lineStart, lineEnd - lineStart);
+		}
+		baseline -= ascent + descent;
+		height += ascent + descent;
+		lineStart = nextStart;
+	}
+
+	CGContextRestoreGState(quartz);
+	delete[] str;
+	return height;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Scroll the list.
+----------------------------------------------------------------------------- */
+
+static void
+DrawFrame(const Row * inRows, int inScroll, CGColorRef inColor, bool inUseCache)
+{
+	CGContextSetGrayFillColor(quartz, 1.0, 1.0);
+	CGContextFillRect(quartz, CGRectMake(0, 0, gScreenWidth, gScreenHeight));
+	// as DrawUnicodeText sets up for text
+	CGContextSetTextMatrix(quartz, CGAffineTransformIdentity);
+	CGContextSetTextDrawingMode(quartz, kCGTextStroke);
+	CGContextSetStrokeColorWithColor(quartz, inColor);
+	for (ArrayIndex i = MAX(inScroll / kRowHeight - 1, 0); i < kNumOfRows; ++i)
+	{
+		int top = 4 + i * kRowHeight - inScroll;
+		if (top >= gScreenHeight)
+			break;
+		CGRect box = CGRectMake(10, gScreenHeight - top - kRowHeight, kRowWidth, kRowHeight);
+		if (inUseCache)
+			DrawCachedText(inRows[i].text, inRows[i].length, box, inColor, inRows[i].justify);
+		else
+			LayOutSoftText(inRows[i].text, inRows[i].length, box, inRows[i].justify, true);
+	}
+}
+
+
+static void
+ScrollList(const Row * inRows, NativePixelMap * ioScreen, NativePixelMap * ioReference, CGColorRef inColor)
+{
+	size_t screenSize = ioScreen->rowBytes * gScreenHeight;
+	CGContextRef screenContext = CGPixelMapContextCreate(ioScreen);
+	CGContextRef referenceContext = CGPixelMapContextCreate(ioReference);
+	CGContextSetShouldCacheGlyphs(referenceContext, false);
+	int maxScroll = kNumOfRows * kRowHeight - gScreenHeight;
+	ArrayIndex numOfFrames = 0, numOfDifferences = 0;
+	double oldTime = 0, newTime = 0;
+
+	FlushTextCache();
+	ULong hits0, misses0, glyphHits0, glyphMisses0;
+	TextCacheStatistics(&hits0, &misses0);
+	CGGlyphCacheGetStatistics(&glyphHits0, &glyphMisses0);
+
+	// down to the bottom and back up to the top
+	for (int step = kScrollStep, scroll = 0; scroll >= 0; scroll += step)
+	{
+		if (scroll >= maxScroll)
+			step = -kScrollStep;
+
+		quartz = referenceContext;
+		double startTime = Seconds();
+		DrawFrame(inRows, scroll, inColor, false);
+		oldTime += Seconds() - startTime;
+
+		quartz = screenContext;
+		startTime = Seconds();
+		DrawFrame(inRows, scroll, inColor, true);
+		newTime += Seconds() - startTime;
+
+		if (memcmp(ioScreen->baseAddr, ioReference->baseAddr, screenSize) != 0)
+		{
+			if (numOfDifferences++ == 0)
+				fprintf(stderr, "frame %u, scrolled %d, differs\n", numOfFrames, scroll);
+		}
+		numOfFrames++;
+	}
+	CHECK(numOfDifferences == 0);
+
+	ULong hits, misses, glyphHits, glyphMisses;
+	TextCacheStatistics(&hits, &misses);
+	CGGlyphCacheGetStatistics(&glyphHits, &glyphMisses);
+	hits -= hits0;
+	misses -= misses0;
+	glyphHits -= glyphHits0;
+	glyphMisses -= glyphMisses0;
+	// each row is laid out once on the way down, and again on the way up
+	// unless it is still in the cache
+	CHECK(misses >= kNumOfRows && misses < 2 * kNumOfRows);
+	// there are fewer than a hundred glyphs, all on the same fraction of a pixel
+	CHECK(glyphMisses < glyphHits / 100);
+	printf("%u frames scrolling %d rows: %.3fs -> %.3fs, %.0f -> %.0f frames/s\n",
+				numOfFrames, kNumOfRows, oldTime, newTime, numOfFrames / oldTime, numOfFrames / newTime);
+	printf("text runs: %u hits, %u misses, %.1f%% hit rate; glyphs: %u hits, %u misses, %.1f%% hit rate\n",
+				hits, misses, 100.0 * hits / (hits + misses), glyphHits, glyphMisses, 100.0 * glyphHits / (glyphHits + glyphMisses));
+
+	CGContextRelease(screenContext);
+	CGContextRelease(referenceContext);
+}
+
+
+/* -----------------------------------------------------------------------------
+	What hits and what misses.
+----------------------------------------------------------------------------- */
+
+static void
+CheckHits(CGColorRef inColor)
+{
+	const UniChar text[] = { 'N','e','w','t','o','n',' ','M','e','s','s','a','g','e','P','a','d' };
+	UniChar copy[sizeof(text)/sizeof(UniChar)];
+	size_t length = sizeof(text)/sizeof(UniChar);
+	memcpy(copy, text, sizeof(text));
+	CGColorRef otherColor = CGColorCreateGenericGray(0.5, 1.0);
+	ULong hits, misses, lastHits, lastMisses;
+
+	FlushTextCache();
+	TextCacheStatistics(&lastHits, &lastMisses);
+#define EXPECT(h, m)	TextCacheStatistics(&hits, &misses); \
+							CHECK(hits - lastHits == h && misses - lastMisses == m); \
+							lastHits = hits; lastMisses = misses
+
+	CGFloat height = MeasureCachedText(text, length, kRowWidth, inColor, vjLeftH);
+	EXPECT(0, 1);
+	CHECK(height == LayOutSoftText(text, length, CGRectMake(0, 0, kRowWidth, 100), vjLeftH, false));
+	// drawn anywhere, from a copy of the text, with other view justification bits
+	DrawCachedText(copy, length, CGRectMake(50, 50, kRowWidth, 10), inColor, vjLeftH | vjTopV);
+	EXPECT(1, 0);
+	// anything that changes the layout misses
+	MeasureCachedText(text, length, kRowWidth / 2, inColor, vjLeftH);
+	EXPECT(0, 1);
+	MeasureCachedText(text, length, kRowWidth, inColor, vjCenterH);
+	EXPECT(0, 1);
+	MeasureCachedText(text, length, kRowWidth, otherColor, vjLeftH);
+	EXPECT(0, 1);
+	MeasureCachedText(text, length - 1, kRowWidth, inColor, vjLeftH);
+	EXPECT(0, 1);
+	copy[0] = 'n';
+	MeasureCachedText(copy, length, kRowWidth, inColor, vjLeftH);
+	EXPECT(0, 1);
+	// a narrow box wraps it
+	CHECK(MeasureCachedText(text, length, 70, inColor, vjLeftH) == 2 * height);
+	EXPECT(0, 1);
+	MeasureCachedText(text, length, kRowWidth, inColor, vjLeftH);
+	EXPECT(1, 0);
+	// nothing is left after a flush
+	FlushTextCache();
+	MeasureCachedText(text, length, kRowWidth, inColor, vjLeftH);
+	EXPECT(0, 1);
+#undef EXPECT
+
+	CGColorRelease(otherColor);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	NativePixelMap screen;
+	screen.rowBytes = gScreenWidth * 4 / 8;
+	SetRect(&screen.bounds, 0, 0, gScreenWidth, gScreenHeight);
+	screen.pixMapFlags = kPixMapPtr + 4;
+	screen.deviceRes.h = screen.deviceRes.v = 0;
+	screen.grayTable = NULL;
+	NativePixelMap reference = screen;
+	screen.baseAddr = (Ptr)calloc(screen.rowBytes * gScreenHeight, 1);
+	reference.baseAddr = (Ptr)calloc(screen.rowBytes * gScreenHeight, 1);
+	CGColorRef black = CGColorCreateGenericGray(0.0, 1.0);
+
+	static Row rows[kNumOfRows];
+	unsigned int seed = 38;
+	for (ArrayIndex i = 0; i < kNumOfRows; ++i)
+		MakeRow(i, &seed, &rows[i]);
+
+	ScrollList(rows, &screen, &reference, black);
+
+	CGContextRef context = CGPixelMapContextCreate(&screen);
+	quartz = context;
+	CheckHits(black);
+	FlushTextCache();
+	CGContextRelease(context);
+
+	CGColorRelease(black);
+	free(screen.baseAddr);
+	free(reference.baseAddr);
+	return TestResult("TextCacheList");
+}
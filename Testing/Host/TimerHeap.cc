@@ -0,0 +1,451 @@
+/*
+	File:		TimerHeap.cc
+
+	Contains:	Timer engine test and benchmark.
+					Builds OS/TimerEngine.cc against a stub clock and alarm, and
+					checks that timers fire in expiry order, that timers expiring
+					together fire in the order they were queued, that cancelled
+					timers never fire, and that a reserved slot can't be taken by
+					anything queued in the meantime. Then times queueing,
+					cancelling and firing with 10000 timers outstanding, against a
+					sorted list as the engine used to keep.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostTest.h"
+#include "Timers.h"
+#include "KernelGlobals.h"
+
+#include <time.h>
+
+#define kNumOfTimers				2000
+#define kNumOfBenchmarkTimers		10000
+#define kNumOfBenchmarkChurns		10000
+
+
+static double
+Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/* -----------------------------------------------------------------------------
+	A stub kernel: a clock that moves only when the test moves it, and an
+	alarm that just remembers when it was set for.
+----------------------------------------------------------------------------- */
+
+static int64_t		gNow = 0;
+static int64_t		gAlarmTime = 0;		// 0 => none
+CTimerEngine *			gTimerEngine;
+CDoubleQContainer *	gTimerDeferred;
+bool						gKernelTraceOn = false;
+
+void	CScheduler::remove(CTask * inTask) { }
+void	AddTraceEvent(CTask * inTask, ULong inEvent, ULong inArg1, ULong inArg2) { }
+void	QueueNotify(CSharedMemMsg * inMsg) { abort(); }		// nothing here queues timeouts or delays
+
+extern "C" {
+void	EnterAtomic(void) { }
+void	ExitAtomic(void) { }
+}
+
+CTime
+GetClock(void)
+{
+	return CTime(gNow);
+}
+
+bool
+SetAlarmAtomic(CTime & inTime)
+{
+	if ((int64_t)inTime <= gNow)
+		return false;
+	gAlarmTime = inTime;
+	return true;
+}
+
+void
+ClearAlarmAtomic(void)
+{
+	gAlarmTime = 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Timers.
+	A CSharedMemMsg's constructor is in SharedMem.cc, which brings in all the
+	rest of the kernel, so the messages are zeroed memory with just what the
+	timer engine uses filled in.
+----------------------------------------------------------------------------- */
+
+struct TestTimer
+{
+	CSharedMemMsg *	msg;
+	int64_t				expiryTime;
+	ArrayIndex			queueOrder;
+	bool					isRemoved;
+};
+
+static TestTimer *	gTimer;
+static ArrayIndex *	gFired;			// indexes of timers, in the order they fired
+static ArrayIndex		gNumOfFired;
+static ArrayIndex		gNumOfEarly;	// timers that fired before they expired
+
+
+static CSharedMemMsg *
+NewTestMsg(void)
+{
+	CSharedMemMsg * msg = (CSharedMemMsg *)calloc(1, sizeof(CSharedMemMsg));
+	msg->fTimerIndex = kIndexNotFound;
+	return msg;
+}
+
+
+static void
+TimerFired(void * inData)
+{
+	ArrayIndex index = (ArrayIndex)(uintptr_t)inData;
+	if (gTimer[index].expiryTime > gNow)
+		gNumOfEarly++;
+	gFired[gNumOfFired++] = index;
+}
+
+
+static void
+NewTimers(ArrayIndex inCount)
+{
+	gTimer = (TestTimer *)calloc(inCount, sizeof(TestTimer));
+	gFired = (ArrayIndex *)calloc(inCount, sizeof(ArrayIndex));
+	gNumOfFired = 0;
+	gNumOfEarly = 0;
+	for (ArrayIndex i = 0; i < inCount; ++i)
+		gTimer[i].msg = NewTestMsg();
+}
+
+
+static void
+FreeTimers(ArrayIndex inCount)
+{
+	for (ArrayIndex i = 0; i < inCount; ++i)
+		free(gTimer[i].msg);
+	free(gTimer);
+	free(gFired);
+}
+
+
+static ArrayIndex	gQueueOrder;
+
+static bool
+QueueTimer(CTimerEngine & ioEngine, ArrayIndex index, Timeout inTimeout)
+{
+	gTimer[index].expiryTime = gNow + inTimeout;
+	gTimer[index].queueOrder = gQueueOrder++;
+	gTimer[index].isRemoved = false;
+	CHECK(ioEngine.reserve() == noErr);
+	return ioEngine.queueTimer(gTimer[index].msg, inTimeout, (void *)(uintptr_t)index, TimerFired, true);
+}
+
+
+// move the clock on, and take the timer interrupt if the alarm has gone off
+static void
+AdvanceTo(CTimerEngine & ioEngine, int64_t inTime)
+{
+	gNow = inTime;
+	if (gAlarmTime != 0 && gAlarmTime <= gNow)
+		ioEngine.alarm();
+}
+
+
+// every timer not removed has fired, in expiry then queue order
+static bool
+IsFiredInOrder(ArrayIndex inCount)
+{
+	ArrayIndex numOfLive = 0;
+	for (ArrayIndex i = 0; i < inCount; ++i)
+		if (!gTimer[i].isRemoved)
+			numOfLive++;
+	if (gNumOfFired != numOfLive || gNumOfEarly != 0)
+		return false;
+	for (ArrayIndex i = 1; i < gNumOfFired; ++i)
+	{
+		const TestTimer & prev = gTimer[gFired[i-1]];
+		const TestTimer & next = gTimer[gFired[i]];
+		if (prev.expiryTime > next.expiryTime
+		|| (prev.expiryTime == next.expiryTime && prev.queueOrder > next.queueOrder))
+			return false;
+	}
+	for (ArrayIndex i = 0; i < gNumOfFired; ++i)
+		if (gTimer[gFired[i]].isRemoved || gTimer[gFired[i]].msg->fTimerIndex != kIndexNotFound)
+			return false;
+	return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Ordering: random expiry times, with plenty of ties, queued as the clock
+	moves on and fired in random steps.
+----------------------------------------------------------------------------- */
+
+static void
+TestOrdering(void)
+{
+	CTimerEngine engine;
+	engine.init();
+	NewTimers(kNumOfTimers);
+	gNow = 1000;
+
+	unsigned int seed = 1;
+	for (ArrayIndex i = 0; i < kNumOfTimers; ++i)
+	{
+		// queue later timers so some expire with earlier ones queued before them
+		if (i % 100 == 99)
+			AdvanceTo(engine, gNow + rand_r(&seed) % 10);
+		CHECK(QueueTimer(engine, i, 1 + rand_r(&seed) % 500));
+	}
+	CHECK(engine.count() + gNumOfFired == kNumOfTimers);
+
+	while (engine.count() > 0)
+		AdvanceTo(engine, gNow + 1 + rand_r(&seed) % 7);
+	CHECK(IsFiredInOrder(kNumOfTimers));
+	CHECK(gAlarmTime <= gNow);		// nothing left to wake for
+	FreeTimers(kNumOfTimers);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Tie-breaking: timers that expire at the same moment fire first come, first
+	served -- including those queued later with a shorter timeout.
+----------------------------------------------------------------------------- */
+
+static void
+TestTies(void)
+{
+	CTimerEngine engine;
+	engine.init();
+	NewTimers(kNumOfTimers);
+	gNow = 1000;
+
+	for (ArrayIndex i = 0; i < kNumOfTimers / 2; ++i)
+		CHECK(QueueTimer(engine, i, 100));
+	AdvanceTo(engine, 1050);
+	CHECK(gNumOfFired == 0);
+	for (ArrayIndex i = kNumOfTimers / 2; i < kNumOfTimers; ++i)
+		CHECK(QueueTimer(engine, i, 50));
+
+	AdvanceTo(engine, 1100);
+	CHECK(gNumOfFired == kNumOfTimers);
+	for (ArrayIndex i = 0; i < gNumOfFired; ++i)
+		CHECK(gFired[i] == i);
+	FreeTimers(kNumOfTimers);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Cancelling: removed timers, wherever they are in the heap, never fire.
+----------------------------------------------------------------------------- */
+
+static void
+TestRemove(void)
+{
+	CTimerEngine engine;
+	engine.init();
+	NewTimers(kNumOfTimers);
+	gNow = 1000;
+
+	unsigned int seed = 2;
+	for (ArrayIndex i = 0; i < kNumOfTimers; ++i)
+		CHECK(QueueTimer(engine, i, 1 + rand_r(&seed) % 300));
+	for (ArrayIndex i = 0; i < kNumOfTimers; i += 3)
+	{
+		engine.remove(gTimer[i].msg);
+		gTimer[i].isRemoved = true;
+		CHECK(gTimer[i].msg->fTimerIndex == kIndexNotFound);
+		CHECK(MASKTEST(gTimer[i].msg->fFlags, kSMemMsgFlags_TimerMask) == 0);
+	}
+	// and the next to expire, which resets the alarm
+	CSharedMemMsg * first = engine.peek();
+	for (ArrayIndex i = 0; i < kNumOfTimers; ++i)
+		if (gTimer[i].msg == first)
+			gTimer[i].isRemoved = true;
+	engine.remove(first);
+
+	while (engine.count() > 0)
+		AdvanceTo(engine, gNow + 5);
+	CHECK(IsFiredInOrder(kNumOfTimers));
+	FreeTimers(kNumOfTimers);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Reserving: once every free slot is reserved, a timer queued without a
+	reservation -- as from an interrupt -- is turned away rather than take
+	one, and every reservation can still be queued.
+----------------------------------------------------------------------------- */
+
+static void
+TestReserve(void)
+{
+	CTimerEngine engine;
+	engine.init();
+	gNow = 1000;
+
+	// reserve every slot in the initial heap
+	ArrayIndex numOfReserved = 0;
+	CHECK(engine.reserve() == noErr);
+	numOfReserved++;
+	CSharedMemMsg * msg = NewTestMsg();
+	bool isQueued = engine.queueTimer(msg, 100, NULL, TimerFired);
+	for ( ; isQueued; numOfReserved++)
+	{
+		// it took a free slot; cancel it and reserve that slot instead
+		engine.remove(msg);
+		CHECK(engine.reserve() == noErr);
+		isQueued = engine.queueTimer(msg, 100, NULL, TimerFired);
+	}
+	CHECK(numOfReserved >= 2 && engine.count() == 0);
+	CHECK(MASKTEST(msg->fFlags, kSMemMsgFlags_TimerMask) == 0 && msg->fTimerIndex == kIndexNotFound);
+
+	// a reservation given back without queueing frees its slot
+	CSharedMemMsg * immediate = NewTestMsg();
+	immediate->fTimeout = kTimeOutImmediate;
+	CHECK(!engine.queueTimeout(immediate, true));
+	numOfReserved--;
+	CHECK(engine.queueTimer(msg, 100, NULL, TimerFired));
+	engine.remove(msg);
+	CHECK(engine.reserve() == noErr);
+	numOfReserved++;
+
+	// every reservation is good
+	NewTimers(numOfReserved);
+	for (ArrayIndex i = 0; i < numOfReserved; ++i)
+	{
+		gTimer[i].expiryTime = gNow + 100;
+		gTimer[i].queueOrder = gQueueOrder++;
+		CHECK(engine.queueTimer(gTimer[i].msg, 100, (void *)(uintptr_t)i, TimerFired, true));
+	}
+	CHECK(engine.count() == numOfReserved);
+	CHECK(!engine.queueTimer(msg, 100, NULL, TimerFired));
+
+	// and reserving another grows the heap
+	CHECK(engine.reserve() == noErr);
+	CHECK(engine.queueTimer(msg, 100, NULL, TimerFired, true));
+	engine.remove(msg);
+
+	AdvanceTo(engine, gNow + 100);
+	CHECK(IsFiredInOrder(numOfReserved));
+	FreeTimers(numOfReserved);
+	free(msg);
+	free(immediate);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Benchmark: 10000 timers outstanding, then cancel and requeue timers at
+	random, then fire them all. The sorted list is the engine as it was: an
+	insertion scan to queue, and a search to cancel.
+----------------------------------------------------------------------------- */
+
+struct ListTimer
+{
+	ListTimer *	next;
+	int64_t		expiryTime;
+};
+
+static ListTimer *	gList;
+
+static void
+ListQueue(ListTimer * inTimer)
+{
+	ListTimer ** p = &gList;
+	while (*p != NULL && (*p)->expiryTime <= inTimer->expiryTime)
+		p = &(*p)->next;
+	inTimer->next = *p;
+	*p = inTimer;
+}
+
+static void
+ListRemove(ListTimer * inTimer)
+{
+	for (ListTimer ** p = &gList; *p != NULL; p = &(*p)->next)
+		if (*p == inTimer)
+		{
+			*p = inTimer->next;
+			break;
+		}
+}
+
+
+static void
+Benchmark(void)
+{
+	// the heap
+	CTimerEngine engine;
+	engine.init();
+	NewTimers(kNumOfBenchmarkTimers);
+	gNow = 1000;
+	unsigned int seed = 3;
+	double startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfBenchmarkTimers; ++i)
+		QueueTimer(engine, i, 1 + rand_r(&seed) % 100000);
+	double queueTime = Seconds() - startTime;
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfBenchmarkChurns; ++i)
+	{
+		ArrayIndex index = rand_r(&seed) % kNumOfBenchmarkTimers;
+		engine.remove(gTimer[index].msg);
+		QueueTimer(engine, index, 1 + rand_r(&seed) % 100000);
+	}
+	double churnTime = Seconds() - startTime;
+	startTime = Seconds();
+	AdvanceTo(engine, gNow + 100000);
+	double fireTime = Seconds() - startTime;
+	CHECK(IsFiredInOrder(kNumOfBenchmarkTimers));
+	FreeTimers(kNumOfBenchmarkTimers);
+
+	// the list
+	ListTimer * timer = (ListTimer *)calloc(kNumOfBenchmarkTimers, sizeof(ListTimer));
+	gList = NULL;
+	seed = 3;
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfBenchmarkTimers; ++i)
+	{
+		timer[i].expiryTime = 1000 + 1 + rand_r(&seed) % 100000;
+		ListQueue(&timer[i]);
+	}
+	double listQueueTime = Seconds() - startTime;
+	startTime = Seconds();
+	for (ArrayIndex i = 0; i < kNumOfBenchmarkChurns; ++i)
+	{
+		ArrayIndex index = rand_r(&seed) % kNumOfBenchmarkTimers;
+		ListRemove(&timer[index]);
+		timer[index].expiryTime = 1000 + 1 + rand_r(&seed) % 100000;
+		ListQueue(&timer[index]);
+	}
+	double listChurnTime = Seconds() - startTime;
+	free(timer);
+
+	printf("%d timers: heap queue %.0fns, cancel+requeue %.0fns, fire %.0fns; sorted list queue %.0fns, cancel+requeue %.0fns\n",
+				kNumOfBenchmarkTimers,
+				queueTime * 1e9 / kNumOfBenchmarkTimers,
+				churnTime * 1e9 / kNumOfBenchmarkChurns,
+				fireTime * 1e9 / kNumOfBenchmarkTimers,
+				listQueueTime * 1e9 / kNumOfBenchmarkTimers,
+				listChurnTime * 1e9 / kNumOfBenchmarkChurns);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	gTimerDeferred = new CDoubleQContainer(offsetof(CSharedMemMsg, fTimerQItem));
+	TestOrdering();
+	TestTies();
+	TestRemove();
+	TestReserve();
+	Benchmark();
+	return TestResult("TimerHeap");
+}
@@ -0,0 +1,384 @@
+/*
+	File:		VisRgnCache.cc
+
+	Contains:	View visible region cache test.
+					Builds Views/View.cc on the host views and makes windows of
+					nested views, filled and not, framed and not, tappable and
+					not. Then moves, resizes, shows, hides and reorders them at
+					random through the views' own methods. After each change
+					every view's visible region, cached or not, must be what
+					setupVisRgn makes of it afresh, and every window's clipper
+					must hide what is in front of it and nothing else. First a
+					few changes are checked to keep the cached regions of views
+					in windows they don't touch. Prints how many regions came
+					from the cache.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "HostViews.h"
+#include "Regions.h"
+#include "Geometry.h"
+#include "ListLoop.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define kNumOfWindows		6
+#define kMaxNumOfViews		64
+#define kNumOfChanges		3000
+
+enum
+{
+	kShowHide,
+	kSetBounds,
+	kOffset,
+	kBringToFront,
+	kMoveBehind,
+	kNumOfKinds
+};
+
+static const char * kKindName[] = { "show/hide", "set bounds", "offset", "bring to front", "move behind" };
+
+static CView *		gView[kMaxNumOfViews];
+static ArrayIndex	gNumOfViews;
+static ArrayIndex	gNumOfRegions, gNumOfHits;
+
+
+/* -----------------------------------------------------------------------------
+	View.cc's redraw logs every call, so it's kept quiet while views change.
+----------------------------------------------------------------------------- */
+
+static int	gStdout = -1;
+
+static void
+Quiet(bool inQuiet)
+{
+	fflush(stdout);
+	if (inQuiet)
+	{
+		gStdout = dup(STDOUT_FILENO);
+		int devNull = open("/dev/null", O_WRONLY);
+		dup2(devNull, STDOUT_FILENO);
+		close(devNull);
+	}
+	else
+	{
+		dup2(gStdout, STDOUT_FILENO);
+		close(gStdout);
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Views.
+----------------------------------------------------------------------------- */
+
+static CView *
+WindowOf(CView * inView)
+{
+	while (!inView->hasVisRgn())
+		inView = inView->fParent;
+	return inView;
+}
+
+
+static void
+RandomBounds(const Rect * inWithin, int inMinSize, Rect * outBounds, unsigned int * ioSeed)
+{
+	int width = inMinSize + rand_r(ioSeed) % (RectGetWidth(*inWithin) - inMinSize + 1);
+	int height = inMinSize + rand_r(ioSeed) % (RectGetHeight(*inWithin) - inMinSize + 1);
+	int left = inWithin->left + rand_r(ioSeed) % (RectGetWidth(*inWithin) - width + 1);
+	int top = inWithin->top + rand_r(ioSeed) % (RectGetHeight(*inWithin) - height + 1);
+	SetRect(outBounds, left, top, left + width, top + height);
+}
+
+
+static CView *
+MakeView(CView * inParent, const Rect * inBounds, unsigned int * ioSeed)
+{
+	ULong flags = (rand_r(ioSeed) & 1) ? vClickable : 0;
+	ULong format = (rand_r(ioSeed) % 3 != 0) ? vfFillWhite : vfNone;
+	if (rand_r(ioSeed) & 1)
+		format |= vfFrameBlack + vfPen(1 + rand_r(ioSeed) % 2);
+	CView * view = NewHostView(inParent, inBounds, flags, format);
+	gView[gNumOfViews++] = view;
+	return view;
+}
+
+
+static void
+MakeWindow(const Rect * inBounds, unsigned int * ioSeed)
+{
+	CView * window = MakeView(gRootView, inBounds, ioSeed);
+	window->show();
+	for (ArrayIndex i = rand_r(ioSeed) % 4; i > 0; --i)
+	{
+		Rect bounds;
+		RandomBounds(inBounds, 4, &bounds, ioSeed);
+		CView * child = MakeView(window, &bounds, ioSeed);
+		child->show();
+		for (ArrayIndex j = rand_r(ioSeed) % 3; j > 0; --j)
+		{
+			Rect within = bounds;
+			InsetRect(&within, -8, -8);		// children may stray outside
+			RandomBounds(&within, 2, &bounds, ioSeed);
+			MakeView(child, &bounds, ioSeed)->show();
+		}
+	}
+}
+
+
+/* -----------------------------------------------------------------------------
+	Check a view's visible region against one made afresh.
+	Args:		inView			the view
+				outIsHit			true => the region came from the cache
+	Return:	true => the region is good
+----------------------------------------------------------------------------- */
+
+static bool
+CheckVisRgn(CView * inView, bool * outIsHit)
+{
+	CClipper * clip = WindowOf(inView)->clipper();
+	*outIsHit = (inView->fVisRgn != NULL && inView->fVisRgnGeneration == clip->fGeneration);
+	CRegion visRgn(inView->setupVisRgn());
+
+	// set the cache aside while the region is made afresh
+	CBaseRegion * cachedRgn = inView->fVisRgn;
+	ULong cachedGeneration = inView->fVisRgnGeneration;
+	inView->fVisRgn = NULL;
+	CRegion freshRgn(inView->setupVisRgn());
+	delete inView->fVisRgn;
+	inView->fVisRgn = cachedRgn;
+	inView->fVisRgnGeneration = cachedGeneration;
+
+	gNumOfRegions++;
+	if (*outIsHit)
+		gNumOfHits++;
+	return visRgn.fRegion->isEqual(*freshRgn.fRegion);
+}
+
+
+/* -----------------------------------------------------------------------------
+	Check a window's clipper: its visible region is its full region on the
+	screen less those of the visible windows in front of it.
+----------------------------------------------------------------------------- */
+
+static bool
+CheckClipper(CView * inWindow)
+{
+	CClipper * clip = inWindow->clipper();
+	if (!FLAGTEST(inWindow->viewFlags, vVisible))
+		return true;
+
+	CRegionVar visRgn;
+	visRgn.fRegion->setRegion(*clip->fFullRgn->fRegion);
+	CRectangularRegion screenRgn(gRootView->viewBounds);
+	visRgn.fRegion->sectRegion(screenRgn);
+	CView * view;
+	CBackwardLoop iter(gRootView->viewChildren);
+	while ((view = (CView *)iter.next()) != NULL && view != inWindow)
+		if (FLAGTEST(view->viewFlags, vVisible))
+			visRgn.fRegion->diffRegion(*view->clipper()->fFullRgn->fRegion);
+	return visRgn.fRegion->isEqual(*clip->x04->fRegion);
+}
+
+
+static bool
+CheckAll(ArrayIndex * outNumOfHits)
+{
+	bool isGood = true;
+	*outNumOfHits = 0;
+	for (ArrayIndex i = 0; i < gNumOfViews; ++i)
+	{
+		bool isHit;
+		if (!CheckVisRgn(gView[i], &isHit))
+			isGood = false;
+		if (isHit)
+			(*outNumOfHits)++;
+		if (gView[i]->hasVisRgn() && !CheckClipper(gView[i]))
+			isGood = false;
+	}
+	return isGood;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Two windows side by side: what happens in one leaves the other's cached
+	regions alone, until it's moved over the other.
+----------------------------------------------------------------------------- */
+
+static ArrayIndex
+NumOfHitsIn(CView * inWindow)
+{
+	ArrayIndex numOfHits = 0;
+	for (ArrayIndex i = 0; i < gNumOfViews; ++i)
+	{
+		bool isHit;
+		if (WindowOf(gView[i]) == inWindow)
+		{
+			CHECK(CheckVisRgn(gView[i], &isHit));
+			if (isHit)
+				numOfHits++;
+		}
+	}
+	return numOfHits;
+}
+
+
+static void
+CheckSideBySide(void)
+{
+	unsigned int seed = 35;
+	Rect leftBounds, rightBounds;
+	SetRect(&leftBounds, 10, 10, 150, 400);
+	SetRect(&rightBounds, 170, 10, 310, 400);
+	Quiet(true);
+	MakeWindow(&leftBounds, &seed);
+	CView * left = gView[0];
+	ArrayIndex firstRight = gNumOfViews;
+	MakeWindow(&rightBounds, &seed);
+	while (gNumOfViews - firstRight < 3)
+		MakeView(gView[firstRight], &rightBounds, &seed)->show();
+	CView * right = gView[firstRight];
+	Quiet(false);
+	ArrayIndex numOfRightViews = gNumOfViews - firstRight;
+
+	// fill the caches
+	NumOfHitsIn(left);
+	NumOfHitsIn(right);
+	CHECK(NumOfHitsIn(right) == numOfRightViews);
+
+	Point delta;
+	delta.h = 5;
+	delta.v = 7;
+	Rect bounds;
+	SetRect(&bounds, 20, 20, 60, 60);
+	Quiet(true);
+	left->offset(delta);
+	left->setBounds(&leftBounds);
+	left->hide();
+	left->show();
+	left->bringToFront();
+	Quiet(false);
+	CHECK(NumOfHitsIn(right) == numOfRightViews);
+
+	// the right window's child moves, so the right window's regions change
+	Quiet(true);
+	gView[firstRight + 1]->setBounds(&bounds);
+	Quiet(false);
+	CHECK(NumOfHitsIn(right) == 0);
+	CHECK(NumOfHitsIn(right) == numOfRightViews);
+
+	// the left window moves over the right, in front of it
+	delta.h = 100;
+	delta.v = 0;
+	Quiet(true);
+	left->offset(delta);
+	Quiet(false);
+	CHECK(NumOfHitsIn(right) == 0);
+	ArrayIndex numOfHits;
+	CHECK(CheckAll(&numOfHits));
+
+	// clear up for the random windows
+	Quiet(true);
+	for (ArrayIndex i = 0; i < gNumOfViews; ++i)
+		if (gView[i]->hasVisRgn())
+			gView[i]->hide();
+	gRootView->viewChildren->removeAll();
+	Quiet(false);
+	gNumOfViews = 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Random windows and random changes.
+----------------------------------------------------------------------------- */
+
+static void
+Change(int inKind, CView * inView, unsigned int * ioSeed)
+{
+	CView * parent = inView->fParent;
+	Rect within;
+	switch (inKind)
+	{
+	case kShowHide:
+		if (FLAGTEST(inView->viewFlags, vVisible))
+			inView->hide();
+		else
+			inView->show();
+		break;
+
+	case kSetBounds:
+		// somewhere about the parent, which for a window is the screen
+		within = parent->viewBounds;
+		InsetRect(&within, -20, -20);
+		Rect bounds;
+		RandomBounds(&within, 2, &bounds, ioSeed);
+		inView->setBounds(&bounds);
+		break;
+
+	case kOffset:
+		Point delta;
+		delta.h = rand_r(ioSeed) % 61 - 30;
+		delta.v = rand_r(ioSeed) % 61 - 30;
+		inView->offset(delta);
+		break;
+
+	case kBringToFront:
+		inView->bringToFront();
+		break;
+
+	case kMoveBehind:
+		parent->moveChildBehind(inView, (CView *)parent->viewChildren->at(rand_r(ioSeed) % parent->viewChildren->count()));
+		break;
+	}
+}
+
+
+static void
+CheckRandom(void)
+{
+	unsigned int seed = 36;
+	Quiet(true);
+	for (ArrayIndex i = 0; i < kNumOfWindows; ++i)
+	{
+		Rect bounds;
+		RandomBounds(&gRootView->viewBounds, 40, &bounds, &seed);
+		MakeWindow(&bounds, &seed);
+	}
+	Quiet(false);
+
+	ArrayIndex numOfHits, numOfBadChanges[kNumOfKinds] = { 0 };
+	CHECK(CheckAll(&numOfHits));
+	gNumOfRegions = gNumOfHits = 0;
+	for (ArrayIndex i = 0; i < kNumOfChanges; ++i)
+	{
+		int kind = rand_r(&seed) % kNumOfKinds;
+		CView * view = gView[rand_r(&seed) % gNumOfViews];
+		Quiet(true);
+		Change(kind, view, &seed);
+		Quiet(false);
+		if (!CheckAll(&numOfHits))
+		{
+			if (numOfBadChanges[kind]++ == 0)
+				fprintf(stderr, "change %u: %s of a %s view: bad visible region\n", i, kKindName[kind], view->hasVisRgn() ? "window" : "nested");
+		}
+	}
+	for (ArrayIndex kind = 0; kind < kNumOfKinds; ++kind)
+		CHECK(numOfBadChanges[kind] == 0);
+	CHECK(gNumOfHits > 0);
+	printf("%d changes to %u views in %d windows: %u of %u visible regions from the cache\n",
+				kNumOfChanges, gNumOfViews, kNumOfWindows, gNumOfHits, gNumOfRegions);
+}
+
+
+int
+main(int argc, const char * argv[])
+{
+	InitHostViews();
+	CheckSideBySide();
+	CheckRandom();
+	return TestResult("VisRgnCache");
+}
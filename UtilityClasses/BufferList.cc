@@ -158,7 +158,7 @@ CBufferList::getn(UByte * outBuf, size_t inSize)
 int
 CBufferList::copyOut(UByte * outBuf, size_t & ioSize)
 {
-	ioSize -= fBuffer->getn(outBuf, ioSize);
+	ioSize -= getn(outBuf, ioSize);	// walks on through the segments, unlike the original
 	if (fCurrentIndex == fHiBound
 	&&  fBuffer->atEOF())
 		return -1;
@@ -196,7 +196,7 @@ CBufferList::putn(const UByte * inBuf, size_t inSize)
 int
 CBufferList::copyIn(const UByte * inBuf, size_t & ioSize)
 {
-	ioSize -= fBuffer->putn(inBuf, ioSize);
+	ioSize -= putn(inBuf, ioSize);	// walks on through the segments, unlike the original
 	if (fCurrentIndex == fHiBound && fBuffer->atEOF())
 		return -1;
 	return 0;
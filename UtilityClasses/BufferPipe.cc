@@ -329,3 +329,56 @@ CBufferPipe::put(int dataByte)
 	return dataChar;
 }
 
+
+
+// direct access -- not in the original
+
+/*----------------------------------------------------------------------
+	Return the bytes waiting in the get buffer without copying them,
+	filling it first if it's empty. Consume them with
+	readSeek(count, kSeekFromHere).
+	Args:		outSpan		the bytes
+				outEOF		true => no bytes, the message has ended
+	Return:	their count
+----------------------------------------------------------------------*/
+
+size_t
+CBufferPipe::readSpan(UByte ** outSpan, bool & outEOF)
+{
+	if (fGetBuf == NULL)
+		ThrowErr(exPipe, kUCErrNotInitialized);
+
+	size_t count = fGetBuf->span(outSpan);
+	if (count == 0 && !f0D)
+	{
+		underflow(1, f0D);
+		count = fGetBuf->span(outSpan);
+	}
+	outEOF = (count == 0 && f0D);
+	if (outEOF)
+		f0D = false;
+	return count;
+}
+
+
+/*----------------------------------------------------------------------
+	Return the room left in the put buffer, emptying it first if it's
+	full. Fill it and commit the bytes with writeSeek(count, kSeekFromHere).
+	Args:		outSpan		the room
+	Return:	its size
+----------------------------------------------------------------------*/
+
+size_t
+CBufferPipe::writeSpan(UByte ** outSpan)
+{
+	if (fPutBuf == NULL)
+		ThrowErr(exPipe, kUCErrNotInitialized);
+
+	size_t count = fPutBuf->span(outSpan);
+	if (count == 0)
+	{
+		overflow();
+		count = fPutBuf->span(outSpan);
+	}
+	return count;
+}
@@ -54,6 +54,11 @@ public:
 
 	int		put(int dataByte);
 
+	// direct access to the buffers -- not in the original
+
+	size_t	readSpan(UByte ** outSpan, bool & outEOF);
+	size_t	writeSpan(UByte ** outSpan);
+
 protected:
 	CBufferSegment *	fGetBuf;
 	CBufferSegment *	fPutBuf;
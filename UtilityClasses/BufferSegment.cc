@@ -29,7 +29,7 @@ CBufferSegment::CBufferSegment()
 CBufferSegment::~CBufferSegment()
 {
 	if (fBufferIsOurs && fBuffer != NULL)
-		free(fBuffer);
+		FreePtr(fBuffer);
 }
 
 
@@ -37,7 +37,7 @@ NewtonErr
 CBufferSegment::init(size_t inSize)
 {
 	if (fBufferIsOurs && fBuffer != NULL)
-		free(fBuffer);
+		FreePtr(fBuffer);
 
 	fBuffer = NewPtr(inSize);
 	if (fBuffer == NULL)
@@ -58,7 +58,7 @@ NewtonErr
 CBufferSegment::init(void * inBuffer, size_t inSize, bool inDoFreeBuffer, long inValidOffset, long inValidCount)
 {
 	if (fBufferIsOurs && fBuffer != NULL)
-		free(fBuffer);
+		FreePtr(fBuffer);
 
 	fBufSize = inSize;
 	fBuffer = (Ptr)inBuffer;
@@ -358,3 +358,19 @@ CBufferSegment::position(void)
 	return (fBufPtr != NULL) ? fBufPtr - fLoBound : 0;
 }
 
+
+/*----------------------------------------------------------------------
+	Return the bytes from the position to the end of the segment without
+	copying them: the bytes still to get, or the room still to put.
+	Consume them with seek(count, kSeekFromHere).
+	Not in the original.
+	Args:		outSpan		the bytes
+	Return:	their count
+----------------------------------------------------------------------*/
+
+size_t
+CBufferSegment::span(UByte ** outSpan)
+{
+	*outSpan = (UByte *)fBufPtr;
+	return fHiBound - fBufPtr;
+}
@@ -81,6 +81,10 @@ public:
 	virtual	long		seek(long offset, int dir);
 	virtual	long		position(void);
 
+	// direct access to the buffer -- not in the original
+
+	size_t		span(UByte ** outSpan);
+
 private:
 //	CBufferSegment& operator=(const CBufferSegment&);
 //	CBufferSegment* operator&();
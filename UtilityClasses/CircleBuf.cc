@@ -336,9 +336,8 @@ CCircleBuf::copyOut(UByte * outBuf, ArrayIndex * ioSize, ULong * outArg3)
 			isBoundByMarker = 0;
 			status = 6;
 		}
-		*ioSize -= amtToCopy;
 
-		ArrayIndex amtCopied;
+		ArrayIndex amtCopied = amtToCopy;
 		ArrayIndex spaceAfter = fBufLen - fGetIndex;
 		UByte * p = fBuf + fGetIndex;
 		if (amtToCopy <= spaceAfter)
@@ -367,6 +366,78 @@ CCircleBuf::copyOut(UByte * outBuf, ArrayIndex * ioSize, ULong * outArg3)
 }
 
 
+/*------------------------------------------------------------------------------
+	Return the bytes in the buffer as they lie, without copying or removing
+	them: from the get index up to the end of the buffer, then from the start.
+	Like peekBytes(), stops before the byte that completes a marked message.
+	Consume them with skipBytes() or updateStart().
+	Args:		outSpan1		first span
+				outLen1
+				outSpan2		second span; NULL => none
+				outLen2
+	Return:	2 => buffer is empty
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CCircleBuf::peekSpans(UByte ** outSpan1, ArrayIndex * outLen1, UByte ** outSpan2, ArrayIndex * outLen2)
+{
+	ArrayIndex count;
+	if (bufferCountToNextMarker(&count) == 1 && count > 0)
+		count--;
+
+	ArrayIndex spaceAfter = fBufLen - fGetIndex;
+	*outSpan1 = fBuf + fGetIndex;
+	*outLen1 = (count <= spaceAfter) ? count : spaceAfter;
+	*outLen2 = count - *outLen1;
+	*outSpan2 = (*outLen2 > 0) ? fBuf : NULL;
+	return (count == 0) ? 2 : noErr;
+}
+
+
+/*------------------------------------------------------------------------------
+	Return the free space in the buffer as at most two spans: from the put
+	index up to the end of the buffer, then from the start.
+	Fill them and commit the bytes with updateEnd().
+	Args:		outSpan1		first span
+				outLen1
+				outSpan2		second span; NULL => none
+				outLen2
+	Return:	3 => buffer is full
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CCircleBuf::putSpans(UByte ** outSpan1, ArrayIndex * outLen1, UByte ** outSpan2, ArrayIndex * outLen2)
+{
+	ArrayIndex count = bufferSpace();
+	ArrayIndex spaceAfter = fBufLen - fPutIndex;
+	if (fGetIndex == 0)
+		spaceAfter--;
+	*outSpan1 = fBuf + fPutIndex;
+	*outLen1 = (count <= spaceAfter) ? count : spaceAfter;
+	*outLen2 = count - *outLen1;
+	*outSpan2 = (*outLen2 > 0) ? fBuf : NULL;
+	return (count == 0) ? 3 : noErr;
+}
+
+
+/*------------------------------------------------------------------------------
+	Remove bytes from the buffer without copying them.
+	Unlike updateStart(), won’t go past the put index.
+	Args:		inCount		number of bytes to remove
+	Return:	number of bytes removed
+------------------------------------------------------------------------------*/
+
+ArrayIndex
+CCircleBuf::skipBytes(ArrayIndex inCount)
+{
+	ArrayIndex count = bufferCount();
+	if (inCount > count)
+		inCount = count;
+	updateStart(inCount);
+	return inCount;
+}
+
+
 void
 CCircleBuf::updateStart(ArrayIndex inDelta)
 {
@@ -519,42 +590,33 @@ CCircleBuf::flushToNextMarker(ULong * outMarker)
 }
 
 
+/*------------------------------------------------------------------------------
+	Move bytes from another circle buffer into this one.
+	Each buffer’s data lies in at most two spans, so this takes at most
+	three memmoves. Markers are not moved.
+	Args:		inBuf			the buffer to move bytes from
+	Return:	2 => copy stopped because source is empty
+				3 => copy stopped because we’re full
+------------------------------------------------------------------------------*/
+
 NewtonErr
 CCircleBuf::getBytes(CCircleBuf * inBuf)
 {
-	NewtonErr status;
-
-	ArrayIndex i = fPutIndex;
-
-	ArrayIndex srcStopIndex = inBuf->fPutIndex;
-	ArrayIndex srcIndex = inBuf->fGetIndex;
-	UByte * srcBuf = inBuf->fBuf;
-	ArrayIndex srcBufLen = inBuf->fBufLen;
+	ArrayIndex srcCount = inBuf->bufferCount();
+	ArrayIndex spaceAfter = inBuf->fBufLen - inBuf->fGetIndex;
+	ArrayIndex srcLen1 = (srcCount <= spaceAfter) ? srcCount : spaceAfter;
+	ArrayIndex srcLen2 = srcCount - srcLen1;
 
-	for ( ; ; )
-	{
-		if (srcIndex == srcStopIndex)
-		{
-			status = 2;	// copy stopped because source is empty
-			break;
-		}
-
-		fBuf[i] = srcBuf[srcIndex];
-		if (++srcIndex == srcBufLen)
-			srcIndex = 0;
-		if (++i == fBufLen)
-			i = 0;
-
-		if (i == fGetIndex)
-		{
-			status = 3;	// copy stopped because we’re full
-			break;
-		}
-	}
-	fPutIndex = i;
-	inBuf->fGetIndex = srcStopIndex;
+	ArrayIndex amtLeft = srcLen1;
+	copyIn(inBuf->fBuf + inBuf->fGetIndex, &amtLeft);
+	if (amtLeft == 0 && srcLen2 > 0)
+		copyIn(inBuf->fBuf, &srcLen2);
+	else
+		srcLen2 += amtLeft;
+	// srcLen2 is now the number of bytes that didn’t fit
+	inBuf->updateStart(srcCount - srcLen2);
 
-	return status;
+	return (srcLen2 == 0) ? 2 : 3;
 }
 
 
@@ -630,6 +692,37 @@ CCircleBuf::peekNextByte(UByte * outByte, ULong * outArg2)
 }
 
 
+/*------------------------------------------------------------------------------
+	Copy bytes from the buffer without removing them.
+	Stops before the byte that completes a marked message, so callers can skip
+	what they have consumed with updateStart() and leave getNextByte() to
+	report the marker.
+	Args:		outBuf		buffer to receive bytes
+				ioSize		on entry, size of outBuf; on exit, number of bytes copied
+	Return:	2 => buffer is empty
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CCircleBuf::peekBytes(UByte * outBuf, ArrayIndex * ioSize)
+{
+	UByte * span1, * span2;
+	ArrayIndex len1, len2;
+	peekSpans(&span1, &len1, &span2, &len2);
+	if (len1 > *ioSize)
+		len1 = *ioSize;
+	if (len2 > *ioSize - len1)
+		len2 = *ioSize - len1;
+	*ioSize = len1 + len2;
+	if (*ioSize == 0)
+		return 2;
+
+	memmove(outBuf, span1, len1);
+	if (len2 > 0)
+		memmove(outBuf + len1, span2, len2);
+	return noErr;
+}
+
+
 NewtonErr
 CCircleBuf::peekFirstLong(ULong * outLong)
 {
@@ -49,6 +49,11 @@ public:
 	NewtonErr	copyOut(CBufferList * outBuf, ArrayIndex * ioSize, ULong * outArg3 = NULL);
 	NewtonErr	copyOut(UByte * outBuf, ArrayIndex * ioSize, ULong * outArg3 = NULL);
 
+	// direct access to the buffer, as at most two contiguous spans
+	NewtonErr	peekSpans(UByte ** outSpan1, ArrayIndex * outLen1, UByte ** outSpan2, ArrayIndex * outLen2);
+	NewtonErr	putSpans(UByte ** outSpan1, ArrayIndex * outLen1, UByte ** outSpan2, ArrayIndex * outLen2);
+	ArrayIndex	skipBytes(ArrayIndex inCount);
+
 	void			updateStart(ArrayIndex inDelta);
 	void			updateEnd(ArrayIndex inDelta);
 
@@ -66,6 +71,7 @@ public:
 	NewtonErr	getNextByte(UByte * outByte, ULong *);
 	NewtonErr	peekNextByte(UByte * outByte);
 	NewtonErr	peekNextByte(UByte * outByte, ULong *);
+	NewtonErr	peekBytes(UByte * outBuf, ArrayIndex * ioSize);
 	NewtonErr	peekFirstLong(ULong * outLong);
 
 	NewtonErr	putFirstPossible(UByte inByte);
@@ -416,7 +416,7 @@ CArrayIterator::removeFromList(void)
 {
 	CArrayIterator *	result = (fNextLink != this) ? fNextLink : NULL;
 	fNextLink->fPreviousLink = fPreviousLink;
-	fNextLink->fNextLink = fPreviousLink->fNextLink;
+	fPreviousLink->fNextLink = fNextLink;
 	fNextLink = fPreviousLink = this;
 	return result;
 }
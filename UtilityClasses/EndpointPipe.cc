@@ -76,6 +76,129 @@ CEndpointPipe::removeFromAppWorld(void)
 }
 
 
+/*------------------------------------------------------------------------------
+	Read a chunk. Whole get buffers' worth are received straight into the
+	caller's memory rather than through the get buffer.
+	Not in the original, which used CBufferPipe's.
+	Args:		outBuf		the chunk
+				ioSize		its size; on return, the number of bytes read
+				outEOF		true => the message has ended
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CEndpointPipe::readChunk(void * outBuf, size_t & ioSize, bool & outEOF)
+{
+	NewtonErr err;
+
+	if (fEndpoint == NULL || fGetBuf == NULL)
+		ThrowErr(exPipe, kUCErrNotInitialized);
+	if (isAborted)
+		ThrowErr(exPipe, kOSErrCallAborted);
+
+	// take what the get buffer holds
+	UByte * p = (UByte *)outBuf;
+	size_t amtRemaining = ioSize;
+	size_t count = fGetBuf->getn(p, amtRemaining);
+	p += count;
+	amtRemaining -= count;
+	outEOF = false;
+	if (f0D)
+	{
+		// that was the end of the message
+		if (fGetBuf->atEOF())
+		{
+			f0D = false;
+			outEOF = true;
+		}
+		ioSize -= amtRemaining;
+		return;
+	}
+
+	// receive whole buffers' worth in place
+	size_t bufSize = fGetBuf->getPhysicalSize();
+	while (amtRemaining >= bufSize)
+	{
+		ArrayIndex amtReceived = amtRemaining;
+		ULong flags = fFraming ? 2 : 0;
+		if ((err = fEndpoint->nRcv(p, &amtReceived, amtReceived, &flags, fTimeout)) != noErr)
+			ThrowErr(exPipe, err);
+		fNumOfBytesRead += amtReceived;
+		p += amtReceived;
+		amtRemaining -= amtReceived;
+		if (fCallback && (err = fCallback->status(fNumOfBytesRead, fNumOfBytesWritten)) != noErr)
+			ThrowErr(exPipe, err);
+		if ((flags & 0x01) == 0)
+		{
+			outEOF = true;
+			ioSize -= amtRemaining;
+			return;
+		}
+	}
+
+	// and the rest through the get buffer
+	if (amtRemaining > 0)
+	{
+		count = amtRemaining;
+		CBufferPipe::readChunk(p, count, outEOF);
+		amtRemaining -= count;
+	}
+	ioSize -= amtRemaining;
+}
+
+
+/*------------------------------------------------------------------------------
+	Write a chunk. Once the put buffer is full, whole put buffers' worth are
+	sent straight from the caller's memory rather than through the put buffer.
+	Not in the original, which used CBufferPipe's.
+	Args:		inBuf			the chunk
+				inSize		its size
+				inFlush		true => send it all, ending the message
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CEndpointPipe::writeChunk(const void * inBuf, size_t inSize, bool inFlush)
+{
+	NewtonErr err;
+
+	if (fEndpoint == NULL || fPutBuf == NULL)
+		ThrowErr(exPipe, kUCErrNotInitialized);
+	if (isAborted)
+		ThrowErr(exPipe, kOSErrCallAborted);
+
+	const UByte * p = (const UByte *)inBuf;
+	size_t amtRemaining = inSize;
+	size_t bufSize = fPutBuf->getSize();
+	if (amtRemaining > bufSize - fPutBuf->position())
+	{
+		// top up the put buffer and send it
+		size_t count = amtRemaining;
+		fPutBuf->copyIn(p, count);
+		p += amtRemaining - count;
+		amtRemaining = count;
+		overflow();
+
+		// send whole buffers' worth in place
+		if (amtRemaining >= bufSize)
+		{
+			ArrayIndex amtSent = amtRemaining - amtRemaining % bufSize;
+			ULong flags = fFraming ? 3 : 1;
+			if ((err = fEndpoint->nSnd((UByte *)p, &amtSent, flags, fTimeout)) != noErr)
+				ThrowErr(exPipe, err);
+			fNumOfBytesWritten += amtSent;
+			p += amtSent;
+			amtRemaining -= amtSent;
+			if (fCallback && (err = fCallback->status(fNumOfBytesRead, fNumOfBytesWritten)) != noErr)
+				ThrowErr(exPipe, err);
+		}
+	}
+
+	// and the rest through the put buffer
+	CBufferPipe::writeChunk(p, amtRemaining, inFlush);
+}
+
+
 void
 CEndpointPipe::resetRead(void)
 {
@@ -33,6 +33,8 @@ public:
 	bool		usingFraming(void);
 
 	// pipe interface
+	void		readChunk(void * outBuf, size_t & ioSize, bool & outEOF);
+	void		writeChunk(const void * inBuf, size_t inSize, bool inFlush);
 	void		resetRead(void);
 	void		resetWrite(void);
 	void		flushRead(void);
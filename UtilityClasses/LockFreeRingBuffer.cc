@@ -0,0 +1,312 @@
+/*
+	File:		LockFreeRingBuffer.cc
+
+	Contains:	Lock-free single-producer/single-consumer ring buffer implementation.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "LockFreeRingBuffer.h"
+#include "OSErrors.h"
+
+#include <string.h>
+
+
+/*------------------------------------------------------------------------------
+	C L o c k F r e e R i n g B u f f e r
+------------------------------------------------------------------------------*/
+
+CLockFreeRingBuffer::CLockFreeRingBuffer()
+{
+	fBuf = NULL;
+	fMask = 0;
+	fIsBufOurs = false;
+	fPutIndex = fPutCachedGetIndex = 0;
+	fGetIndex = fGetCachedPutIndex = 0;
+}
+
+
+CLockFreeRingBuffer::~CLockFreeRingBuffer()
+{
+	if (fIsBufOurs && fBuf != NULL)
+		FreePtr((Ptr)fBuf);
+}
+
+
+/*------------------------------------------------------------------------------
+	Initialize with a buffer of our own.
+	Args:		inSize		minimum size in bytes; rounded up to a power of 2
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CLockFreeRingBuffer::init(size_t inSize)
+{
+	size_t	size;
+	UByte *	buf;
+
+	for (size = 1; size < inSize; size <<= 1)
+		;
+	if ((buf = (UByte *)NewPtr(size)) == NULL)
+		return kOSErrNoMemory;
+	init(buf, size);
+	fIsBufOurs = true;
+	return noErr;
+}
+
+
+/*------------------------------------------------------------------------------
+	Initialize with the caller’s buffer.
+	Must be called before either side uses the buffer.
+	Args:		inBuf			the buffer
+				inSize		its size in bytes; must be a power of 2
+	Return:	error code
+------------------------------------------------------------------------------*/
+
+NewtonErr
+CLockFreeRingBuffer::init(UByte * inBuf, size_t inSize)
+{
+	if (inSize == 0 || (inSize & (inSize - 1)) != 0)
+		return kOSErrBadParameters;
+	if (fIsBufOurs && fBuf != NULL)
+		FreePtr((Ptr)fBuf);
+	fBuf = inBuf;
+	fMask = inSize - 1;
+	fIsBufOurs = false;
+	fPutIndex = fPutCachedGetIndex = 0;
+	fGetIndex = fGetCachedPutIndex = 0;
+	return noErr;
+}
+
+
+/*------------------------------------------------------------------------------
+	Snapshot queries; safe from either side, but only a hint on the other.
+------------------------------------------------------------------------------*/
+
+bool
+CLockFreeRingBuffer::isEmpty(void) const
+{
+	return __atomic_load_n(&fPutIndex, __ATOMIC_ACQUIRE) == __atomic_load_n(&fGetIndex, __ATOMIC_ACQUIRE);
+}
+
+
+bool
+CLockFreeRingBuffer::isFull(void) const
+{
+	return __atomic_load_n(&fPutIndex, __ATOMIC_ACQUIRE) - __atomic_load_n(&fGetIndex, __ATOMIC_ACQUIRE) == fMask + 1;
+}
+
+
+#pragma mark Producer
+/*------------------------------------------------------------------------------
+	Return the space free to put into.
+	Args:		--
+	Return:	number of bytes
+------------------------------------------------------------------------------*/
+
+size_t
+CLockFreeRingBuffer::freeCount(void)
+{
+	fPutCachedGetIndex = __atomic_load_n(&fGetIndex, __ATOMIC_ACQUIRE);
+	return fBuf ? fMask + 1 - (fPutIndex - fPutCachedGetIndex) : 0;
+}
+
+
+/*------------------------------------------------------------------------------
+	Return the free space as at most two spans: from the put index up to the
+	end of the buffer, then from the start.
+	Args:		outBuf1		first span
+				outBuf1Len
+				outBuf2		second span; NULL => none
+				outBuf2Len
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CLockFreeRingBuffer::computePutVectors(UByte *& outBuf1, size_t & outBuf1Len, UByte *& outBuf2, size_t & outBuf2Len)
+{
+	size_t	count = freeCount();
+	size_t	offset = fPutIndex & fMask;
+	outBuf1 = fBuf + offset;
+	outBuf1Len = fMask + 1 - offset;
+	if (outBuf1Len > count)
+		outBuf1Len = count;
+	outBuf2Len = count - outBuf1Len;
+	outBuf2 = outBuf2Len > 0 ? fBuf : NULL;
+}
+
+
+/*------------------------------------------------------------------------------
+	Publish bytes written into the put vectors.
+	Args:		inCount		number of bytes written
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CLockFreeRingBuffer::updatePutVector(size_t inCount)
+{
+	__atomic_store_n(&fPutIndex, fPutIndex + inCount, __ATOMIC_RELEASE);
+}
+
+
+/*------------------------------------------------------------------------------
+	Put bytes into the buffer.
+	Args:		inBuf			the bytes
+				inCount		number of them
+	Return:	number of bytes put; fewer than inCount if the buffer filled
+------------------------------------------------------------------------------*/
+
+size_t
+CLockFreeRingBuffer::putn(const void * inBuf, size_t inCount)
+{
+	size_t	count = fMask + 1 - (fPutIndex - fPutCachedGetIndex);
+	if (count < inCount)
+		count = freeCount();
+	if (count > inCount)
+		count = inCount;
+	if (count > 0)
+	{
+		size_t	offset = fPutIndex & fMask;
+		size_t	count1 = fMask + 1 - offset;
+		if (count1 > count)
+			count1 = count;
+		memcpy(fBuf + offset, inBuf, count1);
+		if (count > count1)
+			memcpy(fBuf, (const UByte *)inBuf + count1, count - count1);
+		updatePutVector(count);
+	}
+	return count;
+}
+
+
+#pragma mark -
+#pragma mark Consumer
+/*------------------------------------------------------------------------------
+	Return the number of bytes there are to get.
+	Args:		--
+	Return:	number of bytes
+------------------------------------------------------------------------------*/
+
+size_t
+CLockFreeRingBuffer::dataCount(void)
+{
+	fGetCachedPutIndex = __atomic_load_n(&fPutIndex, __ATOMIC_ACQUIRE);
+	return fGetCachedPutIndex - fGetIndex;
+}
+
+
+/*------------------------------------------------------------------------------
+	Return the data as at most two spans: from the get index up to the end
+	of the buffer, then from the start.
+	Args:		outBuf1		first span
+				outBuf1Len
+				outBuf2		second span; NULL => none
+				outBuf2Len
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CLockFreeRingBuffer::computeGetVectors(UByte *& outBuf1, size_t & outBuf1Len, UByte *& outBuf2, size_t & outBuf2Len)
+{
+	size_t	count = dataCount();
+	size_t	offset = fGetIndex & fMask;
+	outBuf1 = fBuf + offset;
+	outBuf1Len = fMask + 1 - offset;
+	if (outBuf1Len > count)
+		outBuf1Len = count;
+	outBuf2Len = count - outBuf1Len;
+	outBuf2 = outBuf2Len > 0 ? fBuf : NULL;
+}
+
+
+/*------------------------------------------------------------------------------
+	Release bytes read from the get vectors, so they can be put into again.
+	Args:		inCount		number of bytes read
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CLockFreeRingBuffer::updateGetVector(size_t inCount)
+{
+	__atomic_store_n(&fGetIndex, fGetIndex + inCount, __ATOMIC_RELEASE);
+}
+
+
+/*------------------------------------------------------------------------------
+	Copy bytes out of the buffer without removing them.
+	Args:		outBuf		where to copy them
+				inCount		number of bytes wanted
+	Return:	number of bytes copied; fewer than inCount if the buffer emptied
+------------------------------------------------------------------------------*/
+
+size_t
+CLockFreeRingBuffer::peekn(void * outBuf, size_t inCount)
+{
+	size_t	count = fGetCachedPutIndex - fGetIndex;
+	if (count < inCount)
+		count = dataCount();
+	if (count > inCount)
+		count = inCount;
+	if (count > 0)
+	{
+		size_t	offset = fGetIndex & fMask;
+		size_t	count1 = fMask + 1 - offset;
+		if (count1 > count)
+			count1 = count;
+		memcpy(outBuf, fBuf + offset, count1);
+		if (count > count1)
+			memcpy((UByte *)outBuf + count1, fBuf, count - count1);
+	}
+	return count;
+}
+
+
+/*------------------------------------------------------------------------------
+	Get bytes out of the buffer.
+	Args:		outBuf		where to copy them
+				inCount		number of bytes wanted
+	Return:	number of bytes got; fewer than inCount if the buffer emptied
+------------------------------------------------------------------------------*/
+
+size_t
+CLockFreeRingBuffer::getn(void * outBuf, size_t inCount)
+{
+	size_t	count = peekn(outBuf, inCount);
+	if (count > 0)
+		updateGetVector(count);
+	return count;
+}
+
+
+/*------------------------------------------------------------------------------
+	Remove bytes from the buffer without copying them.
+	Args:		inCount		number of bytes to remove
+	Return:	number of bytes removed
+------------------------------------------------------------------------------*/
+
+size_t
+CLockFreeRingBuffer::skip(size_t inCount)
+{
+	size_t	count = fGetCachedPutIndex - fGetIndex;
+	if (count < inCount)
+		count = dataCount();
+	if (count > inCount)
+		count = inCount;
+	if (count > 0)
+		updateGetVector(count);
+	return count;
+}
+
+
+/*------------------------------------------------------------------------------
+	Discard everything in the buffer.
+	Only the consumer can do this; the producer may be putting at the time.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------*/
+
+void
+CLockFreeRingBuffer::flush(void)
+{
+	updateGetVector(dataCount());
+}
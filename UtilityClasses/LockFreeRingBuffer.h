@@ -0,0 +1,78 @@
+/*
+	File:		LockFreeRingBuffer.h
+
+	Contains:	Lock-free single-producer/single-consumer ring buffer interface.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__LOCKFREERINGBUFFER_H)
+#define __LOCKFREERINGBUFFER_H 1
+
+#include "NewtonTypes.h"
+#include <stddef.h>
+
+#define kCacheLineSize	64
+
+/*------------------------------------------------------------------------------
+	C L o c k F r e e R i n g B u f f e r
+	A byte FIFO for passing data between exactly one producer and one consumer
+	-- typically a host thread and a Newton task -- without locking.
+	The producer only ever writes fPutIndex and the consumer fGetIndex; each
+	publishes its index with release ordering after moving the data, and reads
+	the other's with acquire ordering, so data is never seen before the index
+	that covers it. Each side also keeps its own copy of the other's index and
+	only rereads it when the copy says the buffer is full (or empty); the two
+	sides are kept in separate cache lines.
+	Indices run freely and are masked, so the size is a power of 2 and the
+	whole buffer can be used.
+	Producer side:	freeCount, putn, computePutVectors, updatePutVector
+	Consumer side:	dataCount, getn, peekn, skip, flush, computeGetVectors, updateGetVector
+------------------------------------------------------------------------------*/
+
+class CLockFreeRingBuffer
+{
+public:
+					CLockFreeRingBuffer();
+					~CLockFreeRingBuffer();
+
+	NewtonErr	init(size_t inSize);
+	NewtonErr	init(UByte * inBuf, size_t inSize);
+
+	size_t		getSize(void) const;
+	bool			isEmpty(void) const;
+	bool			isFull(void) const;
+
+// producer side
+	size_t		freeCount(void);
+	size_t		putn(const void * inBuf, size_t inCount);
+	void			computePutVectors(UByte *& outBuf1, size_t & outBuf1Len, UByte *& outBuf2, size_t & outBuf2Len);
+	void			updatePutVector(size_t inCount);
+
+// consumer side
+	size_t		dataCount(void);
+	size_t		getn(void * outBuf, size_t inCount);
+	size_t		peekn(void * outBuf, size_t inCount);
+	size_t		skip(size_t inCount);
+	void			flush(void);
+	void			computeGetVectors(UByte *& outBuf1, size_t & outBuf1Len, UByte *& outBuf2, size_t & outBuf2Len);
+	void			updateGetVector(size_t inCount);
+
+private:
+	UByte *		fBuf;
+	size_t		fMask;				// size - 1
+	bool			fIsBufOurs;
+	UByte			fPad0[kCacheLineSize];
+// producer
+	size_t		fPutIndex;
+	size_t		fPutCachedGetIndex;
+	UByte			fPad1[kCacheLineSize - 2*sizeof(size_t)];
+// consumer
+	size_t		fGetIndex;
+	size_t		fGetCachedPutIndex;
+	UByte			fPad2[kCacheLineSize - 2*sizeof(size_t)];
+};
+
+inline size_t	CLockFreeRingBuffer::getSize(void) const  { return fBuf ? fMask + 1 : 0; }
+
+#endif	/* __LOCKFREERINGBUFFER_H */
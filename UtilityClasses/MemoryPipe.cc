@@ -60,5 +60,7 @@ CMemoryPipe::overflow(void)
 void
 CMemoryPipe::underflow(long inArg1, bool & ioArg2)
 {
-	ioArg2 = false;
+	// there's no more to come: the get buffer is all there is
+	// the original said there was, so reading past the end never returned
+	ioArg2 = true;
 }
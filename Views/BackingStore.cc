@@ -0,0 +1,218 @@
+/*
+	File:		BackingStore.cc
+
+	Contains:	Offscreen copy of a view's drawing.
+
+	Written by:	Newton Research Group.
+*/
+
+#include "BackingStore.h"
+#include "Screen.h"
+#include "NewtonMemory.h"
+
+static CBackingStore *	gBackingStores = NULL;		// all of them, for invalidateOverlapping()
+static int					gNumOfStoresDrawing = 0;
+
+
+/* -----------------------------------------------------------------------------
+	Constructor.
+	Nothing is allocated until the view is first drawn.
+----------------------------------------------------------------------------- */
+
+CBackingStore::CBackingStore()
+{
+	fContext = NULL;
+	fSavedContext = NULL;
+	fBounds = gZeroRect;
+	fWidth = fHeight = 0;
+	fIsValid = false;
+#if defined(forSoftQuartz)
+	fPixMap.baseAddr = NULL;
+#endif
+	fNext = gBackingStores;
+	gBackingStores = this;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Destructor.
+----------------------------------------------------------------------------- */
+
+CBackingStore::~CBackingStore()
+{
+	for (CBackingStore ** p = &gBackingStores; *p != NULL; p = &(*p)->fNext)
+	{
+		if (*p == this)
+		{
+			*p = fNext;
+			break;
+		}
+	}
+	free();
+}
+
+
+/* -----------------------------------------------------------------------------
+	Allocate the offscreen pixels and a context that draws into them.
+	The pixels match the screen's depth, so that copying them to the screen
+	is exact.
+	Args:		inWidth			size required
+				inHeight
+	Return:	true => allocated
+----------------------------------------------------------------------------- */
+
+bool
+CBackingStore::allocate(int inWidth, int inHeight)
+{
+	free();
+	if (inWidth <= 0 || inHeight <= 0)
+		return false;
+
+#if defined(forSoftQuartz)
+	int depth = PixelDepth(&gScreenPixelMap);
+	int pixAlignment = 8 * 8 / depth;
+	fPixMap.rowBytes = (((inWidth + pixAlignment - 1) & -pixAlignment) * depth) / 8;
+	SetRect(&fPixMap.bounds, 0, 0, inWidth, inHeight);
+	fPixMap.pixMapFlags = kPixMapPtr + depth;
+	fPixMap.deviceRes = gScreenPixelMap.deviceRes;
+	fPixMap.grayTable = NULL;
+	fPixMap.baseAddr = NewPtr(fPixMap.rowBytes * inHeight);
+	if (fPixMap.baseAddr == NULL)
+		return false;
+	fContext = CGPixelMapContextCreate(&fPixMap);
+#else
+	CGColorSpaceRef space = CGColorSpaceCreateDeviceGray();
+	fContext = CGBitmapContextCreate(NULL, inWidth, inHeight, 8, 0, space, kCGImageAlphaNone);
+	CGColorSpaceRelease(space);
+#endif
+	if (fContext == NULL)
+	{
+		free();
+		return false;
+	}
+
+	fWidth = inWidth;
+	fHeight = inHeight;
+	return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Free the offscreen pixels.
+----------------------------------------------------------------------------- */
+
+void
+CBackingStore::free(void)
+{
+	if (fContext)
+		CGContextRelease(fContext), fContext = NULL;
+#if defined(forSoftQuartz)
+	if (fPixMap.baseAddr)
+		FreePtr(fPixMap.baseAddr), fPixMap.baseAddr = NULL;
+#endif
+	fWidth = fHeight = 0;
+	fIsValid = false;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Redirect drawing to the offscreen pixels.
+	Its user space is made the same as the screen's, so a view at inBounds
+	draws into the offscreen pixels exactly as it would onto the screen.
+	Args:		inBounds			global bounds of what is to be drawn
+	Return:	false => could not allocate the pixels; draw to the screen instead
+----------------------------------------------------------------------------- */
+
+bool
+CBackingStore::beginDrawing(const Rect * inBounds)
+{
+	int width = RectGetWidth(*inBounds);
+	int height = RectGetHeight(*inBounds);
+	if ((fContext == NULL || width != fWidth || height != fHeight)
+	&&  !allocate(width, height))
+		return false;
+
+	CGContextSaveGState(fContext);
+	// MakeCGRect() flips y about the screen height; map inBounds onto our pixels
+	CGContextTranslateCTM(fContext, -inBounds->left, height + inBounds->top - gScreenHeight);
+	CGContextSetFillColorWithColor(fContext, gWhiteColor);
+	CGContextFillRect(fContext, MakeCGRect(*inBounds));
+
+	// redirect drawing last, so there is nothing to undo if anything above fails
+	fBounds = *inBounds;
+	fSavedContext = quartz;
+	quartz = fContext;
+	gNumOfStoresDrawing++;
+	return true;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Restore drawing to the screen.
+	The pixels are now valid; if drawing failed the caller must invalidate().
+----------------------------------------------------------------------------- */
+
+void
+CBackingStore::endDrawing(void)
+{
+	CGContextRestoreGState(fContext);
+	quartz = fSavedContext;
+	fSavedContext = NULL;
+	gNumOfStoresDrawing--;
+	fIsValid = true;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Copy the offscreen pixels to the screen, subject to its current clipping.
+	Args:		inBounds			where the view now is
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CBackingStore::draw(const Rect * inBounds)
+{
+#if defined(forSoftQuartz)
+	CGImageRef image = CGPixelMapContextCreateImage(fContext);
+#else
+	CGImageRef image = CGBitmapContextCreateImage(fContext);
+#endif
+	if (image)
+	{
+		CGContextDrawImage(quartz, MakeCGRect(*inBounds), image);
+		CGImageRelease(image);
+	}
+	fBounds = *inBounds;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Is drawing going into a backing store rather than onto the screen?
+	Args:		--
+	Return:	true => it is
+----------------------------------------------------------------------------- */
+
+bool
+CBackingStore::isDrawing(void)
+{
+	return gNumOfStoresDrawing > 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+	Mark stale every backing store that has been drawn over directly on the
+	screen, so that its view is drawn again rather than copied over what is
+	now there.
+	Args:		inBounds			global bounds of what was drawn
+	Return:	--
+----------------------------------------------------------------------------- */
+
+void
+CBackingStore::invalidateOverlapping(const Rect * inBounds)
+{
+	for (CBackingStore * store = gBackingStores; store != NULL; store = store->fNext)
+	{
+		if (store->fIsValid && Overlaps(&store->fBounds, inBounds))
+			store->fIsValid = false;
+	}
+}
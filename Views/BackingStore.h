@@ -0,0 +1,72 @@
+/*
+	File:		BackingStore.h
+
+	Contains:	Offscreen copy of a view's drawing.
+					A view with vfBackingStore in its viewFormat draws itself and
+					its children into one of these; the screen is then updated from
+					it, so the view can be moved or partly uncovered without running
+					its drawing code again.
+
+	Written by:	Newton Research Group.
+*/
+
+#if !defined(__BACKINGSTORE_H)
+#define __BACKINGSTORE_H 1
+
+#include "Quartz.h"
+#include "Geometry.h"
+
+
+/* -----------------------------------------------------------------------------
+	C B a c k i n g S t o r e
+	Holds the pixels of a view's outer bounds. The bounds are remembered only
+	for their size: the pixels are drawn wherever the view now is.
+	Drawing happens between beginDrawing() and endDrawing(), during which the
+	global quartz context is redirected to the offscreen pixels (with the same
+	user space as the screen) so that existing drawing code works unchanged.
+	The caller must call endDrawing() however drawing ends, to get the screen
+	context back.
+	Anything drawn straight onto the screen -- live ink, a highlight, a shape
+	drawn by a script -- is not in the pixels, and copying them back would wipe
+	it out; invalidateOverlapping() marks stale the stores it lies over.
+----------------------------------------------------------------------------- */
+
+class CBackingStore
+{
+public:
+						CBackingStore();
+						~CBackingStore();
+
+	bool				isValid(const Rect * inBounds) const;
+	void				invalidate(void);
+
+	bool				beginDrawing(const Rect * inBounds);
+	void				endDrawing(void);
+	void				draw(const Rect * inBounds);
+
+	static bool		isDrawing(void);
+	static void		invalidateOverlapping(const Rect * inBounds);
+
+private:
+	bool				allocate(int inWidth, int inHeight);
+	void				free(void);
+
+	CGContextRef	fContext;
+	CGContextRef	fSavedContext;	// screen context while we are drawing
+	CBackingStore *	fNext;		// in the list of all stores
+	Rect				fBounds;			// global bounds last drawn at
+	int				fWidth;
+	int				fHeight;
+	bool				fIsValid;
+#if defined(forSoftQuartz)
+	NativePixelMap	fPixMap;
+#endif
+};
+
+inline bool		CBackingStore::isValid(const Rect * inBounds) const
+{ return fIsValid && fWidth == RectGetWidth(*inBounds) && fHeight == RectGetHeight(*inBounds); }
+
+inline void		CBackingStore::invalidate(void)  { fIsValid = false; }
+
+
+#endif	/* __BACKINGSTORE_H */
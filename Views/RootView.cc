@@ -21,9 +21,11 @@
 #include "Preference.h"
 
 #include "RootView.h"
+#include "BackingStore.h"
 #include "ParagraphView.h"
 #include "Clipboard.h"
 #include "Screen.h"
+#include "HeadlessDisplay.h"
 #include "Modal.h"
 #include "Notebook.h"
 #include "Animation.h"
@@ -491,6 +493,8 @@ void
 CRootView::smartScreenDirty(const Rect * inRect)
 {
 	UnionRect(&fInkyRect, inRect, &fInkyRect);
+	// not in the original: live ink is drawn straight onto the screen, not into any backing store
+	CBackingStore::invalidateOverlapping(inRect);
 }
 
 
@@ -532,6 +536,7 @@ printf("CRootView::update(inRect={t:%d,l:%d,b:%d,r:%d})\n", inRect->top, inRect-
 		bool  updateCaret = false;
 		if (!caretValid(&pt))
 			updateCaret = true;
+		StartFrameTiming(kFrameUpdate);
 		updateDefaultButtonAndCaretSlip();
 
 		if (gSlowMotion == 0)
@@ -562,6 +567,7 @@ printf("CRootView::update(inRect={t:%d,l:%d,b:%d,r:%d})\n", inRect->top, inRect-
 			fInkyRect = gZeroRect;				// original sets em manually
 		}
 
+		StartFrameTiming(kFrameDraw);
 		for (ArrayIndex i = 0; i < kNumOfLayers; ++i)
 		{
 			if (fLayer[i].fView != NULL)
@@ -598,9 +604,12 @@ printf("CRootView::update(inRect={t:%d,l:%d,b:%d,r:%d})\n", inRect->top, inRect-
 
 		if (updateCaret && caretEnabled())
 			drawCaret(pt);
+		StopFrameTiming(kFrameDraw);
 
 		if (gSlowMotion == 0)
 			StopDrawing(NULL, NULL);		// blit to h/w screen
+		StopFrameTiming(kFrameUpdate);
+		EndFrame();
 	}
 }
 
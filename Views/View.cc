@@ -30,6 +30,7 @@
 
 #include "Geometry.h"
 #include "DrawShape.h"
+#include "BackingStore.h"
 
 
 /* -------------------------------------------------------------------------------
@@ -158,11 +159,16 @@ VIEW_SOURCE_MACRO(clView, CView, CResponder)
 
 /* -------------------------------------------------------------------------------
 	Constructor.
-	Doesnt do anything, initialization is done in init().
+	Initialization is done in init(); only the visRgn cache and backing store
+	are set up here so that the destructor is always safe.
 ------------------------------------------------------------------------------- */
 
 CView::CView()
-{ }
+{
+	fVisRgn = NULL;
+	fVisRgnGeneration = 0;
+	fBackingStore = NULL;
+}
 
 
 /* -------------------------------------------------------------------------------
@@ -170,7 +176,12 @@ CView::CView()
 ------------------------------------------------------------------------------- */
 
 CView::~CView()
-{ }
+{
+	if (fVisRgn)
+		delete fVisRgn;
+	if (fBackingStore)
+		delete fBackingStore;
+}
 
 
 /* -------------------------------------------------------------------------------
@@ -1165,6 +1176,7 @@ void
 CView::setDataSlot(RefArg inTag, RefArg inValue)
 {
 	SetFrameSlot(dataFrame(), inTag, inValue);
+	invalidateBackingStore();
 }
 
 
@@ -1453,9 +1465,22 @@ CRegion
 CView::setupVisRgn(void)
 {
 	CRegionVar visRgn;
-	visRgn.fRegion->setRegion(ViewPortRegion());
 
-	for (CView * view = this; view != gRootView; view = view->fParent)
+	// the region depends only on views within our clippers view, so its generation tells us whether a cached region is still good
+	CClipper * clipperOfView = NULL;
+	CView * view;
+	for (view = this; view != gRootView && !view->hasVisRgn(); view = view->fParent)
+		;
+	if (view != gRootView)
+		clipperOfView = view->clipper();
+	if (clipperOfView != NULL && fVisRgn != NULL && fVisRgnGeneration == clipperOfView->fGeneration)
+	{
+		visRgn.fRegion->setRegion(*fVisRgn);
+		return visRgn;
+	}
+
+	visRgn.fRegion->setRegion(ViewPortRegion());
+	for (view = this; view != gRootView; view = view->fParent)
 	{
 		CClipper * clip = view->clipper();
 		if (clip)
@@ -1464,20 +1489,51 @@ CView::setupVisRgn(void)
 //			SectRgn(visRgn, *clip->x04, visRgn);
 			break;
 		}
-		if (FLAGTEST(viewFlags, vClickable))
+		if (FLAGTEST(view->viewFlags, vClickable))
 		{
 			CRectangularRegion tapRgn(view->viewBounds);
 			visRgn.fRegion->sectRegion(tapRgn);
 //			SectRgn(visRgn, tapRgn, visRgn);
 		}
-		visRgn.fRegion->diffRegion(*getFrontMask().fRegion);
+		visRgn.fRegion->diffRegion(*view->getFrontMask().fRegion);
 //		DiffRgn(visRgn, getFrontMask(), visRgn);
 	}
 
+	if (clipperOfView != NULL)
+	{
+		if (fVisRgn == NULL)
+			fVisRgn = new CBaseRegion;
+		fVisRgn->setRegion(*visRgn.fRegion);
+		fVisRgnGeneration = clipperOfView->fGeneration;
+	}
 	return visRgn;
 }
 
 
+/* -------------------------------------------------------------------------------
+	Note that this views bounds, visibility or stacking order have changed.
+	Any visRgn cached by a view within the same clipped view may now be wrong,
+	so move that clipper on to a new generation. Views under other clippers
+	keep their cached regions.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------- */
+
+void
+CView::visRgnChanged(void)
+{
+	CView * view;
+	for (view = this; view != gRootView && !view->hasVisRgn(); view = view->fParent)
+		;
+	if (view != gRootView)
+	{
+		CClipper * clip = view->clipper();
+		if (clip)
+			clip->invalidate();
+	}
+}
+
+
 /* -------------------------------------------------------------------------------
 	Determine whether we have a visible region.
 	The answers true if we are a child of the root view.
@@ -1580,12 +1636,29 @@ CView::clipper(void)
 
 /* -------------------------------------------------------------------------------
 	Dirty this view so that it will be redrawn.
+	What it draws has changed, so any backing store holding it is stale.
 	Args:		inBounds		rect within the view to dirty
 	Return:	--
 ------------------------------------------------------------------------------- */
 
 void
 CView::dirty(const Rect * inBounds)
+{
+	invalidateBackingStore();
+	redraw(inBounds);
+}
+
+
+/* -------------------------------------------------------------------------------
+	Invalidate the screen where this view is so that it will be redrawn.
+	Unlike dirty() this does not imply that what the view draws has changed --
+	it has just moved, say -- so its own backing store is still good.
+	Args:		inBounds		rect within the view to redraw
+	Return:	--
+------------------------------------------------------------------------------- */
+
+void
+CView::redraw(const Rect * inBounds)
 {
 if (inBounds) printf("CView<%p>::dirty(inBounds={t:%d,l:%d,b:%d,r:%d})\n", this, inBounds->top, inBounds->left, inBounds->bottom, inBounds->right); else printf("CView<%p>::dirty(inBounds=NULL)\n", this);
 if (inBounds != NULL && inBounds->top < 0)
@@ -1628,6 +1701,25 @@ if (inBounds != NULL && inBounds->top < 0)
 }
 
 
+/* -------------------------------------------------------------------------------
+	Mark the backing store of this view, and of every view enclosing it, as
+	stale. Their drawing includes ours.
+	Args:		--
+	Return:	--
+------------------------------------------------------------------------------- */
+
+void
+CView::invalidateBackingStore(void)
+{
+	CView * view = this;
+	do
+	{
+		if (view->fBackingStore)
+			view->fBackingStore->invalidate();
+	} while (view != gRootView && (view = view->fParent) != NULL);
+}
+
+
 /* -------------------------------------------------------------------------------
 	Show the view. Theres no animation but may be a sound.
 	Args:		--
@@ -1649,7 +1741,10 @@ CView::show(void)
 		if (hasVisRgn())
 			fParent->viewVisibleChanged(this, true);
 		else
+		{
+			visRgnChanged();
 			dirty();
+		}
 
 		animation.doEffect(SYMA(showSound));
 
@@ -1681,6 +1776,11 @@ CView::hide(void)
 
 	runScript(SYMA(viewHideScript), RA(NILREF));
 
+	// we no longer need our pixels, and enclosing views no longer include them
+	if (fBackingStore)
+		delete fBackingStore, fBackingStore = NULL;
+	invalidateBackingStore();
+
 	if (hasVisRgn())
 	{
 		clearFlags(vVisible);
@@ -1691,6 +1791,7 @@ CView::hide(void)
 		Rect	bounds;
 		outerBounds(&bounds);
 		clearFlags(vVisible);
+		visRgnChanged();
 		gRootView->smartInvalidate(&bounds);
 	}
 
@@ -1720,11 +1821,15 @@ CView::setBounds(const Rect * inBounds)
 	CClipper * clip = clipper();
 	if (clip)
 	{
-		Rect bounds;
-		outerBounds(&bounds);		// sic - doesnt appear to have any effect
+		// views behind us may be uncovered where we were, or obscured where we are now
+		Rect changedArea = clip->fFullRgn->fRegion->bounds();
 		clip->updateRegions(this);
-		fParent->viewVisibleChanged(this, false);
+		Rect bounds = clip->fFullRgn->fRegion->bounds();
+		UnionRect(&changedArea, &bounds, &changedArea);
+		fParent->viewVisibleChanged(this, false, &changedArea);
 	}
+	else
+		visRgnChanged();
 }
 
 
@@ -2100,7 +2205,8 @@ CView::offset(Point inDelta)
 	simpleOffset(inDelta, false);
 
 	if (hasNoVisRgn)
-		dirty();
+		// what we draw is unchanged, only where
+		redraw();
 	else
 		fParent->childViewMoved(this, inDelta);
 
@@ -2115,6 +2221,7 @@ CView::simpleOffset(Point inDelta, bool inAlways)
 		return;
 
 	OffsetRect(&viewBounds, inDelta.h, inDelta.v);
+	visRgnChanged();
 
 	CView *		view;
 	CListLoop	iter(viewChildren);
@@ -2484,7 +2591,22 @@ CView::reorderView(CView * inView, int index)
 	viewChildren->insertAt(index, inView);
 
 	if (!FLAGTEST(inView->viewFlags, vVisible))
+	{
+		// it hides nothing, but what it would show has changed
+		inView->visRgnChanged();
 		return;
+	}
+
+	// only the views between the old and new positions have changed places,
+	// and only where they overlap the view that moved
+	CClipper * clip = inView->clipper();
+	if (clip)
+	{
+		Rect changedArea = clip->fFullRgn->fRegion->bounds();
+		viewVisibleChanged((CView *)viewChildren->at(MAX(viewIndex, index)), false, &changedArea);
+	}
+	else
+		inView->visRgnChanged();
 
 	// INCOMPLETE!
 	// calculate the region invalidated by the new arrangement, and invalidate it
@@ -2496,7 +2618,7 @@ CView::reorderView(CView * inView, int index)
 void
 CView::bringToFront(void)
 {
-	fParent->reorderView(this, viewChildren->count());
+	fParent->reorderView(this, fParent->viewChildren->count());
 }
 
 
@@ -2589,8 +2711,20 @@ CView::childViewMoved(CView * inView, Point inDelta)
 	if (!inView->hasVisRgn())
 		return;
 
+	invalidateBackingStore();
+
+	// as in viewVisibleChanged, nothing outside our bounds is visible
+	Rect bBox;
+	bBox.left = -32767;
+	bBox.top = -32767;
+	bBox.right = 32767;
+	bBox.bottom = 32767;
+	CRectangularRegion wideOpenRgn(bBox);
 	CRegionVar foregroundMask;
-	foregroundMask.fRegion->setEmpty();
+	foregroundMask.fRegion->setRegion(wideOpenRgn);
+	outerBounds(&bBox);
+	CRectangularRegion boundsRgn(bBox);
+	foregroundMask.fRegion->diffRegion(boundsRgn);
 	CRegionVar dirty;
 	dirty.fRegion->setEmpty();
 
@@ -2614,9 +2748,11 @@ CView::childViewMoved(CView * inView, Point inDelta)
 				// update its position
 				clip->offset(inDelta);
 			}
-			if (isBehind)
+			// views behind that dont overlap the area uncovered or covered by the move cant have changed
+			Rect fullBounds = clip->fFullRgn->fRegion->bounds();
+			if (isBehind && (view == inView || dirty.fRegion->intersects(&fullBounds)))
 			{
-				clip->recalcVisible(*dirty.fRegion);
+				clip->recalcVisible(*foregroundMask.fRegion);
 				if (view == inView)
 				{
 					// get the new extent now that the view has moved
@@ -2803,15 +2939,31 @@ CView::narrowVisByIntersectingObscuringSiblingsAndUncles(CView * inView, Rect *
 /* -----------------------------------------------------------------------------
 	A child views visibility has changed.
 	Invalidate display regions as necessary.
-	Args:		inView		the view that has become (in)visible
-								MUST be a child of ours
-				inVisible	true => is now visible
+	Args:		inView			the view that has become (in)visible
+									MUST be a child of ours
+				inVisible		true => is now visible
+				inChangedArea	where views behind inView might be covered or
+									uncovered; NULL => inViews bounds
 	Return:	--
 ----------------------------------------------------------------------------- */
 
 void
-CView::viewVisibleChanged(CView * inView, bool inVisible)
+CView::viewVisibleChanged(CView * inView, bool inVisible, const Rect * inChangedArea)
 {
+	invalidateBackingStore();
+
+	Rect changedArea;
+	if (inChangedArea != NULL)
+		changedArea = *inChangedArea;
+	else
+	{
+		CClipper * clip = inView->clipper();
+		if (clip)
+			changedArea = clip->fFullRgn->fRegion->bounds();
+		else
+			inView->outerBounds(&changedArea);
+	}
+
 	CRegionVar foregroundMask;
 
 	Rect bBox;
@@ -2862,7 +3014,9 @@ CView::viewVisibleChanged(CView * inView, bool inVisible)
 			CClipper * clip = view->clipper();
 			if (clip)
 			{
-				if (isBehind)
+				// views behind that dont overlap the changed area keep their visible regions
+				Rect fullBounds = clip->fFullRgn->fRegion->bounds();
+				if (isBehind && (view == inView || RectsOverlap(&fullBounds, &changedArea)))
 					clip->recalcVisible(*foregroundMask.fRegion);
 				// this view is now part of the foreground of views further back
 				foregroundMask.fRegion->unionRegion(*clip->fFullRgn->fRegion);
@@ -2928,7 +3082,11 @@ CView::changed(RefArg inTag, RefArg inContext)
 	if (hasNoScripts)
 		setFlags(vNoScripts);
 
-	dirty();
+	// a change of size alone is noticed when we next draw
+	if (EQ(inTag, SYMA(viewBounds)))
+		redraw();
+	else
+		dirty();
 }
 
 
@@ -2986,6 +3144,9 @@ CView::hilite(bool isOn)
 		outerBounds(&bounds);
 		if ((isCaretOn = Overlaps(&caretBounds, &bounds)))	// intentional assignment
 			gRootView->hideCaret();
+		// not in the original: a highlight drawn onto the screen is not in any backing store
+		if (!CBackingStore::isDrawing())
+			CBackingStore::invalidateOverlapping(&bounds);
 
 		unwind_protect
 		{
@@ -3495,7 +3656,11 @@ CView::update(CBaseRegion& inUpdateRgn, CView * inView)
 	{
 //		clip to inUpdateRgn
 //		SectRgn(clipRgn, inUpdateRgn, clipRgn);
+#if defined(forSoftQuartz)
+		CGContextClipToRegion(quartz, inUpdateRgn);
+#else
 		CGContextClipToRect(quartz, MakeCGRect(inUpdateRgn.bounds()));
+#endif
 		CView * view = (inView != NULL) ? inView : this;
 //		if ((view->viewFormat & vfFillMask) == vfNone)
 //			EraseRgn(clipRgn);
@@ -3593,110 +3758,174 @@ printf("CView<%p>::draw(region={t:%d,l:%d,b:%d,r:%d})\n", this, inUpdateRgn.boun
 			needsUpdate = inUpdateRgn.intersects(&bBox);
 		if (needsUpdate)
 		{
-/*			CRegionStruct *  savedClipRgn = NULL;	//sp04
-			CRegionStruct *  sp00 = NULL;
-			if (!gSkipVisRegions)
-			{
-				CRegion	rgn;
-				if (hasVisRgn())
-				{
-					rgn = setupVisRgn();
-					sp00 = rgn->stealRegion();
-				}
-			}
-*/
-			unwind_protect
-			{
-/*				GrafPtr  thePort;
-				GetPort(&thePort);
-				if (savedClipRgn == NULL || !EmptyRgn(thePort->clipRgn))
-*/				{
-					if (gSlowMotion != 0 && viewChildren != gEmptyViewList)
-						StartDrawing(NULL, NULL);
-
-					preDraw(updateBounds);
+			if (inForPrint || !drawBackingStore(bBox))
+				drawContents(inUpdateRgn, updateBounds);
+		}
+	}
 
-					if (FLAGTEST(viewFlags, vClipping))
-					{
-/*						// save the ports clipRgn
-						savedClipRgn = new CRegionStruct;
-						GrafPtr thePort;
-						GetPort(&thePort);
-						CopyRgn(thePort->clipRgn, savedClipRgn);
-
-						// clip the ports clipRgn to this views bounds
-						GetPort(&thePort);
-						RgnHandle sp008 = thePort->clipRgn;
-						CRectangularRegion viewRgn(viewBounds);
-						SectRgn(sp008, viewRgn, sp008);
-*/						CGContextSaveGState(quartz);
-						CGContextClipToRect(quartz, MakeCGRect(viewBounds));
-					}
+	if (gOutlineViews)
+	{
+		SetPattern(vfGray);
+		SetLineWidth(2);
+		StrokeRect(viewBounds);
+	}
+}
 
-					realDraw(updateBounds);
 
-					if (fTagCacheMaskLo & kIndexViewDrawScript)
-					{
-						newton_try
-						{
-							runCacheScript(kIndexViewDrawScript, RA(NILREF));
-						}
-						newton_catch(exRootException)
-						{ }
-						end_try;
-					}
+/* -------------------------------------------------------------------------------
+	Draw this view and its children.
+	Args:		inUpdateRgn			update region
+				inUpdateBounds		its bounds
+	Return:	--
+------------------------------------------------------------------------------- */
 
-					drawChildren(inUpdateRgn, NULL);
+void
+CView::drawContents(CBaseRegion& inUpdateRgn, Rect& inUpdateBounds)
+{
+/*	CRegionStruct *  savedClipRgn = NULL;	//sp04
+	CRegionStruct *  sp00 = NULL;
+	if (!gSkipVisRegions)
+	{
+		CRegion	rgn;
+		if (hasVisRgn())
+		{
+			rgn = setupVisRgn();
+			sp00 = rgn->stealRegion();
+		}
+	}
+*/
+	unwind_protect
+	{
+/*		GrafPtr  thePort;
+		GetPort(&thePort);
+		if (savedClipRgn == NULL || !EmptyRgn(thePort->clipRgn))
+*/		{
+			if (gSlowMotion != 0 && viewChildren != gEmptyViewList)
+				StartDrawing(NULL, NULL);
 
-					if (FLAGTEST(viewFlags, vClipping))
-					{
-/*						// restore the ports clipRgn
-						GrafPtr thePort;
-						GetPort(&thePort);
-						RgnHandle theRgn = thePort->clipRgn;
-						CopyRgn(savedClipRgn, theRgn);
-						delete savedClipRgn, savedClipRgn = NULL;
-*/						CGContextRestoreGState(quartz);
-					}
+			preDraw(inUpdateBounds);
 
-					postDraw(updateBounds);
+			if (FLAGTEST(viewFlags, vClipping))
+			{
+/*				// save the ports clipRgn
+				savedClipRgn = new CRegionStruct;
+				GrafPtr thePort;
+				GetPort(&thePort);
+				CopyRgn(thePort->clipRgn, savedClipRgn);
 
-					if (gSlowMotion != 0 && viewChildren != gEmptyViewList)
-					{
-						StopDrawing(NULL, NULL);
-						Wait(gSlowMotion);
-					}
-				}
+				// clip the ports clipRgn to this views bounds
+				GetPort(&thePort);
+				RgnHandle sp008 = thePort->clipRgn;
+				CRectangularRegion viewRgn(viewBounds);
+				SectRgn(sp008, viewRgn, sp008);
+*/				CGContextSaveGState(quartz);
+				CGContextClipToRect(quartz, MakeCGRect(viewBounds));
 			}
-			on_unwind
+
+			realDraw(inUpdateBounds);
+
+			if (fTagCacheMaskLo & kIndexViewDrawScript)
 			{
-/*				if (savedClipRgn)
+				newton_try
 				{
-					GrafPtr thePort;
-					GetPort(&thePort);
-					RgnHandle theRgn = thePort->clipRgn;
-					CopyRgn(savedClipRgn, theRgn);
-					delete savedClipRgn;
+					runCacheScript(kIndexViewDrawScript, RA(NILREF));
 				}
-				if (sp00)
-				{
-					GrafPtr thePort;
-					GetPort(&thePort);
-					RgnHandle theRgn = thePort->clipRgn;
-					CopyRgn(sp00, theRgn);
-					delete sp00;
-				}
-*/			}
-			end_unwind;
+				newton_catch(exRootException)
+				{ }
+				end_try;
+			}
+
+			drawChildren(inUpdateRgn, NULL);
+
+			if (FLAGTEST(viewFlags, vClipping))
+			{
+/*				// restore the ports clipRgn
+				GrafPtr thePort;
+				GetPort(&thePort);
+				RgnHandle theRgn = thePort->clipRgn;
+				CopyRgn(savedClipRgn, theRgn);
+				delete savedClipRgn, savedClipRgn = NULL;
+*/				CGContextRestoreGState(quartz);
+			}
+
+			postDraw(inUpdateBounds);
+
+			if (gSlowMotion != 0 && viewChildren != gEmptyViewList)
+			{
+				StopDrawing(NULL, NULL);
+				Wait(gSlowMotion);
+			}
 		}
 	}
+	on_unwind
+	{
+/*		if (savedClipRgn)
+		{
+			GrafPtr thePort;
+			GetPort(&thePort);
+			RgnHandle theRgn = thePort->clipRgn;
+			CopyRgn(savedClipRgn, theRgn);
+			delete savedClipRgn;
+		}
+		if (sp00)
+		{
+			GrafPtr thePort;
+			GetPort(&thePort);
+			RgnHandle theRgn = thePort->clipRgn;
+			CopyRgn(sp00, theRgn);
+			delete sp00;
+		}
+*/	}
+	end_unwind;
+}
 
-	if (gOutlineViews)
+
+/* -------------------------------------------------------------------------------
+	Draw this view from its backing store, first bringing that up to date if
+	need be. The backing store holds all of the view, so once it is valid the
+	view can be moved or uncovered without drawing it again.
+	Only opaque views -- those with a fill, and square unshadowed corners --
+	can use a backing store, since its pixels replace whatever is behind.
+	Args:		inBounds			outer bounds of the view
+	Return:	false => the view must be drawn directly
+------------------------------------------------------------------------------- */
+
+bool
+CView::drawBackingStore(Rect& inBounds)
+{
+	if (!FLAGTEST(viewFormat, vfBackingStore) || (viewFormat & vfFillMask) == vfNone
+	||  FLAGTEST(viewFormat, vfRoundMask|vfShadowMask) || this == gRootView)
 	{
-		SetPattern(vfGray);
-		SetLineWidth(2);
-		StrokeRect(viewBounds);
+		if (fBackingStore)
+			// viewFormat has changed
+			delete fBackingStore, fBackingStore = NULL;
+		return false;
+	}
+
+	if (fBackingStore == NULL
+	&& (fBackingStore = new CBackingStore) == NULL)
+		return false;
+
+	if (!fBackingStore->isValid(&inBounds))
+	{
+		if (!fBackingStore->beginDrawing(&inBounds))
+			return false;
+		unwind_protect
+		{
+			CRectangularRegion allRgn(inBounds);
+			drawContents(allRgn, inBounds);
+		}
+		on_unwind
+		{
+			fBackingStore->endDrawing();
+			if (unwind_failed())
+				fBackingStore->invalidate();
+		}
+		end_unwind;
 	}
+
+	fBackingStore->draw(&inBounds);
+	return true;
 }
 
 
@@ -22,6 +22,7 @@
 
 class CUnit;
 class CStroke;
+class CBackingStore;
 
 
 /*------------------------------------------------------------------------------
@@ -113,11 +114,14 @@ public:
 				Point		contentsOrigin(void);
 				Point		childOrigin(void);
 				CRegion	setupVisRgn(void);
+				void		visRgnChanged(void);
 				bool		hasVisRgn(void);
 				bool		visibleDeep(void);
 				CRegion	getFrontMask(void);
 				CClipper * clipper(void);
 	virtual	void		dirty(const Rect * inBounds = NULL);
+				void		redraw(const Rect * inBounds = NULL);
+				void		invalidateBackingStore(void);
 				void		show(void);
 	virtual	void		hide(void);
 
@@ -164,7 +168,7 @@ public:
 				CView *  findClosestView(Point inPt, ULong inRecognitionReqd, int * outDistance, Point * inSlop, bool * outIsClickable);
 				int		distance(Point inPt1, Point * ioPt2);
 	virtual	void		narrowVisByIntersectingObscuringSiblingsAndUncles(CView * inView, Rect * inBounds);
-				void		viewVisibleChanged(CView * inView, bool inVisible);
+				void		viewVisibleChanged(CView * inView, bool inVisible, const Rect * inChangedArea = NULL);
 
 	virtual	Ref		getRangeText(long inStart, long inEnd);
 				bool		isGridded(RefArg inGrid, Point * outSpacing);
@@ -229,6 +233,8 @@ public:
 				void		draw(CBaseRegion& inRgn, bool inForPrint=false);
 				void		drawChildren(Rect& inRect, CView * inView);
 				void		drawChildren(CBaseRegion& inRgn, CView * inView);
+				void		drawContents(CBaseRegion& inRgn, Rect& inRect);
+				bool		drawBackingStore(Rect& inBounds);
 	virtual	void		preDraw(Rect& inRect);
 	virtual	void		realDraw(Rect& inRect);
 	virtual	void		postDraw(Rect& inRect);
@@ -276,6 +282,9 @@ public:
 	ULong				fTagCacheMaskHi;	// +2C
 	ULong				fTagCacheMaskLo;	// +18
 	RefStruct		fContext;			// +24 NS object corresponding to this C view
+	CBaseRegion *	fVisRgn;				// cached result of setupVisRgn()
+	ULong				fVisRgnGeneration;	// generation of our clipper when it was cached
+	CBackingStore *	fBackingStore;		// offscreen copy of our drawing if vfBackingStore
 };
 
 
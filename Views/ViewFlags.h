@@ -1 +1 @@
-/*	File:		ViewFlags.h	Contains:	View flag declarations.	Written by:	Newton Research Group, 2007.*/#if !defined(__VIEWFLAGS_H)#define __VIEWFLAGS_H 1/*------------------------------------------------------------------------------	V i e w   F o r m a t s------------------------------------------------------------------------------*/#define vfNone				 0#define vfWhite			 1#define vfLtGray			 2#define vfGray				 3#define vfDkGray			 4#define vfBlack			 5#define vfDragger			13#define vfCustom			14#define vfMatte			15#define vfFillShift		0#define vfFillWhite		vfWhite#define vfFillLtGray		vfLtGray#define vfFillGray		vfGray#define vfFillDkGray		vfDkGray#define vfFillBlack		vfBlack#define vfFillCustom		vfCustom#define vfFillMask		0x0F#define vfFrameShift		4#define vfFrameWhite		(vfWhite		<< vfFrameShift)#define vfFrameLtGray	(vfLtGray	<< vfFrameShift)#define vfFrameGray		(vfGray		<< vfFrameShift)#define vfFrameDkGray	(vfDkGray	<< vfFrameShift)#define vfFrameBlack		(vfBlack		<< vfFrameShift)#define vfFrameDragger	(vfBlack		<< vfFrameShift)#define vfFrameCustom	(vfCustom	<< vfFrameShift)#define vfFrameMatte		(vfMatte		<< vfFrameShift)#define vfFrameMask		(0x0F	<< vfFrameShift)#define vfPenShift		8#define vfPen(x)			((x) << vfPenShift)#define vfPenMask			(0x0F << vfPenShift)#define vfLineShift		12#define vfLinesWhite		(vfWhite		<< vfLineShift)#define vfLinesLtGray	(vfLtGray	<< vfLineShift)#define vfLinesGray		(vfGray		<< vfLineShift)#define vfLinesDkGray	(vfDkGray	<< vfLineShift)#define vfLinesBlack		(vfBlack		<< vfLineShift)#define vfLinesCustom	(vfBlack		<< vfLineShift)#define vfLinesMask		(0x0F			<< vfLineShift)#define vfInsetShift		16#define vfInset(x)		((x) << vfInsetShift)#define vfInsetMask		(0x03	<< vfInsetShift)#define vfShadowShift	18#define vfShadow(x)		((x) << vfShadowShift)#define vfShadowMask		(0x03	<< vfShadowShift)#define vfHiliteShift	20#define vfHiliteInvert	(1			<< vfHiliteShift)#define vfHiliteBullet	(2			<< vfHiliteShift)#define vfHiliteTriangle (4 		<< vfHiliteShift)#define vfHiliteMask		(0x0F 	<< vfHiliteShift)#define vfRoundShift		24#define vfRound(x)		((x) << vfRoundShift)#define vfRoundMask		(0x0F << vfRoundShift)#define vfEverything		0x3FFFFFFF#define kDraggerBorder			7#define kDraggerInset			1#define kDraggerBorderWidth	8/*------------------------------------------------------------------------------	V i e w   F l a g s------------------------------------------------------------------------------*/#define vNoFlags					0#define vVisible					(1 <<  0)#define vReadOnly					(1 <<  1)#define vApplication				(1 <<  2)#define vCalculateBounds		(1 <<  3)#define vNoKeys					(1 <<  4)#define vClipping					(1 <<  5)#define vFloating					(1 <<  6)#define vWriteProtected			(1 <<  7)#define vSingleUnit				(1 <<  8)#define vClickable				(1 <<  9)#define vStrokesAllowed			(1 << 10)#define vGesturesAllowed		(1 << 11)#define vCharsAllowed			(1 << 12)#define vNumbersAllowed			(1 << 13)#define vLettersAllowed			(1 << 14)#define vPunctuationAllowed	(1 << 15)#define vShapesAllowed			(1 << 16)#define vMathAllowed				(1 << 17)#define vPhoneField				(1 << 18)#define vDateField				(1 << 19)#define vTimeField				(1 << 20)#define vAddressField			(1 << 21)#define vNameField				(1 << 22)#define vCapsRequired			(1 << 23)#define vCustomDictionaries	(1 << 24)#define vNothingAllowed			0#define vWordsAllowed			0x017EF000#define vDictionariesAllowed	0x01FFF000#define vRecognitionAllowed	0x01FFFF00#define vAnythingAllowed		0x01FFFE00#define vSelected					(1 << 25)#define vClipboard				(1 << 26)#define vNoScripts				(1 << 27)#define vEverything				0x0FFFFFFF// Private view flags, used during view construction#define vIsInSetupForm			(1 << 28)	//0x10000000#define vHasIdlerHint			(1 << 29)	//0x20000000#define vIsMarked					(1 << 30)	//0x40000000#define vIsInSetup2				(1 << 31)	//0x80000000 ?/*------------------------------------------------------------------------------	T e x t   F l a g s------------------------------------------------------------------------------*/#define vWidthIsParentWidth	(1 <<  0)#define vNoSpaces					(1 <<  1)#define vWidthGrowsWithText	(1 <<  2)#define vFixedTextStyle			(1 <<  3)#define vFixedInkTextStyle		(1 <<  4)#define vAlignToParentLineSpacing	(1 <<  5)#define vNoTrackScale			(1 <<  6)#define vAllowEmpty				(1 <<  7)#define vKeepStylesArray		(1 <<  8)#define vExpectingNumbers		(1 <<  9)#define vSingleKeyStrokes		(1 << 10)#define vStandAloneBounds		(1 << 11)#define vAlwaysTryKeyCommands (1 << 12)#define vCallStandardScripts  (1 << 13)#define vTakesCommandKeys		(1 << 14)#define vTakesAllKeys			(1 << 15)#define vTakesNoKeys				(1 << 16)/*------------------------------------------------------------------------------	V i e w   J u s t i f i c a t i o n------------------------------------------------------------------------------*/#define vjLeftH				0#define vjRightH				1#define vjCenterH				2#define vjFullH				3#define vjHMask				3#define vjTopV					(0 << 2)#define vjCenterV				(1 << 2)#define vjBottomV				(2 << 2)#define vjFullV				(3 << 2)#define vjVMask				(3 << 2)#define vjParentLeftH		(0 << 4)#define vjParentCenterH		(1 << 4)#define vjParentRightH		(2 << 4)#define vjParentFullH		(3 << 4)#define vjParentHMask		(3 << 4)#define vjParentTopV			(0 << 6)#define vjParentCenterV		(1 << 6)#define vjParentBottomV		(2 << 6)#define vjParentFullV		(3 << 6)#define vjParentVMask		(3 << 6)#define vjParentMask			(vjParentHMask + vjParentVMask)#define vjParentClip			(1 << 8)#define vjSiblingNoH			(0 << 9)#define vjSiblingCenterH	(1 << 9)#define vjSiblingRightH		(2 << 9)#define vjSiblingFullH		(3 << 9)#define vjSiblingLeftH		(4 << 9)#define vjSiblingHMask		(7 << 9)#define vjSiblingNoV			(0 << 12)#define vjSiblingCenterV	(1 << 12)#define vjSiblingBottomV	(2 << 12)#define vjSiblingFullV		(3 << 12)#define vjSiblingTopV		(4 << 12)#define vjSiblingVMask		(7 << 12)#define vjSiblingMask		(vjSiblingHMask + vjSiblingVMask)#define vjChildrenLasso		(1 << 15)#define vjReflow				(1 << 16)#define vjNoLineLimits		(0 << 23)#define vjOneLineOnly		(1 << 23)#define vjOneWordOnly		(2 << 23)#define vjOneCharOnly		(3 << 23)#define vjNoLineCompaction (3 << 23)#define vjLineLimitMask		(7 << 23)#define vjNoRatio				0#define vjLeftRatio			(1 << 26)#define vjRightRatio			(1 << 27)#define vjTopRatio			(1 << 28)#define vjBottomRatio		(1 << 29)#define vjParentAnchored	256#define vjEverything			0x3FFFFFFF#define vIsModal				0x40000000/*------------------------------------------------------------------------------	V i e w   E f f e c t s------------------------------------------------------------------------------*/#define fxColumnsShift			0#define fxColumns(num)			((num-1) << fxColumnsShift)#define fxColumnsMask			(0x1F << fxColumnsShift)		// = 31#define fxRowsShift				5#define fxRows(num)				((num-1) << fxRowsShift)#define fxRowsMask				(0x1F << fxRowsShift)			// = 992#define fxHStartPhaseShift		10#define fxHStartPhase			(1 << fxHStartPhaseShift)		// = 1024#define fxVStartPhaseShift		11#define fxVStartPhase			(1 << fxVStartPhaseShift)		// = 2048#define fxColAltHPhaseShift	12#define fxColAltHPhase			(1 << fxColAltHPhaseShift)		// = 4096#define fxColAltVPhaseShift	13#define fxColAltVPhase			(1 << fxColAltVPhaseShift)		// = 8192#define fxRowAltHPhaseShift	14#define fxRowAltHPhase			(1 << fxRowAltHPhaseShift)		// = 16384#define fxRowAltVPhaseShift	15#define fxRowAltVPhase			(1 << fxRowAltVPhaseShift)		// = 32768#define fxMoveHShift				16#define fxMoveH					(1 << fxMoveHShift)				// = 65536#define fxMoveVShift				17#define fxMoveV					(1 << fxMoveVShift)				// = 131072#define fxRevealLineShift		18#define fxRevealLine				(1 << fxRevealLineShift)		// = 262144#define fxWipeShift				19#define fxWipe						(1 << fxWipeShift)				// = 524288#define fxFromEdgeShift			20#define fxFromEdge				(1 << fxFromEdgeShift)			// = 1048576#define fxStepsShift				21#define fxSteps(num)				(((num-1) << fxStepsShift))#define fxStepsMask				(0x0F << fxStepsShift)			// = 31457280#define fxStepTimeShift			25#define fxStepTime(num)			(((num) << fxStepTimeShift))#define fxStepTimeMask			(0x0F << fxStepTimeShift)		// = 503316480#define fxLeft						(fxHStartPhase + fxMoveH)#define fxRight					fxMoveH#define fxUp						(fxVStartPhase + fxMoveV)#define fxDown						fxMoveV#define fxCheckerboardEffect	(fxColumns(8) + fxRows(8) + fxColAltVPhase + fxRowAltHPhase + fxDown)#define fxBarnDoorOpenEffect	(fxColumns(2) + fxColAltHPhase + fxRowAltVPhase + fxLeft + fxWipe)#define fxBarnDoorCloseEffect (fxColumns(2) + fxColAltHPhase + fxRowAltVPhase + fxRight + fxWipe)#define fxVenetianBlindsEffect (fxRows(8) + fxDown)#define fxIrisOpenEffect		(fxColumns(2) + fxRows(2) + fxUp + fxLeft + fxColAltHPhase + fxRowAltVPhase + fxRevealLine + fxWipe)#define fxIrisCloseEffect		(fxColumns(2) + fxRows(2) + fxUp + fxLeft + fxRevealLine + fxWipe)#define fxPopUpEffect			(fxUp + fxRevealLine)#define fxPopDownEffect			(fxDown + fxRevealLine)#define fxDrawerEffect			fxUp#define fxZoomOpenEffect		(fxColumns(2) + fxRows(2) + fxUp + fxLeft + fxColAltHPhase + fxRowAltVPhase)#define fxZoomCloseEffect		(fxColumns(2) + fxRows(2) + fxUp + fxLeft)#define fxZoomVerticalEffect	(fxColumns(1) + fxRows(2) + fxUp + fxRowAltVPhase)/*------------------------------------------------------------------------------	T r a n s f e r   M o d e s------------------------------------------------------------------------------*/#define modeCopy					0#define modeOr						1#define modeXor					2#define modeBic					3#define modeNotCopy				4#define modeNotOr					5#define modeNotXor				6#define modeNotBic				7#define modeMask					8/*------------------------------------------------------------------------------	C o p y   P r o t e c t i o n------------------------------------------------------------------------------*/#define cpNoCopyProtection		0#define cpNoCopies				(1 << 0)#define cpReadOnlyCopies		(1 << 1)#define cpOriginalOnlyCopies	(1 << 2)#define cpNewtonOnlyCopies		(1 << 3)/*------------------------------------------------------------------------------	T e x t   S t y l e s------------------------------------------------------------------------------*/#define tsFamilyShift		 0#define tsSizeShift			10#define tsFaceShift			20#define tsFamilyMask			0x000003FF#define tsSizeMask			0x000FFC00#define tsFaceMask			0x3FF00000#define tsSystem				0#define tsFancy				1#define tsSimple				2#define tsHandwriting		3#define tsSize(num)			((num) << tsSizeShift)#define kPlainFace			 0#define kBoldFace				(1 << 0)#define kItalicFace			(1 << 1)#define kUnderlineFace		(1 << 2)#define kOutlineFace			(1 << 3)#define kSuperScriptFace	(1 << 7)#define kSubScriptFace		(1 << 8)#define kUndefinedFace		(1 << 9)#define tsPlain				 0#define tsBold					(kBoldFace << tsFaceShift)#define tsItalic				(kItalicFace << tsFaceShift)#define tsUnderline			(kUnderlineFace << tsFaceShift)#define tsOutline				(kOutlineFace << tsFaceShift)#define tsSuperScript		(kSuperScriptFace << tsFaceShift)#define tsSubScript			(kSubScriptFace << tsFaceShift)#define tsUndefinedFace		(kUndefinedFace << tsFaceShift)#define simpleFont9			(tsSimple + tsSize(9) + tsPlain)#define simpleFont10			(tsSimple + tsSize(10) + tsPlain)#define simpleFont12			(tsSimple + tsSize(12) + tsPlain)#define simpleFont18			(tsSimple + tsSize(18) + tsPlain)#define fancyFont9			(tsFancy + tsSize(9) + tsPlain)#define fancyFont10			(tsFancy + tsSize(10) + tsPlain)#define fancyFont12			(tsFancy + tsSize(12) + tsPlain)#define fancyFont18			(tsFancy + tsSize(18) + tsPlain)#define userFont9				(tsFancy + tsSize(9) + tsPlain)#define userFont10			(tsFancy + tsSize(10) + tsPlain)#define userFont12			(tsFancy + tsSize(12) + tsPlain)#define userFont18			(tsFancy + tsSize(18) + tsPlain)#endif	/* __VIEWFLAGS_H */
\ No newline at end of file
+/*	File:		ViewFlags.h	Contains:	View flag declarations.	Written by:	Newton Research Group, 2007.*/#if !defined(__VIEWFLAGS_H)#define __VIEWFLAGS_H 1/*------------------------------------------------------------------------------	V i e w   F o r m a t s------------------------------------------------------------------------------*/#define vfNone				 0#define vfWhite			 1#define vfLtGray			 2#define vfGray				 3#define vfDkGray			 4#define vfBlack			 5#define vfDragger			13#define vfCustom			14#define vfMatte			15#define vfFillShift		0#define vfFillWhite		vfWhite#define vfFillLtGray		vfLtGray#define vfFillGray		vfGray#define vfFillDkGray		vfDkGray#define vfFillBlack		vfBlack#define vfFillCustom		vfCustom#define vfFillMask		0x0F#define vfFrameShift		4#define vfFrameWhite		(vfWhite		<< vfFrameShift)#define vfFrameLtGray	(vfLtGray	<< vfFrameShift)#define vfFrameGray		(vfGray		<< vfFrameShift)#define vfFrameDkGray	(vfDkGray	<< vfFrameShift)#define vfFrameBlack		(vfBlack		<< vfFrameShift)#define vfFrameDragger	(vfBlack		<< vfFrameShift)#define vfFrameCustom	(vfCustom	<< vfFrameShift)#define vfFrameMatte		(vfMatte		<< vfFrameShift)#define vfFrameMask		(0x0F	<< vfFrameShift)#define vfPenShift		8#define vfPen(x)			((x) << vfPenShift)#define vfPenMask			(0x0F << vfPenShift)#define vfLineShift		12#define vfLinesWhite		(vfWhite		<< vfLineShift)#define vfLinesLtGray	(vfLtGray	<< vfLineShift)#define vfLinesGray		(vfGray		<< vfLineShift)#define vfLinesDkGray	(vfDkGray	<< vfLineShift)#define vfLinesBlack		(vfBlack		<< vfLineShift)#define vfLinesCustom	(vfBlack		<< vfLineShift)#define vfLinesMask		(0x0F			<< vfLineShift)#define vfInsetShift		16#define vfInset(x)		((x) << vfInsetShift)#define vfInsetMask		(0x03	<< vfInsetShift)#define vfShadowShift	18#define vfShadow(x)		((x) << vfShadowShift)#define vfShadowMask		(0x03	<< vfShadowShift)#define vfHiliteShift	20#define vfHiliteInvert	(1			<< vfHiliteShift)#define vfHiliteBullet	(2			<< vfHiliteShift)#define vfHiliteTriangle (4 		<< vfHiliteShift)#define vfHiliteMask		(0x0F 	<< vfHiliteShift)#define vfRoundShift		24#define vfRound(x)		((x) << vfRoundShift)#define vfRoundMask		(0x0F << vfRoundShift)// not in the original: keep an offscreen copy of an opaque view (filled, square, unshadowed)#define vfBackingStoreShift	28#define vfBackingStore	(1 << vfBackingStoreShift)#define vfEverything		0x3FFFFFFF#define kDraggerBorder			7#define kDraggerInset			1#define kDraggerBorderWidth	8/*------------------------------------------------------------------------------	V i e w   F l a g s------------------------------------------------------------------------------*/#define vNoFlags					0#define vVisible					(1 <<  0)#define vReadOnly					(1 <<  1)#define vApplication				(1 <<  2)#define vCalculateBounds		(1 <<  3)#define vNoKeys					(1 <<  4)#define vClipping					(1 <<  5)#define vFloating					(1 <<  6)#define vWriteProtected			(1 <<  7)#define vSingleUnit				(1 <<  8)#define vClickable				(1 <<  9)#define vStrokesAllowed			(1 << 10)#define vGesturesAllowed		(1 << 11)#define vCharsAllowed			(1 << 12)#define vNumbersAllowed			(1 << 13)#define vLettersAllowed			(1 << 14)#define vPunctuationAllowed	(1 << 15)#define vShapesAllowed			(1 << 16)#define vMathAllowed				(1 << 17)#define vPhoneField				(1 << 18)#define vDateField				(1 << 19)#define vTimeField				(1 << 20)#define vAddressField			(1 << 21)#define vNameField				(1 << 22)#define vCapsRequired			(1 << 23)#define vCustomDictionaries	(1 << 24)#define vNothingAllowed			0#define vWordsAllowed			0x017EF000#define vDictionariesAllowed	0x01FFF000#define vRecognitionAllowed	0x01FFFF00#define vAnythingAllowed		0x01FFFE00#define vSelected					(1 << 25)#define vClipboard				(1 << 26)#define vNoScripts				(1 << 27)#define vEverything				0x0FFFFFFF// Private view flags, used during view construction#define vIsInSetupForm			(1 << 28)	//0x10000000#define vHasIdlerHint			(1 << 29)	//0x20000000#define vIsMarked					(1 << 30)	//0x40000000#define vIsInSetup2				(1 << 31)	//0x80000000 ?/*------------------------------------------------------------------------------	T e x t   F l a g s------------------------------------------------------------------------------*/#define vWidthIsParentWidth	(1 <<  0)#define vNoSpaces					(1 <<  1)#define vWidthGrowsWithText	(1 <<  2)#define vFixedTextStyle			(1 <<  3)#define vFixedInkTextStyle		(1 <<  4)#define vAlignToParentLineSpacing	(1 <<  5)#define vNoTrackScale			(1 <<  6)#define vAllowEmpty				(1 <<  7)#define vKeepStylesArray		(1 <<  8)#define vExpectingNumbers		(1 <<  9)#define vSingleKeyStrokes		(1 << 10)#define vStandAloneBounds		(1 << 11)#define vAlwaysTryKeyCommands (1 << 12)#define vCallStandardScripts  (1 << 13)#define vTakesCommandKeys		(1 << 14)#define vTakesAllKeys			(1 << 15)#define vTakesNoKeys				(1 << 16)/*------------------------------------------------------------------------------	V i e w   J u s t i f i c a t i o n------------------------------------------------------------------------------*/#define vjLeftH				0#define vjRightH				1#define vjCenterH				2#define vjFullH				3#define vjHMask				3#define vjTopV					(0 << 2)#define vjCenterV				(1 << 2)#define vjBottomV				(2 << 2)#define vjFullV				(3 << 2)#define vjVMask				(3 << 2)#define vjParentLeftH		(0 << 4)#define vjParentCenterH		(1 << 4)#define vjParentRightH		(2 << 4)#define vjParentFullH		(3 << 4)#define vjParentHMask		(3 << 4)#define vjParentTopV			(0 << 6)#define vjParentCenterV		(1 << 6)#define vjParentBottomV		(2 << 6)#define vjParentFullV		(3 << 6)#define vjParentVMask		(3 << 6)#define vjParentMask			(vjParentHMask + vjParentVMask)#define vjParentClip			(1 << 8)#define vjSiblingNoH			(0 << 9)#define vjSiblingCenterH	(1 << 9)#define vjSiblingRightH		(2 << 9)#define vjSiblingFullH		(3 << 9)#define vjSiblingLeftH		(4 << 9)#define vjSiblingHMask		(7 << 9)#define vjSiblingNoV			(0 << 12)#define vjSiblingCenterV	(1 << 12)#define vjSiblingBottomV	(2 << 12)#define vjSiblingFullV		(3 << 12)#define vjSiblingTopV		(4 << 12)#define vjSiblingVMask		(7 << 12)#define vjSiblingMask		(vjSiblingHMask + vjSiblingVMask)#define vjChildrenLasso		(1 << 15)#define vjReflow				(1 << 16)#define vjNoLineLimits		(0 << 23)#define vjOneLineOnly		(1 << 23)#define vjOneWordOnly		(2 << 23)#define vjOneCharOnly		(3 << 23)#define vjNoLineCompaction (3 << 23)#define vjLineLimitMask		(7 << 23)#define vjNoRatio				0#define vjLeftRatio			(1 << 26)#define vjRightRatio			(1 << 27)#define vjTopRatio			(1 << 28)#define vjBottomRatio		(1 << 29)#define vjParentAnchored	256#define vjEverything			0x3FFFFFFF#define vIsModal				0x40000000/*------------------------------------------------------------------------------	V i e w   E f f e c t s------------------------------------------------------------------------------*/#define fxColumnsShift			0#define fxColumns(num)			((num-1) << fxColumnsShift)#define fxColumnsMask			(0x1F << fxColumnsShift)		// = 31#define fxRowsShift				5#define fxRows(num)				((num-1) << fxRowsShift)#define fxRowsMask				(0x1F << fxRowsShift)			// = 992#define fxHStartPhaseShift		10#define fxHStartPhase			(1 << fxHStartPhaseShift)		// = 1024#define fxVStartPhaseShift		11#define fxVStartPhase			(1 << fxVStartPhaseShift)		// = 2048#define fxColAltHPhaseShift	12#define fxColAltHPhase			(1 << fxColAltHPhaseShift)		// = 4096#define fxColAltVPhaseShift	13#define fxColAltVPhase			(1 << fxColAltVPhaseShift)		// = 8192#define fxRowAltHPhaseShift	14#define fxRowAltHPhase			(1 << fxRowAltHPhaseShift)		// = 16384#define fxRowAltVPhaseShift	15#define fxRowAltVPhase			(1 << fxRowAltVPhaseShift)		// = 32768#define fxMoveHShift				16#define fxMoveH					(1 << fxMoveHShift)				// = 65536#define fxMoveVShift				17#define fxMoveV					(1 << fxMoveVShift)				// = 131072#define fxRevealLineShift		18#define fxRevealLine				(1 << fxRevealLineShift)		// = 262144#define fxWipeShift				19#define fxWipe						(1 << fxWipeShift)				// = 524288#define fxFromEdgeShift			20#define fxFromEdge				(1 << fxFromEdgeShift)			// = 1048576#define fxStepsShift				21#define fxSteps(num)				(((num-1) << fxStepsShift))#define fxStepsMask				(0x0F << fxStepsShift)			// = 31457280#define fxStepTimeShift			25#define fxStepTime(num)			(((num) << fxStepTimeShift))#define fxStepTimeMask			(0x0F << fxStepTimeShift)		// = 503316480#define fxLeft						(fxHStartPhase + fxMoveH)#define fxRight					fxMoveH#define fxUp						(fxVStartPhase + fxMoveV)#define fxDown						fxMoveV#define fxCheckerboardEffect	(fxColumns(8) + fxRows(8) + fxColAltVPhase + fxRowAltHPhase + fxDown)#define fxBarnDoorOpenEffect	(fxColumns(2) + fxColAltHPhase + fxRowAltVPhase + fxLeft + fxWipe)#define fxBarnDoorCloseEffect (fxColumns(2) + fxColAltHPhase + fxRowAltVPhase + fxRight + fxWipe)#define fxVenetianBlindsEffect (fxRows(8) + fxDown)#define fxIrisOpenEffect		(fxColumns(2) + fxRows(2) + fxUp + fxLeft + fxColAltHPhase + fxRowAltVPhase + fxRevealLine + fxWipe)#define fxIrisCloseEffect		(fxColumns(2) + fxRows(2) + fxUp + fxLeft + fxRevealLine + fxWipe)#define fxPopUpEffect			(fxUp + fxRevealLine)#define fxPopDownEffect			(fxDown + fxRevealLine)#define fxDrawerEffect			fxUp#define fxZoomOpenEffect		(fxColumns(2) + fxRows(2) + fxUp + fxLeft + fxColAltHPhase + fxRowAltVPhase)#define fxZoomCloseEffect		(fxColumns(2) + fxRows(2) + fxUp + fxLeft)#define fxZoomVerticalEffect	(fxColumns(1) + fxRows(2) + fxUp + fxRowAltVPhase)/*------------------------------------------------------------------------------	T r a n s f e r   M o d e s------------------------------------------------------------------------------*/#define modeCopy					0#define modeOr						1#define modeXor					2#define modeBic					3#define modeNotCopy				4#define modeNotOr					5#define modeNotXor				6#define modeNotBic				7#define modeMask					8/*------------------------------------------------------------------------------	C o p y   P r o t e c t i o n------------------------------------------------------------------------------*/#define cpNoCopyProtection		0#define cpNoCopies				(1 << 0)#define cpReadOnlyCopies		(1 << 1)#define cpOriginalOnlyCopies	(1 << 2)#define cpNewtonOnlyCopies		(1 << 3)/*------------------------------------------------------------------------------	T e x t   S t y l e s------------------------------------------------------------------------------*/#define tsFamilyShift		 0#define tsSizeShift			10#define tsFaceShift			20#define tsFamilyMask			0x000003FF#define tsSizeMask			0x000FFC00#define tsFaceMask			0x3FF00000#define tsSystem				0#define tsFancy				1#define tsSimple				2#define tsHandwriting		3#define tsSize(num)			((num) << tsSizeShift)#define kPlainFace			 0#define kBoldFace				(1 << 0)#define kItalicFace			(1 << 1)#define kUnderlineFace		(1 << 2)#define kOutlineFace			(1 << 3)#define kSuperScriptFace	(1 << 7)#define kSubScriptFace		(1 << 8)#define kUndefinedFace		(1 << 9)#define tsPlain				 0#define tsBold					(kBoldFace << tsFaceShift)#define tsItalic				(kItalicFace << tsFaceShift)#define tsUnderline			(kUnderlineFace << tsFaceShift)#define tsOutline				(kOutlineFace << tsFaceShift)#define tsSuperScript		(kSuperScriptFace << tsFaceShift)#define tsSubScript			(kSubScriptFace << tsFaceShift)#define tsUndefinedFace		(kUndefinedFace << tsFaceShift)#define simpleFont9			(tsSimple + tsSize(9) + tsPlain)#define simpleFont10			(tsSimple + tsSize(10) + tsPlain)#define simpleFont12			(tsSimple + tsSize(12) + tsPlain)#define simpleFont18			(tsSimple + tsSize(18) + tsPlain)#define fancyFont9			(tsFancy + tsSize(9) + tsPlain)#define fancyFont10			(tsFancy + tsSize(10) + tsPlain)#define fancyFont12			(tsFancy + tsSize(12) + tsPlain)#define fancyFont18			(tsFancy + tsSize(18) + tsPlain)#define userFont9				(tsFancy + tsSize(9) + tsPlain)#define userFont10			(tsFancy + tsSize(10) + tsPlain)#define userFont12			(tsFancy + tsSize(12) + tsPlain)#define userFont18			(tsFancy + tsSize(18) + tsPlain)#endif	/* __VIEWFLAGS_H */
\ No newline at end of file